@@ -0,0 +1,140 @@
+#include "stdafx.h"
+#include "Animation.h"
+#include <algorithm>
+#include <random>
+
+AnimationCurve::AnimationCurve() :
+    m_type(CurveTypeConstant),
+    m_value(0.0f),
+    m_rate(0.0f),
+    m_loop(false)
+{
+}
+
+AnimationCurve AnimationCurve::Constant(float value)
+{
+    AnimationCurve curve;
+    curve.m_value = value;
+    return curve;
+}
+
+AnimationCurve AnimationCurve::Linear(float value, float rate)
+{
+    AnimationCurve curve;
+    curve.m_type = CurveTypeLinear;
+    curve.m_value = value;
+    curve.m_rate = rate;
+    return curve;
+}
+
+AnimationCurve AnimationCurve::Rotation(float angle, float rate)
+{
+    AnimationCurve curve = Linear(angle, rate);
+    curve.m_type = CurveTypeRotation;
+    return curve;
+}
+
+AnimationCurve AnimationCurve::Keyframes(const AnimationKey* pKeys, UINT keyCount, bool loop)
+{
+    assert(keyCount > 0);
+
+    AnimationCurve curve;
+    curve.m_type = CurveTypeKeyframes;
+    curve.m_keys.assign(pKeys, pKeys + keyCount);
+    curve.m_loop = loop && keyCount > 1 && pKeys[keyCount - 1].time > pKeys[0].time;
+    return curve;
+}
+
+float AnimationCurve::Evaluate(double time) const
+{
+    switch (m_type)
+    {
+    case CurveTypeLinear:
+        return static_cast<float>(m_value + static_cast<double>(m_rate) * time);
+
+    case CurveTypeRotation:
+    {
+        // XM_2PI is a float, a little over 2 pi; hours in, wrapping by it would be off
+        // by more than float rounding.
+        const double twoPi = 6.283185307179586;
+        const double angle = m_value + static_cast<double>(m_rate) * time;
+        return static_cast<float>(angle - twoPi * floor(angle / twoPi));
+    }
+
+    case CurveTypeKeyframes:
+    {
+        const double firstTime = m_keys.front().time;
+        const double lastTime = m_keys.back().time;
+        if (m_loop)
+        {
+            const double span = lastTime - firstTime;
+            time = firstTime + (time - firstTime) - span * floor((time - firstTime) / span);
+        }
+        if (time <= firstTime)
+        {
+            return m_keys.front().value;
+        }
+        if (time >= lastTime)
+        {
+            return m_keys.back().value;
+        }
+
+        // The first key after time, and the one before it.
+        const auto next = std::upper_bound(m_keys.begin(), m_keys.end(), time,
+            [](double value, const AnimationKey& key) { return value < key.time; });
+        const auto previous = next - 1;
+        const double t = (time - previous->time) / (next->time - previous->time);
+        return static_cast<float>(previous->value + (next->value - previous->value) * t);
+    }
+
+    default:
+        return m_value;
+    }
+}
+
+XMMATRIX EvaluateObjectAnimation(const ObjectAnimation& animation, double time)
+{
+    const float x = animation.basePosition.x + animation.offsetX.Evaluate(time);
+    const float y = animation.basePosition.y + animation.offsetY.Evaluate(time);
+    return XMMatrixRotationZ(animation.rotationZ.Evaluate(time)) * XMMatrixTranslation(x, y, animation.basePosition.z);
+}
+
+AnimationDriftError MeasureAnimationDrift(UINT objectCount, UINT frameCount, double frameTime)
+{
+    std::mt19937 random(45);
+    std::uniform_real_distribution<float> rate(0.5f, 3.0f);
+
+    AnimationDriftError error = {};
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        const float spinRate = rate(random);
+        const AnimationCurve spin = AnimationCurve::Rotation(0.0f, spinRate);
+
+        // What the sample used to do: keep the last frame's matrix and turn it on.
+        const XMMATRIX step = XMMatrixRotationZ(static_cast<float>(spinRate * frameTime));
+        XMMATRIX stepped = XMMatrixIdentity();
+        for (UINT frame = 0; frame < frameCount; frame++)
+        {
+            stepped = stepped * step;
+        }
+        const double time = frameCount * frameTime;
+        const XMMATRIX evaluated = XMMatrixRotationZ(spin.Evaluate(time));
+
+        const double angle = static_cast<double>(spinRate) * time;
+        const double sine = sin(angle);
+        const double cosine = cos(angle);
+        auto rotationError = [&](const XMMATRIX& rotation)
+        {
+            XMFLOAT4X4 m;
+            XMStoreFloat4x4(&m, rotation);
+            return static_cast<float>(max(max(fabs(m._11 - cosine), fabs(m._12 - sine)), max(fabs(m._21 + sine), fabs(m._22 - cosine))));
+        };
+        error.steppedError = max(error.steppedError, rotationError(stepped));
+        error.evaluatedError = max(error.evaluatedError, rotationError(evaluated));
+    }
+
+    // The wrapped angle, below 2 pi, rounds to float within 2^-22, and XMScalarSinCos is
+    // accurate to about as much again.
+    error.tolerance = 1e-6f;
+    return error;
+}
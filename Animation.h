@@ -0,0 +1,77 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+using namespace DirectX;
+
+// Animation evaluated from a base pose and a time, rather than stepped on from the
+// previous frame's result: any time can be evaluated on its own, on any thread and in
+// any order, frames can be skipped, and nothing accumulates rounding error. Times are
+// seconds in double precision, so hours in, a time still resolves well under a
+// microsecond.
+
+struct AnimationKey
+{
+    float time;
+    float value;
+};
+
+// One animated value.
+class AnimationCurve
+{
+public:
+    AnimationCurve();                   // Constant zero.
+
+    static AnimationCurve Constant(float value);
+
+    // value + rate * time.
+    static AnimationCurve Linear(float value, float rate);
+
+    // An angle in radians turning at rate, wrapped into [0, 2 pi). The wrap is taken in
+    // double precision, against a double 2 pi, before the angle is rounded to float.
+    static AnimationCurve Rotation(float angle, float rate);
+
+    // Linear between keys, which must be sorted by time. Before the first key and after
+    // the last the curve holds their values, unless it loops over the keys' time span.
+    static AnimationCurve Keyframes(const AnimationKey* pKeys, UINT keyCount, bool loop);
+
+    float Evaluate(double time) const;
+
+private:
+    enum CurveType
+    {
+        CurveTypeConstant = 0,
+        CurveTypeLinear,
+        CurveTypeRotation,
+        CurveTypeKeyframes
+    };
+
+    CurveType m_type;
+    float m_value;
+    float m_rate;
+    bool m_loop;
+    std::vector<AnimationKey> m_keys;
+};
+
+// An object's pose: turned about z at its base position, which the offsets move.
+struct ObjectAnimation
+{
+    XMFLOAT3 basePosition;
+    AnimationCurve rotationZ;           // Radians.
+    AnimationCurve offsetX;
+    AnimationCurve offsetY;
+};
+
+// The object's world matrix at time.
+XMMATRIX EvaluateObjectAnimation(const ObjectAnimation& animation, double time);
+
+struct AnimationDriftError
+{
+    float steppedError;             // Largest rotation matrix element error from multiplying in a step every frame.
+    float evaluatedError;           // From evaluating the rotation curve at the same time.
+    float tolerance;                // What evaluating in float precision allows.
+};
+
+// Spins objectCount objects at random rates for frameCount frames of frameTime seconds,
+// both ways, and compares the final rotations with ones computed in double precision.
+AnimationDriftError MeasureAnimationDrift(UINT objectCount, UINT frameCount, double frameTime);
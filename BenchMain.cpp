@@ -0,0 +1,933 @@
+// Entry point of the D3D12MiniProjectBench console target: runs one scenario file
+// headlessly, prints the JSON results and compares them with a stored baseline.
+//
+//   D3D12MiniProjectBench <scenario file> [-out <results.json>] [-baseline <baseline.json>] [-updatebaseline]
+//
+// The baseline defaults to the scenario file with a .baseline.json extension.
+// -updatebaseline stores this run's results there instead of comparing. Exits with 0
+// when nothing regressed, 1 on a regression and 2 on an error.
+//
+//   D3D12MiniProjectBench -replay <capture file> [-passes <n>] [-out <results.json>]
+//
+// Replays a capture saved with 'K' in the sample into command lists that only write
+// their arguments, and compares the replay's time with the captured frames'. Exits
+// with 2 if the capture can't be read.
+//
+//   D3D12MiniProjectBench -allocators [-threads <n>] [-frames <n>] [-out <results.json>]
+//
+// Compares per-thread frame arenas with the CRT heap for scratch lists built on every
+// core at once. -threads defaults to the processor count.
+//
+//   D3D12MiniProjectBench -hierarchy [-nodes <n>] [-threads <n>] [-frames <n>] [-out <results.json>]
+//
+// Times TransformHierarchy's level-order update of -nodes transforms (a million by
+// default) at depths from 2 to 32 levels, with every node and with a few subtrees
+// dirty, against a recursive walk of a pointer tree. Exits with 2 if the two disagree.
+//
+//   D3D12MiniProjectBench -animation [-objects <n>] [-threads <n>] [-frames <n>] [-out <results.json>]
+//
+// Times evaluating -objects animations (100000 by default) from time, on one thread and
+// on every thread, and measures rotation drift over an hour. Exits with 2 if a frame
+// evaluated out of order differs or the evaluated rotation drifts.
+//
+//   D3D12MiniProjectBench -simulation [-objects <n>] [-frames <n>] [-out <results.json>]
+//
+// Steps -objects bodies at a fixed rate for -frames frames' worth of 60 Hz time, driven
+// by renderers at several frame rates and on a thread of its own. Exits with 2 unless
+// every run ends in the same state.
+//
+//   D3D12MiniProjectBench -mesh [<.obj or .glb file>] [-threads <n>] [-passes <n>] [-out <results.json>]
+//
+// Imports the mesh -passes times on one thread and on -threads, reporting MB/s, then
+// the vertex cache miss ratios (ACMR, ATVR) and overfetch after each MeshOptimizer
+// pass. Without a file, a million-triangle sphere with normals is generated as OBJ
+// text. Exits with 2 if the import fails, the thread counts disagree or the passes
+// lose a triangle.
+//
+//   D3D12MiniProjectBench -meshlets [<.obj or .glb file>] [-threads <n>] [-passes <n>] [-out <results.json>]
+//
+// Builds meshlets from the optimised mesh -passes times on one thread and on -threads,
+// then culls them for 256 object views on one thread and on -threads, reporting
+// millions of triangles and meshlets a second. Exits with 2 if the thread counts
+// disagree, the meshlets don't cover the mesh or a culled meshlet could be seen.
+//
+//   D3D12MiniProjectBench -lods [<.obj or .glb file>] [-objects <n>] [-frames <n>] [-passes <n>] [-out <results.json>]
+//
+// Builds the optimised mesh's LODs -passes times, then picks LODs for -objects objects
+// drifting to and from a perspective camera over -frames frames, reporting the
+// triangles saved and how often objects switch with and without hysteresis. Without a
+// file, a quarter-million-triangle sphere is generated. Exits with 2 if a LOD isn't
+// smaller than the one before or a pick isn't one the object's size allows.
+//
+//   D3D12MiniProjectBench -quantize [<.obj or .glb file>] [-threads <n>] [-passes <n>] [-out <results.json>]
+//
+// Rebuilds the optimised mesh's normals, unless the file has them, and quantises its
+// vertices -passes times on one thread and on -threads, reporting millions of vertices
+// a second, the vertex memory against float vertices and the largest error in each
+// attribute. Without a file, a million-triangle sphere without normals is generated. Exits with 2 if the thread counts disagree or
+// an attribute moved further than its quantisation step allows.
+//
+//   D3D12MiniProjectBench -ring [-frames <n>] [-out <results.json>]
+//
+// Times RingAllocator through -frames frames of upload-sized allocations with the
+// sample's frames in flight, reporting allocations a second, stalls and wraparounds.
+// Exits with 2 if an allocation is misaligned or outside the ring.
+//
+//   D3D12MiniProjectBench -buddy [-frames <n>] [-out <results.json>]
+//
+// Churns BuddyAllocator for -frames rounds as HeapSuballocator's heap blocks are,
+// reporting nanoseconds per allocation and free and how fragmented the free space
+// gets. PortableTestMain.cpp runs the same benchmark on other platforms. Exits with 2
+// if live blocks overlapped.
+//
+//   D3D12MiniProjectBench -rendergraph [-passes <n>] [-frames <n>] [-out <results.json>]
+//
+// Resets, declares and compiles a synthetic RenderGraph of -passes passes (64 by
+// default) every frame without a device, reporting the frame and Compile times, the
+// culled passes, the barriers and batches it built and the transient heap size against
+// the unaliased size. Exits with 2 if frames compiled differently or aliasing took
+// more memory than it saved.
+//
+//   D3D12MiniProjectBench -binding [-out <results.json>]
+//
+// Times recording a draw in every draw binding strategy and writing a million objects'
+// transforms in every instance data format, and measures how far half-precision
+// instance data moves vertices. Exits with 2 if that is beyond half precision's
+// tolerance.
+//
+//   D3D12MiniProjectBench -pacing [-out <results.json>]
+//
+// Simulates the frame pacer against a 60 Hz display, unpaced and paced at every frame
+// latency and then on a variable refresh display, for a light and a heavy frame.
+// Exits with 2 if pacing doesn't lower the average latency or slows the frame rate by
+// more than 5%.
+//
+//   D3D12MiniProjectBench -shaders [<asset directory>] [-passes <n>] [-out <results.json>]
+//
+// Loads every shader the sample uses through ShaderCache -passes times, compiling them
+// into an empty cache file and then reading them back from it, and reports the startup
+// time the cache saves. The directory defaults to the executable's, as the sample's
+// assets do. Exits with 2 if a shader doesn't compile or the cached load compiled
+// anything or returned different bytecode.
+//
+//   D3D12MiniProjectBench -tests
+//
+// Runs the checks in PortableTests.cpp and HeadlessTests.cpp and prints a line for
+// each. Exits with 2 if any failed. CullAndCompactCS is checked against
+// CullAndCompactObjects on WARP, with ObjectTransforms.hlsl from the executable's
+// directory.
+
+#include "stdafx.h"
+#include "Benchmark.h"
+#include "BuddyBenchmark.h"
+#include "CommandCapture.h"
+#include "HeadlessTests.h"
+#include "PortableTests.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    const int ExitPassed = 0;
+    const int ExitRegressed = 1;
+    const int ExitFailed = 2;
+
+    bool ReadTextFile(const std::wstring& path, std::string* pText)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        std::ostringstream text;
+        text << file.rdbuf();
+        *pText = text.str();
+        return true;
+    }
+
+    bool WriteTextFile(const std::wstring& path, const std::string& text)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+        return static_cast<bool>(file);
+    }
+
+    int RunAllocatorComparison(UINT threadCount, UINT frameCount, const std::wstring& outputPath)
+    {
+        if (threadCount == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threadCount = systemInfo.dwNumberOfProcessors;
+        }
+
+        const AllocatorBenchmarkResult result = RunAllocatorBenchmark(threadCount, frameCount);
+        const std::string json = WriteAllocatorBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.checksumsMatch)
+        {
+            fwprintf(stderr, L"The heap and arena runs built different lists\n");
+            return ExitFailed;
+        }
+        fwprintf(stderr, L"Arenas on %u threads: %.3f ms median frame against %.3f ms from the heap (%.1fx)\n",
+            threadCount, result.arena.p50, result.heap.p50, result.arena.p50 > 0.0 ? result.heap.p50 / result.arena.p50 : 0.0);
+        return ExitPassed;
+    }
+
+    int RunHierarchyComparison(UINT nodeCount, UINT threadCount, UINT frameCount, const std::wstring& outputPath)
+    {
+        if (threadCount == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threadCount = systemInfo.dwNumberOfProcessors;
+        }
+
+        const HierarchyBenchmarkResult result = RunHierarchyBenchmark(nodeCount, threadCount, frameCount);
+        const std::string json = WriteHierarchyBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        bool matches = true;
+        for (const HierarchyBenchmarkDepth& depth : result.depths)
+        {
+            fwprintf(stderr, L"%2u levels on %u threads: %.3f ms median update (%.3f ms for %.0f dirty nodes) against %.3f ms for the pointer tree\n",
+                depth.levelCount, threadCount, depth.full.p50, depth.partial.p50, depth.averagePartialUpdatedCount, depth.pointerTree.p50);
+            matches = matches && depth.worldTransformsMatch;
+        }
+        if (!matches)
+        {
+            fwprintf(stderr, L"The hierarchy and the pointer tree computed different world transforms\n");
+            return ExitFailed;
+        }
+        return ExitPassed;
+    }
+
+    int RunAnimationComparison(UINT objectCount, UINT threadCount, UINT frameCount, const std::wstring& outputPath)
+    {
+        if (threadCount == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threadCount = systemInfo.dwNumberOfProcessors;
+        }
+
+        const AnimationBenchmarkResult result = RunAnimationBenchmark(objectCount, threadCount, frameCount);
+        const std::string json = WriteAnimationBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.framesIndependent)
+        {
+            fwprintf(stderr, L"Frames evaluated out of order came out differently\n");
+            return ExitFailed;
+        }
+        if (result.drift.evaluatedError > result.drift.tolerance)
+        {
+            fwprintf(stderr, L"Evaluated rotation off by %g after %u frames (tolerance %g)\n", result.drift.evaluatedError, result.driftFrameCount, result.drift.tolerance);
+            return ExitFailed;
+        }
+        fwprintf(stderr, L"%u animations: %.3f ms median frame on one thread, %.3f ms on %u; drift after %u frames %g evaluated, %g stepped\n",
+            objectCount, result.singleThread.p50, result.allThreads.p50, threadCount, result.driftFrameCount, result.drift.evaluatedError, result.drift.steppedError);
+        return ExitPassed;
+    }
+
+    int RunSimulationComparison(UINT bodyCount, UINT frameCount, const std::wstring& outputPath)
+    {
+        const SimulationBenchmarkResult result = RunSimulationBenchmark(bodyCount, frameCount);
+        const std::string json = WriteSimulationBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        for (const SimulationBenchmarkRun& run : result.runs)
+        {
+            fwprintf(stderr, L"%-8S %5u frames, %llu steps: %.4f ms per step, %.4f ms median interpolation\n",
+                run.name.c_str(), run.frameCount, run.stepCount, run.millisecondsPerStep, run.interpolate.p50);
+        }
+        if (!result.deterministic || !result.threadedMatches)
+        {
+            fwprintf(stderr, L"The simulation ended in different states%s\n", result.deterministic ? L" when stepped on its own thread" : L" at different render rates");
+            return ExitFailed;
+        }
+        return ExitPassed;
+    }
+
+    int RunMeshComparison(const std::wstring& meshPath, UINT threadCount, UINT passCount, const std::wstring& outputPath)
+    {
+        if (threadCount == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threadCount = systemInfo.dwNumberOfProcessors;
+        }
+
+        const MeshBenchmarkResult result = RunMeshBenchmark(meshPath, threadCount, passCount);
+        if (!result.error.empty())
+        {
+            fwprintf(stderr, L"%S: %S\n", result.source.c_str(), result.error.c_str());
+            return ExitFailed;
+        }
+        const std::string json = WriteMeshBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.importsMatch || !result.trianglesPreserved)
+        {
+            fwprintf(stderr, L"%s\n", result.importsMatch ? L"The optimised mesh draws different triangles" : L"Importing on more threads built a different mesh");
+            return ExitFailed;
+        }
+
+        auto megabytesPerSecond = [&result](const BenchmarkTimes& times)
+        {
+            return times.p50 > 0.0 ? result.sizeInBytes / 1e6 / (times.p50 / 1000.0) : 0.0;
+        };
+        const MeshBenchmarkStage& imported = result.stages.front();
+        const MeshBenchmarkStage& optimized = result.stages.back();
+        fwprintf(stderr, L"%u triangles: imported at %.1f MB/s on one thread, %.1f MB/s on %u; ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overfetch %.2f -> %.2f; %u-bit indices\n",
+            result.triangleCount, megabytesPerSecond(result.singleThread), megabytesPerSecond(result.allThreads), threadCount,
+            imported.cache.acmr, optimized.cache.acmr, imported.cache.atvr, optimized.cache.atvr, imported.fetch.overfetch, optimized.fetch.overfetch,
+            result.indexFormat == DXGI_FORMAT_R16_UINT ? 16 : 32);
+        return ExitPassed;
+    }
+
+    int RunMeshletComparison(const std::wstring& meshPath, UINT threadCount, UINT passCount, const std::wstring& outputPath)
+    {
+        if (threadCount == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threadCount = systemInfo.dwNumberOfProcessors;
+        }
+
+        const MeshletBenchmarkResult result = RunMeshletBenchmark(meshPath, threadCount, passCount);
+        if (!result.error.empty())
+        {
+            fwprintf(stderr, L"%S: %S\n", result.source.c_str(), result.error.c_str());
+            return ExitFailed;
+        }
+        const std::string json = WriteMeshletBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.buildsMatch || !result.meshletsValid || !result.cullingConservative)
+        {
+            fwprintf(stderr, L"%s\n", !result.buildsMatch ? L"Building on more threads gave different meshlets" :
+                !result.meshletsValid ? L"The meshlets don't draw the mesh's triangles" : L"A culled meshlet was in view and facing it");
+            return ExitFailed;
+        }
+
+        auto millionsPerSecond = [](double count, const BenchmarkTimes& times)
+        {
+            return times.p50 > 0.0 ? count / 1e6 / (times.p50 / 1000.0) : 0.0;
+        };
+        const double culledMeshlets = static_cast<double>(result.meshletCount) * result.viewCount;
+        fwprintf(stderr, L"%u triangles in %u meshlets (%.1f vertices, %.1f triangles each): built at %.1f M triangles/s on one thread, %.1f on %u; culled at %.1f M meshlets/s on one thread, %.1f on %u, keeping %.1f%% of the triangles\n",
+            result.triangleCount, result.meshletCount, result.averageMeshletVertices, result.averageMeshletTriangles,
+            millionsPerSecond(result.triangleCount, result.buildSingleThread), millionsPerSecond(result.triangleCount, result.buildAllThreads), threadCount,
+            millionsPerSecond(culledMeshlets, result.cullSingleThread), millionsPerSecond(culledMeshlets, result.cullAllThreads), threadCount,
+            100.0 * result.visibleTriangleFraction);
+        return ExitPassed;
+    }
+
+    int RunLodComparison(const std::wstring& meshPath, UINT threadCount, UINT objectCount, UINT frameCount, UINT passCount, const std::wstring& outputPath)
+    {
+        if (threadCount == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threadCount = systemInfo.dwNumberOfProcessors;
+        }
+
+        const LodBenchmarkResult result = RunLodBenchmark(meshPath, threadCount, objectCount, frameCount, passCount);
+        if (!result.error.empty())
+        {
+            fwprintf(stderr, L"%S: %S\n", result.source.c_str(), result.error.c_str());
+            return ExitFailed;
+        }
+        const std::string json = WriteLodBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.lodsValid || !result.selectionInBand)
+        {
+            fwprintf(stderr, L"%s\n", !result.lodsValid ? L"A LOD isn't a smaller mesh within the error budget" : L"An object was given a LOD its size doesn't allow");
+            return ExitFailed;
+        }
+
+        const double simplifySeconds = result.simplify.p50 / 1000.0;
+        fwprintf(stderr, L"%u triangles in %zu LODs, down to %u: simplified at %.2f M triangles/s; %u objects drew %.1f%% of the full-detail triangles, picked in %.3f ms a frame, %.1f switching a frame (%.1f without hysteresis)\n",
+            result.triangleCount, result.levels.size(), result.levels.back().triangleCount, simplifySeconds > 0.0 ? result.triangleCount / 1e6 / simplifySeconds : 0.0,
+            result.objectCount, 100.0 * result.drawnTriangleFraction, result.select.p50, result.switchesPerFrame, result.switchesPerFrameWithoutHysteresis);
+        return ExitPassed;
+    }
+
+    int RunQuantizationComparison(const std::wstring& meshPath, UINT threadCount, UINT passCount, const std::wstring& outputPath)
+    {
+        if (threadCount == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threadCount = systemInfo.dwNumberOfProcessors;
+        }
+
+        const QuantizationBenchmarkResult result = RunQuantizationBenchmark(meshPath, threadCount, passCount);
+        if (!result.error.empty())
+        {
+            fwprintf(stderr, L"%S: %S\n", result.source.c_str(), result.error.c_str());
+            return ExitFailed;
+        }
+        const std::string json = WriteQuantizationBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.quantizationsMatch || !result.errorWithinStep)
+        {
+            fwprintf(stderr, L"%s\n", result.quantizationsMatch ? L"An attribute moved further than its quantisation step" : L"Quantising on more threads gave different vertices");
+            return ExitFailed;
+        }
+
+        auto millionsPerSecond = [](double count, const BenchmarkTimes& times)
+        {
+            return times.p50 > 0.0 ? count / 1e6 / (times.p50 / 1000.0) : 0.0;
+        };
+        fwprintf(stderr, L"%u vertices: %.1f MB quantised from %.1f MB of floats (%s normals), at %.1f M vertices/s on one thread, %.1f on %u; largest errors %.2g of the radius, %.2g in texture coordinates, %.4f degrees of normal\n",
+            result.vertexCount, result.quantizedBytes / 1e6, result.floatBytes / 1e6, result.importedNormals ? L"imported" : L"rebuilt",
+            millionsPerSecond(result.vertexCount, result.singleThread), millionsPerSecond(result.vertexCount, result.allThreads), threadCount,
+            result.quantizationError.position, result.quantizationError.uv, result.quantizationError.normalDegrees);
+        return ExitPassed;
+    }
+
+    int RunRingComparison(UINT frameCount, const std::wstring& outputPath)
+    {
+        const RingBenchmarkResult result = RunRingBenchmark(frameCount);
+        const std::string json = WriteRingBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.offsetsValid)
+        {
+            fwprintf(stderr, L"The ring handed out a misaligned or out of range allocation\n");
+            return ExitFailed;
+        }
+        fwprintf(stderr, L"%u allocations a frame: %.3f ms median frame, %.1f M allocations/s; %u stalls and %u wraparounds in %u frames, %.0f%% used on average\n",
+            result.allocationsPerFrame, result.frame.p50, result.allocationsPerSecond / 1e6, result.stallCount, result.wrapCount, result.frameCount,
+            100.0 * result.averageUsedFraction);
+        return ExitPassed;
+    }
+
+    int RunBuddyComparison(UINT roundCount, const std::wstring& outputPath)
+    {
+        const BuddyBenchmarkResult result = RunBuddyBenchmark(roundCount);
+        const std::string json = WriteBuddyBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.consistent)
+        {
+            fwprintf(stderr, L"The buddy allocator's live blocks overlapped or didn't add up to its used size\n");
+            return ExitFailed;
+        }
+        fwprintf(stderr, L"%.0f ns per allocation, %.0f ns per free; %.0f%% occupied, %.0f%% of it rounding, fragmentation %.2f on average and %.2f at worst, %llu failures with enough space free\n",
+            result.allocateNanoseconds, result.freeNanoseconds, 100.0 * result.averageOccupancy, 100.0 * result.internalWaste,
+            result.averageFragmentation, result.maxFragmentation, result.fragmentationFailureCount);
+        return ExitPassed;
+    }
+
+    int RunRenderGraphComparison(UINT passCount, UINT frameCount, const std::wstring& outputPath)
+    {
+        const RenderGraphBenchmarkResult result = RunRenderGraphBenchmark(passCount, frameCount);
+        const std::string json = WriteRenderGraphBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.consistent)
+        {
+            fwprintf(stderr, L"The same graph compiled differently from one frame to the next, or aliasing took more memory than it saved\n");
+            return ExitFailed;
+        }
+        const RenderGraph::Statistics& statistics = result.statistics;
+        fwprintf(stderr, L"%u passes, %u culled: %.3f ms median frame, %.3f ms of it in Compile; %u barriers in %u batches, %u split and %u aliasing; %.1f MB of transient heaps against %.1f MB unaliased\n",
+            result.passCount, statistics.culledPassCount, result.frame.p50, result.compile.p50, statistics.barrierCount, statistics.barrierBatchCount,
+            statistics.splitBarrierCount, statistics.aliasingBarrierCount, statistics.transientHeapSize / 1e6, statistics.transientUnaliasedSize / 1e6);
+        return ExitPassed;
+    }
+
+    int RunBindingComparison(const std::wstring& outputPath)
+    {
+        const BindingBenchmarkResult result = RunBindingBenchmark(ConstBufferNum, 1000000);
+        const std::string json = WriteBindingBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        for (UINT i = 0; i < DrawBindingStrategyCount; i++)
+        {
+            fwprintf(stderr, L"%-16S %7.2f ns/draw %5.1f bytes/draw (%u draws)\n", GetDrawBindingStrategyName(static_cast<DrawBindingStrategy>(i)),
+                result.strategies[i].nanosecondsPerDraw, result.strategies[i].bytesPerDraw, result.drawCount);
+        }
+        for (UINT i = 0; i < InstanceDataFormatCount; i++)
+        {
+            const InstanceUploadCost& cost = result.formats[i];
+            fwprintf(stderr, L"%-16S %3u bytes/object (%2u written) %7.2f ms %6.2f GB/s (%u objects)\n", GetInstanceDataFormatName(static_cast<InstanceDataFormat>(i)),
+                cost.bytesPerObject, cost.bytesWrittenPerObject, cost.milliseconds, cost.gigabytesPerSecond, result.instanceCount);
+        }
+        if (result.halfError.maxError > result.halfError.tolerance)
+        {
+            fwprintf(stderr, L"Half instance data moved a vertex by %g, beyond the tolerance of %g\n", result.halfError.maxError, result.halfError.tolerance);
+            return ExitFailed;
+        }
+        fwprintf(stderr, L"Half instance data: max error %g, mean error %g, tolerance %g\n", result.halfError.maxError, result.halfError.meanError, result.halfError.tolerance);
+        return ExitPassed;
+    }
+
+    int RunPacingComparison(const std::wstring& outputPath)
+    {
+        const PacingBenchmarkResult result = RunPacingBenchmark(2000);
+        const std::string json = WritePacingBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        for (const PacingBenchmarkRun& run : result.runs)
+        {
+            fwprintf(stderr, L"%-8s latency %u cpu %4.1f gpu %4.1f ms: %6.2f ms average %6.2f ms max latency, %6.2f ms/frame, %4u missed\n",
+                run.scenario.variableRefresh ? L"VRR" : (run.scenario.pacingEnabled ? L"paced" : L"unpaced"), run.scenario.maxFrameLatency, run.scenario.cpuTime, run.scenario.gpuTime,
+                run.result.averageLatency, run.result.maxLatency, run.result.averageFrameInterval, run.result.missedFrameCount);
+        }
+        if (!result.latencyReduced || !result.frameRateKept)
+        {
+            fwprintf(stderr, L"%s\n", result.latencyReduced ? L"Pacing slowed the frame rate" : L"Pacing didn't lower the average latency");
+            return ExitFailed;
+        }
+        return ExitPassed;
+    }
+
+    int RunShaderCacheComparison(std::wstring assetDirectory, UINT passCount, const std::wstring& outputPath)
+    {
+        if (assetDirectory.empty())
+        {
+            WCHAR modulePath[MAX_PATH];
+            const DWORD length = GetModuleFileName(nullptr, modulePath, MAX_PATH);
+            assetDirectory.assign(modulePath, length);
+            assetDirectory.erase(assetDirectory.find_last_of(L"\\/") + 1);
+        }
+        else if (assetDirectory.back() != L'\\' && assetDirectory.back() != L'/')
+        {
+            assetDirectory += L'\\';
+        }
+
+        const ShaderCacheBenchmarkResult result = RunShaderCacheBenchmark(assetDirectory, passCount);
+        if (!result.error.empty())
+        {
+            fwprintf(stderr, L"%s: %S\n", assetDirectory.c_str(), result.error.c_str());
+            return ExitFailed;
+        }
+        const std::string json = WriteShaderCacheBenchmarkJson(result);
+        printf("%s", json.c_str());
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+        if (!result.allCached || !result.bytecodeMatches)
+        {
+            fwprintf(stderr, L"%s\n", result.allCached ? L"The cache returned different bytecode" : L"Loading from the cache file compiled shaders again");
+            return ExitFailed;
+        }
+        fwprintf(stderr, L"%u shaders: %.2f ms compiled, %.2f ms from a %llu-byte cache file, %.2f ms saved at startup\n",
+            result.programCount, result.compiled.p50, result.cached.p50, result.cacheFileSize, result.compiled.p50 - result.cached.p50);
+        return ExitPassed;
+    }
+
+    int RunTests()
+    {
+        std::vector<HeadlessTest> tests;
+        GetPortableTests(&tests);
+        GetHeadlessTests(&tests);
+        return RunHeadlessTests(tests) == 0 ? ExitPassed : ExitFailed;
+    }
+
+    int RunReplay(const std::wstring& capturePath, UINT passCount, const std::wstring& outputPath)
+    {
+        CaptureFile file;
+        std::string error;
+        if (!file.Open(capturePath, &error))
+        {
+            fwprintf(stderr, L"%s: %S\n", capturePath.c_str(), error.c_str());
+            return ExitFailed;
+        }
+
+        const CaptureReplayResult result = ReplayCaptureHeadless(file, passCount);
+        const std::string json = WriteCaptureReplayJson(capturePath, result);
+        printf("%s", json.c_str());
+        if (!result.valid)
+        {
+            fwprintf(stderr, L"%s: malformed command stream\n", capturePath.c_str());
+            return ExitFailed;
+        }
+        if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+            return ExitFailed;
+        }
+
+        // The captured frames include recording into the driver and waiting on the GPU,
+        // so the replay should be an order of magnitude faster; if it isn't, decoding
+        // has become the bottleneck.
+        const double speedup = result.replayFrameMilliseconds > 0.0 ? result.capturedFrameMilliseconds / result.replayFrameMilliseconds : 0.0;
+        fwprintf(stderr, L"Replayed %u frames %.1fx faster than captured%s\n", result.frameCount, speedup, speedup < 10.0 ? L" (expected 10x or more)" : L"");
+        return ExitPassed;
+    }
+
+    std::wstring GetDefaultBaselinePath(const std::wstring& scenarioPath)
+    {
+        const size_t extension = scenarioPath.find_last_of(L'.');
+        const size_t directory = scenarioPath.find_last_of(L"\\/");
+        const bool hasExtension = extension != std::wstring::npos && (directory == std::wstring::npos || extension > directory);
+        return (hasExtension ? scenarioPath.substr(0, extension) : scenarioPath) + L".baseline.json";
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    std::wstring scenarioPath;
+    std::wstring outputPath;
+    std::wstring baselinePath;
+    std::wstring capturePath;
+    UINT passCount = 10;
+    UINT graphPassCount = 64;
+    bool compareAllocators = false;
+    bool compareHierarchies = false;
+    UINT nodeCount = 1000000;
+    bool compareAnimations = false;
+    UINT objectCount = 100000;
+    bool compareSimulations = false;
+    bool compareMeshes = false;
+    bool compareMeshlets = false;
+    bool compareLods = false;
+    bool compareQuantization = false;
+    bool compareRing = false;
+    bool compareBuddy = false;
+    bool compareRenderGraph = false;
+    bool compareBinding = false;
+    bool comparePacing = false;
+    bool compareShaderCache = false;
+    std::wstring assetDirectory;
+    bool runTests = false;
+    std::wstring meshPath;
+    UINT threadCount = 0;
+    UINT frameCount = 500;
+    bool updateBaseline = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (_wcsicmp(argv[i], L"-out") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (_wcsicmp(argv[i], L"-baseline") == 0 && i + 1 < argc)
+        {
+            baselinePath = argv[++i];
+        }
+        else if (_wcsicmp(argv[i], L"-replay") == 0 && i + 1 < argc)
+        {
+            capturePath = argv[++i];
+        }
+        else if (_wcsicmp(argv[i], L"-passes") == 0 && i + 1 < argc)
+        {
+            passCount = static_cast<UINT>(max(1, _wtoi(argv[++i])));
+            graphPassCount = passCount;
+        }
+        else if (_wcsicmp(argv[i], L"-allocators") == 0)
+        {
+            compareAllocators = true;
+        }
+        else if (_wcsicmp(argv[i], L"-hierarchy") == 0)
+        {
+            compareHierarchies = true;
+        }
+        else if (_wcsicmp(argv[i], L"-nodes") == 0 && i + 1 < argc)
+        {
+            nodeCount = static_cast<UINT>(max(1000, _wtoi(argv[++i])));
+        }
+        else if (_wcsicmp(argv[i], L"-animation") == 0)
+        {
+            compareAnimations = true;
+        }
+        else if (_wcsicmp(argv[i], L"-simulation") == 0)
+        {
+            compareSimulations = true;
+        }
+        else if (_wcsicmp(argv[i], L"-mesh") == 0)
+        {
+            compareMeshes = true;
+            if (i + 1 < argc && argv[i + 1][0] != L'-')
+            {
+                meshPath = argv[++i];
+            }
+        }
+        else if (_wcsicmp(argv[i], L"-meshlets") == 0)
+        {
+            compareMeshlets = true;
+            if (i + 1 < argc && argv[i + 1][0] != L'-')
+            {
+                meshPath = argv[++i];
+            }
+        }
+        else if (_wcsicmp(argv[i], L"-lods") == 0)
+        {
+            compareLods = true;
+            if (i + 1 < argc && argv[i + 1][0] != L'-')
+            {
+                meshPath = argv[++i];
+            }
+        }
+        else if (_wcsicmp(argv[i], L"-quantize") == 0)
+        {
+            compareQuantization = true;
+            if (i + 1 < argc && argv[i + 1][0] != L'-')
+            {
+                meshPath = argv[++i];
+            }
+        }
+        else if (_wcsicmp(argv[i], L"-ring") == 0)
+        {
+            compareRing = true;
+        }
+        else if (_wcsicmp(argv[i], L"-buddy") == 0)
+        {
+            compareBuddy = true;
+        }
+        else if (_wcsicmp(argv[i], L"-rendergraph") == 0)
+        {
+            compareRenderGraph = true;
+        }
+        else if (_wcsicmp(argv[i], L"-binding") == 0)
+        {
+            compareBinding = true;
+        }
+        else if (_wcsicmp(argv[i], L"-pacing") == 0)
+        {
+            comparePacing = true;
+        }
+        else if (_wcsicmp(argv[i], L"-shaders") == 0)
+        {
+            compareShaderCache = true;
+            if (i + 1 < argc && argv[i + 1][0] != L'-')
+            {
+                assetDirectory = argv[++i];
+            }
+        }
+        else if (_wcsicmp(argv[i], L"-tests") == 0)
+        {
+            runTests = true;
+        }
+        else if (_wcsicmp(argv[i], L"-objects") == 0 && i + 1 < argc)
+        {
+            objectCount = static_cast<UINT>(max(1, _wtoi(argv[++i])));
+        }
+        else if (_wcsicmp(argv[i], L"-threads") == 0 && i + 1 < argc)
+        {
+            threadCount = static_cast<UINT>(max(1, _wtoi(argv[++i])));
+        }
+        else if (_wcsicmp(argv[i], L"-frames") == 0 && i + 1 < argc)
+        {
+            frameCount = static_cast<UINT>(max(1, _wtoi(argv[++i])));
+        }
+        else if (_wcsicmp(argv[i], L"-updatebaseline") == 0)
+        {
+            updateBaseline = true;
+        }
+        else if (scenarioPath.empty() && argv[i][0] != L'-')
+        {
+            scenarioPath = argv[i];
+        }
+        else
+        {
+            fwprintf(stderr, L"Unknown argument: %s\n", argv[i]);
+            return ExitFailed;
+        }
+    }
+    if (!capturePath.empty())
+    {
+        return RunReplay(capturePath, passCount, outputPath);
+    }
+    if (compareAllocators)
+    {
+        return RunAllocatorComparison(threadCount, frameCount, outputPath);
+    }
+    if (compareHierarchies)
+    {
+        return RunHierarchyComparison(nodeCount, threadCount, frameCount, outputPath);
+    }
+    if (compareAnimations)
+    {
+        return RunAnimationComparison(objectCount, threadCount, frameCount, outputPath);
+    }
+    if (compareSimulations)
+    {
+        return RunSimulationComparison(objectCount, frameCount, outputPath);
+    }
+    if (compareMeshes)
+    {
+        return RunMeshComparison(meshPath, threadCount, passCount, outputPath);
+    }
+    if (compareMeshlets)
+    {
+        return RunMeshletComparison(meshPath, threadCount, passCount, outputPath);
+    }
+    if (compareLods)
+    {
+        return RunLodComparison(meshPath, threadCount, objectCount, frameCount, passCount, outputPath);
+    }
+    if (compareQuantization)
+    {
+        return RunQuantizationComparison(meshPath, threadCount, passCount, outputPath);
+    }
+    if (compareRing)
+    {
+        return RunRingComparison(frameCount, outputPath);
+    }
+    if (compareBuddy)
+    {
+        return RunBuddyComparison(frameCount, outputPath);
+    }
+    if (compareRenderGraph)
+    {
+        return RunRenderGraphComparison(graphPassCount, frameCount, outputPath);
+    }
+    if (compareBinding)
+    {
+        return RunBindingComparison(outputPath);
+    }
+    if (comparePacing)
+    {
+        return RunPacingComparison(outputPath);
+    }
+    if (compareShaderCache)
+    {
+        return RunShaderCacheComparison(assetDirectory, passCount, outputPath);
+    }
+    if (runTests)
+    {
+        return RunTests();
+    }
+    if (scenarioPath.empty())
+    {
+        fwprintf(stderr, L"Usage: %s <scenario file> [-out <results.json>] [-baseline <baseline.json>] [-updatebaseline]\n", argv[0]);
+        fwprintf(stderr, L"       %s -replay <capture file> [-passes <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -allocators [-threads <n>] [-frames <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -hierarchy [-nodes <n>] [-threads <n>] [-frames <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -animation [-objects <n>] [-threads <n>] [-frames <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -simulation [-objects <n>] [-frames <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -mesh [<.obj or .glb file>] [-threads <n>] [-passes <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -meshlets [<.obj or .glb file>] [-threads <n>] [-passes <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -lods [<.obj or .glb file>] [-objects <n>] [-frames <n>] [-passes <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -quantize [<.obj or .glb file>] [-threads <n>] [-passes <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -ring [-frames <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -buddy [-frames <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -rendergraph [-passes <n>] [-frames <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -binding [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -pacing [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -shaders [<asset directory>] [-passes <n>] [-out <results.json>]\n", argv[0]);
+        fwprintf(stderr, L"       %s -tests\n", argv[0]);
+        return ExitFailed;
+    }
+    if (baselinePath.empty())
+    {
+        baselinePath = GetDefaultBaselinePath(scenarioPath);
+    }
+
+    BenchmarkScenario scenario;
+    std::string error;
+    if (!LoadBenchmarkScenario(scenarioPath, &scenario, &error))
+    {
+        fwprintf(stderr, L"%s: %S\n", scenarioPath.c_str(), error.c_str());
+        return ExitFailed;
+    }
+
+    const BenchmarkResult result = RunBenchmark(scenario);
+    const std::string json = WriteBenchmarkJson(scenario, result);
+    printf("%s", json.c_str());
+    if (!outputPath.empty() && !WriteTextFile(outputPath, json))
+    {
+        fwprintf(stderr, L"Can't write %s\n", outputPath.c_str());
+        return ExitFailed;
+    }
+
+    if (updateBaseline)
+    {
+        if (!WriteTextFile(baselinePath, json))
+        {
+            fwprintf(stderr, L"Can't write %s\n", baselinePath.c_str());
+            return ExitFailed;
+        }
+        fwprintf(stderr, L"Baseline stored in %s\n", baselinePath.c_str());
+        return ExitPassed;
+    }
+
+    std::string baselineJson;
+    if (!ReadTextFile(baselinePath, &baselineJson))
+    {
+        fwprintf(stderr, L"No baseline at %s; run with -updatebaseline to store one.\n", baselinePath.c_str());
+        return ExitPassed;
+    }
+
+    BenchmarkBaseline baseline;
+    std::vector<BenchmarkRegression> regressions;
+    if (!ReadBenchmarkBaseline(baselineJson, &baseline, &error) ||
+        !CompareBenchmarkBaseline(scenario, result, baseline, &regressions, &error))
+    {
+        fwprintf(stderr, L"%s: %S\n", baselinePath.c_str(), error.c_str());
+        return ExitFailed;
+    }
+
+    for (const BenchmarkRegression& regression : regressions)
+    {
+        fwprintf(stderr, L"REGRESSION %S: %.4f ms -> %.4f ms\n", regression.metric.c_str(), regression.baseline, regression.current);
+    }
+    if (regressions.empty())
+    {
+        fwprintf(stderr, L"No regressions against %s (tolerance %.0f%%)\n", baselinePath.c_str(), 100.0 * scenario.tolerance);
+    }
+    return regressions.empty() ? ExitPassed : ExitRegressed;
+}
@@ -0,0 +1,2952 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+#include "D3D12HelloTriangle.h"
+#include "FixedStepSimulation.h"
+#include "FrameArena.h"
+#include "IndirectDraw.h"
+#include "InstanceData.h"
+#include "LodSelection.h"
+#include "MeshImport.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "OcclusionCulling.h"
+#include "RenderGraph.h"
+#include "RingAllocator.h"
+#include "ShaderCache.h"
+#include "ShaderPrograms.h"
+#include "TransformHierarchy.h"
+#include "VertexQuantization.h"
+#include "VisibilityCache.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <process.h>
+#include <random>
+#include <sstream>
+
+namespace
+{
+    // Differences below this are timer noise, whatever the tolerance says.
+    const double RegressionNoiseFloor = 0.005;
+
+    // The sample's quad: 6 indices, corners at (+-0.05, +-0.05).
+    const UINT BenchmarkIndexCount = 6;
+    const float BenchmarkCullRadius = 0.0707107f;
+    const float BenchmarkHalfSize = 0.05f;
+
+    // The sample's occlusion buffer size.
+    const UINT BenchmarkOcclusionWidth = 256;
+    const UINT BenchmarkOcclusionHeight = 144;
+
+    // Overdraw is estimated at a fixed size, so results compare across machines.
+    const UINT BenchmarkOverdrawWidth = 640;
+    const UINT BenchmarkOverdrawHeight = 360;
+
+    // The sample's visibility cache cell size.
+    const float BenchmarkVisibilityCellSize = 0.25f;
+
+    std::string Trim(const std::string& text)
+    {
+        const size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos)
+        {
+            return std::string();
+        }
+        const size_t last = text.find_last_not_of(" \t\r\n");
+        return text.substr(first, last - first + 1);
+    }
+
+    bool ParseUint(const std::string& text, UINT* pValue)
+    {
+        char* pEnd = nullptr;
+        const unsigned long value = strtoul(text.c_str(), &pEnd, 10);
+        if (text.empty() || *pEnd != '\0')
+        {
+            return false;
+        }
+        *pValue = static_cast<UINT>(value);
+        return true;
+    }
+
+    bool ParseDouble(const std::string& text, double* pValue)
+    {
+        char* pEnd = nullptr;
+        *pValue = strtod(text.c_str(), &pEnd);
+        return !text.empty() && *pEnd == '\0';
+    }
+
+    std::string EscapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    std::string FormatChecksum(UINT64 checksum)
+    {
+        char text[32];
+        sprintf_s(text, "%016llx", checksum);
+        return text;
+    }
+
+    // FNV-1a.
+    UINT64 HashBytes(UINT64 hash, const void* pData, size_t size)
+    {
+        const UINT8* pBytes = static_cast<const UINT8*>(pData);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ pBytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // Nearest rank.
+    BenchmarkTimes Summarize(std::vector<double> times)
+    {
+        BenchmarkTimes summary = {};
+        if (times.empty())
+        {
+            return summary;
+        }
+        std::sort(times.begin(), times.end());
+        auto percentile = [&times](double fraction)
+        {
+            const size_t rank = static_cast<size_t>(ceil(fraction * times.size()));
+            return times[min(max(rank, static_cast<size_t>(1)), times.size()) - 1];
+        };
+        double sum = 0.0;
+        for (double time : times)
+        {
+            sum += time;
+        }
+        summary.mean = sum / times.size();
+        summary.p50 = percentile(0.5);
+        summary.p90 = percentile(0.9);
+        summary.p99 = percentile(0.99);
+        summary.max = times.back();
+        return summary;
+    }
+
+    struct BenchmarkObject
+    {
+        XMFLOAT3 start;
+        float speed;        // Radians per frame.
+        float phase;
+        bool moving;
+    };
+
+    XMFLOAT4 MoveObject(BenchmarkMotion motion, const BenchmarkObject& object, UINT frame)
+    {
+        switch (object.moving ? motion : BenchmarkMotionStatic)
+        {
+        case BenchmarkMotionOrbit:
+        {
+            const float s = sinf(object.speed * frame);
+            const float c = cosf(object.speed * frame);
+            return XMFLOAT4(object.start.x * c - object.start.y * s, object.start.x * s + object.start.y * c, object.start.z, 0.0f);
+        }
+
+        case BenchmarkMotionWander:
+        {
+            const float angle = object.speed * frame + object.phase;
+            return XMFLOAT4(object.start.x + 0.25f * sinf(angle), object.start.y + 0.25f * cosf(0.7f * angle), object.start.z + 0.5f * sinf(0.3f * angle), 0.0f);
+        }
+
+        default:
+            return XMFLOAT4(object.start.x, object.start.y, object.start.z, 0.0f);
+        }
+    }
+
+    // Persistent recording threads, woken and waited for with events like the sample's
+    // worker threads, so thread creation is not part of the measurement.
+    class BenchmarkWorkers
+    {
+    public:
+        explicit BenchmarkWorkers(UINT threadCount) :
+            m_pWork(nullptr),
+            m_exit(false)
+        {
+            m_workers.resize(threadCount);
+            for (UINT i = 0; i < threadCount; i++)
+            {
+                Worker& worker = m_workers[i];
+                worker.pWorkers = this;
+                worker.index = i;
+                worker.beginEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+                worker.finishedEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+                m_finishedEvents.push_back(worker.finishedEvent);
+            }
+            // Started once m_workers no longer reallocates.
+            for (Worker& worker : m_workers)
+            {
+                worker.thread = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, ThreadProc, &worker, 0, nullptr));
+                m_threads.push_back(worker.thread);
+            }
+        }
+
+        ~BenchmarkWorkers()
+        {
+            m_exit = true;
+            for (Worker& worker : m_workers)
+            {
+                SetEvent(worker.beginEvent);
+            }
+            WaitForMultipleObjects(static_cast<DWORD>(m_threads.size()), m_threads.data(), TRUE, INFINITE);
+            for (Worker& worker : m_workers)
+            {
+                CloseHandle(worker.thread);
+                CloseHandle(worker.beginEvent);
+                CloseHandle(worker.finishedEvent);
+            }
+        }
+
+        // Runs work(threadIndex) on every thread and waits for all of them.
+        void Run(const std::function<void(UINT)>& work)
+        {
+            m_pWork = &work;
+            for (Worker& worker : m_workers)
+            {
+                SetEvent(worker.beginEvent);
+            }
+            WaitForMultipleObjects(static_cast<DWORD>(m_finishedEvents.size()), m_finishedEvents.data(), TRUE, INFINITE);
+        }
+
+    private:
+        struct Worker
+        {
+            BenchmarkWorkers* pWorkers;
+            UINT index;
+            HANDLE beginEvent;
+            HANDLE finishedEvent;
+            HANDLE thread;
+        };
+
+        static unsigned int WINAPI ThreadProc(LPVOID pParameter)
+        {
+            Worker* pWorker = static_cast<Worker*>(pParameter);
+            for (;;)
+            {
+                WaitForSingleObject(pWorker->beginEvent, INFINITE);
+                if (pWorker->pWorkers->m_exit)
+                {
+                    return 0;
+                }
+                (*pWorker->pWorkers->m_pWork)(pWorker->index);
+                SetEvent(pWorker->finishedEvent);
+            }
+        }
+
+        std::vector<Worker> m_workers;
+        std::vector<HANDLE> m_finishedEvents;
+        std::vector<HANDLE> m_threads;
+        const std::function<void(UINT)>* m_pWork;
+        volatile bool m_exit;
+    };
+
+    // One frame of a thread's scratch work: lists of varying length, like culling
+    // results and sort keys, grown by push_back and dropped at the end of the frame.
+    template <class Allocator>
+    UINT64 BuildScratchLists(const Allocator& allocator, UINT listCount, UINT seed)
+    {
+        UINT64 sum = 0;
+        UINT random = seed;
+        for (UINT i = 0; i < listCount; i++)
+        {
+            random = random * 1664525u + 1013904223u;
+            const UINT length = 16 + (random >> 22);
+            std::vector<UINT, Allocator> list(allocator);
+            for (UINT j = 0; j < length; j++)
+            {
+                list.push_back(j ^ random);
+            }
+            sum += list[length / 2];
+        }
+        return sum;
+    }
+
+    // A forest of nodeCount nodes in levelCount levels, widening by the same factor at
+    // every level from at most HierarchyRootCount roots; each node's children are spread evenly
+    // over the level below. Returned in a shuffled order, as a scene graph's nodes
+    // would be created, with a random local transform each.
+    const UINT HierarchyRootCount = 16;
+
+    void GenerateHierarchy(UINT nodeCount, UINT levelCount, std::mt19937& random, std::vector<UINT>* pParents, std::vector<XMFLOAT4X3>* pLocalTransforms)
+    {
+        std::vector<UINT> levelSizes(levelCount, 1);
+        const double growth = (levelCount > 1) ? pow(static_cast<double>(nodeCount) / HierarchyRootCount, 1.0 / (levelCount - 1)) : 1.0;
+        double weightSum = 0.0;
+        for (UINT level = 0; level < levelCount; level++)
+        {
+            weightSum += pow(growth, static_cast<double>(level));
+        }
+        UINT assigned = 0;
+        for (UINT level = 0; level + 1 < levelCount; level++)
+        {
+            levelSizes[level] = max(1u, static_cast<UINT>(nodeCount * pow(growth, static_cast<double>(level)) / weightSum));
+            assigned += levelSizes[level];
+        }
+        levelSizes[levelCount - 1] = nodeCount - assigned;
+
+        // Shuffled indices of the nodes, numbered level by level.
+        std::vector<UINT> shuffled(nodeCount);
+        for (UINT i = 0; i < nodeCount; i++)
+        {
+            shuffled[i] = i;
+        }
+        std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+        pParents->assign(nodeCount, TransformHierarchy::NoParent);
+        UINT levelStart = 0;
+        for (UINT level = 0; level < levelCount; level++)
+        {
+            const UINT levelEnd = levelStart + levelSizes[level];
+            if (level > 0)
+            {
+                const UINT parentStart = levelStart - levelSizes[level - 1];
+                for (UINT i = levelStart; i < levelEnd; i++)
+                {
+                    const UINT parent = parentStart + static_cast<UINT>(static_cast<UINT64>(i - levelStart) * levelSizes[level - 1] / levelSizes[level]);
+                    (*pParents)[shuffled[i]] = shuffled[parent];
+                }
+            }
+            levelStart = levelEnd;
+        }
+
+        std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+        pLocalTransforms->resize(nodeCount);
+        for (UINT i = 0; i < nodeCount; i++)
+        {
+            XMStoreFloat4x3(&(*pLocalTransforms)[i], XMMatrixRotationZ(angle(random)) * XMMatrixTranslation(offset(random), offset(random), 0.0f));
+        }
+    }
+
+    // What TransformHierarchy replaces: nodes allocated one by one, in creation order,
+    // each owning a list of pointers to its children.
+    struct PointerNode
+    {
+        XMFLOAT4X3 localTransform;
+        XMFLOAT4X3 worldTransform;
+        std::vector<PointerNode*> children;
+    };
+
+    void UpdatePointerNode(PointerNode* pNode, FXMMATRIX parentWorld)
+    {
+        const XMMATRIX world = XMMatrixMultiply(XMLoadFloat4x3(&pNode->localTransform), parentWorld);
+        XMStoreFloat4x3(&pNode->worldTransform, world);
+        for (PointerNode* pChild : pNode->children)
+        {
+            UpdatePointerNode(pChild, world);
+        }
+    }
+
+    // Minimal reader for WriteBenchmarkJson's output: objects, strings and numbers.
+    class FlatJsonReader
+    {
+    public:
+        FlatJsonReader(const std::string& text, BenchmarkBaseline* pBaseline) :
+            m_text(text),
+            m_position(0),
+            m_pBaseline(pBaseline)
+        {
+        }
+
+        bool Read(std::string* pError)
+        {
+            const bool succeeded = ReadValue(std::string()) && (SkipWhitespace(), m_position == m_text.size());
+            if (!succeeded)
+            {
+                *pError = "Malformed JSON at offset " + std::to_string(m_position);
+            }
+            return succeeded;
+        }
+
+    private:
+        void SkipWhitespace()
+        {
+            while (m_position < m_text.size() && isspace(static_cast<unsigned char>(m_text[m_position])))
+            {
+                m_position++;
+            }
+        }
+
+        bool Expect(char c)
+        {
+            SkipWhitespace();
+            if (m_position < m_text.size() && m_text[m_position] == c)
+            {
+                m_position++;
+                return true;
+            }
+            return false;
+        }
+
+        bool ReadString(std::string* pValue)
+        {
+            if (!Expect('"'))
+            {
+                return false;
+            }
+            pValue->clear();
+            while (m_position < m_text.size() && m_text[m_position] != '"')
+            {
+                if (m_text[m_position] == '\\' && m_position + 1 < m_text.size())
+                {
+                    m_position++;
+                }
+                *pValue += m_text[m_position++];
+            }
+            return Expect('"');
+        }
+
+        bool ReadValue(const std::string& path)
+        {
+            SkipWhitespace();
+            if (m_position >= m_text.size())
+            {
+                return false;
+            }
+
+            const char c = m_text[m_position];
+            if (c == '{')
+            {
+                m_position++;
+                if (Expect('}'))
+                {
+                    return true;
+                }
+                do
+                {
+                    std::string key;
+                    if (!ReadString(&key) || !Expect(':') || !ReadValue(path.empty() ? key : path + "." + key))
+                    {
+                        return false;
+                    }
+                } while (Expect(','));
+                return Expect('}');
+            }
+            if (c == '"')
+            {
+                return ReadString(&m_pBaseline->strings[path]);
+            }
+
+            char* pEnd = nullptr;
+            const double value = strtod(m_text.c_str() + m_position, &pEnd);
+            if (pEnd == m_text.c_str() + m_position)
+            {
+                return false;
+            }
+            m_position = pEnd - m_text.c_str();
+            m_pBaseline->numbers[path] = value;
+            return true;
+        }
+
+        const std::string& m_text;
+        size_t m_position;
+        BenchmarkBaseline* m_pBaseline;
+    };
+
+    // A UV sphere of rings x segments quads, as OBJ text, with or without normals. The
+    // quads are shuffled, and written with absolute and relative indices alternately.
+    std::string GenerateSphereObj(UINT rings, UINT segments, bool normals)
+    {
+        std::string text;
+        char line[192];
+        for (UINT ring = 0; ring <= rings; ring++)
+        {
+            for (UINT segment = 0; segment <= segments; segment++)
+            {
+                const float theta = XM_PI * ring / rings;
+                const float phi = XM_2PI * segment / segments;
+                const XMFLOAT3 position(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+                sprintf_s(line, "v %.6f %.6f %.6f\nvt %.6f %.6f\n",
+                    position.x, position.y, position.z, static_cast<float>(segment) / segments, 1.0f - static_cast<float>(ring) / rings);
+                text += line;
+                if (normals)
+                {
+                    sprintf_s(line, "vn %.6f %.6f %.6f\n", position.x, position.y, position.z);
+                    text += line;
+                }
+            }
+        }
+
+        std::vector<UINT> quads(rings * segments);
+        for (UINT i = 0; i < rings * segments; i++)
+        {
+            quads[i] = i;
+        }
+        std::mt19937 random(47);
+        std::shuffle(quads.begin(), quads.end(), random);
+
+        const int vertexCount = static_cast<int>((rings + 1) * (segments + 1));
+        for (size_t i = 0; i < quads.size(); i++)
+        {
+            const UINT ring = quads[i] / segments;
+            const UINT segment = quads[i] % segments;
+            // Counter-clockwise seen from outside, as OBJ files are.
+            int corners[4];
+            corners[0] = static_cast<int>(ring * (segments + 1) + segment) + 1;
+            corners[1] = corners[0] + 1;
+            corners[2] = corners[1] + static_cast<int>(segments) + 1;
+            corners[3] = corners[0] + static_cast<int>(segments) + 1;
+            if (i % 2)
+            {
+                for (int& corner : corners)
+                {
+                    corner -= vertexCount + 1;
+                }
+            }
+            if (normals)
+            {
+                sprintf_s(line, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", corners[0], corners[0], corners[0], corners[1], corners[1], corners[1],
+                    corners[2], corners[2], corners[2], corners[3], corners[3], corners[3]);
+            }
+            else
+            {
+                sprintf_s(line, "f %d/%d %d/%d %d/%d %d/%d\n", corners[0], corners[0], corners[1], corners[1], corners[2], corners[2], corners[3], corners[3]);
+            }
+            text += line;
+        }
+        return text;
+    }
+
+    // Every triangle as the hashes of its three vertices, starting from the smallest so
+    // that turning it doesn't change it, in sorted order.
+    std::vector<std::array<UINT64, 3>> GetTriangleSignatures(const Mesh& mesh)
+    {
+        std::vector<UINT64> vertexHashes(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            vertexHashes[i] = HashBytes(0xcbf29ce484222325ull, &mesh.vertices[i], sizeof(MeshVertex));
+        }
+
+        std::vector<std::array<UINT64, 3>> signatures(mesh.indices.size() / 3);
+        for (size_t t = 0; t < signatures.size(); t++)
+        {
+            const UINT64 a = vertexHashes[mesh.indices[t * 3 + 0]];
+            const UINT64 b = vertexHashes[mesh.indices[t * 3 + 1]];
+            const UINT64 c = vertexHashes[mesh.indices[t * 3 + 2]];
+            signatures[t] = (a <= b && a <= c) ? std::array<UINT64, 3>{ a, b, c } :
+                (b <= c) ? std::array<UINT64, 3>{ b, c, a } : std::array<UINT64, 3>{ c, a, b };
+        }
+        std::sort(signatures.begin(), signatures.end());
+        return signatures;
+    }
+}
+
+const char* GetBenchmarkMotionName(BenchmarkMotion motion)
+{
+    switch (motion)
+    {
+    case BenchmarkMotionStatic:
+        return "static";
+    case BenchmarkMotionRotate:
+        return "rotate";
+    case BenchmarkMotionOrbit:
+        return "orbit";
+    case BenchmarkMotionWander:
+        return "wander";
+    default:
+        return "unknown";
+    }
+}
+
+const char* GetBenchmarkStageName(BenchmarkStage stage)
+{
+    switch (stage)
+    {
+    case BenchmarkStageUpdate:
+        return "update";
+    case BenchmarkStageCull:
+        return "cull";
+    case BenchmarkStageRasterize:
+        return "rasterize";
+    case BenchmarkStageOcclusionTest:
+        return "occlusion";
+    case BenchmarkStageSort:
+        return "sort";
+    case BenchmarkStageRecord:
+        return "record";
+    default:
+        return "unknown";
+    }
+}
+
+BenchmarkScenario::BenchmarkScenario() :
+    name("default"),
+    objectCount(ConstBufferNum),
+    frameCount(600),
+    warmupFrameCount(60),
+    threadCount(NumContexts),
+    motion(BenchmarkMotionRotate),
+    bindingStrategy(DrawBindingDescriptorTable),
+    cullRadius(BenchmarkCullRadius),
+    spread(1.0f),
+    seed(1),
+    tolerance(0.1),
+    occlusion(false),
+    depthMode(DepthModeTested),
+    movingFraction(1.0f),
+    visibilityCache(false),
+    cameraPan(false)
+{
+}
+
+bool LoadBenchmarkScenario(const std::wstring& path, BenchmarkScenario* pScenario, std::string* pError)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        *pError = "Can't open the scenario file";
+        return false;
+    }
+
+    BenchmarkScenario scenario;
+    std::string line;
+    UINT lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty())
+        {
+            continue;
+        }
+
+        const size_t separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            *pError = "Line " + std::to_string(lineNumber) + ": expected \"key = value\"";
+            return false;
+        }
+
+        const std::string key = Trim(line.substr(0, separator));
+        const std::string value = Trim(line.substr(separator + 1));
+        double number = 0.0;
+        bool valid = true;
+        if (key == "name")
+        {
+            scenario.name = value;
+        }
+        else if (key == "objects")
+        {
+            valid = ParseUint(value, &scenario.objectCount) && scenario.objectCount > 0;
+        }
+        else if (key == "frames")
+        {
+            valid = ParseUint(value, &scenario.frameCount) && scenario.frameCount > 0;
+        }
+        else if (key == "warmup")
+        {
+            valid = ParseUint(value, &scenario.warmupFrameCount);
+        }
+        else if (key == "threads")
+        {
+            // The workers are waited for with one WaitForMultipleObjects call.
+            valid = ParseUint(value, &scenario.threadCount) && scenario.threadCount > 0 && scenario.threadCount <= MAXIMUM_WAIT_OBJECTS;
+        }
+        else if (key == "motion")
+        {
+            valid = false;
+            for (UINT i = 0; i < BenchmarkMotionCount && !valid; i++)
+            {
+                valid = (_stricmp(value.c_str(), GetBenchmarkMotionName(static_cast<BenchmarkMotion>(i))) == 0);
+                scenario.motion = static_cast<BenchmarkMotion>(i);
+            }
+        }
+        else if (key == "binding")
+        {
+            valid = false;
+            for (UINT i = 0; i < DrawBindingStrategyCount && !valid; i++)
+            {
+                valid = (_stricmp(value.c_str(), GetDrawBindingStrategyName(static_cast<DrawBindingStrategy>(i))) == 0);
+                scenario.bindingStrategy = static_cast<DrawBindingStrategy>(i);
+            }
+        }
+        else if (key == "cull_radius")
+        {
+            valid = ParseDouble(value, &number) && number >= 0.0;
+            scenario.cullRadius = static_cast<float>(number);
+        }
+        else if (key == "spread")
+        {
+            valid = ParseDouble(value, &number) && number > 0.0;
+            scenario.spread = static_cast<float>(number);
+        }
+        else if (key == "seed")
+        {
+            valid = ParseUint(value, &scenario.seed);
+        }
+        else if (key == "tolerance")
+        {
+            valid = ParseDouble(value, &scenario.tolerance) && scenario.tolerance >= 0.0;
+        }
+        else if (key == "occlusion")
+        {
+            scenario.occlusion = (_stricmp(value.c_str(), "on") == 0);
+            valid = scenario.occlusion || _stricmp(value.c_str(), "off") == 0;
+        }
+        else if (key == "depth")
+        {
+            valid = false;
+            for (UINT i = 0; i < DepthModeCount && !valid; i++)
+            {
+                valid = (_stricmp(value.c_str(), GetDepthModeName(static_cast<DepthMode>(i))) == 0);
+                scenario.depthMode = static_cast<DepthMode>(i);
+            }
+        }
+        else if (key == "moving")
+        {
+            valid = ParseDouble(value, &number) && number >= 0.0 && number <= 1.0;
+            scenario.movingFraction = static_cast<float>(number);
+        }
+        else if (key == "visibility_cache")
+        {
+            scenario.visibilityCache = (_stricmp(value.c_str(), "on") == 0);
+            valid = scenario.visibilityCache || _stricmp(value.c_str(), "off") == 0;
+        }
+        else if (key == "camera")
+        {
+            scenario.cameraPan = (_stricmp(value.c_str(), "pan") == 0);
+            valid = scenario.cameraPan || _stricmp(value.c_str(), "static") == 0;
+        }
+        else
+        {
+            *pError = "Line " + std::to_string(lineNumber) + ": unknown key \"" + key + "\"";
+            return false;
+        }
+
+        if (!valid)
+        {
+            *pError = "Line " + std::to_string(lineNumber) + ": invalid value for \"" + key + "\"";
+            return false;
+        }
+    }
+
+    *pScenario = scenario;
+    return true;
+}
+
+BenchmarkResult RunBenchmark(const BenchmarkScenario& scenario)
+{
+    const UINT objectCount = scenario.objectCount;
+    std::mt19937 random(scenario.seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<BenchmarkObject> objects(objectCount);
+    for (BenchmarkObject& object : objects)
+    {
+        object.start = XMFLOAT3(scenario.spread * unit(random), scenario.spread * unit(random), 0.5f + 0.5f * unit(random));
+        object.speed = 0.02f * (1.0f + unit(random));
+        object.phase = XM_PI * unit(random);
+    }
+
+    // Evenly spread: object i moves when the count of movers up to it goes up. Only
+    // orbit and wander change positions; rotation stays inside the cull radius.
+    std::vector<UINT> movingObjects;
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        objects[i].moving = static_cast<UINT>((i + 1) * static_cast<double>(scenario.movingFraction)) != static_cast<UINT>(i * static_cast<double>(scenario.movingFraction));
+        if (objects[i].moving && (scenario.motion == BenchmarkMotionOrbit || scenario.motion == BenchmarkMotionWander))
+        {
+            movingObjects.push_back(i);
+        }
+    }
+
+    // The transforms go where the sample's CPU update writes them: instances for root
+    // constants, 256-byte constant buffers otherwise, in write-combined memory.
+    const bool instancesPacked = (scenario.bindingStrategy == DrawBindingRootConstants);
+    const SIZE_T transformSize = static_cast<SIZE_T>(instancesPacked ? sizeof(PackedInstanceData) : sizeof(SceneConstantBuffer)) * objectCount;
+    UINT8* pTransforms = static_cast<UINT8*>(VirtualAlloc(nullptr, transformSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE | PAGE_WRITECOMBINE));
+    if (pTransforms == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    // Only the arithmetic of the bindings matters; nothing is dereferenced.
+    DrawBindingSource source = {};
+    source.firstCbvHandle.ptr = 0x100000;
+    source.cbvDescriptorSize = 32;
+    source.firstConstantsAddress = 0x200000;
+    source.constantsStride = sizeof(SceneConstantBuffer);
+    source.indexCount = BenchmarkIndexCount;
+
+    std::vector<XMFLOAT4> positions(objectCount);
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        positions[i] = MoveObject(scenario.motion, objects[i], 0);
+    }
+    VisibilityView view = GetClipSpaceView();
+    VisibilityCache visibilityCache;
+    if (scenario.visibilityCache)
+    {
+        visibilityCache.Reset(positions.data(), objectCount, scenario.cullRadius, view, BenchmarkVisibilityCellSize);
+    }
+
+    std::vector<UINT64> sortKeys(objectCount);
+    std::vector<UINT> drawList;
+    drawList.reserve(objectCount);
+    std::vector<HeadlessCommandEncoder> encoders(scenario.threadCount);
+    BenchmarkWorkers workers(scenario.threadCount);
+
+    // Consecutive runs, as the sample's workers split the sorted order, so that the
+    // draw list is the submission order in every depth mode.
+    const std::function<void(UINT)> recordDraws = [&](UINT threadIndex)
+    {
+        const UINT drawCount = static_cast<UINT>(drawList.size());
+        encoders[threadIndex].Reset();
+        EncodeDrawList(encoders[threadIndex], scenario.bindingStrategy, source, drawList.data(),
+            threadIndex * drawCount / scenario.threadCount, 1, (threadIndex + 1) * drawCount / scenario.threadCount);
+    };
+
+    // Occlusion culling as the sample's workers do it. In the depth modes the opaque
+    // objects hide what is behind them; without depth, each object hides the ones
+    // drawn before it, so its depth is its place in the draw list. The buffer covers
+    // the view, so positions are taken relative to its centre.
+    OcclusionBuffer occlusionBuffer;
+    occlusionBuffer.Create(BenchmarkOcclusionWidth, BenchmarkOcclusionHeight);
+    XMMATRIX rotation = XMMatrixIdentity();
+    std::vector<UINT8> unoccluded;
+    auto getOcclusionDepth = [&](size_t drawIndex)
+    {
+        return (scenario.depthMode == DepthModeOff) ?
+            1.0f - static_cast<float>(drawIndex + 1) / (drawList.size() + 1) :
+            positions[drawList[drawIndex]].z;
+    };
+    const std::function<void(UINT)> rasterizeOccluders = [&](UINT threadIndex)
+    {
+        UINT firstTileRow, endTileRow;
+        occlusionBuffer.GetBand(threadIndex, scenario.threadCount, &firstTileRow, &endTileRow);
+        occlusionBuffer.Clear(firstTileRow, endTileRow);
+        for (size_t i = 0; i < drawList.size(); i++)
+        {
+            if (scenario.depthMode != DepthModeOff && IsObjectTransparent(drawList[i]))
+            {
+                continue;
+            }
+            const XMFLOAT4& position = positions[drawList[i]];
+            const XMMATRIX world = rotation * XMMatrixTranslation(position.x - view.centerX, position.y - view.centerY, position.z);
+            occlusionBuffer.RasterizeQuad(world, BenchmarkHalfSize, getOcclusionDepth(i), firstTileRow, endTileRow);
+        }
+        occlusionBuffer.UpdateTiles(firstTileRow, endTileRow);
+    };
+    const std::function<void(UINT)> testOccludees = [&](UINT threadIndex)
+    {
+        for (size_t i = threadIndex; i < drawList.size(); i += scenario.threadCount)
+        {
+            const XMFLOAT4& position = positions[drawList[i]];
+            const XMFLOAT2 minCorner(position.x - view.centerX - scenario.cullRadius, position.y - view.centerY - scenario.cullRadius);
+            const XMFLOAT2 maxCorner(position.x - view.centerX + scenario.cullRadius, position.y - view.centerY + scenario.cullRadius);
+            unoccluded[i] = occlusionBuffer.IsRectVisible(minCorner, maxCorner, getOcclusionDepth(i)) ? 1 : 0;
+        }
+    };
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+
+    std::vector<double> frameTimes;
+    std::vector<double> stageTimes[BenchmarkStageCount];
+    UINT64 checksum = 0xcbf29ce484222325ull;
+    UINT64 visibleSum = 0;
+    UINT64 occludedSum = 0;
+    UINT64 retestedSum = 0;
+    const float rotationPerFrame = (scenario.motion == BenchmarkMotionStatic) ? 0.0f : 0.1f / FrameCount;
+    const UINT totalFrameCount = scenario.warmupFrameCount + scenario.frameCount;
+    float angle = 0.0f;
+    for (UINT frame = 0; frame < totalFrameCount; frame++)
+    {
+        LARGE_INTEGER stageEnds[BenchmarkStageCount + 1];
+        QueryPerformanceCounter(&stageEnds[0]);
+
+        // Update, as UpdateObjectTransformsOnCpu does.
+        angle = XMScalarModAngle(rotationPerFrame * frame);
+        rotation = XMMatrixRotationZ(angle);
+        if (scenario.cameraPan)
+        {
+            view.centerX = 0.5f * sinf(0.01f * frame);
+        }
+        for (UINT i = 0; i < objectCount; i++)
+        {
+            positions[i] = MoveObject(scenario.motion, objects[i], frame);
+            const XMMATRIX world = rotation * XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z);
+            if (instancesPacked)
+            {
+                EncodeInstanceData(world, reinterpret_cast<PackedInstanceData*>(pTransforms) + i);
+            }
+            else
+            {
+                reinterpret_cast<SceneConstantBuffer*>(pTransforms)[i].model = XMMatrixTranspose(world);
+            }
+        }
+        QueryPerformanceCounter(&stageEnds[BenchmarkStageUpdate + 1]);
+
+        UINT retestedCount = objectCount;
+        if (scenario.visibilityCache)
+        {
+            for (UINT i : movingObjects)
+            {
+                visibilityCache.MoveObject(i, positions[i]);
+            }
+            visibilityCache.Update(view);
+            const std::vector<UINT>& visibleObjects = visibilityCache.GetVisibleObjects();
+            drawList.assign(visibleObjects.begin(), visibleObjects.end());
+            retestedCount = visibilityCache.GetRetestedCount();
+            if (scenario.depthMode == DepthModeOff)
+            {
+                // The cache's list is unordered; without depth the draws go in object order.
+                std::sort(drawList.begin(), drawList.end());
+            }
+        }
+        else
+        {
+            drawList.clear();
+            for (UINT i = 0; i < objectCount; i++)
+            {
+                if (IsObjectInView(positions[i], scenario.cullRadius, view))
+                {
+                    drawList.push_back(i);
+                }
+            }
+        }
+        QueryPerformanceCounter(&stageEnds[BenchmarkStageCull + 1]);
+
+        const size_t inViewCount = drawList.size();
+        if (scenario.occlusion)
+        {
+            workers.Run(rasterizeOccluders);
+        }
+        QueryPerformanceCounter(&stageEnds[BenchmarkStageRasterize + 1]);
+
+        if (scenario.occlusion)
+        {
+            unoccluded.resize(drawList.size());
+            workers.Run(testOccludees);
+            size_t keptCount = 0;
+            for (size_t i = 0; i < drawList.size(); i++)
+            {
+                if (unoccluded[i])
+                {
+                    drawList[keptCount++] = drawList[i];
+                }
+            }
+            drawList.resize(keptCount);
+        }
+        QueryPerformanceCounter(&stageEnds[BenchmarkStageOcclusionTest + 1]);
+
+        SortDrawOrder(scenario.depthMode, positions.data(), drawList.data(), static_cast<UINT>(drawList.size()), sortKeys.data());
+        QueryPerformanceCounter(&stageEnds[BenchmarkStageSort + 1]);
+
+        workers.Run(recordDraws);
+        QueryPerformanceCounter(&stageEnds[BenchmarkStageRecord + 1]);
+
+        for (const HeadlessCommandEncoder& encoder : encoders)
+        {
+            checksum = HashBytes(checksum, encoder.GetData(), encoder.GetSize());
+        }
+
+        if (frame >= scenario.warmupFrameCount)
+        {
+            for (UINT stage = 0; stage < BenchmarkStageCount; stage++)
+            {
+                stageTimes[stage].push_back((stageEnds[stage + 1].QuadPart - stageEnds[stage].QuadPart) * millisecondsPerTick);
+            }
+            frameTimes.push_back((stageEnds[BenchmarkStageCount].QuadPart - stageEnds[0].QuadPart) * millisecondsPerTick);
+            visibleSum += drawList.size();
+            occludedSum += inViewCount - drawList.size();
+            retestedSum += retestedCount;
+        }
+    }
+    VirtualFree(pTransforms, 0, MEM_RELEASE);
+
+    BenchmarkResult result = {};
+
+    // Every object of the last frame in view, occluded or not, in each mode's order,
+    // relative to the view's centre.
+    for (XMFLOAT4& position : positions)
+    {
+        position.x -= view.centerX;
+        position.y -= view.centerY;
+    }
+    OverdrawEstimator overdrawEstimator;
+    overdrawEstimator.Create(BenchmarkOverdrawWidth, BenchmarkOverdrawHeight);
+    for (UINT mode = 0; mode < DepthModeCount; mode++)
+    {
+        drawList.clear();
+        for (UINT i = 0; i < objectCount; i++)
+        {
+            if (IsObjectVisible(positions[i], scenario.cullRadius))
+            {
+                drawList.push_back(i);
+            }
+        }
+        const DepthMode depthMode = static_cast<DepthMode>(mode);
+        const UINT drawCount = static_cast<UINT>(drawList.size());
+        const UINT opaqueCount = SortDrawOrder(depthMode, positions.data(), drawList.data(), drawCount, sortKeys.data());
+        result.overdraw[mode] = overdrawEstimator.Estimate(depthMode, positions.data(), drawList.data(), drawCount, opaqueCount, angle, BenchmarkHalfSize);
+    }
+
+    result.frame = Summarize(frameTimes);
+    for (UINT stage = 0; stage < BenchmarkStageCount; stage++)
+    {
+        result.stages[stage] = Summarize(stageTimes[stage]);
+    }
+    result.averageVisibleCount = static_cast<double>(visibleSum) / scenario.frameCount;
+    result.averageOccludedCount = static_cast<double>(occludedSum) / scenario.frameCount;
+    result.averageRetestedCount = static_cast<double>(retestedSum) / scenario.frameCount;
+    result.checksum = checksum;
+    return result;
+}
+
+std::string WriteBenchmarkJson(const BenchmarkScenario& scenario, const BenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"scenario\": \"" << EscapeJson(scenario.name) << "\",\n";
+    json << "  \"objects\": " << scenario.objectCount << ",\n";
+    json << "  \"frames\": " << scenario.frameCount << ",\n";
+    json << "  \"threads\": " << scenario.threadCount << ",\n";
+    json << "  \"motion\": \"" << GetBenchmarkMotionName(scenario.motion) << "\",\n";
+    json << "  \"binding\": \"" << GetDrawBindingStrategyName(scenario.bindingStrategy) << "\",\n";
+    json << "  \"checksum\": \"" << FormatChecksum(result.checksum) << "\",\n";
+    json << "  \"averageVisible\": " << result.averageVisibleCount << ",\n";
+    json << "  \"occlusion\": \"" << (scenario.occlusion ? "on" : "off") << "\",\n";
+    if (scenario.occlusion)
+    {
+        // Every object in view is both an occluder and a query.
+        const double inViewCount = result.averageVisibleCount + result.averageOccludedCount;
+        const double rasterizeTime = result.stages[BenchmarkStageRasterize].mean;
+        const double testTime = result.stages[BenchmarkStageOcclusionTest].mean;
+        json << "  \"averageOccluded\": " << result.averageOccludedCount << ",\n";
+        json << "  \"occludersPerMs\": " << (rasterizeTime > 0.0 ? inViewCount / rasterizeTime : 0.0) << ",\n";
+        json << "  \"occlusionTestsPerMs\": " << (testTime > 0.0 ? inViewCount / testTime : 0.0) << ",\n";
+    }
+    json << "  \"moving\": " << scenario.movingFraction << ",\n";
+    json << "  \"camera\": \"" << (scenario.cameraPan ? "pan" : "static") << "\",\n";
+    json << "  \"visibilityCache\": \"" << (scenario.visibilityCache ? "on" : "off") << "\",\n";
+    json << "  \"averageRetested\": " << result.averageRetestedCount << ",\n";
+    json << "  \"cullMsPerFrame\": " << result.stages[BenchmarkStageCull].mean << ",\n";
+    json << "  \"depth\": \"" << GetDepthModeName(scenario.depthMode) << "\",\n";
+    json << "  \"overdraw\": {\n";
+    for (UINT mode = 0; mode < DepthModeCount; mode++)
+    {
+        const OverdrawStatistics& overdraw = result.overdraw[mode];
+        char text[256];
+        sprintf_s(text, "    \"%s\": { \"average\": %.4f, \"max\": %u, \"coveredPixels\": %llu, \"shaded\": %llu, \"rasterized\": %llu, \"depthOnly\": %llu }%s\n",
+            GetDepthModeName(static_cast<DepthMode>(mode)), GetAverageOverdraw(overdraw), overdraw.maxOverdraw,
+            overdraw.coveredPixelCount, overdraw.shadedCount, overdraw.rasterizedCount, overdraw.depthOnlyCount,
+            (mode + 1 < DepthModeCount) ? "," : "");
+        json << text;
+    }
+    json << "  },\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"frame\": ";
+    writeTimes(json, result.frame);
+    json << ",\n  \"stages\": {\n";
+    for (UINT stage = 0; stage < BenchmarkStageCount; stage++)
+    {
+        json << "    \"" << GetBenchmarkStageName(static_cast<BenchmarkStage>(stage)) << "\": ";
+        writeTimes(json, result.stages[stage]);
+        json << ((stage + 1 < BenchmarkStageCount) ? ",\n" : "\n");
+    }
+    json << "  }\n}\n";
+    return json.str();
+}
+
+bool ReadBenchmarkBaseline(const std::string& json, BenchmarkBaseline* pBaseline, std::string* pError)
+{
+    *pBaseline = BenchmarkBaseline();
+    FlatJsonReader reader(json, pBaseline);
+    return reader.Read(pError);
+}
+
+bool CompareBenchmarkBaseline(const BenchmarkScenario& scenario, const BenchmarkResult& result, const BenchmarkBaseline& baseline,
+    std::vector<BenchmarkRegression>* pRegressions, std::string* pError)
+{
+    pRegressions->clear();
+
+    // Timings are only comparable for the same draw lists.
+    const auto checksum = baseline.strings.find("checksum");
+    if (checksum == baseline.strings.end() || checksum->second != FormatChecksum(result.checksum))
+    {
+        *pError = "The baseline's checksum differs; it was recorded for a different scenario or pipeline";
+        return false;
+    }
+
+    std::vector<std::pair<std::string, double>> metrics;
+    metrics.push_back(std::make_pair("frame.p50", result.frame.p50));
+    metrics.push_back(std::make_pair("frame.p90", result.frame.p90));
+    metrics.push_back(std::make_pair("frame.p99", result.frame.p99));
+    for (UINT stage = 0; stage < BenchmarkStageCount; stage++)
+    {
+        metrics.push_back(std::make_pair(std::string("stages.") + GetBenchmarkStageName(static_cast<BenchmarkStage>(stage)) + ".p50", result.stages[stage].p50));
+    }
+
+    for (const auto& metric : metrics)
+    {
+        const auto baselineValue = baseline.numbers.find(metric.first);
+        if (baselineValue == baseline.numbers.end())
+        {
+            *pError = "The baseline has no \"" + metric.first + "\"";
+            return false;
+        }
+
+        if (metric.second > baselineValue->second * (1.0 + scenario.tolerance) &&
+            metric.second - baselineValue->second > RegressionNoiseFloor)
+        {
+            const BenchmarkRegression regression = { metric.first, baselineValue->second, metric.second };
+            pRegressions->push_back(regression);
+        }
+    }
+    return true;
+}
+
+AllocatorBenchmarkResult RunAllocatorBenchmark(UINT threadCount, UINT frameCount)
+{
+    const UINT ListsPerFrame = 256;
+
+    BenchmarkWorkers workers(threadCount);
+    std::vector<std::unique_ptr<LinearArena>> arenas;
+    for (UINT i = 0; i < threadCount; i++)
+    {
+        arenas.emplace_back(new LinearArena());
+    }
+    // Each thread's sums go on their own cache line.
+    std::vector<UINT64> heapSums(8 * threadCount);
+    std::vector<UINT64> arenaSums(8 * threadCount);
+
+    UINT frame = 0;
+    const std::function<void(UINT)> heapFrame = [&](UINT threadIndex)
+    {
+        heapSums[8 * threadIndex] += BuildScratchLists(std::allocator<UINT>(), ListsPerFrame, frame * threadCount + threadIndex);
+    };
+    const std::function<void(UINT)> arenaFrame = [&](UINT threadIndex)
+    {
+        LinearArena& arena = *arenas[threadIndex];
+        arena.Reset();
+        arenaSums[8 * threadIndex] += BuildScratchLists(ArenaAllocator<UINT>(&arena), ListsPerFrame, frame * threadCount + threadIndex);
+    };
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto timeFrame = [&](const std::function<void(UINT)>& work)
+    {
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        workers.Run(work);
+        QueryPerformanceCounter(&end);
+        return (end.QuadPart - start.QuadPart) * millisecondsPerTick;
+    };
+
+    // Alternate frame by frame, so both see the same machine state.
+    std::vector<double> heapTimes;
+    std::vector<double> arenaTimes;
+    for (frame = 0; frame < frameCount; frame++)
+    {
+        heapTimes.push_back(timeFrame(heapFrame));
+        arenaTimes.push_back(timeFrame(arenaFrame));
+    }
+
+    AllocatorBenchmarkResult result = {};
+    result.threadCount = threadCount;
+    result.frameCount = frameCount;
+    result.listsPerFrame = ListsPerFrame;
+    result.heap = Summarize(heapTimes);
+    result.arena = Summarize(arenaTimes);
+    for (const std::unique_ptr<LinearArena>& arena : arenas)
+    {
+        result.arenaHighWaterMark = max(result.arenaHighWaterMark, arena->GetHighWaterMark());
+        result.arenaOverflowCount += arena->GetOverflowCount();
+    }
+    result.checksumsMatch = (heapSums == arenaSums);
+    return result;
+}
+
+std::string WriteAllocatorBenchmarkJson(const AllocatorBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"threads\": " << result.threadCount << ",\n";
+    json << "  \"frames\": " << result.frameCount << ",\n";
+    json << "  \"listsPerFrame\": " << result.listsPerFrame << ",\n";
+    json << "  \"checksumsMatch\": " << (result.checksumsMatch ? "true" : "false") << ",\n";
+    json << "  \"arenaHighWaterMark\": " << result.arenaHighWaterMark << ",\n";
+    json << "  \"arenaOverflows\": " << result.arenaOverflowCount << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"heap\": ";
+    writeTimes(json, result.heap);
+    json << ",\n  \"arena\": ";
+    writeTimes(json, result.arena);
+    json << "\n}\n";
+    return json.str();
+}
+
+RingBenchmarkResult RunRingBenchmark(UINT frameCount)
+{
+    const UINT AllocationsPerFrame = 1024;
+
+    struct Request
+    {
+        UINT64 size;
+        UINT64 alignment;
+    };
+
+    // Mostly constant buffers, some buffer copies and the odd texture, drawn up front so
+    // the timing is the allocator's alone.
+    std::vector<Request> requests(8 * AllocationsPerFrame);
+    std::mt19937 random(26);
+    for (Request& request : requests)
+    {
+        const UINT kind = random() % 100;
+        if (kind < 79)
+        {
+            request.size = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+            request.alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+        }
+        else if (kind < 99)
+        {
+            request.size = 1 + random() % (64 * 1024);
+            request.alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+        }
+        else
+        {
+            request.size = 64 * 1024 + random() % (192 * 1024);
+            request.alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+        }
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    RingBenchmarkResult result = {};
+    result.frameCount = frameCount;
+    result.allocationsPerFrame = AllocationsPerFrame;
+    result.capacity = UploadRingBufferSize;
+    result.offsetsValid = true;
+
+    RingAllocator ring(UploadRingBufferSize);
+    std::vector<double> frameTimes;
+    double usedFractionSum = 0.0;
+    UINT64 previousEnd = 0;
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        // Fence values start at 1, as the sample's do.
+        const UINT64 fenceValue = frame + 1;
+        bool stalled = false;
+        const double start = now();
+        for (UINT i = 0; i < AllocationsPerFrame; i++)
+        {
+            const Request& request = requests[(static_cast<size_t>(frame) * AllocationsPerFrame + i) % requests.size()];
+            UINT64 offset = ring.Allocate(request.size, request.alignment);
+            if (offset == RingAllocator::InvalidOffset)
+            {
+                ring.Retire(fenceValue - 1);
+                stalled = true;
+                offset = ring.Allocate(request.size, request.alignment);
+            }
+            if (offset == RingAllocator::InvalidOffset || offset % request.alignment != 0 || offset + request.size > UploadRingBufferSize)
+            {
+                result.offsetsValid = false;
+                continue;
+            }
+            result.wrapCount += (offset < previousEnd) ? 1 : 0;
+            previousEnd = offset + request.size;
+        }
+        ring.FinishFrame(fenceValue);
+        ring.Retire(fenceValue > FrameCount ? fenceValue - FrameCount : 0);
+        frameTimes.push_back(now() - start);
+
+        result.stallCount += stalled ? 1 : 0;
+        usedFractionSum += static_cast<double>(ring.GetUsedSize()) / UploadRingBufferSize;
+    }
+    result.frame = Summarize(frameTimes);
+    result.allocationsPerSecond = result.frame.p50 > 0.0 ? AllocationsPerFrame / (result.frame.p50 / 1000.0) : 0.0;
+    result.averageUsedFraction = usedFractionSum / frameCount;
+    return result;
+}
+
+std::string WriteRingBenchmarkJson(const RingBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"frames\": " << result.frameCount << ",\n";
+    json << "  \"allocationsPerFrame\": " << result.allocationsPerFrame << ",\n";
+    json << "  \"capacity\": " << result.capacity << ",\n";
+    json << "  \"offsetsValid\": " << (result.offsetsValid ? "true" : "false") << ",\n";
+    json << "  \"allocationsPerSecond\": " << result.allocationsPerSecond << ",\n";
+    json << "  \"stalls\": " << result.stallCount << ",\n";
+    json << "  \"wraps\": " << result.wrapCount << ",\n";
+    json << "  \"averageUsedFraction\": " << result.averageUsedFraction << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"frame\": ";
+    writeTimes(json, result.frame);
+    json << "\n}\n";
+    return json.str();
+}
+
+RenderGraphBenchmarkResult RunRenderGraphBenchmark(UINT passCount, UINT frameCount)
+{
+    const UINT CommandListCount = 4;
+    const UINT PassesPerList = 3;           // Consecutive passes recorded on one list, so that split barriers fit.
+    const UINT ReadWindow = 8;              // Passes read the outputs of the ones this far back.
+    const UINT MaxReadCount = 4;            // The composite's; the other passes read up to two.
+
+    struct SyntheticPass
+    {
+        std::string name;
+        D3D12_RESOURCE_DESC outputDesc;
+        D3D12_RESOURCE_ALLOCATION_INFO outputInfo;
+        D3D12_RESOURCE_STATES outputState;
+        UINT reads[MaxReadCount];
+        D3D12_RESOURCE_STATES readStates[MaxReadCount];
+        UINT readCount;
+    };
+
+    // Drawn up front, so that every frame declares the same graph and the timing is the
+    // graph's alone. The last pass composites the last few outputs into the back buffer.
+    passCount = max(passCount, 2u);
+    std::vector<SyntheticPass> passes(passCount);
+    std::mt19937 random(31);
+    for (UINT i = 0; i + 1 < passCount; i++)
+    {
+        SyntheticPass& pass = passes[i];
+        pass.name = "Pass" + std::to_string(i);
+        if (random() % 4 != 0)
+        {
+            const UINT width = 256u << (random() % 4);
+            pass.outputDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, width, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+            pass.outputInfo.SizeInBytes = static_cast<UINT64>(width) * width * 8;
+            pass.outputState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+        }
+        else
+        {
+            const UINT64 size = (1 + random() % 16) * D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+            pass.outputDesc = CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+            pass.outputInfo.SizeInBytes = size;
+            pass.outputState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+        }
+        pass.outputInfo.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+        const UINT readCount = 1 + static_cast<UINT>(random() % 2);
+        pass.readCount = min(i, readCount);
+        for (UINT r = 0; r < pass.readCount; r++)
+        {
+            pass.reads[r] = i - 1 - static_cast<UINT>(random() % min(i, ReadWindow));
+            pass.readStates[r] = (random() % 2 != 0) ? D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE : D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+        }
+        if (pass.readCount == 2 && pass.reads[1] == pass.reads[0])
+        {
+            pass.readCount = 1;
+        }
+    }
+    SyntheticPass& composite = passes[passCount - 1];
+    composite.name = "Composite";
+    composite.outputState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    composite.readCount = min(passCount - 1, MaxReadCount);
+    for (UINT r = 0; r < composite.readCount; r++)
+    {
+        composite.reads[r] = passCount - 2 - r;
+        composite.readStates[r] = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    }
+
+    // The graph only compares command lists, so these are never dereferenced.
+    int commandLists[CommandListCount] = {};
+    ID3D12GraphicsCommandList* pCommandLists[CommandListCount];
+    for (UINT i = 0; i < CommandListCount; i++)
+    {
+        pCommandLists[i] = reinterpret_cast<ID3D12GraphicsCommandList*>(&commandLists[i]);
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    RenderGraphBenchmarkResult result = {};
+    result.passCount = passCount;
+    result.frameCount = frameCount;
+    result.consistent = true;
+
+    RenderGraph graph;
+    std::vector<RenderGraphResource> outputs(passCount);
+    std::vector<double> frameTimes;
+    std::vector<double> compileTimes;
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        const double start = now();
+        graph.Reset();
+        const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", nullptr, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+        for (UINT i = 0; i + 1 < passCount; i++)
+        {
+            outputs[i] = graph.CreateTransientResource(passes[i].name.c_str(), passes[i].outputDesc, nullptr, passes[i].outputInfo);
+        }
+        outputs[passCount - 1] = backBuffer;
+        for (UINT i = 0; i < passCount; i++)
+        {
+            const SyntheticPass& pass = passes[i];
+            const UINT index = graph.AddPass(pass.name.c_str(), pCommandLists[(i / PassesPerList) % CommandListCount]);
+            for (UINT r = 0; r < pass.readCount; r++)
+            {
+                graph.ReadResource(index, outputs[pass.reads[r]], pass.readStates[r]);
+            }
+            graph.WriteResource(index, outputs[i], pass.outputState);
+        }
+        const double compileStart = now();
+        graph.Compile();
+        const double end = now();
+        frameTimes.push_back(end - start);
+        compileTimes.push_back(end - compileStart);
+
+        const RenderGraph::Statistics& statistics = graph.GetStatistics();
+        if (frame == 0)
+        {
+            result.statistics = statistics;
+        }
+        const RenderGraph::Statistics& first = result.statistics;
+        result.consistent = result.consistent &&
+            statistics.culledPassCount == first.culledPassCount && statistics.barrierCount == first.barrierCount &&
+            statistics.barrierBatchCount == first.barrierBatchCount && statistics.splitBarrierCount == first.splitBarrierCount &&
+            statistics.aliasingBarrierCount == first.aliasingBarrierCount && statistics.transientHeapSize == first.transientHeapSize &&
+            statistics.transientHeapSize <= statistics.transientUnaliasedSize;
+    }
+    result.frame = Summarize(frameTimes);
+    result.compile = Summarize(compileTimes);
+    return result;
+}
+
+std::string WriteRenderGraphBenchmarkJson(const RenderGraphBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    const RenderGraph::Statistics& statistics = result.statistics;
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"passes\": " << result.passCount << ",\n";
+    json << "  \"frames\": " << result.frameCount << ",\n";
+    json << "  \"consistent\": " << (result.consistent ? "true" : "false") << ",\n";
+    json << "  \"culledPasses\": " << statistics.culledPassCount << ",\n";
+    json << "  \"barriers\": " << statistics.barrierCount << ",\n";
+    json << "  \"barrierBatches\": " << statistics.barrierBatchCount << ",\n";
+    json << "  \"splitBarriers\": " << statistics.splitBarrierCount << ",\n";
+    json << "  \"aliasingBarriers\": " << statistics.aliasingBarrierCount << ",\n";
+    json << "  \"transientResources\": " << statistics.transientResourceCount << ",\n";
+    json << "  \"transientHeapSize\": " << statistics.transientHeapSize << ",\n";
+    json << "  \"transientUnaliasedSize\": " << statistics.transientUnaliasedSize << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"frame\": ";
+    writeTimes(json, result.frame);
+    json << ",\n  \"compile\": ";
+    writeTimes(json, result.compile);
+    json << "\n}\n";
+    return json.str();
+}
+
+ShaderCacheBenchmarkResult RunShaderCacheBenchmark(const std::wstring& assetDirectory, UINT passCount)
+{
+    ShaderCacheBenchmarkResult result = {};
+    result.programCount = ShaderProgramCount;
+    result.passCount = passCount;
+    result.allCached = true;
+    result.bytecodeMatches = true;
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    const std::wstring cacheFilename = assetDirectory + L"shaders.bench.cache";
+    std::vector<double> compiledTimes, cachedTimes;
+    try
+    {
+        for (UINT pass = 0; pass < passCount; pass++)
+        {
+            DeleteFile(cacheFilename.c_str());
+
+            // Kept past Close; the cached load has to return the same bytes.
+            std::vector<std::string> compiledBytecode(ShaderProgramCount);
+            ShaderCache cache;
+            const double compileStart = now();
+            cache.Open(cacheFilename);
+            for (UINT i = 0; i < ShaderProgramCount; i++)
+            {
+                const D3D12_SHADER_BYTECODE bytecode = cache.GetShader(assetDirectory + ShaderPrograms[i].filename, nullptr,
+                    ShaderPrograms[i].entryPoint, ShaderPrograms[i].target, GetShaderCompileFlags());
+                compiledBytecode[i].assign(static_cast<const char*>(bytecode.pShaderBytecode), bytecode.BytecodeLength);
+            }
+            compiledTimes.push_back(now() - compileStart);
+            cache.Close();
+
+            const double cachedStart = now();
+            cache.Open(cacheFilename);
+            for (UINT i = 0; i < ShaderProgramCount; i++)
+            {
+                const D3D12_SHADER_BYTECODE bytecode = cache.GetShader(assetDirectory + ShaderPrograms[i].filename, nullptr,
+                    ShaderPrograms[i].entryPoint, ShaderPrograms[i].target, GetShaderCompileFlags());
+                result.bytecodeMatches = result.bytecodeMatches && bytecode.BytecodeLength == compiledBytecode[i].size() &&
+                    memcmp(bytecode.pShaderBytecode, compiledBytecode[i].data(), bytecode.BytecodeLength) == 0;
+            }
+            cachedTimes.push_back(now() - cachedStart);
+            result.allCached = result.allCached && cache.GetMissCount() == 0;
+            cache.Close();
+        }
+    }
+    catch (HrException& e)
+    {
+        result.error = std::string("Can't compile the shaders: ") + e.what();
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+    if (GetFileAttributesEx(cacheFilename.c_str(), GetFileExInfoStandard, &attributes))
+    {
+        result.cacheFileSize = (static_cast<UINT64>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    }
+    DeleteFile(cacheFilename.c_str());
+
+    result.compiled = Summarize(compiledTimes);
+    result.cached = Summarize(cachedTimes);
+    return result;
+}
+
+std::string WriteShaderCacheBenchmarkJson(const ShaderCacheBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"programs\": " << result.programCount << ",\n";
+    json << "  \"passes\": " << result.passCount << ",\n";
+    json << "  \"allCached\": " << (result.allCached ? "true" : "false") << ",\n";
+    json << "  \"bytecodeMatches\": " << (result.bytecodeMatches ? "true" : "false") << ",\n";
+    json << "  \"cacheFileSize\": " << result.cacheFileSize << ",\n";
+    json << "  \"savedMilliseconds\": " << (result.compiled.p50 - result.cached.p50) << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"compiled\": ";
+    writeTimes(json, result.compiled);
+    json << ",\n  \"cached\": ";
+    writeTimes(json, result.cached);
+    json << "\n}\n";
+    return json.str();
+}
+
+HierarchyBenchmarkResult RunHierarchyBenchmark(UINT nodeCount, UINT threadCount, UINT frameCount)
+{
+    const UINT LevelCounts[] = { 2, 4, 8, 16, 32 };
+    // About one node in a thousand is animated on a partial frame, with its subtree.
+    const UINT dirtyNodeCount = max(1u, nodeCount / 1000);
+
+    BenchmarkWorkers workers(threadCount);
+    SYNCHRONIZATION_BARRIER levelBarrier;
+    InitializeSynchronizationBarrier(&levelBarrier, threadCount, -1);
+    // Each thread's count goes on its own cache line.
+    std::vector<UINT> updatedCounts(16 * threadCount);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto timeWork = [&](const std::function<void()>& work)
+    {
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        work();
+        QueryPerformanceCounter(&end);
+        return (end.QuadPart - start.QuadPart) * millisecondsPerTick;
+    };
+
+    HierarchyBenchmarkResult result = {};
+    result.nodeCount = nodeCount;
+    result.threadCount = threadCount;
+    result.frameCount = frameCount;
+    result.dirtyNodesPerFrame = dirtyNodeCount;
+    std::mt19937 random(44);
+    for (UINT levelCount : LevelCounts)
+    {
+        std::vector<UINT> parents;
+        std::vector<XMFLOAT4X3> localTransforms;
+        GenerateHierarchy(nodeCount, levelCount, random, &parents, &localTransforms);
+
+        TransformHierarchy hierarchy;
+        hierarchy.Build(parents.data(), nodeCount);
+        std::vector<std::unique_ptr<PointerNode>> pointerNodes;
+        for (UINT i = 0; i < nodeCount; i++)
+        {
+            pointerNodes.emplace_back(new PointerNode());
+            pointerNodes[i]->localTransform = localTransforms[i];
+            hierarchy.SetLocalTransform(hierarchy.GetNode(i), XMLoadFloat4x3(&localTransforms[i]));
+        }
+        std::vector<PointerNode*> pointerRoots;
+        std::vector<UINT> roots;
+        for (UINT i = 0; i < nodeCount; i++)
+        {
+            if (parents[i] == TransformHierarchy::NoParent)
+            {
+                pointerRoots.push_back(pointerNodes[i].get());
+                roots.push_back(i);
+            }
+            else
+            {
+                pointerNodes[parents[i]]->children.push_back(pointerNodes[i].get());
+            }
+        }
+
+        const std::function<void(UINT)> updateWork = [&](UINT threadIndex)
+        {
+            updatedCounts[16 * threadIndex] = hierarchy.UpdateWorldTransforms(threadIndex, threadCount, &levelBarrier);
+        };
+        auto update = [&]() { workers.Run(updateWork); };
+        auto updatePointers = [&]()
+        {
+            for (PointerNode* pRoot : pointerRoots)
+            {
+                UpdatePointerNode(pRoot, XMMatrixIdentity());
+            }
+        };
+        update();
+
+        // Alternate frame by frame, so all three see the same machine state. The full
+        // frames turn every root, the partial ones dirtyNodeCount random nodes; the
+        // pointer tree recomputes everything either way.
+        std::uniform_int_distribution<UINT> randomNode(0, nodeCount - 1);
+        std::vector<double> fullTimes, partialTimes, pointerTimes;
+        UINT64 partialUpdatedCount = 0;
+        for (UINT frame = 0; frame < frameCount; frame++)
+        {
+            const XMMATRIX turn = XMMatrixRotationZ(0.01f);
+            for (UINT root : roots)
+            {
+                const XMMATRIX local = XMLoadFloat4x3(&pointerNodes[root]->localTransform) * turn;
+                XMStoreFloat4x3(&pointerNodes[root]->localTransform, local);
+                hierarchy.SetLocalTransform(hierarchy.GetNode(root), local);
+            }
+            fullTimes.push_back(timeWork(update));
+            pointerTimes.push_back(timeWork(updatePointers));
+
+            for (UINT i = 0; i < dirtyNodeCount; i++)
+            {
+                const UINT dirtyNode = randomNode(random);
+                const XMMATRIX local = XMLoadFloat4x3(&pointerNodes[dirtyNode]->localTransform) * turn;
+                XMStoreFloat4x3(&pointerNodes[dirtyNode]->localTransform, local);
+                hierarchy.SetLocalTransform(hierarchy.GetNode(dirtyNode), local);
+            }
+            partialTimes.push_back(timeWork(update));
+            for (UINT threadIndex = 0; threadIndex < threadCount; threadIndex++)
+            {
+                partialUpdatedCount += updatedCounts[16 * threadIndex];
+            }
+        }
+
+        // The batched update sums its products in XMMatrixMultiply's order, so both
+        // layouts agree exactly unless the level order or the batching went wrong.
+        updatePointers();
+        bool matches = true;
+        for (UINT i = 0; i < nodeCount && matches; i++)
+        {
+            XMFLOAT4X3 world;
+            XMStoreFloat4x3(&world, hierarchy.GetWorldTransform(hierarchy.GetNode(i)));
+            for (UINT element = 0; element < 12 && matches; element++)
+            {
+                matches = (&world._11)[element] == (&pointerNodes[i]->worldTransform._11)[element];
+            }
+        }
+
+        HierarchyBenchmarkDepth depth = {};
+        depth.levelCount = hierarchy.GetLevelCount();
+        depth.full = Summarize(fullTimes);
+        depth.partial = Summarize(partialTimes);
+        depth.pointerTree = Summarize(pointerTimes);
+        depth.averagePartialUpdatedCount = frameCount > 0 ? static_cast<double>(partialUpdatedCount) / frameCount : 0.0;
+        depth.worldTransformsMatch = matches;
+        result.depths.push_back(depth);
+    }
+
+    DeleteSynchronizationBarrier(&levelBarrier);
+    return result;
+}
+
+std::string WriteHierarchyBenchmarkJson(const HierarchyBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"nodes\": " << result.nodeCount << ",\n";
+    json << "  \"threads\": " << result.threadCount << ",\n";
+    json << "  \"frames\": " << result.frameCount << ",\n";
+    json << "  \"dirtyNodesPerFrame\": " << result.dirtyNodesPerFrame << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"depths\": [\n";
+    for (size_t i = 0; i < result.depths.size(); i++)
+    {
+        const HierarchyBenchmarkDepth& depth = result.depths[i];
+        json << "    {\n";
+        json << "      \"levels\": " << depth.levelCount << ",\n";
+        json << "      \"worldTransformsMatch\": " << (depth.worldTransformsMatch ? "true" : "false") << ",\n";
+        json << "      \"averagePartialUpdated\": " << depth.averagePartialUpdatedCount << ",\n";
+        json << "      \"full\": ";
+        writeTimes(json, depth.full);
+        json << ",\n      \"partial\": ";
+        writeTimes(json, depth.partial);
+        json << ",\n      \"pointerTree\": ";
+        writeTimes(json, depth.pointerTree);
+        json << "\n    }" << ((i + 1 < result.depths.size()) ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+AnimationBenchmarkResult RunAnimationBenchmark(UINT objectCount, UINT threadCount, UINT frameCount)
+{
+    const double FrameTime = 1.0 / 60.0;
+
+    // Every kind of curve: spins, keyframed sways over different spans, and drifts.
+    std::mt19937 random(45);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<ObjectAnimation> animations(objectCount);
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        ObjectAnimation& animation = animations[i];
+        animation.basePosition = XMFLOAT3(unit(random), unit(random), 0.5f + 0.45f * unit(random));
+        animation.rotationZ = AnimationCurve::Rotation(XM_PI * unit(random), 2.0f * unit(random));
+        const float span = 1.0f + 0.5f * (i % 4);
+        const AnimationKey keys[] = { { 0.0f, 0.0f }, { 0.25f * span, 0.2f * unit(random) }, { 0.5f * span, 0.2f * unit(random) }, { span, 0.0f } };
+        animation.offsetX = AnimationCurve::Keyframes(keys, _countof(keys), true);
+        animation.offsetY = (i % 2) ? AnimationCurve::Linear(0.0f, 0.01f * unit(random)) : AnimationCurve::Constant(0.0f);
+    }
+
+    std::vector<XMFLOAT4X3> transforms(objectCount);
+    auto evaluate = [&](UINT frame, UINT first, UINT end)
+    {
+        for (UINT i = first; i < end; i++)
+        {
+            XMStoreFloat4x3(&transforms[i], EvaluateObjectAnimation(animations[i], frame * FrameTime));
+        }
+    };
+
+    BenchmarkWorkers workers(threadCount);
+    UINT frame = 0;
+    const std::function<void(UINT)> parallelFrame = [&](UINT threadIndex)
+    {
+        evaluate(frame, static_cast<UINT>(static_cast<UINT64>(objectCount) * threadIndex / threadCount), static_cast<UINT>(static_cast<UINT64>(objectCount) * (threadIndex + 1) / threadCount));
+    };
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto timeWork = [&](const std::function<void()>& work)
+    {
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        work();
+        QueryPerformanceCounter(&end);
+        return (end.QuadPart - start.QuadPart) * millisecondsPerTick;
+    };
+
+    // In order on one thread, then backwards across every thread: no frame depends on
+    // another, so each must come out the same.
+    std::vector<UINT64> frameHashes(frameCount);
+    std::vector<double> singleThreadTimes;
+    for (frame = 0; frame < frameCount; frame++)
+    {
+        singleThreadTimes.push_back(timeWork([&]() { evaluate(frame, 0, objectCount); }));
+        frameHashes[frame] = HashBytes(0xcbf29ce484222325ull, transforms.data(), transforms.size() * sizeof(XMFLOAT4X3));
+    }
+    std::vector<double> allThreadTimes;
+    bool framesIndependent = true;
+    for (UINT i = 0; i < frameCount; i++)
+    {
+        frame = frameCount - 1 - i;
+        allThreadTimes.push_back(timeWork([&]() { workers.Run(parallelFrame); }));
+        framesIndependent = framesIndependent && HashBytes(0xcbf29ce484222325ull, transforms.data(), transforms.size() * sizeof(XMFLOAT4X3)) == frameHashes[frame];
+    }
+
+    AnimationBenchmarkResult result = {};
+    result.objectCount = objectCount;
+    result.threadCount = threadCount;
+    result.frameCount = frameCount;
+    result.singleThread = Summarize(singleThreadTimes);
+    result.allThreads = Summarize(allThreadTimes);
+    result.framesIndependent = framesIndependent;
+    result.driftFrameCount = 60 * 60 * 60;
+    result.drift = MeasureAnimationDrift(16, result.driftFrameCount, FrameTime);
+    return result;
+}
+
+std::string WriteAnimationBenchmarkJson(const AnimationBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"objects\": " << result.objectCount << ",\n";
+    json << "  \"threads\": " << result.threadCount << ",\n";
+    json << "  \"frames\": " << result.frameCount << ",\n";
+    json << "  \"framesIndependent\": " << (result.framesIndependent ? "true" : "false") << ",\n";
+    char drift[192];
+    sprintf_s(drift, "  \"drift\": { \"frames\": %u, \"stepped\": %g, \"evaluated\": %g, \"tolerance\": %g },\n",
+        result.driftFrameCount, result.drift.steppedError, result.drift.evaluatedError, result.drift.tolerance);
+    json << drift;
+    json << "  \"singleThreadObjectsPerMs\": " << (result.singleThread.mean > 0.0 ? result.objectCount / result.singleThread.mean : 0.0) << ",\n";
+    json << "  \"allThreadsObjectsPerMs\": " << (result.allThreads.mean > 0.0 ? result.objectCount / result.allThreads.mean : 0.0) << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"singleThread\": ";
+    writeTimes(json, result.singleThread);
+    json << ",\n  \"allThreads\": ";
+    writeTimes(json, result.allThreads);
+    json << "\n}\n";
+    return json.str();
+}
+
+SimulationBenchmarkResult RunSimulationBenchmark(UINT bodyCount, UINT frameCount)
+{
+    const double StepRate = 60.0;
+    const float Bound = 1.0f;
+    // Faster than real time, so the threaded run takes a fraction of the simulated time.
+    const double ThreadedClockSpeed = 4.0;
+
+    std::mt19937 random(46);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<XMFLOAT2> positions(bodyCount);
+    std::vector<XMFLOAT2> velocities(bodyCount);
+    for (UINT i = 0; i < bodyCount; i++)
+    {
+        positions[i] = XMFLOAT2(Bound * unit(random), Bound * unit(random));
+        velocities[i] = XMFLOAT2(0.5f * unit(random), 0.5f * unit(random));
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    SimulationBenchmarkResult result = {};
+    result.bodyCount = bodyCount;
+    result.stepRate = StepRate;
+    result.duration = frameCount / 60.0;
+
+    // Rendering at fixed rates, and at a rate that jitters from frame to frame.
+    struct RenderRate
+    {
+        const char* name;
+        double frameTime;               // Seconds; 0 for jittered.
+    };
+    const RenderRate renderRates[] = { { "30hz", 1.0 / 30.0 }, { "60hz", 1.0 / 60.0 }, { "144hz", 1.0 / 144.0 }, { "240hz", 1.0 / 240.0 }, { "jittered", 0.0 } };
+    std::uniform_real_distribution<double> jitteredFrameTime(0.002, 0.040);
+    std::vector<XMFLOAT2> interpolated(bodyCount);
+    std::vector<XMFLOAT2> latest;
+    FixedStepSimulation simulation;
+    for (const RenderRate& renderRate : renderRates)
+    {
+        simulation.Reset(positions.data(), velocities.data(), bodyCount, Bound, StepRate, 0);
+
+        std::vector<double> advanceTimes, interpolateTimes;
+        double advanceSum = 0.0;
+        double time = 0.0;
+        while (time < result.duration)
+        {
+            time = min(time + (renderRate.frameTime > 0.0 ? renderRate.frameTime : jitteredFrameTime(random)), result.duration);
+            const double advanceStart = now();
+            simulation.Advance(time);
+            const double interpolateStart = now();
+            simulation.Interpolate(time, interpolated.data());
+            const double interpolateEnd = now();
+            advanceTimes.push_back(interpolateStart - advanceStart);
+            interpolateTimes.push_back(interpolateEnd - interpolateStart);
+            advanceSum += interpolateStart - advanceStart;
+        }
+
+        SimulationBenchmarkRun run = {};
+        run.name = renderRate.name;
+        run.frameCount = static_cast<UINT>(advanceTimes.size());
+        run.stepCount = simulation.GetStepCount();
+        run.advance = Summarize(advanceTimes);
+        run.interpolate = Summarize(interpolateTimes);
+        run.millisecondsPerStep = run.stepCount > 0 ? advanceSum / run.stepCount : 0.0;
+        simulation.GetLatestState(&latest);
+        run.stateHash = HashBytes(0xcbf29ce484222325ull, latest.data(), latest.size() * sizeof(XMFLOAT2));
+        result.runs.push_back(run);
+    }
+
+    result.deterministic = true;
+    for (const SimulationBenchmarkRun& run : result.runs)
+    {
+        result.deterministic = result.deterministic && run.stepCount == result.runs[0].stepCount && run.stateHash == result.runs[0].stateHash;
+    }
+
+    // On its own thread, while this one keeps interpolating as a renderer would.
+    simulation.Reset(positions.data(), velocities.data(), bodyCount, Bound, StepRate, 0);
+    const double start = now();
+    const double duration = result.duration;
+    simulation.Start([&]() { return min((now() - start) / 1000.0 * ThreadedClockSpeed, duration); }, 0.0);
+    while (simulation.GetStepCount() < result.runs[0].stepCount)
+    {
+        simulation.Interpolate((now() - start) / 1000.0 * ThreadedClockSpeed, interpolated.data());
+        result.threadedInterpolationCount++;
+    }
+    simulation.Stop();
+    simulation.GetLatestState(&latest);
+    result.threadedMatches = simulation.GetStepCount() == result.runs[0].stepCount &&
+        HashBytes(0xcbf29ce484222325ull, latest.data(), latest.size() * sizeof(XMFLOAT2)) == result.runs[0].stateHash;
+    return result;
+}
+
+std::string WriteSimulationBenchmarkJson(const SimulationBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"bodies\": " << result.bodyCount << ",\n";
+    json << "  \"stepRate\": " << result.stepRate << ",\n";
+    json << "  \"seconds\": " << result.duration << ",\n";
+    json << "  \"deterministic\": " << (result.deterministic ? "true" : "false") << ",\n";
+    json << "  \"threadedMatches\": " << (result.threadedMatches ? "true" : "false") << ",\n";
+    json << "  \"threadedInterpolations\": " << result.threadedInterpolationCount << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"runs\": [\n";
+    for (size_t i = 0; i < result.runs.size(); i++)
+    {
+        const SimulationBenchmarkRun& run = result.runs[i];
+        json << "    {\n";
+        json << "      \"render\": \"" << run.name << "\",\n";
+        json << "      \"frames\": " << run.frameCount << ",\n";
+        json << "      \"steps\": " << run.stepCount << ",\n";
+        json << "      \"state\": \"" << FormatChecksum(run.stateHash) << "\",\n";
+        json << "      \"msPerStep\": " << run.millisecondsPerStep << ",\n";
+        json << "      \"bodiesInterpolatedPerMs\": " << (run.interpolate.mean > 0.0 ? result.bodyCount / run.interpolate.mean : 0.0) << ",\n";
+        json << "      \"advance\": ";
+        writeTimes(json, run.advance);
+        json << ",\n      \"interpolate\": ";
+        writeTimes(json, run.interpolate);
+        json << "\n    }" << ((i + 1 < result.runs.size()) ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+MeshBenchmarkResult RunMeshBenchmark(const std::wstring& path, UINT threadCount, UINT passCount)
+{
+    // A million triangles.
+    const UINT SphereRings = 500;
+    const UINT SphereSegments = 1000;
+
+    MeshBenchmarkResult result = {};
+    result.threadCount = threadCount;
+    result.passCount = passCount;
+
+    std::string data;
+    bool glb = false;
+    if (path.empty())
+    {
+        result.source = "generated sphere";
+        data = GenerateSphereObj(SphereRings, SphereSegments, true);
+    }
+    else
+    {
+        char source[MAX_PATH];
+        sprintf_s(source, "%S", path.c_str());
+        result.source = source;
+        const size_t dot = path.find_last_of(L'.');
+        glb = dot != std::wstring::npos && _wcsicmp(path.c_str() + dot, L".glb") == 0;
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            result.error = "Can't open the file";
+            return result;
+        }
+        std::ostringstream text;
+        text << file.rdbuf();
+        data = text.str();
+    }
+    result.sizeInBytes = data.size();
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    // From memory, so the disk isn't timed. A .glb is binary and doesn't split.
+    auto importMesh = [&](UINT importThreadCount, Mesh* pMesh)
+    {
+        return glb ?
+            LoadGlbMesh(reinterpret_cast<const UINT8*>(data.data()), data.size(), pMesh, &result.error) :
+            LoadObjMesh(data.data(), data.size(), importThreadCount, pMesh, &result.error);
+    };
+
+    Mesh mesh;
+    Mesh threadedMesh;
+    std::vector<double> singleThreadTimes, allThreadTimes;
+    result.importsMatch = true;
+    for (UINT pass = 0; pass < passCount; pass++)
+    {
+        const double singleStart = now();
+        if (!importMesh(1, &mesh))
+        {
+            return result;
+        }
+        const double allStart = now();
+        if (!importMesh(threadCount, &threadedMesh))
+        {
+            return result;
+        }
+        const double allEnd = now();
+        singleThreadTimes.push_back(allStart - singleStart);
+        allThreadTimes.push_back(allEnd - allStart);
+        result.importsMatch = result.importsMatch && mesh.indices == threadedMesh.indices && mesh.vertices.size() == threadedMesh.vertices.size() &&
+            memcmp(mesh.vertices.data(), threadedMesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex)) == 0;
+    }
+    result.singleThread = Summarize(singleThreadTimes);
+    result.allThreads = Summarize(allThreadTimes);
+    result.vertexCount = static_cast<UINT>(mesh.vertices.size());
+    result.triangleCount = static_cast<UINT>(mesh.indices.size() / 3);
+    const std::vector<std::array<UINT64, 3>> importedTriangles = GetTriangleSignatures(mesh);
+
+    // The passes OptimizeMesh runs, one at a time.
+    UINT vertexCount = result.vertexCount;
+    auto addStage = [&](const char* name, double milliseconds)
+    {
+        MeshBenchmarkStage stage = {};
+        stage.name = name;
+        stage.milliseconds = milliseconds;
+        stage.cache = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount, VertexCacheSize);
+        stage.fetch = AnalyzeVertexFetch(mesh.indices.data(), mesh.indices.size(), vertexCount, sizeof(QuantizedVertex));
+        result.stages.push_back(stage);
+    };
+    addStage("imported", 0.0);
+
+    double start = now();
+    OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+    addStage("vertexCache", now() - start);
+
+    start = now();
+    OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), vertexCount, OverdrawCacheThreshold);
+    addStage("overdraw", now() - start);
+
+    start = now();
+    vertexCount = OptimizeVertexFetch(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), vertexCount);
+    mesh.vertices.resize(vertexCount);
+    addStage("vertexFetch", now() - start);
+
+    result.trianglesPreserved = GetTriangleSignatures(mesh) == importedTriangles;
+
+    std::vector<UINT8> indexData;
+    result.indexFormat = PackIndexBuffer(mesh.indices, vertexCount, &indexData);
+    result.indexBufferSize = indexData.size();
+    return result;
+}
+
+std::string WriteMeshBenchmarkJson(const MeshBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+    auto megabytesPerSecond = [&result](const BenchmarkTimes& times)
+    {
+        return times.p50 > 0.0 ? result.sizeInBytes / 1e6 / (times.p50 / 1000.0) : 0.0;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"source\": \"" << EscapeJson(result.source) << "\",\n";
+    json << "  \"bytes\": " << result.sizeInBytes << ",\n";
+    json << "  \"threads\": " << result.threadCount << ",\n";
+    json << "  \"passes\": " << result.passCount << ",\n";
+    json << "  \"vertices\": " << result.vertexCount << ",\n";
+    json << "  \"triangles\": " << result.triangleCount << ",\n";
+    json << "  \"importsMatch\": " << (result.importsMatch ? "true" : "false") << ",\n";
+    json << "  \"trianglesPreserved\": " << (result.trianglesPreserved ? "true" : "false") << ",\n";
+    json << "  \"indexBits\": " << (result.indexFormat == DXGI_FORMAT_R16_UINT ? 16 : 32) << ",\n";
+    json << "  \"indexBufferBytes\": " << result.indexBufferSize << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"import\": {\n";
+    json << "    \"singleThreadMBps\": " << megabytesPerSecond(result.singleThread) << ",\n";
+    json << "    \"allThreadsMBps\": " << megabytesPerSecond(result.allThreads) << ",\n";
+    json << "    \"singleThread\": ";
+    writeTimes(json, result.singleThread);
+    json << ",\n    \"allThreads\": ";
+    writeTimes(json, result.allThreads);
+    json << "\n  },\n";
+    json << "  \"vertexCacheSize\": " << VertexCacheSize << ",\n";
+    json << "  \"stages\": [\n";
+    for (size_t i = 0; i < result.stages.size(); i++)
+    {
+        const MeshBenchmarkStage& stage = result.stages[i];
+        json << "    { \"after\": \"" << stage.name << "\", \"ms\": " << stage.milliseconds
+            << ", \"acmr\": " << stage.cache.acmr << ", \"atvr\": " << stage.cache.atvr
+            << ", \"overfetch\": " << stage.fetch.overfetch << " }" << ((i + 1 < result.stages.size()) ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+MeshletBenchmarkResult RunMeshletBenchmark(const std::wstring& path, UINT threadCount, UINT passCount)
+{
+    // The same million-triangle sphere as the mesh benchmark, seen by this many objects.
+    const UINT SphereRings = 500;
+    const UINT SphereSegments = 1000;
+    const UINT ViewCount = 256;
+
+    MeshletBenchmarkResult result = {};
+    result.threadCount = threadCount;
+    result.passCount = passCount;
+    result.viewCount = ViewCount;
+
+    Mesh mesh;
+    if (path.empty())
+    {
+        result.source = "generated sphere";
+        const std::string text = GenerateSphereObj(SphereRings, SphereSegments, false);
+        LoadObjMesh(text.data(), text.size(), threadCount, &mesh, &result.error);
+    }
+    else
+    {
+        char source[MAX_PATH];
+        sprintf_s(source, "%S", path.c_str());
+        result.source = source;
+        LoadMeshFile(path, threadCount, &mesh, &result.error);
+    }
+    if (!result.error.empty())
+    {
+        return result;
+    }
+    // As the sample draws it, so that meshlets follow the vertex cache order.
+    OptimizeMesh(&mesh);
+    result.vertexCount = static_cast<UINT>(mesh.vertices.size());
+    result.triangleCount = static_cast<UINT>(mesh.indices.size() / 3);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    MeshletData meshlets;
+    MeshletData threadedMeshlets;
+    std::vector<double> singleThreadTimes, allThreadTimes;
+    result.buildsMatch = true;
+    for (UINT pass = 0; pass < passCount; pass++)
+    {
+        const double singleStart = now();
+        BuildMeshlets(mesh, 1, &meshlets);
+        const double allStart = now();
+        BuildMeshlets(mesh, threadCount, &threadedMeshlets);
+        const double allEnd = now();
+        singleThreadTimes.push_back(allStart - singleStart);
+        allThreadTimes.push_back(allEnd - allStart);
+        result.buildsMatch = result.buildsMatch && meshlets.vertices == threadedMeshlets.vertices && meshlets.triangles == threadedMeshlets.triangles &&
+            meshlets.meshlets.size() == threadedMeshlets.meshlets.size() &&
+            memcmp(meshlets.meshlets.data(), threadedMeshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(Meshlet)) == 0 &&
+            memcmp(meshlets.bounds.data(), threadedMeshlets.bounds.data(), meshlets.bounds.size() * sizeof(MeshletBounds)) == 0;
+    }
+    result.buildSingleThread = Summarize(singleThreadTimes);
+    result.buildAllThreads = Summarize(allThreadTimes);
+    const UINT meshletCount = static_cast<UINT>(meshlets.meshlets.size());
+    result.meshletCount = meshletCount;
+
+    // Within the limits, and in order, each meshlet's triangles the index buffer's next ones.
+    result.meshletsValid = true;
+    UINT nextIndex = 0;
+    for (const Meshlet& meshlet : meshlets.meshlets)
+    {
+        result.meshletsValid = result.meshletsValid && meshlet.triangleOffset == nextIndex &&
+            meshlet.vertexCount <= MeshletMaxVertices && meshlet.triangleCount <= MeshletMaxTriangles;
+        for (UINT i = 0; i < meshlet.triangleCount * 3 && result.meshletsValid; i++)
+        {
+            const UINT8 localIndex = meshlets.triangles[meshlet.triangleOffset + i];
+            result.meshletsValid = localIndex < meshlet.vertexCount &&
+                meshlets.vertices[meshlet.vertexOffset + localIndex] == mesh.indices[meshlet.triangleOffset + i];
+        }
+        nextIndex += meshlet.triangleCount * 3;
+        result.averageMeshletVertices += meshlet.vertexCount;
+        result.averageMeshletTriangles += meshlet.triangleCount;
+    }
+    result.meshletsValid = result.meshletsValid && nextIndex == mesh.indices.size();
+    result.averageMeshletVertices /= max(meshletCount, 1u);
+    result.averageMeshletTriangles /= max(meshletCount, 1u);
+
+    // Objects around the mesh's bounds: half through a perspective camera, scattered
+    // in front of it and past the edges of its view; half through the sample's static
+    // clip space view, which is orthographic. Each is turned so that a different side
+    // faces the eye.
+    XMVECTOR minimum = XMLoadFloat3(&mesh.vertices[0].position);
+    XMVECTOR maximum = minimum;
+    for (const MeshVertex& vertex : mesh.vertices)
+    {
+        minimum = XMVectorMin(minimum, XMLoadFloat3(&vertex.position));
+        maximum = XMVectorMax(maximum, XMLoadFloat3(&vertex.position));
+    }
+    const XMVECTOR meshCenter = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+    const float meshRadius = max(XMVectorGetX(XMVector3Length(XMVectorSubtract(maximum, minimum))) * 0.5f, 1e-6f);
+    const XMMATRIX centered = XMMatrixTranslationFromVector(XMVectorNegate(meshCenter)) * XMMatrixScaling(1.0f / meshRadius, 1.0f / meshRadius, 1.0f / meshRadius);
+    const XMMATRIX perspective = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f);
+
+    std::mt19937 random(48);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<MeshletCullView> views(ViewCount);
+    std::vector<XMMATRIX> objectToClip(ViewCount);
+    for (UINT i = 0; i < ViewCount; i++)
+    {
+        const XMMATRIX rotation = XMMatrixRotationX(XM_2PI * unit(random)) * XMMatrixRotationZ(XM_2PI * unit(random));
+        if (i % 2)
+        {
+            const float depth = 3.0f + 27.0f * unit(random);
+            objectToClip[i] = centered * rotation * XMMatrixTranslation(depth * (unit(random) - 0.5f), depth * (unit(random) - 0.5f), depth) * perspective;
+        }
+        else
+        {
+            objectToClip[i] = centered * XMMatrixScaling(0.2f, 0.2f, 0.2f) * rotation * XMMatrixTranslation(2.4f * unit(random) - 1.2f, 2.4f * unit(random) - 1.2f, 0.5f);
+        }
+        views[i] = GetMeshletCullView(objectToClip[i]);
+    }
+
+    // Every view's meshlets, on one thread and shared out over every thread.
+    BenchmarkWorkers workers(threadCount);
+    std::vector<std::vector<DrawIndexRange>> threadRanges(threadCount);
+    std::vector<UINT> threadVisibleCounts(threadCount);
+    auto cullViews = [&](UINT thread, UINT step)
+    {
+        threadRanges[thread].clear();
+        threadVisibleCounts[thread] = 0;
+        for (UINT i = thread; i < ViewCount; i += step)
+        {
+            threadVisibleCounts[thread] += CullMeshlets(meshlets, 0, views[i], &threadRanges[thread]);
+        }
+    };
+    singleThreadTimes.clear();
+    allThreadTimes.clear();
+    for (UINT pass = 0; pass < passCount; pass++)
+    {
+        const double singleStart = now();
+        cullViews(0, 1);
+        const double allStart = now();
+        workers.Run([&](UINT thread) { cullViews(thread, threadCount); });
+        const double allEnd = now();
+        singleThreadTimes.push_back(allStart - singleStart);
+        allThreadTimes.push_back(allEnd - allStart);
+    }
+    result.cullSingleThread = Summarize(singleThreadTimes);
+    result.cullAllThreads = Summarize(allThreadTimes);
+
+    // Whatever was culled must be invisible: every vertex outside one plane of the clip
+    // volume, or every triangle facing away. Clockwise front faces give a negative
+    // determinant of their clip space x, y and w, whichever side of the eye they are.
+    result.cullingConservative = true;
+    UINT64 visibleMeshlets = 0;
+    UINT64 visibleTriangles = 0;
+    UINT64 rangeCount = 0;
+    std::vector<DrawIndexRange> ranges;
+    std::vector<XMFLOAT4> clipPositions(mesh.vertices.size());
+    std::vector<bool> drawn(meshletCount);
+    for (UINT i = 0; i < ViewCount && result.cullingConservative; i++)
+    {
+        ranges.clear();
+        visibleMeshlets += CullMeshlets(meshlets, 0, views[i], &ranges);
+        rangeCount += ranges.size();
+        std::fill(drawn.begin(), drawn.end(), false);
+        UINT next = 0;
+        for (const DrawIndexRange& range : ranges)
+        {
+            visibleTriangles += range.indexCount / 3;
+            while (meshlets.meshlets[next].triangleOffset < range.firstIndex)
+            {
+                next++;
+            }
+            for (; next < meshletCount && meshlets.meshlets[next].triangleOffset < range.firstIndex + range.indexCount; next++)
+            {
+                drawn[next] = true;
+            }
+        }
+
+        for (size_t v = 0; v < mesh.vertices.size(); v++)
+        {
+            XMStoreFloat4(&clipPositions[v], XMVector3Transform(XMLoadFloat3(&mesh.vertices[v].position), objectToClip[i]));
+        }
+        for (UINT m = 0; m < meshletCount && result.cullingConservative; m++)
+        {
+            if (drawn[m])
+            {
+                continue;
+            }
+            const Meshlet& meshlet = meshlets.meshlets[m];
+            const UINT32* pVertices = meshlets.vertices.data() + meshlet.vertexOffset;
+            bool outside = false;
+            for (UINT plane = 0; plane < 6 && !outside; plane++)
+            {
+                outside = true;
+                for (UINT v = 0; v < meshlet.vertexCount && outside; v++)
+                {
+                    const XMFLOAT4& p = clipPositions[pVertices[v]];
+                    const float distances[6] = { p.w + p.x, p.w - p.x, p.w + p.y, p.w - p.y, p.z, p.w - p.z };
+                    outside = distances[plane] <= 1e-5f * fabsf(p.w);
+                }
+            }
+            bool facingAway = true;
+            for (UINT t = 0; t < meshlet.triangleCount && !outside && facingAway; t++)
+            {
+                const XMFLOAT4& a = clipPositions[pVertices[meshlets.triangles[meshlet.triangleOffset + t * 3]]];
+                const XMFLOAT4& b = clipPositions[pVertices[meshlets.triangles[meshlet.triangleOffset + t * 3 + 1]]];
+                const XMFLOAT4& c = clipPositions[pVertices[meshlets.triangles[meshlet.triangleOffset + t * 3 + 2]]];
+                const double determinant = static_cast<double>(a.x) * (static_cast<double>(b.y) * c.w - static_cast<double>(b.w) * c.y)
+                    - static_cast<double>(a.y) * (static_cast<double>(b.x) * c.w - static_cast<double>(b.w) * c.x)
+                    + static_cast<double>(a.w) * (static_cast<double>(b.x) * c.y - static_cast<double>(b.y) * c.x);
+                const double scale = XMVectorGetX(XMVector4Length(XMLoadFloat4(&a))) * XMVectorGetX(XMVector4Length(XMLoadFloat4(&b))) * XMVectorGetX(XMVector4Length(XMLoadFloat4(&c)));
+                facingAway = determinant >= -1e-4 * scale;
+            }
+            result.cullingConservative = outside || facingAway;
+        }
+    }
+    result.visibleMeshletFraction = static_cast<double>(visibleMeshlets) / (static_cast<double>(meshletCount) * ViewCount);
+    result.visibleTriangleFraction = static_cast<double>(visibleTriangles) / (static_cast<double>(result.triangleCount) * ViewCount);
+    result.averageRangesPerView = static_cast<double>(rangeCount) / ViewCount;
+    return result;
+}
+
+std::string WriteMeshletBenchmarkJson(const MeshletBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+    auto perSecond = [](double count, const BenchmarkTimes& times)
+    {
+        return times.p50 > 0.0 ? count / 1e6 / (times.p50 / 1000.0) : 0.0;
+    };
+    const double culledMeshlets = static_cast<double>(result.meshletCount) * result.viewCount;
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"source\": \"" << EscapeJson(result.source) << "\",\n";
+    json << "  \"threads\": " << result.threadCount << ",\n";
+    json << "  \"passes\": " << result.passCount << ",\n";
+    json << "  \"vertices\": " << result.vertexCount << ",\n";
+    json << "  \"triangles\": " << result.triangleCount << ",\n";
+    json << "  \"maxVertices\": " << MeshletMaxVertices << ",\n";
+    json << "  \"maxTriangles\": " << MeshletMaxTriangles << ",\n";
+    json << "  \"meshlets\": " << result.meshletCount << ",\n";
+    json << "  \"averageVertices\": " << result.averageMeshletVertices << ",\n";
+    json << "  \"averageTriangles\": " << result.averageMeshletTriangles << ",\n";
+    json << "  \"buildsMatch\": " << (result.buildsMatch ? "true" : "false") << ",\n";
+    json << "  \"meshletsValid\": " << (result.meshletsValid ? "true" : "false") << ",\n";
+    json << "  \"cullingConservative\": " << (result.cullingConservative ? "true" : "false") << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"build\": {\n";
+    json << "    \"singleThreadMtrisPerSecond\": " << perSecond(result.triangleCount, result.buildSingleThread) << ",\n";
+    json << "    \"allThreadsMtrisPerSecond\": " << perSecond(result.triangleCount, result.buildAllThreads) << ",\n";
+    json << "    \"singleThread\": ";
+    writeTimes(json, result.buildSingleThread);
+    json << ",\n    \"allThreads\": ";
+    writeTimes(json, result.buildAllThreads);
+    json << "\n  },\n";
+    json << "  \"cull\": {\n";
+    json << "    \"views\": " << result.viewCount << ",\n";
+    json << "    \"visibleMeshlets\": " << result.visibleMeshletFraction << ",\n";
+    json << "    \"visibleTriangles\": " << result.visibleTriangleFraction << ",\n";
+    json << "    \"rangesPerView\": " << result.averageRangesPerView << ",\n";
+    json << "    \"singleThreadMmeshletsPerSecond\": " << perSecond(culledMeshlets, result.cullSingleThread) << ",\n";
+    json << "    \"allThreadsMmeshletsPerSecond\": " << perSecond(culledMeshlets, result.cullAllThreads) << ",\n";
+    json << "    \"singleThread\": ";
+    writeTimes(json, result.cullSingleThread);
+    json << ",\n    \"allThreads\": ";
+    writeTimes(json, result.cullAllThreads);
+    json << "\n  }\n}\n";
+    return json.str();
+}
+
+LodBenchmarkResult RunLodBenchmark(const std::wstring& path, UINT threadCount, UINT objectCount, UINT frameCount, UINT passCount)
+{
+    // A quarter-million-triangle sphere; simplifying takes far longer than importing.
+    const UINT SphereRings = 250;
+    const UINT SphereSegments = 500;
+    // A 1080p view with a 45 degree field of view, the objects between these distances.
+    const float ViewportWidth = 1920.0f;
+    const float ViewportHeight = 1080.0f;
+    const float NearestDistance = 2.0f;
+    const float FarthestDistance = 400.0f;
+    // How far each object drifts from its distance and back, and how much that jitters
+    // from frame to frame: less than the hysteresis, as camera shake or animation would.
+    const float DriftAmplitude = 0.5f;
+    const float DistanceJitter = 0.02f;
+
+    LodBenchmarkResult result = {};
+    result.threadCount = threadCount;
+    result.passCount = passCount;
+    result.objectCount = objectCount;
+    result.frameCount = frameCount;
+
+    Mesh mesh;
+    if (path.empty())
+    {
+        result.source = "generated sphere";
+        const std::string text = GenerateSphereObj(SphereRings, SphereSegments, false);
+        LoadObjMesh(text.data(), text.size(), threadCount, &mesh, &result.error);
+    }
+    else
+    {
+        char source[MAX_PATH];
+        sprintf_s(source, "%S", path.c_str());
+        result.source = source;
+        LoadMeshFile(path, threadCount, &mesh, &result.error);
+    }
+    if (!result.error.empty())
+    {
+        return result;
+    }
+    // As the sample draws it.
+    OptimizeMesh(&mesh);
+    result.vertexCount = static_cast<UINT>(mesh.vertices.size());
+    result.triangleCount = static_cast<UINT>(mesh.indices.size() / 3);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    Mesh lodMesh;
+    std::vector<double> simplifyTimes;
+    for (UINT pass = 0; pass < passCount; pass++)
+    {
+        lodMesh = mesh;
+        const double start = now();
+        BuildMeshLods(&lodMesh, MaxLodCount);
+        simplifyTimes.push_back(now() - start);
+    }
+    result.simplify = Summarize(simplifyTimes);
+
+    const std::vector<MeshLod>& lods = lodMesh.lods;
+    result.lodsValid = !lods.empty() && lods[0].firstIndex == 0 && lods[0].indexCount == mesh.indices.size() &&
+        std::equal(mesh.indices.begin(), mesh.indices.end(), lodMesh.indices.begin());
+    for (size_t lod = 1; lod < lods.size() && result.lodsValid; lod++)
+    {
+        result.lodsValid = lods[lod].firstIndex == lods[lod - 1].firstIndex + lods[lod - 1].indexCount && lods[lod].indexCount % 3 == 0 &&
+            lods[lod].indexCount < lods[lod - 1].indexCount && lods[lod].error >= lods[lod - 1].error && lods[lod].error <= MaxLodError;
+        for (UINT i = 0; i < lods[lod].indexCount && result.lodsValid; i++)
+        {
+            result.lodsValid = lodMesh.indices[lods[lod].firstIndex + i] < result.vertexCount;
+        }
+    }
+    result.lodsValid = result.lodsValid && lodMesh.indices.size() == lods.back().firstIndex + lods.back().indexCount;
+    if (!result.lodsValid)
+    {
+        return result;
+    }
+
+    // The errors are relative to half the diagonal of the mesh's bounds.
+    XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+    for (const MeshVertex& vertex : mesh.vertices)
+    {
+        minimum = XMVectorMin(minimum, XMLoadFloat3(&vertex.position));
+        maximum = XMVectorMax(maximum, XMLoadFloat3(&vertex.position));
+    }
+    const float meshRadius = 0.5f * XMVectorGetX(XMVector3Length(XMVectorSubtract(maximum, minimum)));
+
+    std::vector<float> lodErrors;
+    for (const MeshLod& lod : lods)
+    {
+        lodErrors.push_back(lod.error);
+    }
+    const UINT lodCount = static_cast<UINT>(lods.size());
+    LodSelector selector;
+    LodSelector unsteadySelector;
+    selector.Reset(lodErrors.data(), lodCount, objectCount, meshRadius, LodHysteresis);
+    unsteadySelector.Reset(lodErrors.data(), lodCount, objectCount, meshRadius, 0.0f);
+
+    // The camera at the origin looking down +z, so an object's clip space w is its z.
+    const XMMATRIX viewProjection = XMMatrixPerspectiveFovLH(XM_PIDIV4, ViewportWidth / ViewportHeight, 0.1f, 1000.0f);
+    const D3D12_VIEWPORT viewport = { 0.0f, 0.0f, ViewportWidth, ViewportHeight, 0.0f, 1.0f };
+    const double pixelsPerRadiusAtUnitW = meshRadius * XMVectorGetY(viewProjection.r[1]) * 0.5 * ViewportHeight;
+
+    // Spread evenly over the logarithm of the distance, as over the screen sizes.
+    struct LodBenchmarkObject
+    {
+        float x, y;                     // At a distance of 1.
+        float distance;
+        float phase;
+        float radiansPerFrame;
+    };
+    std::mt19937 random(49);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<LodBenchmarkObject> objects(objectCount);
+    for (LodBenchmarkObject& object : objects)
+    {
+        object.x = (unit(random) * 2.0f - 1.0f) * 0.6f;
+        object.y = (unit(random) * 2.0f - 1.0f) * 0.35f;
+        object.distance = NearestDistance * powf(FarthestDistance / NearestDistance, unit(random));
+        object.phase = unit(random) * XM_2PI;
+        object.radiansPerFrame = XM_2PI / (200.0f + 400.0f * unit(random));
+    }
+
+    // Counts the LODs past 0 good enough for an object this many pixels across.
+    auto countCoarserLods = [&selector, lodCount](double radius)
+    {
+        UINT count = 0;
+        for (UINT lod = 1; lod < lodCount; lod++)
+        {
+            count += radius <= selector.GetSwitchRadius(lod) ? 1 : 0;
+        }
+        return count;
+    };
+
+    std::vector<XMFLOAT4> positions(objectCount);
+    std::vector<UINT> lastLods(objectCount, 0);
+    std::vector<UINT> lastUnsteadyLods(objectCount, 0);
+    std::vector<UINT64> lodObjects(lodCount, 0);
+    std::vector<double> selectTimes;
+    UINT64 drawnTriangles = 0;
+    UINT64 switches = 0;
+    UINT64 unsteadySwitches = 0;
+    const double Tolerance = 1e-4;
+    result.selectionInBand = true;
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        for (UINT i = 0; i < objectCount; i++)
+        {
+            const LodBenchmarkObject& object = objects[i];
+            const float drift = 1.0f + DriftAmplitude * sinf(object.phase + object.radiansPerFrame * frame);
+            const float jitter = 1.0f + DistanceJitter * (unit(random) * 2.0f - 1.0f);
+            const float distance = object.distance * drift * jitter;
+            positions[i] = XMFLOAT4(object.x * distance, object.y * distance, distance, 0.0f);
+        }
+
+        const double start = now();
+        selector.Update(positions.data(), viewProjection, viewport);
+        selectTimes.push_back(now() - start);
+        unsteadySelector.Update(positions.data(), viewProjection, viewport);
+
+        for (UINT i = 0; i < objectCount; i++)
+        {
+            const UINT lod = selector.GetLod(i);
+            const UINT unsteadyLod = unsteadySelector.GetLod(i);
+            if (frame > 0)
+            {
+                switches += lod != lastLods[i] ? 1 : 0;
+                unsteadySwitches += unsteadyLod != lastUnsteadyLods[i] ? 1 : 0;
+            }
+            lastLods[i] = lod;
+            lastUnsteadyLods[i] = unsteadyLod;
+            lodObjects[lod]++;
+            drawnTriangles += lods[lod].indexCount / 3;
+
+            const double radius = pixelsPerRadiusAtUnitW / positions[i].z;
+            result.selectionInBand = result.selectionInBand &&
+                countCoarserLods(radius * (1.0 + LodHysteresis) * (1.0 + Tolerance)) <= lod && lod <= countCoarserLods(radius * (1.0 - LodHysteresis) * (1.0 - Tolerance)) &&
+                countCoarserLods(radius * (1.0 + Tolerance)) <= unsteadyLod && unsteadyLod <= countCoarserLods(radius * (1.0 - Tolerance));
+        }
+    }
+    result.select = Summarize(selectTimes);
+
+    const double pickCount = static_cast<double>(objectCount) * frameCount;
+    for (UINT lod = 0; lod < lodCount; lod++)
+    {
+        LodBenchmarkLevel level = {};
+        level.triangleCount = lods[lod].indexCount / 3;
+        level.error = lods[lod].error;
+        level.switchRadius = lod > 0 ? selector.GetSwitchRadius(lod) : 0.0f;
+        level.objectFraction = lodObjects[lod] / pickCount;
+        result.levels.push_back(level);
+    }
+    result.drawnTriangleFraction = drawnTriangles / (pickCount * result.triangleCount);
+    const double switchFrameCount = max(frameCount - 1, 1u);
+    result.switchesPerFrame = switches / switchFrameCount;
+    result.switchesPerFrameWithoutHysteresis = unsteadySwitches / switchFrameCount;
+    return result;
+}
+
+std::string WriteLodBenchmarkJson(const LodBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+    auto perSecond = [](double count, const BenchmarkTimes& times)
+    {
+        return times.p50 > 0.0 ? count / 1e6 / (times.p50 / 1000.0) : 0.0;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"source\": \"" << EscapeJson(result.source) << "\",\n";
+    json << "  \"passes\": " << result.passCount << ",\n";
+    json << "  \"vertices\": " << result.vertexCount << ",\n";
+    json << "  \"triangles\": " << result.triangleCount << ",\n";
+    json << "  \"maxError\": " << MaxLodError << ",\n";
+    json << "  \"lodsValid\": " << (result.lodsValid ? "true" : "false") << ",\n";
+    json << "  \"selectionInBand\": " << (result.selectionInBand ? "true" : "false") << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"simplify\": {\n";
+    json << "    \"mtrisPerSecond\": " << perSecond(result.triangleCount, result.simplify) << ",\n";
+    json << "    \"times\": ";
+    writeTimes(json, result.simplify);
+    json << "\n  },\n";
+    json << "  \"lods\": [\n";
+    for (size_t i = 0; i < result.levels.size(); i++)
+    {
+        const LodBenchmarkLevel& level = result.levels[i];
+        json << "    { \"triangles\": " << level.triangleCount << ", \"error\": " << level.error
+            << ", \"switchRadiusPixels\": " << level.switchRadius << ", \"objects\": " << level.objectFraction << " }"
+            << ((i + 1 < result.levels.size()) ? ",\n" : "\n");
+    }
+    json << "  ],\n";
+    json << "  \"select\": {\n";
+    json << "    \"objects\": " << result.objectCount << ",\n";
+    json << "    \"frames\": " << result.frameCount << ",\n";
+    json << "    \"maxErrorPixels\": " << MaxLodErrorPixels << ",\n";
+    json << "    \"hysteresis\": " << LodHysteresis << ",\n";
+    json << "    \"drawnTriangles\": " << result.drawnTriangleFraction << ",\n";
+    json << "    \"switchesPerFrame\": " << result.switchesPerFrame << ",\n";
+    json << "    \"switchesPerFrameWithoutHysteresis\": " << result.switchesPerFrameWithoutHysteresis << ",\n";
+    json << "    \"mobjectsPerSecond\": " << perSecond(result.objectCount, result.select) << ",\n";
+    json << "    \"times\": ";
+    writeTimes(json, result.select);
+    json << "\n  }\n}\n";
+    return json.str();
+}
+
+QuantizationBenchmarkResult RunQuantizationBenchmark(const std::wstring& path, UINT threadCount, UINT passCount)
+{
+    // The same million-triangle sphere as the mesh benchmark, but without normals, so
+    // that they are rebuilt.
+    const UINT SphereRings = 500;
+    const UINT SphereSegments = 1000;
+    // Sixteen-bit octahedral normals land within a few thousandths of a degree.
+    const float MaxNormalErrorDegrees = 0.01f;
+
+    QuantizationBenchmarkResult result = {};
+    result.threadCount = threadCount;
+    result.passCount = passCount;
+
+    Mesh mesh;
+    if (path.empty())
+    {
+        result.source = "generated sphere";
+        const std::string text = GenerateSphereObj(SphereRings, SphereSegments, false);
+        LoadObjMesh(text.data(), text.size(), threadCount, &mesh, &result.error);
+    }
+    else
+    {
+        char source[MAX_PATH];
+        sprintf_s(source, "%S", path.c_str());
+        result.source = source;
+        LoadMeshFile(path, threadCount, &mesh, &result.error);
+    }
+    if (!result.error.empty())
+    {
+        return result;
+    }
+    // As the sample draws it.
+    OptimizeMesh(&mesh);
+    result.vertexCount = static_cast<UINT>(mesh.vertices.size());
+    result.importedNormals = mesh.importedNormals;
+    result.floatBytes = static_cast<UINT64>(result.vertexCount) * sizeof(MeshVertex);
+    result.quantizedBytes = static_cast<UINT64>(result.vertexCount) * sizeof(QuantizedVertex);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double millisecondsPerTick = 1000.0 / frequency.QuadPart;
+    auto now = [&]()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart * millisecondsPerTick;
+    };
+
+    QuantizedMesh quantized;
+    QuantizedMesh threadedQuantized;
+    std::vector<double> normalTimes, singleThreadTimes, allThreadTimes;
+    result.quantizationsMatch = true;
+    for (UINT pass = 0; pass < passCount; pass++)
+    {
+        // As the sample does, the file's normals are kept if it has them.
+        if (!mesh.importedNormals)
+        {
+            const double normalStart = now();
+            ComputeVertexNormals(&mesh);
+            normalTimes.push_back(now() - normalStart);
+        }
+        const double singleStart = now();
+        QuantizeMesh(mesh, 1, &quantized);
+        const double allStart = now();
+        QuantizeMesh(mesh, threadCount, &threadedQuantized);
+        const double allEnd = now();
+        singleThreadTimes.push_back(allStart - singleStart);
+        allThreadTimes.push_back(allEnd - allStart);
+        result.quantizationsMatch = result.quantizationsMatch && quantized.vertices.size() == threadedQuantized.vertices.size() &&
+            memcmp(quantized.vertices.data(), threadedQuantized.vertices.data(), quantized.vertices.size() * sizeof(QuantizedVertex)) == 0 &&
+            memcmp(&quantized.dequantization, &threadedQuantized.dequantization, sizeof(VertexDequantization)) == 0 &&
+            memcmp(&quantized.error, &threadedQuantized.error, sizeof(QuantizationError)) == 0;
+    }
+    result.normals = Summarize(normalTimes);
+    result.singleThread = Summarize(singleThreadTimes);
+    result.allThreads = Summarize(allThreadTimes);
+    result.quantizationError = quantized.error;
+
+    // Rounding to the nearest step moves each coordinate at most half a step, a 65535th
+    // of the extent: a position at most a 65535th of the radius. Float rounding gets a
+    // little leeway.
+    const XMFLOAT4& uvScaleOffset = quantized.dequantization.uvScaleOffset;
+    const float uvHalfStep = 0.5f * max(uvScaleOffset.x, uvScaleOffset.y) / 65535.0f;
+    result.errorWithinStep = quantized.error.position <= 1.01f / 65535.0f && quantized.error.uv <= uvHalfStep * 1.01f + 1e-7f &&
+        quantized.error.normalDegrees <= MaxNormalErrorDegrees;
+    return result;
+}
+
+std::string WriteQuantizationBenchmarkJson(const QuantizationBenchmarkResult& result)
+{
+    auto writeTimes = [](std::ostringstream& json, const BenchmarkTimes& times)
+    {
+        char text[192];
+        sprintf_s(text, "{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            times.mean, times.p50, times.p90, times.p99, times.max);
+        json << text;
+    };
+    auto perSecond = [](double count, const BenchmarkTimes& times)
+    {
+        return times.p50 > 0.0 ? count / 1e6 / (times.p50 / 1000.0) : 0.0;
+    };
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"source\": \"" << EscapeJson(result.source) << "\",\n";
+    json << "  \"threads\": " << result.threadCount << ",\n";
+    json << "  \"passes\": " << result.passCount << ",\n";
+    json << "  \"vertices\": " << result.vertexCount << ",\n";
+    json << "  \"importedNormals\": " << (result.importedNormals ? "true" : "false") << ",\n";
+    json << "  \"quantizationsMatch\": " << (result.quantizationsMatch ? "true" : "false") << ",\n";
+    json << "  \"errorWithinStep\": " << (result.errorWithinStep ? "true" : "false") << ",\n";
+    json << "  \"memory\": {\n";
+    json << "    \"floatBytes\": " << result.floatBytes << ",\n";
+    json << "    \"quantizedBytes\": " << result.quantizedBytes << ",\n";
+    json << "    \"stride\": " << sizeof(QuantizedVertex) << "\n";
+    json << "  },\n";
+    json << "  \"error\": {\n";
+    json << "    \"positionOfRadius\": " << result.quantizationError.position << ",\n";
+    json << "    \"uv\": " << result.quantizationError.uv << ",\n";
+    json << "    \"normalDegrees\": " << result.quantizationError.normalDegrees << "\n";
+    json << "  },\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"normals\": ";
+    writeTimes(json, result.normals);
+    json << ",\n";
+    json << "  \"quantize\": {\n";
+    json << "    \"singleThreadMverticesPerSecond\": " << perSecond(result.vertexCount, result.singleThread) << ",\n";
+    json << "    \"allThreadsMverticesPerSecond\": " << perSecond(result.vertexCount, result.allThreads) << ",\n";
+    json << "    \"singleThread\": ";
+    writeTimes(json, result.singleThread);
+    json << ",\n    \"allThreads\": ";
+    writeTimes(json, result.allThreads);
+    json << "\n  }\n}\n";
+    return json.str();
+}
+
+BindingBenchmarkResult RunBindingBenchmark(UINT drawCount, UINT instanceCount)
+{
+    BindingBenchmarkResult result = {};
+    result.drawCount = drawCount;
+    for (UINT i = 0; i < DrawBindingStrategyCount; i++)
+    {
+        result.strategies[i] = MeasureDrawBindingCost(static_cast<DrawBindingStrategy>(i), drawCount, 100);
+    }
+    result.instanceCount = instanceCount;
+    for (UINT i = 0; i < InstanceDataFormatCount; i++)
+    {
+        result.formats[i] = MeasureInstanceUploadCost(static_cast<InstanceDataFormat>(i), instanceCount, 10);
+    }
+    result.translationRange = 16.0f;
+    result.halfError = MeasureInstanceQuantizationError(100000, result.translationRange);
+    return result;
+}
+
+std::string WriteBindingBenchmarkJson(const BindingBenchmarkResult& result)
+{
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"draws\": " << result.drawCount << ",\n";
+    json << "  \"strategies\": [\n";
+    for (UINT i = 0; i < DrawBindingStrategyCount; i++)
+    {
+        const DrawBindingCost& cost = result.strategies[i];
+        json << "    { \"name\": \"" << GetDrawBindingStrategyName(static_cast<DrawBindingStrategy>(i)) << "\", \"nsPerDraw\": " << cost.nanosecondsPerDraw
+            << ", \"bytesPerDraw\": " << cost.bytesPerDraw << " }" << ((i + 1 < DrawBindingStrategyCount) ? ",\n" : "\n");
+    }
+    json << "  ],\n";
+    json << "  \"instances\": " << result.instanceCount << ",\n";
+    json << "  \"formats\": [\n";
+    for (UINT i = 0; i < InstanceDataFormatCount; i++)
+    {
+        const InstanceUploadCost& cost = result.formats[i];
+        json << "    { \"name\": \"" << GetInstanceDataFormatName(static_cast<InstanceDataFormat>(i)) << "\", \"bytesPerObject\": " << cost.bytesPerObject
+            << ", \"bytesWrittenPerObject\": " << cost.bytesWrittenPerObject << ", \"ms\": " << cost.milliseconds
+            << ", \"gigabytesPerSecond\": " << cost.gigabytesPerSecond << " }" << ((i + 1 < InstanceDataFormatCount) ? ",\n" : "\n");
+    }
+    json << "  ],\n";
+    json << "  \"half\": { \"translationRange\": " << result.translationRange << ", \"maxError\": " << result.halfError.maxError
+        << ", \"meanError\": " << result.halfError.meanError << ", \"tolerance\": " << result.halfError.tolerance << " }\n";
+    json << "}\n";
+    return json.str();
+}
+
+PacingBenchmarkResult RunPacingBenchmark(UINT frameCount)
+{
+    PacingBenchmarkResult result = {};
+    result.latencyReduced = true;
+    result.frameRateKept = true;
+
+    const double cpuTimes[] = { 4.0, 12.0 };
+    const double gpuTimes[] = { 6.0, 14.0 };
+    for (UINT workload = 0; workload < _countof(cpuTimes); workload++)
+    {
+        for (UINT i = 0; i <= 2 * FrameCount; i++)
+        {
+            // Unpaced, then paced, at each frame latency.
+            PacingBenchmarkRun run = {};
+            run.scenario.refreshPeriod = 1000.0 / 60.0;
+            run.scenario.maxFrameLatency = (i < 2 * FrameCount) ? i / 2 + 1 : 1;
+            run.scenario.variableRefresh = (i == 2 * FrameCount);
+            run.scenario.pacingEnabled = (i % 2) == 1;
+            run.scenario.cpuTime = cpuTimes[workload];
+            run.scenario.gpuTime = gpuTimes[workload];
+            run.scenario.jitter = 0.2;
+            run.scenario.frameCount = frameCount;
+            run.result = SimulateFramePacing(run.scenario);
+
+            if (run.scenario.pacingEnabled)
+            {
+                const FramePacingResult& unpaced = result.runs.back().result;
+                result.latencyReduced = result.latencyReduced && run.result.averageLatency < unpaced.averageLatency;
+                result.frameRateKept = result.frameRateKept && run.result.averageFrameInterval <= (1.0 + PacingFrameIntervalTolerance) * unpaced.averageFrameInterval;
+            }
+            result.runs.push_back(run);
+        }
+    }
+    return result;
+}
+
+std::string WritePacingBenchmarkJson(const PacingBenchmarkResult& result)
+{
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"latencyReduced\": " << (result.latencyReduced ? "true" : "false") << ",\n";
+    json << "  \"frameRateKept\": " << (result.frameRateKept ? "true" : "false") << ",\n";
+    json << "  \"units\": \"ms\",\n";
+    json << "  \"runs\": [\n";
+    for (size_t i = 0; i < result.runs.size(); i++)
+    {
+        const PacingBenchmarkRun& run = result.runs[i];
+        const char* mode = run.scenario.variableRefresh ? "vrr" : (run.scenario.pacingEnabled ? "paced" : "unpaced");
+        char text[320];
+        sprintf_s(text, "    { \"mode\": \"%s\", \"frameLatency\": %u, \"cpu\": %.1f, \"gpu\": %.1f, \"averageLatency\": %.3f, \"maxLatency\": %.3f, \"frameInterval\": %.3f, \"missed\": %u }",
+            mode, run.scenario.maxFrameLatency, run.scenario.cpuTime, run.scenario.gpuTime,
+            run.result.averageLatency, run.result.maxLatency, run.result.averageFrameInterval, run.result.missedFrameCount);
+        json << text << ((i + 1 < result.runs.size()) ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
@@ -0,0 +1,441 @@
+#pragma once
+#include "stdafx.h"
+#include "Animation.h"
+#include "DrawBinding.h"
+#include "DrawOrder.h"
+#include "FramePacing.h"
+#include "InstanceData.h"
+#include "MeshOptimizer.h"
+#include "OverdrawEstimator.h"
+#include "RenderGraph.h"
+#include <map>
+#include <vector>
+
+// How the benchmark moves the objects from one frame to the next. Every pattern is a
+// function of the frame number only, so runs are repeatable.
+enum BenchmarkMotion
+{
+    BenchmarkMotionStatic = 0,
+    BenchmarkMotionRotate,          // Spin in place, as the sample does; nothing enters or leaves the view.
+    BenchmarkMotionOrbit,           // Circle the origin at different speeds, crossing the view's edges.
+    BenchmarkMotionWander,          // Drift around the start position, in depth too.
+    BenchmarkMotionCount
+};
+
+const char* GetBenchmarkMotionName(BenchmarkMotion motion);
+
+// Read from a scenario file of "key = value" lines; '#' starts a comment.
+//   name, objects, frames, warmup, threads, motion, binding, cull_radius, spread,
+//   seed, tolerance, occlusion, depth, moving, visibility_cache, camera
+// motion, binding and depth take the names GetBenchmarkMotionName,
+// GetDrawBindingStrategyName and GetDepthModeName return; occlusion and
+// visibility_cache are on or off; camera is static or pan.
+struct BenchmarkScenario
+{
+    std::string name;
+    UINT objectCount;
+    UINT frameCount;
+    UINT warmupFrameCount;          // Run before measuring, not reported.
+    UINT threadCount;               // Recording threads, like the sample's NumContexts.
+    BenchmarkMotion motion;
+    DrawBindingStrategy bindingStrategy;
+    float cullRadius;
+    float spread;                   // Objects start within [-spread, spread] in x and y; the view is [-1, 1].
+    UINT seed;
+    double tolerance;               // Allowed slowdown against the baseline, as a fraction.
+    bool occlusion;                 // Drop the objects in view that nearer ones cover, before sorting.
+    DepthMode depthMode;            // How the draws are ordered, and what covers what.
+    float movingFraction;           // Of the objects, evenly spread, that follow motion; the rest stay put.
+    bool visibilityCache;           // Cull with a VisibilityCache instead of testing every object.
+    bool cameraPan;                 // Sweep the view from side to side instead of keeping it on the origin.
+
+    BenchmarkScenario();
+};
+
+// Returns false and describes the problem in error if the file can't be read or
+// has an unknown key or value.
+bool LoadBenchmarkScenario(const std::wstring& path, BenchmarkScenario* pScenario, std::string* pError);
+
+// Milliseconds, over the measured frames.
+struct BenchmarkTimes
+{
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+// The stages of the headless frame, in order.
+enum BenchmarkStage
+{
+    BenchmarkStageUpdate = 0,       // Move the objects and write their transforms.
+    BenchmarkStageCull,             // Every object against the view, or the visibility cache's changes.
+    BenchmarkStageRasterize,        // Every object in view into the occlusion buffer, a band per thread.
+    BenchmarkStageOcclusionTest,    // Each thread tests its share of the objects in view.
+    BenchmarkStageSort,             // SortDrawOrder for the depth mode.
+    BenchmarkStageRecord,           // EncodeDrawList on every thread, a consecutive run of the draws each.
+    BenchmarkStageCount
+};
+
+const char* GetBenchmarkStageName(BenchmarkStage stage);
+
+struct BenchmarkResult
+{
+    BenchmarkTimes frame;
+    BenchmarkTimes stages[BenchmarkStageCount];
+    double averageVisibleCount;
+    double averageOccludedCount;    // Objects in view the occlusion test dropped; already left out of averageVisibleCount.
+    double averageRetestedCount;    // Objects the cull stage tested; all of them without the visibility cache.
+    UINT64 checksum;                // Of the draw lists; equal for equal scenarios, whatever the timing.
+    OverdrawStatistics overdraw[DepthModeCount];    // The last frame's objects in view, drawn in each depth mode.
+};
+
+// Runs the CPU side of the sample's frame, without a device: transform update, cull,
+// occlusion culling if the scenario asks for it, sort and draw recording into
+// HeadlessCommandEncoders, one per thread. The occlusion stages take no time when it
+// is off. Afterwards estimates the last frame's overdraw in every depth mode, outside
+// the measurement.
+BenchmarkResult RunBenchmark(const BenchmarkScenario& scenario);
+
+std::string WriteBenchmarkJson(const BenchmarkScenario& scenario, const BenchmarkResult& result);
+
+// A benchmark result read back from WriteBenchmarkJson's output, as dotted key paths
+// ("frame.p90", "stages.record.p50", "checksum") to values.
+struct BenchmarkBaseline
+{
+    std::map<std::string, double> numbers;
+    std::map<std::string, std::string> strings;
+};
+
+bool ReadBenchmarkBaseline(const std::string& json, BenchmarkBaseline* pBaseline, std::string* pError);
+
+struct BenchmarkRegression
+{
+    std::string metric;
+    double baseline;
+    double current;
+};
+
+// Compares the frame percentiles and each stage's median against the baseline. A
+// metric regresses when it is slower by more than the scenario's tolerance and by
+// more than timer noise. Returns false, with the reason in error, if the runs are not
+// comparable because the baseline did different work.
+bool CompareBenchmarkBaseline(const BenchmarkScenario& scenario, const BenchmarkResult& result, const BenchmarkBaseline& baseline,
+    std::vector<BenchmarkRegression>* pRegressions, std::string* pError);
+
+// Scratch allocation under contention: every thread builds the same short-lived lists
+// each frame, once from the CRT heap and once from its own LinearArena.
+struct AllocatorBenchmarkResult
+{
+    UINT threadCount;
+    UINT frameCount;
+    UINT listsPerFrame;             // Per thread.
+    BenchmarkTimes heap;            // Milliseconds per frame, over every thread.
+    BenchmarkTimes arena;
+    SIZE_T arenaHighWaterMark;
+    UINT64 arenaOverflowCount;
+    bool checksumsMatch;            // Both did the same work.
+};
+
+AllocatorBenchmarkResult RunAllocatorBenchmark(UINT threadCount, UINT frameCount);
+
+std::string WriteAllocatorBenchmarkJson(const AllocatorBenchmarkResult& result);
+
+// The upload ring's bookkeeping alone: a frame's worth of staging allocations of mixed
+// sizes and alignments, FinishFrame, then Retire with the fence of the frame FrameCount
+// back, as the sample does. A frame that runs out of space retires everything in
+// flight, as the sample's wait for the GPU would, and tries again.
+struct RingBenchmarkResult
+{
+    UINT frameCount;
+    UINT allocationsPerFrame;
+    UINT64 capacity;
+    BenchmarkTimes frame;               // Milliseconds per frame.
+    double allocationsPerSecond;        // At the median frame.
+    UINT stallCount;                    // Frames that had to wait for the GPU.
+    UINT wrapCount;                     // Allocations that started over at offset 0.
+    double averageUsedFraction;         // Of the capacity, after each frame's Retire.
+    bool offsetsValid;                  // Every allocation aligned and inside the ring.
+};
+
+RingBenchmarkResult RunRingBenchmark(UINT frameCount);
+
+std::string WriteRingBenchmarkJson(const RingBenchmarkResult& result);
+
+// RenderGraph's CPU cost without a device: a synthetic graph of passCount passes, each
+// writing a transient render target or buffer that some of the next few passes read,
+// recorded in runs on four command lists and composited into the back buffer. Every
+// frame resets the graph, declares it again and compiles it, as FrameResource does.
+// Outputs that nothing reads get culled.
+struct RenderGraphBenchmarkResult
+{
+    UINT passCount;
+    UINT frameCount;
+    BenchmarkTimes frame;                   // Milliseconds for Reset, declaring the graph and Compile.
+    BenchmarkTimes compile;                 // Compile alone.
+    RenderGraph::Statistics statistics;     // Every frame compiles the same graph.
+    bool consistent;                        // Every frame got the same statistics, and aliasing never took more memory.
+};
+
+RenderGraphBenchmarkResult RunRenderGraphBenchmark(UINT passCount, UINT frameCount);
+
+std::string WriteRenderGraphBenchmarkJson(const RenderGraphBenchmarkResult& result);
+
+// The startup cost of the sample's shaders: every ShaderPrograms entry loaded through a
+// ShaderCache with no cache file, which compiles them all and writes one, then loaded
+// again from that file, opening it included.
+struct ShaderCacheBenchmarkResult
+{
+    std::string error;                  // Empty if every shader compiled.
+    UINT programCount;
+    UINT passCount;
+    BenchmarkTimes compiled;            // Milliseconds to load every program.
+    BenchmarkTimes cached;
+    UINT64 cacheFileSize;
+    bool allCached;                     // The second load compiled nothing.
+    bool bytecodeMatches;               // And returned what the compiler had.
+};
+
+// The shaders are read from assetDirectory, where the cache file is written and deleted.
+ShaderCacheBenchmarkResult RunShaderCacheBenchmark(const std::wstring& assetDirectory, UINT passCount);
+
+std::string WriteShaderCacheBenchmarkJson(const ShaderCacheBenchmarkResult& result);
+
+// World transforms of a TransformHierarchy, for the same node count at several depths:
+// updated level by level on every thread after every node moved and after a few
+// subtrees did, against a depth-first walk of a tree of individually allocated nodes.
+struct HierarchyBenchmarkDepth
+{
+    UINT levelCount;
+    BenchmarkTimes full;                // Milliseconds per update, every root turned.
+    BenchmarkTimes partial;             // dirtyNodesPerFrame random nodes turned.
+    BenchmarkTimes pointerTree;         // Every node, on one thread.
+    double averagePartialUpdatedCount;  // Nodes the partial updates recomputed.
+    bool worldTransformsMatch;          // Between the hierarchy and the pointer tree.
+};
+
+struct HierarchyBenchmarkResult
+{
+    UINT nodeCount;
+    UINT threadCount;
+    UINT frameCount;
+    UINT dirtyNodesPerFrame;
+    std::vector<HierarchyBenchmarkDepth> depths;
+};
+
+HierarchyBenchmarkResult RunHierarchyBenchmark(UINT nodeCount, UINT threadCount, UINT frameCount);
+
+std::string WriteHierarchyBenchmarkJson(const HierarchyBenchmarkResult& result);
+
+// Evaluating every object's animation from time: a frame on one thread, and split
+// across every thread, plus MeasureAnimationDrift over an hour at 60 Hz.
+struct AnimationBenchmarkResult
+{
+    UINT objectCount;
+    UINT threadCount;
+    UINT frameCount;
+    BenchmarkTimes singleThread;        // Milliseconds per frame.
+    BenchmarkTimes allThreads;
+    bool framesIndependent;             // Evaluated backwards across threads, every frame matched the in-order run.
+    UINT driftFrameCount;
+    AnimationDriftError drift;
+};
+
+AnimationBenchmarkResult RunAnimationBenchmark(UINT objectCount, UINT threadCount, UINT frameCount);
+
+std::string WriteAnimationBenchmarkJson(const AnimationBenchmarkResult& result);
+
+// FixedStepSimulation driven to the same time by renderers at different frame rates,
+// then on its own thread: every run should end in the same state.
+struct SimulationBenchmarkRun
+{
+    std::string name;                   // The render rate.
+    UINT frameCount;
+    UINT64 stepCount;
+    BenchmarkTimes advance;             // Milliseconds per frame spent stepping.
+    BenchmarkTimes interpolate;
+    double millisecondsPerStep;
+    UINT64 stateHash;                   // Of the final positions.
+};
+
+struct SimulationBenchmarkResult
+{
+    UINT bodyCount;
+    double stepRate;
+    double duration;                    // Simulated seconds.
+    std::vector<SimulationBenchmarkRun> runs;
+    bool deterministic;                 // Every render rate ended in the same state.
+    bool threadedMatches;               // Stepping on its own thread did too.
+    UINT64 threadedInterpolationCount;  // Frames interpolated while it stepped.
+};
+
+SimulationBenchmarkResult RunSimulationBenchmark(UINT bodyCount, UINT frameCount);
+
+std::string WriteSimulationBenchmarkJson(const SimulationBenchmarkResult& result);
+
+// Importing a mesh from memory, on one thread and on every thread, then what each
+// MeshOptimizer pass does to the vertex cache and vertex fetch. With no file, a sphere
+// written out as OBJ text with its triangles shuffled, as an exporter might leave them.
+struct MeshBenchmarkStage
+{
+    std::string name;                   // The pass applied last.
+    double milliseconds;                // The pass's time.
+    VertexCacheStatistics cache;
+    VertexFetchStatistics fetch;
+};
+
+struct MeshBenchmarkResult
+{
+    std::string source;
+    std::string error;                  // Empty if it imported.
+    UINT64 sizeInBytes;
+    UINT threadCount;
+    UINT passCount;
+    BenchmarkTimes singleThread;        // Milliseconds per import.
+    BenchmarkTimes allThreads;
+    bool importsMatch;                  // Every thread count built the same mesh.
+    UINT vertexCount;
+    UINT triangleCount;
+    std::vector<MeshBenchmarkStage> stages;
+    bool trianglesPreserved;            // The optimised mesh draws the same triangles, each with the same winding.
+    DXGI_FORMAT indexFormat;
+    UINT64 indexBufferSize;
+};
+
+MeshBenchmarkResult RunMeshBenchmark(const std::wstring& path, UINT threadCount, UINT passCount);
+
+std::string WriteMeshBenchmarkJson(const MeshBenchmarkResult& result);
+
+// Splitting the vertex cache optimised mesh into meshlets, on one thread and on every
+// thread, then culling them for a few hundred object views, one thread culling them
+// all and every thread a share. Checks that the meshlets draw the mesh's index buffer
+// as it is and that nothing culled could have been seen.
+struct MeshletBenchmarkResult
+{
+    std::string source;
+    std::string error;                  // Empty if it imported.
+    UINT threadCount;
+    UINT passCount;
+    UINT vertexCount;
+    UINT triangleCount;
+    BenchmarkTimes buildSingleThread;   // Milliseconds per build.
+    BenchmarkTimes buildAllThreads;
+    bool buildsMatch;                   // Every thread count built the same meshlets.
+    UINT meshletCount;
+    double averageMeshletVertices;
+    double averageMeshletTriangles;
+    bool meshletsValid;                 // Within the limits, covering the index buffer in order.
+    UINT viewCount;
+    BenchmarkTimes cullSingleThread;    // Milliseconds to cull every view.
+    BenchmarkTimes cullAllThreads;
+    double visibleMeshletFraction;
+    double visibleTriangleFraction;
+    double averageRangesPerView;        // Draws per object after merging neighbours.
+    bool cullingConservative;           // Every culled meshlet was outside the view or facing away.
+};
+
+MeshletBenchmarkResult RunMeshletBenchmark(const std::wstring& path, UINT threadCount, UINT passCount);
+
+std::string WriteMeshletBenchmarkJson(const MeshletBenchmarkResult& result);
+
+// Building the optimised mesh's LOD chain, then picking LODs for objects drifting to
+// and from a perspective camera, jittering a little every frame, with the sample's
+// hysteresis and without. Checks that every LOD has fewer triangles within the error
+// budget and that every pick is one the object's projected size allows.
+struct LodBenchmarkLevel
+{
+    UINT triangleCount;
+    float error;                        // Relative to the mesh's radius.
+    float switchRadius;                 // In pixels; the LOD is picked below it. 0 for LOD 0.
+    double objectFraction;              // Of the objects drawn with it, over every frame.
+};
+
+struct LodBenchmarkResult
+{
+    std::string source;
+    std::string error;                  // Empty if it imported.
+    UINT threadCount;
+    UINT passCount;
+    UINT vertexCount;
+    UINT triangleCount;
+    BenchmarkTimes simplify;            // Milliseconds per LOD chain.
+    std::vector<LodBenchmarkLevel> levels;
+    bool lodsValid;                     // LOD 0 untouched, each next one smaller, no coarser than the one after.
+    UINT objectCount;
+    UINT frameCount;
+    BenchmarkTimes select;              // Milliseconds to pick every object's LOD.
+    double drawnTriangleFraction;       // Of what LOD 0 everywhere would draw.
+    double switchesPerFrame;            // Objects changing LOD, after the first frame.
+    double switchesPerFrameWithoutHysteresis;
+    bool selectionInBand;               // Every pick within the hysteresis of the projected size's.
+};
+
+LodBenchmarkResult RunLodBenchmark(const std::wstring& path, UINT threadCount, UINT objectCount, UINT frameCount, UINT passCount);
+
+std::string WriteLodBenchmarkJson(const LodBenchmarkResult& result);
+
+// Rebuilding the optimised mesh's normals, unless its file has them, and quantising its
+// vertices, on one thread and on every thread, against the float vertices it replaces.
+// Checks that no attribute decodes further than the quantisation step allows.
+struct QuantizationBenchmarkResult
+{
+    std::string source;
+    std::string error;                  // Empty if it imported.
+    UINT threadCount;
+    UINT passCount;
+    UINT vertexCount;
+    bool importedNormals;               // The file's normals were kept, and normals is all zero.
+    BenchmarkTimes normals;             // Milliseconds to rebuild the normals.
+    BenchmarkTimes singleThread;        // Milliseconds per quantisation.
+    BenchmarkTimes allThreads;
+    bool quantizationsMatch;            // Every thread count gave the same vertices.
+    UINT64 floatBytes;                  // As MeshVertex, the same attributes unquantised.
+    UINT64 quantizedBytes;
+    QuantizationError quantizationError;
+    bool errorWithinStep;               // Positions and texture coordinates within half a step, normals within a hundredth of a degree.
+};
+
+QuantizationBenchmarkResult RunQuantizationBenchmark(const std::wstring& path, UINT threadCount, UINT passCount);
+
+std::string WriteQuantizationBenchmarkJson(const QuantizationBenchmarkResult& result);
+
+// How per-object data reaches the GPU: the worker threads' recording cost per draw in
+// every DrawBindingStrategy, writing instanceCount objects' transforms in every
+// InstanceDataFormat, and how far the half-precision format moves a unit cube's corners
+// for translations well beyond the scene's.
+struct BindingBenchmarkResult
+{
+    UINT drawCount;
+    DrawBindingCost strategies[DrawBindingStrategyCount];
+    UINT instanceCount;
+    InstanceUploadCost formats[InstanceDataFormatCount];
+    float translationRange;
+    InstanceQuantizationError halfError;
+};
+
+BindingBenchmarkResult RunBindingBenchmark(UINT drawCount, UINT instanceCount);
+
+std::string WriteBindingBenchmarkJson(const BindingBenchmarkResult& result);
+
+// FramePacer against a SimulatedDisplay at 60 Hz, for a frame that fits in a refresh
+// and one whose CPU and GPU work have to overlap: unpaced and paced at every frame
+// latency up to FrameCount, then without vsync on a variable refresh display.
+struct PacingBenchmarkRun
+{
+    FramePacingScenario scenario;
+    FramePacingResult result;
+};
+
+struct PacingBenchmarkResult
+{
+    std::vector<PacingBenchmarkRun> runs;
+    bool latencyReduced;                // Every paced run's average latency below the unpaced run's at its frame latency.
+    bool frameRateKept;                 // And its frame interval within PacingFrameIntervalTolerance of it.
+};
+
+const double PacingFrameIntervalTolerance = 0.05;
+
+PacingBenchmarkResult RunPacingBenchmark(UINT frameCount);
+
+std::string WritePacingBenchmarkJson(const PacingBenchmarkResult& result);
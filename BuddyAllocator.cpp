@@ -0,0 +1,142 @@
+#include "BuddyAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    inline uint64_t NextPowerOfTwo(uint64_t value)
+    {
+        uint64_t result = 1;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    inline unsigned Log2(uint64_t value)
+    {
+        unsigned result = 0;
+        while (value > 1)
+        {
+            value >>= 1;
+            result++;
+        }
+        return result;
+    }
+}
+
+BuddyAllocator::BuddyAllocator(uint64_t size, uint64_t minBlockSize) :
+    m_size(size),
+    m_usedSize(0),
+    m_levelCount(Log2(size / minBlockSize) + 1)
+{
+    assert((size & (size - 1)) == 0);
+    assert((minBlockSize & (minBlockSize - 1)) == 0);
+    assert(minBlockSize <= size);
+
+    m_freeBlocks.resize(m_levelCount);
+    m_freeBlocks[0].insert(0);
+}
+
+uint64_t BuddyAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    const uint64_t minBlockSize = BlockSize(m_levelCount - 1);
+    uint64_t blockSize = NextPowerOfTwo(std::max(std::max(size, alignment), minBlockSize));
+    if (size == 0 || blockSize > m_size)
+    {
+        return InvalidOffset;
+    }
+
+    // Find the smallest free block that can hold the request.
+    const unsigned level = Log2(m_size / blockSize);
+    int sourceLevel = static_cast<int>(level);
+    while (sourceLevel >= 0 && m_freeBlocks[sourceLevel].empty())
+    {
+        sourceLevel--;
+    }
+    if (sourceLevel < 0)
+    {
+        return InvalidOffset;
+    }
+
+    const uint64_t offset = *m_freeBlocks[sourceLevel].begin();
+    m_freeBlocks[sourceLevel].erase(m_freeBlocks[sourceLevel].begin());
+
+    // Split it down to the requested level, returning the upper halves to the free lists.
+    for (unsigned splitLevel = static_cast<unsigned>(sourceLevel) + 1; splitLevel <= level; splitLevel++)
+    {
+        m_freeBlocks[splitLevel].insert(offset + BlockSize(splitLevel));
+    }
+
+    m_allocatedLevels[offset] = level;
+    m_usedSize += blockSize;
+    return offset;
+}
+
+void BuddyAllocator::Free(uint64_t offset)
+{
+    auto it = m_allocatedLevels.find(offset);
+    assert(it != m_allocatedLevels.end());
+    if (it == m_allocatedLevels.end())
+    {
+        return;
+    }
+
+    unsigned level = it->second;
+    m_allocatedLevels.erase(it);
+    m_usedSize -= BlockSize(level);
+
+    // Merge with the buddy for as long as it is free as well.
+    while (level > 0)
+    {
+        const uint64_t buddy = offset ^ BlockSize(level);
+        auto buddyIt = m_freeBlocks[level].find(buddy);
+        if (buddyIt == m_freeBlocks[level].end())
+        {
+            break;
+        }
+        m_freeBlocks[level].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        level--;
+    }
+    m_freeBlocks[level].insert(offset);
+}
+
+uint64_t BuddyAllocator::GetLargestFreeBlock() const
+{
+    for (unsigned level = 0; level < m_levelCount; level++)
+    {
+        if (!m_freeBlocks[level].empty())
+        {
+            return BlockSize(level);
+        }
+    }
+    return 0;
+}
+
+uint64_t BuddyAllocator::GetAllocationSize(uint64_t offset) const
+{
+    auto it = m_allocatedLevels.find(offset);
+    return it == m_allocatedLevels.end() ? 0 : BlockSize(it->second);
+}
+
+void BuddyAllocator::GetAllocations(std::vector<uint64_t>& offsets) const
+{
+    offsets.clear();
+    offsets.reserve(m_allocatedLevels.size());
+    for (const auto& allocation : m_allocatedLevels)
+    {
+        offsets.push_back(allocation.first);
+    }
+}
+
+float BuddyAllocator::GetFragmentation() const
+{
+    const uint64_t freeSize = m_size - m_usedSize;
+    if (freeSize == 0)
+    {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(GetLargestFreeBlock()) / static_cast<float>(freeSize);
+}
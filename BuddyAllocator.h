@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Power-of-two buddy allocator over the range [0, size). Only tracks offsets, so it
+// has no dependency on D3D and can be driven directly by tools or benchmarks; like
+// RingAllocator it keeps to standard headers so it builds on any platform.
+class BuddyAllocator
+{
+public:
+    static const uint64_t InvalidOffset = ~0ull;
+
+    // size and minBlockSize must be powers of two.
+    BuddyAllocator(uint64_t size, uint64_t minBlockSize);
+
+    // Blocks are aligned to their own size, so any alignment up to the block size is honoured.
+    uint64_t Allocate(uint64_t size, uint64_t alignment);
+    void Free(uint64_t offset);
+
+    uint64_t GetSize() const { return m_size; }
+    uint64_t GetUsedSize() const { return m_usedSize; }
+    uint64_t GetLargestFreeBlock() const;
+    size_t GetAllocationCount() const { return m_allocatedLevels.size(); }
+    uint64_t GetAllocationSize(uint64_t offset) const;
+    void GetAllocations(std::vector<uint64_t>& offsets) const;
+
+    // 0 when all free space is one block, approaching 1 as it splinters.
+    float GetFragmentation() const;
+
+private:
+    uint64_t BlockSize(unsigned level) const { return m_size >> level; }
+
+    uint64_t m_size;
+    uint64_t m_usedSize;
+    unsigned m_levelCount;
+    std::vector<std::set<uint64_t>> m_freeBlocks;              // Indexed by level; level 0 is the whole range.
+    std::unordered_map<uint64_t, unsigned> m_allocatedLevels;  // Offset -> level of each live allocation.
+};
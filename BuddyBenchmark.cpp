@@ -0,0 +1,187 @@
+#include "BuddyBenchmark.h"
+#include "BuddyAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+    // HeapSuballocator's defaults: 64 MB blocks carved at D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT.
+    const uint64_t BlockSize = 64ull * 1024 * 1024;
+    const uint64_t PlacementAlignment = 64 * 1024;
+    const uint64_t MsaaPlacementAlignment = 4 * 1024 * 1024;
+
+    const double TargetOccupancy = 0.8;
+
+    double Median(std::vector<double> values)
+    {
+        if (values.empty())
+        {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+    // No two live blocks overlap, and together they are the used size.
+    bool CheckAllocations(const BuddyAllocator& allocator)
+    {
+        std::vector<uint64_t> offsets;
+        allocator.GetAllocations(offsets);
+        std::sort(offsets.begin(), offsets.end());
+        uint64_t usedSize = 0;
+        uint64_t end = 0;
+        for (uint64_t offset : offsets)
+        {
+            if (offset < end)
+            {
+                return false;
+            }
+            end = offset + allocator.GetAllocationSize(offset);
+            usedSize += allocator.GetAllocationSize(offset);
+        }
+        return end <= allocator.GetSize() && usedSize == allocator.GetUsedSize();
+    }
+}
+
+BuddyBenchmarkResult RunBuddyBenchmark(unsigned roundCount)
+{
+    struct Request
+    {
+        uint64_t size;
+        uint64_t alignment;
+    };
+
+    struct Live
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    BuddyAllocator allocator(BlockSize, PlacementAlignment);
+    std::mt19937 random(27);
+    // Log-uniform, so small buffers are as common as every larger size class.
+    std::uniform_real_distribution<double> sizeExponent(std::log2(64.0 * 1024), std::log2(8.0 * 1024 * 1024));
+
+    BuddyBenchmarkResult result = {};
+    result.size = BlockSize;
+    result.minBlockSize = PlacementAlignment;
+    result.roundCount = roundCount;
+    result.consistent = true;
+
+    std::vector<Live> live;
+    std::vector<Request> requests;
+    std::vector<double> allocateTimes, freeTimes;
+    double occupancySum = 0.0;
+    double fragmentationSum = 0.0;
+    double wasteSum = 0.0;
+    for (unsigned round = 0; round < roundCount; round++)
+    {
+        // Free a random quarter.
+        std::shuffle(live.begin(), live.end(), random);
+        const size_t freeCount = live.size() / 4;
+        const auto freeStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < freeCount; i++)
+        {
+            allocator.Free(live[live.size() - 1 - i].offset);
+        }
+        const auto freeEnd = std::chrono::steady_clock::now();
+        live.resize(live.size() - freeCount);
+        if (freeCount > 0)
+        {
+            freeTimes.push_back(std::chrono::duration<double, std::nano>(freeEnd - freeStart).count() / freeCount);
+        }
+        result.freeCount += freeCount;
+
+        // Refill until the target or the first failure. The requests are drawn first so
+        // that only the allocator is timed; the block can't take more than this many.
+        requests.clear();
+        for (uint64_t i = 0; i < BlockSize / PlacementAlignment; i++)
+        {
+            Request request;
+            request.size = static_cast<uint64_t>(std::exp2(sizeExponent(random)));
+            request.alignment = (random() % 20 == 0) ? MsaaPlacementAlignment : PlacementAlignment;
+            requests.push_back(request);
+        }
+        size_t allocationCount = 0;
+        bool failed = false;
+        const auto allocateStart = std::chrono::steady_clock::now();
+        while (allocator.GetUsedSize() < TargetOccupancy * BlockSize && allocationCount < requests.size())
+        {
+            const Request& request = requests[allocationCount++];
+            const uint64_t offset = allocator.Allocate(request.size, request.alignment);
+            if (offset == BuddyAllocator::InvalidOffset)
+            {
+                failed = true;
+                break;
+            }
+            const Live allocation = { offset, request.size };
+            live.push_back(allocation);
+        }
+        const auto allocateEnd = std::chrono::steady_clock::now();
+        if (allocationCount > 0)
+        {
+            allocateTimes.push_back(std::chrono::duration<double, std::nano>(allocateEnd - allocateStart).count() / allocationCount);
+        }
+        result.allocationCount += allocationCount;
+
+        if (failed)
+        {
+            const Request& request = requests[allocationCount - 1];
+            uint64_t blockSize = PlacementAlignment;
+            while (blockSize < std::max(request.size, request.alignment))
+            {
+                blockSize <<= 1;
+            }
+            if (blockSize <= allocator.GetSize() - allocator.GetUsedSize())
+            {
+                result.fragmentationFailureCount++;
+            }
+        }
+
+        uint64_t requestedSize = 0;
+        for (const Live& allocation : live)
+        {
+            requestedSize += allocation.size;
+        }
+        occupancySum += static_cast<double>(allocator.GetUsedSize()) / BlockSize;
+        fragmentationSum += allocator.GetFragmentation();
+        result.maxFragmentation = std::max(result.maxFragmentation, static_cast<double>(allocator.GetFragmentation()));
+        wasteSum += allocator.GetUsedSize() > 0 ? 1.0 - static_cast<double>(requestedSize) / allocator.GetUsedSize() : 0.0;
+        result.consistent = result.consistent && CheckAllocations(allocator);
+    }
+
+    result.allocateNanoseconds = Median(allocateTimes);
+    result.freeNanoseconds = Median(freeTimes);
+    if (roundCount > 0)
+    {
+        result.averageOccupancy = occupancySum / roundCount;
+        result.averageFragmentation = fragmentationSum / roundCount;
+        result.internalWaste = wasteSum / roundCount;
+    }
+    return result;
+}
+
+std::string WriteBuddyBenchmarkJson(const BuddyBenchmarkResult& result)
+{
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"size\": " << result.size << ",\n";
+    json << "  \"minBlockSize\": " << result.minBlockSize << ",\n";
+    json << "  \"rounds\": " << result.roundCount << ",\n";
+    json << "  \"consistent\": " << (result.consistent ? "true" : "false") << ",\n";
+    json << "  \"allocations\": " << result.allocationCount << ",\n";
+    json << "  \"frees\": " << result.freeCount << ",\n";
+    json << "  \"allocateNanoseconds\": " << result.allocateNanoseconds << ",\n";
+    json << "  \"freeNanoseconds\": " << result.freeNanoseconds << ",\n";
+    json << "  \"averageOccupancy\": " << result.averageOccupancy << ",\n";
+    json << "  \"averageFragmentation\": " << result.averageFragmentation << ",\n";
+    json << "  \"maxFragmentation\": " << result.maxFragmentation << ",\n";
+    json << "  \"internalWaste\": " << result.internalWaste << ",\n";
+    json << "  \"fragmentationFailures\": " << result.fragmentationFailureCount << "\n";
+    json << "}\n";
+    return json.str();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// BuddyAllocator churned the way HeapSuballocator's blocks are: resources from 64 KB to
+// 8 MB come and go, a random quarter of them freed each round and the block refilled
+// to most of its size. Reports how fast allocations and frees run and how badly the
+// free space splinters. Standard headers only, like the allocator, so that it runs on
+// any platform; see PortableTestMain.cpp.
+struct BuddyBenchmarkResult
+{
+    uint64_t size;                      // Of the allocator, as one heap block.
+    uint64_t minBlockSize;
+    unsigned roundCount;
+    uint64_t allocationCount;
+    uint64_t freeCount;
+    double allocateNanoseconds;         // Median over the rounds, per call.
+    double freeNanoseconds;
+    double averageOccupancy;            // Used size over the allocator's size, after each round.
+    double averageFragmentation;        // GetFragmentation after each round.
+    double maxFragmentation;
+    double internalWaste;               // Of the used size, lost to rounding up to a power of two.
+    uint64_t fragmentationFailureCount; // Allocations that failed though there was enough free space in total.
+    bool consistent;                    // The live blocks never overlapped and add up to the used size.
+};
+
+BuddyBenchmarkResult RunBuddyBenchmark(unsigned roundCount);
+
+std::string WriteBuddyBenchmarkJson(const BuddyBenchmarkResult& result);
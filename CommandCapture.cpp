@@ -0,0 +1,1259 @@
+#include "stdafx.h"
+#include "CommandCapture.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    const char* const CapturePhaseNames[] =
+    {
+        "update",
+        "pre",
+        "scene",
+        "post",
+    };
+    static_assert(_countof(CapturePhaseNames) == CapturePhaseCount, "Missing capture phase name");
+
+    UINT GetWordCount(UINT64 byteCount)
+    {
+        return static_cast<UINT>((byteCount + sizeof(UINT32) - 1) / sizeof(UINT32));
+    }
+
+    UINT32 AsWord(FLOAT value)
+    {
+        UINT32 word;
+        memcpy(&word, &value, sizeof(word));
+        return word;
+    }
+
+    void WriteUint64(UINT64 value, UINT32* pWords)
+    {
+        pWords[0] = static_cast<UINT32>(value);
+        pWords[1] = static_cast<UINT32>(value >> 32);
+    }
+
+    void WriteRect(const D3D12_RECT& rect, UINT32* pWords)
+    {
+        pWords[0] = static_cast<UINT32>(rect.left);
+        pWords[1] = static_cast<UINT32>(rect.top);
+        pWords[2] = static_cast<UINT32>(rect.right);
+        pWords[3] = static_cast<UINT32>(rect.bottom);
+    }
+
+    double GetMilliseconds(const LARGE_INTEGER& start, const LARGE_INTEGER& end, const LARGE_INTEGER& frequency)
+    {
+        return 1000.0 * (end.QuadPart - start.QuadPart) / frequency.QuadPart;
+    }
+
+    std::string EscapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+const char* GetCapturePhaseName(CapturePhase phase)
+{
+    return (phase < CapturePhaseCount) ? CapturePhaseNames[phase] : "unknown";
+}
+
+// Stands in for one of the frame's command lists while it is captured. Every call is
+// forwarded to the real list; the ones the frame makes are also written to the stream.
+// The stand-in belongs to the writer, so it does no reference counting of its own.
+class CaptureCommandList : public ID3D12GraphicsCommandList
+{
+public:
+    CaptureCommandList(CommandCaptureWriter* pWriter, UINT listIndex) :
+        m_pWriter(pWriter),
+        m_pTarget(nullptr),
+        m_listIndex(listIndex),
+        m_phase(CapturePhasePre),
+        m_frameSerial(0),
+        m_commandCount(0),
+        m_unsupportedCount(0)
+    {
+    }
+
+    void Begin(ID3D12GraphicsCommandList* pTarget, CapturePhase phase, UINT frameSerial)
+    {
+        m_pTarget = pTarget;
+        m_phase = phase;
+        m_frameSerial = frameSerial;
+        m_words.clear();
+    }
+
+    UINT GetListIndex() const { return m_listIndex; }
+    CapturePhase GetPhase() const { return m_phase; }
+    UINT GetFrameSerial() const { return m_frameSerial; }
+    const std::vector<UINT32>& GetWords() const { return m_words; }
+    UINT64 GetCommandCount() const { return m_commandCount; }
+    UINT64 GetUnsupportedCount() const { return m_unsupportedCount; }
+
+    // IUnknown
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+    {
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D12Object) || riid == __uuidof(ID3D12DeviceChild) ||
+            riid == __uuidof(ID3D12CommandList) || riid == __uuidof(ID3D12GraphicsCommandList))
+        {
+            *ppvObject = static_cast<ID3D12GraphicsCommandList*>(this);
+            return S_OK;
+        }
+        *ppvObject = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+    ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+    // ID3D12Object and ID3D12DeviceChild
+    HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override { return m_pTarget->GetPrivateData(guid, pDataSize, pData); }
+    HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override { return m_pTarget->SetPrivateData(guid, DataSize, pData); }
+    HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* pData) override { return m_pTarget->SetPrivateDataInterface(guid, pData); }
+    HRESULT STDMETHODCALLTYPE SetName(LPCWSTR Name) override { return m_pTarget->SetName(Name); }
+    HRESULT STDMETHODCALLTYPE GetDevice(REFIID riid, void** ppvDevice) override { return m_pTarget->GetDevice(riid, ppvDevice); }
+
+    // ID3D12CommandList
+    D3D12_COMMAND_LIST_TYPE STDMETHODCALLTYPE GetType() override { return m_pTarget->GetType(); }
+
+    // ID3D12GraphicsCommandList: the calls the frame makes.
+    HRESULT STDMETHODCALLTYPE Close() override
+    {
+        BeginPacket(CaptureCommandClose, 0);
+        return m_pTarget->Close();
+    }
+
+    void STDMETHODCALLTYPE SetGraphicsRootSignature(ID3D12RootSignature* pRootSignature) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetGraphicsRootSignature, 1);
+        p[0] = m_pWriter->EncodeObject(pRootSignature, CaptureObjectRootSignature);
+        m_pTarget->SetGraphicsRootSignature(pRootSignature);
+    }
+
+    void STDMETHODCALLTYPE SetPipelineState(ID3D12PipelineState* pPipelineState) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetPipelineState, 1);
+        p[0] = m_pWriter->EncodeObject(pPipelineState, CaptureObjectPipelineState);
+        m_pTarget->SetPipelineState(pPipelineState);
+    }
+
+    void STDMETHODCALLTYPE SetDescriptorHeaps(UINT NumDescriptorHeaps, ID3D12DescriptorHeap* const* ppDescriptorHeaps) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetDescriptorHeaps, 1 + NumDescriptorHeaps);
+        p[0] = NumDescriptorHeaps;
+        for (UINT i = 0; i < NumDescriptorHeaps; i++)
+        {
+            p[1 + i] = m_pWriter->EncodeObject(ppDescriptorHeaps[i], CaptureObjectDescriptorHeap);
+        }
+        m_pTarget->SetDescriptorHeaps(NumDescriptorHeaps, ppDescriptorHeaps);
+    }
+
+    void STDMETHODCALLTYPE RSSetViewports(UINT NumViewports, const D3D12_VIEWPORT* pViewports) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandRSSetViewports, 1 + 6 * NumViewports);
+        p[0] = NumViewports;
+        for (UINT i = 0; i < NumViewports; i++)
+        {
+            const D3D12_VIEWPORT& viewport = pViewports[i];
+            UINT32* pViewport = p + 1 + 6 * i;
+            pViewport[0] = AsWord(viewport.TopLeftX);
+            pViewport[1] = AsWord(viewport.TopLeftY);
+            pViewport[2] = AsWord(viewport.Width);
+            pViewport[3] = AsWord(viewport.Height);
+            pViewport[4] = AsWord(viewport.MinDepth);
+            pViewport[5] = AsWord(viewport.MaxDepth);
+        }
+        m_pTarget->RSSetViewports(NumViewports, pViewports);
+    }
+
+    void STDMETHODCALLTYPE RSSetScissorRects(UINT NumRects, const D3D12_RECT* pRects) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandRSSetScissorRects, 1 + 4 * NumRects);
+        p[0] = NumRects;
+        for (UINT i = 0; i < NumRects; i++)
+        {
+            WriteRect(pRects[i], p + 1 + 4 * i);
+        }
+        m_pTarget->RSSetScissorRects(NumRects, pRects);
+    }
+
+    void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY PrimitiveTopology) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandIASetPrimitiveTopology, 1);
+        p[0] = PrimitiveTopology;
+        m_pTarget->IASetPrimitiveTopology(PrimitiveTopology);
+    }
+
+    void STDMETHODCALLTYPE IASetVertexBuffers(UINT StartSlot, UINT NumViews, const D3D12_VERTEX_BUFFER_VIEW* pViews) override
+    {
+        const UINT viewCount = pViews ? NumViews : 0;
+        UINT32* p = BeginPacket(CaptureCommandIASetVertexBuffers, 2 + 5 * viewCount);
+        p[0] = StartSlot;
+        p[1] = viewCount;
+        for (UINT i = 0; i < viewCount; i++)
+        {
+            UINT32* pView = p + 2 + 5 * i;
+            m_pWriter->EncodeGpuAddress(pViews[i].BufferLocation, pView);
+            pView[3] = pViews[i].SizeInBytes;
+            pView[4] = pViews[i].StrideInBytes;
+        }
+        m_pTarget->IASetVertexBuffers(StartSlot, NumViews, pViews);
+    }
+
+    void STDMETHODCALLTYPE IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* pView) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandIASetIndexBuffer, 6);
+        p[0] = pView ? 1 : 0;
+        if (pView)
+        {
+            m_pWriter->EncodeGpuAddress(pView->BufferLocation, p + 1);
+            p[4] = pView->SizeInBytes;
+            p[5] = pView->Format;
+        }
+        m_pTarget->IASetIndexBuffer(pView);
+    }
+
+    void STDMETHODCALLTYPE OMSetRenderTargets(UINT NumRenderTargetDescriptors, const D3D12_CPU_DESCRIPTOR_HANDLE* pRenderTargetDescriptors,
+        BOOL RTsSingleHandleToDescriptorRange, const D3D12_CPU_DESCRIPTOR_HANDLE* pDepthStencilDescriptor) override
+    {
+        // A single handle starts a range of NumRenderTargetDescriptors descriptors.
+        const UINT handleCount = !pRenderTargetDescriptors ? 0 : (RTsSingleHandleToDescriptorRange ? min(NumRenderTargetDescriptors, 1u) : NumRenderTargetDescriptors);
+        const UINT depthCount = pDepthStencilDescriptor ? 1 : 0;
+        UINT32* p = BeginPacket(CaptureCommandOMSetRenderTargets, 3 + 2 * (handleCount + depthCount));
+        p[0] = pRenderTargetDescriptors ? NumRenderTargetDescriptors : 0;
+        p[1] = RTsSingleHandleToDescriptorRange ? 1 : 0;
+        p[2] = depthCount;
+        for (UINT i = 0; i < handleCount; i++)
+        {
+            m_pWriter->EncodeCpuDescriptor(pRenderTargetDescriptors[i], p + 3 + 2 * i);
+        }
+        if (pDepthStencilDescriptor)
+        {
+            m_pWriter->EncodeCpuDescriptor(*pDepthStencilDescriptor, p + 3 + 2 * handleCount);
+        }
+        m_pTarget->OMSetRenderTargets(NumRenderTargetDescriptors, pRenderTargetDescriptors, RTsSingleHandleToDescriptorRange, pDepthStencilDescriptor);
+    }
+
+    void STDMETHODCALLTYPE SetGraphicsRootDescriptorTable(UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetGraphicsRootDescriptorTable, 3);
+        p[0] = RootParameterIndex;
+        m_pWriter->EncodeGpuDescriptor(BaseDescriptor, p + 1);
+        m_pTarget->SetGraphicsRootDescriptorTable(RootParameterIndex, BaseDescriptor);
+    }
+
+    void STDMETHODCALLTYPE SetGraphicsRootConstantBufferView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetGraphicsRootConstantBufferView, 4);
+        p[0] = RootParameterIndex;
+        m_pWriter->EncodeGpuAddress(BufferLocation, p + 1);
+        m_pTarget->SetGraphicsRootConstantBufferView(RootParameterIndex, BufferLocation);
+    }
+
+    void STDMETHODCALLTYPE SetGraphicsRootShaderResourceView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetGraphicsRootShaderResourceView, 4);
+        p[0] = RootParameterIndex;
+        m_pWriter->EncodeGpuAddress(BufferLocation, p + 1);
+        m_pTarget->SetGraphicsRootShaderResourceView(RootParameterIndex, BufferLocation);
+    }
+
+    void STDMETHODCALLTYPE SetGraphicsRoot32BitConstant(UINT RootParameterIndex, UINT SrcData, UINT DestOffsetIn32BitValues) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetGraphicsRoot32BitConstant, 3);
+        p[0] = RootParameterIndex;
+        p[1] = SrcData;
+        p[2] = DestOffsetIn32BitValues;
+        m_pTarget->SetGraphicsRoot32BitConstant(RootParameterIndex, SrcData, DestOffsetIn32BitValues);
+    }
+
+    void STDMETHODCALLTYPE SetGraphicsRoot32BitConstants(UINT RootParameterIndex, UINT Num32BitValuesToSet, const void* pSrcData, UINT DestOffsetIn32BitValues) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandSetGraphicsRoot32BitConstants, 3 + Num32BitValuesToSet);
+        p[0] = RootParameterIndex;
+        p[1] = DestOffsetIn32BitValues;
+        p[2] = Num32BitValuesToSet;
+        memcpy(p + 3, pSrcData, Num32BitValuesToSet * sizeof(UINT32));
+        m_pTarget->SetGraphicsRoot32BitConstants(RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+    }
+
+    void STDMETHODCALLTYPE DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandDrawInstanced, 4);
+        p[0] = VertexCountPerInstance;
+        p[1] = InstanceCount;
+        p[2] = StartVertexLocation;
+        p[3] = StartInstanceLocation;
+        m_pTarget->DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
+    }
+
+    void STDMETHODCALLTYPE DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandDrawIndexedInstanced, 5);
+        p[0] = IndexCountPerInstance;
+        p[1] = InstanceCount;
+        p[2] = StartIndexLocation;
+        p[3] = static_cast<UINT32>(BaseVertexLocation);
+        p[4] = StartInstanceLocation;
+        m_pTarget->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
+    }
+
+    void STDMETHODCALLTYPE ExecuteIndirect(ID3D12CommandSignature* pCommandSignature, UINT MaxCommandCount, ID3D12Resource* pArgumentBuffer,
+        UINT64 ArgumentBufferOffset, ID3D12Resource* pCountBuffer, UINT64 CountBufferOffset) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandExecuteIndirect, 8);
+        p[0] = m_pWriter->EncodeObject(pCommandSignature, CaptureObjectCommandSignature);
+        p[1] = MaxCommandCount;
+        p[2] = m_pWriter->EncodeObject(pArgumentBuffer, CaptureObjectResource);
+        WriteUint64(ArgumentBufferOffset, p + 3);
+        p[5] = m_pWriter->EncodeObject(pCountBuffer, CaptureObjectResource);
+        WriteUint64(CountBufferOffset, p + 6);
+        m_pTarget->ExecuteIndirect(pCommandSignature, MaxCommandCount, pArgumentBuffer, ArgumentBufferOffset, pCountBuffer, CountBufferOffset);
+    }
+
+    void STDMETHODCALLTYPE ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE RenderTargetView, const FLOAT ColorRGBA[4], UINT NumRects, const D3D12_RECT* pRects) override
+    {
+        const UINT rectCount = pRects ? NumRects : 0;
+        UINT32* p = BeginPacket(CaptureCommandClearRenderTargetView, 7 + 4 * rectCount);
+        m_pWriter->EncodeCpuDescriptor(RenderTargetView, p);
+        for (UINT i = 0; i < 4; i++)
+        {
+            p[2 + i] = AsWord(ColorRGBA[i]);
+        }
+        p[6] = rectCount;
+        for (UINT i = 0; i < rectCount; i++)
+        {
+            WriteRect(pRects[i], p + 7 + 4 * i);
+        }
+        m_pTarget->ClearRenderTargetView(RenderTargetView, ColorRGBA, NumRects, pRects);
+    }
+
+    void STDMETHODCALLTYPE ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView, D3D12_CLEAR_FLAGS ClearFlags, FLOAT Depth, UINT8 Stencil,
+        UINT NumRects, const D3D12_RECT* pRects) override
+    {
+        const UINT rectCount = pRects ? NumRects : 0;
+        UINT32* p = BeginPacket(CaptureCommandClearDepthStencilView, 6 + 4 * rectCount);
+        m_pWriter->EncodeCpuDescriptor(DepthStencilView, p);
+        p[2] = ClearFlags;
+        p[3] = AsWord(Depth);
+        p[4] = Stencil;
+        p[5] = rectCount;
+        for (UINT i = 0; i < rectCount; i++)
+        {
+            WriteRect(pRects[i], p + 6 + 4 * i);
+        }
+        m_pTarget->ClearDepthStencilView(DepthStencilView, ClearFlags, Depth, Stencil, NumRects, pRects);
+    }
+
+    void STDMETHODCALLTYPE ResourceBarrier(UINT NumBarriers, const D3D12_RESOURCE_BARRIER* pBarriers) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandResourceBarrier, 1 + 6 * NumBarriers);
+        p[0] = NumBarriers;
+        for (UINT i = 0; i < NumBarriers; i++)
+        {
+            const D3D12_RESOURCE_BARRIER& barrier = pBarriers[i];
+            UINT32* pBarrier = p + 1 + 6 * i;
+            pBarrier[0] = barrier.Type;
+            pBarrier[1] = barrier.Flags;
+            switch (barrier.Type)
+            {
+            case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+                pBarrier[2] = m_pWriter->EncodeObject(barrier.Transition.pResource, CaptureObjectResource);
+                pBarrier[3] = barrier.Transition.Subresource;
+                pBarrier[4] = barrier.Transition.StateBefore;
+                pBarrier[5] = barrier.Transition.StateAfter;
+                break;
+
+            case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+                pBarrier[2] = m_pWriter->EncodeObject(barrier.Aliasing.pResourceBefore, CaptureObjectResource);
+                pBarrier[3] = m_pWriter->EncodeObject(barrier.Aliasing.pResourceAfter, CaptureObjectResource);
+                pBarrier[4] = 0;
+                pBarrier[5] = 0;
+                break;
+
+            default:
+                pBarrier[2] = m_pWriter->EncodeObject(barrier.UAV.pResource, CaptureObjectResource);
+                pBarrier[3] = 0;
+                pBarrier[4] = 0;
+                pBarrier[5] = 0;
+                break;
+            }
+        }
+        m_pTarget->ResourceBarrier(NumBarriers, pBarriers);
+    }
+
+    void STDMETHODCALLTYPE CopyResource(ID3D12Resource* pDstResource, ID3D12Resource* pSrcResource) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandCopyResource, 2);
+        p[0] = m_pWriter->EncodeObject(pDstResource, CaptureObjectResource);
+        p[1] = m_pWriter->EncodeObject(pSrcResource, CaptureObjectResource);
+        m_pTarget->CopyResource(pDstResource, pSrcResource);
+    }
+
+    void STDMETHODCALLTYPE CopyBufferRegion(ID3D12Resource* pDstBuffer, UINT64 DstOffset, ID3D12Resource* pSrcBuffer, UINT64 SrcOffset, UINT64 NumBytes) override
+    {
+        UINT32* p = BeginPacket(CaptureCommandCopyBufferRegion, 8);
+        p[0] = m_pWriter->EncodeObject(pDstBuffer, CaptureObjectResource);
+        WriteUint64(DstOffset, p + 1);
+        p[3] = m_pWriter->EncodeObject(pSrcBuffer, CaptureObjectResource);
+        WriteUint64(SrcOffset, p + 4);
+        WriteUint64(NumBytes, p + 6);
+        m_pTarget->CopyBufferRegion(pDstBuffer, DstOffset, pSrcBuffer, SrcOffset, NumBytes);
+    }
+
+    void STDMETHODCALLTYPE DiscardResource(ID3D12Resource* pResource, const D3D12_DISCARD_REGION* pRegion) override
+    {
+        const UINT rectCount = (pRegion && pRegion->pRects) ? pRegion->NumRects : 0;
+        UINT32* p = BeginPacket(CaptureCommandDiscardResource, 5 + 4 * rectCount);
+        p[0] = m_pWriter->EncodeObject(pResource, CaptureObjectResource);
+        p[1] = pRegion ? 1 : 0;
+        p[2] = pRegion ? pRegion->FirstSubresource : 0;
+        p[3] = pRegion ? pRegion->NumSubresources : 0;
+        p[4] = rectCount;
+        for (UINT i = 0; i < rectCount; i++)
+        {
+            WriteRect(pRegion->pRects[i], p + 5 + 4 * i);
+        }
+        m_pTarget->DiscardResource(pResource, pRegion);
+    }
+
+    // Debug markers and queries are forwarded and left out of the capture; they measure
+    // the frame rather than draw it.
+    void STDMETHODCALLTYPE SetMarker(UINT Metadata, const void* pData, UINT Size) override { m_pTarget->SetMarker(Metadata, pData, Size); }
+    void STDMETHODCALLTYPE BeginEvent(UINT Metadata, const void* pData, UINT Size) override { m_pTarget->BeginEvent(Metadata, pData, Size); }
+    void STDMETHODCALLTYPE EndEvent() override { m_pTarget->EndEvent(); }
+    void STDMETHODCALLTYPE BeginQuery(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE Type, UINT Index) override { m_pTarget->BeginQuery(pQueryHeap, Type, Index); }
+    void STDMETHODCALLTYPE EndQuery(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE Type, UINT Index) override { m_pTarget->EndQuery(pQueryHeap, Type, Index); }
+    void STDMETHODCALLTYPE ResolveQueryData(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE Type, UINT StartIndex, UINT NumQueries, ID3D12Resource* pDestinationBuffer, UINT64 AlignedDestinationBufferOffset) override
+    {
+        m_pTarget->ResolveQueryData(pQueryHeap, Type, StartIndex, NumQueries, pDestinationBuffer, AlignedDestinationBufferOffset);
+    }
+
+    // The rest are forwarded and only noted in the stream, so a replay can tell it is
+    // missing something.
+    HRESULT STDMETHODCALLTYPE Reset(ID3D12CommandAllocator* pAllocator, ID3D12PipelineState* pInitialState) override
+    {
+        WriteUnsupported("Reset");
+        return m_pTarget->Reset(pAllocator, pInitialState);
+    }
+    void STDMETHODCALLTYPE ClearState(ID3D12PipelineState* pPipelineState) override
+    {
+        WriteUnsupported("ClearState");
+        m_pTarget->ClearState(pPipelineState);
+    }
+    void STDMETHODCALLTYPE Dispatch(UINT ThreadGroupCountX, UINT ThreadGroupCountY, UINT ThreadGroupCountZ) override
+    {
+        WriteUnsupported("Dispatch");
+        m_pTarget->Dispatch(ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ);
+    }
+    void STDMETHODCALLTYPE CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION* pDst, UINT DstX, UINT DstY, UINT DstZ, const D3D12_TEXTURE_COPY_LOCATION* pSrc, const D3D12_BOX* pSrcBox) override
+    {
+        WriteUnsupported("CopyTextureRegion");
+        m_pTarget->CopyTextureRegion(pDst, DstX, DstY, DstZ, pSrc, pSrcBox);
+    }
+    void STDMETHODCALLTYPE CopyTiles(ID3D12Resource* pTiledResource, const D3D12_TILED_RESOURCE_COORDINATE* pTileRegionStartCoordinate, const D3D12_TILE_REGION_SIZE* pTileRegionSize,
+        ID3D12Resource* pBuffer, UINT64 BufferStartOffsetInBytes, D3D12_TILE_COPY_FLAGS Flags) override
+    {
+        WriteUnsupported("CopyTiles");
+        m_pTarget->CopyTiles(pTiledResource, pTileRegionStartCoordinate, pTileRegionSize, pBuffer, BufferStartOffsetInBytes, Flags);
+    }
+    void STDMETHODCALLTYPE ResolveSubresource(ID3D12Resource* pDstResource, UINT DstSubresource, ID3D12Resource* pSrcResource, UINT SrcSubresource, DXGI_FORMAT Format) override
+    {
+        WriteUnsupported("ResolveSubresource");
+        m_pTarget->ResolveSubresource(pDstResource, DstSubresource, pSrcResource, SrcSubresource, Format);
+    }
+    void STDMETHODCALLTYPE OMSetBlendFactor(const FLOAT BlendFactor[4]) override
+    {
+        // A null factor means all ones.
+        UINT32* p = BeginPacket(CaptureCommandOMSetBlendFactor, 4);
+        for (UINT i = 0; i < 4; i++)
+        {
+            p[i] = AsWord(BlendFactor ? BlendFactor[i] : 1.0f);
+        }
+        m_pTarget->OMSetBlendFactor(BlendFactor);
+    }
+    void STDMETHODCALLTYPE OMSetStencilRef(UINT StencilRef) override
+    {
+        WriteUnsupported("OMSetStencilRef");
+        m_pTarget->OMSetStencilRef(StencilRef);
+    }
+    void STDMETHODCALLTYPE ExecuteBundle(ID3D12GraphicsCommandList* pCommandList) override
+    {
+        WriteUnsupported("ExecuteBundle");
+        m_pTarget->ExecuteBundle(pCommandList);
+    }
+    void STDMETHODCALLTYPE SetComputeRootSignature(ID3D12RootSignature* pRootSignature) override
+    {
+        WriteUnsupported("SetComputeRootSignature");
+        m_pTarget->SetComputeRootSignature(pRootSignature);
+    }
+    void STDMETHODCALLTYPE SetComputeRootDescriptorTable(UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor) override
+    {
+        WriteUnsupported("SetComputeRootDescriptorTable");
+        m_pTarget->SetComputeRootDescriptorTable(RootParameterIndex, BaseDescriptor);
+    }
+    void STDMETHODCALLTYPE SetComputeRoot32BitConstant(UINT RootParameterIndex, UINT SrcData, UINT DestOffsetIn32BitValues) override
+    {
+        WriteUnsupported("SetComputeRoot32BitConstant");
+        m_pTarget->SetComputeRoot32BitConstant(RootParameterIndex, SrcData, DestOffsetIn32BitValues);
+    }
+    void STDMETHODCALLTYPE SetComputeRoot32BitConstants(UINT RootParameterIndex, UINT Num32BitValuesToSet, const void* pSrcData, UINT DestOffsetIn32BitValues) override
+    {
+        WriteUnsupported("SetComputeRoot32BitConstants");
+        m_pTarget->SetComputeRoot32BitConstants(RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+    }
+    void STDMETHODCALLTYPE SetComputeRootConstantBufferView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation) override
+    {
+        WriteUnsupported("SetComputeRootConstantBufferView");
+        m_pTarget->SetComputeRootConstantBufferView(RootParameterIndex, BufferLocation);
+    }
+    void STDMETHODCALLTYPE SetComputeRootShaderResourceView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation) override
+    {
+        WriteUnsupported("SetComputeRootShaderResourceView");
+        m_pTarget->SetComputeRootShaderResourceView(RootParameterIndex, BufferLocation);
+    }
+    void STDMETHODCALLTYPE SetComputeRootUnorderedAccessView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation) override
+    {
+        WriteUnsupported("SetComputeRootUnorderedAccessView");
+        m_pTarget->SetComputeRootUnorderedAccessView(RootParameterIndex, BufferLocation);
+    }
+    void STDMETHODCALLTYPE SetGraphicsRootUnorderedAccessView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation) override
+    {
+        WriteUnsupported("SetGraphicsRootUnorderedAccessView");
+        m_pTarget->SetGraphicsRootUnorderedAccessView(RootParameterIndex, BufferLocation);
+    }
+    void STDMETHODCALLTYPE SOSetTargets(UINT StartSlot, UINT NumViews, const D3D12_STREAM_OUTPUT_BUFFER_VIEW* pViews) override
+    {
+        WriteUnsupported("SOSetTargets");
+        m_pTarget->SOSetTargets(StartSlot, NumViews, pViews);
+    }
+    void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(D3D12_GPU_DESCRIPTOR_HANDLE ViewGPUHandleInCurrentHeap, D3D12_CPU_DESCRIPTOR_HANDLE ViewCPUHandle, ID3D12Resource* pResource,
+        const UINT Values[4], UINT NumRects, const D3D12_RECT* pRects) override
+    {
+        WriteUnsupported("ClearUnorderedAccessViewUint");
+        m_pTarget->ClearUnorderedAccessViewUint(ViewGPUHandleInCurrentHeap, ViewCPUHandle, pResource, Values, NumRects, pRects);
+    }
+    void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(D3D12_GPU_DESCRIPTOR_HANDLE ViewGPUHandleInCurrentHeap, D3D12_CPU_DESCRIPTOR_HANDLE ViewCPUHandle, ID3D12Resource* pResource,
+        const FLOAT Values[4], UINT NumRects, const D3D12_RECT* pRects) override
+    {
+        WriteUnsupported("ClearUnorderedAccessViewFloat");
+        m_pTarget->ClearUnorderedAccessViewFloat(ViewGPUHandleInCurrentHeap, ViewCPUHandle, pResource, Values, NumRects, pRects);
+    }
+    void STDMETHODCALLTYPE SetPredication(ID3D12Resource* pBuffer, UINT64 AlignedBufferOffset, D3D12_PREDICATION_OP Operation) override
+    {
+        WriteUnsupported("SetPredication");
+        m_pTarget->SetPredication(pBuffer, AlignedBufferOffset, Operation);
+    }
+
+private:
+    UINT32* BeginPacket(CaptureCommand command, UINT payloadWordCount)
+    {
+        const size_t first = m_words.size();
+        m_words.resize(first + 1 + payloadWordCount);
+        m_words[first] = MakeCapturePacketHeader(command, payloadWordCount);
+        m_commandCount++;
+        return m_words.data() + first + 1;
+    }
+
+    void WriteUnsupported(const char* pMethodName)
+    {
+        const size_t length = strlen(pMethodName);
+        UINT32* p = BeginPacket(CaptureCommandUnsupported, GetWordCount(length + 1));
+        memset(p, 0, GetWordCount(length + 1) * sizeof(UINT32));
+        memcpy(p, pMethodName, length);
+        m_unsupportedCount++;
+    }
+
+    CommandCaptureWriter* m_pWriter;
+    ID3D12GraphicsCommandList* m_pTarget;
+    UINT m_listIndex;
+    CapturePhase m_phase;
+    UINT m_frameSerial;
+    std::vector<UINT32> m_words;
+    UINT64 m_commandCount;
+    UINT64 m_unsupportedCount;
+};
+
+CommandCaptureWriter::CommandCaptureWriter() :
+    m_pDevice(nullptr),
+    m_listCount(0),
+    m_unresolvedReferenceCount(0),
+    m_commandCount(0),
+    m_unsupportedCommandCount(0),
+    m_frame{},
+    m_frameSerial(0)
+{
+    InitializeSRWLock(&m_objectLock);
+}
+
+CommandCaptureWriter::~CommandCaptureWriter()
+{
+}
+
+void CommandCaptureWriter::Begin(ID3D12Device* pDevice, UINT listCount, const std::vector<CaptureObjectBinding>& objects)
+{
+    m_pDevice = pDevice;
+    m_listCount = listCount;
+    m_objects.clear();
+    m_objectIds.clear();
+    m_bufferAddresses.clear();
+    m_descriptorHeaps.clear();
+    m_unresolvedReferenceCount = 0;
+    m_commandCount = 0;
+    m_unsupportedCommandCount = 0;
+    m_previousBufferData.clear();
+    m_frames.clear();
+    m_streams.clear();
+    m_buffers.clear();
+    m_words.clear();
+
+    m_commandLists.clear();
+    for (UINT i = 0; i < listCount; i++)
+    {
+        m_commandLists.emplace_back(new CaptureCommandList(this, i));
+    }
+
+    // Object 0 is null.
+    AddObject(nullptr, CaptureObjectUnknown, std::string());
+    for (const CaptureObjectBinding& object : objects)
+    {
+        if (object.pObject && m_objectIds.find(object.pObject) == m_objectIds.end())
+        {
+            AddObject(object.pObject, object.type, object.name);
+        }
+    }
+}
+
+void CommandCaptureWriter::End()
+{
+    m_pDevice = nullptr;
+}
+
+void CommandCaptureWriter::BeginFrame(UINT frameResourceIndex, UINT backBufferIndex)
+{
+    m_frameSerial++;
+    m_frame = {};
+    m_frame.firstBuffer = static_cast<UINT32>(m_buffers.size());
+    m_frame.frameResourceIndex = frameResourceIndex;
+    m_frame.backBufferIndex = backBufferIndex;
+}
+
+ID3D12GraphicsCommandList* CommandCaptureWriter::GetCommandList(UINT listIndex, CapturePhase phase, ID3D12GraphicsCommandList* pCommandList)
+{
+    if (!IsCapturing() || listIndex >= m_commandLists.size())
+    {
+        return pCommandList;
+    }
+
+    // Each list belongs to one thread, so only that thread touches its stand-in.
+    CaptureCommandList* pCaptureList = m_commandLists[listIndex].get();
+    if (pCaptureList->GetFrameSerial() != m_frameSerial)
+    {
+        pCaptureList->Begin(pCommandList, phase, m_frameSerial);
+    }
+    return pCaptureList;
+}
+
+void CommandCaptureWriter::CaptureBufferData(ID3D12Resource* pBuffer, UINT64 offset, const void* pData, UINT size)
+{
+    CaptureBufferRecord record = {};
+    record.objectId = EncodeObject(pBuffer, CaptureObjectResource);
+    record.size = size;
+    record.offset = offset;
+    record.firstWord = m_words.size();
+
+    // Stored relative to the same range in the previous frame; the first time, to zeros.
+    const UINT wordCount = GetWordCount(size);
+    std::vector<UINT32>& previous = m_previousBufferData[std::make_pair(record.objectId, offset)];
+    previous.resize(wordCount, 0);
+    std::vector<UINT32> current(wordCount, 0);
+    memcpy(current.data(), pData, size);
+    for (UINT i = 0; i < wordCount; i++)
+    {
+        m_words.push_back(current[i] ^ previous[i]);
+    }
+    previous.swap(current);
+
+    m_buffers.push_back(record);
+    m_frame.bufferCount++;
+}
+
+void CommandCaptureWriter::EndFrame(const CaptureFrameTimes& times)
+{
+    // In submission order, whatever order the threads finished in.
+    m_frame.firstStream = static_cast<UINT32>(m_streams.size());
+    for (const std::unique_ptr<CaptureCommandList>& pCommandList : m_commandLists)
+    {
+        if (pCommandList->GetFrameSerial() != m_frameSerial)
+        {
+            continue;
+        }
+
+        const std::vector<UINT32>& words = pCommandList->GetWords();
+        CaptureStreamRecord stream = {};
+        stream.phase = pCommandList->GetPhase();
+        stream.listIndex = pCommandList->GetListIndex();
+        stream.firstWord = m_words.size();
+        stream.wordCount = words.size();
+        m_words.insert(m_words.end(), words.begin(), words.end());
+        m_streams.push_back(stream);
+        m_frame.streamCount++;
+    }
+
+    m_commandCount = 0;
+    m_unsupportedCommandCount = 0;
+    for (const std::unique_ptr<CaptureCommandList>& pCommandList : m_commandLists)
+    {
+        m_commandCount += pCommandList->GetCommandCount();
+        m_unsupportedCommandCount += pCommandList->GetUnsupportedCount();
+    }
+
+    memcpy(m_frame.phaseMilliseconds, times.phaseMilliseconds, sizeof(m_frame.phaseMilliseconds));
+    m_frame.frameMilliseconds = times.frameMilliseconds;
+    m_frames.push_back(m_frame);
+}
+
+UINT64 CommandCaptureWriter::GetSize() const
+{
+    return sizeof(CaptureFileHeader) + m_objects.size() * sizeof(CaptureObjectRecord) + m_frames.size() * sizeof(CaptureFrameRecord) +
+        m_streams.size() * sizeof(CaptureStreamRecord) + m_buffers.size() * sizeof(CaptureBufferRecord) + m_words.size() * sizeof(UINT32);
+}
+
+bool CommandCaptureWriter::Save(const std::wstring& path) const
+{
+    CaptureFileHeader header = {};
+    header.magic = CaptureFileMagic;
+    header.version = CaptureFileVersion;
+    header.listCount = m_listCount;
+    header.objectCount = static_cast<UINT32>(m_objects.size());
+    header.frameCount = static_cast<UINT32>(m_frames.size());
+    header.streamCount = static_cast<UINT32>(m_streams.size());
+    header.bufferCount = static_cast<UINT32>(m_buffers.size());
+    header.objectOffset = sizeof(CaptureFileHeader);
+    header.frameOffset = header.objectOffset + m_objects.size() * sizeof(CaptureObjectRecord);
+    header.streamOffset = header.frameOffset + m_frames.size() * sizeof(CaptureFrameRecord);
+    header.bufferOffset = header.streamOffset + m_streams.size() * sizeof(CaptureStreamRecord);
+    header.wordOffset = header.bufferOffset + m_buffers.size() * sizeof(CaptureBufferRecord);
+    header.wordCount = m_words.size();
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const ObjectInfo& object : m_objects)
+    {
+        file.write(reinterpret_cast<const char*>(&object.record), sizeof(object.record));
+    }
+    file.write(reinterpret_cast<const char*>(m_frames.data()), m_frames.size() * sizeof(CaptureFrameRecord));
+    file.write(reinterpret_cast<const char*>(m_streams.data()), m_streams.size() * sizeof(CaptureStreamRecord));
+    file.write(reinterpret_cast<const char*>(m_buffers.data()), m_buffers.size() * sizeof(CaptureBufferRecord));
+    file.write(reinterpret_cast<const char*>(m_words.data()), m_words.size() * sizeof(UINT32));
+    return static_cast<bool>(file);
+}
+
+UINT CommandCaptureWriter::EncodeObject(ID3D12DeviceChild* pObject, CaptureObjectType type)
+{
+    if (!pObject)
+    {
+        return 0;
+    }
+
+    AcquireSRWLockShared(&m_objectLock);
+    const auto found = m_objectIds.find(pObject);
+    const UINT id = (found != m_objectIds.end()) ? found->second : 0;
+    ReleaseSRWLockShared(&m_objectLock);
+    if (id != 0)
+    {
+        return id;
+    }
+
+    // First seen in a command; it stays unnamed.
+    AcquireSRWLockExclusive(&m_objectLock);
+    const auto added = m_objectIds.find(pObject);
+    const UINT addedId = (added != m_objectIds.end()) ? added->second : AddObject(pObject, type, std::string());
+    ReleaseSRWLockExclusive(&m_objectLock);
+    return addedId;
+}
+
+void CommandCaptureWriter::EncodeGpuAddress(D3D12_GPU_VIRTUAL_ADDRESS address, UINT32* pWords)
+{
+    UINT id = 0;
+    UINT64 offset = address;
+    if (address != 0)
+    {
+        AcquireSRWLockShared(&m_objectLock);
+        auto buffer = m_bufferAddresses.upper_bound(address);
+        if (buffer != m_bufferAddresses.begin())
+        {
+            --buffer;
+            if (address - buffer->first < m_objects[buffer->second].record.size)
+            {
+                id = buffer->second;
+                offset = address - buffer->first;
+            }
+        }
+        ReleaseSRWLockShared(&m_objectLock);
+
+        // Only buffers named when the capture began, or seen in an earlier command, are known.
+        if (id == 0)
+        {
+            InterlockedIncrement64(&m_unresolvedReferenceCount);
+        }
+    }
+
+    pWords[0] = id;
+    WriteUint64(offset, pWords + 1);
+}
+
+void CommandCaptureWriter::EncodeCpuDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE handle, UINT32* pWords)
+{
+    UINT index = 0;
+    pWords[0] = FindDescriptorHeap(handle.ptr, false, &index);
+    pWords[1] = index;
+}
+
+void CommandCaptureWriter::EncodeGpuDescriptor(D3D12_GPU_DESCRIPTOR_HANDLE handle, UINT32* pWords)
+{
+    UINT index = 0;
+    pWords[0] = FindDescriptorHeap(handle.ptr, true, &index);
+    pWords[1] = index;
+}
+
+// Called with the object lock held exclusively, or before any recording starts.
+UINT CommandCaptureWriter::AddObject(ID3D12DeviceChild* pObject, CaptureObjectType type, const std::string& name)
+{
+    const UINT id = static_cast<UINT>(m_objects.size());
+    ObjectInfo object = {};
+    object.record.type = type;
+    strncpy_s(object.record.name, name.c_str(), _TRUNCATE);
+
+    if (type == CaptureObjectResource)
+    {
+        ID3D12Resource* pResource = static_cast<ID3D12Resource*>(pObject);
+        const D3D12_RESOURCE_DESC desc = pResource->GetDesc();
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            object.record.size = desc.Width;
+            m_bufferAddresses[pResource->GetGPUVirtualAddress()] = id;
+        }
+    }
+    else if (type == CaptureObjectDescriptorHeap)
+    {
+        ID3D12DescriptorHeap* pHeap = static_cast<ID3D12DescriptorHeap*>(pObject);
+        const D3D12_DESCRIPTOR_HEAP_DESC desc = pHeap->GetDesc();
+        object.record.size = desc.NumDescriptors;
+        object.cpuDescriptorStart = pHeap->GetCPUDescriptorHandleForHeapStart().ptr;
+        if (desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+        {
+            object.gpuDescriptorStart = pHeap->GetGPUDescriptorHandleForHeapStart().ptr;
+        }
+        object.descriptorSize = m_pDevice->GetDescriptorHandleIncrementSize(desc.Type);
+        m_descriptorHeaps.push_back(id);
+    }
+
+    m_objects.push_back(object);
+    if (pObject)
+    {
+        m_objectIds[pObject] = id;
+    }
+    return id;
+}
+
+// Descriptor heaps are named when the capture begins, so there is nothing to add here.
+UINT CommandCaptureWriter::FindDescriptorHeap(UINT64 handle, bool shaderVisible, UINT* pIndex)
+{
+    UINT heapId = 0;
+    AcquireSRWLockShared(&m_objectLock);
+    for (UINT id : m_descriptorHeaps)
+    {
+        const ObjectInfo& heap = m_objects[id];
+        const UINT64 start = shaderVisible ? heap.gpuDescriptorStart : heap.cpuDescriptorStart;
+        if (start != 0 && handle >= start && handle < start + heap.record.size * heap.descriptorSize)
+        {
+            heapId = id;
+            *pIndex = static_cast<UINT>((handle - start) / heap.descriptorSize);
+            break;
+        }
+    }
+    ReleaseSRWLockShared(&m_objectLock);
+
+    if (heapId == 0)
+    {
+        InterlockedIncrement64(&m_unresolvedReferenceCount);
+    }
+    return heapId;
+}
+
+CaptureFile::CaptureFile() :
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr),
+    m_pView(nullptr),
+    m_pHeader(nullptr),
+    m_pObjects(nullptr),
+    m_pFrames(nullptr),
+    m_pStreams(nullptr),
+    m_pBuffers(nullptr),
+    m_pWords(nullptr)
+{
+}
+
+CaptureFile::~CaptureFile()
+{
+    Close();
+}
+
+bool CaptureFile::Open(const std::wstring& path, std::string* pError)
+{
+    Close();
+    pError->clear();
+
+    m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER fileSize = {};
+    if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &fileSize))
+    {
+        *pError = "Can't open the file";
+        Close();
+        return false;
+    }
+    const UINT64 size = fileSize.QuadPart;
+    if (size < sizeof(CaptureFileHeader))
+    {
+        *pError = "Not a capture file";
+        Close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_pView = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!m_pView)
+    {
+        *pError = "Can't map the file";
+        Close();
+        return false;
+    }
+
+    const UINT8* pBytes = static_cast<const UINT8*>(m_pView);
+    m_pHeader = reinterpret_cast<const CaptureFileHeader*>(pBytes);
+    const CaptureFileHeader& header = *m_pHeader;
+    auto fits = [size](UINT64 offset, UINT64 count, UINT64 elementSize)
+    {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / elementSize;
+    };
+    if (header.magic != CaptureFileMagic || header.version != CaptureFileVersion)
+    {
+        *pError = "Not a capture file, or from another version";
+    }
+    else if (!fits(header.objectOffset, header.objectCount, sizeof(CaptureObjectRecord)) ||
+        !fits(header.frameOffset, header.frameCount, sizeof(CaptureFrameRecord)) ||
+        !fits(header.streamOffset, header.streamCount, sizeof(CaptureStreamRecord)) ||
+        !fits(header.bufferOffset, header.bufferCount, sizeof(CaptureBufferRecord)) ||
+        !fits(header.wordOffset, header.wordCount, sizeof(UINT32)))
+    {
+        *pError = "The file is truncated";
+    }
+    if (!pError->empty())
+    {
+        Close();
+        return false;
+    }
+
+    m_pObjects = reinterpret_cast<const CaptureObjectRecord*>(pBytes + header.objectOffset);
+    m_pFrames = reinterpret_cast<const CaptureFrameRecord*>(pBytes + header.frameOffset);
+    m_pStreams = reinterpret_cast<const CaptureStreamRecord*>(pBytes + header.streamOffset);
+    m_pBuffers = reinterpret_cast<const CaptureBufferRecord*>(pBytes + header.bufferOffset);
+    m_pWords = reinterpret_cast<const UINT32*>(pBytes + header.wordOffset);
+
+    // The replay trusts every range below, so check them once here.
+    for (UINT i = 0; i < header.frameCount && pError->empty(); i++)
+    {
+        const CaptureFrameRecord& frame = m_pFrames[i];
+        if (frame.firstStream > header.streamCount || frame.streamCount > header.streamCount - frame.firstStream ||
+            frame.firstBuffer > header.bufferCount || frame.bufferCount > header.bufferCount - frame.firstBuffer)
+        {
+            *pError = "Frame " + std::to_string(i) + " is out of range";
+        }
+    }
+    for (UINT i = 0; i < header.streamCount && pError->empty(); i++)
+    {
+        const CaptureStreamRecord& stream = m_pStreams[i];
+        if (stream.phase >= CapturePhaseCount || stream.listIndex >= header.listCount ||
+            stream.firstWord > header.wordCount || stream.wordCount > header.wordCount - stream.firstWord)
+        {
+            *pError = "Command stream " + std::to_string(i) + " is out of range";
+        }
+    }
+    for (UINT i = 0; i < header.bufferCount && pError->empty(); i++)
+    {
+        const CaptureBufferRecord& buffer = m_pBuffers[i];
+        if (buffer.objectId >= header.objectCount || buffer.firstWord > header.wordCount || GetWordCount(buffer.size) > header.wordCount - buffer.firstWord)
+        {
+            *pError = "Buffer data " + std::to_string(i) + " is out of range";
+        }
+    }
+    if (!pError->empty())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CaptureFile::Close()
+{
+    if (m_pView)
+    {
+        UnmapViewOfFile(m_pView);
+    }
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = nullptr;
+    m_pView = nullptr;
+    m_pHeader = nullptr;
+    m_pObjects = nullptr;
+    m_pFrames = nullptr;
+    m_pStreams = nullptr;
+    m_pBuffers = nullptr;
+    m_pWords = nullptr;
+}
+
+void CaptureReplayResolver::Reset(ID3D12Device* pDevice, const CaptureFile& file)
+{
+    m_pDevice = pDevice;
+    m_pFile = &file;
+    m_objects.assign(file.GetHeader().objectCount, Object());
+    m_headlessData.clear();
+}
+
+bool CaptureReplayResolver::Bind(const CaptureObjectBinding& binding, INT descriptorOffset)
+{
+    const CaptureObjectRecord* pRecords = m_pFile->GetObjects();
+    for (UINT id = 1; id < m_objects.size(); id++)
+    {
+        const CaptureObjectRecord& record = pRecords[id];
+        if (record.type != static_cast<UINT32>(binding.type) || strncmp(record.name, binding.name.c_str(), sizeof(record.name)) != 0)
+        {
+            continue;
+        }
+
+        Object& object = m_objects[id];
+        object.pObject = binding.pObject;
+        object.pMappedData = binding.pMappedData;
+        if (binding.type == CaptureObjectResource)
+        {
+            object.gpuAddress = static_cast<ID3D12Resource*>(binding.pObject)->GetGPUVirtualAddress();
+        }
+        else if (binding.type == CaptureObjectDescriptorHeap)
+        {
+            ID3D12DescriptorHeap* pHeap = static_cast<ID3D12DescriptorHeap*>(binding.pObject);
+            const D3D12_DESCRIPTOR_HEAP_DESC desc = pHeap->GetDesc();
+            object.cpuDescriptorStart = pHeap->GetCPUDescriptorHandleForHeapStart().ptr;
+            object.gpuDescriptorStart = (desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE) ? pHeap->GetGPUDescriptorHandleForHeapStart().ptr : 0;
+            object.descriptorSize = m_pDevice->GetDescriptorHandleIncrementSize(desc.Type);
+            object.descriptorOffset = descriptorOffset;
+        }
+        return true;
+    }
+    return false;
+}
+
+void CaptureReplayResolver::BindHeadless(const CaptureFile& file)
+{
+    Reset(nullptr, file);
+
+    // Placeholders that differ per object; HeadlessReplayCommandList never dereferences them.
+    for (UINT id = 1; id < m_objects.size(); id++)
+    {
+        Object& object = m_objects[id];
+        object.pObject = reinterpret_cast<void*>(static_cast<UINT_PTR>(id) << 4);
+        object.gpuAddress = static_cast<UINT64>(id) << 32;
+        object.cpuDescriptorStart = static_cast<SIZE_T>(id) << 20;
+        object.gpuDescriptorStart = static_cast<UINT64>(id) << 32;
+        object.descriptorSize = 32;
+    }
+
+    // Somewhere to restore the buffer contents to.
+    m_headlessData.resize(m_objects.size());
+    for (UINT i = 0; i < file.GetHeader().bufferCount; i++)
+    {
+        const CaptureBufferRecord& buffer = file.GetBuffers()[i];
+        std::vector<UINT32>& data = m_headlessData[buffer.objectId];
+        data.resize(max(data.size(), static_cast<size_t>(GetWordCount(buffer.offset + buffer.size))));
+    }
+    for (UINT id = 1; id < m_objects.size(); id++)
+    {
+        m_objects[id].pMappedData = m_headlessData[id].empty() ? nullptr : m_headlessData[id].data();
+    }
+}
+
+UINT CaptureReplayResolver::GetUnboundObjectCount() const
+{
+    UINT count = 0;
+    for (UINT id = 1; id < m_objects.size(); id++)
+    {
+        count += (m_objects[id].pObject == nullptr) ? 1 : 0;
+    }
+    return count;
+}
+
+bool CaptureReplayResolver::ResolveGpuAddress(const UINT32* pWords, D3D12_GPU_VIRTUAL_ADDRESS* pAddress) const
+{
+    const UINT32 id = pWords[0];
+    const UINT64 offset = CaptureReplayDetail::ReadUint64(pWords + 1);
+    if (id == 0)
+    {
+        // A raw address means the buffer was unknown during capture; only null is portable.
+        *pAddress = 0;
+        return offset == 0;
+    }
+    if (id >= m_objects.size() || m_objects[id].pObject == nullptr)
+    {
+        return false;
+    }
+    *pAddress = m_objects[id].gpuAddress + offset;
+    return true;
+}
+
+bool CaptureReplayResolver::ResolveCpuDescriptor(const UINT32* pWords, D3D12_CPU_DESCRIPTOR_HANDLE* pHandle) const
+{
+    const UINT32 id = pWords[0];
+    if (id == 0 || id >= m_objects.size() || m_objects[id].pObject == nullptr)
+    {
+        return false;
+    }
+    const Object& heap = m_objects[id];
+    pHandle->ptr = heap.cpuDescriptorStart + static_cast<SIZE_T>(static_cast<INT64>(pWords[1]) + heap.descriptorOffset) * heap.descriptorSize;
+    return true;
+}
+
+bool CaptureReplayResolver::ResolveGpuDescriptor(const UINT32* pWords, D3D12_GPU_DESCRIPTOR_HANDLE* pHandle) const
+{
+    const UINT32 id = pWords[0];
+    if (id == 0 || id >= m_objects.size() || m_objects[id].pObject == nullptr || m_objects[id].gpuDescriptorStart == 0)
+    {
+        return false;
+    }
+    const Object& heap = m_objects[id];
+    pHandle->ptr = heap.gpuDescriptorStart + static_cast<UINT64>(static_cast<INT64>(pWords[1]) + heap.descriptorOffset) * heap.descriptorSize;
+    return true;
+}
+
+UINT64 CaptureBufferDecoder::Decode(const CaptureFile& file, UINT frameIndex, const CaptureReplayResolver& resolver)
+{
+    UINT64 byteCount = 0;
+    const CaptureFrameRecord& frame = file.GetFrames()[frameIndex];
+    for (UINT i = 0; i < frame.bufferCount; i++)
+    {
+        const CaptureBufferRecord& buffer = file.GetBuffers()[frame.firstBuffer + i];
+        const UINT wordCount = GetWordCount(buffer.size);
+        const UINT32* pDelta = file.GetWords() + buffer.firstWord;
+        std::vector<UINT32>& data = m_data[std::make_pair(buffer.objectId, buffer.offset)];
+        data.resize(wordCount, 0);
+        for (UINT j = 0; j < wordCount; j++)
+        {
+            data[j] ^= pDelta[j];
+        }
+
+        // Upload heaps are write-combined, so the buffer is only ever written, in one go.
+        UINT8* pMappedData = static_cast<UINT8*>(resolver.GetMappedData(buffer.objectId));
+        if (pMappedData)
+        {
+            memcpy(pMappedData + buffer.offset, data.data(), buffer.size);
+            byteCount += buffer.size;
+        }
+    }
+    return byteCount;
+}
+
+CaptureReplayResult ReplayCaptureHeadless(const CaptureFile& file, UINT passCount)
+{
+    const CaptureFileHeader& header = file.GetHeader();
+    CaptureReplayResolver resolver;
+    resolver.BindHeadless(file);
+    CaptureBufferDecoder buffers;
+    std::vector<HeadlessReplayCommandList> commandLists(header.listCount);
+
+    CaptureReplayResult result = {};
+    result.valid = true;
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    for (UINT pass = 0; pass < passCount; pass++)
+    {
+        buffers.Reset();
+        for (UINT i = 0; i < header.frameCount; i++)
+        {
+            const CaptureFrameRecord& frame = file.GetFrames()[i];
+            LARGE_INTEGER frameStart, phaseStart, phaseEnd;
+            QueryPerformanceCounter(&frameStart);
+            result.bufferBytes += buffers.Decode(file, i, resolver);
+            QueryPerformanceCounter(&phaseEnd);
+            result.replayMilliseconds[CapturePhaseUpdate] += GetMilliseconds(frameStart, phaseEnd, frequency);
+
+            for (UINT j = 0; j < frame.streamCount; j++)
+            {
+                const CaptureStreamRecord& stream = file.GetStreams()[frame.firstStream + j];
+                HeadlessReplayCommandList& commandList = commandLists[stream.listIndex];
+                QueryPerformanceCounter(&phaseStart);
+                commandList.Reset();
+                result.valid = ReplayCommandStream(commandList, resolver, file.GetWords() + stream.firstWord, stream.wordCount, &result.statistics) && result.valid;
+                QueryPerformanceCounter(&phaseEnd);
+                result.replayMilliseconds[stream.phase] += GetMilliseconds(phaseStart, phaseEnd, frequency);
+                result.commandBytes += commandList.GetSize();
+            }
+            result.replayFrameMilliseconds += GetMilliseconds(frameStart, phaseEnd, frequency);
+
+            for (UINT phase = 0; phase < CapturePhaseCount; phase++)
+            {
+                result.capturedMilliseconds[phase] += frame.phaseMilliseconds[phase];
+            }
+            result.capturedFrameMilliseconds += frame.frameMilliseconds;
+            result.frameCount++;
+        }
+    }
+    return result;
+}
+
+std::string WriteCaptureReplayJson(const std::wstring& capturePath, const CaptureReplayResult& result)
+{
+    char path[MAX_PATH];
+    sprintf_s(path, "%S", capturePath.c_str());
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"capture\": \"" << EscapeJson(path) << "\",\n";
+    json << "  \"frames\": " << result.frameCount << ",\n";
+    json << "  \"commands\": " << result.statistics.commandCount << ",\n";
+    json << "  \"draws\": " << result.statistics.drawCount << ",\n";
+    json << "  \"barriers\": " << result.statistics.barrierCount << ",\n";
+    json << "  \"unsupported\": " << result.statistics.unsupportedCount << ",\n";
+    json << "  \"buffer_bytes\": " << result.bufferBytes << ",\n";
+    json << "  \"command_bytes\": " << result.commandBytes << ",\n";
+
+    // Per frame, as captured and as replayed.
+    const double frameCount = max(result.frameCount, 1u);
+    char text[128];
+    json << "  \"phases\": {\n";
+    for (UINT phase = 0; phase < CapturePhaseCount; phase++)
+    {
+        sprintf_s(text, "{ \"captured\": %.4f, \"replay\": %.4f }", result.capturedMilliseconds[phase] / frameCount, result.replayMilliseconds[phase] / frameCount);
+        json << "    \"" << GetCapturePhaseName(static_cast<CapturePhase>(phase)) << "\": " << text << ((phase + 1 < CapturePhaseCount) ? ",\n" : "\n");
+    }
+    json << "  },\n";
+    sprintf_s(text, "{ \"captured\": %.4f, \"replay\": %.4f }", result.capturedFrameMilliseconds / frameCount, result.replayFrameMilliseconds / frameCount);
+    json << "  \"frame\": " << text << ",\n";
+    sprintf_s(text, "%.1f", (result.replayFrameMilliseconds > 0.0) ? result.capturedFrameMilliseconds / result.replayFrameMilliseconds : 0.0);
+    json << "  \"speedup\": " << text << "\n";
+    json << "}\n";
+    return json.str();
+}
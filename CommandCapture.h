@@ -0,0 +1,872 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+// Command capture: everything the frame records into its direct queue command lists,
+// and the CPU-written buffers those commands read, saved to a file that replays
+// without the rest of the app. Replaying into HeadlessReplayCommandList times the
+// recording side alone; replaying into the app's own command lists reproduces the
+// frame on the GPU.
+//
+// The file is read in place from a mapped view. Everything is 8-byte aligned:
+//   CaptureFileHeader
+//   CaptureObjectRecord[objectCount]
+//   CaptureFrameRecord[frameCount]
+//   CaptureStreamRecord[streamCount]
+//   CaptureBufferRecord[bufferCount]
+//   UINT32[wordCount]              The command streams and buffer contents.
+//
+// Commands are packets of 32-bit words. Objects are stored as indices into the object
+// table, GPU virtual addresses as an object and an offset, and descriptors as a heap
+// and an index, so a capture does not depend on where anything was allocated. Buffer
+// contents are stored XORed with the same range in the previous frame, which leaves
+// mostly zeros where little changed, so captures compress well.
+
+static const UINT32 CaptureFileMagic = 0x50434433;      // "3DCP"
+static const UINT32 CaptureFileVersion = 2;
+
+enum CaptureObjectType
+{
+    CaptureObjectUnknown = 0,
+    CaptureObjectRootSignature,
+    CaptureObjectPipelineState,
+    CaptureObjectDescriptorHeap,
+    CaptureObjectResource,
+    CaptureObjectCommandSignature,
+    CaptureObjectTypeCount
+};
+
+// The phases of a frame that record, timed during capture and replay.
+enum CapturePhase
+{
+    CapturePhaseUpdate = 0,         // Writing the buffers; during replay, restoring them.
+    CapturePhasePre,                // BeginFrame.
+    CapturePhaseScene,              // The worker threads.
+    CapturePhasePost,               // EndFrame.
+    CapturePhaseCount
+};
+
+const char* GetCapturePhaseName(CapturePhase phase);
+
+enum CaptureCommand
+{
+    CaptureCommandClose = 1,
+    CaptureCommandSetGraphicsRootSignature,
+    CaptureCommandSetPipelineState,
+    CaptureCommandSetDescriptorHeaps,
+    CaptureCommandRSSetViewports,
+    CaptureCommandRSSetScissorRects,
+    CaptureCommandIASetPrimitiveTopology,
+    CaptureCommandIASetVertexBuffers,
+    CaptureCommandIASetIndexBuffer,
+    CaptureCommandOMSetRenderTargets,
+    CaptureCommandSetGraphicsRootDescriptorTable,
+    CaptureCommandSetGraphicsRootConstantBufferView,
+    CaptureCommandSetGraphicsRootShaderResourceView,
+    CaptureCommandSetGraphicsRoot32BitConstant,
+    CaptureCommandSetGraphicsRoot32BitConstants,
+    CaptureCommandDrawInstanced,
+    CaptureCommandDrawIndexedInstanced,
+    CaptureCommandExecuteIndirect,
+    CaptureCommandClearRenderTargetView,
+    CaptureCommandClearDepthStencilView,
+    CaptureCommandResourceBarrier,
+    CaptureCommandCopyResource,
+    CaptureCommandCopyBufferRegion,
+    CaptureCommandDiscardResource,
+    CaptureCommandOMSetBlendFactor,
+    CaptureCommandUnsupported,      // Forwarded but not captured; the payload is the method's name.
+    CaptureCommandCount
+};
+
+// One word per packet: the command in the top 8 bits, the payload's word count below.
+inline UINT32 MakeCapturePacketHeader(CaptureCommand command, UINT payloadWordCount)
+{
+    return (static_cast<UINT32>(command) << 24) | (payloadWordCount & 0xffffff);
+}
+
+struct CaptureFileHeader
+{
+    UINT32 magic;
+    UINT32 version;
+    UINT32 listCount;               // Command lists per frame, in submission order.
+    UINT32 objectCount;
+    UINT32 frameCount;
+    UINT32 streamCount;
+    UINT32 bufferCount;
+    UINT32 reserved;
+    UINT64 objectOffset;            // Byte offsets from the start of the file.
+    UINT64 frameOffset;
+    UINT64 streamOffset;
+    UINT64 bufferOffset;
+    UINT64 wordOffset;
+    UINT64 wordCount;
+};
+
+// Object 0 is null. Unnamed objects were first seen in a command rather than named
+// when the capture began; a replay on a device can't bind them.
+struct CaptureObjectRecord
+{
+    UINT32 type;                    // CaptureObjectType.
+    UINT32 reserved;
+    UINT64 size;                    // Bytes of a buffer, descriptors in a heap.
+    char name[48];
+};
+
+struct CaptureFrameRecord
+{
+    UINT32 firstStream;
+    UINT32 streamCount;
+    UINT32 firstBuffer;
+    UINT32 bufferCount;
+    UINT32 frameResourceIndex;
+    UINT32 backBufferIndex;
+    double phaseMilliseconds[CapturePhaseCount];    // CPU time of each phase.
+    double frameMilliseconds;       // Start of the update to the present returning.
+};
+
+struct CaptureStreamRecord
+{
+    UINT32 phase;                   // CapturePhase.
+    UINT32 listIndex;
+    UINT64 firstWord;
+    UINT64 wordCount;
+};
+
+struct CaptureBufferRecord
+{
+    UINT32 objectId;
+    UINT32 size;                    // Bytes; the data is padded to whole words.
+    UINT64 offset;
+    UINT64 firstWord;
+};
+
+static_assert(sizeof(CaptureFileHeader) % 8 == 0 && sizeof(CaptureObjectRecord) % 8 == 0 && sizeof(CaptureFrameRecord) % 8 == 0 &&
+    sizeof(CaptureStreamRecord) % 8 == 0 && sizeof(CaptureBufferRecord) % 8 == 0, "Capture records must keep 8-byte alignment");
+
+// An object the app names when a capture begins and binds again by the same name to
+// replay it. pMappedData is where the CPU writes a buffer, for the replay to restore
+// its captured contents.
+struct CaptureObjectBinding
+{
+    std::string name;
+    CaptureObjectType type;
+    ID3D12DeviceChild* pObject;
+    void* pMappedData;
+};
+
+struct CaptureFrameTimes
+{
+    double phaseMilliseconds[CapturePhaseCount];
+    double frameMilliseconds;
+};
+
+class CaptureCommandList;
+
+// Records frames. Between BeginFrame and EndFrame, GetCommandList returns a stand-in
+// for each of the frame's command lists that captures every call and forwards it to
+// the real list. Each list may be recorded on its own thread.
+class CommandCaptureWriter
+{
+public:
+    CommandCaptureWriter();
+    ~CommandCaptureWriter();
+
+    void Begin(ID3D12Device* pDevice, UINT listCount, const std::vector<CaptureObjectBinding>& objects);
+    void End();
+    bool IsCapturing() const { return m_pDevice != nullptr; }
+
+    void BeginFrame(UINT frameResourceIndex, UINT backBufferIndex);
+    ID3D12GraphicsCommandList* GetCommandList(UINT listIndex, CapturePhase phase, ID3D12GraphicsCommandList* pCommandList);
+    // Call from the thread that wrote the buffer, before the frame's lists are recorded.
+    void CaptureBufferData(ID3D12Resource* pBuffer, UINT64 offset, const void* pData, UINT size);
+    void EndFrame(const CaptureFrameTimes& times);
+
+    bool Save(const std::wstring& path) const;
+
+    UINT GetFrameCount() const { return static_cast<UINT>(m_frames.size()); }
+    UINT64 GetCommandCount() const { return m_commandCount; }
+    UINT64 GetUnsupportedCommandCount() const { return m_unsupportedCommandCount; }
+    UINT64 GetUnresolvedReferenceCount() const { return m_unresolvedReferenceCount; }
+    UINT64 GetSize() const;
+
+    // Used by the command list stand-ins.
+    UINT EncodeObject(ID3D12DeviceChild* pObject, CaptureObjectType type);
+    void EncodeGpuAddress(D3D12_GPU_VIRTUAL_ADDRESS address, UINT32* pWords);
+    void EncodeCpuDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE handle, UINT32* pWords);
+    void EncodeGpuDescriptor(D3D12_GPU_DESCRIPTOR_HANDLE handle, UINT32* pWords);
+
+private:
+    struct ObjectInfo
+    {
+        CaptureObjectRecord record;
+        SIZE_T cpuDescriptorStart;
+        UINT64 gpuDescriptorStart;
+        UINT descriptorSize;
+    };
+
+    UINT AddObject(ID3D12DeviceChild* pObject, CaptureObjectType type, const std::string& name);
+    UINT FindDescriptorHeap(UINT64 handle, bool shaderVisible, UINT* pIndex);
+
+    ID3D12Device* m_pDevice;
+    UINT m_listCount;
+
+    // Written from every recording thread; lookups are shared, additions exclusive.
+    mutable SRWLOCK m_objectLock;
+    std::vector<ObjectInfo> m_objects;
+    std::map<ID3D12DeviceChild*, UINT> m_objectIds;
+    std::map<D3D12_GPU_VIRTUAL_ADDRESS, UINT> m_bufferAddresses;   // Start of each buffer.
+    std::vector<UINT> m_descriptorHeaps;
+    volatile LONG64 m_unresolvedReferenceCount;
+    UINT64 m_commandCount;
+    UINT64 m_unsupportedCommandCount;
+
+    std::vector<std::unique_ptr<CaptureCommandList>> m_commandLists;
+
+    // The frame being recorded. A list's stand-in starts a new stream the first time
+    // it is asked for in a frame.
+    CaptureFrameRecord m_frame;
+    UINT m_frameSerial;
+    std::map<std::pair<UINT, UINT64>, std::vector<UINT32>> m_previousBufferData;
+
+    std::vector<CaptureFrameRecord> m_frames;
+    std::vector<CaptureStreamRecord> m_streams;
+    std::vector<CaptureBufferRecord> m_buffers;
+    std::vector<UINT32> m_words;
+};
+
+// A capture file mapped into memory.
+class CaptureFile
+{
+public:
+    CaptureFile();
+    ~CaptureFile();
+
+    bool Open(const std::wstring& path, std::string* pError);
+    void Close();
+    bool IsOpen() const { return m_pView != nullptr; }
+
+    const CaptureFileHeader& GetHeader() const { return *m_pHeader; }
+    const CaptureObjectRecord* GetObjects() const { return m_pObjects; }
+    const CaptureFrameRecord* GetFrames() const { return m_pFrames; }
+    const CaptureStreamRecord* GetStreams() const { return m_pStreams; }
+    const CaptureBufferRecord* GetBuffers() const { return m_pBuffers; }
+    const UINT32* GetWords() const { return m_pWords; }
+
+private:
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const void* m_pView;
+    const CaptureFileHeader* m_pHeader;
+    const CaptureObjectRecord* m_pObjects;
+    const CaptureFrameRecord* m_pFrames;
+    const CaptureStreamRecord* m_pStreams;
+    const CaptureBufferRecord* m_pBuffers;
+    const UINT32* m_pWords;
+};
+
+// Maps a capture's object indices, addresses and descriptors to live objects.
+class CaptureReplayResolver
+{
+public:
+    CaptureReplayResolver() : m_pDevice(nullptr), m_pFile(nullptr) {}
+
+    // Every object starts unbound.
+    void Reset(ID3D12Device* pDevice, const CaptureFile& file);
+    // Returns false if the capture has no object of that name. descriptorOffset moves
+    // every descriptor index in a heap, such as render target views captured for one
+    // back buffer onto another.
+    bool Bind(const CaptureObjectBinding& binding, INT descriptorOffset = 0);
+    // Binds every object to a placeholder, for replaying into HeadlessReplayCommandList.
+    void BindHeadless(const CaptureFile& file);
+    UINT GetUnboundObjectCount() const;
+
+    // Each returns false if the reference is to an unbound object.
+    template <class T>
+    bool ResolveObject(UINT32 id, T** ppObject) const
+    {
+        *ppObject = nullptr;
+        if (id == 0)
+        {
+            return true;
+        }
+        if (id >= m_objects.size() || m_objects[id].pObject == nullptr)
+        {
+            return false;
+        }
+        *ppObject = static_cast<T*>(m_objects[id].pObject);
+        return true;
+    }
+    bool ResolveGpuAddress(const UINT32* pWords, D3D12_GPU_VIRTUAL_ADDRESS* pAddress) const;
+    bool ResolveCpuDescriptor(const UINT32* pWords, D3D12_CPU_DESCRIPTOR_HANDLE* pHandle) const;
+    bool ResolveGpuDescriptor(const UINT32* pWords, D3D12_GPU_DESCRIPTOR_HANDLE* pHandle) const;
+    void* GetMappedData(UINT32 id) const { return (id < m_objects.size()) ? m_objects[id].pMappedData : nullptr; }
+
+private:
+    struct Object
+    {
+        void* pObject;
+        void* pMappedData;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+        SIZE_T cpuDescriptorStart;
+        UINT64 gpuDescriptorStart;
+        UINT descriptorSize;
+        INT descriptorOffset;
+    };
+
+    ID3D12Device* m_pDevice;
+    const CaptureFile* m_pFile;
+    std::vector<Object> m_objects;
+    std::vector<std::vector<UINT32>> m_headlessData;     // Stands in for the mapped buffers.
+};
+
+// Restores a frame's captured buffer contents. Keeps the decoded contents of every
+// range, since each frame's are stored relative to the frame before.
+class CaptureBufferDecoder
+{
+public:
+    // Before the first frame; replays that loop reset at every pass.
+    void Reset() { m_data.clear(); }
+    // Writes into the resolver's mapped pointers, where bound. Returns the bytes restored.
+    UINT64 Decode(const CaptureFile& file, UINT frameIndex, const CaptureReplayResolver& resolver);
+
+private:
+    std::map<std::pair<UINT, UINT64>, std::vector<UINT32>> m_data;
+};
+
+struct CaptureReplayStatistics
+{
+    UINT64 commandCount;
+    UINT64 drawCount;
+    UINT64 barrierCount;
+    UINT64 unsupportedCount;        // Calls the capture could not store.
+    UINT64 unresolvedCount;         // Commands skipped because they use an unbound object.
+};
+
+// Has the ID3D12GraphicsCommandList calls ReplayCommandStream makes. Like
+// HeadlessCommandEncoder it appends a packed record per call, roughly what a driver
+// writes, so a headless replay costs about what recording does.
+class HeadlessReplayCommandList
+{
+public:
+    void Reset() { m_commands.clear(); }
+    size_t GetSize() const { return m_commands.size() * sizeof(UINT32); }
+    const UINT32* GetData() const { return m_commands.data(); }
+
+    HRESULT Close() { Write(CaptureCommandClose); return S_OK; }
+    void SetGraphicsRootSignature(ID3D12RootSignature* pRootSignature) { Write(CaptureCommandSetGraphicsRootSignature, pRootSignature); }
+    void SetPipelineState(ID3D12PipelineState* pPipelineState) { Write(CaptureCommandSetPipelineState, pPipelineState); }
+    void SetDescriptorHeaps(UINT numDescriptorHeaps, ID3D12DescriptorHeap* const* ppDescriptorHeaps)
+    {
+        Write(CaptureCommandSetDescriptorHeaps, numDescriptorHeaps);
+        for (UINT i = 0; i < numDescriptorHeaps; i++)
+        {
+            Write(ppDescriptorHeaps[i]);
+        }
+    }
+    void RSSetViewports(UINT numViewports, const D3D12_VIEWPORT* pViewports) { WriteArray(CaptureCommandRSSetViewports, pViewports, numViewports); }
+    void RSSetScissorRects(UINT numRects, const D3D12_RECT* pRects) { WriteArray(CaptureCommandRSSetScissorRects, pRects, numRects); }
+    void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology) { Write(CaptureCommandIASetPrimitiveTopology, primitiveTopology); }
+    void IASetVertexBuffers(UINT startSlot, UINT numViews, const D3D12_VERTEX_BUFFER_VIEW* pViews)
+    {
+        WriteArray(CaptureCommandIASetVertexBuffers, pViews, numViews);
+        Write(startSlot);
+    }
+    void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* pView) { WriteArray(CaptureCommandIASetIndexBuffer, pView, pView ? 1 : 0); }
+    void OMSetBlendFactor(const FLOAT blendFactor[4]) { WriteArray(CaptureCommandOMSetBlendFactor, blendFactor, 4); }
+    void OMSetRenderTargets(UINT numRenderTargetDescriptors, const D3D12_CPU_DESCRIPTOR_HANDLE* pRenderTargetDescriptors, BOOL singleHandleToDescriptorRange, const D3D12_CPU_DESCRIPTOR_HANDLE* pDepthStencilDescriptor)
+    {
+        WriteArray(CaptureCommandOMSetRenderTargets, pRenderTargetDescriptors, singleHandleToDescriptorRange ? 1 : numRenderTargetDescriptors);
+        Write(pDepthStencilDescriptor ? pDepthStencilDescriptor->ptr : 0);
+    }
+    void SetGraphicsRootDescriptorTable(UINT rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) { Write(CaptureCommandSetGraphicsRootDescriptorTable, rootParameterIndex, baseDescriptor.ptr); }
+    void SetGraphicsRootConstantBufferView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) { Write(CaptureCommandSetGraphicsRootConstantBufferView, rootParameterIndex, bufferLocation); }
+    void SetGraphicsRootShaderResourceView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) { Write(CaptureCommandSetGraphicsRootShaderResourceView, rootParameterIndex, bufferLocation); }
+    void SetGraphicsRoot32BitConstant(UINT rootParameterIndex, UINT srcData, UINT destOffsetIn32BitValues) { Write(CaptureCommandSetGraphicsRoot32BitConstant, rootParameterIndex, srcData, destOffsetIn32BitValues); }
+    void SetGraphicsRoot32BitConstants(UINT rootParameterIndex, UINT num32BitValuesToSet, const void* pSrcData, UINT destOffsetIn32BitValues)
+    {
+        WriteArray(CaptureCommandSetGraphicsRoot32BitConstants, static_cast<const UINT32*>(pSrcData), num32BitValuesToSet);
+        Write(rootParameterIndex, destOffsetIn32BitValues);
+    }
+    void DrawInstanced(UINT vertexCountPerInstance, UINT instanceCount, UINT startVertexLocation, UINT startInstanceLocation)
+    {
+        Write(CaptureCommandDrawInstanced, vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+    }
+    void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndexLocation, INT baseVertexLocation, UINT startInstanceLocation)
+    {
+        Write(CaptureCommandDrawIndexedInstanced, indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation);
+        Write(startInstanceLocation);
+    }
+    void ExecuteIndirect(ID3D12CommandSignature* pCommandSignature, UINT maxCommandCount, ID3D12Resource* pArgumentBuffer, UINT64 argumentBufferOffset, ID3D12Resource* pCountBuffer, UINT64 countBufferOffset)
+    {
+        Write(CaptureCommandExecuteIndirect, pCommandSignature, maxCommandCount, pArgumentBuffer);
+        Write(argumentBufferOffset, pCountBuffer, countBufferOffset);
+    }
+    void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView, const FLOAT colorRGBA[4], UINT numRects, const D3D12_RECT* pRects)
+    {
+        WriteArray(CaptureCommandClearRenderTargetView, pRects, numRects);
+        Write(renderTargetView.ptr);
+        WriteArray(colorRGBA, 4);
+    }
+    void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE depthStencilView, D3D12_CLEAR_FLAGS clearFlags, FLOAT depth, UINT8 stencil, UINT numRects, const D3D12_RECT* pRects)
+    {
+        WriteArray(CaptureCommandClearDepthStencilView, pRects, numRects);
+        Write(depthStencilView.ptr, clearFlags, depth, stencil);
+    }
+    void ResourceBarrier(UINT numBarriers, const D3D12_RESOURCE_BARRIER* pBarriers) { WriteArray(CaptureCommandResourceBarrier, pBarriers, numBarriers); }
+    void CopyResource(ID3D12Resource* pDstResource, ID3D12Resource* pSrcResource) { Write(CaptureCommandCopyResource, pDstResource, pSrcResource); }
+    void CopyBufferRegion(ID3D12Resource* pDstBuffer, UINT64 dstOffset, ID3D12Resource* pSrcBuffer, UINT64 srcOffset, UINT64 numBytes)
+    {
+        Write(CaptureCommandCopyBufferRegion, pDstBuffer, dstOffset, pSrcBuffer);
+        Write(srcOffset, numBytes);
+    }
+    void DiscardResource(ID3D12Resource* pResource, const D3D12_DISCARD_REGION* pRegion)
+    {
+        Write(CaptureCommandDiscardResource, pResource);
+        if (pRegion)
+        {
+            WriteArray(pRegion->pRects, pRegion->NumRects);
+            Write(pRegion->FirstSubresource, pRegion->NumSubresources);
+        }
+    }
+
+private:
+    void WriteValue(UINT32 value) { m_commands.push_back(value); }
+    void WriteValue(INT value) { m_commands.push_back(static_cast<UINT32>(value)); }
+    void WriteValue(FLOAT value) { UINT32 word; memcpy(&word, &value, sizeof(word)); m_commands.push_back(word); }
+    void WriteValue(UINT64 value) { m_commands.push_back(static_cast<UINT32>(value)); m_commands.push_back(static_cast<UINT32>(value >> 32)); }
+    void WriteValue(const void* pointer) { WriteValue(static_cast<UINT64>(reinterpret_cast<UINT_PTR>(pointer))); }
+
+    template <class... Values>
+    void Write(Values... values)
+    {
+        const int unused[] = { 0, (WriteValue(values), 0)... };
+        (void)unused;
+    }
+
+    template <class T>
+    void WriteArray(const T* pValues, UINT count)
+    {
+        const size_t first = m_commands.size();
+        const size_t wordCount = (count * sizeof(T) + sizeof(UINT32) - 1) / sizeof(UINT32);
+        m_commands.resize(first + wordCount);
+        if (wordCount > 0)
+        {
+            memcpy(m_commands.data() + first, pValues, count * sizeof(T));
+        }
+    }
+
+    template <class T>
+    void WriteArray(CaptureCommand command, const T* pValues, UINT count)
+    {
+        Write(command, count);
+        WriteArray(pValues, count);
+    }
+
+    std::vector<UINT32> m_commands;
+};
+
+namespace CaptureReplayDetail
+{
+    inline FLOAT ReadFloat(const UINT32* pWord)
+    {
+        FLOAT value;
+        memcpy(&value, pWord, sizeof(value));
+        return value;
+    }
+
+    inline UINT64 ReadUint64(const UINT32* pWords)
+    {
+        return pWords[0] | (static_cast<UINT64>(pWords[1]) << 32);
+    }
+
+    inline D3D12_RECT ReadRect(const UINT32* pWords)
+    {
+        const D3D12_RECT rect = { static_cast<LONG>(pWords[0]), static_cast<LONG>(pWords[1]), static_cast<LONG>(pWords[2]), static_cast<LONG>(pWords[3]) };
+        return rect;
+    }
+}
+
+// Replays one captured command stream. CommandList is ID3D12GraphicsCommandList, or
+// HeadlessReplayCommandList to time the replay without a device. Commands that use an
+// unbound object are skipped and counted. Returns false if the stream is malformed.
+template <class CommandList>
+bool ReplayCommandStream(CommandList& commandList, const CaptureReplayResolver& resolver, const UINT32* pWords, UINT64 wordCount, CaptureReplayStatistics* pStatistics)
+{
+    using namespace CaptureReplayDetail;
+
+    // Enough for the largest packet the writer emits.
+    const UINT MaxArrayCount = 16;
+    UINT64 position = 0;
+    while (position < wordCount)
+    {
+        const UINT32 header = pWords[position];
+        const CaptureCommand command = static_cast<CaptureCommand>(header >> 24);
+        const UINT32 payloadWordCount = header & 0xffffff;
+        const UINT32* p = pWords + position + 1;
+        position += 1 + payloadWordCount;
+        if (position > wordCount)
+        {
+            return false;
+        }
+        pStatistics->commandCount++;
+
+        bool resolved = true;
+        switch (command)
+        {
+        case CaptureCommandClose:
+            ThrowIfFailed(commandList.Close());
+            break;
+
+        case CaptureCommandSetGraphicsRootSignature:
+        {
+            ID3D12RootSignature* pRootSignature;
+            if ((resolved = resolver.ResolveObject(p[0], &pRootSignature)))
+            {
+                commandList.SetGraphicsRootSignature(pRootSignature);
+            }
+            break;
+        }
+
+        case CaptureCommandSetPipelineState:
+        {
+            ID3D12PipelineState* pPipelineState;
+            if ((resolved = resolver.ResolveObject(p[0], &pPipelineState)))
+            {
+                commandList.SetPipelineState(pPipelineState);
+            }
+            break;
+        }
+
+        case CaptureCommandSetDescriptorHeaps:
+        {
+            ID3D12DescriptorHeap* ppHeaps[MaxArrayCount];
+            const UINT count = min(p[0], MaxArrayCount);
+            for (UINT i = 0; i < count; i++)
+            {
+                resolved = resolver.ResolveObject(p[1 + i], &ppHeaps[i]) && resolved;
+            }
+            if (resolved)
+            {
+                commandList.SetDescriptorHeaps(count, ppHeaps);
+            }
+            break;
+        }
+
+        case CaptureCommandRSSetViewports:
+        {
+            D3D12_VIEWPORT viewports[MaxArrayCount];
+            const UINT count = min(p[0], MaxArrayCount);
+            for (UINT i = 0; i < count; i++)
+            {
+                const UINT32* pViewport = p + 1 + 6 * i;
+                const D3D12_VIEWPORT viewport = { ReadFloat(pViewport), ReadFloat(pViewport + 1), ReadFloat(pViewport + 2), ReadFloat(pViewport + 3), ReadFloat(pViewport + 4), ReadFloat(pViewport + 5) };
+                viewports[i] = viewport;
+            }
+            commandList.RSSetViewports(count, viewports);
+            break;
+        }
+
+        case CaptureCommandRSSetScissorRects:
+        {
+            D3D12_RECT rects[MaxArrayCount];
+            const UINT count = min(p[0], MaxArrayCount);
+            for (UINT i = 0; i < count; i++)
+            {
+                rects[i] = ReadRect(p + 1 + 4 * i);
+            }
+            commandList.RSSetScissorRects(count, rects);
+            break;
+        }
+
+        case CaptureCommandIASetPrimitiveTopology:
+            commandList.IASetPrimitiveTopology(static_cast<D3D12_PRIMITIVE_TOPOLOGY>(p[0]));
+            break;
+
+        case CaptureCommandOMSetBlendFactor:
+        {
+            const FLOAT blendFactor[4] = { ReadFloat(p), ReadFloat(p + 1), ReadFloat(p + 2), ReadFloat(p + 3) };
+            commandList.OMSetBlendFactor(blendFactor);
+            break;
+        }
+
+        case CaptureCommandIASetVertexBuffers:
+        {
+            // Start slot, count, then per view: address (3 words), size and stride.
+            D3D12_VERTEX_BUFFER_VIEW views[MaxArrayCount];
+            const UINT count = min(p[1], MaxArrayCount);
+            for (UINT i = 0; i < count; i++)
+            {
+                const UINT32* pView = p + 2 + 5 * i;
+                resolved = resolver.ResolveGpuAddress(pView, &views[i].BufferLocation) && resolved;
+                views[i].SizeInBytes = pView[3];
+                views[i].StrideInBytes = pView[4];
+            }
+            if (resolved)
+            {
+                commandList.IASetVertexBuffers(p[0], count, views);
+            }
+            break;
+        }
+
+        case CaptureCommandIASetIndexBuffer:
+        {
+            // A flag for whether there is a view, then its address (3 words), size and format.
+            D3D12_INDEX_BUFFER_VIEW view = {};
+            if (p[0] != 0)
+            {
+                resolved = resolver.ResolveGpuAddress(p + 1, &view.BufferLocation);
+                view.SizeInBytes = p[4];
+                view.Format = static_cast<DXGI_FORMAT>(p[5]);
+            }
+            if (resolved)
+            {
+                commandList.IASetIndexBuffer((p[0] != 0) ? &view : nullptr);
+            }
+            break;
+        }
+
+        case CaptureCommandOMSetRenderTargets:
+        {
+            // Count, single handle flag, depth flag, the handles, then the depth handle.
+            D3D12_CPU_DESCRIPTOR_HANDLE handles[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT];
+            D3D12_CPU_DESCRIPTOR_HANDLE depthHandle = {};
+            const BOOL singleHandle = p[1];
+            const UINT handleCount = singleHandle ? min(p[0], 1u) : min(p[0], static_cast<UINT>(D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT));
+            for (UINT i = 0; i < handleCount; i++)
+            {
+                resolved = resolver.ResolveCpuDescriptor(p + 3 + 2 * i, &handles[i]) && resolved;
+            }
+            if (p[2] != 0)
+            {
+                resolved = resolver.ResolveCpuDescriptor(p + 3 + 2 * handleCount, &depthHandle) && resolved;
+            }
+            if (resolved)
+            {
+                commandList.OMSetRenderTargets(singleHandle ? p[0] : handleCount, handleCount ? handles : nullptr, singleHandle, (p[2] != 0) ? &depthHandle : nullptr);
+            }
+            break;
+        }
+
+        case CaptureCommandSetGraphicsRootDescriptorTable:
+        {
+            D3D12_GPU_DESCRIPTOR_HANDLE handle;
+            if ((resolved = resolver.ResolveGpuDescriptor(p + 1, &handle)))
+            {
+                commandList.SetGraphicsRootDescriptorTable(p[0], handle);
+            }
+            break;
+        }
+
+        case CaptureCommandSetGraphicsRootConstantBufferView:
+        case CaptureCommandSetGraphicsRootShaderResourceView:
+        {
+            D3D12_GPU_VIRTUAL_ADDRESS address;
+            if ((resolved = resolver.ResolveGpuAddress(p + 1, &address)))
+            {
+                if (command == CaptureCommandSetGraphicsRootConstantBufferView)
+                {
+                    commandList.SetGraphicsRootConstantBufferView(p[0], address);
+                }
+                else
+                {
+                    commandList.SetGraphicsRootShaderResourceView(p[0], address);
+                }
+            }
+            break;
+        }
+
+        case CaptureCommandSetGraphicsRoot32BitConstant:
+            commandList.SetGraphicsRoot32BitConstant(p[0], p[1], p[2]);
+            break;
+
+        case CaptureCommandSetGraphicsRoot32BitConstants:
+            // Root parameter, offset, count, then the values.
+            commandList.SetGraphicsRoot32BitConstants(p[0], p[2], p + 3, p[1]);
+            break;
+
+        case CaptureCommandDrawInstanced:
+            commandList.DrawInstanced(p[0], p[1], p[2], p[3]);
+            pStatistics->drawCount++;
+            break;
+
+        case CaptureCommandDrawIndexedInstanced:
+            commandList.DrawIndexedInstanced(p[0], p[1], p[2], static_cast<INT>(p[3]), p[4]);
+            pStatistics->drawCount++;
+            break;
+
+        case CaptureCommandExecuteIndirect:
+        {
+            // Signature, max count, argument buffer and offset (2 words), count buffer and offset.
+            ID3D12CommandSignature* pCommandSignature;
+            ID3D12Resource* pArgumentBuffer;
+            ID3D12Resource* pCountBuffer;
+            resolved = resolver.ResolveObject(p[0], &pCommandSignature) &&
+                resolver.ResolveObject(p[2], &pArgumentBuffer) &&
+                resolver.ResolveObject(p[5], &pCountBuffer);
+            if (resolved)
+            {
+                commandList.ExecuteIndirect(pCommandSignature, p[1], pArgumentBuffer, ReadUint64(p + 3), pCountBuffer, ReadUint64(p + 6));
+                pStatistics->drawCount++;
+            }
+            break;
+        }
+
+        case CaptureCommandClearRenderTargetView:
+        {
+            // The view (2 words), the color, the rect count and the rects.
+            D3D12_CPU_DESCRIPTOR_HANDLE handle;
+            D3D12_RECT rects[MaxArrayCount];
+            const FLOAT color[4] = { ReadFloat(p + 2), ReadFloat(p + 3), ReadFloat(p + 4), ReadFloat(p + 5) };
+            const UINT rectCount = min(p[6], MaxArrayCount);
+            for (UINT i = 0; i < rectCount; i++)
+            {
+                rects[i] = ReadRect(p + 7 + 4 * i);
+            }
+            if ((resolved = resolver.ResolveCpuDescriptor(p, &handle)))
+            {
+                commandList.ClearRenderTargetView(handle, color, rectCount, rectCount ? rects : nullptr);
+            }
+            break;
+        }
+
+        case CaptureCommandClearDepthStencilView:
+        {
+            // The view (2 words), flags, depth, stencil, the rect count and the rects.
+            D3D12_CPU_DESCRIPTOR_HANDLE handle;
+            D3D12_RECT rects[MaxArrayCount];
+            const UINT rectCount = min(p[5], MaxArrayCount);
+            for (UINT i = 0; i < rectCount; i++)
+            {
+                rects[i] = ReadRect(p + 6 + 4 * i);
+            }
+            if ((resolved = resolver.ResolveCpuDescriptor(p, &handle)))
+            {
+                commandList.ClearDepthStencilView(handle, static_cast<D3D12_CLEAR_FLAGS>(p[2]), ReadFloat(p + 3), static_cast<UINT8>(p[4]), rectCount, rectCount ? rects : nullptr);
+            }
+            break;
+        }
+
+        case CaptureCommandResourceBarrier:
+        {
+            // Per barrier: type, flags and four words that depend on the type.
+            D3D12_RESOURCE_BARRIER barriers[MaxArrayCount];
+            const UINT count = min(p[0], MaxArrayCount);
+            for (UINT i = 0; i < count; i++)
+            {
+                const UINT32* pBarrier = p + 1 + 6 * i;
+                D3D12_RESOURCE_BARRIER& barrier = barriers[i];
+                barrier.Type = static_cast<D3D12_RESOURCE_BARRIER_TYPE>(pBarrier[0]);
+                barrier.Flags = static_cast<D3D12_RESOURCE_BARRIER_FLAGS>(pBarrier[1]);
+                switch (barrier.Type)
+                {
+                case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+                    resolved = resolver.ResolveObject(pBarrier[2], &barrier.Transition.pResource) && resolved;
+                    barrier.Transition.Subresource = pBarrier[3];
+                    barrier.Transition.StateBefore = static_cast<D3D12_RESOURCE_STATES>(pBarrier[4]);
+                    barrier.Transition.StateAfter = static_cast<D3D12_RESOURCE_STATES>(pBarrier[5]);
+                    break;
+
+                case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+                    resolved = resolver.ResolveObject(pBarrier[2], &barrier.Aliasing.pResourceBefore) && resolved;
+                    resolved = resolver.ResolveObject(pBarrier[3], &barrier.Aliasing.pResourceAfter) && resolved;
+                    break;
+
+                default:
+                    resolved = resolver.ResolveObject(pBarrier[2], &barrier.UAV.pResource) && resolved;
+                    break;
+                }
+            }
+            if (resolved)
+            {
+                commandList.ResourceBarrier(count, barriers);
+                pStatistics->barrierCount += count;
+            }
+            break;
+        }
+
+        case CaptureCommandCopyResource:
+        {
+            ID3D12Resource* pDestination;
+            ID3D12Resource* pSource;
+            if ((resolved = resolver.ResolveObject(p[0], &pDestination) && resolver.ResolveObject(p[1], &pSource)))
+            {
+                commandList.CopyResource(pDestination, pSource);
+            }
+            break;
+        }
+
+        case CaptureCommandCopyBufferRegion:
+        {
+            // Destination and offset (2 words), source and offset, then the size.
+            ID3D12Resource* pDestination;
+            ID3D12Resource* pSource;
+            if ((resolved = resolver.ResolveObject(p[0], &pDestination) && resolver.ResolveObject(p[3], &pSource)))
+            {
+                commandList.CopyBufferRegion(pDestination, ReadUint64(p + 1), pSource, ReadUint64(p + 4), ReadUint64(p + 6));
+            }
+            break;
+        }
+
+        case CaptureCommandDiscardResource:
+        {
+            // The resource, a flag for whether there is a region, then its first
+            // subresource, subresource count, rect count and rects.
+            ID3D12Resource* pResource;
+            D3D12_RECT rects[MaxArrayCount];
+            D3D12_DISCARD_REGION region = {};
+            if (p[1] != 0)
+            {
+                region.NumRects = min(p[4], MaxArrayCount);
+                region.pRects = region.NumRects ? rects : nullptr;
+                region.FirstSubresource = p[2];
+                region.NumSubresources = p[3];
+                for (UINT i = 0; i < region.NumRects; i++)
+                {
+                    rects[i] = ReadRect(p + 5 + 4 * i);
+                }
+            }
+            if ((resolved = resolver.ResolveObject(p[0], &pResource)))
+            {
+                commandList.DiscardResource(pResource, (p[1] != 0) ? &region : nullptr);
+            }
+            break;
+        }
+
+        case CaptureCommandUnsupported:
+            pStatistics->unsupportedCount++;
+            break;
+
+        default:
+            return false;
+        }
+
+        if (!resolved)
+        {
+            pStatistics->unresolvedCount++;
+        }
+    }
+    return true;
+}
+
+// Times replaying every frame of a capture into HeadlessReplayCommandLists, one per
+// captured list, passCount times over.
+struct CaptureReplayResult
+{
+    UINT frameCount;                // Replayed, over every pass.
+    CaptureReplayStatistics statistics;
+    double capturedMilliseconds[CapturePhaseCount];     // Totals, over every pass.
+    double replayMilliseconds[CapturePhaseCount];
+    double capturedFrameMilliseconds;
+    double replayFrameMilliseconds;
+    UINT64 bufferBytes;
+    UINT64 commandBytes;            // Written by the headless command lists.
+    bool valid;                     // False if a stream was malformed.
+};
+
+CaptureReplayResult ReplayCaptureHeadless(const CaptureFile& file, UINT passCount);
+
+std::string WriteCaptureReplayJson(const std::wstring& capturePath, const CaptureReplayResult& result);
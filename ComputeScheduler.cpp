@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include "ComputeScheduler.h"
+
+namespace
+{
+    // Weight of a new measurement in the cost model's moving average.
+    const double CostSmoothing = 0.1;
+}
+
+FencedCommandQueue::FencedCommandQueue() :
+    m_nextFenceValue(1),
+    m_fenceEvent(nullptr)
+{
+}
+
+FencedCommandQueue::~FencedCommandQueue()
+{
+    Release();
+}
+
+void FencedCommandQueue::Create(ID3D12Device* pDevice, D3D12_COMMAND_LIST_TYPE type)
+{
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    queueDesc.Type = type;
+    ThrowIfFailed(pDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue)));
+    ThrowIfFailed(pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+    m_nextFenceValue = 1;
+    m_waits.clear();
+
+    m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (m_fenceEvent == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+}
+
+void FencedCommandQueue::Release()
+{
+    if (m_fenceEvent != nullptr)
+    {
+        CloseHandle(m_fenceEvent);
+        m_fenceEvent = nullptr;
+    }
+    m_waits.clear();
+    m_fence.Reset();
+    m_queue.Reset();
+}
+
+UINT64 FencedCommandQueue::ExecuteCommandLists(UINT count, ID3D12CommandList* const* ppCommandLists)
+{
+    m_queue->ExecuteCommandLists(count, ppCommandLists);
+    const UINT64 fenceValue = m_nextFenceValue++;
+    ThrowIfFailed(m_queue->Signal(m_fence.Get(), fenceValue));
+    return fenceValue;
+}
+
+bool FencedCommandQueue::IsWaitCovered(void* pWaiter, UINT64 fenceValue)
+{
+    for (QueueWait& wait : m_waits)
+    {
+        if (wait.pWaiter == pWaiter)
+        {
+            if (wait.fenceValue >= fenceValue)
+            {
+                return true;
+            }
+            wait.fenceValue = fenceValue;
+            return false;
+        }
+    }
+
+    QueueWait wait = { pWaiter, fenceValue };
+    m_waits.push_back(wait);
+    return false;
+}
+
+void FencedCommandQueue::InsertWait(ID3D12CommandQueue* pConsumer, UINT64 fenceValue)
+{
+    if (fenceValue == 0 || IsWaitCovered(pConsumer, fenceValue))
+    {
+        return;
+    }
+    ThrowIfFailed(pConsumer->Wait(m_fence.Get(), fenceValue));
+}
+
+void FencedCommandQueue::WaitForFence(ID3D12Fence* pFence, UINT64 fenceValue)
+{
+    if (fenceValue == 0 || IsWaitCovered(pFence, fenceValue))
+    {
+        return;
+    }
+    ThrowIfFailed(m_queue->Wait(pFence, fenceValue));
+}
+
+void FencedCommandQueue::WaitForCpu(UINT64 fenceValue)
+{
+    if (m_fence->GetCompletedValue() < fenceValue)
+    {
+        ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+        WaitForSingleObject(m_fenceEvent, INFINITE);
+    }
+}
+
+WorkloadScheduler::WorkloadScheduler(double cpuItemCost, double gpuFixedCost, double gpuItemCost) :
+    m_cpuItemCost(cpuItemCost),
+    m_gpuFixedCost(gpuFixedCost),
+    m_gpuItemCost(gpuItemCost)
+{
+}
+
+WorkloadScheduler::ExecutionTarget WorkloadScheduler::Choose(UINT itemCount) const
+{
+    const double cpuCost = itemCount * m_cpuItemCost;
+    const double gpuCost = m_gpuFixedCost + itemCount * m_gpuItemCost;
+    return (gpuCost < cpuCost) ? ExecutionTargetGpu : ExecutionTargetCpu;
+}
+
+void WorkloadScheduler::RecordCpuTime(UINT itemCount, double microseconds)
+{
+    if (itemCount > 0)
+    {
+        m_cpuItemCost += CostSmoothing * (microseconds / itemCount - m_cpuItemCost);
+    }
+}
+
+void WorkloadScheduler::RecordGpuTime(UINT itemCount, double microseconds)
+{
+    if (itemCount > 0)
+    {
+        m_gpuItemCost += CostSmoothing * (microseconds / itemCount - m_gpuItemCost);
+    }
+}
+
+UINT WorkloadScheduler::GetBreakEvenItemCount() const
+{
+    if (m_cpuItemCost <= m_gpuItemCost)
+    {
+        return UINT_MAX;
+    }
+    const double breakEven = m_gpuFixedCost / (m_cpuItemCost - m_gpuItemCost);
+    if (breakEven >= UINT_MAX)
+    {
+        return UINT_MAX;
+    }
+    return static_cast<UINT>(breakEven) + 1;
+}
+
+UINT QueueTimelineSimulator::AddQueue()
+{
+    Queue queue = {};
+    m_queues.push_back(queue);
+    return static_cast<UINT>(m_queues.size() - 1);
+}
+
+UINT64 QueueTimelineSimulator::Submit(UINT queue, double submitTime, double duration, const std::vector<QueueWait>& waits)
+{
+    double startTime = max(submitTime, m_queues[queue].idleTime);
+    for (const QueueWait& wait : waits)
+    {
+        // A wait on a value nobody has submitted yet would hang a real queue.
+        assert(wait.fenceValue <= m_queues[wait.queue].submissions.size());
+        startTime = max(startTime, GetCompletionTime(wait.queue, wait.fenceValue));
+    }
+
+    Submission submission = {};
+    submission.queue = queue;
+    submission.fenceValue = m_queues[queue].submissions.size() + 1;
+    submission.submitTime = submitTime;
+    submission.startTime = startTime;
+    submission.endTime = startTime + duration;
+    m_submissions.push_back(submission);
+
+    m_queues[queue].submissions.push_back(static_cast<UINT>(m_submissions.size() - 1));
+    m_queues[queue].idleTime = submission.endTime;
+    return submission.fenceValue;
+}
+
+double QueueTimelineSimulator::GetCompletionTime(UINT queue, UINT64 fenceValue) const
+{
+    if (fenceValue == 0)
+    {
+        return 0.0;
+    }
+    return m_submissions[m_queues[queue].submissions[fenceValue - 1]].endTime;
+}
+
+double QueueTimelineSimulator::GetBusyTime(UINT queue) const
+{
+    double busyTime = 0.0;
+    for (UINT index : m_queues[queue].submissions)
+    {
+        busyTime += m_submissions[index].endTime - m_submissions[index].startTime;
+    }
+    return busyTime;
+}
+
+// Work on one queue never overlaps itself, so summing pairwise intersections is exact.
+double QueueTimelineSimulator::GetOverlapTime(UINT queueA, UINT queueB) const
+{
+    double overlapTime = 0.0;
+    for (UINT a : m_queues[queueA].submissions)
+    {
+        for (UINT b : m_queues[queueB].submissions)
+        {
+            const double start = max(m_submissions[a].startTime, m_submissions[b].startTime);
+            const double end = min(m_submissions[a].endTime, m_submissions[b].endTime);
+            if (end > start)
+            {
+                overlapTime += end - start;
+            }
+        }
+    }
+    return overlapTime;
+}
+
+double QueueTimelineSimulator::GetEndTime() const
+{
+    double endTime = 0.0;
+    for (const Queue& queue : m_queues)
+    {
+        endTime = max(endTime, queue.idleTime);
+    }
+    return endTime;
+}
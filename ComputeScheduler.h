@@ -0,0 +1,126 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include <vector>
+
+// A command queue paired with its own fence. Every submission signals the next fence
+// value, and waits from other queues are only inserted when they are not already
+// covered by an earlier wait, so callers can state every dependency without cost.
+class FencedCommandQueue
+{
+public:
+    FencedCommandQueue();
+    ~FencedCommandQueue();
+
+    void Create(ID3D12Device* pDevice, D3D12_COMMAND_LIST_TYPE type);
+    void Release();
+
+    ID3D12CommandQueue* GetQueue() const { return m_queue.Get(); }
+
+    // Returns the fence value that marks completion of these command lists.
+    UINT64 ExecuteCommandLists(UINT count, ID3D12CommandList* const* ppCommandLists);
+
+    // Makes pConsumer wait on the GPU until this queue has reached fenceValue.
+    void InsertWait(ID3D12CommandQueue* pConsumer, UINT64 fenceValue);
+
+    // Makes this queue wait on the GPU for another queue's fence.
+    void WaitForFence(ID3D12Fence* pFence, UINT64 fenceValue);
+
+    UINT64 GetCompletedValue() const { return m_fence->GetCompletedValue(); }
+    void WaitForCpu(UINT64 fenceValue);
+    void WaitForIdle() { WaitForCpu(m_nextFenceValue - 1); }
+private:
+    struct QueueWait
+    {
+        void* pWaiter;          // Consumer queue, or the fence this queue waited on.
+        UINT64 fenceValue;
+    };
+
+    bool IsWaitCovered(void* pWaiter, UINT64 fenceValue);
+
+    ComPtr<ID3D12CommandQueue> m_queue;
+    ComPtr<ID3D12Fence> m_fence;
+    UINT64 m_nextFenceValue;
+    HANDLE m_fenceEvent;
+    std::vector<QueueWait> m_waits;     // Highest value already waited for, per pair of queues.
+};
+
+// Chooses where a data-parallel workload runs. The CPU path costs main-thread time per
+// item; the GPU path costs a fixed recording, submission and cross-queue sync overhead
+// plus a small per-item time that mostly overlaps the previous frame's graphics work.
+class WorkloadScheduler
+{
+public:
+    enum ExecutionTarget
+    {
+        ExecutionTargetCpu = 0,
+        ExecutionTargetGpu
+    };
+
+    // Costs in microseconds.
+    WorkloadScheduler(double cpuItemCost = 0.05, double gpuFixedCost = 60.0, double gpuItemCost = 0.002);
+
+    ExecutionTarget Choose(UINT itemCount) const;
+
+    // Measured timings refine the model with an exponential moving average.
+    void RecordCpuTime(UINT itemCount, double microseconds);
+    void RecordGpuTime(UINT itemCount, double microseconds);
+
+    // Smallest workload for which the GPU path is chosen.
+    UINT GetBreakEvenItemCount() const;
+
+    double GetCpuItemCost() const { return m_cpuItemCost; }
+    double GetGpuItemCost() const { return m_gpuItemCost; }
+    double GetGpuFixedCost() const { return m_gpuFixedCost; }
+
+private:
+    double m_cpuItemCost;
+    double m_gpuFixedCost;
+    double m_gpuItemCost;
+};
+
+// Replays queue submissions against a simulated clock to check that cross-queue waits
+// order work correctly and to measure how much the queues overlap. Submissions are
+// modelled in CPU submission order, as a real queue would see them.
+class QueueTimelineSimulator
+{
+public:
+    struct QueueWait
+    {
+        UINT queue;
+        UINT64 fenceValue;
+    };
+
+    struct Submission
+    {
+        UINT queue;
+        UINT64 fenceValue;
+        double submitTime;
+        double startTime;
+        double endTime;
+    };
+
+    UINT AddQueue();
+
+    // Starts once the queue is idle, every wait is satisfied and submitTime has passed.
+    // Returns the fence value the submission signals when it completes.
+    UINT64 Submit(UINT queue, double submitTime, double duration, const std::vector<QueueWait>& waits = std::vector<QueueWait>());
+
+    // Simulated time at which the queue's fence reaches fenceValue.
+    double GetCompletionTime(UINT queue, UINT64 fenceValue) const;
+
+    double GetBusyTime(UINT queue) const;
+    double GetOverlapTime(UINT queueA, UINT queueB) const;
+    double GetEndTime() const;
+    const std::vector<Submission>& GetSubmissions() const { return m_submissions; }
+
+private:
+    struct Queue
+    {
+        std::vector<UINT> submissions;      // Indices into m_submissions, in fence order.
+        double idleTime;
+    };
+
+    std::vector<Queue> m_queues;
+    std::vector<Submission> m_submissions;
+};
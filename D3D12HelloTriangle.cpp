@@ -13,6 +13,8 @@
 #include "D3D12HelloTriangle.h"
 #include "FrameResource.h"
 #include <process.h>
+#include <algorithm>
+#include <random>
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
@@ -36,15 +38,116 @@ void EnableDebugLayer()
 
 D3D12HelloTriangle* D3D12HelloTriangle::s_app = nullptr;
 
+namespace
+{
+    const WCHAR ShaderCacheFilename[] = L"shaders.cache";
+    const WCHAR PipelineLibraryFilename[] = L"pipelines.cache";
+    const WCHAR CaptureFilename[] = L"frames.capture";
+
+    // About two seconds at 60 Hz.
+    const UINT CaptureFrameCount = 120;
+
+    // Timestamp pairs per frame: the render graph's passes and one per scene list.
+    const UINT MaxGpuZoneCount = 32;
+
+    // On the compute queue: the transform update and the cull and compact.
+    const UINT MaxComputeZoneCount = 2;
+    const char TransformZoneName[] = "Transforms";
+
+    // The occlusion buffer only has to resolve whole objects, so a fraction of the
+    // window's resolution will do; at this size every band is a few tile rows.
+    const UINT OcclusionBufferWidth = 256;
+    const UINT OcclusionBufferHeight = 144;
+
+    // A few quads across, so a cell re-tested for view movement holds a handful of objects.
+    const float VisibilityCellSize = 0.25f;
+
+    // Objects per group node in the object hierarchy.
+    const UINT ObjectGroupSize = 4;
+
+    // Radians per second. The spin is the old 0.1 radians every FrameCount frames at 60 Hz.
+    const float ObjectSpinRate = 2.0f;
+    const float GroupOrbitRate = 0.6f;
+
+    // The group drift's steps per second, and how far ahead of the clock its thread
+    // keeps: far enough for the display time of a frame started now.
+    const double GroupSimulationStepRate = 60.0;
+    const double GroupSimulationLead = FrameCount / GroupSimulationStepRate;
+    const UINT GroupSimulationMaxCatchUpSteps = 8;
+
+    // Vertices and indices together; the texture takes half the upload ring already.
+    const size_t MaxMeshUploadSize = static_cast<size_t>(UploadRingBufferSize / 4);
+
+    // QuantizedVertex; the vertex shaders dequantise it.
+    const D3D12_INPUT_ELEMENT_DESC SceneInputElementDescs[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+    };
+}
+
 D3D12HelloTriangle::D3D12HelloTriangle(UINT width, UINT height, std::wstring name) :
     DXSample(width, height, name),
     m_frameIndex(0),
     m_viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)),
     m_scissorRect(0, 0, static_cast<LONG>(width), static_cast<LONG>(height)),
     m_rtvDescriptorSize(0),
-    m_fenceValues{}
+    m_indexCount(0),
+    m_wireframe(false),
+    m_objectSpin(AnimationCurve::Rotation(0.0f, ObjectSpinRate)),
+    m_objectRotation(0.0f),
+    m_animationStartTime(0.0),
+    m_objectCullRadius(0.0f),
+    m_objectHalfSize(0.0f),
+    m_objectFillsSquare(true),
+    m_transformMode(TransformModeAuto),
+    m_groupOrbit(AnimationCurve::Rotation(0.0f, GroupOrbitRate)),
+    m_groupOrbitStartTime(0.0),
+    m_groupDriftStartTime(0.0),
+    m_groupsOrbiting(false),
+    m_groupsDrifting(false),
+    m_groupsMoved(false),
+    m_objectPositionsUploaded(true),
+    m_gpuDriven(false),
+    m_validateIndirectDraws(false),
+    m_occlusionCulling(false),
+    m_occlusionTestedCount(0),
+    m_occlusionCulledCount(0),
+    m_lodSelection(false),
+    m_meshletCulling(false),
+    m_objectRangesBuilt(false),
+    m_meshletTestedCount(0),
+    m_meshletCulledCount(0),
+    m_lodTriangleCount(0),
+    m_fullDetailTriangleCount(0),
+    m_drawBindingStrategy(DrawBindingDescriptorTable),
+    m_scenePipelineStateKeys{},
+    m_pendingScenePipelineStateKeys{},
+    m_depthMode(DepthModeOff),
+    m_opaqueDrawCount(0),
+    m_frameResources{},
+    m_pCurrentFrameResource(nullptr),
+    m_hotReloadPending(false),
+    m_fenceValues{},
+    m_frameLatencyWaitableObject(nullptr),
+    m_maxFrameLatency(2),
+    m_tearingSupported(false),
+    m_vsync(true),
+    m_framePacingEnabled(true),
+    m_frameTiming{},
+    m_lastFrameStatistics{},
+    m_captureFramesRemaining(0),
+    m_frameStartTime(0.0),
+    m_frameTimes{},
+    m_replayFrame(0),
+    m_replayStatistics{},
+    m_replayTimes{}
 {
     s_app = this;
+    m_occlusionBuffer.Create(OcclusionBufferWidth, OcclusionBufferHeight);
+    m_overdrawEstimator.Create(width, height);
+    InitializeSynchronizationBarrier(&m_occlusionBarrier, NumContexts, -1);
 }
 
 void D3D12HelloTriangle::OnInit()
@@ -52,6 +155,12 @@ void D3D12HelloTriangle::OnInit()
     LoadPipeline();
     LoadAssets();
     LoadContexts();
+    m_animationStartTime = m_pacingClock.Now();
+
+    if (!m_replayCapturePath.empty())
+    {
+        StartReplay();
+    }
 }
 
 // Load the rendering pipeline dependencies.
@@ -107,6 +216,8 @@ void D3D12HelloTriangle::LoadPipeline()
 
     ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
 
+    // Object transforms can be computed here, overlapping the direct queue's graphics work.
+    m_computeQueue.Create(m_device.Get(), D3D12_COMMAND_LIST_TYPE_COMPUTE);
     // Describe and create the swap chain.
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.BufferCount = FrameCount;
@@ -117,6 +228,23 @@ void D3D12HelloTriangle::LoadPipeline()
     swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
     swapChainDesc.SampleDesc.Count = 1;
 
+    // Presents without vsync only go out immediately when tearing is allowed, which is
+    // also what lets a variable refresh display follow the frame rate.
+    {
+        ComPtr<IDXGIFactory5> factory5;
+        BOOL allowTearing = FALSE;
+        if (SUCCEEDED(factory.As(&factory5)) &&
+            SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing))))
+        {
+            m_tearingSupported = (allowTearing == TRUE);
+        }
+    }
+    swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    if (m_tearingSupported)
+    {
+        swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+    }
+
     ComPtr<IDXGISwapChain1> swapChain;
     ThrowIfFailed(factory->CreateSwapChainForHwnd(
         m_commandQueue.Get(),        // Swap chain needs the queue so that it can force a flush on it.
@@ -131,6 +259,11 @@ void D3D12HelloTriangle::LoadPipeline()
     ThrowIfFailed(factory->MakeWindowAssociation(Win32Application::GetHwnd(), DXGI_MWA_NO_ALT_ENTER));
 
     ThrowIfFailed(swapChain.As(&m_swapChain));
+
+    // Present no longer blocks when too many frames are queued; OnUpdate waits on this
+    // object before starting a frame instead.
+    ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(m_maxFrameLatency));
+    m_frameLatencyWaitableObject = m_swapChain->GetFrameLatencyWaitableObject();
     m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 
     // Create descriptor heaps.
@@ -146,7 +279,7 @@ void D3D12HelloTriangle::LoadPipeline()
 
         // Describe and create a shader resource view (SRV) heap for the texture.
         D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-        srvHeapDesc.NumDescriptors = 1 + ConstBufferNum*FrameCount; // srv + cbv
+        srvHeapDesc.NumDescriptors = 1 + FrameResource::DescriptorCount * FrameCount; // srv + cbv
         srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
         srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
         ThrowIfFailed(m_device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&m_srvHeap)));
@@ -165,6 +298,9 @@ void D3D12HelloTriangle::LoadPipeline()
     }
 
     ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
+
+    // Buffers and textures are placed into large heaps owned by the suballocator.
+    m_heapAllocator.Create(m_device.Get());
 }
 
 // Load the sample assets.
@@ -186,9 +322,13 @@ void D3D12HelloTriangle::LoadAssets()
         ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);//Texture
         ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);// 1 frequently changed constant buffer.
 
-        CD3DX12_ROOT_PARAMETER1 rootParameters[2];
+        CD3DX12_ROOT_PARAMETER1 rootParameters[6];
         rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL);
         rootParameters[1].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_ALL);
+        rootParameters[2].InitAsConstants(1, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);    // Object index, set per draw or by ExecuteIndirect.
+        rootParameters[3].InitAsShaderResourceView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);   // Object transforms.
+        rootParameters[4].InitAsConstantBufferView(0, 1, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_VERTEX);    // Object constants by GPU VA.
+        rootParameters[5].InitAsConstants(sizeof(VertexDequantization) / sizeof(UINT32), 2, 0, D3D12_SHADER_VISIBILITY_VERTEX);     // Vertex dequantisation.
         D3D12_STATIC_SAMPLER_DESC sampler = {};
         sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
         sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
@@ -214,126 +354,298 @@ void D3D12HelloTriangle::LoadAssets()
         ComPtr<ID3DBlob> error;
         ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &signature, &error));
         ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
-    }
 
+        // PSOs are keyed by the serialized root signature, so the library matches across runs.
+        m_pipelineStateCache.Create(m_device.Get(), GetAssetFullPath(PipelineLibraryFilename));
+        m_pipelineStateCache.RegisterRootSignature(m_rootSignature.Get(), signature->GetBufferPointer(), signature->GetBufferSize());
+
+        // Compute root signature for ObjectTransforms.hlsl.
+        ThrowIfFailed(SerializeObjectTransformRootSignature(featureData.HighestVersion, &signature, &error));
+        ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_computeRootSignature)));
+
+        // Each indirect command sets the object index root constant, then draws.
+        D3D12_INDIRECT_ARGUMENT_DESC argumentDescs[2] = {};
+        argumentDescs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+        argumentDescs[0].Constant.RootParameterIndex = 2;
+        argumentDescs[0].Constant.DestOffsetIn32BitValues = 0;
+        argumentDescs[0].Constant.Num32BitValuesToSet = 1;
+        argumentDescs[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {};
+        commandSignatureDesc.ByteStride = sizeof(IndirectCommand);
+        commandSignatureDesc.NumArgumentDescs = _countof(argumentDescs);
+        commandSignatureDesc.pArgumentDescs = argumentDescs;
+        ThrowIfFailed(m_device->CreateCommandSignature(&commandSignatureDesc, m_rootSignature.Get(), IID_PPV_ARGS(&m_commandSignature)));
+        NAME_D3D12_OBJECT(m_commandSignature);
+    }
     // PSO   Shader 
     // Create the pipeline state, which includes compiling and loading shaders.
     {
-        ComPtr<ID3DBlob> vertexShader;
-        ComPtr<ID3DBlob> pixelShader;
+        // Shader bytecode comes from the cache file when the sources are unchanged.
+        LARGE_INTEGER frequency, loadStart, loadEnd;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&loadStart);
+
+        m_shaderCache.Open(GetAssetFullPath(ShaderCacheFilename));
+        D3D12_SHADER_BYTECODE vertexShader = LoadShader(ShaderProgramSceneVS);
+        D3D12_SHADER_BYTECODE pixelShader = LoadShader(ShaderProgramScenePS);
+        D3D12_SHADER_BYTECODE objectTransformShader = LoadShader(ShaderProgramObjectTransformsCS);
+        D3D12_SHADER_BYTECODE indirectVertexShader = LoadShader(ShaderProgramSceneIndirectVS);
+        D3D12_SHADER_BYTECODE cullAndCompactShader = LoadShader(ShaderProgramCullAndCompactCS);
+        D3D12_SHADER_BYTECODE rootCbvVertexShader = LoadShader(ShaderProgramSceneRootCbvVS);
+        QueryPerformanceCounter(&loadEnd);
+        char message[128];
+        sprintf_s(message, "Shaders loaded in %.2f ms (%u cached, %u compiled)\n",
+            1000.0 * (loadEnd.QuadPart - loadStart.QuadPart) / frequency.QuadPart, m_shaderCache.GetHitCount(), m_shaderCache.GetMissCount());
+        OutputDebugStringA(message);
+
+        // In ShaderProgramId order.
+        const D3D12_SHADER_BYTECODE shaderBytecode[ShaderProgramCount] = { vertexShader, pixelShader, objectTransformShader, indirectVertexShader, cullAndCompactShader, rootCbvVertexShader };
+
+        // Describe and create the graphics pipeline state objects (PSOs).
+        for (UINT pipeline = 0; pipeline < ScenePipelineCount; pipeline++)
+        {
+            const D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = DescribeScenePipeline(static_cast<ScenePipeline>(pipeline), shaderBytecode);
+            ComPtr<ID3D12PipelineState>* pPipelineState = GetScenePipelineState(static_cast<ScenePipeline>(pipeline));
+            if (pPipelineState == nullptr)
+            {
+                // Variants are compiled in the background; the default PSO is drawn until they are ready.
+                m_scenePipelineStateKeys[pipeline] = m_pipelineStateCache.RequestPipelineState(psoDesc);
+            }
+            else
+            {
+                *pPipelineState = m_pipelineStateCache.GetPipelineState(psoDesc);
+                m_scenePipelineStateKeys[pipeline] = m_pipelineStateCache.GetKey(psoDesc);
+            }
+        }
 
-#if defined(_DEBUG)
-        // Enable better shader debugging with the graphics debugging tools.
-        UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-        UINT compileFlags = 0;
-#endif
-        ThrowIfFailed(D3DCompileFromFile(GetAssetFullPath(L"shaders.hlsl").c_str(), nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-        ThrowIfFailed(D3DCompileFromFile(GetAssetFullPath(L"shaders.hlsl").c_str(), nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
-        // Define the vertex input layout.
-        D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+        D3D12_COMPUTE_PIPELINE_STATE_DESC computePsoDesc = {};
+        computePsoDesc.pRootSignature = m_computeRootSignature.Get();
+        computePsoDesc.CS = objectTransformShader;
+        ThrowIfFailed(m_device->CreateComputePipelineState(&computePsoDesc, IID_PPV_ARGS(&m_objectTransformPipelineState)));
+        NAME_D3D12_OBJECT(m_objectTransformPipelineState);
+
+        computePsoDesc.CS = cullAndCompactShader;
+        ThrowIfFailed(m_device->CreateComputePipelineState(&computePsoDesc, IID_PPV_ARGS(&m_cullAndCompactPipelineState)));
+        NAME_D3D12_OBJECT(m_cullAndCompactPipelineState);
+
+        // Recompile in the background whenever a shader source in the assets directory, or
+        // a file it includes, is saved.
+        std::vector<ShaderHotReload::ShaderSource> shaderSources(ShaderProgramCount);
+        for (UINT i = 0; i < ShaderProgramCount; i++)
         {
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-        };
+            shaderSources[i].filename = GetAssetFullPath(ShaderPrograms[i].filename);
+            shaderSources[i].entryPoint = ShaderPrograms[i].entryPoint;
+            shaderSources[i].target = ShaderPrograms[i].target;
+            shaderSources[i].initialBytecode = shaderBytecode[i];
+        }
+        m_shaderHotReload.Start(GetAssetFullPath(L""), shaderSources, ShaderHotReload::DefaultCompileFunction(GetShaderCompileFlags()));
 
-        // Describe and create the graphics pipeline state object (PSO).
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-        psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-        psoDesc.pRootSignature = m_rootSignature.Get();
-        psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-        psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
-        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-        psoDesc.DepthStencilState.DepthEnable = FALSE;
-        psoDesc.DepthStencilState.StencilEnable = FALSE;
-        psoDesc.SampleMask = UINT_MAX;
-        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-        psoDesc.NumRenderTargets = 1;
-        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-        psoDesc.SampleDesc.Count = 1;
-        ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
+        // The PSO cache and hot reload hold their own copies of the bytecode; persist anything that was compiled.
+        m_shaderCache.Close();
     }
 
     // Create the command list.
     ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocator.Get(), m_pipelineState.Get(), IID_PPV_ARGS(&m_commandList)));
 
-    // Create the vertex buffer.
+    // Every upload below is staged through this ring and copied into DEFAULT heap resources.
+    m_uploadRing.Create(&m_heapAllocator, UploadRingBufferSize);
+    m_gpuTimer.Create(m_device.Get(), m_commandQueue.Get(), &m_heapAllocator, FrameCount, MaxGpuZoneCount);
+    m_computeTimer.Create(m_device.Get(), m_computeQueue.GetQueue(), &m_heapAllocator, FrameCount, MaxComputeZoneCount);
+
+    // The object mesh: the one named on the command line, fitted to the quad's square,
+    // or else the quad. Either way its triangles are reordered for the vertex cache and
+    // its vertices for fetching, and its indices drop to 16 bits if they can.
+    Mesh mesh;
+    if (!m_meshPath.empty())
+    {
+        std::string error;
+        if (!LoadMeshFile(m_meshPath, NumContexts, &mesh, &error))
+        {
+            mesh = Mesh();
+        }
+        else if ((mesh.vertices.size() * sizeof(QuantizedVertex) + 2 * mesh.indices.size() * sizeof(UINT32)) > MaxMeshUploadSize)
+        {
+            // It's staged through the upload ring along with the texture. The LODs after
+            // the first add up to less than it again.
+            error = "larger than the upload ring can stage";
+            mesh = Mesh();
+        }
+        if (!error.empty())
+        {
+            OutputDebugStringA(("Can't import the mesh, drawing the quad instead: " + error + "\n").c_str());
+        }
+        else
+        {
+            FitMeshToSquare(&mesh, 0.05f);
+            m_objectFillsSquare = false;
+            m_lodSelection = true;
+            m_meshletCulling = true;
+        }
+    }
+    if (mesh.indices.empty())
     {
-        // Define the geometry for a triangle.
-        Vertex triangleVertices[] =//m_aspectRatio
+        // Define the geometry for a quad.
+        const MeshVertex quadVertices[] =//m_aspectRatio
         {
             { { -0.05f, 0.05f, 0.0f }, { 0.0f, 0.0f} },//   
             { { 0.05f, -0.05f, 0.0f }, { 1.0f, 1.0f } },//  ϴ 
             { { -0.05f, -0.05f, 0.0f }, { 0.0f, 1.0f} },//  ϴ 
             { { 0.05f,   0.05f, 0.0f }, { 1.0f, 0.0f } },//   
         };
+        const UINT32 quadIndices[] =
+        {
+            0,1,2,
+            0,3,1
+        };
+        mesh.vertices.assign(quadVertices, quadVertices + _countof(quadVertices));
+        mesh.indices.assign(quadIndices, quadIndices + _countof(quadIndices));
+    }
+    OptimizeMesh(&mesh);
+    BuildMeshLods(&mesh, MaxLodCount);
+    BuildMeshlets(mesh, NumContexts, &m_meshlets);
+    m_meshLods = mesh.lods;
 
-        const UINT vertexBufferSize = sizeof(triangleVertices);
-
-        // Note: using upload heaps to transfer static data like vert buffers is not 
-        // recommended. Every time the GPU needs it, the upload heap will be marshalled 
-        // over. Please read up on Default Heap usage. An upload heap is used here for 
-        // code simplicity and because there are very few verts to actually transfer.
-        ThrowIfFailed(m_device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
+    // Create the vertex buffer, quantised; the vertex shaders dequantise it. The file's
+    // normals are kept when it has them for every vertex.
+    {
+        if (!mesh.importedNormals)
+        {
+            ComputeVertexNormals(&mesh);
+        }
+        QuantizedMesh quantizedMesh;
+        QuantizeMesh(mesh, NumContexts, &quantizedMesh);
+        m_vertexDequantization = quantizedMesh.dequantization;
+        char message[256];
+        sprintf_s(message, "Quantised %zu vertices to %zu bytes each, from %zu: largest errors %.2g of the radius, %.2g in texture coordinates, %.3f degrees of normal\n",
+            mesh.vertices.size(), sizeof(QuantizedVertex), sizeof(MeshVertex), quantizedMesh.error.position, quantizedMesh.error.uv, quantizedMesh.error.normalDegrees);
+        OutputDebugStringA(message);
+
+        const UINT vertexBufferSize = static_cast<UINT>(quantizedMesh.vertices.size() * sizeof(QuantizedVertex));
+
+        // Static geometry lives in GPU-local memory; the data is staged through the upload ring.
+        m_heapAllocator.CreatePlacedResource(
+            D3D12_HEAP_TYPE_DEFAULT,
             &CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
+            D3D12_RESOURCE_STATE_COPY_DEST,
             nullptr,
-            IID_PPV_ARGS(&m_vertexBuffer)));
+            IID_PPV_ARGS(&m_vertexBuffer));
 
-        // Copy the triangle data to the vertex buffer.
-        UINT8* pVertexDataBegin;
-        CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-        ThrowIfFailed(m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-        memcpy(pVertexDataBegin, triangleVertices, sizeof(triangleVertices));
-        m_vertexBuffer->Unmap(0, nullptr);
+        // Copy the mesh data to the vertex buffer.
+        m_uploadRing.CopyBuffer(m_commandList.Get(), m_vertexBuffer.Get(), 0, quantizedMesh.vertices.data(), vertexBufferSize);
+        m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
 
         // Initialize the vertex buffer view.
         m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-        m_vertexBufferView.StrideInBytes = sizeof(Vertex);
+        m_vertexBufferView.StrideInBytes = sizeof(QuantizedVertex);
         m_vertexBufferView.SizeInBytes = vertexBufferSize;
+
+        // Bounding radius used to cull objects against the viewport.
+        for (const MeshVertex& vertex : mesh.vertices)
+        {
+            m_objectCullRadius = max(m_objectCullRadius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&vertex.position))));
+            m_objectHalfSize = max(m_objectHalfSize, max(fabsf(vertex.position.x), fabsf(vertex.position.y)));
+        }
     }
 
     // Create the Index Buffer
     {
-        // Define the geometry for a triangle.
-        uint32_t triangleIndex[] =
-        {
-            0,1,2,
-            0,3,1
-        };
-
-        const UINT indexBufferSize = sizeof(triangleIndex);
-
-        ThrowIfFailed(m_device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
+        std::vector<UINT8> indexData;
+        const DXGI_FORMAT indexFormat = PackIndexBuffer(mesh.indices, static_cast<UINT>(mesh.vertices.size()), &indexData);
+        const UINT indexBufferSize = static_cast<UINT>(indexData.size());
+        // Every LOD shares the buffer; whole-mesh draws take LOD 0, at the front.
+        m_indexCount = mesh.lods[0].indexCount;
+
+        m_heapAllocator.CreatePlacedResource(
+            D3D12_HEAP_TYPE_DEFAULT,
             &CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
+            D3D12_RESOURCE_STATE_COPY_DEST,
             nullptr,
-            IID_PPV_ARGS(&m_IndexBuffer)));
+            IID_PPV_ARGS(&m_IndexBuffer));
 
-        // Copy the triangle data to the vertex buffer.
-        UINT8* pVertexDataBegin;
-        CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-        ThrowIfFailed(m_IndexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-        memcpy(pVertexDataBegin, triangleIndex, sizeof(triangleIndex));
-        m_IndexBuffer->Unmap(0, nullptr);
+        // Copy the index data to the index buffer.
+        m_uploadRing.CopyBuffer(m_commandList.Get(), m_IndexBuffer.Get(), 0, indexData.data(), indexBufferSize);
+        m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_IndexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER));
 
         // Initialize the vertex buffer view.
         m_IndexBufferView.BufferLocation = m_IndexBuffer->GetGPUVirtualAddress();
         m_IndexBufferView.SizeInBytes = indexBufferSize;
-        m_IndexBufferView.Format = DXGI_FORMAT::DXGI_FORMAT_R32_UINT;
+        m_IndexBufferView.Format = indexFormat;
     }
 
+    // Place the objects. Shared by every frame resource and by both transform paths.
+    {
+        std::random_device rd; //    ʿ õ 
+        std::mt19937 gen(rd()); //    (Mersenne Twister)
+
+        // 2. -1.0 ~ 1.0   εҼ ڸ ϴ  
+        std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+        // Inside the depth range, so the depth modes have something to sort by.
+        std::uniform_real_distribution<float> depthDis(0.05f, 0.95f);
+        m_objectPositions.resize(ConstBufferNum);
+        for (int i = 0; i < ConstBufferNum; i++)
+        {
+            m_objectPositions[i] = XMFLOAT4(dis(gen), dis(gen), depthDis(gen), 0.0f);
+        }
+        m_visibilityCache.Reset(m_objectPositions.data(), ConstBufferNum, m_objectCullRadius, GetClipSpaceView(), VisibilityCellSize);
+
+        std::vector<float> lodErrors;
+        for (const MeshLod& lod : m_meshLods)
+        {
+            lodErrors.push_back(lod.error);
+        }
+        m_lodSelector.Reset(lodErrors.data(), static_cast<UINT>(lodErrors.size()), ConstBufferNum, m_objectCullRadius, LodHysteresis);
+
+        // The groups come first in build order, then the objects, each offset from its
+        // group's centroid.
+        const UINT groupCount = (ConstBufferNum + ObjectGroupSize - 1) / ObjectGroupSize;
+        std::vector<UINT> parents(groupCount + ConstBufferNum, TransformHierarchy::NoParent);
+        std::vector<UINT> groupSizes(groupCount, 0);
+        m_groupCentroids.assign(groupCount, XMFLOAT2(0.0f, 0.0f));
+        for (int i = 0; i < ConstBufferNum; i++)
+        {
+            const UINT group = i / ObjectGroupSize;
+            parents[groupCount + i] = group;
+            groupSizes[group]++;
+            m_groupCentroids[group].x += m_objectPositions[i].x;
+            m_groupCentroids[group].y += m_objectPositions[i].y;
+        }
+        m_objectHierarchy.Build(parents.data(), static_cast<UINT>(parents.size()));
+        for (UINT group = 0; group < groupCount; group++)
+        {
+            m_groupCentroids[group].x /= groupSizes[group];
+            m_groupCentroids[group].y /= groupSizes[group];
+            m_objectHierarchy.SetLocalTransform(m_objectHierarchy.GetNode(group), XMMatrixTranslation(m_groupCentroids[group].x, m_groupCentroids[group].y, 0.0f));
+        }
+        for (int i = 0; i < ConstBufferNum; i++)
+        {
+            const XMFLOAT4& position = m_objectPositions[i];
+            const XMFLOAT2& centroid = m_groupCentroids[i / ObjectGroupSize];
+            m_objectHierarchy.SetLocalTransform(m_objectHierarchy.GetNode(groupCount + i), XMMatrixTranslation(position.x - centroid.x, position.y - centroid.y, position.z));
+        }
+        m_objectHierarchy.UpdateWorldTransforms(0, 1, nullptr);
+        m_groupPositions = m_groupCentroids;
+
+        std::uniform_real_distribution<float> velocityDis(-0.2f, 0.2f);
+        m_groupVelocities.resize(groupCount);
+        for (XMFLOAT2& velocity : m_groupVelocities)
+        {
+            velocity = XMFLOAT2(velocityDis(gen), velocityDis(gen));
+        }
+
+        const UINT positionBufferSize = static_cast<UINT>(m_objectPositions.size() * sizeof(XMFLOAT4));
+        m_heapAllocator.CreatePlacedResource(
+            D3D12_HEAP_TYPE_DEFAULT,
+            &CD3DX12_RESOURCE_DESC::Buffer(positionBufferSize),
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&m_objectPositionBuffer));
+        NAME_D3D12_OBJECT(m_objectPositionBuffer);
+
+        m_uploadRing.CopyBuffer(m_commandList.Get(), m_objectPositionBuffer.Get(), 0, m_objectPositions.data(), positionBufferSize);
+        m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_objectPositionBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+    }
     // ؽó
-    // Note: ComPtr's are CPU objects but this resource needs to stay in scope until
-    // the command list that references it has finished executing on the GPU.
-    // We will flush the GPU at the end of this method to ensure the resource is not
-    // prematurely destroyed.
-    ComPtr<ID3D12Resource> textureUploadHeap;
     // Create the texture.
     {
         // Copy data to the intermediate upload heap and then schedule a copy 
@@ -357,33 +669,19 @@ void D3D12HelloTriangle::LoadAssets()
         textureDesc.SampleDesc.Quality = 0;
         textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 
-        ThrowIfFailed(m_device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-            D3D12_HEAP_FLAG_NONE,
+        m_heapAllocator.CreatePlacedResource(
+            D3D12_HEAP_TYPE_DEFAULT,
             &textureDesc,
             D3D12_RESOURCE_STATE_COPY_DEST,
             nullptr,
-            IID_PPV_ARGS(&m_texture)));
-
-        const UINT64 uploadBufferSize = GetRequiredIntermediateSize(m_texture.Get(), 0, 1);
-
-        // Create the GPU upload buffer.
-        ThrowIfFailed(m_device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&textureUploadHeap)));
-
-
+            IID_PPV_ARGS(&m_texture));
 
         D3D12_SUBRESOURCE_DATA textureData = {};
         textureData.pData = &texture[0];
         textureData.RowPitch = textureWidth * texturePixelSize;
         textureData.SlicePitch = textureData.RowPitch * textureHeight;
 
-        UpdateSubresources(m_commandList.Get(), m_texture.Get(), textureUploadHeap.Get(), 0, 0, 1, &textureData);
+        m_uploadRing.CopyTexture(m_commandList.Get(), m_texture.Get(), 0, 1, &textureData);
         m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 
         // Describe and create a SRV for the texture.
@@ -402,7 +700,8 @@ void D3D12HelloTriangle::LoadAssets()
     // Create frame resources.
     for (int i = 0; i < FrameCount; i++)
     {
-        m_frameResources[i] = new FrameResource(m_device.Get(), m_pipelineState.Get(), m_srvHeap.Get(), &m_viewport, i);
+        m_frameResources[i] = new FrameResource(m_device.Get(), &m_heapAllocator, m_pipelineState.Get(), m_srvHeap.Get(), &m_viewport, i);
+        m_frameResources[i]->m_renderGraph.SetGpuTimer(&m_gpuTimer);
         //m_frameResources[i]->WriteConstantBuffers(XMMatrixIdentity());
     }
     m_currentFrameResourceIndex = 0;
@@ -427,6 +726,7 @@ void D3D12HelloTriangle::LoadAssets()
         // Signal and increment the fence value.
         const UINT64 fenceToWaitFor = m_fenceValue;
         ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fenceToWaitFor));
+        m_uploadRing.FinishFrame(fenceToWaitFor);
         m_fenceValue++;
 
         // Wait until the fence is completed.
@@ -481,14 +781,21 @@ void D3D12HelloTriangle::LoadContexts()
 // Update frame-based values.
 void D3D12HelloTriangle::OnUpdate()
 {
+    m_frameStartTime = m_pacingClock.Now();
+    WaitForFrameStart();
+
     PIXSetMarker(m_commandQueue.Get(), 0, L"Getting last completed fence.");
 
     // Get current GPU progress against submitted workload. Resources still scheduled 
     // for GPU execution cannot be modified or else undefined behavior will result.
     const UINT64 lastCompletedFence = m_fence->GetCompletedValue();
 
-    // Move to the next frame resource.
-    m_currentFrameResourceIndex = (m_currentFrameResourceIndex + 1) % FrameCount;
+    // Hand back staging memory whose copies have finished on the GPU.
+    m_uploadRing.Retire(lastCompletedFence);
+
+    // Move to the next frame resource. A replay uses the one the captured frame did, which
+    // the captured descriptors and buffer addresses belong to.
+    m_currentFrameResourceIndex = m_replayFile.IsOpen() ? m_replayFile.GetFrames()[m_replayFrame].frameResourceIndex : (m_currentFrameResourceIndex + 1) % FrameCount;
     m_pCurrentFrameResource = m_frameResources[m_currentFrameResourceIndex];
 
     // Make sure that this frame resource isn't still in use by the GPU.
@@ -505,13 +812,44 @@ void D3D12HelloTriangle::OnUpdate()
         CloseHandle(eventHandle);
     }
 
-    const float offsetAngle = 0.1f;
-    for (int i = 0; i < ConstBufferNum; i++)
+    // Nothing from the frame resource's last frame is in use any more.
+    m_pCurrentFrameResource->ResetScratchArenas();
+
+    // At least the timings of the frame this frame resource last rendered are ready.
+    m_gpuTimer.ReadBack(m_fence->GetCompletedValue(), m_pacingClock);
+    m_gpuTimer.BeginFrame();
+    ReadBackComputeTimes();
+
+    // ReplayFrame restores the captured buffer contents instead of updating them.
+    if (m_replayFile.IsOpen())
+    {
+        return;
+    }
+
+    UpdateHotReloadedPipelines(lastCompletedFence);
+
+    // The commands copied back by this frame resource's last frame are complete now.
+    if (m_pCurrentFrameResource->m_validateIndirectDraws)
+    {
+        ValidateIndirectDraws();
+    }
+
+    if (m_captureFramesRemaining > 0)
+    {
+        BeginCaptureFrame();
+    }
+
+    const double updateStartTime = m_pacingClock.Now();
+    UpdateObjectTransforms();    
+    BuildDrawOrder();
+    const double updateEndTime = m_pacingClock.Now();
+    m_frameTimes.phaseMilliseconds[CapturePhaseUpdate] = updateEndTime - updateStartTime;
+    m_gpuTimer.AddCpuZone("Update", updateStartTime, updateEndTime);
+
+    if (m_commandCapture.IsCapturing())
     {
-        m_pCurrentFrameResource->WriteConstantBuffers(XMMatrixRotationZ(offsetAngle), i);
+        m_pCurrentFrameResource->CaptureBufferContents(&m_commandCapture);
     }
-    
-    
 }
 
 // Render the scene.
@@ -519,35 +857,99 @@ void D3D12HelloTriangle::OnRender()
 {
     try
     {
-        BeginFrame();
-
-        for (int i = 0; i < NumContexts; i++)
+        if (m_replayFile.IsOpen())
         {
-            SetEvent(m_workerBeginRenderFrame[i]); // Tell each worker to start drawing.
+            ReplayFrame();
         }
-        EndFrame();
-
-        // You can execute command lists on any thread. Depending on the work 
-        // load, apps can choose between using ExecuteCommandLists on one thread 
-        // vs ExecuteCommandList from multiple threads.
+        else
+        {
+            const double preStartTime = m_pacingClock.Now();
+            BeginFrame();
+            const double sceneStartTime = m_pacingClock.Now();
+            m_frameTimes.phaseMilliseconds[CapturePhasePre] = sceneStartTime - preStartTime;
+            m_gpuTimer.AddCpuZone("BeginFrame", preStartTime, sceneStartTime);
+
+            for (int i = 0; i < NumContexts; i++)
+            {
+                SetEvent(m_workerBeginRenderFrame[i]); // Tell each worker to start drawing.
+            }
 
-        m_commandQueue->ExecuteCommandLists(1, m_pCurrentFrameResource->m_batchSubmit);
-        WaitForMultipleObjects(NumContexts, m_workerFinishedRenderFrame, TRUE, INFINITE);
+            // You can execute command lists on any thread. Depending on the work 
+            // load, apps can choose between using ExecuteCommandLists on one thread 
+            // vs ExecuteCommandList from multiple threads.
 
-        m_commandQueue->ExecuteCommandLists(NumContexts+1, m_pCurrentFrameResource->m_batchSubmit + 1);
-        // Submit remaining command lists.
-        //m_commandQueue->ExecuteCommandLists(_countof(m_pCurrentFrameResource->m_batchSubmit) - NumContexts - 1, m_pCurrentFrameResource->m_batchSubmit + NumContexts + 1);
+            // In GPU-driven mode CommandListPre already transitions the indirect commands
+            // written on the compute queue.
+            if (m_pCurrentFrameResource->m_drawsOnGpu)
+            {
+                m_computeQueue.InsertWait(m_commandQueue.Get(), m_pCurrentFrameResource->m_computeFenceValue);
+            }
+            m_commandQueue->ExecuteCommandLists(1, m_pCurrentFrameResource->m_batchSubmit);
+            WaitForMultipleObjects(NumContexts, m_workerFinishedRenderFrame, TRUE, INFINITE);
+            const double postStartTime = m_pacingClock.Now();
+            m_frameTimes.phaseMilliseconds[CapturePhaseScene] = postStartTime - sceneStartTime;
+            m_gpuTimer.AddCpuZone("RecordScene", sceneStartTime, postStartTime);
+
+            // CommandListPost is closed once the workers are done, so it can resolve the
+            // timestamps their lists wrote.
+            EndFrame();
+            const double postEndTime = m_pacingClock.Now();
+            m_frameTimes.phaseMilliseconds[CapturePhasePost] = postEndTime - postStartTime;
+            m_gpuTimer.AddCpuZone("EndFrame", postStartTime, postEndTime);
+
+            // The scene draws read the transforms written on the compute queue.
+            if (m_pCurrentFrameResource->m_transformsOnGpu)
+            {
+                m_computeQueue.InsertWait(m_commandQueue.Get(), m_pCurrentFrameResource->m_computeFenceValue);
+            }
+            m_commandQueue->ExecuteCommandLists(NumContexts+1, m_pCurrentFrameResource->m_batchSubmit + 1);
+            // Submit remaining command lists.
+            //m_commandQueue->ExecuteCommandLists(_countof(m_pCurrentFrameResource->m_batchSubmit) - NumContexts - 1, m_pCurrentFrameResource->m_batchSubmit + NumContexts + 1);
+        }
 
         // Present and update the frame index for the next frame.
         PIXBeginEvent(m_commandQueue.Get(), 0, L"Presenting to screen");
-        ThrowIfFailed(m_swapChain->Present(1, 0));
+        // Without vsync the present goes out immediately: torn in a window, or at the
+        // display's own pace with variable refresh.
+        const UINT syncInterval = m_vsync ? 1 : 0;
+        const UINT presentFlags = (!m_vsync && m_tearingSupported) ? DXGI_PRESENT_ALLOW_TEARING : 0;
+        ThrowIfFailed(m_swapChain->Present(syncInterval, presentFlags));
         PIXEndEvent(m_commandQueue.Get());
         m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 
+        // Matched against the frame statistics once the frame has been shown.
+        PendingPresent present = { 0, m_frameTiming };
+        if (SUCCEEDED(m_swapChain->GetLastPresentCount(&present.presentId)))
+        {
+            m_pendingPresents.push_back(present);
+            while (m_pendingPresents.size() > 2 * FrameCount)
+            {
+                m_pendingPresents.pop_front();
+            }
+        }
+
         // Signal and increment the fence value.
         m_pCurrentFrameResource->m_fenceValue = m_fenceValue;
         ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_fenceValue));
+        m_uploadRing.FinishFrame(m_fenceValue);
         m_fenceValue++;
+
+        m_frameTimes.frameMilliseconds = m_pacingClock.Now() - m_frameStartTime;
+        m_gpuTimer.AddCpuZone("Frame", m_frameStartTime, m_frameStartTime + m_frameTimes.frameMilliseconds);
+        m_gpuTimer.FinishFrame(m_pCurrentFrameResource->m_fenceValue);
+        if (m_replayFile.IsOpen())
+        {
+            m_replayTimes.frameMilliseconds += m_frameTimes.frameMilliseconds;
+            if (++m_replayFrame == m_replayFile.GetHeader().frameCount)
+            {
+                ReportReplay();
+                m_replayFrame = 0;
+            }
+        }
+        else if (m_commandCapture.IsCapturing())
+        {
+            EndCaptureFrame();
+        }
     }
     catch (HrException& e)
     {
@@ -568,8 +970,125 @@ void D3D12HelloTriangle::OnDestroy()
     // Ensure that the GPU is no longer referencing resources that are about to be
     // cleaned up by the destructor.
     WaitForGpu();
+    m_computeQueue.WaitForIdle();
+
+    m_shaderHotReload.Stop();
+    m_groupSimulation.Stop();
+    // Finishes pending PSO compiles and saves the pipeline library.
+    m_pipelineStateCache.Release();
 
     CloseHandle(m_fenceEvent);
+    DeleteSynchronizationBarrier(&m_occlusionBarrier);
+    if (m_frameLatencyWaitableObject)
+    {
+        CloseHandle(m_frameLatencyWaitableObject);
+        m_frameLatencyWaitableObject = nullptr;
+    }
+}
+
+void D3D12HelloTriangle::OnKeyDown(UINT8 key)
+{
+    switch (key)
+    {
+    case 'W':
+        m_wireframe = !m_wireframe;
+        break;
+
+    case 'C':
+        m_transformMode = static_cast<TransformMode>((m_transformMode + 1) % TransformModeCount);
+        break;
+
+    case 'G':
+        m_gpuDriven = !m_gpuDriven;
+        break;
+
+    case 'V':
+        m_validateIndirectDraws = true;
+        break;
+
+    case 'H':
+        m_groupsOrbiting = !m_groupsOrbiting;
+        m_groupOrbitStartTime = GetAnimationTime(m_frameTiming.targetTime);
+        OutputDebugStringA(m_groupsOrbiting ? "Object groups: orbiting\n" : "Object groups: not orbiting\n");
+        break;
+
+    case 'M':
+        m_groupsDrifting = !m_groupsDrifting;
+        if (m_groupsDrifting)
+        {
+            m_groupDriftStartTime = GetAnimationTime(m_frameTiming.targetTime);
+            m_groupSimulation.Reset(m_groupCentroids.data(), m_groupVelocities.data(), static_cast<UINT>(m_groupCentroids.size()), 1.0f,
+                GroupSimulationStepRate, GroupSimulationMaxCatchUpSteps);
+            m_groupSimulation.Start([this]() { return GetAnimationTime(m_pacingClock.Now()) - m_groupDriftStartTime; }, GroupSimulationLead);
+        }
+        else
+        {
+            m_groupSimulation.Stop();
+        }
+        OutputDebugStringA(m_groupsDrifting ? "Object groups: drifting\n" : "Object groups: not drifting\n");
+        break;
+
+    case 'O':
+        m_occlusionCulling = !m_occlusionCulling;
+        OutputDebugStringA(m_occlusionCulling ? "Occlusion culling: on\n" : "Occlusion culling: off\n");
+        break;
+
+    case 'X':
+        m_meshletCulling = !m_meshletCulling;
+        OutputDebugStringA(m_meshletCulling ? "Meshlet culling: on\n" : "Meshlet culling: off\n");
+        break;
+
+    case 'J':
+        m_lodSelection = !m_lodSelection;
+        OutputDebugStringA(m_lodSelection ? "LOD selection: on\n" : "LOD selection: off\n");
+        break;
+
+    case 'D':
+    {
+        m_depthMode = static_cast<DepthMode>((m_depthMode + 1) % DepthModeCount);
+        char message[64];
+        sprintf_s(message, "Depth: %s\n", GetDepthModeName(m_depthMode));
+        OutputDebugStringA(message);
+        break;
+    }
+
+    case 'B':
+    {
+        m_drawBindingStrategy = static_cast<DrawBindingStrategy>((m_drawBindingStrategy + 1) % DrawBindingStrategyCount);
+        char message[64];
+        sprintf_s(message, "Draw binding: %s\n", GetDrawBindingStrategyName(m_drawBindingStrategy));
+        OutputDebugStringA(message);
+        break;
+    }
+
+    // Frame pacing: each change first reports how the previous settings did.
+    case 'L':
+        ReportFramePacing();
+        m_maxFrameLatency = (m_maxFrameLatency % FrameCount) + 1;
+        ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(m_maxFrameLatency));
+        break;
+
+    case 'T':
+        ReportFramePacing();
+        m_vsync = !m_vsync;
+        break;
+
+    case 'P':
+        ReportFramePacing();
+        m_framePacingEnabled = !m_framePacingEnabled;
+        break;
+
+    case 'Z':
+        ReportFrameTimings();
+        break;
+
+    case 'K':
+        if (!m_replayFile.IsOpen() && !m_commandCapture.IsCapturing())
+        {
+            m_captureFramesRemaining = CaptureFrameCount;
+        }
+        break;
+    }
 }
 
 
@@ -578,24 +1097,98 @@ void D3D12HelloTriangle::BeginFrame()
 {
     m_pCurrentFrameResource->Init();
 
-    // Indicate that the back buffer will be used as a render target.
-    m_pCurrentFrameResource->m_commandLists[CommandListPre]->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+    // While capturing, the lists are recorded through the capture's stand-ins.
+    ID3D12GraphicsCommandList* pPreCommandList = m_commandCapture.GetCommandList(0, CapturePhasePre, m_pCurrentFrameResource->m_commandLists[CommandListPre].Get());
+    ID3D12GraphicsCommandList* pPostCommandList = m_commandCapture.GetCommandList(NumContexts + 1, CapturePhasePost, m_pCurrentFrameResource->m_commandLists[CommandListPost].Get());
+
+    // Describe the frame; the graph derives every barrier from the declared accesses.
+    RenderGraph& renderGraph = m_pCurrentFrameResource->m_renderGraph;
+    renderGraph.Reset();
+    const RenderGraphResource backBuffer = renderGraph.ImportResource("BackBuffer", m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+
+    // The frame resource's depth buffer stays in DEPTH_WRITE between frames.
+    const DepthMode depthMode = m_pCurrentFrameResource->m_depthMode;
+    RenderGraphResource depthBuffer = RenderGraph::InvalidIndex;
+    if (depthMode != DepthModeOff)
+    {
+        depthBuffer = renderGraph.ImportResource("DepthBuffer", m_pCurrentFrameResource->GetDepthBuffer(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    }
 
     // Clear the render target and depth stencil.
-    const float clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
-    m_pCurrentFrameResource->m_commandLists[CommandListPre]->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+    const UINT clearPass = renderGraph.AddPass("Clear", pPreCommandList, [this, depthMode](ID3D12GraphicsCommandList* pCommandList)
+    {
+        const float clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
+        pCommandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+        if (depthMode != DepthModeOff)
+        {
+            pCommandList->ClearDepthStencilView(m_pCurrentFrameResource->GetDepthStencilView(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+        }
+    });
+    renderGraph.WriteResource(clearPass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    if (depthMode != DepthModeOff)
+    {
+        renderGraph.WriteResource(clearPass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    }
+
+    if (depthMode == DepthModePrePass)
+    {
+        const UINT depthPrePass = renderGraph.AddPass("DepthPrePass", pPreCommandList, [this](ID3D12GraphicsCommandList* pCommandList)
+        {
+            RecordDepthPrePass(pCommandList);
+        });
+        renderGraph.WriteResource(depthPrePass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    }
+
+    // Drawn by the worker threads. Their lists execute after CommandListPre, so the
+    // pass's barriers are recorded there.
+    const UINT scenePass = renderGraph.AddPass("Scene", pPreCommandList);
+    renderGraph.WriteResource(scenePass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    if (depthMode == DepthModeTested)
+    {
+        renderGraph.WriteResource(scenePass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    }
+    else if (depthMode == DepthModePrePass)
+    {
+        renderGraph.ReadResource(scenePass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_READ);
+    }
+
+    // The cull pass on the compute queue wrote the draw commands; the buffer decayed to
+    // COMMON when that submission finished.
+    if (m_pCurrentFrameResource->m_drawsOnGpu)
+    {
+        ID3D12Resource* pIndirectCommandBuffer = m_pCurrentFrameResource->GetIndirectCommandBuffer();
+        const RenderGraphResource indirectCommands = renderGraph.ImportResource("IndirectCommands", pIndirectCommandBuffer, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        renderGraph.ReadResource(scenePass, indirectCommands, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 
-    ThrowIfFailed(m_pCurrentFrameResource->m_commandLists[CommandListPre]->Close());
+        if (m_pCurrentFrameResource->m_validateIndirectDraws)
+        {
+            const UINT validatePass = renderGraph.AddPass("ValidateIndirectDraws", pPostCommandList, [this, pIndirectCommandBuffer](ID3D12GraphicsCommandList* pCommandList)
+            {
+                pCommandList->CopyResource(m_pCurrentFrameResource->GetIndirectReadbackBuffer(), pIndirectCommandBuffer);
+            });
+            renderGraph.ReadResource(validatePass, indirectCommands, D3D12_RESOURCE_STATE_COPY_SOURCE);
+            renderGraph.SetSideEffect(validatePass);
+        }
+    }
+
+    const UINT presentPass = renderGraph.AddPass("Present", pPostCommandList);
+    renderGraph.ReadResource(presentPass, backBuffer, D3D12_RESOURCE_STATE_PRESENT);
+    renderGraph.SetSideEffect(presentPass);
+
+    renderGraph.Compile();
+    renderGraph.Execute();
+
+    ThrowIfFailed(pPreCommandList->Close());
 }
 
 // Assemble the CommandListPost command list.
 void D3D12HelloTriangle::EndFrame()
 {
-    // Indicate that the back buffer will now be used to present.
-    m_pCurrentFrameResource->m_commandLists[CommandListPost]->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
-
-    ThrowIfFailed(m_pCurrentFrameResource->m_commandLists[CommandListPost]->Close());
+    // The transition to PRESENT was recorded by the render graph's Present pass.
+    ID3D12GraphicsCommandList* pPostCommandList = m_commandCapture.GetCommandList(NumContexts + 1, CapturePhasePost, m_pCurrentFrameResource->m_commandLists[CommandListPost].Get());
+    m_gpuTimer.EndFrame(pPostCommandList);
+    ThrowIfFailed(pPostCommandList->Close());
 }
 
 
@@ -630,10 +1223,39 @@ void D3D12HelloTriangle::RestoreD3DResources()
 void D3D12HelloTriangle::ReleaseD3DResources()
 {
     m_fence.Reset();
+    m_shaderHotReload.Stop();
+    m_pipelineStateCache.Release();
+    m_gpuTimer.Release();
+    m_computeTimer.Release();
+    m_uploadRing.Release();
+
+    // Everything placed in m_heapAllocator's heaps goes before them; the frame
+    // resources free their allocations as they are deleted.
+    for (int i = 0; i < FrameCount; i++)
+    {
+        delete m_frameResources[i];
+        m_frameResources[i] = nullptr;
+    }
+    m_pCurrentFrameResource = nullptr;
+    m_vertexBuffer.Reset();
+    m_IndexBuffer.Reset();
+    m_texture.Reset();
+    m_objectPositionBuffer.Reset();
+    m_heapAllocator.Release();
     ResetComPtrArray(&m_renderTargets);
     m_commandQueue.Reset();
+    m_computeQueue.Release();
     m_swapChain.Reset();
     m_device.Reset();
+
+    // LoadPipeline gets a new one from the new swap chain.
+    if (m_frameLatencyWaitableObject)
+    {
+        CloseHandle(m_frameLatencyWaitableObject);
+        m_frameLatencyWaitableObject = nullptr;
+    }
+    m_pendingPresents.clear();
+    m_lastFrameStatistics = {};
 }
 // Worker thread body. workerIndex is an integer from 0 to NumContexts 
 // describing the worker's thread index.
@@ -642,61 +1264,1150 @@ void D3D12HelloTriangle::WorkerThread(int threadIndex)
     assert(threadIndex >= 0);
     assert(threadIndex < NumContexts);
 
+    char sceneZoneName[32];
+    sprintf_s(sceneZoneName, "SceneList%d", threadIndex);
+
     while (threadIndex >= 0 && threadIndex < NumContexts)
     {
         // Wait for main thread to tell us to draw.
         WaitForSingleObject(m_workerBeginRenderFrame[threadIndex], INFINITE);
 
-        ID3D12GraphicsCommandList* pSceneCommandList = m_pCurrentFrameResource->m_sceneCommandLists[threadIndex].Get();
+        ID3D12GraphicsCommandList* pSceneCommandList = m_commandCapture.GetCommandList(1 + threadIndex, CapturePhaseScene, m_pCurrentFrameResource->m_sceneCommandLists[threadIndex].Get());
+        const UINT sceneZone = m_gpuTimer.BeginZone(pSceneCommandList, sceneZoneName);
+
+        // A single ExecuteIndirect draws everything the cull pass kept, so only the
+        // first worker records; the others submit empty lists.
+        if (m_pCurrentFrameResource->m_drawsOnGpu)
+        {
+            if (threadIndex == 0)
+            {
+                SetCommonPipelineState(pSceneCommandList);
+                pSceneCommandList->SetPipelineState(SelectPipelineState(ScenePipelineIndirect));
+                CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
+                m_pCurrentFrameResource->Bind(pSceneCommandList, &rtvHandle);
+                pSceneCommandList->SetGraphicsRootDescriptorTable(0, m_srvHeap->GetGPUDescriptorHandleForHeapStart());
+                m_pCurrentFrameResource->ExecuteIndirectDraws(pSceneCommandList, m_commandSignature.Get());
+            }
+
+            m_gpuTimer.EndZone(pSceneCommandList, sceneZone);
+            ThrowIfFailed(pSceneCommandList->Close());
+            SetEvent(m_workerFinishedRenderFrame[threadIndex]);
+            continue;
+        }
 
         // Populate the command list.  
         SetCommonPipelineState(pSceneCommandList);
+        const DepthMode depthMode = m_pCurrentFrameResource->m_depthMode;
+        if (depthMode != DepthModeOff)
+        {
+            const DepthPipeline pipeline = (depthMode == DepthModePrePass) ? DepthPipelineOpaqueEqual : DepthPipelineOpaque;
+            pSceneCommandList->SetPipelineState(SelectPipelineState(GetDepthScenePipeline(pipeline, m_drawBindingStrategy)));
+        }
+        else if (m_drawBindingStrategy == DrawBindingRootCbv)
+        {
+            pSceneCommandList->SetPipelineState(SelectPipelineState(ScenePipelineRootCbv));
+        }
+        else if (m_drawBindingStrategy == DrawBindingRootConstants)
+        {
+            pSceneCommandList->SetPipelineState(SelectPipelineState(ScenePipelineIndirect));
+        }
+        if (m_drawBindingStrategy == DrawBindingRootConstants)
+        {
+            // VSMainIndirect reads the packed instance at the object index from the root SRV.
+            m_pCurrentFrameResource->SetObjectTransforms(pSceneCommandList);
+        }
         CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
         m_pCurrentFrameResource->Bind(pSceneCommandList, &rtvHandle);
 
-
-        D3D12_GPU_DESCRIPTOR_HANDLE cbvSrvHeapStart = m_srvHeap->GetGPUDescriptorHandleForHeapStart();
-        const UINT cbvSrvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-        for (int j = threadIndex; j < ConstBufferNum; j += NumContexts)
+        // Every object samples the same texture.
+        // ⼭ ؽó ,  ٸ ؽó õ ɤ
+        pSceneCommandList->SetGraphicsRootDescriptorTable(0, m_srvHeap->GetGPUDescriptorHandleForHeapStart());
+        const DrawBindingSource source = GetDrawBindingSource();
+        UINT first, step, end;
+        GetWorkerDraws(threadIndex, &first, &step, &end);
+        if (m_occlusionCulling)
         {
-            // Set the diffuse and normal textures for the current object.
-            // ⼭ ؽó ,  ٸ ؽó õ ɤ
-            //CD3DX12_GPU_DESCRIPTOR_HANDLE cbvSrvHandle(cbvSrvHeapStart, nullSrvCount + drawArgs.DiffuseTextureIndex, cbvSrvDescriptorSize);
-            pSceneCommandList->SetGraphicsRootDescriptorTable(0, cbvSrvHeapStart);
-            m_pCurrentFrameResource->SetConstBuffer(pSceneCommandList, j % ConstBufferNum);
-            pSceneCommandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
+            UINT* pDrawList = m_pCurrentFrameResource->m_scratchArenas[threadIndex].AllocateArray<UINT>(ConstBufferNum);
+            const UINT drawCount = CullOccludedObjects(threadIndex, first, step, end, pDrawList);
+            const UINT objectCount = (end > first) ? (end - first + step - 1) / step : 0;
+            InterlockedExchangeAdd64(&m_occlusionTestedCount, objectCount);
+            InterlockedExchangeAdd64(&m_occlusionCulledCount, objectCount - drawCount);
+            EncodeSceneDraws(pSceneCommandList, source, pDrawList, 0, 1, drawCount);
+        }
+        else
+        {
+            EncodeSceneDraws(pSceneCommandList, source, m_drawOrder.data(), first, step, end);
         }
 
+        m_gpuTimer.EndZone(pSceneCommandList, sceneZone);
         ThrowIfFailed(pSceneCommandList->Close());
         // Tell main thread that we are done.
         SetEvent(m_workerFinishedRenderFrame[threadIndex]);
     }
 }
-//  Frame  ٸ CommandList ϰ   ̰ɷ µ
-void D3D12HelloTriangle::SetCommonPipelineState(ID3D12GraphicsCommandList* pCommandList)
+
+// Settles the frame's depth mode and the order its objects are drawn in. The
+// GPU-driven path draws in its compacted order, without depth.
+void D3D12HelloTriangle::BuildDrawOrder()
 {
-    pCommandList->SetGraphicsRootSignature(m_rootSignature.Get());
+    m_pCurrentFrameResource->m_depthMode = m_pCurrentFrameResource->m_drawsOnGpu ? DepthModeOff : m_depthMode;
 
-    ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Get() };
-    pCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+    m_drawOrder.resize(ConstBufferNum);
+    for (UINT i = 0; i < ConstBufferNum; i++)
+    {
+        m_drawOrder[i] = i;
+    }
+    UINT64* pKeys = m_pCurrentFrameResource->GetMainThreadArena().AllocateArray<UINT64>(ConstBufferNum);
+    m_opaqueDrawCount = SortDrawOrder(m_pCurrentFrameResource->m_depthMode, m_objectPositions.data(), m_drawOrder.data(), ConstBufferNum, pKeys);
+}
 
-    pCommandList->RSSetViewports(1, &m_viewport);
-    pCommandList->RSSetScissorRects(1, &m_scissorRect);
-    pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    pCommandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-    pCommandList->IASetIndexBuffer(&m_IndexBufferView);
-    //pCommandList->OMSetStencilRef(0);
+// Lays down the opaque objects' depth, front to back, so the scene lists only shade
+// the fragments that end up visible.
+void D3D12HelloTriangle::RecordDepthPrePass(ID3D12GraphicsCommandList* pCommandList)
+{
+    SetCommonPipelineState(pCommandList);
+    pCommandList->SetPipelineState(SelectPipelineState(GetDepthScenePipeline(DepthPipelineDepthOnly, m_drawBindingStrategy)));
+    if (m_drawBindingStrategy == DrawBindingRootConstants)
+    {
+        m_pCurrentFrameResource->SetObjectTransforms(pCommandList);
+    }
+    m_pCurrentFrameResource->BindDepthOnly(pCommandList);
 
-    // Render targets and depth stencil are set elsewhere because the 
-    // depth stencil depends on the frame resource being used.
+    const DrawBindingSource source = GetDrawBindingSource();
+    EncodeDrawList(*pCommandList, m_drawBindingStrategy, source, m_drawOrder.data(), 0, 1, m_opaqueDrawCount);
+}
 
-    // Constant buffers are set elsewhere because they depend on the 
-    // frame resource being used.
+// The worker's share of m_drawOrder: entries first, first + step, ... before end.
+// Without depth, list t keeps drawing objects t, t + NumContexts, ... as the sample
+// always has. The depth modes split the sorted order into consecutive runs instead;
+// the lists execute one after another, so the order survives.
+void D3D12HelloTriangle::GetWorkerDraws(int threadIndex, UINT* pFirst, UINT* pStep, UINT* pEnd) const
+{
+    const UINT drawCount = static_cast<UINT>(m_drawOrder.size());
+    if (m_pCurrentFrameResource->m_depthMode == DepthModeOff)
+    {
+        *pFirst = threadIndex;
+        *pStep = NumContexts;
+        *pEnd = drawCount;
+    }
+    else
+    {
+        *pFirst = threadIndex * drawCount / NumContexts;
+        *pStep = 1;
+        *pEnd = (threadIndex + 1) * drawCount / NumContexts;
+    }
+}
 
-    // SRVs are set elsewhere because they change based on the object 
-    // being drawn.
+// Records pObjects[first], pObjects[first + step], ... before end, with the opaque
+// pipeline already set. In the depth modes the transparent objects come last; they
+// switch to the blended pipeline.
+void D3D12HelloTriangle::EncodeSceneDraws(ID3D12GraphicsCommandList* pCommandList, const DrawBindingSource& source, const UINT* pObjects, UINT first, UINT step, UINT end)
+{
+    UINT transparentBegin = end;
+    if (m_pCurrentFrameResource->m_depthMode != DepthModeOff)
+    {
+        transparentBegin = static_cast<UINT>(std::partition_point(pObjects + first, pObjects + end, [](UINT object)
+        {
+            return !IsObjectTransparent(object);
+        }) - pObjects);
+    }
+    EncodeDrawList(*pCommandList, m_drawBindingStrategy, source, pObjects, first, step, transparentBegin);
+
+    if (transparentBegin < end)
+    {
+        const float blendFactor[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+        pCommandList->SetPipelineState(SelectPipelineState(GetDepthScenePipeline(DepthPipelineTransparent, m_drawBindingStrategy)));
+        pCommandList->OMSetBlendFactor(blendFactor);
+        EncodeDrawList(*pCommandList, m_drawBindingStrategy, source, pObjects, transparentBegin, step, end);
+    }
+}
+
+// Without depth testing an object is covered by the ones drawn after it. Its occlusion
+// depth is then its place in the submission order: the scene lists execute one after
+// another, list t drawing objects t, t + NumContexts, ... In the depth modes it is the
+// object's depth.
+float D3D12HelloTriangle::GetOcclusionDepth(UINT objectIndex) const
+{
+    if (m_pCurrentFrameResource->m_depthMode != DepthModeOff)
+    {
+        return m_objectPositions[objectIndex].z;
+    }
+
+    const UINT objectsPerList = (ConstBufferNum + NumContexts - 1) / NumContexts;
+    const UINT drawOrder = (objectIndex % NumContexts) * objectsPerList + objectIndex / NumContexts;
+    return 1.0f - static_cast<float>(drawOrder + 1) / (NumContexts * objectsPerList + 1);
 }
 
+// Called by every worker each frame. Fills the worker's band of the occlusion buffer
+// with every object in view, waits for the other bands, then writes the worker's draws
+// (see GetWorkerDraws) that are in view and not covered to pDrawList, in order. Returns
+// their count. Transparent objects hide nothing.
+UINT D3D12HelloTriangle::CullOccludedObjects(int threadIndex, UINT first, UINT step, UINT end, UINT* pDrawList)
+{
+    UINT firstTileRow, endTileRow;
+    m_occlusionBuffer.GetBand(threadIndex, NumContexts, &firstTileRow, &endTileRow);
+    m_occlusionBuffer.Clear(firstTileRow, endTileRow);
+
+    const bool transparency = m_pCurrentFrameResource->m_depthMode != DepthModeOff;
+    const XMMATRIX rotation = XMMatrixRotationZ(m_objectRotation);
+    for (UINT i = 0; i < ConstBufferNum; i++)
+    {
+        const XMFLOAT4& position = m_objectPositions[i];
+        if (m_visibilityCache.IsVisible(i) && !(transparency && IsObjectTransparent(i)))
+        {
+            const XMMATRIX world = rotation * XMMatrixTranslation(position.x, position.y, position.z);
+            if (m_objectFillsSquare)
+            {
+                m_occlusionBuffer.RasterizeQuad(world, m_objectHalfSize, GetOcclusionDepth(i), firstTileRow, endTileRow);
+            }
+        }
+    }
+    m_occlusionBuffer.UpdateTiles(firstTileRow, endTileRow);
+    EnterSynchronizationBarrier(&m_occlusionBarrier, 0);
+
+    // The next frame's Clear can't overtake these queries: the main thread waits for
+    // every worker before starting it.
+    UINT drawCount = 0;
+    for (UINT i = first; i < end; i += step)
+    {
+        const UINT object = m_drawOrder[i];
+        const XMFLOAT4& position = m_objectPositions[object];
+        const XMFLOAT2 minCorner(position.x - m_objectCullRadius, position.y - m_objectCullRadius);
+        const XMFLOAT2 maxCorner(position.x + m_objectCullRadius, position.y + m_objectCullRadius);
+        if (m_visibilityCache.IsVisible(object) && m_occlusionBuffer.IsRectVisible(minCorner, maxCorner, GetOcclusionDepth(object)))
+        {
+            pDrawList[drawCount++] = object;
+        }
+    }
+    return drawCount;
+}
+// Picks a LOD ('J') for every object in view and culls its meshlets ('X') into the
+// ranges this frame's CPU-recorded draws use. Objects out of view get none; their draws
+// are skipped anyway.
+void D3D12HelloTriangle::BuildObjectDrawRanges()
+{
+    const bool selectsLods = m_lodSelection && m_meshLods.size() > 1;
+    m_objectRangesBuilt = (selectsLods || m_meshletCulling) && !m_pCurrentFrameResource->m_drawsOnGpu;
+    if (!m_objectRangesBuilt)
+    {
+        return;
+    }
+
+    // The view is clip space, an orthographic one, so only the viewport's size changes
+    // how large the objects look.
+    if (selectsLods)
+    {
+        m_lodSelector.Update(m_objectPositions.data(), XMMatrixIdentity(), m_viewport);
+    }
+
+    const XMMATRIX rotation = XMMatrixRotationZ(m_objectRotation);
+    m_objectRanges.clear();
+    m_objectRangeOffsets.resize(ConstBufferNum + 1);
+    for (UINT i = 0; i < ConstBufferNum; i++)
+    {
+        m_objectRangeOffsets[i] = static_cast<UINT>(m_objectRanges.size());
+        if (m_visibilityCache.IsVisible(i))
+        {
+            const UINT lod = selectsLods ? m_lodSelector.GetLod(i) : 0;
+            if (m_meshletCulling)
+            {
+                // The view is clip space, so the world transform takes the object all the way.
+                const XMFLOAT4& position = m_objectPositions[i];
+                const XMMATRIX world = rotation * XMMatrixTranslation(position.x, position.y, position.z);
+                const UINT meshletCount = m_meshlets.lodMeshlets[lod + 1] - m_meshlets.lodMeshlets[lod];
+                const UINT visibleCount = CullMeshlets(m_meshlets, lod, GetMeshletCullView(world), &m_objectRanges);
+                m_meshletTestedCount += meshletCount;
+                m_meshletCulledCount += meshletCount - visibleCount;
+            }
+            else
+            {
+                const DrawIndexRange range = { m_meshLods[lod].firstIndex, m_meshLods[lod].indexCount };
+                m_objectRanges.push_back(range);
+            }
+            m_lodTriangleCount += m_meshLods[lod].indexCount / 3;
+            m_fullDetailTriangleCount += m_meshLods[0].indexCount / 3;
+        }
+    }
+    m_objectRangeOffsets[ConstBufferNum] = static_cast<UINT>(m_objectRanges.size());
+}
+
+// The frame's per-object constants, and the LOD and meshlet ranges if it built them.
+DrawBindingSource D3D12HelloTriangle::GetDrawBindingSource() const
+{
+    DrawBindingSource source = m_pCurrentFrameResource->GetDrawBindingSource(m_indexCount);
+    if (m_objectRangesBuilt)
+    {
+        source.pObjectRanges = m_objectRanges.data();
+        source.pObjectRangeOffsets = m_objectRangeOffsets.data();
+    }
+    return source;
+}
+
+//  Frame  ٸ CommandList ϰ   ̰ɷ µ
+void D3D12HelloTriangle::SetCommonPipelineState(ID3D12GraphicsCommandList* pCommandList)
+{
+    pCommandList->SetGraphicsRootSignature(m_rootSignature.Get());
+
+    pCommandList->SetPipelineState(SelectPipelineState(ScenePipelineDefault));
+
+    ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Get() };
+    pCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+
+    pCommandList->RSSetViewports(1, &m_viewport);
+    pCommandList->RSSetScissorRects(1, &m_scissorRect);
+    pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    pCommandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
+    pCommandList->IASetIndexBuffer(&m_IndexBufferView);
+    pCommandList->SetGraphicsRoot32BitConstants(5, sizeof(VertexDequantization) / sizeof(UINT32), &m_vertexDequantization, 0);
+    //pCommandList->OMSetStencilRef(0);
+
+    // Render targets and depth stencil are set elsewhere because the 
+    // depth stencil depends on the frame resource being used.
+
+    // Constant buffers are set elsewhere because they depend on the 
+    // frame resource being used.
+
+    // SRVs are set elsewhere because they change based on the object 
+    // being drawn.
+}
+
+
+// Describes the scene PSO for the given shaders; variants start from this desc.
+D3D12_GRAPHICS_PIPELINE_STATE_DESC D3D12HelloTriangle::GetScenePipelineDesc(D3D12_SHADER_BYTECODE vertexShader, D3D12_SHADER_BYTECODE pixelShader)
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+    psoDesc.InputLayout = { SceneInputElementDescs, _countof(SceneInputElementDescs) };
+    psoDesc.pRootSignature = m_rootSignature.Get();
+    psoDesc.VS = vertexShader;
+    psoDesc.PS = pixelShader;
+    psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    psoDesc.DepthStencilState.DepthEnable = FALSE;
+    psoDesc.DepthStencilState.StencilEnable = FALSE;
+    psoDesc.SampleMask = UINT_MAX;
+    psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    psoDesc.NumRenderTargets = 1;
+    psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    psoDesc.SampleDesc.Count = 1;
+    return psoDesc;
+}
+
+// The scene PSO with a depth buffer; see DepthPipeline.
+D3D12_GRAPHICS_PIPELINE_STATE_DESC D3D12HelloTriangle::GetDepthPipelineDesc(D3D12_SHADER_BYTECODE vertexShader, D3D12_SHADER_BYTECODE pixelShader, DepthPipeline pipeline)
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = GetScenePipelineDesc(vertexShader, pixelShader);
+    psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+    psoDesc.DSVFormat = FrameResource::DepthBufferFormat;
+    switch (pipeline)
+    {
+    case DepthPipelineDepthOnly:
+        psoDesc.PS = {};
+        psoDesc.NumRenderTargets = 0;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+        break;
+
+    case DepthPipelineOpaqueEqual:
+        psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+        psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+        break;
+
+    case DepthPipelineTransparent:
+    {
+        psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+        psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+        D3D12_RENDER_TARGET_BLEND_DESC& blend = psoDesc.BlendState.RenderTarget[0];
+        blend.BlendEnable = TRUE;
+        blend.SrcBlend = D3D12_BLEND_BLEND_FACTOR;
+        blend.DestBlend = D3D12_BLEND_INV_BLEND_FACTOR;
+        blend.BlendOp = D3D12_BLEND_OP_ADD;
+        break;
+    }
+
+    default:
+        break;
+    }
+    return psoDesc;
+}
+
+// Describes one of the graphics PSOs from the shaders in ShaderProgramId order.
+D3D12_GRAPHICS_PIPELINE_STATE_DESC D3D12HelloTriangle::DescribeScenePipeline(ScenePipeline pipeline, const D3D12_SHADER_BYTECODE* pShaders)
+{
+    if (pipeline >= ScenePipelineWireframe)
+    {
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = DescribeScenePipeline(static_cast<ScenePipeline>(pipeline - ScenePipelineWireframe), pShaders);
+        psoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+        return psoDesc;
+    }
+
+    const D3D12_SHADER_BYTECODE& pixelShader = pShaders[ShaderProgramScenePS];
+    switch (pipeline)
+    {
+    case ScenePipelineDefault:
+        return GetScenePipelineDesc(pShaders[ShaderProgramSceneVS], pixelShader);
+
+    case ScenePipelineIndirect:
+        return GetScenePipelineDesc(pShaders[ShaderProgramSceneIndirectVS], pixelShader);
+
+    case ScenePipelineRootCbv:
+        return GetScenePipelineDesc(pShaders[ShaderProgramSceneRootCbvVS], pixelShader);
+
+    default:
+    {
+        // In DrawBindingStrategy order.
+        const ShaderProgramId strategyVertexShaders[DrawBindingStrategyCount] = { ShaderProgramSceneVS, ShaderProgramSceneRootCbvVS, ShaderProgramSceneIndirectVS };
+        const UINT depthPipeline = (pipeline - ScenePipelineDepth) / DrawBindingStrategyCount;
+        const UINT strategy = (pipeline - ScenePipelineDepth) % DrawBindingStrategyCount;
+        return GetDepthPipelineDesc(pShaders[strategyVertexShaders[strategy]], pixelShader, static_cast<DepthPipeline>(depthPipeline));
+    }
+    }
+}
+
+// The member the PSO is drawn from, or nullptr for the ones only looked up by key.
+ComPtr<ID3D12PipelineState>* D3D12HelloTriangle::GetScenePipelineState(ScenePipeline pipeline)
+{
+    if (pipeline >= ScenePipelineWireframe)
+    {
+        return nullptr;
+    }
+
+    switch (pipeline)
+    {
+    case ScenePipelineDefault:
+        return &m_pipelineState;
+
+    case ScenePipelineIndirect:
+        return &m_indirectPipelineState;
+
+    case ScenePipelineRootCbv:
+        return &m_rootCbvPipelineState;
+
+    default:
+    {
+        const UINT depthPipeline = (pipeline - ScenePipelineDepth) / DrawBindingStrategyCount;
+        const UINT strategy = (pipeline - ScenePipelineDepth) % DrawBindingStrategyCount;
+        return &m_depthPipelineStates[depthPipeline][strategy];
+    }
+    }
+}
+
+D3D12HelloTriangle::ScenePipeline D3D12HelloTriangle::GetDepthScenePipeline(DepthPipeline pipeline, DrawBindingStrategy strategy)
+{
+    return static_cast<ScenePipeline>(ScenePipelineDepth + pipeline * DrawBindingStrategyCount + strategy);
+}
+
+// The PSO to draw with for one of the solid pipelines: its wireframe variant while 'W'
+// is on, falling back to the solid one while the variant is still compiling.
+ID3D12PipelineState* D3D12HelloTriangle::SelectPipelineState(ScenePipeline pipeline)
+{
+    ID3D12PipelineState* pPipelineState = GetScenePipelineState(pipeline)->Get();
+    if (m_wireframe)
+    {
+        pPipelineState = m_pipelineStateCache.FindPipelineState(m_scenePipelineStateKeys[ScenePipelineWireframe + pipeline], pPipelineState);
+    }
+    return pPipelineState;
+}
+
+// Swaps in PSOs built from hot reloaded shaders. Called at the frame boundary, before
+// any command list of the new frame is recorded.
+void D3D12HelloTriangle::UpdateHotReloadedPipelines(UINT64 lastCompletedFence)
+{
+    m_shaderHotReload.ReleaseRetiredObjects(lastCompletedFence);
+
+    std::vector<ComPtr<ID3DBlob>> shaders;
+    std::vector<bool> changed;
+    if (m_shaderHotReload.TakeRecompiledShaders(shaders, changed))
+    {
+        D3D12_SHADER_BYTECODE shaderBytecode[ShaderProgramCount];
+        for (UINT i = 0; i < ShaderProgramCount; i++)
+        {
+            shaderBytecode[i] = CD3DX12_SHADER_BYTECODE(shaders[i].Get());
+        }
+
+        // Build the replacements on the PSO cache workers; keep drawing with the current ones.
+        // A PSO that uses none of the changed shaders has the same desc and so the same key,
+        // and the cache hands back the one it already has.
+        for (UINT pipeline = 0; pipeline < ScenePipelineCount; pipeline++)
+        {
+            m_pendingScenePipelineStateKeys[pipeline] = m_pipelineStateCache.RequestPipelineState(DescribeScenePipeline(static_cast<ScenePipeline>(pipeline), shaderBytecode));
+        }
+
+        // Compute PSOs are quick to create without an input layout or render state, and
+        // are only rebuilt while editing shaders.
+        D3D12_COMPUTE_PIPELINE_STATE_DESC computePsoDesc = {};
+        computePsoDesc.pRootSignature = m_computeRootSignature.Get();
+        const ShaderProgramId computeShaders[] = { ShaderProgramObjectTransformsCS, ShaderProgramCullAndCompactCS };
+        ComPtr<ID3D12PipelineState>* pendingComputePipelineStates[] = { &m_pendingObjectTransformPipelineState, &m_pendingCullAndCompactPipelineState };
+        for (UINT i = 0; i < _countof(computeShaders); i++)
+        {
+            if (!changed[computeShaders[i]])
+            {
+                continue;
+            }
+            computePsoDesc.CS = shaderBytecode[computeShaders[i]];
+            if (FAILED(m_device->CreateComputePipelineState(&computePsoDesc, IID_PPV_ARGS(pendingComputePipelineStates[i]->ReleaseAndGetAddressOf()))))
+            {
+                pendingComputePipelineStates[i]->Reset();
+            }
+        }
+        m_hotReloadPending = true;
+    }
+
+    if (!m_hotReloadPending)
+    {
+        return;
+    }
+    for (UINT pipeline = 0; pipeline < ScenePipelineCount; pipeline++)
+    {
+        if (!m_pipelineStateCache.IsPipelineStateReady(m_pendingScenePipelineStateKeys[pipeline]))
+        {
+            return;
+        }
+    }
+    m_hotReloadPending = false;
+
+    // Frames that are still in flight may reference the old PSOs.
+    const UINT64 lastSubmittedFence = m_fenceValue - 1;
+    for (UINT pipeline = 0; pipeline < ScenePipelineCount; pipeline++)
+    {
+        // Unaffected PSOs keep their keys; a failed creation keeps the current PSO.
+        const UINT64 key = m_pendingScenePipelineStateKeys[pipeline];
+        ID3D12PipelineState* pPipelineState = m_pipelineStateCache.FindPipelineState(key, nullptr);
+        if (pPipelineState == nullptr || key == m_scenePipelineStateKeys[pipeline])
+        {
+            continue;
+        }
+
+        ComPtr<ID3D12PipelineState>* pMember = GetScenePipelineState(static_cast<ScenePipeline>(pipeline));
+        ID3D12PipelineState* pOldPipelineState = (pMember != nullptr) ? pMember->Get() : m_pipelineStateCache.FindPipelineState(m_scenePipelineStateKeys[pipeline], nullptr);
+        m_shaderHotReload.RetireObject(pOldPipelineState, lastSubmittedFence);
+        m_pipelineStateCache.EvictPipelineState(m_scenePipelineStateKeys[pipeline]);
+        m_scenePipelineStateKeys[pipeline] = key;
+        if (pMember != nullptr)
+        {
+            *pMember = pPipelineState;
+        }
+    }
+
+    if (m_pendingObjectTransformPipelineState)
+    {
+        m_shaderHotReload.RetireObject(m_objectTransformPipelineState.Get(), lastSubmittedFence);
+        m_objectTransformPipelineState = m_pendingObjectTransformPipelineState;
+        m_pendingObjectTransformPipelineState.Reset();
+    }
+    if (m_pendingCullAndCompactPipelineState)
+    {
+        m_shaderHotReload.RetireObject(m_cullAndCompactPipelineState.Get(), lastSubmittedFence);
+        m_cullAndCompactPipelineState = m_pendingCullAndCompactPipelineState;
+        m_pendingCullAndCompactPipelineState.Reset();
+    }
+
+    for (int i = 0; i < FrameCount; i++)
+    {
+        m_frameResources[i]->SetPipelineState(m_pipelineState.Get());
+    }
+}
+
+// Evaluates the object animation and writes this frame's per-object transforms, culling
+// objects outside the viewport, on whichever processor is cheaper for the object count.
+void D3D12HelloTriangle::UpdateObjectTransforms()
+{
+    // Evaluated for when the frame is expected on screen rather than stepped on from
+    // the last frame, so the motion keeps its speed when frames take longer or are
+    // dropped, and never drifts.
+    const double animationTime = GetAnimationTime(m_frameTiming.targetTime);
+    m_objectRotation = m_objectSpin.Evaluate(animationTime);
+
+    WorkloadScheduler::ExecutionTarget target = m_transformScheduler.Choose(ConstBufferNum);
+    if (m_transformMode != TransformModeAuto)
+    {
+        target = (m_transformMode == TransformModeGpu) ? WorkloadScheduler::ExecutionTargetGpu : WorkloadScheduler::ExecutionTargetCpu;
+    }
+
+    m_pCurrentFrameResource->m_transformsOnGpu = (target == WorkloadScheduler::ExecutionTargetGpu);
+    m_pCurrentFrameResource->m_drawsOnGpu = m_gpuDriven;
+    m_pCurrentFrameResource->m_instancesPacked = m_gpuDriven || m_drawBindingStrategy == DrawBindingRootConstants;
+    // The check compares against the positions at validation time, FrameCount frames on.
+    m_pCurrentFrameResource->m_validateIndirectDraws = m_gpuDriven && m_validateIndirectDraws && !m_groupsOrbiting && !m_groupsDrifting;
+    m_validateIndirectDraws = false;
+
+    UpdateObjectGroups(animationTime);
+
+    // The objects spin in place, inside their cull radius, and the view is fixed, so
+    // only objects their groups moved are re-tested.
+    m_visibilityCache.Update(GetClipSpaceView());
+    BuildObjectDrawRanges();
+
+    if (!m_pCurrentFrameResource->m_transformsOnGpu)
+    {
+        UpdateObjectTransformsOnCpu();
+    }
+    if (m_pCurrentFrameResource->m_transformsOnGpu || m_pCurrentFrameResource->m_drawsOnGpu)
+    {
+        SubmitComputeWork();
+    }
+}
+
+// Orbits ('H') and drifts ('M') the object groups through m_objectHierarchy, and moves
+// the objects to their new world positions. Stopping both puts the groups back.
+void D3D12HelloTriangle::UpdateObjectGroups(double animationTime)
+{
+    const bool moving = m_groupsOrbiting || m_groupsDrifting;
+    if (!moving && !m_groupsMoved)
+    {
+        return;
+    }
+
+    const float orbitAngle = m_groupsOrbiting ? m_groupOrbit.Evaluate(animationTime - m_groupOrbitStartTime) : 0.0f;
+    const XMMATRIX orbit = XMMatrixRotationZ(orbitAngle);
+    if (m_groupsDrifting)
+    {
+        m_groupSimulation.Interpolate(animationTime - m_groupDriftStartTime, m_groupPositions.data());
+    }
+    else
+    {
+        m_groupPositions = m_groupCentroids;
+    }
+    const UINT groupCount = static_cast<UINT>(m_groupPositions.size());
+    for (UINT group = 0; group < groupCount; group++)
+    {
+        const XMFLOAT2& position = m_groupPositions[group];
+        m_objectHierarchy.SetLocalTransform(m_objectHierarchy.GetNode(group), orbit * XMMatrixTranslation(position.x, position.y, 0.0f));
+    }
+    m_objectHierarchy.UpdateWorldTransforms(0, 1, nullptr);
+
+    for (int i = 0; i < ConstBufferNum; i++)
+    {
+        XMFLOAT3 translation;
+        XMStoreFloat3(&translation, m_objectHierarchy.GetWorldTransform(m_objectHierarchy.GetNode(groupCount + i)).r[3]);
+        m_objectPositions[i] = XMFLOAT4(translation.x, translation.y, translation.z, 0.0f);
+        m_visibilityCache.MoveObject(i, m_objectPositions[i]);
+    }
+    m_objectPositionsUploaded = false;
+    m_groupsMoved = moving;
+}
+
+void D3D12HelloTriangle::UpdateObjectTransformsOnCpu()
+{
+    LARGE_INTEGER frequency, updateStart, updateEnd;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&updateStart);
+
+    const XMMATRIX rotation = XMMatrixRotationZ(m_objectRotation);
+    const XMMATRIX culled(g_XMZero, g_XMZero, g_XMZero, g_XMZero);
+    for (int i = 0; i < ConstBufferNum; i++)
+    {
+        const XMFLOAT4& position = m_objectPositions[i];
+        const bool visible = m_visibilityCache.IsVisible(i);
+        const XMMATRIX world = visible ? rotation * XMMatrixTranslation(position.x, position.y, position.z) : culled;
+        if (m_pCurrentFrameResource->m_instancesPacked)
+        {
+            m_pCurrentFrameResource->WriteInstanceData(world, i);
+        }
+        else
+        {
+            m_pCurrentFrameResource->WriteConstantBuffers(world, i);
+        }
+    }
+
+    QueryPerformanceCounter(&updateEnd);
+    m_transformScheduler.RecordCpuTime(ConstBufferNum, 1000000.0 * (updateEnd.QuadPart - updateStart.QuadPart) / frequency.QuadPart);
+}
+
+// Records the GPU transform update and/or the GPU cull and compact, and submits them
+// to the compute queue. Runs while the direct queue is still busy with the previous
+// frame; this frame resource's buffers are idle because OnUpdate already waited for it.
+void D3D12HelloTriangle::SubmitComputeWork()
+{
+    ID3D12CommandAllocator* pCommandAllocator = m_pCurrentFrameResource->m_computeCommandAllocator.Get();
+    ID3D12GraphicsCommandList* pCommandList = m_pCurrentFrameResource->m_computeCommandList.Get();
+    ThrowIfFailed(pCommandAllocator->Reset());
+    ThrowIfFailed(pCommandList->Reset(pCommandAllocator, m_objectTransformPipelineState.Get()));
+    m_computeTimer.BeginFrame();
+
+    ObjectTransformConstants constants = {};
+    XMScalarSinCos(&constants.rotationSin, &constants.rotationCos, m_objectRotation);
+    constants.objectCount = ConstBufferNum;
+    constants.cullRadius = m_objectCullRadius;
+    constants.indexCount = m_indexCount;
+    constants.writeInstances = m_pCurrentFrameResource->m_instancesPacked ? 1 : 0;
+
+    // Every compute pass on this queue reads the one buffer, in order, so it only has to
+    // catch up with the positions once.
+    if (!m_objectPositionsUploaded)
+    {
+        const UINT positionBufferSize = static_cast<UINT>(m_objectPositions.size() * sizeof(XMFLOAT4));
+        pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_objectPositionBuffer.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+        m_uploadRing.CopyBuffer(pCommandList, m_objectPositionBuffer.Get(), 0, m_objectPositions.data(), positionBufferSize);
+        pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_objectPositionBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+        m_objectPositionsUploaded = true;
+    }
+
+    pCommandList->SetComputeRootSignature(m_computeRootSignature.Get());
+    pCommandList->SetComputeRoot32BitConstants(0, sizeof(constants) / sizeof(UINT32), &constants, 0);
+    pCommandList->SetComputeRootShaderResourceView(1, m_objectPositionBuffer->GetGPUVirtualAddress());
+    pCommandList->SetComputeRootUnorderedAccessView(2, m_pCurrentFrameResource->GetSceneTransformBuffer()->GetGPUVirtualAddress());
+    pCommandList->SetComputeRootUnorderedAccessView(5, m_pCurrentFrameResource->GetInstanceBuffer()->GetGPUVirtualAddress());
+    if (m_pCurrentFrameResource->m_transformsOnGpu)
+    {
+        GpuZone zone(&m_computeTimer, pCommandList, TransformZoneName);
+        pCommandList->Dispatch((ConstBufferNum + 63) / 64, 1, 1);
+    }
+
+    if (m_pCurrentFrameResource->m_drawsOnGpu)
+    {
+        // The buffer decayed to COMMON at the end of its last use, so the copy promotes
+        // it to COPY_DEST implicitly.
+        ID3D12Resource* pIndirectCommandBuffer = m_pCurrentFrameResource->GetIndirectCommandBuffer();
+        const UINT zero = 0;
+        m_uploadRing.CopyBuffer(pCommandList, pIndirectCommandBuffer, FrameResource::IndirectCommandCountOffset, &zero, sizeof(zero));
+        pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pIndirectCommandBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+        const D3D12_GPU_VIRTUAL_ADDRESS indirectCommandAddress = pIndirectCommandBuffer->GetGPUVirtualAddress();
+        pCommandList->SetComputeRootUnorderedAccessView(3, indirectCommandAddress);
+        pCommandList->SetComputeRootUnorderedAccessView(4, indirectCommandAddress + FrameResource::IndirectCommandCountOffset);
+        pCommandList->SetPipelineState(m_cullAndCompactPipelineState.Get());
+        GpuZone zone(&m_computeTimer, pCommandList, "CullAndCompact");
+        pCommandList->Dispatch((ConstBufferNum + 63) / 64, 1, 1);
+    }
+    m_computeTimer.EndFrame(pCommandList);
+    ThrowIfFailed(pCommandList->Close());
+
+    ID3D12CommandList* ppCommandLists[] = { pCommandList };
+    m_pCurrentFrameResource->m_computeFenceValue = m_computeQueue.ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    m_computeTimer.FinishFrame(m_pCurrentFrameResource->m_computeFenceValue);
+}
+
+// Feeds the measured GPU transform update time into m_transformScheduler, so that the
+// choice between the CPU and the compute queue follows this GPU rather than the
+// defaults. Only the most recent finished submission counts; the average smooths it.
+void D3D12HelloTriangle::ReadBackComputeTimes()
+{
+    const UINT readBackFrameCount = m_computeTimer.GetReadBackFrameCount();
+    m_computeTimer.ReadBack(m_computeQueue.GetCompletedValue(), m_pacingClock);
+    if (m_computeTimer.GetReadBackFrameCount() == readBackFrameCount)
+    {
+        return;
+    }
+
+    for (const TimingZone& zone : m_computeTimer.GetLastFrameZones())
+    {
+        if (strcmp(zone.name, TransformZoneName) == 0)
+        {
+            m_transformScheduler.RecordGpuTime(ConstBufferNum, 1000.0 * (zone.end - zone.start));
+        }
+    }
+}
+
+// Checks the commands the cull pass wrote in this frame resource's last frame against
+// CullAndCompactObjects. It is only requested while the object groups hold still, so
+// unless they started moving since, the match is exact.
+void D3D12HelloTriangle::ValidateIndirectDraws()
+{
+    ID3D12Resource* pReadbackBuffer = m_pCurrentFrameResource->GetIndirectReadbackBuffer();
+    const CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(FrameResource::IndirectCommandCountOffset + sizeof(UINT)));
+    UINT8* pData;
+    ThrowIfFailed(pReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+    const IndirectCommand* pCommands = reinterpret_cast<const IndirectCommand*>(pData);
+    const UINT commandCount = *reinterpret_cast<const UINT*>(pData + FrameResource::IndirectCommandCountOffset);
+
+    std::vector<IndirectCommand, ArenaAllocator<IndirectCommand>> referenceCommands(ConstBufferNum, IndirectCommand(), ArenaAllocator<IndirectCommand>(&m_pCurrentFrameResource->GetMainThreadArena()));
+    const UINT referenceCount = CullAndCompactObjects(m_objectPositions.data(), ConstBufferNum, m_objectCullRadius, m_indexCount, referenceCommands.data());
+    const bool match = commandCount <= ConstBufferNum && MatchesReferenceCommands(pCommands, commandCount, referenceCommands.data(), referenceCount);
+
+    const CD3DX12_RANGE writeRange(0, 0);
+    pReadbackBuffer->Unmap(0, &writeRange);
+
+    char message[128];
+    sprintf_s(message, "Indirect draws %s the CPU reference (%u commands, %u expected)\n",
+        match ? "match" : "DO NOT match", commandCount, referenceCount);
+    OutputDebugStringA(message);
+}
+
+// Returns the bytecode of one of the ShaderPrograms entries through the shader cache.
+D3D12_SHADER_BYTECODE D3D12HelloTriangle::LoadShader(ShaderProgramId program)
+{
+    const ShaderProgram& desc = ShaderPrograms[program];
+    return m_shaderCache.GetShader(GetAssetFullPath(desc.filename), nullptr, desc.entryPoint, desc.target, GetShaderCompileFlags());
+}
+
+// Compiles every shader into the cache file without creating a device or window.
+void D3D12HelloTriangle::OnPrecompileShaders()
+{
+    m_shaderCache.Open(GetAssetFullPath(ShaderCacheFilename));
+    for (UINT i = 0; i < ShaderProgramCount; i++)
+    {
+        LoadShader(static_cast<ShaderProgramId>(i));
+    }
+    m_shaderCache.Close();
+}
+
+// Blocks until the swap chain can take another frame, and then until the time the
+// pacer picked for it.
+void D3D12HelloTriangle::WaitForFrameStart()
+{
+    // Signaled once fewer than m_maxFrameLatency presents are queued.
+    WaitForSingleObjectEx(m_frameLatencyWaitableObject, 1000, TRUE);
+
+    UpdateFramePacing();
+    m_frameTiming = m_framePacer.ScheduleFrame(m_pacingClock.Now());
+    m_pacingClock.SleepUntil(m_frameTiming.startTime);
+}
+
+// Feeds the display times in the swap chain's frame statistics back to the pacer.
+void D3D12HelloTriangle::UpdateFramePacing()
+{
+    // Without vsync there is no vblank to aim at.
+    m_framePacer.SetPacingEnabled(m_framePacingEnabled && m_vsync);
+
+    // Fails while the window is not presented through independent flip, or before the
+    // first vblank; the pacer keeps the timing it has.
+    DXGI_FRAME_STATISTICS statistics;
+    if (FAILED(m_swapChain->GetFrameStatistics(&statistics)) || statistics.SyncRefreshCount == m_lastFrameStatistics.SyncRefreshCount)
+    {
+        return;
+    }
+
+    const double vblankTime = m_pacingClock.FromQpc(statistics.SyncQPCTime.QuadPart);
+    if (m_lastFrameStatistics.SyncRefreshCount != 0 && statistics.SyncRefreshCount > m_lastFrameStatistics.SyncRefreshCount)
+    {
+        const double lastVblankTime = m_pacingClock.FromQpc(m_lastFrameStatistics.SyncQPCTime.QuadPart);
+        const double refreshPeriod = (vblankTime - lastVblankTime) / (statistics.SyncRefreshCount - m_lastFrameStatistics.SyncRefreshCount);
+        m_framePacer.SetDisplayTiming(refreshPeriod, vblankTime);
+    }
+
+    // PresentCount is the last present shown, at SyncQPCTime. Earlier ones were shown
+    // between the two samples, at times not reported.
+    while (!m_pendingPresents.empty() && m_pendingPresents.front().presentId <= statistics.PresentCount)
+    {
+        if (m_pendingPresents.front().presentId == statistics.PresentCount)
+        {
+            m_framePacer.RecordDisplay(m_pendingPresents.front().timing, vblankTime);
+        }
+        m_pendingPresents.pop_front();
+    }
+    m_lastFrameStatistics = statistics;
+}
+
+void D3D12HelloTriangle::ReportFramePacing()
+{
+    char message[192];
+    sprintf_s(message, "Frame pacing (%s, latency %u, %s): %.2f ms average %.2f ms max latency, %u of %u frames missed, work estimate %.2f ms\n",
+        m_vsync ? "vsync" : (m_tearingSupported ? "tearing" : "no vsync"), m_maxFrameLatency, m_framePacer.IsPacingEnabled() ? "paced" : "unpaced",
+        m_framePacer.GetAverageLatency(), m_framePacer.GetMaxLatency(), m_framePacer.GetMissedFrameCount(), m_framePacer.GetDisplayedFrameCount(),
+        m_framePacer.GetWorkEstimate());
+    OutputDebugStringA(message);
+    m_framePacer.ResetStatistics();
+}
+
+// Averages of every CPU and GPU zone since the last report, in the order of the most
+// recent frame's timeline, the scratch memory the frames use and how many draws
+// occlusion culling skipped.
+void D3D12HelloTriangle::ReportFrameTimings()
+{
+    const UINT frameCount = m_gpuTimer.GetReadBackFrameCount();
+    const std::vector<TimingZone>& zones = m_gpuTimer.GetLastFrameZones();
+    if (frameCount == 0 || zones.empty())
+    {
+        return;
+    }
+
+    char message[160];
+    sprintf_s(message, "Frame timings over %u frames (%llu dropped before read back), start relative to the frame:\n",
+        frameCount, m_gpuTimer.GetDroppedFrameCount());
+    OutputDebugStringA(message);
+    const double frameStart = zones.front().start;
+    for (const TimingZone& zone : zones)
+    {
+        const GpuTimer::ZoneStatistics& statistics = m_gpuTimer.GetStatistics().at(zone.name);
+        sprintf_s(message, "  %s %-16s %8.3f ms average %8.3f ms max, last at +%.3f ms\n", zone.gpu ? "GPU" : "CPU", zone.name,
+            statistics.total / statistics.count, statistics.max, zone.start - frameStart);
+        OutputDebugStringA(message);
+    }
+    m_gpuTimer.ResetStatistics();
+
+    FrameArenaStatistics arenaStatistics = {};
+    for (FrameResource* pFrameResource : m_frameResources)
+    {
+        for (const LinearArena& arena : pFrameResource->m_scratchArenas)
+        {
+            AccumulateArenaStatistics(arena, &arenaStatistics);
+        }
+    }
+    sprintf_s(message, "Scratch arenas: %.1f KB per frame, %.1f KB most in one arena, %.1f KB reserved, %llu overflow blocks\n",
+        arenaStatistics.usedSize / (1024.0 * FrameCount), arenaStatistics.highWaterMark / 1024.0, arenaStatistics.capacity / 1024.0, arenaStatistics.overflowCount);
+    OutputDebugStringA(message);
+
+    // Workers only update these while recording, and none are at this point.
+    if (m_occlusionTestedCount > 0)
+    {
+        sprintf_s(message, "Occlusion culling: %lld of %lld draws skipped (%.1f%%), off screen or covered\n",
+            m_occlusionCulledCount, m_occlusionTestedCount, 100.0 * m_occlusionCulledCount / m_occlusionTestedCount);
+        OutputDebugStringA(message);
+        m_occlusionTestedCount = 0;
+        m_occlusionCulledCount = 0;
+    }
+    if (m_meshletTestedCount > 0)
+    {
+        sprintf_s(message, "Meshlet culling: %llu of %llu meshlets skipped (%.1f%%), off screen or facing away\n",
+            m_meshletCulledCount, m_meshletTestedCount, 100.0 * m_meshletCulledCount / m_meshletTestedCount);
+        OutputDebugStringA(message);
+        m_meshletTestedCount = 0;
+        m_meshletCulledCount = 0;
+    }
+    if (m_fullDetailTriangleCount > 0)
+    {
+        sprintf_s(message, "LOD selection: %llu of %llu full-detail triangles kept (%.1f%%)\n",
+            m_lodTriangleCount, m_fullDetailTriangleCount, 100.0 * m_lodTriangleCount / m_fullDetailTriangleCount);
+        OutputDebugStringA(message);
+        m_lodTriangleCount = 0;
+        m_fullDetailTriangleCount = 0;
+    }
+
+    ReportOverdraw();
+}
+
+// What each depth mode would shade for the objects as they are now, counted on the CPU.
+void D3D12HelloTriangle::ReportOverdraw()
+{
+    std::vector<UINT> draws(ConstBufferNum);
+    std::vector<UINT64> keys(ConstBufferNum);
+    char message[192];
+    for (UINT mode = 0; mode < DepthModeCount; mode++)
+    {
+        // In submission order: without depth, every scene list's objects in turn.
+        UINT drawCount = 0;
+        for (UINT t = 0; t < NumContexts; t++)
+        {
+            for (UINT i = t; i < ConstBufferNum; i += NumContexts)
+            {
+                draws[drawCount++] = i;
+            }
+        }
+        const DepthMode depthMode = static_cast<DepthMode>(mode);
+        const UINT opaqueCount = SortDrawOrder(depthMode, m_objectPositions.data(), draws.data(), drawCount, keys.data());
+        const OverdrawStatistics statistics = m_overdrawEstimator.Estimate(depthMode, m_objectPositions.data(), draws.data(), drawCount, opaqueCount, m_objectRotation, m_objectHalfSize);
+        sprintf_s(message, "Overdraw with depth %-8s %.2f shaded per covered pixel, %u at most, %llu of %llu fragments shaded, %llu depth only\n",
+            GetDepthModeName(depthMode), GetAverageOverdraw(statistics), statistics.maxOverdraw, statistics.shadedCount, statistics.rasterizedCount, statistics.depthOnlyCount);
+        OutputDebugStringA(message);
+    }
+}
+
+// Everything the frame's commands reference, by the names a replay binds them to.
+void D3D12HelloTriangle::GetCaptureObjects(std::vector<CaptureObjectBinding>* pObjects)
+{
+    const CaptureObjectBinding objects[] =
+    {
+        { "RootSignature", CaptureObjectRootSignature, m_rootSignature.Get(), nullptr },
+        { "PipelineState", CaptureObjectPipelineState, m_pipelineState.Get(), nullptr },
+        { "IndirectPipelineState", CaptureObjectPipelineState, m_indirectPipelineState.Get(), nullptr },
+        { "RootCbvPipelineState", CaptureObjectPipelineState, m_rootCbvPipelineState.Get(), nullptr },
+        { "CommandSignature", CaptureObjectCommandSignature, m_commandSignature.Get(), nullptr },
+        { "RtvHeap", CaptureObjectDescriptorHeap, m_rtvHeap.Get(), nullptr },
+        { "SrvHeap", CaptureObjectDescriptorHeap, m_srvHeap.Get(), nullptr },
+        { "VertexBuffer", CaptureObjectResource, m_vertexBuffer.Get(), nullptr },
+        { "IndexBuffer", CaptureObjectResource, m_IndexBuffer.Get(), nullptr },
+    };
+    pObjects->assign(std::begin(objects), std::end(objects));
+
+    // Whichever wireframe variants have compiled.
+    for (UINT pipeline = 0; pipeline < ScenePipelineSolidCount; pipeline++)
+    {
+        const CaptureObjectBinding wireframePipelineState = { "WireframePipelineState" + std::to_string(pipeline), CaptureObjectPipelineState,
+            m_pipelineStateCache.FindPipelineState(m_scenePipelineStateKeys[ScenePipelineWireframe + pipeline], nullptr), nullptr };
+        pObjects->push_back(wireframePipelineState);
+    }
+
+    for (UINT pipeline = 0; pipeline < DepthPipelineCount; pipeline++)
+    {
+        for (UINT strategy = 0; strategy < DrawBindingStrategyCount; strategy++)
+        {
+            const CaptureObjectBinding depthPipelineState = { "DepthPipelineState" + std::to_string(pipeline) + "_" + std::to_string(strategy), CaptureObjectPipelineState, m_depthPipelineStates[pipeline][strategy].Get(), nullptr };
+            pObjects->push_back(depthPipelineState);
+        }
+    }
+
+    for (UINT i = 0; i < FrameCount; i++)
+    {
+        const CaptureObjectBinding backBuffer = { "BackBuffer" + std::to_string(i), CaptureObjectResource, m_renderTargets[i].Get(), nullptr };
+        pObjects->push_back(backBuffer);
+        m_frameResources[i]->GetCaptureObjects(i, pObjects);
+    }
+}
+
+// The first frame after 'K' names the objects; every captured frame records through
+// the capture's command lists from here until EndCaptureFrame.
+void D3D12HelloTriangle::BeginCaptureFrame()
+{
+    if (!m_commandCapture.IsCapturing())
+    {
+        std::vector<CaptureObjectBinding> objects;
+        GetCaptureObjects(&objects);
+        m_commandCapture.Begin(m_device.Get(), NumContexts + CommandListCount, objects);
+    }
+    m_commandCapture.BeginFrame(m_currentFrameResourceIndex, m_frameIndex);
+}
+
+void D3D12HelloTriangle::EndCaptureFrame()
+{
+    m_commandCapture.EndFrame(m_frameTimes);
+    if (--m_captureFramesRemaining > 0)
+    {
+        return;
+    }
+
+    m_commandCapture.End();
+    const std::wstring path = GetAssetFullPath(CaptureFilename);
+    const bool saved = m_commandCapture.Save(path);
+
+    char message[MAX_PATH + 256];
+    sprintf_s(message, "%s %u frames, %llu commands (%llu not captured, %llu unknown addresses or descriptors), %.1f KB to %S\n",
+        saved ? "Captured" : "Couldn't save", m_commandCapture.GetFrameCount(), m_commandCapture.GetCommandCount(), m_commandCapture.GetUnsupportedCommandCount(),
+        m_commandCapture.GetUnresolvedReferenceCount(), m_commandCapture.GetSize() / 1024.0, path.c_str());
+    OutputDebugStringA(message);
+}
+
+// Opens the capture passed with -replay and binds its objects to this run's by name.
+// Without a capture this build can replay, the sample renders as usual.
+void D3D12HelloTriangle::StartReplay()
+{
+    std::string error;
+    if (m_replayFile.Open(m_replayCapturePath, &error))
+    {
+        const CaptureFileHeader& header = m_replayFile.GetHeader();
+        if (header.frameCount == 0)
+        {
+            error = "It has no frames";
+        }
+        else if (header.listCount != NumContexts + CommandListCount)
+        {
+            error = "It was captured with a different number of command lists";
+        }
+        for (UINT i = 0; i < header.frameCount && error.empty(); i++)
+        {
+            const CaptureFrameRecord& frame = m_replayFile.GetFrames()[i];
+            if (frame.frameResourceIndex >= FrameCount || frame.backBufferIndex >= FrameCount)
+            {
+                error = "It was captured with a different frame count";
+            }
+        }
+    }
+
+    char message[MAX_PATH + 256];
+    if (!error.empty())
+    {
+        m_replayFile.Close();
+        sprintf_s(message, "Can't replay %S: %s\n", m_replayCapturePath.c_str(), error.c_str());
+        OutputDebugStringA(message);
+        return;
+    }
+
+    std::vector<CaptureObjectBinding> objects;
+    GetCaptureObjects(&objects);
+    m_replayResolver.Reset(m_device.Get(), m_replayFile);
+    for (const CaptureObjectBinding& object : objects)
+    {
+        if (object.pObject)
+        {
+            m_replayResolver.Bind(object);
+        }
+    }
+    m_replayBuffers.Reset();
+    m_replayFrame = 0;
+    m_replayStatistics = {};
+    m_replayTimes = {};
+
+    // Such as a pipeline state that was recompiled during the capture.
+    sprintf_s(message, "Replaying %u frames of %S; %u captured objects have no match and the commands using them are skipped\n",
+        m_replayFile.GetHeader().frameCount, m_replayCapturePath.c_str(), m_replayResolver.GetUnboundObjectCount());
+    OutputDebugStringA(message);
+}
+
+// Records the next captured frame into the current frame resource's command lists and
+// submits them, instead of BeginFrame, the worker threads and EndFrame. The compute
+// queue is not replayed.
+void D3D12HelloTriangle::ReplayFrame()
+{
+    const CaptureFrameRecord& frame = m_replayFile.GetFrames()[m_replayFrame];
+    if (m_replayFrame == 0)
+    {
+        m_replayBuffers.Reset();
+    }
+
+    double phaseStartTime = m_pacingClock.Now();
+    m_replayBuffers.Decode(m_replayFile, m_replayFrame, m_replayResolver);
+    double phaseEndTime = m_pacingClock.Now();
+    m_replayTimes.phaseMilliseconds[CapturePhaseUpdate] += phaseEndTime - phaseStartTime;
+
+    // The swap chain decides which back buffer this frame draws to; point the captured
+    // one, and its render target view, at it.
+    const CaptureObjectBinding backBuffer = { "BackBuffer" + std::to_string(frame.backBufferIndex), CaptureObjectResource, m_renderTargets[m_frameIndex].Get(), nullptr };
+    const CaptureObjectBinding rtvHeap = { "RtvHeap", CaptureObjectDescriptorHeap, m_rtvHeap.Get(), nullptr };
+    m_replayResolver.Bind(backBuffer);
+    m_replayResolver.Bind(rtvHeap, static_cast<INT>(m_frameIndex) - static_cast<INT>(frame.backBufferIndex));
+
+    m_pCurrentFrameResource->Init();
+    ID3D12GraphicsCommandList* pCommandLists[NumContexts + CommandListCount];
+    pCommandLists[0] = m_pCurrentFrameResource->m_commandLists[CommandListPre].Get();
+    for (UINT i = 0; i < NumContexts; i++)
+    {
+        pCommandLists[1 + i] = m_pCurrentFrameResource->m_sceneCommandLists[i].Get();
+    }
+    pCommandLists[NumContexts + 1] = m_pCurrentFrameResource->m_commandLists[CommandListPost].Get();
+
+    bool replayed[NumContexts + CommandListCount] = {};
+    for (UINT i = 0; i < frame.streamCount; i++)
+    {
+        const CaptureStreamRecord& stream = m_replayFile.GetStreams()[frame.firstStream + i];
+        phaseStartTime = m_pacingClock.Now();
+        if (!ReplayCommandStream(*pCommandLists[stream.listIndex], m_replayResolver, m_replayFile.GetWords() + stream.firstWord, stream.wordCount, &m_replayStatistics))
+        {
+            ThrowIfFailed(E_FAIL);
+        }
+        phaseEndTime = m_pacingClock.Now();
+        m_replayTimes.phaseMilliseconds[stream.phase] += phaseEndTime - phaseStartTime;
+        replayed[stream.listIndex] = true;
+    }
+
+    // Every list in the batch has to be closed to execute it.
+    for (UINT i = 0; i < _countof(pCommandLists); i++)
+    {
+        if (!replayed[i])
+        {
+            ThrowIfFailed(pCommandLists[i]->Close());
+        }
+    }
+    m_commandQueue->ExecuteCommandLists(_countof(m_pCurrentFrameResource->m_batchSubmit), m_pCurrentFrameResource->m_batchSubmit);
+}
+
+// After each pass over the capture: per-frame times of the replay against the capture's.
+void D3D12HelloTriangle::ReportReplay()
+{
+    const UINT frameCount = m_replayFile.GetHeader().frameCount;
+    CaptureFrameTimes captured = {};
+    for (UINT i = 0; i < frameCount; i++)
+    {
+        const CaptureFrameRecord& frame = m_replayFile.GetFrames()[i];
+        for (UINT phase = 0; phase < CapturePhaseCount; phase++)
+        {
+            captured.phaseMilliseconds[phase] += frame.phaseMilliseconds[phase];
+        }
+        captured.frameMilliseconds += frame.frameMilliseconds;
+    }
+
+    char message[128];
+    for (UINT phase = 0; phase < CapturePhaseCount; phase++)
+    {
+        sprintf_s(message, "Replay %-6s %7.3f ms/frame, captured %7.3f ms/frame\n", GetCapturePhaseName(static_cast<CapturePhase>(phase)),
+            m_replayTimes.phaseMilliseconds[phase] / frameCount, captured.phaseMilliseconds[phase] / frameCount);
+        OutputDebugStringA(message);
+    }
+    sprintf_s(message, "Replay frame  %7.3f ms/frame, captured %7.3f ms/frame; %llu commands skipped, %llu not captured\n",
+        m_replayTimes.frameMilliseconds / frameCount, captured.frameMilliseconds / frameCount, m_replayStatistics.unresolvedCount, m_replayStatistics.unsupportedCount);
+    OutputDebugStringA(message);
+
+    m_replayStatistics = {};
+    m_replayTimes = {};
+}
 
 void D3D12HelloTriangle::ReadImage(const std::string filename, std::vector<uint8_t>& image,
     int& width, int& height) {
@@ -12,6 +12,30 @@
 #pragma once
 
 #include "DXSample.h"
+#include "UploadRingBuffer.h"
+#include "ShaderCache.h"
+#include "ShaderPrograms.h"
+#include "PipelineStateCache.h"
+#include "ShaderHotReload.h"
+#include "ComputeScheduler.h"
+#include "DrawBinding.h"
+#include "FramePacing.h"
+#include "CommandCapture.h"
+#include "GpuTimer.h"
+#include "OcclusionCulling.h"
+#include "VisibilityCache.h"
+#include "DrawOrder.h"
+#include "OverdrawEstimator.h"
+#include "Animation.h"
+#include "FixedStepSimulation.h"
+#include "TransformHierarchy.h"
+#include "MeshImport.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+#include "LodSelection.h"
+#include "VertexQuantization.h"
+#include <deque>
 
 using namespace DirectX;
 
@@ -29,10 +53,6 @@ struct SceneConstantBuffer {
     XMMATRIX model;// -> 16
     float padding[48];
 };
-struct ModelConstatBuffer {
-    int index;
-    float paading[63];
-};
 
 static_assert((sizeof(SceneConstantBuffer) % 256) == 0, "BasicVertexConstantData size must be 256-byte aligned");
 
@@ -47,16 +67,12 @@ public:
     virtual void OnUpdate();
     virtual void OnRender();
     virtual void OnDestroy();
+    virtual void OnPrecompileShaders();
+    virtual void OnKeyDown(UINT8 key);
     void BeginFrame();
     void EndFrame();
 private:
 
-    struct Vertex
-    {
-        XMFLOAT3 position;
-        XMFLOAT2 uv;
-    };
-
     // Pipeline objects.
     CD3DX12_VIEWPORT m_viewport;
     CD3DX12_RECT m_scissorRect;
@@ -70,17 +86,157 @@ private:
     ComPtr<ID3D12DescriptorHeap> m_srvHeap;
     ComPtr<ID3D12DescriptorHeap> m_cbvHeap;
     ComPtr<ID3D12PipelineState> m_pipelineState;
+    PipelineStateCache m_pipelineStateCache;
+    bool m_wireframe;
+
+    // Hot reload rebuilds every PSO that uses a recompiled shader, graphics ones on the
+    // PSO cache's workers and compute ones, which the cache doesn't hold, when the shaders
+    // arrive. They are swapped in together once all of them are ready; see
+    // m_pendingScenePipelineStateKeys.
+    ShaderHotReload m_shaderHotReload;
+    ComPtr<ID3D12PipelineState> m_pendingObjectTransformPipelineState;
+    ComPtr<ID3D12PipelineState> m_pendingCullAndCompactPipelineState;
+    bool m_hotReloadPending;
     ComPtr<ID3D12GraphicsCommandList> m_commandList;
     UINT m_rtvDescriptorSize;
 
     // App resources.
     ComPtr<ID3D12Resource> m_vertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
+    VertexDequantization m_vertexDequantization;
     ComPtr<ID3D12Resource> m_IndexBuffer;
     D3D12_INDEX_BUFFER_VIEW m_IndexBufferView;
+    UINT m_indexCount;
 
     ComPtr<ID3D12Resource> m_texture;
 
+    // Backing heaps for every placed buffer and texture. Declared before the
+    // users below so that it outlives them.
+    HeapSuballocator m_heapAllocator;
+
+    // Staging memory for every upload; recycled as the frame fence advances.
+    UploadRingBuffer m_uploadRing;
+
+    // Timestamps around every render graph pass and scene list, with the CPU's frame
+    // phases on the same timeline. 'Z' reports the averages.
+    GpuTimer m_gpuTimer;
+
+    ShaderCache m_shaderCache;
+
+    // Per-object transform update and culling, on the CPU or the compute queue.
+    enum TransformMode
+    {
+        TransformModeAuto = 0,      // Let m_transformScheduler decide from the object count.
+        TransformModeCpu,
+        TransformModeGpu,
+        TransformModeCount
+    };
+    FencedCommandQueue m_computeQueue;
+    GpuTimer m_computeTimer;        // Its transform update times refine m_transformScheduler.
+    ComPtr<ID3D12RootSignature> m_computeRootSignature;
+    ComPtr<ID3D12PipelineState> m_objectTransformPipelineState;
+    ComPtr<ID3D12Resource> m_objectPositionBuffer;
+    std::vector<XMFLOAT4> m_objectPositions;
+    AnimationCurve m_objectSpin;
+    float m_objectRotation;         // m_objectSpin at the frame's animation time.
+    double m_animationStartTime;    // On m_pacingClock.
+    float m_objectCullRadius;
+    float m_objectHalfSize;         // Of the square quad, for rasterizing it as an occluder.
+    bool m_objectFillsSquare;       // Only the quad does; an imported mesh's square would hide what shows past it.
+    VisibilityCache m_visibilityCache;  // The CPU paths' frustum culling; GPU culling tests every object.
+    WorkloadScheduler m_transformScheduler;
+    TransformMode m_transformMode;
+
+    // Object groups: every ObjectGroupSize consecutive objects hang off a node at their
+    // centroid in m_objectHierarchy. 'H' orbits the groups around it; 'M' lets the
+    // centroids drift in m_groupSimulation, stepped on its own thread at a fixed rate
+    // and interpolated to each frame's time. Moved positions are uploaded to
+    // m_objectPositionBuffer before the next compute pass.
+    TransformHierarchy m_objectHierarchy;
+    std::vector<XMFLOAT2> m_groupCentroids;
+    std::vector<XMFLOAT2> m_groupVelocities;
+    std::vector<XMFLOAT2> m_groupPositions;     // This frame's.
+    AnimationCurve m_groupOrbit;
+    double m_groupOrbitStartTime;               // Animation time.
+    FixedStepSimulation m_groupSimulation;
+    double m_groupDriftStartTime;               // Animation time; the simulation's time 0.
+    bool m_groupsOrbiting;
+    bool m_groupsDrifting;
+    bool m_groupsMoved;                         // Away from their centroids, as of the last frame.
+    bool m_objectPositionsUploaded;
+
+    // GPU-driven mode: a compute pass culls and compacts the draws, and a single
+    // ExecuteIndirect replaces the worker threads' per-object draws.
+    ComPtr<ID3D12CommandSignature> m_commandSignature;
+    ComPtr<ID3D12PipelineState> m_indirectPipelineState;
+    ComPtr<ID3D12PipelineState> m_cullAndCompactPipelineState;
+    bool m_gpuDriven;
+    bool m_validateIndirectDraws;       // Read the next frame's commands back and check them on the CPU.
+
+    // Occlusion culling ('O'): before recording, each worker rasterizes every object in
+    // view into its band of m_occlusionBuffer, waits at m_occlusionBarrier for the other
+    // bands, then skips the draws of its objects that later draws cover completely,
+    // or, in the depth modes, nearer opaque ones.
+    // Only the CPU-recorded path culls; GPU-driven frames draw what the cull pass kept.
+    OcclusionBuffer m_occlusionBuffer;
+    SYNCHRONIZATION_BARRIER m_occlusionBarrier;
+    bool m_occlusionCulling;
+    volatile LONG64 m_occlusionTestedCount;     // Since the last ReportFrameTimings.
+    volatile LONG64 m_occlusionCulledCount;
+
+    // LOD selection ('J') and meshlet culling ('X'): before the workers record, the main
+    // thread picks each object in view a LOD by its size on screen and culls that LOD's
+    // meshlets, and their draws only cover the ranges left. Both on by default for an
+    // imported mesh. GPU-driven frames draw whole meshes at LOD 0.
+    std::vector<MeshLod> m_meshLods;
+    LodSelector m_lodSelector;
+    MeshletData m_meshlets;
+    std::vector<DrawIndexRange> m_objectRanges;
+    std::vector<UINT> m_objectRangeOffsets;     // Each object's first range, and one past the last object's.
+    bool m_lodSelection;
+    bool m_meshletCulling;
+    bool m_objectRangesBuilt;                   // This frame's draws use the ranges.
+    UINT64 m_meshletTestedCount;                // Since the last ReportFrameTimings.
+    UINT64 m_meshletCulledCount;
+    UINT64 m_lodTriangleCount;                  // Triangles in the LODs picked, before meshlet culling,
+    UINT64 m_fullDetailTriangleCount;           // and what LOD 0 would have had.
+
+    // How the worker threads bind each object's constants; see DrawBinding.h.
+    DrawBindingStrategy m_drawBindingStrategy;
+    ComPtr<ID3D12PipelineState> m_rootCbvPipelineState;
+
+    // Depth modes ('D'); see DrawOrder.h. Each variant exists for every draw binding
+    // strategy's vertex shader. GPU-driven frames are drawn without depth.
+    enum DepthPipeline
+    {
+        DepthPipelineOpaque = 0,        // LESS, writing depth.
+        DepthPipelineDepthOnly,         // The pre-pass: no pixel shader, no render target.
+        DepthPipelineOpaqueEqual,       // After the pre-pass: EQUAL, not writing.
+        DepthPipelineTransparent,       // LESS_EQUAL, not writing, blended by the blend factor.
+        DepthPipelineCount
+    };
+    ComPtr<ID3D12PipelineState> m_depthPipelineStates[DepthPipelineCount][DrawBindingStrategyCount];
+
+    // Every graphics PSO, by its key in m_pipelineStateCache. The solid ones are also held
+    // by the members GetScenePipelineState returns. Each has a wireframe variant ('W'),
+    // only looked up by key, so that the solid one is drawn while it compiles.
+    enum ScenePipeline
+    {
+        ScenePipelineDefault = 0,
+        ScenePipelineIndirect,
+        ScenePipelineRootCbv,
+        ScenePipelineDepth,             // DepthPipelineCount * DrawBindingStrategyCount of them.
+        ScenePipelineSolidCount = ScenePipelineDepth + DepthPipelineCount * DrawBindingStrategyCount,
+        ScenePipelineWireframe = ScenePipelineSolidCount,   // Plus the solid pipeline.
+        ScenePipelineCount = 2 * ScenePipelineSolidCount
+    };
+    UINT64 m_scenePipelineStateKeys[ScenePipelineCount];
+    UINT64 m_pendingScenePipelineStateKeys[ScenePipelineCount];   // Requested for hot reloaded shaders.
+    DepthMode m_depthMode;
+    std::vector<UINT> m_drawOrder;      // The frame's objects in drawing order, from SortDrawOrder.
+    UINT m_opaqueDrawCount;             // The first ones in m_drawOrder; the rest are transparent.
+    OverdrawEstimator m_overdrawEstimator;
+
     // Frame resources.
     FrameResource* m_frameResources[FrameCount];
     FrameResource* m_pCurrentFrameResource;
@@ -91,7 +247,41 @@ private:
     HANDLE m_fenceEvent;
     ComPtr<ID3D12Fence> m_fence;
     UINT64 m_fenceValues;
-    UINT64 m_fenceValue = 0;
+    UINT64 m_fenceValue = 1;
+
+    // Frame pacing. The swap chain's frame latency waitable object limits how many
+    // presents can be queued, and m_framePacer then delays the start of each frame so
+    // that input is sampled as late as the frame's work allows.
+    struct PendingPresent
+    {
+        UINT presentId;
+        FramePacer::FrameTiming timing;
+    };
+    HANDLE m_frameLatencyWaitableObject;
+    UINT m_maxFrameLatency;
+    bool m_tearingSupported;
+    bool m_vsync;                   // Otherwise presents go out immediately: torn, or at a variable refresh display's pace.
+    bool m_framePacingEnabled;
+    FramePacer m_framePacer;
+    PacingClock m_pacingClock;
+    FramePacer::FrameTiming m_frameTiming;
+    std::deque<PendingPresent> m_pendingPresents;   // Waiting for their display time in the frame statistics.
+    DXGI_FRAME_STATISTICS m_lastFrameStatistics;
+
+    // Command capture and replay. 'K' captures the next CaptureFrameCount frames; with
+    // -replay the sample submits a capture's frames instead of recording its own. The
+    // lists are numbered in submission order: CommandListPre, the scene lists, then
+    // CommandListPost.
+    CommandCaptureWriter m_commandCapture;
+    UINT m_captureFramesRemaining;
+    double m_frameStartTime;
+    CaptureFrameTimes m_frameTimes;
+    CaptureFile m_replayFile;
+    CaptureReplayResolver m_replayResolver;
+    CaptureBufferDecoder m_replayBuffers;
+    UINT m_replayFrame;
+    CaptureReplayStatistics m_replayStatistics;
+    CaptureFrameTimes m_replayTimes;        // Totals over the current pass.
 
     HANDLE m_workerBeginRenderFrame[NumContexts];
     HANDLE m_workerFinishedRenderFrame[NumContexts];
@@ -115,6 +305,40 @@ private:
     void ReleaseD3DResources();
     void WorkerThread(int threadIndex);
     void SetCommonPipelineState(ID3D12GraphicsCommandList* pCommandList);
+    D3D12_SHADER_BYTECODE LoadShader(ShaderProgramId program);
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC GetScenePipelineDesc(D3D12_SHADER_BYTECODE vertexShader, D3D12_SHADER_BYTECODE pixelShader);
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC GetDepthPipelineDesc(D3D12_SHADER_BYTECODE vertexShader, D3D12_SHADER_BYTECODE pixelShader, DepthPipeline pipeline);
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC DescribeScenePipeline(ScenePipeline pipeline, const D3D12_SHADER_BYTECODE* pShaders);
+    ComPtr<ID3D12PipelineState>* GetScenePipelineState(ScenePipeline pipeline);
+    static ScenePipeline GetDepthScenePipeline(DepthPipeline pipeline, DrawBindingStrategy strategy);
+    ID3D12PipelineState* SelectPipelineState(ScenePipeline pipeline);
+    void UpdateHotReloadedPipelines(UINT64 lastCompletedFence);
+    double GetAnimationTime(double clockTime) const { return (clockTime - m_animationStartTime) / 1000.0; }
+    void UpdateObjectGroups(double animationTime);
+    void UpdateObjectTransforms();
+    void UpdateObjectTransformsOnCpu();
+    void SubmitComputeWork();
+    void ReadBackComputeTimes();
+    void ValidateIndirectDraws();
+    void BuildDrawOrder();
+    void RecordDepthPrePass(ID3D12GraphicsCommandList* pCommandList);
+    void GetWorkerDraws(int threadIndex, UINT* pFirst, UINT* pStep, UINT* pEnd) const;
+    void EncodeSceneDraws(ID3D12GraphicsCommandList* pCommandList, const DrawBindingSource& source, const UINT* pObjects, UINT first, UINT step, UINT end);
+    float GetOcclusionDepth(UINT objectIndex) const;
+    UINT CullOccludedObjects(int threadIndex, UINT first, UINT step, UINT end, UINT* pDrawList);
+    void BuildObjectDrawRanges();
+    DrawBindingSource GetDrawBindingSource() const;
+    void WaitForFrameStart();
+    void UpdateFramePacing();
+    void ReportFramePacing();
+    void ReportFrameTimings();
+    void ReportOverdraw();
+    void GetCaptureObjects(std::vector<CaptureObjectBinding>* pObjects);
+    void BeginCaptureFrame();
+    void EndCaptureFrame();
+    void StartReplay();
+    void ReplayFrame();
+    void ReportReplay();
 
     // Support
     void ReadImage(const std::string filename, std::vector<uint8_t>& image,
@@ -18,7 +18,8 @@ DXSample::DXSample(UINT width, UINT height, std::wstring name) :
     m_width(width),
     m_height(height),
     m_title(name),
-    m_useWarpDevice(false)
+    m_useWarpDevice(false),
+    m_precompileShaders(false)
 {
     WCHAR assetsPath[512];
     GetAssetsPath(assetsPath, _countof(assetsPath));
@@ -124,5 +125,20 @@ void DXSample::ParseCommandLineArgs(WCHAR* argv[], int argc)
             m_useWarpDevice = true;
             m_title = m_title + L" (WARP)";
         }
+        else if (_wcsnicmp(argv[i], L"-precompileshaders", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/precompileshaders", wcslen(argv[i])) == 0)
+        {
+            m_precompileShaders = true;
+        }
+        else if ((_wcsnicmp(argv[i], L"-replay", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/replay", wcslen(argv[i])) == 0) && i + 1 < argc)
+        {
+            m_replayCapturePath = argv[++i];
+        }
+        else if ((_wcsnicmp(argv[i], L"-mesh", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/mesh", wcslen(argv[i])) == 0) && i + 1 < argc)
+        {
+            m_meshPath = argv[++i];
+        }
     }
 }
@@ -29,10 +29,14 @@ public:
     virtual void OnKeyDown(UINT8 /*key*/)   {}
     virtual void OnKeyUp(UINT8 /*key*/)     {}
 
+    // Run instead of the render loop when "-precompileshaders" is passed.
+    virtual void OnPrecompileShaders()      {}
+
     // Accessors.
     UINT GetWidth() const           { return m_width; }
     UINT GetHeight() const          { return m_height; }
     const WCHAR* GetTitle() const   { return m_title.c_str(); }
+    bool GetPrecompileShaders() const { return m_precompileShaders; }
 
     void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc);
 
@@ -54,6 +58,15 @@ protected:
     // Adapter info.
     bool m_useWarpDevice;
 
+    // Only populate the shader cache and exit.
+    bool m_precompileShaders;
+
+    // Replay this command capture instead of rendering the scene.
+    std::wstring m_replayCapturePath;
+
+    // Draw this .obj or .glb mesh instead of the quad.
+    std::wstring m_meshPath;
+
 private:
     // Root assets path.
     std::wstring m_assetsPath;
@@ -0,0 +1,200 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+// How each draw tells the vertex shader which object's constants to use.
+enum DrawBindingStrategy
+{
+    DrawBindingDescriptorTable = 0,     // A CBV descriptor per object per frame (root parameter 1).
+    DrawBindingRootCbv,                 // The object's constants by GPU virtual address (root parameter 4).
+    DrawBindingRootConstants,           // The object index (root parameter 2); packed instances through the root SRV (root parameter 3).
+    DrawBindingStrategyCount
+};
+
+const char* GetDrawBindingStrategyName(DrawBindingStrategy strategy);
+
+// Part of the index buffer, such as the meshlets of an object that survived culling.
+struct DrawIndexRange
+{
+    UINT firstIndex;
+    UINT indexCount;
+};
+
+// Where a frame's per-object constants live. Object i's descriptor and constants are
+// i steps past the first ones.
+struct DrawBindingSource
+{
+    D3D12_GPU_DESCRIPTOR_HANDLE firstCbvHandle;
+    UINT cbvDescriptorSize;
+    D3D12_GPU_VIRTUAL_ADDRESS firstConstantsAddress;
+    UINT constantsStride;
+    UINT indexCount;
+
+    // With meshlet culling, object i draws pObjectRanges[pObjectRangeOffsets[i]] up to
+    // pObjectRanges[pObjectRangeOffsets[i + 1]] instead of all indexCount indices.
+    // Null draws every object whole.
+    const DrawIndexRange* pObjectRanges;
+    const UINT* pObjectRangeOffsets;
+};
+
+// Draws one object's indices, whole or the ranges its meshlets left.
+template <class CommandList>
+void DrawObject(CommandList& commandList, const DrawBindingSource& source, UINT object)
+{
+    if (source.pObjectRangeOffsets == nullptr)
+    {
+        commandList.DrawIndexedInstanced(source.indexCount, 1, 0, 0, 0);
+        return;
+    }
+    for (UINT r = source.pObjectRangeOffsets[object]; r < source.pObjectRangeOffsets[object + 1]; r++)
+    {
+        commandList.DrawIndexedInstanced(source.pObjectRanges[r].indexCount, 1, source.pObjectRanges[r].firstIndex, 0, 0);
+    }
+}
+
+// Records the per-object bindings and draws for objects firstObject, firstObject + objectStep, ...
+// CommandList is ID3D12GraphicsCommandList, or HeadlessCommandEncoder to time the
+// recording without a device. The strategy is switched on once, outside the loops.
+template <class CommandList>
+void EncodeDraws(CommandList& commandList, DrawBindingStrategy strategy, const DrawBindingSource& source, UINT firstObject, UINT objectStep, UINT objectCount)
+{
+    switch (strategy)
+    {
+    case DrawBindingDescriptorTable:
+        for (UINT i = firstObject; i < objectCount; i += objectStep)
+        {
+            const D3D12_GPU_DESCRIPTOR_HANDLE cbvHandle = { source.firstCbvHandle.ptr + static_cast<UINT64>(i) * source.cbvDescriptorSize };
+            commandList.SetGraphicsRootDescriptorTable(1, cbvHandle);
+            DrawObject(commandList, source, i);
+        }
+        break;
+
+    case DrawBindingRootCbv:
+        for (UINT i = firstObject; i < objectCount; i += objectStep)
+        {
+            commandList.SetGraphicsRootConstantBufferView(4, source.firstConstantsAddress + static_cast<UINT64>(i) * source.constantsStride);
+            DrawObject(commandList, source, i);
+        }
+        break;
+
+    case DrawBindingRootConstants:
+        for (UINT i = firstObject; i < objectCount; i += objectStep)
+        {
+            commandList.SetGraphicsRoot32BitConstant(2, i, 0);
+            DrawObject(commandList, source, i);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Same, for the objects pObjects[first], pObjects[first + step], ... below count,
+// such as a culled and sorted draw list.
+template <class CommandList>
+void EncodeDrawList(CommandList& commandList, DrawBindingStrategy strategy, const DrawBindingSource& source, const UINT* pObjects, UINT first, UINT step, UINT count)
+{
+    switch (strategy)
+    {
+    case DrawBindingDescriptorTable:
+        for (UINT i = first; i < count; i += step)
+        {
+            const D3D12_GPU_DESCRIPTOR_HANDLE cbvHandle = { source.firstCbvHandle.ptr + static_cast<UINT64>(pObjects[i]) * source.cbvDescriptorSize };
+            commandList.SetGraphicsRootDescriptorTable(1, cbvHandle);
+            DrawObject(commandList, source, pObjects[i]);
+        }
+        break;
+
+    case DrawBindingRootCbv:
+        for (UINT i = first; i < count; i += step)
+        {
+            commandList.SetGraphicsRootConstantBufferView(4, source.firstConstantsAddress + static_cast<UINT64>(pObjects[i]) * source.constantsStride);
+            DrawObject(commandList, source, pObjects[i]);
+        }
+        break;
+
+    case DrawBindingRootConstants:
+        for (UINT i = first; i < count; i += step)
+        {
+            commandList.SetGraphicsRoot32BitConstant(2, pObjects[i], 0);
+            DrawObject(commandList, source, pObjects[i]);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Has the ID3D12GraphicsCommandList calls EncodeDraws makes. Each call appends a
+// packed record, roughly what a driver writes into its command buffer, so the
+// per-draw recording cost of each strategy can be measured headlessly.
+class HeadlessCommandEncoder
+{
+public:
+    void Reset() { m_commands.clear(); }
+
+    void SetGraphicsRootDescriptorTable(UINT rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+    {
+        WriteHeader(CommandSetRootDescriptorTable, rootParameterIndex);
+        Write(baseDescriptor.ptr);
+    }
+
+    void SetGraphicsRootConstantBufferView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation)
+    {
+        WriteHeader(CommandSetRootConstantBufferView, rootParameterIndex);
+        Write(bufferLocation);
+    }
+
+    void SetGraphicsRoot32BitConstant(UINT rootParameterIndex, UINT srcData, UINT destOffsetIn32BitValues)
+    {
+        WriteHeader(CommandSetRoot32BitConstant, rootParameterIndex, destOffsetIn32BitValues);
+        m_commands.push_back(srcData);
+    }
+
+    void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndexLocation, INT baseVertexLocation, UINT startInstanceLocation)
+    {
+        WriteHeader(CommandDrawIndexedInstanced);
+        m_commands.push_back(indexCountPerInstance);
+        m_commands.push_back(instanceCount);
+        m_commands.push_back(startIndexLocation);
+        m_commands.push_back(static_cast<UINT32>(baseVertexLocation));
+        m_commands.push_back(startInstanceLocation);
+    }
+
+    size_t GetSize() const { return m_commands.size() * sizeof(UINT32); }
+    const UINT32* GetData() const { return m_commands.data(); }
+
+private:
+    enum CommandType
+    {
+        CommandSetRootDescriptorTable = 1,
+        CommandSetRootConstantBufferView,
+        CommandSetRoot32BitConstant,
+        CommandDrawIndexedInstanced
+    };
+
+    // One word: command type, root parameter index and constant offset.
+    void WriteHeader(CommandType type, UINT rootParameterIndex = 0, UINT destOffset = 0)
+    {
+        m_commands.push_back((type << 24) | ((rootParameterIndex & 0xff) << 16) | (destOffset & 0xffff));
+    }
+
+    void Write(UINT64 value)
+    {
+        m_commands.push_back(static_cast<UINT32>(value));
+        m_commands.push_back(static_cast<UINT32>(value >> 32));
+    }
+
+    std::vector<UINT32> m_commands;
+};
+
+struct DrawBindingCost
+{
+    double nanosecondsPerDraw;
+    double bytesPerDraw;
+};
+
+// Times EncodeDraws into a HeadlessCommandEncoder, best of several runs.
+DrawBindingCost MeasureDrawBindingCost(DrawBindingStrategy strategy, UINT objectCount, UINT iterations);
@@ -0,0 +1,63 @@
+#include "stdafx.h"
+#include "DrawOrder.h"
+#include <algorithm>
+
+namespace
+{
+    // Orders IEEE floats as unsigned integers, negative ones included.
+    UINT32 GetSortableFloatBits(float value)
+    {
+        UINT32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+}
+
+const char* GetDepthModeName(DepthMode mode)
+{
+    switch (mode)
+    {
+    case DepthModeOff:
+        return "off";
+    case DepthModeTested:
+        return "tested";
+    case DepthModePrePass:
+        return "prepass";
+    default:
+        return "unknown";
+    }
+}
+
+UINT SortDrawOrder(DepthMode mode, const XMFLOAT4* pPositions, UINT* pObjects, UINT count, UINT64* pKeys)
+{
+    if (mode == DepthModeOff)
+    {
+        return count;
+    }
+
+    // Opaque keys fill the scratch from the front, transparent ones from the back; the
+    // transparent depth bits are inverted so that farther sorts first.
+    UINT opaqueCount = 0;
+    UINT transparentBegin = count;
+    for (UINT i = 0; i < count; i++)
+    {
+        const UINT object = pObjects[i];
+        const UINT32 depthBits = GetSortableFloatBits(pPositions[object].z);
+        if (IsObjectTransparent(object))
+        {
+            pKeys[--transparentBegin] = (static_cast<UINT64>(~depthBits) << 32) | object;
+        }
+        else
+        {
+            pKeys[opaqueCount++] = (static_cast<UINT64>(depthBits) << 32) | object;
+        }
+    }
+    std::sort(pKeys, pKeys + opaqueCount);
+    std::sort(pKeys + transparentBegin, pKeys + count);
+
+    for (UINT i = 0; i < count; i++)
+    {
+        pObjects[i] = static_cast<UINT>(pKeys[i]);
+    }
+    return opaqueCount;
+}
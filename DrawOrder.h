@@ -0,0 +1,35 @@
+#pragma once
+#include "stdafx.h"
+
+using namespace DirectX;
+
+// How the scene is depth tested. Without a depth buffer the objects cover each other
+// in submission order and every fragment is shaded. With one, the opaque objects are
+// drawn front to back, so the depth test rejects covered fragments before they are
+// shaded, then the transparent ones back to front, blended and tested but not
+// writing depth. The pre-pass first draws the opaque objects' depth alone, so their
+// shading pass only shades the fragments that end up visible.
+enum DepthMode
+{
+    DepthModeOff = 0,
+    DepthModeTested,
+    DepthModePrePass,
+    DepthModeCount
+};
+
+const char* GetDepthModeName(DepthMode mode);
+
+// Every TransparentObjectStride-th object is drawn blended in the depth modes.
+static const UINT TransparentObjectStride = 4;
+
+inline bool IsObjectTransparent(UINT objectIndex)
+{
+    return objectIndex % TransparentObjectStride == TransparentObjectStride - 1;
+}
+
+// Orders the objects for drawing and returns how many of them, from the start, are
+// opaque. DepthModeOff keeps the order and treats everything as opaque; the depth
+// modes put the opaque objects first, front to back, then the transparent ones back
+// to front. Depth is the position's z; ties keep the object order. pKeys is scratch
+// for count entries. Needs no device, so the benchmark sorts with it too.
+UINT SortDrawOrder(DepthMode mode, const XMFLOAT4* pPositions, UINT* pObjects, UINT count, UINT64* pKeys);
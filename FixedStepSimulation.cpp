@@ -0,0 +1,203 @@
+#include "stdafx.h"
+#include "FixedStepSimulation.h"
+#include <process.h>
+
+FixedStepSimulation::FixedStepSimulation() :
+    m_bound(1.0f),
+    m_stepTime(1.0 / 60.0),
+    m_maxCatchUpSteps(0),
+    m_previousState(0),
+    m_latestState(1),
+    m_previousTime(0.0),
+    m_latestTime(0.0),
+    m_stepCount(0),
+    m_lead(0.0),
+    m_exitEvent(nullptr),
+    m_threadHandle(nullptr)
+{
+    InitializeSRWLock(&m_stateLock);
+}
+
+FixedStepSimulation::~FixedStepSimulation()
+{
+    Stop();
+}
+
+void FixedStepSimulation::Reset(const XMFLOAT2* pPositions, const XMFLOAT2* pVelocities, UINT bodyCount, float bound, double stepRate, UINT maxCatchUpSteps)
+{
+    Stop();
+
+    for (std::vector<XMFLOAT2>& state : m_states)
+    {
+        state.assign(pPositions, pPositions + bodyCount);
+    }
+    m_velocities.assign(pVelocities, pVelocities + bodyCount);
+    m_bound = bound;
+    m_stepTime = 1.0 / stepRate;
+    m_maxCatchUpSteps = maxCatchUpSteps;
+    m_previousState = 0;
+    m_latestState = 1;
+    m_previousTime = -m_stepTime;
+    m_latestTime = 0.0;
+    m_stepCount = 0;
+}
+
+UINT FixedStepSimulation::Advance(double time)
+{
+    UINT stepCount = 0;
+    while (m_latestTime < time)
+    {
+        if (m_maxCatchUpSteps > 0 && stepCount == m_maxCatchUpSteps)
+        {
+            // Skip the rest: the states keep their positions, a step apart, at the end.
+            AcquireSRWLockExclusive(&m_stateLock);
+            const double skipped = m_stepTime * ceil((time - m_latestTime) / m_stepTime);
+            m_previousTime += skipped;
+            m_latestTime += skipped;
+            ReleaseSRWLockExclusive(&m_stateLock);
+            break;
+        }
+        Step();
+        stepCount++;
+    }
+    return stepCount;
+}
+
+// Moves every body on from the latest state into the buffer neither published state
+// uses, then publishes it.
+void FixedStepSimulation::Step()
+{
+    const UINT nextState = 3 - m_previousState - m_latestState;
+    const std::vector<XMFLOAT2>& latest = m_states[m_latestState];
+    std::vector<XMFLOAT2>& next = m_states[nextState];
+    const float stepTime = static_cast<float>(m_stepTime);
+    const UINT bodyCount = GetBodyCount();
+    for (UINT i = 0; i < bodyCount; i++)
+    {
+        XMFLOAT2& velocity = m_velocities[i];
+        float x = latest[i].x + velocity.x * stepTime;
+        float y = latest[i].y + velocity.y * stepTime;
+        if (fabsf(x) > m_bound)
+        {
+            x = copysignf(2.0f * m_bound, x) - x;
+            velocity.x = -velocity.x;
+        }
+        if (fabsf(y) > m_bound)
+        {
+            y = copysignf(2.0f * m_bound, y) - y;
+            velocity.y = -velocity.y;
+        }
+        next[i] = XMFLOAT2(x, y);
+    }
+
+    AcquireSRWLockExclusive(&m_stateLock);
+    m_previousState = m_latestState;
+    m_latestState = nextState;
+    m_previousTime = m_latestTime;
+    m_latestTime += m_stepTime;
+    m_stepCount++;
+    ReleaseSRWLockExclusive(&m_stateLock);
+}
+
+void FixedStepSimulation::Start(const std::function<double()>& clock, double lead)
+{
+    Stop();
+
+    struct threadwrapper
+    {
+        static unsigned int WINAPI thunk(LPVOID lpParameter)
+        {
+            reinterpret_cast<FixedStepSimulation*>(lpParameter)->SteppingThread();
+            return 0;
+        }
+    };
+
+    m_clock = clock;
+    m_lead = lead;
+    m_exitEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (m_exitEvent == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    m_threadHandle = reinterpret_cast<HANDLE>(_beginthreadex(
+        nullptr,
+        0,
+        threadwrapper::thunk,
+        reinterpret_cast<LPVOID>(this),
+        0,
+        nullptr));
+    assert(m_threadHandle != NULL);
+}
+
+void FixedStepSimulation::Stop()
+{
+    if (m_threadHandle != nullptr)
+    {
+        SetEvent(m_exitEvent);
+        WaitForSingleObject(m_threadHandle, INFINITE);
+        CloseHandle(m_threadHandle);
+        m_threadHandle = nullptr;
+    }
+    if (m_exitEvent != nullptr)
+    {
+        CloseHandle(m_exitEvent);
+        m_exitEvent = nullptr;
+    }
+}
+
+// Steps whenever the clock catches up with the latest state, and sleeps until then.
+void FixedStepSimulation::SteppingThread()
+{
+    for (;;)
+    {
+        Advance(m_clock() + m_lead);
+
+        const double wait = m_latestTime - (m_clock() + m_lead);
+        const DWORD milliseconds = (wait > 0.0) ? static_cast<DWORD>(1000.0 * wait) : 0;
+        if (WaitForSingleObject(m_exitEvent, milliseconds) == WAIT_OBJECT_0)
+        {
+            return;
+        }
+    }
+}
+
+void FixedStepSimulation::Interpolate(double time, XMFLOAT2* pPositions) const
+{
+    AcquireSRWLockShared(&m_stateLock);
+    const XMFLOAT2* pPrevious = m_states[m_previousState].data();
+    const XMFLOAT2* pLatest = m_states[m_latestState].data();
+    const double span = m_latestTime - m_previousTime;
+    const float t = static_cast<float>(min(max((time - m_previousTime) / span, 0.0), 1.0));
+
+    // Two bodies to a vector.
+    const UINT bodyCount = GetBodyCount();
+    const XMVECTOR weight = XMVectorReplicate(t);
+    UINT i = 0;
+    for (; i + 2 <= bodyCount; i += 2)
+    {
+        const XMVECTOR previous = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pPrevious + i));
+        const XMVECTOR latest = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pLatest + i));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pPositions + i), XMVectorLerpV(previous, latest, weight));
+    }
+    if (i < bodyCount)
+    {
+        XMStoreFloat2(pPositions + i, XMVectorLerpV(XMLoadFloat2(pPrevious + i), XMLoadFloat2(pLatest + i), weight));
+    }
+    ReleaseSRWLockShared(&m_stateLock);
+}
+
+UINT64 FixedStepSimulation::GetStepCount() const
+{
+    AcquireSRWLockShared(&m_stateLock);
+    const UINT64 stepCount = m_stepCount;
+    ReleaseSRWLockShared(&m_stateLock);
+    return stepCount;
+}
+
+void FixedStepSimulation::GetLatestState(std::vector<XMFLOAT2>* pPositions) const
+{
+    AcquireSRWLockShared(&m_stateLock);
+    *pPositions = m_states[m_latestState];
+    ReleaseSRWLockShared(&m_stateLock);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "stdafx.h"
+#include <functional>
+#include <vector>
+
+using namespace DirectX;
+
+// Bodies drifting at constant velocities inside the square [-bound, bound], bouncing
+// off its sides, advanced in steps of a fixed length however often frames are drawn.
+// A run is a function of its step count alone, so every render rate, and stepping on
+// a thread of its own, ends in the same state.
+//
+// Positions are kept for the two latest steps; a frame draws them interpolated to its
+// own time. Stepping writes a third buffer and only takes the lock to publish it, so a
+// thread of its own never waits on the renderer for longer than swapping indices.
+class FixedStepSimulation
+{
+public:
+    FixedStepSimulation();
+    ~FixedStepSimulation();
+
+    // Starts over at time 0 with stepRate steps per second. maxCatchUpSteps limits the
+    // steps one Advance runs; past that the rest are dropped, moving the simulation's
+    // clock on without them, so that a stall can't leave it further behind every
+    // frame. 0 never drops any. Stops the stepping thread.
+    void Reset(const XMFLOAT2* pPositions, const XMFLOAT2* pVelocities, UINT bodyCount, float bound, double stepRate, UINT maxCatchUpSteps);
+
+    // Runs every step due by time, in seconds, on the calling thread: until the latest
+    // state is no earlier than time. Returns how many ran. Not while the thread steps.
+    UINT Advance(double time);
+
+    // Steps on a thread of its own instead, keeping lead seconds ahead of clock.
+    void Start(const std::function<double()>& clock, double lead);
+    void Stop();
+
+    // Every body's position at time, between the two latest states; clamped to them.
+    // Safe on any thread.
+    void Interpolate(double time, XMFLOAT2* pPositions) const;
+
+    UINT GetBodyCount() const { return static_cast<UINT>(m_velocities.size()); }
+    double GetStepTime() const { return m_stepTime; }
+    UINT64 GetStepCount() const;
+    void GetLatestState(std::vector<XMFLOAT2>* pPositions) const;
+
+private:
+    void Step();
+    void SteppingThread();
+
+    std::vector<XMFLOAT2> m_states[3];
+    std::vector<XMFLOAT2> m_velocities;     // Only used by whoever steps.
+    float m_bound;
+    double m_stepTime;
+    UINT m_maxCatchUpSteps;
+
+    // Published under m_stateLock; the stepping side reads them without it.
+    mutable SRWLOCK m_stateLock;
+    UINT m_previousState;
+    UINT m_latestState;
+    double m_previousTime;
+    double m_latestTime;
+    UINT64 m_stepCount;
+
+    std::function<double()> m_clock;
+    double m_lead;
+    HANDLE m_exitEvent;
+    HANDLE m_threadHandle;
+};
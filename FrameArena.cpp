@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include "FrameArena.h"
+
+namespace
+{
+    inline SIZE_T AlignUp(SIZE_T value, SIZE_T alignment)
+    {
+        return (value + (alignment - 1)) & ~(alignment - 1);
+    }
+
+    // Blocks start on a cache line, which also covers every fundamental alignment.
+    const SIZE_T BlockAlignment = 64;
+    const SIZE_T BlockHeaderSize = 64;
+}
+
+LinearArena::LinearArena(SIZE_T blockSize) :
+    m_pFirstBlock(nullptr),
+    m_pCurrentBlock(nullptr),
+    m_pCursor(nullptr),
+    m_pEnd(nullptr),
+    m_blockSize(blockSize),
+    m_capacity(0),
+    m_usedSize(0),
+    m_lastFrameSize(0),
+    m_highWaterMark(0),
+    m_overflowCount(0)
+{
+}
+
+LinearArena::~LinearArena()
+{
+    FreeBlocks();
+}
+
+void* LinearArena::Allocate(SIZE_T size, SIZE_T alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= BlockAlignment);
+
+    UINT8* pAligned = reinterpret_cast<UINT8*>(AlignUp(reinterpret_cast<SIZE_T>(m_pCursor), alignment));
+    if (m_pCursor == nullptr || size > static_cast<SIZE_T>(m_pEnd - pAligned))
+    {
+        // The rest of the current block is given up for this frame.
+        m_usedSize += m_pEnd - m_pCursor;
+        if (m_pCurrentBlock)
+        {
+            m_overflowCount++;
+        }
+        AddBlock(max(m_blockSize, size));
+        pAligned = m_pCursor;
+    }
+
+    m_usedSize += (pAligned - m_pCursor) + size;
+    m_highWaterMark = max(m_highWaterMark, m_usedSize);
+    m_pCursor = pAligned + size;
+    return pAligned;
+}
+
+void LinearArena::Reset()
+{
+    m_lastFrameSize = m_usedSize;
+    m_usedSize = 0;
+
+    // Chained blocks mean the frame outgrew the arena; start the next with one block
+    // that holds the most any frame has needed.
+    if (m_pFirstBlock && m_pFirstBlock->pNext)
+    {
+        FreeBlocks();
+        m_blockSize = max(m_blockSize, AlignUp(m_highWaterMark, DefaultBlockSize));
+    }
+
+    m_pCurrentBlock = m_pFirstBlock;
+    m_pCursor = m_pFirstBlock ? reinterpret_cast<UINT8*>(m_pFirstBlock) + BlockHeaderSize : nullptr;
+    m_pEnd = m_pFirstBlock ? m_pCursor + m_pFirstBlock->size : nullptr;
+}
+
+void LinearArena::AddBlock(SIZE_T size)
+{
+    Block* pBlock = static_cast<Block*>(_aligned_malloc(BlockHeaderSize + size, BlockAlignment));
+    if (pBlock == nullptr)
+    {
+        ThrowIfFailed(E_OUTOFMEMORY);
+    }
+    pBlock->pNext = nullptr;
+    pBlock->size = size;
+
+    // Blocks are only ever added after the last one.
+    (m_pCurrentBlock ? m_pCurrentBlock->pNext : m_pFirstBlock) = pBlock;
+    m_pCurrentBlock = pBlock;
+    m_pCursor = reinterpret_cast<UINT8*>(pBlock) + BlockHeaderSize;
+    m_pEnd = m_pCursor + size;
+    m_capacity += size;
+}
+
+void LinearArena::FreeBlocks()
+{
+    while (m_pFirstBlock)
+    {
+        Block* pNext = m_pFirstBlock->pNext;
+        _aligned_free(m_pFirstBlock);
+        m_pFirstBlock = pNext;
+    }
+    m_pCurrentBlock = nullptr;
+    m_pCursor = nullptr;
+    m_pEnd = nullptr;
+    m_capacity = 0;
+}
+
+void AccumulateArenaStatistics(const LinearArena& arena, FrameArenaStatistics* pStatistics)
+{
+    pStatistics->usedSize += arena.GetLastFrameSize();
+    pStatistics->highWaterMark = max(pStatistics->highWaterMark, arena.GetHighWaterMark());
+    pStatistics->capacity += arena.GetCapacity();
+    pStatistics->overflowCount += arena.GetOverflowCount();
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include <cstddef>
+
+// Bump allocator for scratch memory that lives until the end of a frame. Owned by one
+// thread, so allocating takes no lock and no atomic; memory is only given back all at
+// once by Reset. A request that does not fit chains an overflow block, and the next
+// Reset replaces the chain with one block as large as the most the arena ever held,
+// so a steady workload stops overflowing after its first frame.
+class LinearArena
+{
+public:
+    static const SIZE_T DefaultBlockSize = 64 * 1024;
+
+    explicit LinearArena(SIZE_T blockSize = DefaultBlockSize);
+    ~LinearArena();
+
+    // Throws HrException(E_OUTOFMEMORY) when a block can't be allocated.
+    void* Allocate(SIZE_T size, SIZE_T alignment = alignof(std::max_align_t));
+
+    template <class T>
+    T* AllocateArray(SIZE_T count)
+    {
+        return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Frees everything allocated since the previous Reset.
+    void Reset();
+
+    SIZE_T GetUsedSize() const { return m_usedSize; }
+    SIZE_T GetLastFrameSize() const { return m_lastFrameSize; }    // Used before the last Reset.
+    SIZE_T GetCapacity() const { return m_capacity; }
+    SIZE_T GetHighWaterMark() const { return m_highWaterMark; }
+    UINT64 GetOverflowCount() const { return m_overflowCount; }     // Blocks chained since construction.
+
+private:
+    struct Block
+    {
+        Block* pNext;
+        SIZE_T size;                // Usable bytes, after the header.
+    };
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void AddBlock(SIZE_T size);
+    void FreeBlocks();
+
+    Block* m_pFirstBlock;
+    Block* m_pCurrentBlock;
+    UINT8* m_pCursor;
+    UINT8* m_pEnd;
+    SIZE_T m_blockSize;
+    SIZE_T m_capacity;
+    SIZE_T m_usedSize;              // Including alignment padding and the ends of filled blocks.
+    SIZE_T m_lastFrameSize;
+    SIZE_T m_highWaterMark;
+    UINT64 m_overflowCount;
+
+    // The arenas of different threads sit next to each other; keep the next one's
+    // cursor off this one's cache line.
+    UINT8 m_padding[64];
+};
+
+// STL allocator over a LinearArena, for containers that only live for the frame.
+// deallocate does nothing; the memory comes back with the arena's Reset.
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(LinearArena* pArena) : m_pArena(pArena) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_pArena(other.GetArena()) {}
+
+    T* allocate(size_t count) { return m_pArena->AllocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    LinearArena* GetArena() const { return m_pArena; }
+
+private:
+    LinearArena* m_pArena;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.GetArena() == b.GetArena(); }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.GetArena() != b.GetArena(); }
+
+// Totals over a set of arenas, such as every thread's for each frame in flight.
+struct FrameArenaStatistics
+{
+    SIZE_T usedSize;                // Summed over the arenas' last complete frames.
+    SIZE_T highWaterMark;           // The most any one arena ever held.
+    SIZE_T capacity;
+    UINT64 overflowCount;
+};
+
+void AccumulateArenaStatistics(const LinearArena& arena, FrameArenaStatistics* pStatistics);
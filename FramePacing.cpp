@@ -0,0 +1,267 @@
+#include "stdafx.h"
+#include "FramePacing.h"
+#include <cmath>
+#include <deque>
+#include <random>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace
+{
+    // How the work estimate reacts to a missed vblank and to a frame shown on time, as
+    // fractions of the refresh period. Their ratio is roughly the miss rate it settles at.
+    const double WorkIncreaseOnMiss = 0.2;
+    const double WorkDecreaseOnHit = 0.005;
+    const double MinWorkEstimate = 0.5;
+    const double MaxWorkEstimateInPeriods = 4.0;
+
+    // Left to spin after the timer wakes up.
+    const double SpinTime = 0.5;
+}
+
+FramePacer::FramePacer() :
+    m_pacingEnabled(true),
+    m_refreshPeriod(0.0),
+    m_vblankTime(0.0),
+    m_workEstimate(0.0),
+    m_lastTargetTime(0.0),
+    m_lastMissTime(0.0)
+{
+    ResetStatistics();
+}
+
+void FramePacer::SetDisplayTiming(double refreshPeriod, double vblankTime)
+{
+    // Until there is any feedback, assume the frame takes a whole refresh, which is no
+    // later than starting right away.
+    if (m_refreshPeriod <= 0.0 && refreshPeriod > 0.0)
+    {
+        m_workEstimate = refreshPeriod;
+    }
+    m_refreshPeriod = refreshPeriod;
+    m_vblankTime = vblankTime;
+}
+
+FramePacer::FrameTiming FramePacer::ScheduleFrame(double now)
+{
+    FrameTiming frame = { now, now, now };
+    if (!m_pacingEnabled || m_refreshPeriod <= 0.0)
+    {
+        return frame;
+    }
+
+    // One frame per vblank: aiming at the previous frame's vblank would always miss.
+    frame.targetTime = max(GetNextVblank(now + m_workEstimate), m_lastTargetTime + m_refreshPeriod);
+    frame.startTime = max(now, frame.targetTime - m_workEstimate);
+    m_lastTargetTime = frame.targetTime;
+    return frame;
+}
+
+void FramePacer::RecordDisplay(const FrameTiming& frame, double displayTime)
+{
+    const double latency = displayTime - frame.startTime;
+    m_latencySum += latency;
+    m_maxLatency = max(m_maxLatency, latency);
+    m_displayedFrameCount++;
+
+    if (!m_pacingEnabled || m_refreshPeriod <= 0.0 || frame.targetTime <= frame.scheduleTime)
+    {
+        return;
+    }
+
+    if (displayTime > frame.targetTime + 0.5 * m_refreshPeriod)
+    {
+        m_missedFrameCount++;
+
+        // Frames scheduled before the last miss was shown did not know about it; they
+        // are late because it was, not because the estimate still is too small.
+        if (frame.scheduleTime > m_lastMissTime)
+        {
+            m_workEstimate = min(m_workEstimate + WorkIncreaseOnMiss * m_refreshPeriod, MaxWorkEstimateInPeriods * m_refreshPeriod);
+            m_lastMissTime = displayTime;
+
+            // The frames queued behind it are shown that much later too, so the next
+            // frame has to aim past them.
+            m_lastTargetTime += displayTime - frame.targetTime;
+        }
+    }
+    else
+    {
+        m_workEstimate = max(m_workEstimate - WorkDecreaseOnHit * m_refreshPeriod, MinWorkEstimate);
+    }
+}
+
+double FramePacer::GetAverageLatency() const
+{
+    return (m_displayedFrameCount > 0) ? m_latencySum / m_displayedFrameCount : 0.0;
+}
+
+void FramePacer::ResetStatistics()
+{
+    m_latencySum = 0.0;
+    m_maxLatency = 0.0;
+    m_displayedFrameCount = 0;
+    m_missedFrameCount = 0;
+}
+
+double FramePacer::GetNextVblank(double time) const
+{
+    return m_vblankTime + ceil((time - m_vblankTime) / m_refreshPeriod) * m_refreshPeriod;
+}
+
+PacingClock::PacingClock()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_millisecondsPerTick = 1000.0 / frequency.QuadPart;
+
+    // Not available before Windows 10 1803; SleepUntil then yields instead.
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+}
+
+PacingClock::~PacingClock()
+{
+    if (m_timer)
+    {
+        CloseHandle(m_timer);
+    }
+}
+
+double PacingClock::Now() const
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return FromQpc(counter.QuadPart);
+}
+
+double PacingClock::FromQpc(INT64 qpcTime) const
+{
+    return qpcTime * m_millisecondsPerTick;
+}
+
+void PacingClock::SleepUntil(double time) const
+{
+    const double sleepTime = time - Now() - SpinTime;
+    if (m_timer && sleepTime > 0.0)
+    {
+        // Relative due times are negative, in 100 ns units.
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -static_cast<LONGLONG>(sleepTime * 10000.0);
+        if (SetWaitableTimer(m_timer, &dueTime, 0, nullptr, nullptr, FALSE))
+        {
+            WaitForSingleObject(m_timer, INFINITE);
+        }
+    }
+
+    while (Now() < time)
+    {
+        if (m_timer)
+        {
+            YieldProcessor();
+        }
+        else
+        {
+            Sleep(0);
+        }
+    }
+}
+
+SimulatedDisplay::SimulatedDisplay(double refreshPeriod, UINT maxFrameLatency, bool variableRefresh) :
+    m_refreshPeriod(refreshPeriod),
+    m_maxFrameLatency(max(maxFrameLatency, 1u)),
+    m_variableRefresh(variableRefresh)
+{
+}
+
+double SimulatedDisplay::WaitForFrameLatency(double time) const
+{
+    // Display times only increase, so the presents still waiting are the last ones.
+    // Once the one maxFrameLatency from the end is shown, fewer than maxFrameLatency wait.
+    const size_t count = m_displayTimes.size();
+    if (count < m_maxFrameLatency)
+    {
+        return time;
+    }
+    return max(time, m_displayTimes[count - m_maxFrameLatency]);
+}
+
+double SimulatedDisplay::Present(double gpuCompleteTime)
+{
+    double displayTime;
+    const double lastDisplayTime = m_displayTimes.empty() ? -m_refreshPeriod : m_displayTimes.back();
+    if (m_variableRefresh)
+    {
+        displayTime = max(gpuCompleteTime, lastDisplayTime + m_refreshPeriod);
+    }
+    else
+    {
+        // Vblanks are at multiples of the period, and each shows at most one new frame.
+        const double readyTime = max(gpuCompleteTime, lastDisplayTime + 0.5 * m_refreshPeriod);
+        displayTime = ceil(readyTime / m_refreshPeriod) * m_refreshPeriod;
+    }
+    m_displayTimes.push_back(displayTime);
+    return displayTime;
+}
+
+FramePacingResult SimulateFramePacing(const FramePacingScenario& scenario)
+{
+    SimulatedDisplay display(scenario.refreshPeriod, scenario.maxFrameLatency, scenario.variableRefresh);
+    FramePacer pacer;
+    pacer.SetPacingEnabled(scenario.pacingEnabled);
+    if (!scenario.variableRefresh)
+    {
+        pacer.SetDisplayTiming(scenario.refreshPeriod, 0.0);
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> variation(1.0 - scenario.jitter, 1.0 + scenario.jitter);
+
+    struct PendingFrame
+    {
+        FramePacer::FrameTiming timing;
+        double displayTime;
+    };
+    std::deque<PendingFrame> pendingFrames;
+
+    double cpuTime = 0.0;
+    double gpuIdleTime = 0.0;
+    double firstDisplayTime = 0.0;
+    double lastDisplayTime = 0.0;
+    for (UINT i = 0; i < scenario.frameCount; i++)
+    {
+        const double wakeTime = display.WaitForFrameLatency(cpuTime);
+
+        // Frame statistics only report frames that have been shown.
+        while (!pendingFrames.empty() && pendingFrames.front().displayTime <= wakeTime)
+        {
+            pacer.RecordDisplay(pendingFrames.front().timing, pendingFrames.front().displayTime);
+            pendingFrames.pop_front();
+        }
+
+        const FramePacer::FrameTiming timing = pacer.ScheduleFrame(wakeTime);
+        cpuTime = timing.startTime + scenario.cpuTime * variation(random);
+        gpuIdleTime = max(cpuTime, gpuIdleTime) + scenario.gpuTime * variation(random);
+
+        const PendingFrame frame = { timing, display.Present(gpuIdleTime) };
+        pendingFrames.push_back(frame);
+        if (i == 0)
+        {
+            firstDisplayTime = frame.displayTime;
+        }
+        lastDisplayTime = frame.displayTime;
+    }
+    for (const PendingFrame& frame : pendingFrames)
+    {
+        pacer.RecordDisplay(frame.timing, frame.displayTime);
+    }
+
+    FramePacingResult result = {};
+    result.averageLatency = pacer.GetAverageLatency();
+    result.maxLatency = pacer.GetMaxLatency();
+    result.averageFrameInterval = (scenario.frameCount > 1) ? (lastDisplayTime - firstDisplayTime) / (scenario.frameCount - 1) : 0.0;
+    result.missedFrameCount = pacer.GetMissedFrameCount();
+    result.workEstimate = pacer.GetWorkEstimate();
+    return result;
+}
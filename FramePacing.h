@@ -0,0 +1,124 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+// Decides when to start simulating a frame so that it is ready just before the vblank
+// it is aimed at. Input is sampled when simulation starts, so starting as late as
+// possible is what shortens the latency the user sees; starting too late misses the
+// vblank and costs a whole refresh.
+//
+// The only feedback needed is when frames were shown. A frame shown after the vblank
+// it was aimed at grows the work estimate by a fraction of the refresh period, and
+// every frame shown on time shrinks it a little, so the estimate settles just above
+// the frame's real CPU and GPU time. All times are in milliseconds.
+class FramePacer
+{
+public:
+    struct FrameTiming
+    {
+        double scheduleTime;
+        double startTime;       // When simulation should start.
+        double targetTime;      // The vblank the frame is aimed at; equal to scheduleTime when not pacing.
+    };
+
+    FramePacer();
+
+    // A vblank time in the past and the refresh period. A period of 0 means there is
+    // no refresh to pace against, as with tearing or variable refresh.
+    void SetDisplayTiming(double refreshPeriod, double vblankTime);
+    void SetPacingEnabled(bool enabled) { m_pacingEnabled = enabled; }
+    bool IsPacingEnabled() const { return m_pacingEnabled; }
+
+    // now is the earliest the frame can start, after the frame latency wait.
+    FrameTiming ScheduleFrame(double now);
+    void RecordDisplay(const FrameTiming& frame, double displayTime);
+
+    double GetWorkEstimate() const { return m_workEstimate; }
+    double GetAverageLatency() const;       // From the start of simulation to display.
+    double GetMaxLatency() const { return m_maxLatency; }
+    UINT GetDisplayedFrameCount() const { return m_displayedFrameCount; }
+    UINT GetMissedFrameCount() const { return m_missedFrameCount; }
+    void ResetStatistics();
+
+private:
+    double GetNextVblank(double time) const;
+
+    bool m_pacingEnabled;
+    double m_refreshPeriod;
+    double m_vblankTime;
+    double m_workEstimate;
+    double m_lastTargetTime;
+    double m_lastMissTime;
+
+    double m_latencySum;
+    double m_maxLatency;
+    UINT m_displayedFrameCount;
+    UINT m_missedFrameCount;
+};
+
+// Milliseconds from QueryPerformanceCounter, and sleeping until one of them. Sleep()
+// is only accurate to the system timer resolution, so the wait uses a high-resolution
+// waitable timer where available and spins for the last fraction of a millisecond.
+class PacingClock
+{
+public:
+    PacingClock();
+    ~PacingClock();
+
+    double Now() const;
+    double FromQpc(INT64 qpcTime) const;
+    void SleepUntil(double time) const;
+
+private:
+    double m_millisecondsPerTick;
+    HANDLE m_timer;
+};
+
+// A flip model display. Presents queue up, and each is shown at the first vblank after
+// its GPU work has finished and the previous present was shown. With variable refresh
+// a frame is shown as soon as it is ready, but no sooner than refreshPeriod (the
+// fastest refresh) after the previous one.
+class SimulatedDisplay
+{
+public:
+    SimulatedDisplay(double refreshPeriod, UINT maxFrameLatency, bool variableRefresh);
+
+    // When the swap chain's frame latency waitable object would be signaled: once fewer
+    // than maxFrameLatency presents are waiting to be shown.
+    double WaitForFrameLatency(double time) const;
+
+    // Returns when the frame is shown.
+    double Present(double gpuCompleteTime);
+
+private:
+    double m_refreshPeriod;
+    UINT m_maxFrameLatency;
+    bool m_variableRefresh;
+    std::vector<double> m_displayTimes;
+};
+
+struct FramePacingScenario
+{
+    double refreshPeriod;
+    UINT maxFrameLatency;
+    bool variableRefresh;
+    bool pacingEnabled;
+    double cpuTime;             // Simulation and recording, per frame.
+    double gpuTime;
+    double jitter;              // Each frame's CPU and GPU times vary by up to this fraction.
+    UINT frameCount;
+};
+
+struct FramePacingResult
+{
+    double averageLatency;
+    double maxLatency;
+    double averageFrameInterval;
+    UINT missedFrameCount;
+    double workEstimate;        // The pacer's, at the end.
+};
+
+// Runs a FramePacer against a SimulatedDisplay, with the CPU and GPU work of each frame
+// serialized as the real queue would. Only display times already in the past are fed
+// back, as the swap chain's frame statistics would be.
+FramePacingResult SimulateFramePacing(const FramePacingScenario& scenario);
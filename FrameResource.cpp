@@ -1,10 +1,18 @@
 #include "stdafx.h"
 #include "FrameResource.h"
-#include <random>
 
-FrameResource::FrameResource(ID3D12Device* pDevice, ID3D12PipelineState* pPso, ID3D12DescriptorHeap* pCbvSrvHeap, D3D12_VIEWPORT* pViewport, UINT frameResourceIndex) :
+FrameResource::FrameResource(ID3D12Device* pDevice, HeapSuballocator* pHeapAllocator, ID3D12PipelineState* pPso, ID3D12DescriptorHeap* pCbvSrvHeap, D3D12_VIEWPORT* pViewport, UINT frameResourceIndex) :
     m_fenceValue(0),
-    m_pipelineState(pPso)
+    m_transformsOnGpu(false),
+    m_drawsOnGpu(false),
+    m_validateIndirectDraws(false),
+    m_instancesPacked(false),
+    m_depthMode(DepthModeOff),
+    m_computeFenceValue(0),
+    m_pipelineState(pPso),
+    m_pHeapAllocator(pHeapAllocator),
+    m_cbvSrvDescriptorSize(pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV)),
+    m_dsvDescriptorSize(pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV))
 {
     for (UINT i = 0; i < CommandListCount; i++)
     {
@@ -29,6 +37,12 @@ FrameResource::FrameResource(ID3D12Device* pDevice, ID3D12PipelineState* pPso, I
         ThrowIfFailed(m_sceneCommandLists[i]->Close());
     }
 
+    ThrowIfFailed(pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(&m_computeCommandAllocator)));
+    ThrowIfFailed(pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, m_computeCommandAllocator.Get(), nullptr, IID_PPV_ARGS(&m_computeCommandList)));
+    NAME_D3D12_OBJECT(m_computeCommandList);
+    ThrowIfFailed(m_computeCommandList->Close());
+
+    m_renderGraph.Create(pDevice);
     // Get a handle to the start of the descriptor heap then offset it 
     // based on the existing textures and the frame resource index. Each 
     // frame has 1 SRV (shadow tex) and 2 CBVs.
@@ -37,53 +51,130 @@ FrameResource::FrameResource(ID3D12Device* pDevice, ID3D12PipelineState* pPso, I
     CD3DX12_CPU_DESCRIPTOR_HANDLE cbvSrvCpuHandle(pCbvSrvHeap->GetCPUDescriptorHandleForHeapStart());
     CD3DX12_GPU_DESCRIPTOR_HANDLE cbvSrvGpuHandle(pCbvSrvHeap->GetGPUDescriptorHandleForHeapStart());
     // ؽó   + Frame   (ϳ  ִٰ ѵѵ,,)
-    cbvSrvCpuHandle.Offset(textureCount + (frameResourceIndex), cbvSrvDescriptorSize);
-    cbvSrvGpuHandle.Offset(textureCount + (frameResourceIndex), cbvSrvDescriptorSize);
+    cbvSrvCpuHandle.Offset(textureCount + frameResourceIndex * DescriptorCount, cbvSrvDescriptorSize);
+    cbvSrvGpuHandle.Offset(textureCount + frameResourceIndex * DescriptorCount, cbvSrvDescriptorSize);
     
-    // Create the constant buffers.
+    // Create the constant buffers. All of them share one placed buffer so they pay
+    // for a single 64KB placement alignment instead of one implicit heap each.
+    const UINT constantBufferSize = CalculateConstantBufferByteSize(sizeof(SceneConstantBuffer)); // must be a multiple 256 bytes
+    m_sceneConstantBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(constantBufferSize * ConstBufferNum),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_sceneConstantBuffer));
+    NAME_D3D12_OBJECT(m_sceneConstantBuffer);
+
+    // Map the constant buffers and cache their heap pointers.
+    UINT8* pConstantBufferBegin;
+    CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
+    ThrowIfFailed(m_sceneConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pConstantBufferBegin)));
+    const D3D12_GPU_VIRTUAL_ADDRESS constantBufferGpuBegin = m_sceneConstantBuffer->GetGPUVirtualAddress();
+
     for(int i = 0; i< ConstBufferNum; i++)
     {
         m_sceneCbvHandle[i] = cbvSrvGpuHandle;
-        const UINT constantBufferSize = (sizeof(SceneConstantBuffer) + (D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1)) & ~(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1); // must be a multiple 256 bytes
-        ThrowIfFailed(pDevice->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(constantBufferSize),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&m_sceneConstantBuffer[i])));
-
-        // Map the constant buffers and cache their hseap pointers.
-        CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-        ThrowIfFailed(m_sceneConstantBuffer[i]->Map(0, &readRange, reinterpret_cast<void**>(&mp_sceneConstantBufferWO[i])));
+        mp_sceneConstantBufferWO[i] = reinterpret_cast<SceneConstantBuffer*>(pConstantBufferBegin + i * constantBufferSize);
 
         D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
         cbvDesc.SizeInBytes = constantBufferSize;
 
         // Describe and create the scene constant buffer view (CBV) and 
         // cache the GPU descriptor handle.
-        cbvDesc.BufferLocation = m_sceneConstantBuffer[i]->GetGPUVirtualAddress();
+        cbvDesc.BufferLocation = constantBufferGpuBegin + i * constantBufferSize;
         pDevice->CreateConstantBufferView(&cbvDesc, cbvSrvCpuHandle);
         
         cbvSrvCpuHandle.Offset(1, cbvSrvDescriptorSize);
         cbvSrvGpuHandle.Offset(1, cbvSrvDescriptorSize);
     }
 
-    std::random_device rd; //    ʿ õ 
-    std::mt19937 gen(rd()); //    (Mersenne Twister)
+    // Compute output with the same per-object layout. Buffers decay to COMMON after every
+    // ExecuteCommandLists, so the compute queue's UAV writes and the direct queue's CBV
+    // reads both rely on implicit promotion and need no explicit barriers.
+    m_sceneTransformBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_DEFAULT,
+        &CD3DX12_RESOURCE_DESC::Buffer(constantBufferSize * ConstBufferNum, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&m_sceneTransformBuffer));
+    NAME_D3D12_OBJECT(m_sceneTransformBuffer);
 
-    // 2. -1.0 ~ 1.0   εҼ ڸ ϴ  
-    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
-    float randomNum = dis(gen);
+    const D3D12_GPU_VIRTUAL_ADDRESS transformBufferGpuBegin = m_sceneTransformBuffer->GetGPUVirtualAddress();
     for (int i = 0; i < ConstBufferNum; i++)
     {
-        mp_sceneConstantBufferWO[i]->model = XMMatrixTranspose(XMMatrixTranslation(dis(gen), dis(gen), 0.0f));
+        m_sceneTransformCbvHandle[i] = cbvSrvGpuHandle;
+
+        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+        cbvDesc.SizeInBytes = constantBufferSize;
+        cbvDesc.BufferLocation = transformBufferGpuBegin + i * constantBufferSize;
+        pDevice->CreateConstantBufferView(&cbvDesc, cbvSrvCpuHandle);
+
+        cbvSrvCpuHandle.Offset(1, cbvSrvDescriptorSize);
+        cbvSrvGpuHandle.Offset(1, cbvSrvDescriptorSize);
     }
 
-    //mp_sceneConstantBufferWO[1]->model = XMMatrixTranspose(XMMatrixTranslation(-0.8f, -0.5f, 0.0f));
-    //mp_sceneConstantBufferWO[2]->model = XMMatrixTranspose(XMMatrixTranslation(0.5f, 0.1f, 0.0f));
-    //mp_sceneConstantBufferWO[3]->model = XMMatrixTranspose(XMMatrixTranslation(-0.65f, -0.1f, 0.0f));
-    //mp_sceneConstantBufferWO[4]->model = XMMatrixTranspose(XMMatrixTranslation(-0.7f, 0.7f, 0.0f));
+    // Packed instances for the paths that read transforms as a structured buffer: one
+    // buffer the CPU writes, one the compute pass writes, like the constants above.
+    const UINT64 instanceBufferSize = sizeof(PackedInstanceData) * ConstBufferNum;
+    m_instanceUploadBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(instanceBufferSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_instanceUploadBuffer));
+    NAME_D3D12_OBJECT(m_instanceUploadBuffer);
+    ThrowIfFailed(m_instanceUploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mp_instanceDataWO)));
+
+    m_instanceBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_DEFAULT,
+        &CD3DX12_RESOURCE_DESC::Buffer(instanceBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&m_instanceBuffer));
+    NAME_D3D12_OBJECT(m_instanceBuffer);
+
+    // Draw commands written by the cull pass, and a copy of them for validation.
+    const UINT64 indirectCommandBufferSize = IndirectCommandCountOffset + sizeof(UINT);
+    m_indirectCommandBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_DEFAULT,
+        &CD3DX12_RESOURCE_DESC::Buffer(indirectCommandBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&m_indirectCommandBuffer));
+    NAME_D3D12_OBJECT(m_indirectCommandBuffer);
+
+    m_indirectReadbackBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_READBACK,
+        &CD3DX12_RESOURCE_DESC::Buffer(indirectCommandBufferSize),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_indirectReadbackBuffer));
+    NAME_D3D12_OBJECT(m_indirectReadbackBuffer);
+
+    // The depth buffer, the size of the viewport, and its two views.
+    const CD3DX12_CLEAR_VALUE depthClearValue(DepthBufferFormat, 1.0f, 0);
+    m_depthBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_DEFAULT,
+        &CD3DX12_RESOURCE_DESC::Tex2D(DepthBufferFormat, static_cast<UINT64>(pViewport->Width), static_cast<UINT>(pViewport->Height), 1, 1, 1, 0,
+            D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE),
+        D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        &depthClearValue,
+        IID_PPV_ARGS(&m_depthBuffer));
+    NAME_D3D12_OBJECT(m_depthBuffer);
+
+    D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
+    dsvHeapDesc.NumDescriptors = 2;
+    dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+    ThrowIfFailed(pDevice->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_dsvHeap)));
+    NAME_D3D12_OBJECT(m_dsvHeap);
+
+    D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+    dsvDesc.Format = DepthBufferFormat;
+    dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+    pDevice->CreateDepthStencilView(m_depthBuffer.Get(), &dsvDesc, dsvHandle);
+    dsvDesc.Flags = D3D12_DSV_FLAG_READ_ONLY_DEPTH;
+    pDevice->CreateDepthStencilView(m_depthBuffer.Get(), &dsvDesc, dsvHandle.Offset(1, m_dsvDescriptorSize));
 
     // Batch up command lists for execution later.
     {
@@ -101,11 +192,24 @@ FrameResource::~FrameResource()
         m_commandAllocators[i] = nullptr;
         m_commandLists[i] = nullptr;
     }
-    for (int i = 0; i < ConstBufferNum; i++)
-    {
-        m_sceneConstantBuffer[i] = nullptr;
-    }
-
+    m_renderGraph.Release();
+    m_sceneConstantBuffer = nullptr;
+    m_pHeapAllocator->Free(m_sceneConstantBufferAllocation);
+    m_sceneTransformBuffer = nullptr;
+    m_pHeapAllocator->Free(m_sceneTransformBufferAllocation);
+    m_instanceUploadBuffer = nullptr;
+    m_pHeapAllocator->Free(m_instanceUploadBufferAllocation);
+    m_instanceBuffer = nullptr;
+    m_pHeapAllocator->Free(m_instanceBufferAllocation);
+    m_indirectCommandBuffer = nullptr;
+    m_pHeapAllocator->Free(m_indirectCommandBufferAllocation);
+    m_indirectReadbackBuffer = nullptr;
+    m_pHeapAllocator->Free(m_indirectReadbackBufferAllocation);
+    m_depthBuffer = nullptr;
+    m_pHeapAllocator->Free(m_depthBufferAllocation);
+    m_dsvHeap = nullptr;
+    m_computeCommandList = nullptr;
+    m_computeCommandAllocator = nullptr;
     for (int i = 0; i < NumContexts; i++)
     {
         m_sceneCommandLists[i] = nullptr;
@@ -118,11 +222,13 @@ FrameResource::~FrameResource()
 // this frame resource.
 void FrameResource::WriteConstantBuffers(XMMATRIX inMatrix, int index)
 {
-    SceneConstantBuffer sceneConsts = *mp_sceneConstantBufferWO[index];
-    sceneConsts.model = XMMatrixTranspose(sceneConsts.model);
-    sceneConsts.model = inMatrix * sceneConsts.model;
-    sceneConsts.model = XMMatrixTranspose(sceneConsts.model);
-    memcpy(mp_sceneConstantBufferWO[index], &sceneConsts, sizeof(SceneConstantBuffer));
+    // Upload heap memory is write-combined; only ever write to it.
+    mp_sceneConstantBufferWO[index]->model = XMMatrixTranspose(inMatrix);
+}
+
+void FrameResource::WriteInstanceData(XMMATRIX inMatrix, int index)
+{
+    EncodeInstanceData(inMatrix, mp_instanceDataWO + index);
 }
 
 void FrameResource::Init()
@@ -151,10 +257,100 @@ void FrameResource::Bind(ID3D12GraphicsCommandList* pCommandList, D3D12_CPU_DESC
 
     assert(pRtvHandle != nullptr);
 
-    pCommandList->OMSetRenderTargets(1, pRtvHandle, FALSE, nullptr);
+    if (m_depthMode == DepthModeOff)
+    {
+        pCommandList->OMSetRenderTargets(1, pRtvHandle, FALSE, nullptr);
+        return;
+    }
+
+    // After a pre-pass the depth buffer is final, and the graph has made it read only.
+    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+    if (m_depthMode == DepthModePrePass)
+    {
+        dsvHandle.Offset(1, m_dsvDescriptorSize);
+    }
+    pCommandList->OMSetRenderTargets(1, pRtvHandle, FALSE, &dsvHandle);
 }
 
-void FrameResource::SetConstBuffer(ID3D12GraphicsCommandList* pCommandList, int index)
+void FrameResource::BindDepthOnly(ID3D12GraphicsCommandList* pCommandList)
 {
-    pCommandList->SetGraphicsRootDescriptorTable(1, m_sceneCbvHandle[index]);
+    const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_dsvHeap->GetCPUDescriptorHandleForHeapStart();
+    pCommandList->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+}
+
+// Per-object constants for this frame, from whichever buffer the transform update wrote.
+DrawBindingSource FrameResource::GetDrawBindingSource(UINT indexCount) const
+{
+    ID3D12Resource* pTransforms = m_transformsOnGpu ? m_sceneTransformBuffer.Get() : m_sceneConstantBuffer.Get();
+
+    DrawBindingSource source = {};
+    source.firstCbvHandle = m_transformsOnGpu ? m_sceneTransformCbvHandle[0] : m_sceneCbvHandle[0];
+    source.cbvDescriptorSize = m_cbvSrvDescriptorSize;
+    source.firstConstantsAddress = pTransforms->GetGPUVirtualAddress();
+    source.constantsStride = sizeof(SceneConstantBuffer);
+    source.indexCount = indexCount;
+    return source;
+}
+
+// Binds the packed instances as a structured buffer, for shaders that index it with
+// the object index root constant. Only valid when m_instancesPacked is set.
+void FrameResource::SetObjectTransforms(ID3D12GraphicsCommandList* pCommandList)
+{
+    assert(m_instancesPacked);
+    ID3D12Resource* pInstances = m_transformsOnGpu ? m_instanceBuffer.Get() : m_instanceUploadBuffer.Get();
+    pCommandList->SetGraphicsRootShaderResourceView(3, pInstances->GetGPUVirtualAddress());
+}
+
+// Draws every object the cull pass kept with one ExecuteIndirect.
+void FrameResource::ExecuteIndirectDraws(ID3D12GraphicsCommandList* pCommandList, ID3D12CommandSignature* pCommandSignature)
+{
+    SetObjectTransforms(pCommandList);
+    pCommandList->ExecuteIndirect(pCommandSignature, ConstBufferNum, m_indirectCommandBuffer.Get(), 0, m_indirectCommandBuffer.Get(), IndirectCommandCountOffset);
+}
+
+// Named after the frame resource; a replay uses the frame resource the captured frame
+// did, so each name binds to the same buffer it was captured from.
+void FrameResource::GetCaptureObjects(UINT frameResourceIndex, std::vector<CaptureObjectBinding>* pObjects)
+{
+    const std::string prefix = "FrameResource" + std::to_string(frameResourceIndex) + ".";
+    const CaptureObjectBinding objects[] =
+    {
+        { prefix + "SceneConstantBuffer", CaptureObjectResource, m_sceneConstantBuffer.Get(), mp_sceneConstantBufferWO[0] },
+        { prefix + "SceneTransformBuffer", CaptureObjectResource, m_sceneTransformBuffer.Get(), nullptr },
+        { prefix + "InstanceUploadBuffer", CaptureObjectResource, m_instanceUploadBuffer.Get(), mp_instanceDataWO },
+        { prefix + "InstanceBuffer", CaptureObjectResource, m_instanceBuffer.Get(), nullptr },
+        { prefix + "IndirectCommandBuffer", CaptureObjectResource, m_indirectCommandBuffer.Get(), nullptr },
+        { prefix + "IndirectReadbackBuffer", CaptureObjectResource, m_indirectReadbackBuffer.Get(), nullptr },
+        { prefix + "DepthBuffer", CaptureObjectResource, m_depthBuffer.Get(), nullptr },
+        { prefix + "DsvHeap", CaptureObjectDescriptorHeap, m_dsvHeap.Get(), nullptr },
+    };
+    pObjects->insert(pObjects->end(), std::begin(objects), std::end(objects));
+}
+
+// Stores what the CPU transform update wrote this frame. Reading back the upload heap
+// is slow because it is write-combined, but this only runs while capturing. Buffers
+// the compute queue writes are not captured; a replay reads whatever they hold.
+void FrameResource::CaptureBufferContents(CommandCaptureWriter* pWriter)
+{
+    if (m_transformsOnGpu)
+    {
+        return;
+    }
+
+    if (m_instancesPacked)
+    {
+        pWriter->CaptureBufferData(m_instanceUploadBuffer.Get(), 0, mp_instanceDataWO, ConstBufferNum * sizeof(PackedInstanceData));
+    }
+    else
+    {
+        pWriter->CaptureBufferData(m_sceneConstantBuffer.Get(), 0, mp_sceneConstantBufferWO[0], ConstBufferNum * sizeof(SceneConstantBuffer));
+    }
+}
+
+void FrameResource::ResetScratchArenas()
+{
+    for (LinearArena& arena : m_scratchArenas)
+    {
+        arena.Reset();
+    }
 }
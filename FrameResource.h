@@ -2,6 +2,13 @@
 #include "stdafx.h"
 #include "DXSampleHelper.h"
 #include "D3D12HelloTriangle.h"
+#include "HeapAllocator.h"
+#include "RenderGraph.h"
+#include "IndirectDraw.h"
+#include "InstanceData.h"
+#include "CommandCapture.h"
+#include "FrameArena.h"
+#include "DrawOrder.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -9,13 +16,40 @@ using namespace Microsoft::WRL;
 class FrameResource
 {
 public:
-	FrameResource(ID3D12Device* pDevice, ID3D12PipelineState* pPso, ID3D12DescriptorHeap* pCbvSrvHeap, D3D12_VIEWPORT* pViewport, UINT frameResourceIndex);
+	// Descriptors each frame resource owns in the shader-visible CBV/SRV heap: one CBV per
+	// object for the CPU-written upload buffer, then one per object for the compute output.
+	static const UINT DescriptorCount = 2 * ConstBufferNum;
+
+	// The indirect command buffer holds ConstBufferNum commands followed by the command count.
+	static const UINT64 IndirectCommandCountOffset = (ConstBufferNum * sizeof(IndirectCommand) + D3D12_UAV_COUNTER_PLACEMENT_ALIGNMENT - 1) & ~(D3D12_UAV_COUNTER_PLACEMENT_ALIGNMENT - 1);
+
+	static const DXGI_FORMAT DepthBufferFormat = DXGI_FORMAT_D32_FLOAT;
+	FrameResource(ID3D12Device* pDevice, HeapSuballocator* pHeapAllocator, ID3D12PipelineState* pPso, ID3D12DescriptorHeap* pCbvSrvHeap, D3D12_VIEWPORT* pViewport, UINT frameResourceIndex);
 	~FrameResource();
 
+	// Binds the depth buffer as m_depthMode needs it, along with the render target.
 	void Bind(ID3D12GraphicsCommandList* pCommandList, D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHandle);
+	// The depth pre-pass: the depth buffer alone, writable.
+	void BindDepthOnly(ID3D12GraphicsCommandList* pCommandList);
+	ID3D12Resource* GetDepthBuffer() const { return m_depthBuffer.Get(); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetDepthStencilView() const { return m_dsvHeap->GetCPUDescriptorHandleForHeapStart(); }
 	void Init();
 	void WriteConstantBuffers(XMMATRIX offset, int index);
-	void SetConstBuffer(ID3D12GraphicsCommandList* pCommandList, int index);
+	void WriteInstanceData(XMMATRIX inMatrix, int index);
+	DrawBindingSource GetDrawBindingSource(UINT indexCount) const;
+	void SetObjectTransforms(ID3D12GraphicsCommandList* pCommandList);
+	void SetPipelineState(ID3D12PipelineState* pPso) { m_pipelineState = pPso; }
+	ID3D12Resource* GetSceneTransformBuffer() const { return m_sceneTransformBuffer.Get(); }
+	ID3D12Resource* GetInstanceBuffer() const { return m_instanceBuffer.Get(); }
+	ID3D12Resource* GetIndirectCommandBuffer() const { return m_indirectCommandBuffer.Get(); }
+	ID3D12Resource* GetIndirectReadbackBuffer() const { return m_indirectReadbackBuffer.Get(); }
+	void ExecuteIndirectDraws(ID3D12GraphicsCommandList* pCommandList, ID3D12CommandSignature* pCommandSignature);
+	// The buffers a command capture names, and the CPU-written part it stores each frame.
+	void GetCaptureObjects(UINT frameResourceIndex, std::vector<CaptureObjectBinding>* pObjects);
+	void CaptureBufferContents(CommandCaptureWriter* pWriter);
+	// Called once the GPU has finished this frame resource's last frame.
+	void ResetScratchArenas();
+	LinearArena& GetMainThreadArena() { return m_scratchArenas[NumContexts]; }
 public:
 	ID3D12CommandList* m_batchSubmit[NumContexts + CommandListCount];
 
@@ -25,13 +59,57 @@ public:
 	ComPtr<ID3D12CommandAllocator> m_sceneCommandAllocators[NumContexts];
 	ComPtr<ID3D12GraphicsCommandList> m_sceneCommandLists[NumContexts];
 
+	// Object transforms are either written by the CPU into the upload buffer or by a
+	// compute dispatch into m_sceneTransformBuffer; the draws read whichever was chosen.
+	ComPtr<ID3D12CommandAllocator> m_computeCommandAllocator;
+	ComPtr<ID3D12GraphicsCommandList> m_computeCommandList;
+	bool m_transformsOnGpu;
+	bool m_drawsOnGpu;
+	bool m_validateIndirectDraws;
+	// The draws read PackedInstanceData rather than the 256-byte SceneConstantBuffers,
+	// so the transform update writes the instance buffers instead.
+	bool m_instancesPacked;
+	// Chosen with the frame's draw order; GPU-driven frames always draw without depth.
+	DepthMode m_depthMode;
+	UINT64 m_computeFenceValue;
+	// Rebuilt every frame; keeps its transient heaps while the frame resource is recycled.
+	RenderGraph m_renderGraph;
+
 	UINT64 m_fenceValue;
+	// Scratch memory that lives for the frame: one arena per worker thread, then the
+	// main thread's. Each is only touched by its thread.
+	LinearArena m_scratchArenas[NumContexts + 1];
 	SceneConstantBuffer* mp_sceneConstantBufferWO[ConstBufferNum];        // WRITE-ONLY pointer to the scene pass constant buffer.
 private:
 	ComPtr<ID3D12PipelineState> m_pipelineState;
-	ComPtr<ID3D12Resource> m_sceneConstantBuffer[ConstBufferNum];
+	HeapSuballocator* m_pHeapAllocator;
+	UINT m_cbvSrvDescriptorSize;
+	ComPtr<ID3D12Resource> m_sceneConstantBuffer;
+	HeapAllocation m_sceneConstantBufferAllocation;
 	
 	D3D12_GPU_DESCRIPTOR_HANDLE m_sceneCbvHandle[ConstBufferNum];
 
+	ComPtr<ID3D12Resource> m_sceneTransformBuffer;
+	HeapAllocation m_sceneTransformBufferAllocation;
+	D3D12_GPU_DESCRIPTOR_HANDLE m_sceneTransformCbvHandle[ConstBufferNum];
+
+	ComPtr<ID3D12Resource> m_instanceUploadBuffer;
+	HeapAllocation m_instanceUploadBufferAllocation;
+	PackedInstanceData* mp_instanceDataWO;        // WRITE-ONLY pointer to m_instanceUploadBuffer.
+	ComPtr<ID3D12Resource> m_instanceBuffer;
+	HeapAllocation m_instanceBufferAllocation;
+
+	ComPtr<ID3D12Resource> m_indirectCommandBuffer;
+	HeapAllocation m_indirectCommandBufferAllocation;
+	ComPtr<ID3D12Resource> m_indirectReadbackBuffer;
+	HeapAllocation m_indirectReadbackBufferAllocation;
+
+	// Each frame resource has its own depth buffer, so frames in flight don't share
+	// one. The DSV heap holds a writable view, then a read-only one for the shading
+	// pass after a depth pre-pass.
+	ComPtr<ID3D12Resource> m_depthBuffer;
+	HeapAllocation m_depthBufferAllocation;
+	ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
+	UINT m_dsvDescriptorSize;
 };
 
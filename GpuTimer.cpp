@@ -0,0 +1,241 @@
+#include "stdafx.h"
+#include "GpuTimer.h"
+#include <algorithm>
+
+namespace
+{
+    void SetZoneName(TimingZone* pZone, const char* name)
+    {
+        strncpy_s(pZone->name, name, _TRUNCATE);
+    }
+}
+
+TimestampQueryRing::TimestampQueryRing() :
+    m_maxZoneCount(0),
+    m_currentSlot(0),
+    m_droppedFrameCount(0),
+    m_overflowZoneCount(0)
+{
+}
+
+void TimestampQueryRing::Reset(UINT frameCount, UINT maxZoneCount)
+{
+    assert(frameCount > 0);
+    m_slots.assign(frameCount, Slot());
+    for (Slot& slot : m_slots)
+    {
+        slot.gpuZones.resize(maxZoneCount);
+        slot.zoneCount = 0;
+        slot.fenceValue = 0;
+    }
+    m_pendingSlots.clear();
+    m_maxZoneCount = maxZoneCount;
+    m_currentSlot = frameCount - 1;
+    m_droppedFrameCount = 0;
+    m_overflowZoneCount = 0;
+}
+
+void TimestampQueryRing::BeginFrame()
+{
+    m_currentSlot = (m_currentSlot + 1) % GetFrameCount();
+
+    // The slices are reused in order, so an unread one is the oldest pending frame.
+    if (!m_pendingSlots.empty() && m_pendingSlots.front() == m_currentSlot)
+    {
+        m_pendingSlots.pop_front();
+        m_droppedFrameCount++;
+    }
+
+    Slot& slot = m_slots[m_currentSlot];
+    slot.zoneCount = 0;
+    slot.cpuZones.clear();
+    slot.fenceValue = 0;
+}
+
+UINT TimestampQueryRing::AllocateZone(const char* name)
+{
+    Slot& slot = m_slots[m_currentSlot];
+    const UINT zone = static_cast<UINT>(InterlockedIncrement(&slot.zoneCount) - 1);
+    if (zone >= m_maxZoneCount)
+    {
+        InterlockedIncrement64(&m_overflowZoneCount);
+        return InvalidZone;
+    }
+    SetZoneName(&slot.gpuZones[zone], name);
+    return zone;
+}
+
+void TimestampQueryRing::AddCpuZone(const char* name, double start, double end)
+{
+    TimingZone zone = {};
+    SetZoneName(&zone, name);
+    zone.start = start;
+    zone.end = end;
+    zone.gpu = false;
+    m_slots[m_currentSlot].cpuZones.push_back(zone);
+}
+
+UINT TimestampQueryRing::GetQueryCount() const
+{
+    return 2 * min(static_cast<UINT>(m_slots[m_currentSlot].zoneCount), m_maxZoneCount);
+}
+
+void TimestampQueryRing::FinishFrame(UINT64 fenceValue)
+{
+    m_slots[m_currentSlot].fenceValue = fenceValue;
+    m_pendingSlots.push_back(m_currentSlot);
+}
+
+bool TimestampQueryRing::GetCompletedFrame(UINT64 completedFenceValue, UINT* pFirstQuery) const
+{
+    if (m_pendingSlots.empty() || m_slots[m_pendingSlots.front()].fenceValue > completedFenceValue)
+    {
+        return false;
+    }
+    *pFirstQuery = 2 * m_pendingSlots.front() * m_maxZoneCount;
+    return true;
+}
+
+void TimestampQueryRing::ResolveFrame(const UINT64* pTimestamps, const TimestampCalibration& calibration, std::vector<TimingZone>* pZones)
+{
+    assert(!m_pendingSlots.empty());
+    const Slot& slot = m_slots[m_pendingSlots.front()];
+    m_pendingSlots.pop_front();
+
+    const size_t firstZone = pZones->size();
+    pZones->insert(pZones->end(), slot.cpuZones.begin(), slot.cpuZones.end());
+
+    // Timestamps from before the calibration point come out as negative tick counts.
+    const double millisecondsPerTick = 1000.0 / calibration.frequency;
+    const UINT zoneCount = min(static_cast<UINT>(slot.zoneCount), m_maxZoneCount);
+    for (UINT i = 0; i < zoneCount; i++)
+    {
+        TimingZone zone = slot.gpuZones[i];
+        zone.start = calibration.cpuTime + static_cast<INT64>(pTimestamps[2 * i] - calibration.gpuTimestamp) * millisecondsPerTick;
+        zone.end = calibration.cpuTime + static_cast<INT64>(pTimestamps[2 * i + 1] - calibration.gpuTimestamp) * millisecondsPerTick;
+        zone.gpu = true;
+        pZones->push_back(zone);
+    }
+
+    std::stable_sort(pZones->begin() + firstZone, pZones->end(), [](const TimingZone& a, const TimingZone& b)
+    {
+        return a.start < b.start;
+    });
+}
+
+GpuTimer::GpuTimer() :
+    m_pHeapAllocator(nullptr),
+    m_frequency(0),
+    m_readBackFrameCount(0)
+{
+}
+
+GpuTimer::~GpuTimer()
+{
+    Release();
+}
+
+void GpuTimer::Create(ID3D12Device* pDevice, ID3D12CommandQueue* pCommandQueue, HeapSuballocator* pHeapAllocator, UINT frameCount, UINT maxZoneCount)
+{
+    Release();
+    m_commandQueue = pCommandQueue;
+    m_pHeapAllocator = pHeapAllocator;
+    m_ring.Reset(frameCount, maxZoneCount);
+    ThrowIfFailed(pCommandQueue->GetTimestampFrequency(&m_frequency));
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = m_ring.GetTotalQueryCount();
+    ThrowIfFailed(pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_queryHeap)));
+    NAME_D3D12_OBJECT(m_queryHeap);
+
+    m_readbackBufferAllocation = pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_READBACK,
+        &CD3DX12_RESOURCE_DESC::Buffer(m_ring.GetTotalQueryCount() * sizeof(UINT64)),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_readbackBuffer));
+    NAME_D3D12_OBJECT(m_readbackBuffer);
+
+    m_lastFrameZones.clear();
+    ResetStatistics();
+}
+
+void GpuTimer::Release()
+{
+    if (m_readbackBuffer)
+    {
+        m_readbackBuffer = nullptr;
+        m_pHeapAllocator->Free(m_readbackBufferAllocation);
+    }
+    m_queryHeap = nullptr;
+    m_commandQueue = nullptr;
+}
+
+UINT GpuTimer::BeginZone(ID3D12GraphicsCommandList* pCommandList, const char* name)
+{
+    const UINT zone = m_ring.AllocateZone(name);
+    if (zone != TimestampQueryRing::InvalidZone)
+    {
+        pCommandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_ring.GetBeginQuery(zone));
+    }
+    return zone;
+}
+
+void GpuTimer::EndZone(ID3D12GraphicsCommandList* pCommandList, UINT zone)
+{
+    if (zone != TimestampQueryRing::InvalidZone)
+    {
+        pCommandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_ring.GetEndQuery(zone));
+    }
+}
+
+void GpuTimer::EndFrame(ID3D12GraphicsCommandList* pCommandList)
+{
+    const UINT queryCount = m_ring.GetQueryCount();
+    if (queryCount > 0)
+    {
+        const UINT firstQuery = m_ring.GetFirstQuery();
+        pCommandList->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, queryCount, m_readbackBuffer.Get(), firstQuery * sizeof(UINT64));
+    }
+}
+
+void GpuTimer::ReadBack(UINT64 completedFenceValue, const PacingClock& clock)
+{
+    UINT firstQuery;
+    while (m_ring.GetCompletedFrame(completedFenceValue, &firstQuery))
+    {
+        // Recalibrated for every frame, so the two clocks can't drift apart.
+        UINT64 cpuTimestamp;
+        TimestampCalibration calibration;
+        calibration.frequency = m_frequency;
+        ThrowIfFailed(m_commandQueue->GetClockCalibration(&calibration.gpuTimestamp, &cpuTimestamp));
+        calibration.cpuTime = clock.FromQpc(static_cast<INT64>(cpuTimestamp));
+
+        const SIZE_T begin = firstQuery * sizeof(UINT64);
+        const CD3DX12_RANGE readRange(begin, begin + 2 * m_ring.GetMaxZoneCount() * sizeof(UINT64));
+        UINT8* pData;
+        ThrowIfFailed(m_readbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+        m_lastFrameZones.clear();
+        m_ring.ResolveFrame(reinterpret_cast<const UINT64*>(pData + begin), calibration, &m_lastFrameZones);
+        const CD3DX12_RANGE writeRange(0, 0);
+        m_readbackBuffer->Unmap(0, &writeRange);
+
+        for (const TimingZone& zone : m_lastFrameZones)
+        {
+            ZoneStatistics& statistics = m_statistics[zone.name];
+            const double duration = zone.end - zone.start;
+            statistics.total += duration;
+            statistics.max = max(statistics.max, duration);
+            statistics.count++;
+            statistics.gpu = zone.gpu;
+        }
+        m_readBackFrameCount++;
+    }
+}
+
+void GpuTimer::ResetStatistics()
+{
+    m_statistics.clear();
+    m_readBackFrameCount = 0;
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include "FramePacing.h"
+#include "HeapAllocator.h"
+#include <deque>
+#include <map>
+#include <vector>
+
+// A span of CPU or GPU work, in milliseconds on the PacingClock timeline.
+struct TimingZone
+{
+    char name[32];
+    double start;
+    double end;
+    bool gpu;
+};
+
+// The same instant on both clocks, from ID3D12CommandQueue::GetClockCalibration.
+struct TimestampCalibration
+{
+    UINT64 frequency;           // GPU ticks per second.
+    UINT64 gpuTimestamp;
+    double cpuTime;
+};
+
+// Query bookkeeping for GPU timestamps, without a device. Every frame gets its own
+// slice of a query heap, in a ring of frameCount slices; zone i of a frame uses the
+// slice's queries 2i and 2i + 1. A frame's results can be read back once the fence
+// value it was tagged with in FinishFrame has been reached by the GPU.
+class TimestampQueryRing
+{
+public:
+    static const UINT InvalidZone = ~0u;
+
+    TimestampQueryRing();
+
+    void Reset(UINT frameCount, UINT maxZoneCount);
+
+    // Starts a frame in the next slice. If that slice's results were never read back
+    // they are dropped.
+    void BeginFrame();
+
+    // Can be called from any thread. Returns InvalidZone when the frame's slice is full.
+    UINT AllocateZone(const char* name);
+    UINT GetBeginQuery(UINT zone) const { return 2 * (m_currentSlot * m_maxZoneCount + zone); }
+    UINT GetEndQuery(UINT zone) const { return GetBeginQuery(zone) + 1; }
+
+    // start and end are already on the CPU timeline. Main thread only.
+    void AddCpuZone(const char* name, double start, double end);
+
+    // The queries the current frame wrote, to resolve at the end of its last command list.
+    UINT GetFirstQuery() const { return 2 * m_currentSlot * m_maxZoneCount; }
+    UINT GetQueryCount() const;
+
+    void FinishFrame(UINT64 fenceValue);
+
+    // Returns false if no finished frame has reached completedFenceValue. pFirstQuery
+    // is where the frame's timestamps start in the resolved data.
+    bool GetCompletedFrame(UINT64 completedFenceValue, UINT* pFirstQuery) const;
+
+    // Converts the oldest completed frame's timestamps, starting at its first query,
+    // and appends its zones, CPU and GPU, in start order. The frame's slice is free
+    // again afterwards.
+    void ResolveFrame(const UINT64* pTimestamps, const TimestampCalibration& calibration, std::vector<TimingZone>* pZones);
+
+    UINT GetFrameCount() const { return static_cast<UINT>(m_slots.size()); }
+    UINT GetMaxZoneCount() const { return m_maxZoneCount; }
+    UINT GetTotalQueryCount() const { return 2 * GetFrameCount() * m_maxZoneCount; }
+    UINT64 GetDroppedFrameCount() const { return m_droppedFrameCount; }
+    UINT64 GetOverflowZoneCount() const { return m_overflowZoneCount; }
+
+private:
+    struct Slot
+    {
+        std::vector<TimingZone> gpuZones;   // Only the names are set until ResolveFrame.
+        volatile LONG zoneCount;
+        std::vector<TimingZone> cpuZones;
+        UINT64 fenceValue;
+    };
+
+    std::vector<Slot> m_slots;
+    std::deque<UINT> m_pendingSlots;        // Finished and not yet read back, oldest first.
+    UINT m_maxZoneCount;
+    UINT m_currentSlot;
+    UINT64 m_droppedFrameCount;
+    volatile LONG64 m_overflowZoneCount;
+};
+
+// Times command list work with timestamp queries, on one command queue. Zones can be
+// recorded on any list of the frame; EndFrame resolves them into a readback buffer
+// at the end of the frame's last list, and ReadBack picks up every frame the GPU has
+// finished and places its zones on the CPU timeline, next to the CPU zones.
+class GpuTimer
+{
+public:
+    struct ZoneStatistics
+    {
+        double total;
+        double max;
+        UINT count;
+        bool gpu;
+    };
+
+    GpuTimer();
+    ~GpuTimer();
+
+    void Create(ID3D12Device* pDevice, ID3D12CommandQueue* pCommandQueue, HeapSuballocator* pHeapAllocator, UINT frameCount, UINT maxZoneCount);
+    void Release();
+
+    void BeginFrame() { m_ring.BeginFrame(); }
+
+    // Returns the zone to pass to EndZone, or InvalidZone when the frame has no more room.
+    UINT BeginZone(ID3D12GraphicsCommandList* pCommandList, const char* name);
+    void EndZone(ID3D12GraphicsCommandList* pCommandList, UINT zone);
+    void AddCpuZone(const char* name, double start, double end) { m_ring.AddCpuZone(name, start, end); }
+
+    // Must be recorded on the list that executes last.
+    void EndFrame(ID3D12GraphicsCommandList* pCommandList);
+    void FinishFrame(UINT64 fenceValue) { m_ring.FinishFrame(fenceValue); }
+
+    void ReadBack(UINT64 completedFenceValue, const PacingClock& clock);
+
+    // The zones of the most recently read back frame, in start order.
+    const std::vector<TimingZone>& GetLastFrameZones() const { return m_lastFrameZones; }
+    const std::map<std::string, ZoneStatistics>& GetStatistics() const { return m_statistics; }
+    UINT GetReadBackFrameCount() const { return m_readBackFrameCount; }
+    UINT64 GetDroppedFrameCount() const { return m_ring.GetDroppedFrameCount(); }
+    void ResetStatistics();
+
+private:
+    ComPtr<ID3D12CommandQueue> m_commandQueue;
+    HeapSuballocator* m_pHeapAllocator;
+    ComPtr<ID3D12QueryHeap> m_queryHeap;
+    ComPtr<ID3D12Resource> m_readbackBuffer;
+    HeapAllocation m_readbackBufferAllocation;
+    UINT64 m_frequency;
+    TimestampQueryRing m_ring;
+
+    std::vector<TimingZone> m_lastFrameZones;
+    std::map<std::string, ZoneStatistics> m_statistics;
+    UINT m_readBackFrameCount;
+};
+
+// Times the commands recorded on pCommandList during its scope.
+class GpuZone
+{
+public:
+    GpuZone(GpuTimer* pTimer, ID3D12GraphicsCommandList* pCommandList, const char* name) :
+        m_pTimer(pTimer),
+        m_pCommandList(pCommandList),
+        m_zone(pTimer->BeginZone(pCommandList, name))
+    {
+    }
+    ~GpuZone() { m_pTimer->EndZone(m_pCommandList, m_zone); }
+
+private:
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+    GpuTimer* m_pTimer;
+    ID3D12GraphicsCommandList* m_pCommandList;
+    UINT m_zone;
+};
@@ -0,0 +1,1192 @@
+#include "stdafx.h"
+#include "HeadlessTests.h"
+#include "ComputeScheduler.h"
+#include "GpuTimer.h"
+#include "IndirectDraw.h"
+#include "MeshImport.h"
+#include "OcclusionCulling.h"
+#include "PipelineStateCache.h"
+#include "RenderGraph.h"
+#include "ShaderPrograms.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    bool Fail(std::string* pError, const std::string& what)
+    {
+        *pError = what;
+        return false;
+    }
+
+    // A scene-like PSO whose bytecode and input layout live in the test's own buffers.
+    struct TestPipelineDesc
+    {
+        std::vector<UINT8> vertexShader;
+        std::vector<UINT8> pixelShader;
+        std::string semanticName;
+        D3D12_INPUT_ELEMENT_DESC inputElement;
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+
+        TestPipelineDesc() :
+            vertexShader(64),
+            pixelShader(48),
+            semanticName("POSITION")
+        {
+            for (size_t i = 0; i < vertexShader.size(); i++)
+            {
+                vertexShader[i] = static_cast<UINT8>(i * 7);
+            }
+            for (size_t i = 0; i < pixelShader.size(); i++)
+            {
+                pixelShader[i] = static_cast<UINT8>(i * 13);
+            }
+            inputElement = { semanticName.c_str(), 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+
+            desc = {};
+            desc.InputLayout = { &inputElement, 1 };
+            desc.VS = { vertexShader.data(), vertexShader.size() };
+            desc.PS = { pixelShader.data(), pixelShader.size() };
+            desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+            desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+            desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+            desc.SampleMask = UINT_MAX;
+            desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+            desc.NumRenderTargets = 1;
+            desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+            desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+            desc.SampleDesc.Count = 1;
+        }
+
+        TestPipelineDesc(const TestPipelineDesc&) = delete;
+        TestPipelineDesc& operator=(const TestPipelineDesc&) = delete;
+    };
+
+    bool TestPipelineStateHashDesc(std::string* pError)
+    {
+        const UINT64 rootSignatureHash = 0x1234567890abcdefull;
+        TestPipelineDesc a;
+        TestPipelineDesc b;
+        const UINT64 key = PipelineStateCache::HashDesc(a.desc, rootSignatureHash);
+
+        // Equal contents at other addresses, as in another run, give the same key; so does
+        // a different root signature object created from the same blob.
+        b.desc.pRootSignature = reinterpret_cast<ID3D12RootSignature*>(&b);
+        if (PipelineStateCache::HashDesc(b.desc, rootSignatureHash) != key)
+        {
+            return Fail(pError, "The key depends on the addresses the desc points to");
+        }
+        if (PipelineStateCache::HashDesc(a.desc, rootSignatureHash) != key)
+        {
+            return Fail(pError, "Hashing the same desc twice gave different keys");
+        }
+
+        // Anything that changes the PSO changes the key.
+        if (PipelineStateCache::HashDesc(a.desc, rootSignatureHash + 1) == key)
+        {
+            return Fail(pError, "A different root signature didn't change the key");
+        }
+        b.vertexShader[10]++;
+        if (PipelineStateCache::HashDesc(b.desc, rootSignatureHash) == key)
+        {
+            return Fail(pError, "Different vertex shader bytecode didn't change the key");
+        }
+        b.vertexShader[10]--;
+        b.semanticName[0] = 'Q';
+        if (PipelineStateCache::HashDesc(b.desc, rootSignatureHash) == key)
+        {
+            return Fail(pError, "A different semantic name didn't change the key");
+        }
+        b.semanticName[0] = 'P';
+        b.desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+        if (PipelineStateCache::HashDesc(b.desc, rootSignatureHash) == key)
+        {
+            return Fail(pError, "The fill mode didn't change the key");
+        }
+        b.desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+        b.desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_GREATER_EQUAL;
+        if (PipelineStateCache::HashDesc(b.desc, rootSignatureHash) == key)
+        {
+            return Fail(pError, "The depth function didn't change the key");
+        }
+        b.desc.DepthStencilState.DepthFunc = a.desc.DepthStencilState.DepthFunc;
+        b.desc.RTVFormats[0] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        if (PipelineStateCache::HashDesc(b.desc, rootSignatureHash) == key)
+        {
+            return Fail(pError, "The render target format didn't change the key");
+        }
+
+        // Formats past NumRenderTargets aren't part of the PSO.
+        b.desc.RTVFormats[0] = a.desc.RTVFormats[0];
+        b.desc.RTVFormats[3] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        if (PipelineStateCache::HashDesc(b.desc, rootSignatureHash) != key)
+        {
+            return Fail(pError, "An unused render target format changed the key");
+        }
+        return true;
+    }
+
+    bool TestPipelineStateDedup(std::string* pError)
+    {
+        // The stub succeeds without a PSO, which the cache stores like any other.
+        std::atomic<UINT> createCount(0);
+        PipelineStateCache cache;
+        cache.Create(nullptr, L"", 2, [&createCount](const D3D12_GRAPHICS_PIPELINE_STATE_DESC&, ComPtr<ID3D12PipelineState>&)
+        {
+            createCount++;
+            Sleep(1);
+            return S_OK;
+        });
+
+        TestPipelineDesc a;
+        TestPipelineDesc b;
+        TestPipelineDesc wireframe;
+        wireframe.desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+
+        // Racing requests for one desc, from several threads and through both entry
+        // points, create it once.
+        std::vector<std::thread> threads;
+        std::atomic<UINT> mismatchCount(0);
+        const UINT64 key = cache.GetKey(a.desc);
+        for (UINT i = 0; i < 8; i++)
+        {
+            threads.emplace_back([&, i]
+            {
+                const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc = (i % 2) ? a.desc : b.desc;
+                if (i % 3 == 0)
+                {
+                    cache.GetPipelineState(desc);
+                    mismatchCount += cache.IsPipelineStateReady(key) ? 0 : 1;
+                }
+                else
+                {
+                    mismatchCount += cache.RequestPipelineState(desc) == key ? 0 : 1;
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        const UINT64 wireframeKey = cache.RequestPipelineState(wireframe.desc);
+        while (cache.GetPendingCount() > 0)
+        {
+            Sleep(1);
+        }
+
+        if (mismatchCount != 0)
+        {
+            return Fail(pError, "Equal descs got different keys, or GetPipelineState returned before the PSO was ready");
+        }
+        if (wireframeKey == key)
+        {
+            return Fail(pError, "A wireframe variant got the solid PSO's key");
+        }
+        if (createCount != 2)
+        {
+            return Fail(pError, "Two distinct descs weren't created exactly once each");
+        }
+        if (!cache.IsPipelineStateReady(key) || !cache.IsPipelineStateReady(wireframeKey))
+        {
+            return Fail(pError, "A PSO isn't ready after every request finished");
+        }
+
+        // Once evicted, the next request creates it again.
+        cache.EvictPipelineState(key);
+        cache.GetPipelineState(a.desc);
+        if (createCount != 3)
+        {
+            return Fail(pError, "An evicted PSO wasn't created again");
+        }
+        return true;
+    }
+
+    bool TestPipelineStateCreateFailure(std::string* pError)
+    {
+        PipelineStateCache cache;
+        cache.Create(nullptr, L"", 1, [](const D3D12_GRAPHICS_PIPELINE_STATE_DESC&, ComPtr<ID3D12PipelineState>&)
+        {
+            Sleep(1);
+            return E_INVALIDARG;
+        });
+
+        TestPipelineDesc a;
+        TestPipelineDesc wireframe;
+        wireframe.desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+
+        // A second thread waits on the request the first is creating; both must return.
+        std::atomic<UINT> throwCount(0);
+        std::atomic<UINT> returnCount(0);
+        std::vector<std::thread> threads;
+        for (UINT i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&]
+            {
+                try
+                {
+                    returnCount += cache.GetPipelineState(a.desc) == nullptr ? 1 : 0;
+                }
+                catch (HrException&)
+                {
+                    throwCount++;
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        if (throwCount != 1 || returnCount != 3)
+        {
+            return Fail(pError, "The creating thread didn't throw once with the waiters getting nullptr");
+        }
+        if (cache.GetPendingCount() != 0 || !cache.IsPipelineStateReady(cache.GetKey(a.desc)))
+        {
+            return Fail(pError, "A failed creation was left pending");
+        }
+
+        // On a worker the failure is swallowed and the fallback stays in use.
+        const UINT64 wireframeKey = cache.RequestPipelineState(wireframe.desc);
+        while (cache.GetPendingCount() > 0)
+        {
+            Sleep(1);
+        }
+        ID3D12PipelineState* pFallback = reinterpret_cast<ID3D12PipelineState*>(&wireframe);
+        if (!cache.IsPipelineStateReady(wireframeKey) || cache.FindPipelineState(wireframeKey, pFallback) != pFallback)
+        {
+            return Fail(pError, "A failed background creation didn't leave the fallback in place");
+        }
+        return true;
+    }
+
+    const UINT64 MiB = 1024 * 1024;
+
+    RenderGraphResource CreateTestTarget(RenderGraph& graph, const char* name, UINT64 size)
+    {
+        const D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 512, 512, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+        const D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = { size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT };
+        return graph.CreateTransientResource(name, desc, nullptr, allocationInfo);
+    }
+
+    // The only barrier of that type on the resource, or nullptr if there isn't exactly one.
+    const RenderGraph::Barrier* FindBarrier(const std::vector<RenderGraph::Barrier>& barriers, RenderGraphResource resource, D3D12_RESOURCE_BARRIER_TYPE type)
+    {
+        const RenderGraph::Barrier* pFound = nullptr;
+        for (const RenderGraph::Barrier& barrier : barriers)
+        {
+            if (barrier.resource == resource && barrier.type == type)
+            {
+                if (pFound != nullptr)
+                {
+                    return nullptr;
+                }
+                pFound = &barrier;
+            }
+        }
+        return pFound;
+    }
+
+    bool TestRenderGraphCulling(std::string* pError)
+    {
+        RenderGraph graph;
+        const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", nullptr, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+        const RenderGraphResource shadowMap = CreateTestTarget(graph, "ShadowMap", MiB);
+        const RenderGraphResource unusedTarget = CreateTestTarget(graph, "Unused", MiB);
+        const RenderGraphResource orphanTarget = CreateTestTarget(graph, "Orphan", MiB);
+        const RenderGraphResource chainTarget = CreateTestTarget(graph, "Chain", MiB);
+        const RenderGraphResource chainEnd = CreateTestTarget(graph, "ChainEnd", MiB);
+        const RenderGraphResource debugTarget = CreateTestTarget(graph, "Debug", MiB);
+
+        const UINT shadow = graph.AddPass("Shadow", nullptr);
+        graph.WriteResource(shadow, shadowMap, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT unused = graph.AddPass("Unused", nullptr);
+        graph.ReadResource(unused, shadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(unused, unusedTarget, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT lighting = graph.AddPass("Lighting", nullptr);
+        graph.ReadResource(lighting, shadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(lighting, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT orphan = graph.AddPass("Orphan", nullptr);
+        graph.WriteResource(orphan, orphanTarget, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+        // Culling Chain's reader leaves nothing reading Chain, so its writer goes too.
+        const UINT chainStart = graph.AddPass("ChainStart", nullptr);
+        graph.WriteResource(chainStart, chainTarget, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT chainReader = graph.AddPass("ChainReader", nullptr);
+        graph.ReadResource(chainReader, chainTarget, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(chainReader, chainEnd, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+        const UINT debug = graph.AddPass("Debug", nullptr);
+        graph.WriteResource(debug, debugTarget, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        graph.SetSideEffect(debug);
+        graph.Compile();
+
+        if (graph.IsPassCulled(shadow) || graph.IsPassCulled(lighting))
+        {
+            return Fail(pError, "A pass contributing to an imported resource was culled");
+        }
+        if (!graph.IsPassCulled(unused) || !graph.IsPassCulled(orphan))
+        {
+            return Fail(pError, "A pass whose output nobody reads survived");
+        }
+        if (!graph.IsPassCulled(chainStart) || !graph.IsPassCulled(chainReader))
+        {
+            return Fail(pError, "Culling didn't propagate to the writer of a culled pass's input");
+        }
+        if (graph.IsPassCulled(debug))
+        {
+            return Fail(pError, "A pass with side effects was culled");
+        }
+
+        // Only resources a live pass touches are placed.
+        const RenderGraph::Statistics& statistics = graph.GetStatistics();
+        if (statistics.passCount != 7 || statistics.culledPassCount != 4 || statistics.transientResourceCount != 2)
+        {
+            return Fail(pError, "The statistics don't match the culled graph");
+        }
+        return true;
+    }
+
+    // GBuffer and Shadow render to targets that Lighting samples and Compute reads again.
+    // Shadow is recorded on the other passes' list only when sameList is set.
+    bool CheckRenderGraphBarriers(bool sameList, std::string* pError)
+    {
+        int listA = 0;
+        int listB = 0;
+        ID3D12GraphicsCommandList* pListA = reinterpret_cast<ID3D12GraphicsCommandList*>(&listA);
+        ID3D12GraphicsCommandList* pListB = reinterpret_cast<ID3D12GraphicsCommandList*>(sameList ? &listA : &listB);
+
+        RenderGraph graph;
+        const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", nullptr, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+        const RenderGraphResource output = graph.ImportResource("Output", nullptr, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        const RenderGraphResource gbuffer = CreateTestTarget(graph, "GBuffer", MiB);
+        const RenderGraphResource shadowMap = CreateTestTarget(graph, "ShadowMap", MiB);
+
+        const UINT gbufferPass = graph.AddPass("GBuffer", pListA);
+        graph.WriteResource(gbufferPass, gbuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT shadowPass = graph.AddPass("Shadow", pListB);
+        graph.WriteResource(shadowPass, shadowMap, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT lightingPass = graph.AddPass("Lighting", pListA);
+        graph.ReadResource(lightingPass, gbuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.ReadResource(lightingPass, shadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(lightingPass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT computePass = graph.AddPass("Compute", pListA);
+        graph.ReadResource(computePass, gbuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(computePass, output, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        graph.Compile();
+
+        // Lighting moves GBuffer into both read states at once, so Compute needs nothing.
+        const D3D12_RESOURCE_STATES readStates = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+        const RenderGraph::Barrier* pGBufferRead = FindBarrier(graph.GetPassBarriers(lightingPass), gbuffer, D3D12_RESOURCE_BARRIER_TYPE_TRANSITION);
+        if (pGBufferRead == nullptr || pGBufferRead->before != D3D12_RESOURCE_STATE_RENDER_TARGET || pGBufferRead->after != readStates)
+        {
+            return Fail(pError, "The GBuffer wasn't moved into every state its readers need in one transition");
+        }
+        if (FindBarrier(graph.GetPassBarriers(computePass), gbuffer, D3D12_RESOURCE_BARRIER_TYPE_TRANSITION) != nullptr)
+        {
+            return Fail(pError, "A read already covered by the current state got a barrier");
+        }
+
+        // Shadow runs between the GBuffer's write and its read; on the same list, the
+        // transition starts there.
+        const RenderGraph::Barrier* pGBufferBegin = FindBarrier(graph.GetPassBarriers(shadowPass), gbuffer, D3D12_RESOURCE_BARRIER_TYPE_TRANSITION);
+        if (sameList)
+        {
+            if (pGBufferBegin == nullptr || pGBufferBegin->flags != D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY || pGBufferRead->flags != D3D12_RESOURCE_BARRIER_FLAG_END_ONLY ||
+                pGBufferBegin->after != readStates)
+            {
+                return Fail(pError, "The GBuffer transition wasn't split across Shadow and Lighting");
+            }
+        }
+        else if (pGBufferBegin != nullptr || pGBufferRead->flags != D3D12_RESOURCE_BARRIER_FLAG_NONE)
+        {
+            return Fail(pError, "A transition was split across command lists");
+        }
+
+        // The shadow map is read by the very next pass, which leaves no room to split.
+        const RenderGraph::Barrier* pShadowRead = FindBarrier(graph.GetPassBarriers(lightingPass), shadowMap, D3D12_RESOURCE_BARRIER_TYPE_TRANSITION);
+        if (pShadowRead == nullptr || pShadowRead->flags != D3D12_RESOURCE_BARRIER_FLAG_NONE || pShadowRead->after != D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE)
+        {
+            return Fail(pError, "The shadow map's transition is wrong");
+        }
+
+        // Transients start from whatever state last frame left them in.
+        const RenderGraph::Barrier* pGBufferFirst = FindBarrier(graph.GetPassBarriers(gbufferPass), gbuffer, D3D12_RESOURCE_BARRIER_TYPE_TRANSITION);
+        if (pGBufferFirst == nullptr || !pGBufferFirst->fromPhysicalState || pGBufferFirst->after != D3D12_RESOURCE_STATE_RENDER_TARGET)
+        {
+            return Fail(pError, "A transient's first use doesn't transition from its placed state");
+        }
+
+        // Imported resources go back to their final state after the last pass, unless
+        // they are already in it.
+        const RenderGraph::Barrier* pPresent = FindBarrier(graph.GetFinalBarriers(), backBuffer, D3D12_RESOURCE_BARRIER_TYPE_TRANSITION);
+        if (pPresent == nullptr || pPresent->before != D3D12_RESOURCE_STATE_RENDER_TARGET || pPresent->after != D3D12_RESOURCE_STATE_PRESENT ||
+            graph.GetFinalBarriers().size() != 1)
+        {
+            return Fail(pError, "The final barriers don't return exactly the back buffer to PRESENT");
+        }
+
+        // One batch per pass with barriers, plus the final one.
+        const RenderGraph::Statistics& statistics = graph.GetStatistics();
+        const UINT splitCount = sameList ? 1 : 0;
+        if (statistics.barrierCount != 7 + splitCount || statistics.barrierBatchCount != 5 || statistics.splitBarrierCount != splitCount ||
+            statistics.aliasingBarrierCount != 0)
+        {
+            return Fail(pError, "The barrier statistics are wrong");
+        }
+        return true;
+    }
+
+    bool TestRenderGraphBarriers(std::string* pError)
+    {
+        return CheckRenderGraphBarriers(true, pError) && CheckRenderGraphBarriers(false, pError);
+    }
+
+    bool TestRenderGraphAliasing(std::string* pError)
+    {
+        RenderGraph graph;
+        const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", nullptr, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+        const RenderGraphResource scene = CreateTestTarget(graph, "Scene", 4 * MiB);
+        const RenderGraphResource blurred = CreateTestTarget(graph, "Blurred", 2 * MiB);
+        const RenderGraphResource bloom = CreateTestTarget(graph, "Bloom", 2 * MiB);
+        const D3D12_RESOURCE_ALLOCATION_INFO histogramInfo = { MiB, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT };
+        const RenderGraphResource histogram = graph.CreateTransientResource("Histogram", CD3DX12_RESOURCE_DESC::Buffer(MiB, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), nullptr, histogramInfo);
+
+        // Lifetimes: Scene 0-1, Bloom 1-2, Blurred 2-3, Histogram 1.
+        const UINT scenePass = graph.AddPass("Scene", nullptr);
+        graph.WriteResource(scenePass, scene, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT bloomPass = graph.AddPass("Bloom", nullptr);
+        graph.ReadResource(bloomPass, scene, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(bloomPass, bloom, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        graph.WriteResource(bloomPass, histogram, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        const UINT blurPass = graph.AddPass("Blur", nullptr);
+        graph.ReadResource(blurPass, bloom, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(blurPass, blurred, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        const UINT compositePass = graph.AddPass("Composite", nullptr);
+        graph.ReadResource(compositePass, blurred, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.WriteResource(compositePass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        graph.Compile();
+
+        // Largest first: Scene at 0, Blurred reuses it once Scene is dead, and Bloom, which
+        // overlaps both, goes after Scene. The buffer has a pool of its own.
+        if (graph.GetTransientOffset(scene) != 0 || graph.GetTransientOffset(blurred) != 0 ||
+            graph.GetTransientOffset(bloom) != 4 * MiB || graph.GetTransientOffset(histogram) != 0)
+        {
+            return Fail(pError, "The transients weren't placed at the expected offsets");
+        }
+        const RenderGraph::Statistics& statistics = graph.GetStatistics();
+        if (statistics.transientResourceCount != 4 || statistics.transientHeapSize != 7 * MiB || statistics.transientUnaliasedSize != 9 * MiB)
+        {
+            return Fail(pError, "The transient heap sizes are wrong");
+        }
+
+        // Scene and Blurred share memory, so each needs an aliasing barrier before its
+        // first transition; Bloom and the histogram don't.
+        const UINT firstPasses[] = { scenePass, blurPass };
+        const RenderGraphResource aliased[] = { scene, blurred };
+        for (UINT i = 0; i < _countof(aliased); i++)
+        {
+            const std::vector<RenderGraph::Barrier>& barriers = graph.GetPassBarriers(firstPasses[i]);
+            const RenderGraph::Barrier* pAliasing = FindBarrier(barriers, aliased[i], D3D12_RESOURCE_BARRIER_TYPE_ALIASING);
+            const RenderGraph::Barrier* pTransition = FindBarrier(barriers, aliased[i], D3D12_RESOURCE_BARRIER_TYPE_TRANSITION);
+            if (pAliasing == nullptr || pTransition == nullptr || pAliasing > pTransition)
+            {
+                return Fail(pError, "An aliased transient's first use has no aliasing barrier ahead of its transition");
+            }
+        }
+        if (FindBarrier(graph.GetPassBarriers(bloomPass), bloom, D3D12_RESOURCE_BARRIER_TYPE_ALIASING) != nullptr ||
+            statistics.aliasingBarrierCount != 2)
+        {
+            return Fail(pError, "A transient that shares no memory got an aliasing barrier");
+        }
+        return true;
+    }
+
+    // One frame of the sample's loop, durations in milliseconds.
+    struct SimulatedFrame
+    {
+        bool transformsOnGpu;
+        bool drawsOnGpu;
+        double cpu;             // From the frame resource wait to the last submission.
+        double compute;
+        double pre;             // CommandListPre.
+        double scene;           // The workers' lists and CommandListPost.
+    };
+
+    // Fence values of a frame's submissions; compute is 0 when the frame had none.
+    struct SimulatedFrameFences
+    {
+        UINT64 compute;
+        UINT64 pre;
+        UINT64 scene;
+    };
+
+    // Submits frames as OnUpdate and OnRender do: wait on the CPU until the direct queue
+    // has finished the frame resource's last frame, submit the compute work a quarter of
+    // the way into the frame's CPU time, CommandListPre half way, waiting on the compute
+    // queue in GPU-driven mode, and the scene lists at the end, waiting on it when the
+    // transforms are on the GPU. withWaits false leaves the GPU waits out.
+    void SimulateFrameLoop(const std::vector<SimulatedFrame>& frames, bool withWaits, QueueTimelineSimulator* pSimulator, UINT directQueue, UINT computeQueue, std::vector<SimulatedFrameFences>* pFences)
+    {
+        double cpuTime = 0.0;
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            const SimulatedFrame& frame = frames[i];
+            if (i >= FrameCount)
+            {
+                cpuTime = max(cpuTime, pSimulator->GetCompletionTime(directQueue, (*pFences)[i - FrameCount].scene));
+            }
+
+            SimulatedFrameFences fences = {};
+            std::vector<QueueTimelineSimulator::QueueWait> preWaits;
+            std::vector<QueueTimelineSimulator::QueueWait> sceneWaits;
+            if (frame.transformsOnGpu || frame.drawsOnGpu)
+            {
+                fences.compute = pSimulator->Submit(computeQueue, cpuTime + 0.25 * frame.cpu, frame.compute);
+                const QueueTimelineSimulator::QueueWait wait = { computeQueue, fences.compute };
+                if (withWaits && frame.drawsOnGpu)
+                {
+                    preWaits.push_back(wait);
+                }
+                if (withWaits && frame.transformsOnGpu)
+                {
+                    sceneWaits.push_back(wait);
+                }
+            }
+            fences.pre = pSimulator->Submit(directQueue, cpuTime + 0.5 * frame.cpu, frame.pre, preWaits);
+            fences.scene = pSimulator->Submit(directQueue, cpuTime + frame.cpu, frame.scene, sceneWaits);
+            pFences->push_back(fences);
+            cpuTime += frame.cpu;
+        }
+    }
+
+    const QueueTimelineSimulator::Submission& GetSubmission(const QueueTimelineSimulator& simulator, UINT queue, UINT64 fenceValue)
+    {
+        for (const QueueTimelineSimulator::Submission& submission : simulator.GetSubmissions())
+        {
+            if (submission.queue == queue && submission.fenceValue == fenceValue)
+            {
+                return submission;
+            }
+        }
+        assert(false);
+        return simulator.GetSubmissions().front();
+    }
+
+    // Fails on work that overlaps work it must not: two submissions on one queue, a
+    // list that reads the compute queue's output before it is written, or compute work
+    // writing a frame resource's buffers while its last frame still reads them.
+    bool CheckFrameLoopTimeline(const QueueTimelineSimulator& simulator, UINT directQueue, UINT computeQueue, const std::vector<SimulatedFrame>& frames, const std::vector<SimulatedFrameFences>& fences, std::string* pError)
+    {
+        const UINT queues[] = { directQueue, computeQueue };
+        for (UINT queue : queues)
+        {
+            double idleTime = 0.0;
+            for (const QueueTimelineSimulator::Submission& submission : simulator.GetSubmissions())
+            {
+                if (submission.queue != queue)
+                {
+                    continue;
+                }
+                if (submission.startTime < idleTime || submission.startTime < submission.submitTime)
+                {
+                    return Fail(pError, "Work on one queue overlaps, or starts before it is submitted");
+                }
+                idleTime = submission.endTime;
+            }
+        }
+
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            if (fences[i].compute == 0)
+            {
+                continue;
+            }
+            const QueueTimelineSimulator::Submission& compute = GetSubmission(simulator, computeQueue, fences[i].compute);
+            if ((frames[i].drawsOnGpu && GetSubmission(simulator, directQueue, fences[i].pre).startTime < compute.endTime) ||
+                (frames[i].transformsOnGpu && GetSubmission(simulator, directQueue, fences[i].scene).startTime < compute.endTime))
+            {
+                return Fail(pError, "Frame " + std::to_string(i) + " reads the compute queue's output before it is written");
+            }
+            if (i >= FrameCount && compute.startTime < GetSubmission(simulator, directQueue, fences[i - FrameCount].scene).endTime)
+            {
+                return Fail(pError, "Frame " + std::to_string(i) + "'s compute work overwrites buffers the direct queue is still reading");
+            }
+        }
+        return true;
+    }
+
+    // Frames cycling through the four combinations of transforms and draws on the CPU
+    // or the GPU, with some jitter on the durations.
+    std::vector<SimulatedFrame> MakeSimulatedFrames(double cpu, double compute, double scene)
+    {
+        std::vector<SimulatedFrame> frames;
+        for (UINT i = 0; i < 24; i++)
+        {
+            SimulatedFrame frame = {};
+            frame.transformsOnGpu = (i & 1) != 0;
+            frame.drawsOnGpu = (i & 2) != 0;
+            frame.cpu = cpu + 0.5 * (i % 3);
+            frame.compute = compute + 0.25 * (i % 5);
+            frame.pre = 0.25;
+            frame.scene = scene + 0.5 * (i % 4);
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    bool TestQueueTimelineFrameLoop(std::string* pError)
+    {
+        // GPU-bound, so the CPU waits for frame resources, and CPU-bound, so the direct
+        // queue is idle when a frame's lists arrive and only the waits hold them back.
+        const std::vector<SimulatedFrame> workloads[] =
+        {
+            MakeSimulatedFrames(2.0, 0.5, 6.0),
+            MakeSimulatedFrames(8.0, 3.0, 2.0),
+        };
+        for (UINT workload = 0; workload < _countof(workloads); workload++)
+        {
+            const std::vector<SimulatedFrame>& frames = workloads[workload];
+            QueueTimelineSimulator simulator;
+            const UINT directQueue = simulator.AddQueue();
+            const UINT computeQueue = simulator.AddQueue();
+            std::vector<SimulatedFrameFences> fences;
+            SimulateFrameLoop(frames, true, &simulator, directQueue, computeQueue, &fences);
+            if (!CheckFrameLoopTimeline(simulator, directQueue, computeQueue, frames, fences, pError))
+            {
+                return false;
+            }
+
+            // GPU-bound, the compute work is submitted while the direct queue is still on
+            // earlier frames, so most of it hides under their graphics work.
+            if (workload == 0 && simulator.GetOverlapTime(directQueue, computeQueue) < 0.5 * simulator.GetBusyTime(computeQueue))
+            {
+                return Fail(pError, "The compute queue's work doesn't overlap the direct queue's");
+            }
+
+            // CPU-bound, without the waits the direct queue reads the compute queue's
+            // output before it is written; the check has to see that.
+            if (workload == 1)
+            {
+                QueueTimelineSimulator unordered;
+                unordered.AddQueue();
+                unordered.AddQueue();
+                std::vector<SimulatedFrameFences> unorderedFences;
+                SimulateFrameLoop(frames, false, &unordered, directQueue, computeQueue, &unorderedFences);
+                std::string unorderedError;
+                if (CheckFrameLoopTimeline(unordered, directQueue, computeQueue, frames, unorderedFences, &unorderedError))
+                {
+                    return Fail(pError, "The frame loop without its cross-queue waits passed the check");
+                }
+            }
+        }
+        return true;
+    }
+
+    bool TestWorkloadSchedulerRecordGpuTime(std::string* pError)
+    {
+        const UINT itemCount = 100000;
+        WorkloadScheduler scheduler;
+        const UINT breakEven = scheduler.GetBreakEvenItemCount();
+
+        // A GPU ten times slower per item than the default has to push the break even up,
+        // and repeated measurements have to converge on it.
+        for (UINT i = 0; i < 200; i++)
+        {
+            scheduler.RecordGpuTime(itemCount, itemCount * 0.02);
+        }
+        if (scheduler.GetBreakEvenItemCount() <= breakEven || fabs(scheduler.GetGpuItemCost() - 0.02) > 0.0001)
+        {
+            return Fail(pError, "Measured GPU times don't move the break even point");
+        }
+        return true;
+    }
+
+    // Fake timestamps at 1 MHz, one tick a microsecond, calibrated so that GPU tick
+    // 5000000 is CPU time 100 ms.
+    const TimestampCalibration TestCalibration = { 1000000, 5000000, 100.0 };
+
+    bool CheckZone(const TimingZone& zone, const char* name, bool gpu, double start, double end, std::string* pError)
+    {
+        if (strcmp(zone.name, name) != 0 || zone.gpu != gpu || fabs(zone.start - start) > 1e-9 || fabs(zone.end - end) > 1e-9)
+        {
+            char message[256];
+            sprintf_s(message, "Expected %s zone %s at %g-%g ms, got %s zone %s at %g-%g ms",
+                gpu ? "GPU" : "CPU", name, start, end, zone.gpu ? "GPU" : "CPU", zone.name, zone.start, zone.end);
+            return Fail(pError, message);
+        }
+        return true;
+    }
+
+    bool TestTimestampQueryRingReadBack(std::string* pError)
+    {
+        TimestampQueryRing ring;
+        ring.Reset(3, 2);
+        std::vector<UINT64> timestamps(ring.GetTotalQueryCount());
+
+        // Frame 1, in the first slice: a zone after the calibration point, one from
+        // before it, and a CPU zone between them.
+        ring.BeginFrame();
+        if (ring.GetFirstQuery() != 0 || ring.AllocateZone("After") != 0 || ring.AllocateZone("Before") != 1 || ring.GetQueryCount() != 4)
+        {
+            return Fail(pError, "The first frame's zones aren't at the start of the query heap");
+        }
+        ring.AddCpuZone("Cpu", 101.5, 102.5);
+        timestamps[ring.GetBeginQuery(0)] = 5002000;
+        timestamps[ring.GetEndQuery(0)] = 5003000;
+        timestamps[ring.GetBeginQuery(1)] = 4999000;
+        timestamps[ring.GetEndQuery(1)] = 5001000;
+        ring.FinishFrame(1);
+
+        // Frame 2, in the second slice.
+        ring.BeginFrame();
+        if (ring.GetFirstQuery() != 4 || ring.AllocateZone("Second") != 0 || ring.GetQueryCount() != 2)
+        {
+            return Fail(pError, "The second frame's zones aren't in the second slice");
+        }
+        timestamps[ring.GetBeginQuery(0)] = 5010000;
+        timestamps[ring.GetEndQuery(0)] = 5011000;
+        ring.FinishFrame(2);
+
+        UINT firstQuery = 0;
+        if (ring.GetCompletedFrame(0, &firstQuery))
+        {
+            return Fail(pError, "A frame was complete before the GPU reached its fence");
+        }
+        if (!ring.GetCompletedFrame(1, &firstQuery) || firstQuery != 0)
+        {
+            return Fail(pError, "The first frame isn't complete at its fence");
+        }
+        std::vector<TimingZone> zones;
+        ring.ResolveFrame(&timestamps[firstQuery], TestCalibration, &zones);
+        if (zones.size() != 3)
+        {
+            return Fail(pError, "The first frame resolved to " + std::to_string(zones.size()) + " zones, not 3");
+        }
+        if (!CheckZone(zones[0], "Before", true, 99.0, 101.0, pError) ||
+            !CheckZone(zones[1], "Cpu", false, 101.5, 102.5, pError) ||
+            !CheckZone(zones[2], "After", true, 102.0, 103.0, pError))
+        {
+            return false;
+        }
+
+        // The first frame is gone; the second is next once its fence is reached.
+        if (ring.GetCompletedFrame(1, &firstQuery))
+        {
+            return Fail(pError, "The first frame was read back twice");
+        }
+        if (!ring.GetCompletedFrame(2, &firstQuery) || firstQuery != 4)
+        {
+            return Fail(pError, "The second frame isn't complete at its fence");
+        }
+        zones.clear();
+        ring.ResolveFrame(&timestamps[firstQuery], TestCalibration, &zones);
+        if (zones.size() != 1)
+        {
+            return Fail(pError, "The second frame didn't resolve to its one zone");
+        }
+        if (!CheckZone(zones[0], "Second", true, 110.0, 111.0, pError))
+        {
+            return false;
+        }
+        if (ring.GetCompletedFrame(~0ull, &firstQuery) || ring.GetDroppedFrameCount() != 0 || ring.GetOverflowZoneCount() != 0)
+        {
+            return Fail(pError, "Frames were left over, dropped or overflowed");
+        }
+        return true;
+    }
+
+    bool TestTimestampQueryRingDroppedFrames(std::string* pError)
+    {
+        TimestampQueryRing ring;
+        ring.Reset(2, 1);
+        std::vector<UINT64> timestamps(ring.GetTotalQueryCount());
+
+        // Three frames through two slices without reading any back: the third takes the
+        // first's slice, and the first is dropped with its CPU zone.
+        const char* names[] = { "Frame1", "Frame2", "Frame3" };
+        for (UINT i = 0; i < _countof(names); i++)
+        {
+            ring.BeginFrame();
+            if (i == 0)
+            {
+                ring.AddCpuZone("Dropped", 0.0, 1.0);
+            }
+            const UINT zone = ring.AllocateZone(names[i]);
+            timestamps[ring.GetBeginQuery(zone)] = 5000000 + 1000 * i;
+            timestamps[ring.GetEndQuery(zone)] = 5000500 + 1000 * i;
+            ring.FinishFrame(i + 1);
+        }
+        if (ring.GetDroppedFrameCount() != 1)
+        {
+            return Fail(pError, std::to_string(ring.GetDroppedFrameCount()) + " frames dropped, not 1");
+        }
+
+        // The oldest left is the second frame, even once every fence has been reached.
+        UINT firstQuery = 0;
+        std::vector<TimingZone> zones;
+        if (!ring.GetCompletedFrame(3, &firstQuery) || firstQuery != 2)
+        {
+            return Fail(pError, "The second frame isn't the oldest complete one after the first was dropped");
+        }
+        ring.ResolveFrame(&timestamps[firstQuery], TestCalibration, &zones);
+        if (!ring.GetCompletedFrame(3, &firstQuery) || firstQuery != 0)
+        {
+            return Fail(pError, "The third frame isn't complete after the second");
+        }
+        ring.ResolveFrame(&timestamps[firstQuery], TestCalibration, &zones);
+        if (zones.size() != 2)
+        {
+            return Fail(pError, "The second and third frames didn't resolve to one zone each");
+        }
+        if (!CheckZone(zones[0], "Frame2", true, 101.0, 101.5, pError) ||
+            !CheckZone(zones[1], "Frame3", true, 102.0, 102.5, pError))
+        {
+            return false;
+        }
+        if (ring.GetCompletedFrame(3, &firstQuery))
+        {
+            return Fail(pError, "The dropped frame was still read back");
+        }
+
+        // Reading frames back in time keeps the next frames from being dropped.
+        for (UINT64 fenceValue = 4; fenceValue < 10; fenceValue++)
+        {
+            ring.BeginFrame();
+            ring.FinishFrame(fenceValue);
+            if (!ring.GetCompletedFrame(fenceValue, &firstQuery))
+            {
+                return Fail(pError, "A frame read back every frame wasn't complete");
+            }
+            ring.ResolveFrame(&timestamps[firstQuery], TestCalibration, &zones);
+        }
+        if (ring.GetDroppedFrameCount() != 1)
+        {
+            return Fail(pError, "Frames read back in time were dropped");
+        }
+        return true;
+    }
+
+    bool TestTimestampQueryRingOverflow(std::string* pError)
+    {
+        TimestampQueryRing ring;
+        ring.Reset(2, 2);
+        std::vector<UINT64> timestamps(ring.GetTotalQueryCount());
+
+        // A third zone doesn't fit in the slice: it gets no queries, and only the first
+        // two are resolved.
+        ring.BeginFrame();
+        const UINT first = ring.AllocateZone("First");
+        const UINT second = ring.AllocateZone("Second");
+        if (first != 0 || second != 1 || ring.AllocateZone("Third") != TimestampQueryRing::InvalidZone || ring.AllocateZone("Fourth") != TimestampQueryRing::InvalidZone)
+        {
+            return Fail(pError, "Zones beyond the slice's room were allocated");
+        }
+        if (ring.GetOverflowZoneCount() != 2 || ring.GetQueryCount() != 4)
+        {
+            return Fail(pError, "Overflowing zones weren't counted, or added queries to resolve");
+        }
+        timestamps[ring.GetBeginQuery(first)] = 5000000;
+        timestamps[ring.GetEndQuery(first)] = 5001000;
+        timestamps[ring.GetBeginQuery(second)] = 5001000;
+        timestamps[ring.GetEndQuery(second)] = 5002000;
+        ring.FinishFrame(1);
+
+        UINT firstQuery = 0;
+        std::vector<TimingZone> zones;
+        if (!ring.GetCompletedFrame(1, &firstQuery))
+        {
+            return Fail(pError, "The overflowing frame isn't complete at its fence");
+        }
+        ring.ResolveFrame(&timestamps[firstQuery], TestCalibration, &zones);
+        if (zones.size() != 2)
+        {
+            return Fail(pError, "The overflowing frame didn't resolve to the zones that fit");
+        }
+        if (!CheckZone(zones[0], "First", true, 100.0, 101.0, pError) ||
+            !CheckZone(zones[1], "Second", true, 101.0, 102.0, pError))
+        {
+            return false;
+        }
+
+        // The next frame starts with an empty slice again.
+        ring.BeginFrame();
+        if (ring.GetQueryCount() != 0 || ring.AllocateZone("Next") != 0 || ring.GetOverflowZoneCount() != 2)
+        {
+            return Fail(pError, "The frame after an overflow didn't start empty");
+        }
+        return true;
+    }
+
+    UINT CountOccludedPixels(const OcclusionBuffer& buffer)
+    {
+        return static_cast<UINT>(std::count_if(buffer.GetDepths(), buffer.GetDepths() + buffer.GetWidth() * buffer.GetHeight(), [](float depth)
+        {
+            return depth < 1.0f;
+        }));
+    }
+
+    bool TestOcclusionBufferConservative(std::string* pError)
+    {
+        // 16 x 16 pixels, 8 to a clip space unit.
+        OcclusionBuffer buffer;
+        buffer.Create(16, 16);
+        const UINT tileRowCount = buffer.GetTileRowCount();
+
+        // The upper left half of the buffer. Its diagonal, x + y = 16 in pixels, runs
+        // through the centres of pixels like (7, 8), which it only half covers; just the
+        // 120 pixels with x + y <= 14 are covered completely.
+        buffer.Clear(0, tileRowCount);
+        buffer.RasterizeTriangle(XMFLOAT2(-1.0f, 1.0f), XMFLOAT2(1.0f, 1.0f), XMFLOAT2(-1.0f, -1.0f), 0.5f, 0, tileRowCount);
+        if (buffer.GetDepths()[8 * 16 + 7] != 1.0f || CountOccludedPixels(buffer) != 120)
+        {
+            return Fail(pError, "The triangle wrote " + std::to_string(CountOccludedPixels(buffer)) + " pixels, not the 120 it covers completely");
+        }
+
+        // A quad over pixels 4 to 12 covers all 64 of them, its diagonal's too.
+        buffer.Clear(0, tileRowCount);
+        buffer.RasterizeQuad(XMMatrixIdentity(), 0.5f, 0.5f, 0, tileRowCount);
+        buffer.UpdateTiles(0, tileRowCount);
+        if (CountOccludedPixels(buffer) != 64)
+        {
+            return Fail(pError, "The quad wrote " + std::to_string(CountOccludedPixels(buffer)) + " pixels, not the 64 it covers");
+        }
+        if (buffer.IsRectVisible(XMFLOAT2(-0.5f, -0.5f), XMFLOAT2(0.5f, 0.5f), 0.75f) ||
+            !buffer.IsRectVisible(XMFLOAT2(-0.5f, -0.5f), XMFLOAT2(0.5625f, 0.5f), 0.75f))
+        {
+            return Fail(pError, "The quad doesn't hide exactly what is behind it");
+        }
+        return true;
+    }
+
+    // A .glb of one triangle, with a normal of (0, 0, 2) at every corner if withNormals.
+    std::vector<UINT8> MakeTriangleGlb(bool withNormals)
+    {
+        const float positions[9] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+        const float normals[9] = { 0.0f, 0.0f, 2.0f, 0.0f, 0.0f, 2.0f, 0.0f, 0.0f, 2.0f };
+        std::string json =
+            "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":72}],"
+            "\"bufferViews\":[{\"buffer\":0,\"byteLength\":36},{\"buffer\":0,\"byteOffset\":36,\"byteLength\":36}],"
+            "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+            "{\"bufferView\":1,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"}],"
+            "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0";
+        json += withNormals ? ",\"NORMAL\":1}}]}]}" : "}}]}]}";
+        json.resize((json.size() + 3) & ~static_cast<size_t>(3), ' ');
+
+        const UINT32 binarySize = sizeof(positions) + sizeof(normals);
+        const UINT32 header[5] = { 0x46546C67, 2, static_cast<UINT32>(20 + json.size() + 8 + binarySize), static_cast<UINT32>(json.size()), 0x4E4F534A };
+        const UINT32 binaryHeader[2] = { binarySize, 0x004E4942 };
+        std::vector<UINT8> glb(reinterpret_cast<const UINT8*>(header), reinterpret_cast<const UINT8*>(header) + sizeof(header));
+        glb.insert(glb.end(), json.begin(), json.end());
+        glb.insert(glb.end(), reinterpret_cast<const UINT8*>(binaryHeader), reinterpret_cast<const UINT8*>(binaryHeader) + sizeof(binaryHeader));
+        glb.insert(glb.end(), reinterpret_cast<const UINT8*>(positions), reinterpret_cast<const UINT8*>(positions) + sizeof(positions));
+        glb.insert(glb.end(), reinterpret_cast<const UINT8*>(normals), reinterpret_cast<const UINT8*>(normals) + sizeof(normals));
+        return glb;
+    }
+
+    bool IsNormal(const XMFLOAT3& normal, float x, float y, float z)
+    {
+        return fabsf(normal.x - x) < 1e-6f && fabsf(normal.y - y) < 1e-6f && fabsf(normal.z - z) < 1e-6f;
+    }
+
+    bool TestMeshImportNormals(std::string* pError)
+    {
+        // Two faces sharing positions 1 and 3 with different normals, and a third that
+        // repeats the first with relative indices. The normals are scaled and turn to
+        // the sample's axes.
+        const std::string obj =
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\n"
+            "vn 0 0 2\nvn 3 0 0\n"
+            "f 1//1 2//1 3//1\n"
+            "f 1//2 3//2 4//2\n"
+            "f -4//-2 -3//-2 -2//-2\n";
+        Mesh mesh;
+        std::string error;
+        if (!LoadObjMesh(obj.data(), obj.size(), 1, &mesh, &error))
+        {
+            return Fail(pError, "OBJ: " + error);
+        }
+        if (!mesh.importedNormals || mesh.vertices.size() != 6 || mesh.indices.size() != 9)
+        {
+            return Fail(pError, "The OBJ's corners with different normals weren't kept apart, or its normals weren't kept");
+        }
+        if (!IsNormal(mesh.vertices[0].normal, 0.0f, 0.0f, -1.0f) || !IsNormal(mesh.vertices[3].normal, 1.0f, 0.0f, 0.0f))
+        {
+            return Fail(pError, "The OBJ's normals weren't normalised and turned to the sample's axes");
+        }
+        if (mesh.indices[6] != mesh.indices[0] || mesh.indices[7] != mesh.indices[1] || mesh.indices[8] != mesh.indices[2])
+        {
+            return Fail(pError, "Relative normal indices weren't resolved");
+        }
+
+        // A face without normals leaves them to be rebuilt.
+        const std::string partialObj = "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//1 3//1\nf 1 3 2\n";
+        if (!LoadObjMesh(partialObj.data(), partialObj.size(), 1, &mesh, &error) || mesh.importedNormals)
+        {
+            return Fail(pError, "An OBJ with a face without normals claimed to have them");
+        }
+
+        const std::vector<UINT8> glb = MakeTriangleGlb(true);
+        if (!LoadGlbMesh(glb.data(), glb.size(), &mesh, &error))
+        {
+            return Fail(pError, "glTF: " + error);
+        }
+        if (!mesh.importedNormals || mesh.vertices.size() != 3 || !IsNormal(mesh.vertices[2].normal, 0.0f, 0.0f, -1.0f))
+        {
+            return Fail(pError, "The glTF's normals weren't imported, normalised and turned to the sample's axes");
+        }
+        const std::vector<UINT8> glbWithoutNormals = MakeTriangleGlb(false);
+        if (!LoadGlbMesh(glbWithoutNormals.data(), glbWithoutNormals.size(), &mesh, &error) || mesh.importedNormals)
+        {
+            return Fail(pError, "A glTF without normals claimed to have them");
+        }
+        return true;
+    }
+
+    // Runs CullAndCompactCS from the deployed ObjectTransforms.hlsl on WARP, so that no
+    // window or GPU is needed, and compares its commands with CullAndCompactObjects.
+    bool TestCullAndCompactOnWarp(std::string* pError)
+    {
+        // A grid reaching past every viewport edge, with an object count that leaves the
+        // last thread group partly empty.
+        const UINT objectCount = 41 * 41 - 7;
+        const float cullRadius = 0.125f;
+        const UINT indexCount = 36;
+        std::vector<XMFLOAT4> positions(objectCount);
+        for (UINT i = 0; i < objectCount; i++)
+        {
+            positions[i] = XMFLOAT4(-1.5f + 0.075f * (i % 41), -1.5f + 0.075f * (i / 41), 0.5f, 0.0f);
+        }
+        std::vector<IndirectCommand> referenceCommands(objectCount);
+        const UINT referenceCount = CullAndCompactObjects(positions.data(), objectCount, cullRadius, indexCount, referenceCommands.data());
+        if (referenceCount == 0 || referenceCount == objectCount)
+        {
+            return Fail(pError, "The test grid isn't partly visible");
+        }
+
+        WCHAR modulePath[MAX_PATH];
+        const DWORD length = GetModuleFileName(nullptr, modulePath, MAX_PATH);
+        std::wstring shaderPath(modulePath, length);
+        shaderPath.erase(shaderPath.find_last_of(L"\\/") + 1);
+        const ShaderProgram& program = ShaderPrograms[ShaderProgramCullAndCompactCS];
+        shaderPath += program.filename;
+
+        try
+        {
+            ComPtr<IDXGIFactory4> factory;
+            ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&factory)));
+            ComPtr<IDXGIAdapter> warpAdapter;
+            ThrowIfFailed(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
+            ComPtr<ID3D12Device> device;
+            ThrowIfFailed(D3D12CreateDevice(warpAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device)));
+
+            ComPtr<ID3DBlob> shader;
+            ComPtr<ID3DBlob> error;
+            if (FAILED(D3DCompileFromFile(shaderPath.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, program.entryPoint, program.target, GetShaderCompileFlags(), 0, &shader, &error)))
+            {
+                return Fail(pError, error ? static_cast<const char*>(error->GetBufferPointer()) : "ObjectTransforms.hlsl wasn't found next to the executable");
+            }
+            ComPtr<ID3DBlob> signature;
+            ThrowIfFailed(SerializeObjectTransformRootSignature(D3D_ROOT_SIGNATURE_VERSION_1_0, &signature, &error));
+            ComPtr<ID3D12RootSignature> rootSignature;
+            ThrowIfFailed(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
+            D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+            psoDesc.pRootSignature = rootSignature.Get();
+            psoDesc.CS = CD3DX12_SHADER_BYTECODE(shader.Get());
+            ComPtr<ID3D12PipelineState> pipelineState;
+            ThrowIfFailed(device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
+
+            // The commands and their count share one buffer, as in FrameResource; committed
+            // resources start zeroed, so the count needs no clear.
+            const UINT64 countOffset = objectCount * sizeof(IndirectCommand);
+            const UINT64 commandBufferSize = countOffset + sizeof(UINT);
+            const UINT64 positionBufferSize = objectCount * sizeof(XMFLOAT4);
+            ComPtr<ID3D12Resource> positionBuffer;
+            ComPtr<ID3D12Resource> commandBuffer;
+            ComPtr<ID3D12Resource> readbackBuffer;
+            ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Buffer(positionBufferSize), D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&positionBuffer)));
+            ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Buffer(commandBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&commandBuffer)));
+            ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Buffer(commandBufferSize), D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&readbackBuffer)));
+
+            void* pPositions;
+            const CD3DX12_RANGE emptyRange(0, 0);
+            ThrowIfFailed(positionBuffer->Map(0, &emptyRange, &pPositions));
+            memcpy(pPositions, positions.data(), static_cast<size_t>(positionBufferSize));
+            positionBuffer->Unmap(0, nullptr);
+
+            D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+            queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+            ComPtr<ID3D12CommandQueue> queue;
+            ThrowIfFailed(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue)));
+            ComPtr<ID3D12CommandAllocator> commandAllocator;
+            ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(&commandAllocator)));
+            ComPtr<ID3D12GraphicsCommandList> commandList;
+            ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, commandAllocator.Get(), pipelineState.Get(), IID_PPV_ARGS(&commandList)));
+
+            ObjectTransformConstants constants = {};
+            constants.objectCount = objectCount;
+            constants.cullRadius = cullRadius;
+            constants.indexCount = indexCount;
+            commandList->SetComputeRootSignature(rootSignature.Get());
+            commandList->SetComputeRoot32BitConstants(0, sizeof(constants) / sizeof(UINT32), &constants, 0);
+            commandList->SetComputeRootShaderResourceView(1, positionBuffer->GetGPUVirtualAddress());
+            commandList->SetComputeRootUnorderedAccessView(3, commandBuffer->GetGPUVirtualAddress());
+            commandList->SetComputeRootUnorderedAccessView(4, commandBuffer->GetGPUVirtualAddress() + countOffset);
+            commandList->Dispatch((objectCount + 63) / 64, 1, 1);
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(commandBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+            commandList->CopyResource(readbackBuffer.Get(), commandBuffer.Get());
+            ThrowIfFailed(commandList->Close());
+
+            ID3D12CommandList* ppCommandLists[] = { commandList.Get() };
+            queue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+            ComPtr<ID3D12Fence> fence;
+            ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+            ThrowIfFailed(queue->Signal(fence.Get(), 1));
+            ThrowIfFailed(fence->SetEventOnCompletion(1, nullptr));
+
+            UINT8* pData;
+            const CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(commandBufferSize));
+            ThrowIfFailed(readbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+            const UINT commandCount = *reinterpret_cast<const UINT*>(pData + countOffset);
+            const bool matches = commandCount <= objectCount &&
+                MatchesReferenceCommands(reinterpret_cast<const IndirectCommand*>(pData), commandCount, referenceCommands.data(), referenceCount);
+            readbackBuffer->Unmap(0, &emptyRange);
+            if (!matches)
+            {
+                return Fail(pError, "CullAndCompactCS's " + std::to_string(commandCount) + " commands don't match the reference's " + std::to_string(referenceCount));
+            }
+        }
+        catch (const HrException& e)
+        {
+            return Fail(pError, std::string("WARP: ") + e.what());
+        }
+        return true;
+    }
+}
+
+void GetHeadlessTests(std::vector<HeadlessTest>* pTests)
+{
+    const HeadlessTest tests[] =
+    {
+        { "PipelineStateCache.HashDesc", TestPipelineStateHashDesc },
+        { "PipelineStateCache.Dedup", TestPipelineStateDedup },
+        { "PipelineStateCache.CreateFailure", TestPipelineStateCreateFailure },
+        { "RenderGraph.Culling", TestRenderGraphCulling },
+        { "RenderGraph.Barriers", TestRenderGraphBarriers },
+        { "RenderGraph.Aliasing", TestRenderGraphAliasing },
+        { "QueueTimeline.FrameLoop", TestQueueTimelineFrameLoop },
+        { "WorkloadScheduler.RecordGpuTime", TestWorkloadSchedulerRecordGpuTime },
+        { "TimestampQueryRing.ReadBack", TestTimestampQueryRingReadBack },
+        { "TimestampQueryRing.DroppedFrames", TestTimestampQueryRingDroppedFrames },
+        { "TimestampQueryRing.Overflow", TestTimestampQueryRingOverflow },
+        { "OcclusionBuffer.Conservative", TestOcclusionBufferConservative },
+        { "MeshImport.Normals", TestMeshImportNormals },
+        { "IndirectDraw.CullAndCompactOnWarp", TestCullAndCompactOnWarp },
+    };
+    pTests->insert(pTests->end(), tests, tests + _countof(tests));
+}
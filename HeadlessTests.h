@@ -0,0 +1,7 @@
+#pragma once
+#include "stdafx.h"
+#include "PortableTests.h"
+
+// The -tests checks that need the Windows headers but no device: D3D12 objects are
+// stubbed out or left null. The bench target runs them after GetPortableTests'.
+void GetHeadlessTests(std::vector<HeadlessTest>* pTests);
@@ -0,0 +1,267 @@
+#include "stdafx.h"
+#include "HeapAllocator.h"
+
+namespace
+{
+    inline UINT64 NextPowerOfTwo(UINT64 value)
+    {
+        UINT64 result = 1;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+}
+
+HeapSuballocator::HeapSuballocator() :
+    m_blockSize(0)
+{
+    const D3D12_HEAP_TYPE heapTypes[HeapPoolCount] =
+    {
+        D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_HEAP_TYPE_UPLOAD,
+        D3D12_HEAP_TYPE_READBACK,
+    };
+    const D3D12_HEAP_FLAGS heapFlags[HeapPoolCount] =
+    {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+    };
+    for (int i = 0; i < HeapPoolCount; i++)
+    {
+        m_pools[i].heapType = heapTypes[i];
+        m_pools[i].heapFlags = heapFlags[i];
+    }
+}
+
+HeapSuballocator::~HeapSuballocator()
+{
+    Release();
+}
+
+void HeapSuballocator::Create(ID3D12Device* pDevice, UINT64 blockSize)
+{
+    Release();
+    m_device = pDevice;
+    m_blockSize = NextPowerOfTwo(blockSize);
+}
+
+void HeapSuballocator::Release()
+{
+    for (int i = 0; i < HeapPoolCount; i++)
+    {
+        m_pools[i].blocks.clear();
+    }
+    m_device.Reset();
+}
+
+HeapPool HeapSuballocator::SelectPool(D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC* pDesc) const
+{
+    if (heapType == D3D12_HEAP_TYPE_UPLOAD)
+    {
+        return HeapPoolUpload;
+    }
+    if (heapType == D3D12_HEAP_TYPE_READBACK)
+    {
+        return HeapPoolReadback;
+    }
+    if (pDesc->Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return HeapPoolBuffer;
+    }
+    if (pDesc->Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+    {
+        return HeapPoolRenderTarget;
+    }
+    return HeapPoolTexture;
+}
+
+UINT HeapSuballocator::CreateBlock(Pool& pool, UINT64 minimumSize, UINT64 alignment)
+{
+    const UINT64 size = max(m_blockSize, NextPowerOfTwo(minimumSize));
+
+    CD3DX12_HEAP_DESC heapDesc(size, pool.heapType, alignment, pool.heapFlags);
+    Block block;
+    ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&block.heap)));
+    block.allocator.reset(new BuddyAllocator(size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+    block.alignment = alignment;
+
+    // Reuse a slot emptied by Trim so existing allocations keep their block indices.
+    for (UINT i = 0; i < pool.blocks.size(); i++)
+    {
+        if (!pool.blocks[i].heap)
+        {
+            pool.blocks[i] = std::move(block);
+            return i;
+        }
+    }
+    pool.blocks.push_back(std::move(block));
+    return static_cast<UINT>(pool.blocks.size() - 1);
+}
+
+HeapAllocation HeapSuballocator::CreatePlacedResource(
+    D3D12_HEAP_TYPE heapType,
+    const D3D12_RESOURCE_DESC* pDesc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* pOptimizedClearValue,
+    REFIID riid,
+    void** ppResource)
+{
+    const HeapPool poolIndex = SelectPool(heapType, pDesc);
+    Pool& pool = m_pools[poolIndex];
+    const D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, pDesc);
+
+    // Offsets only honour info.Alignment within a heap whose own alignment is at least
+    // as large, so MSAA textures go to blocks created with the 4MB alignment.
+    const UINT64 heapAlignment = max<UINT64>(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, info.Alignment);
+
+    HeapAllocation allocation = {};
+    allocation.pool = poolIndex;
+    allocation.offset = BuddyAllocator::InvalidOffset;
+
+    for (UINT i = 0; i < pool.blocks.size() && allocation.offset == BuddyAllocator::InvalidOffset; i++)
+    {
+        if (pool.blocks[i].allocator && !pool.blocks[i].evacuating && pool.blocks[i].alignment >= heapAlignment)
+        {
+            allocation.block = i;
+            allocation.offset = pool.blocks[i].allocator->Allocate(info.SizeInBytes, info.Alignment);
+        }
+    }
+    if (allocation.offset == BuddyAllocator::InvalidOffset)
+    {
+        allocation.block = CreateBlock(pool, max(info.SizeInBytes, info.Alignment), heapAlignment);
+        allocation.offset = pool.blocks[allocation.block].allocator->Allocate(info.SizeInBytes, info.Alignment);
+    }
+    allocation.size = info.SizeInBytes;
+
+    HRESULT hr = m_device->CreatePlacedResource(
+        pool.blocks[allocation.block].heap.Get(),
+        allocation.offset,
+        pDesc,
+        initialState,
+        pOptimizedClearValue,
+        riid,
+        ppResource);
+    if (FAILED(hr))
+    {
+        Free(allocation);
+        ThrowIfFailed(hr);
+    }
+    return allocation;
+}
+
+void HeapSuballocator::Free(HeapAllocation& allocation)
+{
+    if (!allocation.IsValid())
+    {
+        return;
+    }
+
+    Block& block = m_pools[allocation.pool].blocks[allocation.block];
+    block.allocator->Free(allocation.offset);
+    if (block.allocator->GetAllocationCount() == 0)
+    {
+        block.evacuating = false;
+    }
+    allocation = HeapAllocation();
+}
+
+UINT HeapSuballocator::Defragment(float occupancyThreshold, const RelocateCallback& relocate)
+{
+    UINT requestCount = 0;
+    std::vector<UINT64> offsets;
+
+    for (UINT poolIndex = 0; poolIndex < HeapPoolCount; poolIndex++)
+    {
+        Pool& pool = m_pools[poolIndex];
+        if (pool.blocks.size() < 2)
+        {
+            continue;
+        }
+
+        // Pick every block to empty before asking for any move, so that CreatePlacedResource
+        // keeps the relocations out of all of them. Blocks already being emptied had their
+        // requests made by an earlier call.
+        std::vector<UINT> evacuatedBlocks;
+        for (UINT blockIndex = 0; blockIndex < pool.blocks.size(); blockIndex++)
+        {
+            Block& block = pool.blocks[blockIndex];
+            if (!block.allocator || block.evacuating || block.allocator->GetAllocationCount() == 0)
+            {
+                continue;
+            }
+
+            const float occupancy = static_cast<float>(block.allocator->GetUsedSize()) / static_cast<float>(block.allocator->GetSize());
+            if (occupancy < occupancyThreshold)
+            {
+                block.evacuating = true;
+                evacuatedBlocks.push_back(blockIndex);
+            }
+        }
+
+        for (UINT blockIndex : evacuatedBlocks)
+        {
+            const BuddyAllocator* pAllocator = pool.blocks[blockIndex].allocator.get();
+
+            // Copy the offsets first; the callback is allowed to free while we iterate.
+            pAllocator->GetAllocations(offsets);
+            for (UINT64 offset : offsets)
+            {
+                HeapAllocation allocation = {};
+                allocation.pool = poolIndex;
+                allocation.block = blockIndex;
+                allocation.offset = offset;
+                allocation.size = pAllocator->GetAllocationSize(offset);
+                relocate(allocation);
+                requestCount++;
+            }
+        }
+    }
+    return requestCount;
+}
+
+void HeapSuballocator::Trim()
+{
+    for (int i = 0; i < HeapPoolCount; i++)
+    {
+        for (Block& block : m_pools[i].blocks)
+        {
+            if (block.allocator && block.allocator->GetAllocationCount() == 0)
+            {
+                block.allocator.reset();
+                block.heap.Reset();
+            }
+        }
+    }
+}
+
+void HeapSuballocator::GetPoolStatistics(HeapPool pool, UINT64* pUsedSize, UINT64* pReservedSize, float* pFragmentation) const
+{
+    UINT64 usedSize = 0;
+    UINT64 reservedSize = 0;
+    UINT64 largestFree = 0;
+
+    for (const Block& block : m_pools[pool].blocks)
+    {
+        if (block.allocator)
+        {
+            usedSize += block.allocator->GetUsedSize();
+            reservedSize += block.allocator->GetSize();
+            largestFree = max(largestFree, block.allocator->GetLargestFreeBlock());
+        }
+    }
+
+    if (pUsedSize) *pUsedSize = usedSize;
+    if (pReservedSize) *pReservedSize = reservedSize;
+    if (pFragmentation)
+    {
+        const UINT64 freeSize = reservedSize - usedSize;
+        *pFragmentation = freeSize == 0 ? 0.0f : 1.0f - static_cast<float>(largestFree) / static_cast<float>(freeSize);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include "BuddyAllocator.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Pools kept in separate heaps so the allocator also works on resource heap tier 1.
+enum HeapPool
+{
+    HeapPoolBuffer = 0,         // DEFAULT heap buffers.
+    HeapPoolTexture,            // DEFAULT heap textures that are not render targets or depth buffers.
+    HeapPoolRenderTarget,       // DEFAULT heap render target and depth stencil textures.
+    HeapPoolUpload,             // UPLOAD heap buffers.
+    HeapPoolReadback,           // READBACK heap buffers.
+    HeapPoolCount
+};
+
+struct HeapAllocation
+{
+    UINT pool;
+    UINT block;
+    UINT64 offset;
+    UINT64 size;
+
+    bool IsValid() const { return size != 0; }
+};
+
+// Places resources in large ID3D12Heap blocks instead of giving every resource its
+// own implicit heap through CreateCommittedResource.
+class HeapSuballocator
+{
+public:
+    // Asked to move an allocation out of a sparsely used block. The owner recreates the
+    // resource through CreatePlacedResource, copies its contents, and frees the old
+    // allocation once the GPU is no longer using it.
+    typedef std::function<void(const HeapAllocation& allocation)> RelocateCallback;
+
+    HeapSuballocator();
+    ~HeapSuballocator();
+
+    void Create(ID3D12Device* pDevice, UINT64 blockSize = 64 * 1024 * 1024);
+    void Release();
+
+    HeapAllocation CreatePlacedResource(
+        D3D12_HEAP_TYPE heapType,
+        const D3D12_RESOURCE_DESC* pDesc,
+        D3D12_RESOURCE_STATES initialState,
+        const D3D12_CLEAR_VALUE* pOptimizedClearValue,
+        REFIID riid,
+        void** ppResource);
+
+    // The resource placed at this allocation must have been released and be idle on the GPU.
+    void Free(HeapAllocation& allocation);
+
+    // Requests relocation of every allocation living in a block whose occupancy is below
+    // occupancyThreshold, for pools that own more than one block. Returns the request count.
+    // Those blocks take no new allocations until they have been emptied, so relocations
+    // land in the pool's other blocks, or a new one.
+    UINT Defragment(float occupancyThreshold, const RelocateCallback& relocate);
+
+    // Releases heap blocks that no longer hold any allocation.
+    void Trim();
+
+    void GetPoolStatistics(HeapPool pool, UINT64* pUsedSize, UINT64* pReservedSize, float* pFragmentation) const;
+
+private:
+    struct Block
+    {
+        ComPtr<ID3D12Heap> heap;
+        std::unique_ptr<BuddyAllocator> allocator;
+        UINT64 alignment;       // Of the heap; MSAA textures need D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT.
+        bool evacuating;        // Defragment asked for everything in it to move.
+
+        Block() : alignment(0), evacuating(false) {}
+    };
+
+    struct Pool
+    {
+        D3D12_HEAP_TYPE heapType;
+        D3D12_HEAP_FLAGS heapFlags;
+        std::vector<Block> blocks;
+    };
+
+    HeapPool SelectPool(D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC* pDesc) const;
+    UINT CreateBlock(Pool& pool, UINT64 minimumSize, UINT64 alignment);
+
+    ComPtr<ID3D12Device> m_device;
+    UINT64 m_blockSize;
+    Pool m_pools[HeapPoolCount];
+};
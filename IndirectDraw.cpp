@@ -0,0 +1,55 @@
+#include "stdafx.h"
+#include "IndirectDraw.h"
+#include <algorithm>
+
+UINT CullAndCompactObjects(const XMFLOAT4* pPositions, UINT objectCount, float cullRadius, UINT indexCount, IndirectCommand* pCommands)
+{
+    UINT commandCount = 0;
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        if (!IsObjectVisible(pPositions[i], cullRadius))
+        {
+            continue;
+        }
+
+        IndirectCommand& command = pCommands[commandCount++];
+        command.objectIndex = i;
+        command.drawArguments.IndexCountPerInstance = indexCount;
+        command.drawArguments.InstanceCount = 1;
+        command.drawArguments.StartIndexLocation = 0;
+        command.drawArguments.BaseVertexLocation = 0;
+        command.drawArguments.StartInstanceLocation = 0;
+    }
+    return commandCount;
+}
+
+HRESULT SerializeObjectTransformRootSignature(D3D_ROOT_SIGNATURE_VERSION maxVersion, ID3DBlob** ppSignature, ID3DBlob** ppError)
+{
+    CD3DX12_ROOT_PARAMETER1 rootParameters[6];
+    rootParameters[0].InitAsConstants(sizeof(ObjectTransformConstants) / sizeof(UINT32), 0);
+    rootParameters[1].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC);
+    rootParameters[2].InitAsUnorderedAccessView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE);
+    rootParameters[3].InitAsUnorderedAccessView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE);
+    rootParameters[4].InitAsUnorderedAccessView(2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE);
+    rootParameters[5].InitAsUnorderedAccessView(3, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE);
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+    rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+    return D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, maxVersion, ppSignature, ppError);
+}
+
+bool MatchesReferenceCommands(const IndirectCommand* pCommands, UINT commandCount, const IndirectCommand* pReferenceCommands, UINT referenceCount)
+{
+    if (commandCount != referenceCount)
+    {
+        return false;
+    }
+
+    std::vector<IndirectCommand> sorted(pCommands, pCommands + commandCount);
+    std::sort(sorted.begin(), sorted.end(), [](const IndirectCommand& a, const IndirectCommand& b)
+    {
+        return a.objectIndex < b.objectIndex;
+    });
+
+    // The reference is already in object order.
+    return memcmp(sorted.data(), pReferenceCommands, commandCount * sizeof(IndirectCommand)) == 0;
+}
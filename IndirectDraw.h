@@ -0,0 +1,46 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+using namespace DirectX;
+
+// One ExecuteIndirect command: the object index root constant followed by the draw.
+// Must match IndirectCommand in ObjectTransforms.hlsl and the command signature.
+struct IndirectCommand
+{
+    UINT objectIndex;
+    D3D12_DRAW_INDEXED_ARGUMENTS drawArguments;
+};
+
+static_assert(sizeof(IndirectCommand) == 24, "IndirectCommand must match the HLSL layout");
+
+// Root constants of ObjectTransforms.hlsl.
+struct ObjectTransformConstants {
+    float rotationSin;
+    float rotationCos;
+    UINT objectCount;
+    float cullRadius;
+    UINT indexCount;
+    UINT writeInstances;        // Write PackedInstanceData instead of SceneConstantBuffer.
+};
+
+// The root signature of ObjectTransforms.hlsl, shared by the sample and the bench
+// target's check of CullAndCompactCS. Every buffer is bound as a root descriptor, so the
+// dispatch needs no descriptor heap: 0 is ObjectTransformConstants, 1 the positions, then
+// the UAVs 2 transforms, 3 indirect commands, 4 indirect command count and 5 packed instances.
+HRESULT SerializeObjectTransformRootSignature(D3D_ROOT_SIGNATURE_VERSION maxVersion, ID3DBlob** ppSignature, ID3DBlob** ppError);
+
+// Viewport test shared by the CPU transform path and the CPU reference below; the
+// shaders in ObjectTransforms.hlsl implement the same test.
+inline bool IsObjectVisible(const XMFLOAT4& position, float cullRadius)
+{
+    return fabsf(position.x) - cullRadius <= 1.0f && fabsf(position.y) - cullRadius <= 1.0f;
+}
+
+// CPU reference of CullAndCompactCS: writes one command per visible object, in object
+// order, and returns the command count. Needs no device, so it can run headlessly.
+UINT CullAndCompactObjects(const XMFLOAT4* pPositions, UINT objectCount, float cullRadius, UINT indexCount, IndirectCommand* pCommands);
+
+// The GPU appends commands in whatever order its threads finish, so the comparison
+// ignores order. Returns true when both hold the same set of commands.
+bool MatchesReferenceCommands(const IndirectCommand* pCommands, UINT commandCount, const IndirectCommand* pReferenceCommands, UINT referenceCount);
@@ -0,0 +1,191 @@
+#include "stdafx.h"
+#include "InstanceData.h"
+#include "D3D12HelloTriangle.h"
+#include <DirectXPackedVector.h>
+#include <cfloat>
+#include <random>
+
+using namespace DirectX::PackedVector;
+
+void EncodeInstanceData(FXMMATRIX world, InstanceData* pInstance)
+{
+    const XMMATRIX rows = XMMatrixTranspose(world);
+    XMStoreFloat4(&pInstance->rows[0], rows.r[0]);
+    XMStoreFloat4(&pInstance->rows[1], rows.r[1]);
+    XMStoreFloat4(&pInstance->rows[2], rows.r[2]);
+}
+
+void EncodeInstanceData(FXMMATRIX world, InstanceDataHalf* pInstance)
+{
+    const XMMATRIX rows = XMMatrixTranspose(world);
+    for (UINT i = 0; i < 3; i++)
+    {
+        XMHALF4 halves;
+        XMStoreHalf4(&halves, rows.r[i]);
+        pInstance->packedRows[2 * i] = halves.x | (static_cast<UINT>(halves.y) << 16);
+        pInstance->packedRows[2 * i + 1] = halves.z | (static_cast<UINT>(halves.w) << 16);
+    }
+}
+
+XMMATRIX DecodeInstanceData(const InstanceData& instance)
+{
+    const XMMATRIX rows(XMLoadFloat4(&instance.rows[0]), XMLoadFloat4(&instance.rows[1]), XMLoadFloat4(&instance.rows[2]), g_XMIdentityR3);
+    return XMMatrixTranspose(rows);
+}
+
+XMMATRIX DecodeInstanceData(const InstanceDataHalf& instance)
+{
+    XMMATRIX rows = XMMatrixIdentity();
+    for (UINT i = 0; i < 3; i++)
+    {
+        const UINT low = instance.packedRows[2 * i];
+        const UINT high = instance.packedRows[2 * i + 1];
+        const XMHALF4 halves(static_cast<HALF>(low), static_cast<HALF>(low >> 16), static_cast<HALF>(high), static_cast<HALF>(high >> 16));
+        rows.r[i] = XMLoadHalf4(&halves);
+    }
+    return XMMatrixTranspose(rows);
+}
+
+const char* GetInstanceDataFormatName(InstanceDataFormat format)
+{
+    switch (format)
+    {
+    case InstanceDataFormatConstantBuffer:
+        return "constant buffer";
+    case InstanceDataFormatFloat:
+        return "float 3x4";
+    case InstanceDataFormatHalf:
+        return "half 3x4";
+    default:
+        return "unknown";
+    }
+}
+
+namespace
+{
+    UINT GetInstanceDataSize(InstanceDataFormat format)
+    {
+        switch (format)
+        {
+        case InstanceDataFormatConstantBuffer:
+            return sizeof(SceneConstantBuffer);
+        case InstanceDataFormatFloat:
+            return sizeof(InstanceData);
+        default:
+            return sizeof(InstanceDataHalf);
+        }
+    }
+
+    // The constant buffer's padding is never written, only allocated.
+    UINT GetInstanceDataWriteSize(InstanceDataFormat format)
+    {
+        return (format == InstanceDataFormatConstantBuffer) ? sizeof(XMMATRIX) : GetInstanceDataSize(format);
+    }
+
+    // One pass of the CPU transform update: a rotation shared by every object and a
+    // translation per object.
+    void WriteInstances(InstanceDataFormat format, UINT8* pDestination, const std::vector<XMFLOAT4>& positions, float rotation)
+    {
+        const XMMATRIX rotationMatrix = XMMatrixRotationZ(rotation);
+        const UINT objectCount = static_cast<UINT>(positions.size());
+        for (UINT i = 0; i < objectCount; i++)
+        {
+            const XMMATRIX world = rotationMatrix * XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z);
+            switch (format)
+            {
+            case InstanceDataFormatConstantBuffer:
+                reinterpret_cast<SceneConstantBuffer*>(pDestination)[i].model = XMMatrixTranspose(world);
+                break;
+            case InstanceDataFormatFloat:
+                EncodeInstanceData(world, reinterpret_cast<InstanceData*>(pDestination) + i);
+                break;
+            default:
+                EncodeInstanceData(world, reinterpret_cast<InstanceDataHalf*>(pDestination) + i);
+                break;
+            }
+        }
+    }
+}
+
+InstanceUploadCost MeasureInstanceUploadCost(InstanceDataFormat format, UINT objectCount, UINT iterations)
+{
+    InstanceUploadCost cost = {};
+    cost.bytesPerObject = GetInstanceDataSize(format);
+    cost.bytesWrittenPerObject = GetInstanceDataWriteSize(format);
+
+    // Upload heaps are write-combined on most hardware, which is what makes the
+    // padding expensive: every byte written goes out over the bus.
+    const SIZE_T size = static_cast<SIZE_T>(cost.bytesPerObject) * objectCount;
+    UINT8* pDestination = static_cast<UINT8*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE | PAGE_WRITECOMBINE));
+    if (pDestination == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<XMFLOAT4> positions(objectCount);
+    for (XMFLOAT4& position : positions)
+    {
+        position = XMFLOAT4(distribution(random), distribution(random), 0.0f, 1.0f);
+    }
+
+    // The first pass also commits the pages.
+    WriteInstances(format, pDestination, positions, 0.0f);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    double bestSeconds = DBL_MAX;
+    for (UINT i = 0; i < iterations; i++)
+    {
+        LARGE_INTEGER writeStart, writeEnd;
+        QueryPerformanceCounter(&writeStart);
+        WriteInstances(format, pDestination, positions, 0.1f * (i + 1));
+        QueryPerformanceCounter(&writeEnd);
+        bestSeconds = min(bestSeconds, static_cast<double>(writeEnd.QuadPart - writeStart.QuadPart) / frequency.QuadPart);
+    }
+    VirtualFree(pDestination, 0, MEM_RELEASE);
+
+    cost.milliseconds = 1000.0 * bestSeconds;
+    cost.gigabytesPerSecond = static_cast<double>(cost.bytesWrittenPerObject) * objectCount / bestSeconds / 1e9;
+    return cost;
+}
+
+InstanceQuantizationError MeasureInstanceQuantizationError(UINT objectCount, float translationRange)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    double errorSum = 0.0;
+    UINT sampleCount = 0;
+    InstanceQuantizationError error = {};
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        const XMMATRIX world = XMMatrixRotationRollPitchYaw(XM_PI * unit(random), XM_PI * unit(random), XM_PI * unit(random)) *
+            XMMatrixTranslation(translationRange * unit(random), translationRange * unit(random), translationRange * unit(random));
+
+        InstanceData instance;
+        InstanceDataHalf instanceHalf;
+        EncodeInstanceData(world, &instance);
+        EncodeInstanceData(world, &instanceHalf);
+        const XMMATRIX decoded = DecodeInstanceData(instance);
+        const XMMATRIX decodedHalf = DecodeInstanceData(instanceHalf);
+
+        for (UINT corner = 0; corner < 8; corner++)
+        {
+            const XMVECTOR position = XMVectorSet((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f, 1.0f);
+            const float distance = XMVectorGetX(XMVector3Length(XMVector3Transform(position, decoded) - XMVector3Transform(position, decodedHalf)));
+            error.maxError = max(error.maxError, distance);
+            errorSum += distance;
+            sampleCount++;
+        }
+    }
+
+    // Rounding to half loses at most 2^-11 of a value's magnitude. Rotation terms and
+    // the cube's coordinates are at most 1, so each output component is off by at most
+    // (3 + translationRange) * 2^-11, and the distance by sqrt(3) times that.
+    const float halfPrecision = 1.0f / 2048.0f;
+    error.meanError = (sampleCount > 0) ? static_cast<float>(errorSum / sampleCount) : 0.0f;
+    error.tolerance = sqrtf(3.0f) * (3.0f + translationRange) * halfPrecision;
+    return error;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "stdafx.h"
+#include <cstddef>
+
+using namespace DirectX;
+
+// The layout comes from InstanceData.hlsli, compiled here with C++ spellings of the
+// HLSL types, so the shaders and the CPU writers cannot drift apart.
+namespace ShaderShared
+{
+    typedef XMFLOAT4 float4;
+    typedef UINT uint;
+#include "InstanceData.hlsli"
+}
+
+using ShaderShared::InstanceData;
+using ShaderShared::InstanceDataHalf;
+using ShaderShared::PackedInstanceData;
+
+static_assert(sizeof(InstanceData) == 48 && offsetof(InstanceData, rows) == 0, "InstanceData must match InstanceData.hlsli");
+static_assert(sizeof(InstanceDataHalf) == 24 && offsetof(InstanceDataHalf, packedRows) == 0, "InstanceDataHalf must match InstanceData.hlsli");
+
+// world is a row-vector matrix whose last column is (0, 0, 0, 1).
+void EncodeInstanceData(FXMMATRIX world, InstanceData* pInstance);
+void EncodeInstanceData(FXMMATRIX world, InstanceDataHalf* pInstance);
+XMMATRIX DecodeInstanceData(const InstanceData& instance);
+XMMATRIX DecodeInstanceData(const InstanceDataHalf& instance);
+
+// Per-object upload formats compared by the bandwidth benchmark.
+enum InstanceDataFormat
+{
+    InstanceDataFormatConstantBuffer = 0,   // SceneConstantBuffer: a 4x4 matrix padded to 256 bytes.
+    InstanceDataFormatFloat,                // InstanceData.
+    InstanceDataFormatHalf,                 // InstanceDataHalf.
+    InstanceDataFormatCount
+};
+
+const char* GetInstanceDataFormatName(InstanceDataFormat format);
+
+struct InstanceUploadCost
+{
+    UINT bytesPerObject;            // Buffer footprint.
+    UINT bytesWrittenPerObject;
+    double milliseconds;            // To write every object once, best of several runs.
+    double gigabytesPerSecond;      // Of bytes written.
+};
+
+// Encodes objectCount transforms into write-combined memory, as the CPU transform
+// update does into an upload heap.
+InstanceUploadCost MeasureInstanceUploadCost(InstanceDataFormat format, UINT objectCount, UINT iterations);
+
+struct InstanceQuantizationError
+{
+    float maxError;                 // Largest distance between float and half transformed positions.
+    float meanError;
+    float tolerance;                // What half precision allows for the tested range.
+};
+
+// Transforms the corners of a unit cube by random rotations and translations within
+// translationRange through both encodings and compares the results.
+InstanceQuantizationError MeasureInstanceQuantizationError(UINT objectCount, float translationRange);
@@ -0,0 +1,76 @@
+// Packed per-object data, shared by the shaders and the C++ code (InstanceData.h).
+// Structured buffers are tightly packed, so the sizes static_assert'ed in
+// InstanceData.h are also the HLSL strides.
+//
+// An instance is the affine 3x4 part of the object's row-vector world matrix, stored
+// transposed: row i holds column i, so dot(rows[i], float4(position, 1)) is output
+// component i. The fourth column is always (0, 0, 0, 1) and is not stored.
+
+#ifndef INSTANCE_DATA_HLSLI
+#define INSTANCE_DATA_HLSLI
+
+// 1 stores the matrices as half floats, 24 instead of 48 bytes per object.
+#define INSTANCE_DATA_HALF 0
+
+struct InstanceData
+{
+    float4 rows[3];
+};
+
+// Two halves per uint, low half first, row by row.
+struct InstanceDataHalf
+{
+    uint packedRows[6];
+};
+
+#if INSTANCE_DATA_HALF
+typedef InstanceDataHalf PackedInstanceData;
+#else
+typedef InstanceData PackedInstanceData;
+#endif
+
+#ifndef __cplusplus
+float3x4 DecodeInstanceData(InstanceData instance)
+{
+    return float3x4(instance.rows[0], instance.rows[1], instance.rows[2]);
+}
+
+float3x4 DecodeInstanceData(InstanceDataHalf instance)
+{
+    float3x4 rows;
+    [unroll]
+    for (uint i = 0; i < 3; i++)
+    {
+        const uint low = instance.packedRows[2 * i];
+        const uint high = instance.packedRows[2 * i + 1];
+        rows[i] = float4(f16tof32(low), f16tof32(low >> 16), f16tof32(high), f16tof32(high >> 16));
+    }
+    return rows;
+}
+
+PackedInstanceData EncodeInstanceData(float3x4 rows)
+{
+    PackedInstanceData instance;
+#if INSTANCE_DATA_HALF
+    [unroll]
+    for (uint i = 0; i < 3; i++)
+    {
+        const uint4 halves = f32tof16(rows[i]);
+        instance.packedRows[2 * i] = halves.x | (halves.y << 16);
+        instance.packedRows[2 * i + 1] = halves.z | (halves.w << 16);
+    }
+#else
+    instance.rows[0] = rows[0];
+    instance.rows[1] = rows[1];
+    instance.rows[2] = rows[2];
+#endif
+    return instance;
+}
+
+float4 TransformPosition(float3x4 rows, float3 position)
+{
+    return float4(mul(rows, float4(position, 1.0f)), 1.0f);
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "LodSelection.h"
+#include <cfloat>
+
+LodSelector::LodSelector() :
+    m_objectCount(0),
+    m_objectRadius(0.0f),
+    m_hysteresis(0.0f)
+{
+}
+
+void LodSelector::Reset(const float* pLodErrors, UINT lodCount, UINT objectCount, float objectRadius, float hysteresis)
+{
+    // LOD lod is good enough while pLodErrors[lod] * radius <= MaxLodErrorPixels.
+    m_switchRadii.clear();
+    for (UINT lod = 1; lod < lodCount; lod++)
+    {
+        m_switchRadii.push_back(pLodErrors[lod] > 0.0f ? MaxLodErrorPixels / pLodErrors[lod] : FLT_MAX);
+    }
+    m_objectCount = objectCount;
+    m_lods.assign((objectCount + 3) / 4 * 4, 0.0f);
+    m_objectRadius = objectRadius;
+    m_hysteresis = hysteresis;
+}
+
+void LodSelector::Update(const XMFLOAT4* pPositions, FXMMATRIX viewProjection, const D3D12_VIEWPORT& viewport)
+{
+    if (m_switchRadii.empty() || m_objectCount == 0)
+    {
+        return;
+    }
+
+    // A unit of world space at clip space w = 1 covers as much clip space y as the
+    // matrix's y column is long, and a unit of clip space y half the viewport's height.
+    const XMMATRIX columns = XMMatrixTranspose(viewProjection);
+    const XMVECTOR radiusAtUnitW = XMVectorReplicate(m_objectRadius * XMVectorGetX(XMVector3Length(columns.r[1])) * 0.5f * viewport.Height);
+    const XMVECTOR wFromX = XMVectorSplatX(columns.r[3]);
+    const XMVECTOR wFromY = XMVectorSplatY(columns.r[3]);
+    const XMVECTOR wFromZ = XMVectorSplatZ(columns.r[3]);
+    const XMVECTOR wFromOne = XMVectorSplatW(columns.r[3]);
+    const XMVECTOR minimumW = XMVectorReplicate(1e-6f);
+    const XMVECTOR grow = XMVectorReplicate(1.0f + m_hysteresis);
+    const XMVECTOR shrink = XMVectorReplicate(1.0f - m_hysteresis);
+
+    for (UINT i = 0; i < m_objectCount; i += 4)
+    {
+        // Transposed, so that each register holds one coordinate of all four objects. The
+        // last batch repeats the last object.
+        XMMATRIX positions;
+        for (UINT j = 0; j < 4; j++)
+        {
+            positions.r[j] = XMLoadFloat4(&pPositions[min(i + j, m_objectCount - 1)]);
+        }
+        positions = XMMatrixTranspose(positions);
+        XMVECTOR w = XMVectorMultiplyAdd(positions.r[0], wFromX, XMVectorMultiplyAdd(positions.r[1], wFromY, XMVectorMultiplyAdd(positions.r[2], wFromZ, wFromOne)));
+        w = XMVectorMax(w, minimumW);
+        const XMVECTOR radius = XMVectorDivide(radiusAtUnitW, w);
+
+        // How many LODs past 0 the radius allows, grown by the hysteresis for going
+        // coarser and shrunk by it for going finer. Larger radii allow fewer, so at most
+        // one of the two moves the object.
+        const XMVECTOR grownRadius = XMVectorMultiply(radius, grow);
+        const XMVECTOR shrunkRadius = XMVectorMultiply(radius, shrink);
+        XMVECTOR coarser = XMVectorZero();
+        XMVECTOR finer = XMVectorZero();
+        for (float switchRadius : m_switchRadii)
+        {
+            const XMVECTOR switchRadii = XMVectorReplicate(switchRadius);
+            coarser = XMVectorAdd(coarser, XMVectorAndInt(XMVectorLessOrEqual(grownRadius, switchRadii), g_XMOne));
+            finer = XMVectorAdd(finer, XMVectorAndInt(XMVectorLessOrEqual(shrunkRadius, switchRadii), g_XMOne));
+        }
+
+        XMVECTOR lods = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_lods[i]));
+        lods = XMVectorSelect(lods, coarser, XMVectorGreater(coarser, lods));
+        lods = XMVectorSelect(lods, finer, XMVectorLess(finer, lods));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&m_lods[i]), lods);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+using namespace DirectX;
+
+// Picks each object's level of detail from the size it projects to on screen: the
+// coarsest LOD whose simplification error, scaled by the object's projected radius in
+// pixels, stays within MaxLodErrorPixels. An object only changes LOD once its radius is
+// a hysteresis fraction past the size where it would switch, so objects hovering
+// there don't flicker between two.
+
+// How far, in pixels, a LOD may move the object's outline.
+const float MaxLodErrorPixels = 1.0f;
+
+// The sample's hysteresis: a tenth of the radius either way.
+const float LodHysteresis = 0.1f;
+
+class LodSelector
+{
+public:
+    LodSelector();
+
+    // lodErrors: each LOD's error relative to objectRadius, LOD 0 first and increasing.
+    // Every object starts at LOD 0.
+    void Reset(const float* pLodErrors, UINT lodCount, UINT objectCount, float objectRadius, float hysteresis);
+
+    // Projects every object's radius at its position, pPositions[i].xyz, through
+    // viewProjection onto the viewport, and moves it to the LOD that size calls for.
+    // A perspective projection shrinks objects with their distance, clip space w.
+    // Four objects at a time, all in vector registers.
+    void Update(const XMFLOAT4* pPositions, FXMMATRIX viewProjection, const D3D12_VIEWPORT& viewport);
+
+    UINT GetLodCount() const { return static_cast<UINT>(m_switchRadii.size()) + 1; }
+    UINT GetLod(UINT object) const { return static_cast<UINT>(m_lods[object]); }
+
+    // The radius in pixels below which LOD lod is good enough, for lod from 1.
+    float GetSwitchRadius(UINT lod) const { return m_switchRadii[lod - 1]; }
+
+private:
+    std::vector<float> m_switchRadii;
+    std::vector<float> m_lods;          // As floats, padded to whole batches of four.
+    UINT m_objectCount;
+    float m_objectRadius;
+    float m_hysteresis;
+};
@@ -0,0 +1,1048 @@
+#include "stdafx.h"
+#include "MeshImport.h"
+#include <algorithm>
+#include <functional>
+#include <process.h>
+#include <unordered_map>
+
+namespace
+{
+    // Below this an OBJ file isn't worth splitting.
+    const size_t ObjMinimumChunkSize = 64 * 1024;
+
+    bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char* SkipSpaces(const char* p, const char* pEnd)
+    {
+        while (p < pEnd && IsSpace(*p))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // A decimal number with an optional sign, fraction and exponent. Digits are gathered
+    // into an integer and scaled once, so that "0.1" is as close as strtof gets, without
+    // its locale. Returns nullptr if there's no number.
+    const char* ParseFloat(const char* p, const char* pEnd, float* pValue)
+    {
+        static const double powersOf10[] =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        p = SkipSpaces(p, pEnd);
+        bool negative = false;
+        if (p < pEnd && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            p++;
+        }
+
+        UINT64 mantissa = 0;
+        int exponent = 0;
+        bool digits = false;
+        for (; p < pEnd && IsDigit(*p); p++, digits = true)
+        {
+            if (mantissa < 100000000000000000ull)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+            else
+            {
+                exponent++;
+            }
+        }
+        if (p < pEnd && *p == '.')
+        {
+            for (p++; p < pEnd && IsDigit(*p); p++, digits = true)
+            {
+                if (mantissa < 100000000000000000ull)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                }
+            }
+        }
+        if (!digits)
+        {
+            return nullptr;
+        }
+        if (p < pEnd && (*p == 'e' || *p == 'E'))
+        {
+            const char* pExponent = p + 1;
+            bool negativeExponent = false;
+            if (pExponent < pEnd && (*pExponent == '-' || *pExponent == '+'))
+            {
+                negativeExponent = (*pExponent == '-');
+                pExponent++;
+            }
+            if (pExponent < pEnd && IsDigit(*pExponent))
+            {
+                int value = 0;
+                for (; pExponent < pEnd && IsDigit(*pExponent); pExponent++)
+                {
+                    value = min(value * 10 + (*pExponent - '0'), 1000);
+                }
+                exponent += negativeExponent ? -value : value;
+                p = pExponent;
+            }
+        }
+
+        double value = static_cast<double>(mantissa);
+        if (exponent < 0)
+        {
+            value = (exponent >= -22) ? value / powersOf10[-exponent] : value * pow(10.0, exponent);
+        }
+        else if (exponent > 0)
+        {
+            value = (exponent <= 22) ? value * powersOf10[exponent] : value * pow(10.0, exponent);
+        }
+        *pValue = static_cast<float>(negative ? -value : value);
+        return p;
+    }
+
+    const char* ParseInteger(const char* p, const char* pEnd, INT64* pValue)
+    {
+        bool negative = false;
+        if (p < pEnd && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            p++;
+        }
+        if (p == pEnd || !IsDigit(*p))
+        {
+            return nullptr;
+        }
+        INT64 value = 0;
+        for (; p < pEnd && IsDigit(*p); p++)
+        {
+            value = min(value * 10 + (*p - '0'), static_cast<INT64>(INT_MAX));
+        }
+        *pValue = negative ? -value : value;
+        return p;
+    }
+
+    enum ObjCornerFlags : UINT8
+    {
+        ObjCornerPositionRelative = 0x1,    // Counted from the chunk's first position.
+        ObjCornerUvRelative = 0x2,
+        ObjCornerNoUv = 0x4,
+        ObjCornerNormalRelative = 0x8,
+        ObjCornerNoNormal = 0x10
+    };
+
+    // A face corner as far as its chunk can resolve it: an index from the start of the
+    // file, or, for a negative index, from the chunk's first element, which is only
+    // known once the chunks before it have been counted.
+    struct ObjCorner
+    {
+        INT64 position;
+        INT64 uv;
+        INT64 normal;
+        UINT8 flags;
+    };
+
+    struct ObjChunk
+    {
+        const char* pBegin;
+        const char* pEnd;
+        std::vector<XMFLOAT3> positions;
+        std::vector<XMFLOAT2> uvs;
+        std::vector<XMFLOAT3> normals;
+        std::vector<ObjCorner> corners;     // Three to a triangle.
+        std::string error;
+    };
+
+    // A face corner resolved to the whole file's elements. uv and normal are one past
+    // their index, or 0 for none.
+    struct ObjVertexKey
+    {
+        UINT32 position;
+        UINT32 uv;
+        UINT32 normal;
+
+        bool operator==(const ObjVertexKey& other) const
+        {
+            return position == other.position && uv == other.uv && normal == other.normal;
+        }
+    };
+
+    UINT64 HashObjVertexKey(const ObjVertexKey& key)
+    {
+        // The upper half of the product mixes every field; folding it down lets the
+        // lower half too.
+        const UINT64 attributes = (static_cast<UINT64>(key.uv) << 32) | key.normal;
+        const UINT64 hash = ((static_cast<UINT64>(key.position) * 0xC2B2AE3D27D4EB4Full) ^ attributes) * 0x9E3779B97F4A7C15ull;
+        return hash ^ (hash >> 32);
+    }
+
+    struct ObjVertexKeyHash
+    {
+        size_t operator()(const ObjVertexKey& key) const
+        {
+            return static_cast<size_t>(HashObjVertexKey(key));
+        }
+    };
+
+    // To the sample's axes, as positions are, and unit length. A zero normal stays zero.
+    XMFLOAT3 ConvertFileNormal(XMFLOAT3 normal)
+    {
+        normal.z = -normal.z;
+        XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+        return normal;
+    }
+
+    bool IsObjKeyword(const char* p, const char* pEnd, const char* keyword)
+    {
+        const size_t length = strlen(keyword);
+        return static_cast<size_t>(pEnd - p) > length && memcmp(p, keyword, length) == 0 && IsSpace(p[length]);
+    }
+
+    // v, v/vt, v//vn or v/vt/vn.
+    const char* ParseObjCorner(const char* p, const char* pEnd, const ObjChunk& chunk, ObjCorner* pCorner)
+    {
+        INT64 position;
+        p = ParseInteger(p, pEnd, &position);
+        if (!p || position == 0)
+        {
+            return nullptr;
+        }
+        pCorner->flags = ObjCornerNoUv | ObjCornerNoNormal;
+        pCorner->position = (position > 0) ? position - 1 : static_cast<INT64>(chunk.positions.size()) + position;
+        pCorner->flags |= (position < 0) ? ObjCornerPositionRelative : 0;
+        pCorner->uv = 0;
+        pCorner->normal = 0;
+
+        if (p < pEnd && *p == '/')
+        {
+            p++;
+            if (p < pEnd && *p != '/')
+            {
+                INT64 uv;
+                p = ParseInteger(p, pEnd, &uv);
+                if (!p || uv == 0)
+                {
+                    return nullptr;
+                }
+                pCorner->uv = (uv > 0) ? uv - 1 : static_cast<INT64>(chunk.uvs.size()) + uv;
+                pCorner->flags &= ~ObjCornerNoUv;
+                pCorner->flags |= (uv < 0) ? ObjCornerUvRelative : 0;
+            }
+            if (p < pEnd && *p == '/')
+            {
+                p++;
+                if (p < pEnd && !IsSpace(*p))
+                {
+                    INT64 normal;
+                    p = ParseInteger(p, pEnd, &normal);
+                    if (!p || normal == 0)
+                    {
+                        return nullptr;
+                    }
+                    pCorner->normal = (normal > 0) ? normal - 1 : static_cast<INT64>(chunk.normals.size()) + normal;
+                    pCorner->flags &= ~ObjCornerNoNormal;
+                    pCorner->flags |= (normal < 0) ? ObjCornerNormalRelative : 0;
+                }
+            }
+        }
+        return (p == pEnd || IsSpace(*p)) ? p : nullptr;
+    }
+
+    void ParseObjChunk(ObjChunk* pChunk)
+    {
+        std::vector<ObjCorner> polygon;
+        const char* p = pChunk->pBegin;
+        const char* pEnd = pChunk->pEnd;
+        while (p < pEnd)
+        {
+            const char* pLineEnd = static_cast<const char*>(memchr(p, '\n', pEnd - p));
+            if (!pLineEnd)
+            {
+                pLineEnd = pEnd;
+            }
+            p = SkipSpaces(p, pLineEnd);
+            const char* pLine = p;
+
+            bool valid = true;
+            if (IsObjKeyword(p, pLineEnd, "v"))
+            {
+                XMFLOAT3 position;
+                valid = (p = ParseFloat(p + 1, pLineEnd, &position.x)) &&
+                    (p = ParseFloat(p, pLineEnd, &position.y)) &&
+                    (p = ParseFloat(p, pLineEnd, &position.z));
+                position.z = -position.z;
+                pChunk->positions.push_back(position);
+            }
+            else if (IsObjKeyword(p, pLineEnd, "vt"))
+            {
+                XMFLOAT2 uv(0.0f, 0.0f);
+                valid = (p = ParseFloat(p + 2, pLineEnd, &uv.x)) != nullptr;
+                if (valid && !ParseFloat(p, pLineEnd, &uv.y))
+                {
+                    uv.y = 0.0f;
+                }
+                uv.y = 1.0f - uv.y;
+                pChunk->uvs.push_back(uv);
+            }
+            else if (IsObjKeyword(p, pLineEnd, "vn"))
+            {
+                XMFLOAT3 normal;
+                valid = (p = ParseFloat(p + 2, pLineEnd, &normal.x)) &&
+                    (p = ParseFloat(p, pLineEnd, &normal.y)) &&
+                    (p = ParseFloat(p, pLineEnd, &normal.z));
+                pChunk->normals.push_back(valid ? ConvertFileNormal(normal) : XMFLOAT3(0.0f, 0.0f, 0.0f));
+            }
+            else if (IsObjKeyword(p, pLineEnd, "f"))
+            {
+                polygon.clear();
+                p = SkipSpaces(p + 1, pLineEnd);
+                while (valid && p < pLineEnd)
+                {
+                    ObjCorner corner;
+                    valid = (p = ParseObjCorner(p, pLineEnd, *pChunk, &corner)) != nullptr;
+                    polygon.push_back(corner);
+                    p = valid ? SkipSpaces(p, pLineEnd) : p;
+                }
+                valid = valid && polygon.size() >= 3;
+
+                // A fan, each triangle turned clockwise.
+                for (size_t i = 1; valid && i + 1 < polygon.size(); i++)
+                {
+                    pChunk->corners.push_back(polygon[0]);
+                    pChunk->corners.push_back(polygon[i + 1]);
+                    pChunk->corners.push_back(polygon[i]);
+                }
+            }
+            if (!valid)
+            {
+                pChunk->error = "Malformed line: " + std::string(pLine, min<size_t>(pLineEnd - pLine, 64));
+                return;
+            }
+            p = pLineEnd + 1;
+        }
+    }
+
+    // Just enough JSON for a glTF header.
+    struct JsonValue
+    {
+        enum Type
+        {
+            TypeNull = 0,
+            TypeBoolean,
+            TypeNumber,
+            TypeString,
+            TypeArray,
+            TypeObject
+        };
+
+        Type type = TypeNull;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> elements;
+        std::vector<std::pair<std::string, JsonValue>> members;
+
+        const JsonValue* Find(const char* name) const
+        {
+            for (const auto& member : members)
+            {
+                if (member.first == name)
+                {
+                    return &member.second;
+                }
+            }
+            return nullptr;
+        }
+
+        const JsonValue* At(double index) const
+        {
+            return (type == TypeArray && index >= 0.0 && index < elements.size()) ? &elements[static_cast<size_t>(index)] : nullptr;
+        }
+
+        double GetNumber(const char* name, double defaultValue) const
+        {
+            const JsonValue* pValue = Find(name);
+            return (pValue && pValue->type == TypeNumber) ? pValue->number : defaultValue;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char* pText, size_t size) : m_p(pText), m_pEnd(pText + size) {}
+
+        bool Parse(JsonValue* pValue)
+        {
+            return ParseValue(pValue, 0) && SkipWhitespace() == m_pEnd;
+        }
+
+    private:
+        const char* SkipWhitespace()
+        {
+            while (m_p < m_pEnd && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n'))
+            {
+                m_p++;
+            }
+            return m_p;
+        }
+
+        bool Expect(char c)
+        {
+            if (SkipWhitespace() < m_pEnd && *m_p == c)
+            {
+                m_p++;
+                return true;
+            }
+            return false;
+        }
+
+        bool ParseString(std::string* pString)
+        {
+            if (!Expect('"'))
+            {
+                return false;
+            }
+            while (m_p < m_pEnd && *m_p != '"')
+            {
+                char c = *m_p++;
+                if (c == '\\')
+                {
+                    if (m_p == m_pEnd)
+                    {
+                        return false;
+                    }
+                    c = *m_p++;
+                    switch (c)
+                    {
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    case 'u':
+                        // Nothing read here is outside ASCII.
+                        if (m_pEnd - m_p < 4)
+                        {
+                            return false;
+                        }
+                        m_p += 4;
+                        c = '?';
+                        break;
+                    }
+                }
+                pString->push_back(c);
+            }
+            return Expect('"');
+        }
+
+        bool ParseValue(JsonValue* pValue, UINT depth)
+        {
+            if (depth > 64 || SkipWhitespace() == m_pEnd)
+            {
+                return false;
+            }
+
+            const char c = *m_p;
+            if (c == '{')
+            {
+                pValue->type = JsonValue::TypeObject;
+                m_p++;
+                if (Expect('}'))
+                {
+                    return true;
+                }
+                do
+                {
+                    pValue->members.emplace_back();
+                    if (!ParseString(&pValue->members.back().first) || !Expect(':') || !ParseValue(&pValue->members.back().second, depth + 1))
+                    {
+                        return false;
+                    }
+                } while (Expect(','));
+                return Expect('}');
+            }
+            if (c == '[')
+            {
+                pValue->type = JsonValue::TypeArray;
+                m_p++;
+                if (Expect(']'))
+                {
+                    return true;
+                }
+                do
+                {
+                    pValue->elements.emplace_back();
+                    if (!ParseValue(&pValue->elements.back(), depth + 1))
+                    {
+                        return false;
+                    }
+                } while (Expect(','));
+                return Expect(']');
+            }
+            if (c == '"')
+            {
+                pValue->type = JsonValue::TypeString;
+                return ParseString(&pValue->string);
+            }
+            if (c == '-' || IsDigit(c))
+            {
+                float number;
+                const char* p = ParseFloat(m_p, m_pEnd, &number);
+                if (!p)
+                {
+                    return false;
+                }
+                // Integers, which is all glTF counts and offsets are, parse exactly.
+                INT64 integer;
+                const char* pInteger = ParseInteger(m_p, m_pEnd, &integer);
+                pValue->type = JsonValue::TypeNumber;
+                pValue->number = (pInteger == p) ? static_cast<double>(integer) : number;
+                m_p = p;
+                return true;
+            }
+            for (const char* keyword : { "true", "false", "null" })
+            {
+                const size_t length = strlen(keyword);
+                if (static_cast<size_t>(m_pEnd - m_p) >= length && memcmp(m_p, keyword, length) == 0)
+                {
+                    pValue->type = (keyword[0] == 'n') ? JsonValue::TypeNull : JsonValue::TypeBoolean;
+                    pValue->number = (keyword[0] == 't') ? 1.0 : 0.0;
+                    m_p += length;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        const char* m_p;
+        const char* m_pEnd;
+    };
+
+    const UINT32 GlbMagic = 0x46546C67;            // "glTF"
+    const UINT32 GlbChunkTypeJson = 0x4E4F534A;    // "JSON"
+    const UINT32 GlbChunkTypeBinary = 0x004E4942;  // "BIN\0"
+
+    const UINT GltfComponentTypeUnsignedByte = 5121;
+    const UINT GltfComponentTypeUnsignedShort = 5123;
+    const UINT GltfComponentTypeUnsignedInt = 5125;
+    const UINT GltfComponentTypeFloat = 5126;
+    const UINT GltfModeTriangles = 4;
+
+    // An accessor's elements in the binary chunk.
+    struct GlbAccessor
+    {
+        const UINT8* pData;
+        size_t stride;
+        size_t count;
+        UINT componentType;
+    };
+
+    bool GetGlbAccessor(const JsonValue& document, const UINT8* pBinary, size_t binarySize, const JsonValue* pIndex, const char* type, GlbAccessor* pResult, std::string* pError)
+    {
+        const JsonValue* pAccessors = document.Find("accessors");
+        const JsonValue* pAccessor = (pAccessors && pIndex) ? pAccessors->At(pIndex->number) : nullptr;
+        const JsonValue* pType = pAccessor ? pAccessor->Find("type") : nullptr;
+        if (!pAccessor || !pType || pType->string != type)
+        {
+            *pError = std::string("Missing or mistyped ") + type + " accessor";
+            return false;
+        }
+        if (pAccessor->Find("sparse"))
+        {
+            *pError = "Sparse accessors aren't supported";
+            return false;
+        }
+
+        const JsonValue* pBufferViews = document.Find("bufferViews");
+        const JsonValue* pViewIndex = pAccessor->Find("bufferView");
+        const JsonValue* pView = (pBufferViews && pViewIndex) ? pBufferViews->At(pViewIndex->number) : nullptr;
+        if (!pView || pView->GetNumber("buffer", 0.0) != 0.0)
+        {
+            *pError = "Accessor data must be in the binary chunk";
+            return false;
+        }
+
+        const UINT componentType = static_cast<UINT>(pAccessor->GetNumber("componentType", 0.0));
+        const size_t componentSize =
+            (componentType == GltfComponentTypeUnsignedByte) ? 1 :
+            (componentType == GltfComponentTypeUnsignedShort) ? 2 :
+            (componentType == GltfComponentTypeUnsignedInt || componentType == GltfComponentTypeFloat) ? 4 : 0;
+        const size_t componentCount = (pType->string == "VEC3") ? 3 : (pType->string == "VEC2") ? 2 : 1;
+        const size_t elementSize = componentSize * componentCount;
+
+        const double viewOffset = pView->GetNumber("byteOffset", 0.0);
+        const double viewLength = pView->GetNumber("byteLength", 0.0);
+        const double accessorOffset = pAccessor->GetNumber("byteOffset", 0.0);
+        const double count = pAccessor->GetNumber("count", 0.0);
+        const double stride = pView->GetNumber("byteStride", static_cast<double>(elementSize));
+        if (elementSize == 0 || count < 1.0 || stride < elementSize ||
+            viewOffset + viewLength > binarySize ||
+            accessorOffset + (count - 1.0) * stride + elementSize > viewLength)
+        {
+            *pError = "Accessor out of bounds or of an unsupported component type";
+            return false;
+        }
+
+        pResult->pData = pBinary + static_cast<size_t>(viewOffset + accessorOffset);
+        pResult->stride = static_cast<size_t>(stride);
+        pResult->count = static_cast<size_t>(count);
+        pResult->componentType = componentType;
+        return true;
+    }
+
+    UINT32 ReadGlbIndex(const GlbAccessor& accessor, size_t i)
+    {
+        const UINT8* p = accessor.pData + i * accessor.stride;
+        switch (accessor.componentType)
+        {
+        case GltfComponentTypeUnsignedByte:
+            return *p;
+        case GltfComponentTypeUnsignedShort:
+        {
+            UINT16 index;
+            memcpy(&index, p, sizeof(index));
+            return index;
+        }
+        default:
+        {
+            UINT32 index;
+            memcpy(&index, p, sizeof(index));
+            return index;
+        }
+        }
+    }
+}
+
+void RunInParallel(UINT count, const std::function<void(UINT)>& function)
+{
+    struct ThreadTask
+    {
+        const std::function<void(UINT)>* pFunction;
+        UINT index;
+
+        static unsigned int WINAPI thunk(LPVOID lpParameter)
+        {
+            const ThreadTask* pTask = reinterpret_cast<const ThreadTask*>(lpParameter);
+            (*pTask->pFunction)(pTask->index);
+            return 0;
+        }
+    };
+
+    std::vector<ThreadTask> tasks(count);
+    std::vector<HANDLE> threadHandles;
+    for (UINT i = 1; i < count; i++)
+    {
+        tasks[i].pFunction = &function;
+        tasks[i].index = i;
+        HANDLE threadHandle = reinterpret_cast<HANDLE>(_beginthreadex(
+            nullptr,
+            0,
+            ThreadTask::thunk,
+            reinterpret_cast<LPVOID>(&tasks[i]),
+            0,
+            nullptr));
+        assert(threadHandle != NULL);
+        threadHandles.push_back(threadHandle);
+    }
+    if (count > 0)
+    {
+        function(0);
+    }
+    if (!threadHandles.empty())
+    {
+        WaitForMultipleObjects(static_cast<DWORD>(threadHandles.size()), threadHandles.data(), TRUE, INFINITE);
+        for (HANDLE threadHandle : threadHandles)
+        {
+            CloseHandle(threadHandle);
+        }
+    }
+}
+
+bool LoadObjMesh(const char* pText, size_t size, UINT threadCount, Mesh* pMesh, std::string* pError)
+{
+    pError->clear();
+    pMesh->vertices.clear();
+    pMesh->indices.clear();
+    pMesh->lods.clear();
+    pMesh->importedNormals = false;
+
+    // Split at line breaks, so that each chunk holds whole lines.
+    const UINT chunkCount = static_cast<UINT>(max<size_t>(min<size_t>(threadCount, size / ObjMinimumChunkSize), 1));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* pEnd = pText + size;
+    const char* pBegin = pText;
+    for (UINT i = 0; i < chunkCount; i++)
+    {
+        const char* pSplit = (i + 1 == chunkCount) ? pEnd : pText + size / chunkCount * (i + 1);
+        if (pSplit < pBegin)
+        {
+            pSplit = pBegin;
+        }
+        const char* pLineEnd = static_cast<const char*>(memchr(pSplit, '\n', pEnd - pSplit));
+        chunks[i].pBegin = pBegin;
+        chunks[i].pEnd = (i + 1 == chunkCount || !pLineEnd) ? pEnd : pLineEnd + 1;
+        pBegin = chunks[i].pEnd;
+    }
+
+    RunInParallel(chunkCount, [&](UINT i) { ParseObjChunk(&chunks[i]); });
+
+    // Where each chunk's elements start in the whole file's.
+    std::vector<size_t> positionBases(chunkCount);
+    std::vector<size_t> uvBases(chunkCount);
+    std::vector<size_t> normalBases(chunkCount);
+    std::vector<size_t> cornerBases(chunkCount);
+    size_t positionCount = 0;
+    size_t uvCount = 0;
+    size_t normalCount = 0;
+    size_t cornerCount = 0;
+    for (UINT i = 0; i < chunkCount; i++)
+    {
+        if (!chunks[i].error.empty())
+        {
+            *pError = chunks[i].error;
+            return false;
+        }
+        positionBases[i] = positionCount;
+        uvBases[i] = uvCount;
+        normalBases[i] = normalCount;
+        cornerBases[i] = cornerCount;
+        positionCount += chunks[i].positions.size();
+        uvCount += chunks[i].uvs.size();
+        normalCount += chunks[i].normals.size();
+        cornerCount += chunks[i].corners.size();
+    }
+    if (positionCount > UINT_MAX || uvCount >= UINT_MAX || normalCount >= UINT_MAX || cornerCount > UINT_MAX)
+    {
+        *pError = "Too many vertices";
+        return false;
+    }
+
+    // Gather the elements, and resolve each corner to the key naming its position,
+    // texture coordinate and normal.
+    std::vector<XMFLOAT3> positions(positionCount);
+    std::vector<XMFLOAT2> uvs(uvCount);
+    std::vector<XMFLOAT3> normals(normalCount);
+    std::vector<ObjVertexKey> keys(cornerCount);
+    std::vector<UINT8> chunkMissesNormals(chunkCount, 0);
+    RunInParallel(chunkCount, [&](UINT i)
+    {
+        ObjChunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBases[i]);
+        std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvBases[i]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBases[i]);
+        for (size_t c = 0; c < chunk.corners.size(); c++)
+        {
+            const ObjCorner& corner = chunk.corners[c];
+            const INT64 position = corner.position + ((corner.flags & ObjCornerPositionRelative) ? static_cast<INT64>(positionBases[i]) : 0);
+            const INT64 uv = corner.uv + ((corner.flags & ObjCornerUvRelative) ? static_cast<INT64>(uvBases[i]) : 0);
+            const INT64 normal = corner.normal + ((corner.flags & ObjCornerNormalRelative) ? static_cast<INT64>(normalBases[i]) : 0);
+            const bool hasUv = !(corner.flags & ObjCornerNoUv);
+            const bool hasNormal = !(corner.flags & ObjCornerNoNormal);
+            if (position < 0 || position >= static_cast<INT64>(positionCount) ||
+                (hasUv && (uv < 0 || uv >= static_cast<INT64>(uvCount))) ||
+                (hasNormal && (normal < 0 || normal >= static_cast<INT64>(normalCount))))
+            {
+                chunk.error = "Face index out of range";
+                return;
+            }
+            ObjVertexKey& key = keys[cornerBases[i] + c];
+            key.position = static_cast<UINT32>(position);
+            key.uv = hasUv ? static_cast<UINT32>(uv) + 1 : 0;
+            key.normal = hasNormal ? static_cast<UINT32>(normal) + 1 : 0;
+            chunkMissesNormals[i] |= hasNormal ? 0 : 1;
+        }
+    });
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            *pError = chunk.error;
+            return false;
+        }
+    }
+
+    // One vertex for each distinct key, numbered in the order the faces first use them,
+    // as a single pass would. Each thread finds the first uses of the keys that hash to
+    // it, so no key is shared.
+    std::vector<UINT32> firstUses(cornerCount);
+    RunInParallel(chunkCount, [&](UINT i)
+    {
+        std::unordered_map<ObjVertexKey, UINT32, ObjVertexKeyHash> firstUse;
+        firstUse.reserve(positionCount * 2 / chunkCount);
+        for (size_t c = 0; c < cornerCount; c++)
+        {
+            const ObjVertexKey& key = keys[c];
+            if ((HashObjVertexKey(key) >> 32) % chunkCount == i)
+            {
+                firstUses[c] = firstUse.emplace(key, static_cast<UINT32>(c)).first->second;
+            }
+        }
+    });
+
+    pMesh->indices.resize(cornerCount);
+    for (size_t c = 0; c < cornerCount; c++)
+    {
+        if (firstUses[c] == c)
+        {
+            const ObjVertexKey& key = keys[c];
+            MeshVertex vertex = { positions[key.position], XMFLOAT2(0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) };
+            if (key.uv != 0)
+            {
+                vertex.uv = uvs[key.uv - 1];
+            }
+            if (key.normal != 0)
+            {
+                vertex.normal = normals[key.normal - 1];
+            }
+            pMesh->indices[c] = static_cast<UINT32>(pMesh->vertices.size());
+            pMesh->vertices.push_back(vertex);
+        }
+        else
+        {
+            pMesh->indices[c] = pMesh->indices[firstUses[c]];
+        }
+    }
+    if (pMesh->indices.empty())
+    {
+        *pError = "No faces";
+        return false;
+    }
+    pMesh->importedNormals = std::find(chunkMissesNormals.begin(), chunkMissesNormals.end(), 1) == chunkMissesNormals.end();
+    return true;
+}
+
+bool LoadGlbMesh(const UINT8* pData, size_t size, Mesh* pMesh, std::string* pError)
+{
+    pError->clear();
+    pMesh->vertices.clear();
+    pMesh->indices.clear();
+    pMesh->lods.clear();
+    pMesh->importedNormals = false;
+
+    UINT32 header[5] = {};
+    if (size >= sizeof(header))
+    {
+        memcpy(header, pData, sizeof(header));
+    }
+    if (size < sizeof(header) || header[0] != GlbMagic || header[1] != 2 || header[2] < sizeof(header))
+    {
+        *pError = "Not a glTF 2.0 binary file";
+        return false;
+    }
+    const size_t fileSize = min<size_t>(header[2], size);
+    const size_t jsonSize = header[3];
+    if (header[4] != GlbChunkTypeJson || jsonSize > fileSize - sizeof(header))
+    {
+        *pError = "The file is truncated";
+        return false;
+    }
+
+    const UINT8* pBinary = nullptr;
+    size_t binarySize = 0;
+    const size_t binaryHeader = sizeof(header) + ((jsonSize + 3) & ~static_cast<size_t>(3));
+    if (binaryHeader + 8 <= fileSize)
+    {
+        UINT32 chunk[2];
+        memcpy(chunk, pData + binaryHeader, sizeof(chunk));
+        if (chunk[1] == GlbChunkTypeBinary && chunk[0] <= fileSize - binaryHeader - 8)
+        {
+            pBinary = pData + binaryHeader + 8;
+            binarySize = chunk[0];
+        }
+    }
+
+    JsonValue document;
+    JsonParser parser(reinterpret_cast<const char*>(pData + sizeof(header)), jsonSize);
+    if (!parser.Parse(&document) || document.type != JsonValue::TypeObject)
+    {
+        *pError = "Malformed glTF JSON";
+        return false;
+    }
+    const JsonValue* pBuffers = document.Find("buffers");
+    const JsonValue* pBuffer = pBuffers ? pBuffers->At(0.0) : nullptr;
+    if (pBuffer && (pBuffer->Find("uri") || !pBinary))
+    {
+        *pError = "External buffers aren't supported";
+        return false;
+    }
+
+    bool everyPrimitiveHasNormals = true;
+    const JsonValue* pMeshes = document.Find("meshes");
+    for (size_t m = 0; pMeshes && m < pMeshes->elements.size(); m++)
+    {
+        const JsonValue* pPrimitives = pMeshes->elements[m].Find("primitives");
+        for (size_t p = 0; pPrimitives && p < pPrimitives->elements.size(); p++)
+        {
+            const JsonValue& primitive = pPrimitives->elements[p];
+            if (primitive.GetNumber("mode", GltfModeTriangles) != GltfModeTriangles)
+            {
+                continue;
+            }
+            const JsonValue* pAttributes = primitive.Find("attributes");
+            GlbAccessor positions, uvs, normals, indices;
+            if (!pAttributes)
+            {
+                *pError = "A primitive has no attributes";
+                return false;
+            }
+            if (!GetGlbAccessor(document, pBinary, binarySize, pAttributes->Find("POSITION"), "VEC3", &positions, pError))
+            {
+                return false;
+            }
+            const JsonValue* pUvIndex = pAttributes->Find("TEXCOORD_0");
+            if (pUvIndex && !GetGlbAccessor(document, pBinary, binarySize, pUvIndex, "VEC2", &uvs, pError))
+            {
+                return false;
+            }
+            const JsonValue* pNormalIndex = pAttributes->Find("NORMAL");
+            if (pNormalIndex && !GetGlbAccessor(document, pBinary, binarySize, pNormalIndex, "VEC3", &normals, pError))
+            {
+                return false;
+            }
+            const JsonValue* pIndicesIndex = primitive.Find("indices");
+            if (pIndicesIndex && !GetGlbAccessor(document, pBinary, binarySize, pIndicesIndex, "SCALAR", &indices, pError))
+            {
+                return false;
+            }
+            if (positions.componentType != GltfComponentTypeFloat || (pUvIndex && (uvs.componentType != GltfComponentTypeFloat || uvs.count != positions.count)) ||
+                (pNormalIndex && (normals.componentType != GltfComponentTypeFloat || normals.count != positions.count)) ||
+                (pIndicesIndex && indices.componentType == GltfComponentTypeFloat))
+            {
+                *pError = "Unsupported attribute format";
+                return false;
+            }
+
+            const size_t baseVertex = pMesh->vertices.size();
+            if (baseVertex + positions.count > UINT_MAX)
+            {
+                *pError = "Too many vertices";
+                return false;
+            }
+            for (size_t i = 0; i < positions.count; i++)
+            {
+                MeshVertex vertex = {};
+                memcpy(&vertex.position, positions.pData + i * positions.stride, sizeof(vertex.position));
+                vertex.position.z = -vertex.position.z;
+                if (pUvIndex)
+                {
+                    memcpy(&vertex.uv, uvs.pData + i * uvs.stride, sizeof(vertex.uv));
+                }
+                if (pNormalIndex)
+                {
+                    memcpy(&vertex.normal, normals.pData + i * normals.stride, sizeof(vertex.normal));
+                    vertex.normal = ConvertFileNormal(vertex.normal);
+                }
+                pMesh->vertices.push_back(vertex);
+            }
+            everyPrimitiveHasNormals = everyPrimitiveHasNormals && pNormalIndex != nullptr;
+
+            // Clockwise: each triangle's last two corners swapped.
+            const size_t indexCount = (pIndicesIndex ? indices.count : positions.count) / 3 * 3;
+            for (size_t i = 0; i < indexCount; i += 3)
+            {
+                const size_t corners[3] = { i, i + 2, i + 1 };
+                for (size_t corner : corners)
+                {
+                    const UINT32 index = pIndicesIndex ? ReadGlbIndex(indices, corner) : static_cast<UINT32>(corner);
+                    if (index >= positions.count)
+                    {
+                        *pError = "Index out of range";
+                        return false;
+                    }
+                    pMesh->indices.push_back(static_cast<UINT32>(baseVertex + index));
+                }
+            }
+        }
+    }
+    if (pMesh->indices.empty())
+    {
+        *pError = "No triangles";
+        return false;
+    }
+    pMesh->importedNormals = everyPrimitiveHasNormals;
+    return true;
+}
+
+bool LoadMeshFile(const std::wstring& path, UINT threadCount, Mesh* pMesh, std::string* pError)
+{
+    pError->clear();
+
+    const size_t dot = path.find_last_of(L'.');
+    const std::wstring extension = (dot == std::wstring::npos) ? L"" : path.substr(dot);
+    const bool obj = _wcsicmp(extension.c_str(), L".obj") == 0;
+    if (!obj && _wcsicmp(extension.c_str(), L".glb") != 0)
+    {
+        *pError = "Only .obj and .glb files can be imported";
+        return false;
+    }
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER fileSize = {};
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+    {
+        *pError = "Can't open the file";
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+        return false;
+    }
+
+    std::vector<UINT8> data(static_cast<size_t>(fileSize.QuadPart));
+    size_t read = 0;
+    while (read < data.size())
+    {
+        DWORD bytesRead = 0;
+        const DWORD request = static_cast<DWORD>(min<size_t>(data.size() - read, 1u << 30));
+        if (!ReadFile(file, data.data() + read, request, &bytesRead, nullptr) || bytesRead == 0)
+        {
+            break;
+        }
+        read += bytesRead;
+    }
+    CloseHandle(file);
+    if (read != data.size())
+    {
+        *pError = "Can't read the file";
+        return false;
+    }
+
+    return obj ?
+        LoadObjMesh(reinterpret_cast<const char*>(data.data()), data.size(), threadCount, pMesh, pError) :
+        LoadGlbMesh(data.data(), data.size(), pMesh, pError);
+}
+
+void FitMeshToSquare(Mesh* pMesh, float halfSize)
+{
+    if (pMesh->vertices.empty())
+    {
+        return;
+    }
+
+    XMVECTOR minimum = XMLoadFloat3(&pMesh->vertices[0].position);
+    XMVECTOR maximum = minimum;
+    for (const MeshVertex& vertex : pMesh->vertices)
+    {
+        const XMVECTOR position = XMLoadFloat3(&vertex.position);
+        minimum = XMVectorMin(minimum, position);
+        maximum = XMVectorMax(maximum, position);
+    }
+    const XMVECTOR centre = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+    const XMVECTOR extent = XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f);
+    const float largest = max(XMVectorGetX(extent), XMVectorGetY(extent));
+    const float scale = (largest > 0.0f) ? halfSize / largest : 1.0f;
+
+    for (MeshVertex& vertex : pMesh->vertices)
+    {
+        XMStoreFloat3(&vertex.position, XMVectorScale(XMVectorSubtract(XMLoadFloat3(&vertex.position), centre), scale));
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "stdafx.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+// The mesh tools' vertex, at full precision. The sample draws it quantised; see
+// VertexQuantization.h.
+struct MeshVertex
+{
+    XMFLOAT3 position;
+    XMFLOAT2 uv;
+    XMFLOAT3 normal;        // Unit length, or zero until ComputeVertexNormals for a file without them.
+};
+
+// One level of detail: a range of the mesh's indices, drawing all of it over the same
+// vertices as the others.
+struct MeshLod
+{
+    UINT firstIndex;
+    UINT indexCount;
+    float error;            // How far simplifying moved the surface, relative to the mesh's radius.
+};
+
+// An indexed triangle list. Once BuildMeshLods has run, indices holds every LOD's one
+// after another, LOD 0 first; until then lods is empty and indices is the whole mesh.
+struct Mesh
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<UINT32> indices;
+    std::vector<MeshLod> lods;
+    bool importedNormals = false;   // Every vertex's normal came from the file.
+};
+
+// Importers for Wavefront OBJ text and binary glTF (.glb), with no dependencies beyond
+// the file itself. Both come out in the sample's conventions: D3D's left-handed axes
+// (the file's z negated, so the side facing +z faces the viewer), clockwise front faces
+// and texture coordinates with v down. Normals are normalised, and importedNormals is
+// only set if the file gives every vertex one. Corners that share a position, texture
+// coordinate and normal share a vertex; materials are ignored.
+
+// Parses OBJ text, splitting it at line breaks into threadCount chunks that parse in
+// parallel. Polygons are triangulated as fans; negative (relative) indices are resolved.
+bool LoadObjMesh(const char* pText, size_t size, UINT threadCount, Mesh* pMesh, std::string* pError);
+
+// Every triangle primitive of every mesh in a .glb, concatenated; node transforms
+// aren't applied. Buffers must live in the file's binary chunk, positions, normals and
+// texture coordinates must be floats.
+bool LoadGlbMesh(const UINT8* pData, size_t size, Mesh* pMesh, std::string* pError);
+
+// Reads the file and picks the importer by its extension: .obj or .glb.
+bool LoadMeshFile(const std::wstring& path, UINT threadCount, Mesh* pMesh, std::string* pError);
+
+// Centres the mesh on the origin and scales it uniformly so that its x and y fit in
+// [-halfSize, halfSize].
+void FitMeshToSquare(Mesh* pMesh, float halfSize);
+
+// Runs function(i) for every i below count, each on a thread of its own; the first on
+// the calling one. Returns once they have all finished. Shared by the mesh tools.
+void RunInParallel(UINT count, const std::function<void(UINT)>& function);
@@ -0,0 +1,410 @@
+#include "stdafx.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+namespace
+{
+    // Forsyth's scoring: the three vertices just used score the same, so that the next
+    // triangle doesn't favour any one edge; older ones less and less. Vertices with few
+    // triangles left score highest, to finish them off before they leave the cache.
+    const UINT ForsythCacheSize = 32;
+    const UINT ForsythMaxValence = 32;
+
+    struct ForsythScores
+    {
+        float cache[ForsythCacheSize];
+        float valence[ForsythMaxValence + 1];
+
+        ForsythScores()
+        {
+            for (UINT i = 0; i < ForsythCacheSize; i++)
+            {
+                cache[i] = (i < 3) ? 0.75f : powf(1.0f - (i - 3) / static_cast<float>(ForsythCacheSize - 3), 1.5f);
+            }
+            valence[0] = 0.0f;
+            for (UINT i = 1; i <= ForsythMaxValence; i++)
+            {
+                valence[i] = 2.0f / sqrtf(static_cast<float>(i));
+            }
+        }
+
+        float VertexScore(int cachePosition, UINT liveTriangles) const
+        {
+            if (liveTriangles == 0)
+            {
+                return -1.0f;
+            }
+            return ((cachePosition >= 0) ? cache[cachePosition] : 0.0f) + valence[min(liveTriangles, ForsythMaxValence)];
+        }
+    };
+
+    // Whether a vertex is still in a FIFO of cacheSize, from when it went in: time only
+    // moves on when something goes in, so anything cacheSize insertions old has left.
+    class FifoCache
+    {
+    public:
+        FifoCache(UINT cacheSize, size_t entryCount) :
+            m_cacheSize(cacheSize),
+            m_time(cacheSize + 1),
+            m_timestamps(entryCount, 0)
+        {
+        }
+
+        // True on a miss, which puts the entry in.
+        bool Access(size_t entry)
+        {
+            if (m_time - m_timestamps[entry] > m_cacheSize)
+            {
+                m_timestamps[entry] = m_time++;
+                return true;
+            }
+            return false;
+        }
+
+        void Clear()
+        {
+            m_time += m_cacheSize + 1;
+        }
+
+    private:
+        UINT m_cacheSize;
+        UINT m_time;
+        std::vector<UINT> m_timestamps;
+    };
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const UINT32* pIndices, size_t indexCount, UINT vertexCount, UINT cacheSize)
+{
+    FifoCache cache(cacheSize, vertexCount);
+    std::vector<bool> used(vertexCount, false);
+    UINT64 usedCount = 0;
+
+    VertexCacheStatistics statistics = {};
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        const UINT32 vertex = pIndices[i];
+        statistics.vertexTransforms += cache.Access(vertex) ? 1 : 0;
+        if (!used[vertex])
+        {
+            used[vertex] = true;
+            usedCount++;
+        }
+    }
+    statistics.acmr = (indexCount >= 3) ? static_cast<float>(statistics.vertexTransforms / static_cast<double>(indexCount / 3)) : 0.0f;
+    statistics.atvr = (usedCount > 0) ? static_cast<float>(statistics.vertexTransforms / static_cast<double>(usedCount)) : 0.0f;
+    return statistics;
+}
+
+VertexFetchStatistics AnalyzeVertexFetch(const UINT32* pIndices, size_t indexCount, UINT vertexCount, UINT vertexStride)
+{
+    const UINT LineSize = 64;
+    const UINT LineCacheSize = 4096 / LineSize;
+
+    FifoCache vertexCache(VertexCacheSize, vertexCount);
+    FifoCache lineCache(LineCacheSize, (static_cast<size_t>(vertexCount) * vertexStride + LineSize - 1) / LineSize);
+    std::vector<bool> used(vertexCount, false);
+    UINT64 usedCount = 0;
+
+    VertexFetchStatistics statistics = {};
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        const UINT32 vertex = pIndices[i];
+        if (vertexCache.Access(vertex))
+        {
+            const size_t firstLine = static_cast<size_t>(vertex) * vertexStride / LineSize;
+            const size_t lastLine = (static_cast<size_t>(vertex) * vertexStride + vertexStride - 1) / LineSize;
+            for (size_t line = firstLine; line <= lastLine; line++)
+            {
+                statistics.bytesFetched += lineCache.Access(line) ? LineSize : 0;
+            }
+        }
+        if (!used[vertex])
+        {
+            used[vertex] = true;
+            usedCount++;
+        }
+    }
+    statistics.overfetch = (usedCount > 0) ? static_cast<float>(statistics.bytesFetched / static_cast<double>(usedCount * vertexStride)) : 0.0f;
+    return statistics;
+}
+
+void OptimizeVertexCache(UINT32* pIndices, size_t indexCount, UINT vertexCount)
+{
+    static const ForsythScores scores;
+    const size_t triangleCount = indexCount / 3;
+    const std::vector<UINT32> input(pIndices, pIndices + triangleCount * 3);
+
+    // Each vertex's triangles; the first liveCounts of them not yet emitted.
+    std::vector<UINT> liveCounts(vertexCount, 0);
+    for (UINT32 vertex : input)
+    {
+        liveCounts[vertex]++;
+    }
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (UINT v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + liveCounts[v];
+    }
+    std::vector<UINT> adjacency(input.size());
+    {
+        std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < input.size(); i++)
+        {
+            adjacency[cursors[input[i]]++] = static_cast<UINT>(i / 3);
+        }
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (UINT v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = scores.VertexScore(-1, liveCounts[v]);
+    }
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<UINT32> cache;
+    std::vector<UINT32> nextCache;
+    cache.reserve(ForsythCacheSize + 3);
+    nextCache.reserve(ForsythCacheSize + 3);
+    size_t restartCursor = 0;
+    size_t best = SIZE_MAX;
+    for (size_t output = 0; output < triangleCount; output++)
+    {
+        if (best == SIZE_MAX)
+        {
+            while (emitted[restartCursor])
+            {
+                restartCursor++;
+            }
+            best = restartCursor;
+        }
+
+        const UINT32* pTriangle = &input[best * 3];
+        memcpy(&pIndices[output * 3], pTriangle, 3 * sizeof(UINT32));
+        emitted[best] = true;
+
+        // Out of its vertices' live triangles.
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            const UINT32 vertex = pTriangle[corner];
+            UINT* pLive = &adjacency[offsets[vertex]];
+            UINT& liveCount = liveCounts[vertex];
+            for (UINT i = 0; i < liveCount; i++)
+            {
+                if (pLive[i] == best)
+                {
+                    pLive[i] = pLive[--liveCount];
+                    break;
+                }
+            }
+        }
+
+        // Its vertices go to the front of the cache, pushing the rest back.
+        nextCache.clear();
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            if (std::find(nextCache.begin(), nextCache.end(), pTriangle[corner]) == nextCache.end())
+            {
+                nextCache.push_back(pTriangle[corner]);
+            }
+        }
+        for (UINT32 vertex : cache)
+        {
+            if (vertex != pTriangle[0] && vertex != pTriangle[1] && vertex != pTriangle[2])
+            {
+                nextCache.push_back(vertex);
+            }
+        }
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            const UINT32 vertex = nextCache[i];
+            cachePositions[vertex] = (i < ForsythCacheSize) ? static_cast<int>(i) : -1;
+            vertexScores[vertex] = scores.VertexScore(cachePositions[vertex], liveCounts[vertex]);
+        }
+        nextCache.resize(min<size_t>(nextCache.size(), ForsythCacheSize));
+        cache.swap(nextCache);
+
+        // The next triangle is the best one the cache's vertices have left.
+        best = SIZE_MAX;
+        float bestScore = -1.0f;
+        for (UINT32 vertex : cache)
+        {
+            const UINT* pLive = &adjacency[offsets[vertex]];
+            for (UINT i = 0; i < liveCounts[vertex]; i++)
+            {
+                const UINT32* pCandidate = &input[pLive[i] * 3];
+                const float score = vertexScores[pCandidate[0]] + vertexScores[pCandidate[1]] + vertexScores[pCandidate[2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = pLive[i];
+                }
+            }
+        }
+    }
+}
+
+void OptimizeOverdraw(UINT32* pIndices, size_t indexCount, const MeshVertex* pVertices, UINT vertexCount, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Hard boundaries: triangles the cache misses entirely, where the cache optimiser
+    // had to start over anyway.
+    std::vector<size_t> hardBoundaries;
+    FifoCache cache(VertexCacheSize, vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        UINT misses = 0;
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            misses += cache.Access(pIndices[t * 3 + corner]) ? 1 : 0;
+        }
+        if (t == 0 || misses == 3)
+        {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // Soft boundaries: within each, wherever the miss ratio from the last boundary, with
+    // the cache cleared there, has come down to threshold times the whole run's.
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+    {
+        const size_t begin = hardBoundaries[h];
+        const size_t end = hardBoundaries[h + 1];
+        cache.Clear();
+        UINT64 runMisses = 0;
+        for (size_t i = begin * 3; i < end * 3; i++)
+        {
+            runMisses += cache.Access(pIndices[i]) ? 1 : 0;
+        }
+        const double target = threshold * static_cast<double>(runMisses) / (end - begin);
+
+        cache.Clear();
+        clusters.push_back(begin);
+        UINT64 misses = 0;
+        size_t clusterBegin = begin;
+        for (size_t t = begin; t < end; t++)
+        {
+            for (UINT corner = 0; corner < 3; corner++)
+            {
+                misses += cache.Access(pIndices[t * 3 + corner]) ? 1 : 0;
+            }
+            if (t + 1 < end && misses <= target * (t + 1 - clusterBegin))
+            {
+                clusterBegin = t + 1;
+                clusters.push_back(clusterBegin);
+                cache.Clear();
+                misses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Each cluster's area-weighted centroid and normal, and the mesh's centroid.
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<XMFLOAT3> centroids(clusterCount);
+    std::vector<XMFLOAT3> normals(clusterCount);
+    XMVECTOR meshCentroid = XMVectorZero();
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const XMVECTOR a = XMLoadFloat3(&pVertices[pIndices[t * 3 + 0]].position);
+            const XMVECTOR b = XMLoadFloat3(&pVertices[pIndices[t * 3 + 1]].position);
+            const XMVECTOR c2 = XMLoadFloat3(&pVertices[pIndices[t * 3 + 2]].position);
+
+            // Clockwise in left-handed axes, so this points out of the front face.
+            const XMVECTOR cross = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c2, a));
+            const float triangleArea = 0.5f * XMVectorGetX(XMVector3Length(cross));
+            centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(a, b), c2), triangleArea / 3.0f));
+            normal = XMVectorAdd(normal, cross);
+            area += triangleArea;
+        }
+        meshCentroid = XMVectorAdd(meshCentroid, centroid);
+        meshArea += area;
+        XMStoreFloat3(&centroids[c], (area > 0.0f) ? XMVectorScale(centroid, 1.0f / area) : centroid);
+        XMStoreFloat3(&normals[c], XMVector3Normalize(normal));
+    }
+    meshCentroid = (meshArea > 0.0f) ? XMVectorScale(meshCentroid, 1.0f / meshArea) : meshCentroid;
+
+    // Outward-facing clusters first: they're the likeliest to hide the rest.
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        const XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&centroids[c]), meshCentroid);
+        sortKeys[c] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[c])));
+    }
+    std::vector<UINT> order(clusterCount);
+    for (UINT c = 0; c < clusterCount; c++)
+    {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](UINT a, UINT b) { return sortKeys[a] > sortKeys[b]; });
+
+    const std::vector<UINT32> input(pIndices, pIndices + triangleCount * 3);
+    UINT32* pOutput = pIndices;
+    for (UINT c : order)
+    {
+        const size_t count = (clusters[c + 1] - clusters[c]) * 3;
+        memcpy(pOutput, &input[clusters[c] * 3], count * sizeof(UINT32));
+        pOutput += count;
+    }
+}
+
+UINT OptimizeVertexFetch(MeshVertex* pVertices, UINT32* pIndices, size_t indexCount, UINT vertexCount)
+{
+    std::vector<UINT32> remap(vertexCount, UINT32_MAX);
+    std::vector<MeshVertex> reordered;
+    reordered.reserve(vertexCount);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        UINT32& index = pIndices[i];
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<UINT32>(reordered.size());
+            reordered.push_back(pVertices[index]);
+        }
+        index = remap[index];
+    }
+    std::copy(reordered.begin(), reordered.end(), pVertices);
+    return static_cast<UINT>(reordered.size());
+}
+
+void OptimizeMesh(Mesh* pMesh)
+{
+    assert(pMesh->lods.empty());
+    const UINT vertexCount = static_cast<UINT>(pMesh->vertices.size());
+    pMesh->indices.resize(pMesh->indices.size() / 3 * 3);
+    OptimizeVertexCache(pMesh->indices.data(), pMesh->indices.size(), vertexCount);
+    OptimizeOverdraw(pMesh->indices.data(), pMesh->indices.size(), pMesh->vertices.data(), vertexCount, OverdrawCacheThreshold);
+    pMesh->vertices.resize(OptimizeVertexFetch(pMesh->vertices.data(), pMesh->indices.data(), pMesh->indices.size(), vertexCount));
+}
+
+DXGI_FORMAT PackIndexBuffer(const std::vector<UINT32>& indices, UINT vertexCount, std::vector<UINT8>* pData)
+{
+    // Triangle lists don't cut strips, so 0xFFFF is an index like any other.
+    if (vertexCount <= 0x10000)
+    {
+        pData->resize(indices.size() * sizeof(UINT16));
+        UINT16* pIndices = reinterpret_cast<UINT16*>(pData->data());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            pIndices[i] = static_cast<UINT16>(indices[i]);
+        }
+        return DXGI_FORMAT_R16_UINT;
+    }
+
+    pData->resize(indices.size() * sizeof(UINT32));
+    memcpy(pData->data(), indices.data(), pData->size());
+    return DXGI_FORMAT_R32_UINT;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "MeshImport.h"
+
+// Reorders an indexed triangle list for the GPU: triangles so that the post-transform
+// vertex cache hits more often and, within that, so that triangles facing out of the
+// mesh come first and hide the ones behind them; then vertices, into the order the
+// triangles first use them, so that fetching them walks memory forwards. None of it
+// changes what is drawn.
+
+// The cache the statistics below model: a FIFO of transformed vertices.
+const UINT VertexCacheSize = 16;
+
+// How far the overdraw pass may let the vertex cache's miss ratio slip: 1.05 allows
+// five percent more vertex transforms.
+const float OverdrawCacheThreshold = 1.05f;
+
+struct VertexCacheStatistics
+{
+    UINT64 vertexTransforms;        // Cache misses.
+    float acmr;                     // Average cache miss ratio: transforms per triangle. 0.5 at best, 3 at worst.
+    float atvr;                     // Average transform to vertex ratio: transforms per vertex used. 1 at best.
+};
+
+struct VertexFetchStatistics
+{
+    UINT64 bytesFetched;            // Cache lines read on cache misses.
+    float overfetch;                // Bytes fetched per byte of vertices used. 1 at best.
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const UINT32* pIndices, size_t indexCount, UINT vertexCount, UINT cacheSize);
+
+// Each vertex cache miss reads the vertex's 64-byte lines through a 4 KB FIFO.
+VertexFetchStatistics AnalyzeVertexFetch(const UINT32* pIndices, size_t indexCount, UINT vertexCount, UINT vertexStride);
+
+// Forsyth's linear-speed vertex cache optimisation: greedily emits the triangle whose
+// vertices score highest, by how recently they were used and how few triangles they
+// have left, and restarts at the next unemitted triangle in the input when none of
+// the cached vertices have any.
+void OptimizeVertexCache(UINT32* pIndices, size_t indexCount, UINT vertexCount);
+
+// Splits the triangles into clusters where the vertex cache restarts, or could restart
+// at a miss ratio no worse than threshold times the cluster's, and sorts the clusters
+// by how far out of the mesh they face (after Sander et al., "Fast triangle reordering
+// for vertex locality and reduced overdraw"). Run it on vertex cache optimised indices.
+void OptimizeOverdraw(UINT32* pIndices, size_t indexCount, const MeshVertex* pVertices, UINT vertexCount, float threshold);
+
+// Renumbers the vertices in the order the indices first use them, dropping unused ones.
+// Returns how many are left, at the front of pVertices.
+UINT OptimizeVertexFetch(MeshVertex* pVertices, UINT32* pIndices, size_t indexCount, UINT vertexCount);
+
+// All three, in order, on a mesh without LODs.
+void OptimizeMesh(Mesh* pMesh);
+
+// The indices at 16 bits if every vertex can be addressed with them, otherwise 32.
+// Returns the format to draw them with.
+DXGI_FORMAT PackIndexBuffer(const std::vector<UINT32>& indices, UINT vertexCount, std::vector<UINT8>* pData);
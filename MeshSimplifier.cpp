@@ -0,0 +1,372 @@
+#include "stdafx.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    // The planes of a vertex's triangles, weighted by their areas: the upper triangle of
+    // the symmetric 4x4 matrix summing each plane's (a, b, c, d)(a, b, c, d)^T, and the
+    // total weight, which turns the summed squared distances into a mean.
+    struct Quadric
+    {
+        double a2, ab, ac, ad;
+        double b2, bc, bd;
+        double c2, cd;
+        double d2;
+        double weight;
+    };
+
+    void AddPlane(Quadric* pQuadric, double a, double b, double c, double d, double weight)
+    {
+        pQuadric->a2 += weight * a * a;
+        pQuadric->ab += weight * a * b;
+        pQuadric->ac += weight * a * c;
+        pQuadric->ad += weight * a * d;
+        pQuadric->b2 += weight * b * b;
+        pQuadric->bc += weight * b * c;
+        pQuadric->bd += weight * b * d;
+        pQuadric->c2 += weight * c * c;
+        pQuadric->cd += weight * c * d;
+        pQuadric->d2 += weight * d * d;
+        pQuadric->weight += weight;
+    }
+
+    Quadric AddQuadrics(const Quadric& q0, const Quadric& q1)
+    {
+        Quadric sum;
+        sum.a2 = q0.a2 + q1.a2;
+        sum.ab = q0.ab + q1.ab;
+        sum.ac = q0.ac + q1.ac;
+        sum.ad = q0.ad + q1.ad;
+        sum.b2 = q0.b2 + q1.b2;
+        sum.bc = q0.bc + q1.bc;
+        sum.bd = q0.bd + q1.bd;
+        sum.c2 = q0.c2 + q1.c2;
+        sum.cd = q0.cd + q1.cd;
+        sum.d2 = q0.d2 + q1.d2;
+        sum.weight = q0.weight + q1.weight;
+        return sum;
+    }
+
+    // The mean squared distance of position from the quadric's planes.
+    double EvaluateQuadric(const Quadric& q, const XMFLOAT3& position)
+    {
+        const double x = position.x;
+        const double y = position.y;
+        const double z = position.z;
+        const double r = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z + q.d2
+            + 2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z + q.ad * x + q.bd * y + q.cd * z);
+        return q.weight > 0.0 ? fabs(r) / q.weight : 0.0;
+    }
+
+    // Each vertex's triangles, as offsets into one list.
+    struct TriangleAdjacency
+    {
+        std::vector<UINT> firstTriangle;    // vertexCount + 1 of them.
+        std::vector<UINT> triangles;
+
+        void Build(const UINT32* pIndices, size_t indexCount, UINT vertexCount)
+        {
+            firstTriangle.assign(vertexCount + 1, 0);
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                firstTriangle[pIndices[i] + 1]++;
+            }
+            for (UINT v = 0; v < vertexCount; v++)
+            {
+                firstTriangle[v + 1] += firstTriangle[v];
+            }
+            triangles.resize(indexCount);
+            std::vector<UINT> next(firstTriangle.begin(), firstTriangle.end() - 1);
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                triangles[next[pIndices[i]]++] = static_cast<UINT>(i / 3);
+            }
+        }
+    };
+
+    // Vertices that mustn't move: those that share their position with another vertex,
+    // along a texture seam, and the ends of edges with other than two triangles, along
+    // an open border or where the surface isn't manifold.
+    std::vector<bool> FindLockedVertices(const MeshVertex* pVertices, UINT vertexCount, const UINT32* pIndices, size_t indexCount)
+    {
+        std::vector<UINT32> byPosition(vertexCount);
+        for (UINT v = 0; v < vertexCount; v++)
+        {
+            byPosition[v] = v;
+        }
+        auto positionLess = [pVertices](UINT32 i, UINT32 j)
+        {
+            const XMFLOAT3& p = pVertices[i].position;
+            const XMFLOAT3& q = pVertices[j].position;
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        };
+        std::sort(byPosition.begin(), byPosition.end(), positionLess);
+
+        std::vector<bool> locked(vertexCount, false);
+        std::vector<UINT32> positionIds(vertexCount);
+        UINT32 positionId = 0;
+        for (UINT i = 0; i < vertexCount; i++)
+        {
+            if (i > 0 && positionLess(byPosition[i - 1], byPosition[i]))
+            {
+                positionId++;
+            }
+            else if (i > 0)
+            {
+                locked[byPosition[i - 1]] = true;
+                locked[byPosition[i]] = true;
+            }
+            positionIds[byPosition[i]] = positionId;
+        }
+
+        std::vector<UINT32> positionIndices(indexCount);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            positionIndices[i] = positionIds[pIndices[i]];
+        }
+        TriangleAdjacency adjacency;
+        adjacency.Build(positionIndices.data(), indexCount, positionId + 1);
+        for (size_t t = 0; t < indexCount / 3; t++)
+        {
+            for (UINT e = 0; e < 3; e++)
+            {
+                const UINT32 a = positionIndices[t * 3 + e];
+                const UINT32 b = positionIndices[t * 3 + (e + 1) % 3];
+                UINT edgeTriangles = 0;
+                for (UINT i = adjacency.firstTriangle[a]; i < adjacency.firstTriangle[a + 1]; i++)
+                {
+                    const UINT32* pTriangle = &positionIndices[adjacency.triangles[i] * 3];
+                    edgeTriangles += (pTriangle[0] == b || pTriangle[1] == b || pTriangle[2] == b);
+                }
+                if (edgeTriangles != 2)
+                {
+                    locked[pIndices[t * 3 + e]] = true;
+                    locked[pIndices[t * 3 + (e + 1) % 3]] = true;
+                }
+            }
+        }
+        return locked;
+    }
+
+    // Whether moving from onto to would turn one of from's triangles that don't also have
+    // to, and so don't collapse with the edge, over or nearly so: by more than about 75
+    // degrees. Small turns still add up over the passes.
+    bool FlipsTriangle(const MeshVertex* pVertices, const UINT32* pIndices, const TriangleAdjacency& adjacency, UINT32 from, UINT32 to)
+    {
+        const XMVECTOR fromPosition = XMLoadFloat3(&pVertices[from].position);
+        const XMVECTOR toPosition = XMLoadFloat3(&pVertices[to].position);
+        for (UINT i = adjacency.firstTriangle[from]; i < adjacency.firstTriangle[from + 1]; i++)
+        {
+            const UINT32* pTriangle = pIndices + adjacency.triangles[i] * 3;
+            if (pTriangle[0] == to || pTriangle[1] == to || pTriangle[2] == to)
+            {
+                continue;
+            }
+            const UINT corner = (pTriangle[0] == from) ? 0 : (pTriangle[1] == from) ? 1 : 2;
+            const XMVECTOR b = XMLoadFloat3(&pVertices[pTriangle[(corner + 1) % 3]].position);
+            const XMVECTOR c = XMLoadFloat3(&pVertices[pTriangle[(corner + 2) % 3]].position);
+            const XMVECTOR before = XMVector3Cross(XMVectorSubtract(b, fromPosition), XMVectorSubtract(c, fromPosition));
+            const XMVECTOR after = XMVector3Cross(XMVectorSubtract(b, toPosition), XMVectorSubtract(c, toPosition));
+            if (XMVectorGetX(XMVector3Dot(before, after)) <= 0.25f * XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct Collapse
+    {
+        double error;       // Mean squared distance, in the mesh's units.
+        UINT32 from;
+        UINT32 to;
+    };
+}
+
+float SimplifyMesh(const MeshVertex* pVertices, UINT vertexCount, const UINT32* pIndices, size_t indexCount, size_t targetIndexCount, float maxError, std::vector<UINT32>* pResult)
+{
+    std::vector<UINT32>& indices = *pResult;
+    indices.assign(pIndices, pIndices + indexCount / 3 * 3);
+    if (vertexCount == 0 || indices.size() <= targetIndexCount)
+    {
+        return 0.0f;
+    }
+
+    // Errors are relative to half the bounding box's diagonal.
+    XMVECTOR minimum = XMLoadFloat3(&pVertices[0].position);
+    XMVECTOR maximum = minimum;
+    for (UINT v = 1; v < vertexCount; v++)
+    {
+        minimum = XMVectorMin(minimum, XMLoadFloat3(&pVertices[v].position));
+        maximum = XMVectorMax(maximum, XMLoadFloat3(&pVertices[v].position));
+    }
+    const double radius = 0.5 * XMVectorGetX(XMVector3Length(XMVectorSubtract(maximum, minimum)));
+    if (radius == 0.0)
+    {
+        return 0.0f;
+    }
+    const double maxSquaredError = (maxError * radius) * (maxError * radius);
+
+    const std::vector<bool> locked = FindLockedVertices(pVertices, vertexCount, indices.data(), indices.size());
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        const XMFLOAT3& a = pVertices[indices[t * 3]].position;
+        const XMFLOAT3& b = pVertices[indices[t * 3 + 1]].position;
+        const XMFLOAT3& c = pVertices[indices[t * 3 + 2]].position;
+        const double abx = b.x - a.x, aby = b.y - a.y, abz = b.z - a.z;
+        const double acx = c.x - a.x, acy = c.y - a.y, acz = c.z - a.z;
+        double nx = aby * acz - abz * acy;
+        double ny = abz * acx - abx * acz;
+        double nz = abx * acy - aby * acx;
+        const double length = sqrt(nx * nx + ny * ny + nz * nz);
+        if (length == 0.0)
+        {
+            continue;
+        }
+        nx /= length;
+        ny /= length;
+        nz /= length;
+        const double d = -(nx * a.x + ny * a.y + nz * a.z);
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            AddPlane(&quadrics[indices[t * 3 + corner]], nx, ny, nz, d, 0.5 * length);
+        }
+    }
+
+    // Passes over the whole mesh: every unlocked vertex proposes its cheapest collapse,
+    // and the cheapest proposals are taken until enough triangles would be gone. Nothing
+    // around a collapsed vertex moves again in the same pass, so the flip tests hold.
+    TriangleAdjacency adjacency;
+    std::vector<Collapse> bestCollapses(vertexCount);
+    std::vector<Collapse> collapses;
+    std::vector<UINT32> remap(vertexCount);
+    for (UINT v = 0; v < vertexCount; v++)
+    {
+        remap[v] = v;
+    }
+    std::vector<UINT32> collapsed;
+    std::vector<bool> touched(vertexCount);
+    double largestError = 0.0;
+    while (indices.size() > targetIndexCount)
+    {
+        adjacency.Build(indices.data(), indices.size(), vertexCount);
+
+        for (UINT v = 0; v < vertexCount; v++)
+        {
+            bestCollapses[v].error = DBL_MAX;
+        }
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            const UINT32 a = indices[i];
+            const UINT32 b = indices[(i % 3 == 2) ? i - 2 : i + 1];
+            const Quadric edgeQuadric = AddQuadrics(quadrics[a], quadrics[b]);
+            if (!locked[a])
+            {
+                const double error = EvaluateQuadric(edgeQuadric, pVertices[b].position);
+                if (error < bestCollapses[a].error)
+                {
+                    bestCollapses[a] = { error, a, b };
+                }
+            }
+            if (!locked[b])
+            {
+                const double error = EvaluateQuadric(edgeQuadric, pVertices[a].position);
+                if (error < bestCollapses[b].error)
+                {
+                    bestCollapses[b] = { error, b, a };
+                }
+            }
+        }
+        collapses.clear();
+        for (UINT v = 0; v < vertexCount; v++)
+        {
+            if (bestCollapses[v].error <= maxSquaredError)
+            {
+                collapses.push_back(bestCollapses[v]);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& c0, const Collapse& c1) { return c0.error < c1.error; });
+
+        // A collapse inside the mesh takes two triangles with it.
+        const size_t collapseGoal = max<size_t>((indices.size() - targetIndexCount) / 6, 1);
+        collapsed.clear();
+        std::fill(touched.begin(), touched.end(), false);
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapsed.size() == collapseGoal)
+            {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to] || FlipsTriangle(pVertices, indices.data(), adjacency, collapse.from, collapse.to))
+            {
+                continue;
+            }
+            for (UINT i = adjacency.firstTriangle[collapse.from]; i < adjacency.firstTriangle[collapse.from + 1]; i++)
+            {
+                const UINT32* pTriangle = &indices[adjacency.triangles[i] * 3];
+                touched[pTriangle[0]] = true;
+                touched[pTriangle[1]] = true;
+                touched[pTriangle[2]] = true;
+            }
+            remap[collapse.from] = collapse.to;
+            collapsed.push_back(collapse.from);
+            quadrics[collapse.to] = AddQuadrics(quadrics[collapse.to], quadrics[collapse.from]);
+            largestError = max(largestError, collapse.error);
+        }
+        if (collapsed.empty())
+        {
+            break;
+        }
+
+        // Moves the collapsed vertices' corners and drops the triangles that vanished.
+        size_t write = 0;
+        for (size_t t = 0; t < indices.size() / 3; t++)
+        {
+            const UINT32 a = remap[indices[t * 3]];
+            const UINT32 b = remap[indices[t * 3 + 1]];
+            const UINT32 c = remap[indices[t * 3 + 2]];
+            if (a != b && b != c && c != a)
+            {
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+        }
+        indices.resize(write);
+        for (UINT32 v : collapsed)
+        {
+            remap[v] = v;
+        }
+    }
+    return static_cast<float>(sqrt(largestError) / radius);
+}
+
+void BuildMeshLods(Mesh* pMesh, UINT maxLodCount)
+{
+    assert(pMesh->lods.empty());
+    const UINT vertexCount = static_cast<UINT>(pMesh->vertices.size());
+    const MeshLod fullDetail = { 0, static_cast<UINT>(pMesh->indices.size()), 0.0f };
+    pMesh->lods.push_back(fullDetail);
+
+    // Errors add up from LOD to LOD, since each is measured against the one before.
+    std::vector<UINT32> source(pMesh->indices);
+    std::vector<UINT32> simplified;
+    float error = 0.0f;
+    while (pMesh->lods.size() < maxLodCount)
+    {
+        error += SimplifyMesh(pMesh->vertices.data(), vertexCount, source.data(), source.size(), source.size() / 6 * 3, MaxLodError - error, &simplified);
+        if (simplified.empty() || simplified.size() > source.size() / 5 * 4)
+        {
+            break;
+        }
+        OptimizeVertexCache(simplified.data(), simplified.size(), vertexCount);
+        const MeshLod lod = { static_cast<UINT>(pMesh->indices.size()), static_cast<UINT>(simplified.size()), error };
+        pMesh->indices.insert(pMesh->indices.end(), simplified.begin(), simplified.end());
+        pMesh->lods.push_back(lod);
+        source.swap(simplified);
+    }
+}
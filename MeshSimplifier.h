@@ -0,0 +1,28 @@
+#pragma once
+#include "stdafx.h"
+#include "MeshImport.h"
+
+// Simplifies meshes into levels of detail by edge collapses ordered by quadric error
+// metrics (Garland and Heckbert, "Surface simplification using quadric error
+// metrics"). A vertex only ever collapses onto a neighbour, keeping that neighbour's
+// position and texture coordinate, so every LOD draws from the original vertices.
+// Vertices on an open border or a texture seam never move: the outline and the
+// texture stay in place however far the rest goes.
+
+// The most LODs BuildMeshLods makes, LOD 0 included. Each has half the triangles of
+// the one before.
+const UINT MaxLodCount = 5;
+
+// How far a LOD may move the surface, relative to the mesh's radius.
+const float MaxLodError = 0.1f;
+
+// Collapses edges of the triangle list pIndices, cheapest first, until no more than
+// targetIndexCount indices are left or the next collapse would cost more than maxError,
+// relative to the mesh's radius. Collapses that would turn a triangle over are
+// skipped. Writes what is left to pResult and returns the largest error it reached.
+float SimplifyMesh(const MeshVertex* pVertices, UINT vertexCount, const UINT32* pIndices, size_t indexCount, size_t targetIndexCount, float maxError, std::vector<UINT32>* pResult);
+
+// Simplifies each LOD from the one before, keeping those that lose at least a fifth of
+// its triangles within MaxLodError, and appends them to the indices, vertex cache
+// optimised. Run it after OptimizeMesh; LOD 0 is the mesh as it was.
+void BuildMeshLods(Mesh* pMesh, UINT maxLodCount);
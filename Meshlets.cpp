@@ -0,0 +1,310 @@
+#include "stdafx.h"
+#include "Meshlets.h"
+#include <algorithm>
+
+namespace
+{
+    // Where the scan restarts. Large enough that the meshlet cut short at each restart
+    // costs nothing measurable.
+    const UINT MeshletBlockTriangles = 32 * 1024;
+
+    const UINT8 NotInMeshlet = 0xff;
+
+    struct MeshletBlock
+    {
+        UINT lod;
+        UINT firstTriangle;
+        UINT endTriangle;
+        std::vector<Meshlet> meshlets;
+        std::vector<UINT32> vertices;
+    };
+
+    // Scans triangles [firstTriangle, endTriangle) into pBlock; local indices go straight
+    // to their place in pTriangles, which mirrors the index buffer. pLocalIndices holds
+    // NotInMeshlet for every vertex on entry and on return.
+    void BuildMeshletBlock(const UINT32* pIndices, UINT firstTriangle, UINT endTriangle, UINT8* pTriangles, UINT8* pLocalIndices, MeshletBlock* pBlock)
+    {
+        Meshlet meshlet = {};
+        meshlet.triangleOffset = firstTriangle * 3;
+
+        auto finish = [&]()
+        {
+            for (UINT i = 0; i < meshlet.vertexCount; i++)
+            {
+                pLocalIndices[pBlock->vertices[meshlet.vertexOffset + i]] = NotInMeshlet;
+            }
+            pBlock->meshlets.push_back(meshlet);
+        };
+
+        for (UINT triangle = firstTriangle; triangle < endTriangle; triangle++)
+        {
+            const UINT32 a = pIndices[triangle * 3];
+            const UINT32 b = pIndices[triangle * 3 + 1];
+            const UINT32 c = pIndices[triangle * 3 + 2];
+            const UINT newVertices = (pLocalIndices[a] == NotInMeshlet)
+                + (pLocalIndices[b] == NotInMeshlet && b != a)
+                + (pLocalIndices[c] == NotInMeshlet && c != a && c != b);
+            if (meshlet.vertexCount + newVertices > MeshletMaxVertices || meshlet.triangleCount == MeshletMaxTriangles)
+            {
+                finish();
+                meshlet.vertexOffset = static_cast<UINT>(pBlock->vertices.size());
+                meshlet.vertexCount = 0;
+                meshlet.triangleOffset = triangle * 3;
+                meshlet.triangleCount = 0;
+            }
+
+            UINT8* pTriangle = pTriangles + triangle * 3;
+            const UINT32 corners[3] = { a, b, c };
+            for (UINT i = 0; i < 3; i++)
+            {
+                UINT8& localIndex = pLocalIndices[corners[i]];
+                if (localIndex == NotInMeshlet)
+                {
+                    localIndex = static_cast<UINT8>(meshlet.vertexCount++);
+                    pBlock->vertices.push_back(corners[i]);
+                }
+                pTriangle[i] = localIndex;
+            }
+            meshlet.triangleCount++;
+        }
+        if (meshlet.triangleCount > 0)
+        {
+            finish();
+        }
+    }
+
+    // The sphere around the vertices' bounding box, and the cone of the triangles'
+    // normals the way meshoptimizer's meshopt_computeClusterBounds finds it.
+    MeshletBounds ComputeMeshletBounds(const MeshletData& meshlets, const Meshlet& meshlet, const MeshVertex* pVertices)
+    {
+        const UINT32* pMeshletVertices = meshlets.vertices.data() + meshlet.vertexOffset;
+        XMVECTOR minimum = XMLoadFloat3(&pVertices[pMeshletVertices[0]].position);
+        XMVECTOR maximum = minimum;
+        for (UINT i = 1; i < meshlet.vertexCount; i++)
+        {
+            const XMVECTOR position = XMLoadFloat3(&pVertices[pMeshletVertices[i]].position);
+            minimum = XMVectorMin(minimum, position);
+            maximum = XMVectorMax(maximum, position);
+        }
+        const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+        float radius = 0.0f;
+        for (UINT i = 0; i < meshlet.vertexCount; i++)
+        {
+            radius = max(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&pVertices[pMeshletVertices[i]].position), center))));
+        }
+
+        // Clockwise front faces: cross(b - a, c - a) points out of the front.
+        XMVECTOR normals[MeshletMaxTriangles];
+        XMVECTOR corners[MeshletMaxTriangles];
+        UINT normalCount = 0;
+        XMVECTOR axis = XMVectorZero();
+        const UINT8* pTriangles = meshlets.triangles.data() + meshlet.triangleOffset;
+        for (UINT triangle = 0; triangle < meshlet.triangleCount; triangle++)
+        {
+            const XMVECTOR a = XMLoadFloat3(&pVertices[pMeshletVertices[pTriangles[triangle * 3]]].position);
+            const XMVECTOR b = XMLoadFloat3(&pVertices[pMeshletVertices[pTriangles[triangle * 3 + 1]]].position);
+            const XMVECTOR c = XMLoadFloat3(&pVertices[pMeshletVertices[pTriangles[triangle * 3 + 2]]].position);
+            const XMVECTOR normal = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+            const float length = XMVectorGetX(XMVector3Length(normal));
+            if (length > 0.0f)
+            {
+                normals[normalCount] = XMVectorScale(normal, 1.0f / length);
+                corners[normalCount] = a;
+                axis = XMVectorAdd(axis, normals[normalCount]);
+                normalCount++;
+            }
+        }
+
+        MeshletBounds bounds = {};
+        XMStoreFloat3(&bounds.center, center);
+        bounds.radius = radius;
+        bounds.coneApex = bounds.center;
+        bounds.coneCutoff = 1.0f;
+        bounds.coneAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+
+        const float axisLength = XMVectorGetX(XMVector3Length(axis));
+        if (axisLength == 0.0f)
+        {
+            return bounds;
+        }
+        axis = XMVectorScale(axis, 1.0f / axisLength);
+        XMStoreFloat3(&bounds.coneAxis, axis);
+
+        float minimumDot = 1.0f;
+        for (UINT i = 0; i < normalCount; i++)
+        {
+            minimumDot = min(minimumDot, XMVectorGetX(XMVector3Dot(axis, normals[i])));
+        }
+        // Normals spread this wide leave nowhere useful to cull from, and a small
+        // minimum would put the apex far away.
+        if (minimumDot <= 0.1f)
+        {
+            return bounds;
+        }
+
+        // Back the apex off along the axis until it is behind every triangle's plane.
+        float maximumT = 0.0f;
+        for (UINT i = 0; i < normalCount; i++)
+        {
+            const float t = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, corners[i]), normals[i])) / XMVectorGetX(XMVector3Dot(axis, normals[i]));
+            maximumT = max(maximumT, t);
+        }
+        XMStoreFloat3(&bounds.coneApex, XMVectorSubtract(center, XMVectorScale(axis, maximumT)));
+        bounds.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+        return bounds;
+    }
+}
+
+void BuildMeshlets(const Mesh& mesh, UINT threadCount, MeshletData* pMeshlets)
+{
+    pMeshlets->meshlets.clear();
+    pMeshlets->bounds.clear();
+    pMeshlets->vertices.clear();
+
+    // Each LOD's triangles in blocks of their own, so that no meshlet spans two.
+    const UINT vertexCount = static_cast<UINT>(mesh.vertices.size());
+    std::vector<MeshLod> lods(mesh.lods);
+    if (lods.empty())
+    {
+        lods.push_back({ 0, static_cast<UINT>(mesh.indices.size()), 0.0f });
+    }
+    std::vector<MeshletBlock> blocks;
+    for (UINT lod = 0; lod < lods.size(); lod++)
+    {
+        const UINT endTriangle = (lods[lod].firstIndex + lods[lod].indexCount) / 3;
+        for (UINT firstTriangle = lods[lod].firstIndex / 3; firstTriangle < endTriangle; firstTriangle += MeshletBlockTriangles)
+        {
+            MeshletBlock block;
+            block.lod = lod;
+            block.firstTriangle = firstTriangle;
+            block.endTriangle = min(firstTriangle + MeshletBlockTriangles, endTriangle);
+            blocks.push_back(block);
+        }
+    }
+    pMeshlets->triangles.resize(mesh.indices.size() / 3 * 3);
+    const UINT blockCount = static_cast<UINT>(blocks.size());
+    threadCount = max(min(threadCount, blockCount), 1u);
+    RunInParallel(threadCount, [&](UINT thread)
+    {
+        std::vector<UINT8> localIndices(vertexCount, NotInMeshlet);
+        for (UINT i = thread; i < blockCount; i += threadCount)
+        {
+            MeshletBlock& block = blocks[i];
+            BuildMeshletBlock(mesh.indices.data(), block.firstTriangle, block.endTriangle, pMeshlets->triangles.data(), localIndices.data(), &block);
+        }
+    });
+
+    pMeshlets->lodMeshlets.assign(lods.size() + 1, 0);
+    for (const MeshletBlock& block : blocks)
+    {
+        pMeshlets->lodMeshlets[block.lod + 1] += static_cast<UINT>(block.meshlets.size());
+        const UINT vertexBase = static_cast<UINT>(pMeshlets->vertices.size());
+        for (Meshlet meshlet : block.meshlets)
+        {
+            meshlet.vertexOffset += vertexBase;
+            pMeshlets->meshlets.push_back(meshlet);
+        }
+        pMeshlets->vertices.insert(pMeshlets->vertices.end(), block.vertices.begin(), block.vertices.end());
+    }
+    for (size_t lod = 0; lod < lods.size(); lod++)
+    {
+        pMeshlets->lodMeshlets[lod + 1] += pMeshlets->lodMeshlets[lod];
+    }
+
+    const UINT meshletCount = static_cast<UINT>(pMeshlets->meshlets.size());
+    pMeshlets->bounds.resize(meshletCount);
+    RunInParallel(threadCount, [&](UINT thread)
+    {
+        const UINT first = static_cast<UINT>(static_cast<UINT64>(meshletCount) * thread / threadCount);
+        const UINT end = static_cast<UINT>(static_cast<UINT64>(meshletCount) * (thread + 1) / threadCount);
+        for (UINT i = first; i < end; i++)
+        {
+            pMeshlets->bounds[i] = ComputeMeshletBounds(*pMeshlets, pMeshlets->meshlets[i], mesh.vertices.data());
+        }
+    });
+}
+
+// Gribb and Hartmann's planes, from the matrix's columns.
+MeshletCullView GetMeshletCullView(FXMMATRIX objectToClip)
+{
+    const XMMATRIX columns = XMMatrixTranspose(objectToClip);
+    const XMVECTOR planes[6] =
+    {
+        XMVectorAdd(columns.r[3], columns.r[0]),         // Left.
+        XMVectorSubtract(columns.r[3], columns.r[0]),    // Right.
+        XMVectorAdd(columns.r[3], columns.r[1]),         // Bottom.
+        XMVectorSubtract(columns.r[3], columns.r[1]),    // Top.
+        columns.r[2],                                   // Near.
+        XMVectorSubtract(columns.r[3], columns.r[2]),    // Far.
+    };
+
+    MeshletCullView view = {};
+    for (UINT i = 0; i < 6; i++)
+    {
+        XMStoreFloat4(&view.planes[i], XMPlaneNormalize(planes[i]));
+    }
+
+    // What the matrix takes to (0, 0, 1, 0): the eye, which a perspective projection
+    // sends to infinity down the z axis, or the direction an orthographic one looks in.
+    XMVECTOR determinant;
+    const XMMATRIX clipToObject = XMMatrixInverse(&determinant, objectToClip);
+    const XMVECTOR eye = clipToObject.r[2];
+    const float w = XMVectorGetW(eye);
+    if (fabsf(w) > 1e-6f * XMVectorGetX(XMVector3Length(eye)))
+    {
+        XMStoreFloat4(&view.eye, XMVectorSetW(XMVectorScale(eye, 1.0f / w), 1.0f));
+    }
+    else
+    {
+        XMStoreFloat4(&view.eye, XMVectorSetW(XMVector3Normalize(eye), 0.0f));
+    }
+    return view;
+}
+
+UINT CullMeshlets(const MeshletData& meshlets, UINT lod, const MeshletCullView& view, std::vector<DrawIndexRange>* pRanges)
+{
+    XMVECTOR planes[6];
+    for (UINT i = 0; i < 6; i++)
+    {
+        planes[i] = XMLoadFloat4(&view.planes[i]);
+    }
+    const XMVECTOR eye = XMLoadFloat4(&view.eye);
+    const bool perspective = (view.eye.w != 0.0f);
+
+    UINT visibleCount = 0;
+    bool extendRange = false;
+    for (UINT m = meshlets.lodMeshlets[lod]; m < meshlets.lodMeshlets[lod + 1]; m++)
+    {
+        const MeshletBounds& bounds = meshlets.bounds[m];
+        const XMVECTOR center = XMLoadFloat3(&bounds.center);
+        const XMVECTOR negativeRadius = XMVectorReplicate(-bounds.radius);
+        bool visible = true;
+        for (UINT i = 0; i < 6 && visible; i++)
+        {
+            visible = !XMVector4Less(XMPlaneDotCoord(planes[i], center), negativeRadius);
+        }
+        if (visible && bounds.coneCutoff < 1.0f)
+        {
+            const XMVECTOR direction = perspective ? XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&bounds.coneApex), eye)) : eye;
+            visible = XMVectorGetX(XMVector3Dot(direction, XMLoadFloat3(&bounds.coneAxis))) < bounds.coneCutoff;
+        }
+
+        if (!visible)
+        {
+            extendRange = false;
+            continue;
+        }
+        const Meshlet& meshlet = meshlets.meshlets[m];
+        if (extendRange)
+        {
+            pRanges->back().indexCount += meshlet.triangleCount * 3;
+        }
+        else
+        {
+            pRanges->push_back({ meshlet.triangleOffset, meshlet.triangleCount * 3 });
+        }
+        extendRange = true;
+        visibleCount++;
+    }
+    return visibleCount;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "stdafx.h"
+#include "DrawBinding.h"
+#include "MeshImport.h"
+
+// Splits a mesh into meshlets, small clusters of triangles that can be culled on their
+// own: a bounding sphere for the frustum and a normal cone for the side of the mesh
+// facing away. The CPU cull below turns the survivors into index ranges to draw.
+
+// The limits mesh shaders are usually built around; local vertex indices fit a byte.
+const UINT MeshletMaxVertices = 64;
+const UINT MeshletMaxTriangles = 124;
+
+// Meshlets take consecutive triangles of the mesh's index buffer, so a meshlet's
+// triangleOffset, which counts local indices, is also where its triangles start in it.
+struct Meshlet
+{
+    UINT vertexOffset;      // Into MeshletData::vertices.
+    UINT vertexCount;
+    UINT triangleOffset;    // Into MeshletData::triangles, three entries to a triangle.
+    UINT triangleCount;
+};
+
+// Every triangle of the meshlet faces away from an eye inside the cone that opens
+// backwards from coneApex around -coneAxis: when
+// dot(normalize(coneApex - eye), coneAxis) >= coneCutoff. A cutoff of 1 never culls.
+struct MeshletBounds
+{
+    XMFLOAT3 center;
+    float radius;
+    XMFLOAT3 coneApex;
+    float coneCutoff;
+    XMFLOAT3 coneAxis;
+};
+
+struct MeshletData
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    std::vector<UINT32> vertices;       // The mesh's vertex indices, by meshlet.
+    std::vector<UINT8> triangles;       // Meshlet-local vertex indices, three to a triangle.
+    std::vector<UINT> lodMeshlets;      // LOD l's meshlets are [lodMeshlets[l], lodMeshlets[l + 1]).
+};
+
+// Scans the triangles in order, starting a new meshlet whenever the next would break
+// a limit, so a vertex cache optimised mesh gives compact ones. The scan restarts at
+// every LOD and at fixed blocks of triangles within them, which threadCount threads
+// share out; the result doesn't depend on how many there are. A mesh without LODs is
+// one.
+void BuildMeshlets(const Mesh& mesh, UINT threadCount, MeshletData* pMeshlets);
+
+// A view to cull against, in the object's space: the frustum's planes, normalized, and
+// the eye as a point (w 1), or for an orthographic view the direction it looks in (w 0).
+struct MeshletCullView
+{
+    XMFLOAT4 planes[6];
+    XMFLOAT4 eye;
+};
+
+// From the object-to-clip matrix, D3D's clip volume: -w <= x, y <= w, 0 <= z <= w.
+MeshletCullView GetMeshletCullView(FXMMATRIX objectToClip);
+
+// Appends the index ranges of LOD lod's meshlets that are in the view and facing it,
+// runs of neighbours merged into one range. Returns how many meshlets survived.
+UINT CullMeshlets(const MeshletData& meshlets, UINT lod, const MeshletCullView& view, std::vector<DrawIndexRange>* pRanges);
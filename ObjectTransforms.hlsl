@@ -0,0 +1,102 @@
+// Per-object transform update and visibility culling, run on the compute queue.
+// Mirrors D3D12HelloTriangle::UpdateObjectTransformsOnCpu and CullAndCompactObjects.
+
+#include "InstanceData.hlsli"
+
+cbuffer ObjectTransformConstants : register(b0)
+{
+    float rotationSin;
+    float rotationCos;
+    uint objectCount;
+    float cullRadius;
+    uint indexCount;
+    uint writeInstances;
+};
+
+// Same 256-byte layout as SceneConstantBuffer, so the draw CBVs can point straight at it.
+struct SceneConstants
+{
+    float4x4 model;
+    float4 padding[12];
+};
+
+// Same layout as IndirectCommand in IndirectDraw.h.
+struct IndirectCommand
+{
+    uint objectIndex;
+    uint indexCountPerInstance;
+    uint instanceCount;
+    uint startIndexLocation;
+    int baseVertexLocation;
+    uint startInstanceLocation;
+};
+
+StructuredBuffer<float4> g_objectPositions : register(t0);
+RWStructuredBuffer<SceneConstants> g_sceneConstants : register(u0);
+RWStructuredBuffer<IndirectCommand> g_indirectCommands : register(u1);
+RWByteAddressBuffer g_indirectCommandCount : register(u2);
+RWStructuredBuffer<PackedInstanceData> g_instances : register(u3);
+
+bool IsObjectVisible(float3 position)
+{
+    return abs(position.x) - cullRadius <= 1.0f && abs(position.y) - cullRadius <= 1.0f;
+}
+
+[numthreads(64, 1, 1)]
+void CSMain(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+    const uint index = dispatchThreadId.x;
+    if (index >= objectCount)
+    {
+        return;
+    }
+
+    const float3 position = g_objectPositions[index].xyz;
+
+    // Objects entirely outside the viewport get a zero matrix; their triangles
+    // collapse to a point and are rejected before rasterization.
+    float4x4 model = (float4x4)0;
+    if (IsObjectVisible(position))
+    {
+        // Rotation about Z followed by the translation, for row vectors.
+        model = float4x4(
+            rotationCos, rotationSin, 0.0f, 0.0f,
+            -rotationSin, rotationCos, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            position.x, position.y, position.z, 1.0f);
+    }
+
+    if (writeInstances != 0)
+    {
+        // The packed rows are the model matrix's first three columns.
+        g_instances[index] = EncodeInstanceData((float3x4)transpose(model));
+    }
+    else
+    {
+        g_sceneConstants[index].model = model;
+    }
+}
+
+// Appends one draw per visible object. The count is zeroed before the dispatch and is
+// read by ExecuteIndirect as the command count.
+[numthreads(64, 1, 1)]
+void CullAndCompactCS(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+    const uint index = dispatchThreadId.x;
+    if (index >= objectCount || !IsObjectVisible(g_objectPositions[index].xyz))
+    {
+        return;
+    }
+
+    uint commandIndex;
+    g_indirectCommandCount.InterlockedAdd(0, 1, commandIndex);
+
+    IndirectCommand command;
+    command.objectIndex = index;
+    command.indexCountPerInstance = indexCount;
+    command.instanceCount = 1;
+    command.startIndexLocation = 0;
+    command.baseVertexLocation = 0;
+    command.startInstanceLocation = 0;
+    g_indirectCommands[commandIndex] = command;
+}
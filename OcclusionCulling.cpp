@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "OcclusionCulling.h"
+#include <algorithm>
+#include <emmintrin.h>
+
+namespace
+{
+    inline float HorizontalMax(__m128 value)
+    {
+        value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+        value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(value);
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer() :
+    m_width(0),
+    m_height(0),
+    m_tileColumnCount(0),
+    m_tileRowCount(0)
+{
+}
+
+void OcclusionBuffer::Create(UINT width, UINT height)
+{
+    m_tileColumnCount = (width + TileSize - 1) / TileSize;
+    m_tileRowCount = (height + TileSize - 1) / TileSize;
+    m_width = m_tileColumnCount * TileSize;
+    m_height = m_tileRowCount * TileSize;
+    m_depths.assign(m_width * m_height, 1.0f);
+    m_tileMaxDepths.assign(m_tileColumnCount * m_tileRowCount, 1.0f);
+}
+
+void OcclusionBuffer::GetBand(UINT threadIndex, UINT threadCount, UINT* pFirstTileRow, UINT* pEndTileRow) const
+{
+    *pFirstTileRow = threadIndex * m_tileRowCount / threadCount;
+    *pEndTileRow = (threadIndex + 1) * m_tileRowCount / threadCount;
+}
+
+void OcclusionBuffer::Clear(UINT firstTileRow, UINT endTileRow)
+{
+    std::fill(m_depths.begin() + firstTileRow * TileSize * m_width, m_depths.begin() + endTileRow * TileSize * m_width, 1.0f);
+    std::fill(m_tileMaxDepths.begin() + firstTileRow * m_tileColumnCount, m_tileMaxDepths.begin() + endTileRow * m_tileColumnCount, 1.0f);
+}
+
+void OcclusionBuffer::RasterizeTriangle(const XMFLOAT2& v0, const XMFLOAT2& v1, const XMFLOAT2& v2, float depth, UINT firstTileRow, UINT endTileRow)
+{
+    const XMFLOAT2 vertices[3] = { v0, v1, v2 };
+    RasterizeConvexPolygon(vertices, _countof(vertices), depth, firstTileRow, endTileRow);
+}
+
+void OcclusionBuffer::RasterizeQuad(FXMMATRIX world, float halfSize, float depth, UINT firstTileRow, UINT endTileRow)
+{
+    XMFLOAT2 corners[4];
+    const XMFLOAT2 local[4] =
+    {
+        XMFLOAT2(-halfSize, halfSize),
+        XMFLOAT2(halfSize, halfSize),
+        XMFLOAT2(halfSize, -halfSize),
+        XMFLOAT2(-halfSize, -halfSize),
+    };
+    for (UINT i = 0; i < 4; i++)
+    {
+        XMStoreFloat2(&corners[i], XMVector2Transform(XMLoadFloat2(&local[i]), world));
+    }
+
+    // In one piece: as two triangles, the pixels along the diagonal would be covered
+    // by neither completely.
+    RasterizeConvexPolygon(corners, _countof(corners), depth, firstTileRow, endTileRow);
+}
+
+void OcclusionBuffer::RasterizeConvexPolygon(const XMFLOAT2* pVertices, UINT vertexCount, float depth, UINT firstTileRow, UINT endTileRow)
+{
+    assert(vertexCount >= 3 && vertexCount <= MaxPolygonVertexCount);
+
+    // To pixels, y down.
+    const float scaleX = 0.5f * m_width;
+    const float scaleY = -0.5f * m_height;
+    XMFLOAT2 p[MaxPolygonVertexCount];
+    for (UINT i = 0; i < vertexCount; i++)
+    {
+        p[i] = XMFLOAT2((pVertices[i].x + 1.0f) * scaleX, (pVertices[i].y - 1.0f) * scaleY);
+    }
+
+    // Wind every polygon the same way, so inside is where all its edges are positive.
+    float area = 0.0f;
+    for (UINT i = 0; i < vertexCount; i++)
+    {
+        const XMFLOAT2& a = p[i];
+        const XMFLOAT2& b = p[(i + 1) % vertexCount];
+        area += a.x * b.y - a.y * b.x;
+    }
+    if (area == 0.0f)
+    {
+        return;
+    }
+    if (area < 0.0f)
+    {
+        std::reverse(p, p + vertexCount);
+    }
+
+    float minX = p[0].x, maxX = p[0].x, minY = p[0].y, maxY = p[0].y;
+    for (UINT i = 1; i < vertexCount; i++)
+    {
+        minX = min(minX, p[i].x);
+        maxX = max(maxX, p[i].x);
+        minY = min(minY, p[i].y);
+        maxY = max(maxY, p[i].y);
+    }
+    const int firstX = max(0, static_cast<int>(floorf(minX))) & ~3;
+    const int endX = min(static_cast<int>(m_width), static_cast<int>(ceilf(maxX)));
+    const int firstY = max(static_cast<int>(firstTileRow * TileSize), static_cast<int>(floorf(minY)));
+    const int endY = min(static_cast<int>(endTileRow * TileSize), static_cast<int>(ceilf(maxY)));
+    if (firstX >= endX || firstY >= endY)
+    {
+        return;
+    }
+
+    // Edge functions at the pixel centres of four neighbouring pixels; each step right
+    // moves them by four pixels. Each edge is pulled in by half a pixel along both axes,
+    // to its value at the pixel's worst corner, so that only pixels the polygon covers
+    // completely are written and the buffer never holds depth the occluder doesn't.
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 edgeA[MaxPolygonVertexCount], edgeStep[MaxPolygonVertexCount];
+    float edgeB[MaxPolygonVertexCount], edgeInset[MaxPolygonVertexCount];
+    for (UINT i = 0; i < vertexCount; i++)
+    {
+        const XMFLOAT2& a = p[i];
+        const XMFLOAT2& b = p[(i + 1) % vertexCount];
+        const float stepX = a.y - b.y;
+        edgeB[i] = b.x - a.x;
+        edgeInset[i] = 0.5f * (fabsf(stepX) + fabsf(edgeB[i]));
+        edgeA[i] = _mm_mul_ps(_mm_set1_ps(stepX), _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(firstX)), laneOffsets), _mm_set1_ps(a.x)));
+        edgeStep[i] = _mm_set1_ps(4.0f * stepX);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 allInside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    const __m128 polygonDepth = _mm_set1_ps(depth);
+    for (int y = firstY; y < endY; y++)
+    {
+        float* pRow = &m_depths[y * m_width];
+        __m128 e[MaxPolygonVertexCount];
+        for (UINT i = 0; i < vertexCount; i++)
+        {
+            e[i] = _mm_add_ps(edgeA[i], _mm_set1_ps(edgeB[i] * (y + 0.5f - p[i].y) - edgeInset[i]));
+        }
+        for (int x = firstX; x < endX; x += 4)
+        {
+            __m128 inside = allInside;
+            for (UINT i = 0; i < vertexCount; i++)
+            {
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(e[i], zero));
+                e[i] = _mm_add_ps(e[i], edgeStep[i]);
+            }
+            if (_mm_movemask_ps(inside) != 0)
+            {
+                const __m128 current = _mm_loadu_ps(pRow + x);
+                const __m128 nearest = _mm_min_ps(current, polygonDepth);
+                _mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::UpdateTiles(UINT firstTileRow, UINT endTileRow)
+{
+    for (UINT tileRow = firstTileRow; tileRow < endTileRow; tileRow++)
+    {
+        for (UINT tileColumn = 0; tileColumn < m_tileColumnCount; tileColumn++)
+        {
+            const float* pTile = &m_depths[tileRow * TileSize * m_width + tileColumn * TileSize];
+            __m128 farthest = _mm_setzero_ps();
+            for (UINT y = 0; y < TileSize; y++)
+            {
+                farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(pTile + y * m_width), _mm_loadu_ps(pTile + y * m_width + 4)));
+            }
+            m_tileMaxDepths[tileRow * m_tileColumnCount + tileColumn] = HorizontalMax(farthest);
+        }
+    }
+}
+
+bool OcclusionBuffer::IsRectVisible(const XMFLOAT2& minCorner, const XMFLOAT2& maxCorner, float depth) const
+{
+    // Every pixel the rectangle touches, rounded outwards.
+    const int firstX = max(0, static_cast<int>(floorf((minCorner.x + 1.0f) * 0.5f * m_width)));
+    const int endX = min(static_cast<int>(m_width), static_cast<int>(ceilf((maxCorner.x + 1.0f) * 0.5f * m_width)));
+    const int firstY = max(0, static_cast<int>(floorf((1.0f - maxCorner.y) * 0.5f * m_height)));
+    const int endY = min(static_cast<int>(m_height), static_cast<int>(ceilf((1.0f - minCorner.y) * 0.5f * m_height)));
+    if (firstX >= endX || firstY >= endY)
+    {
+        return false;
+    }
+
+    for (int tileY = firstY / TileSize; tileY * static_cast<int>(TileSize) < endY; tileY++)
+    {
+        for (int tileX = firstX / TileSize; tileX * static_cast<int>(TileSize) < endX; tileX++)
+        {
+            // Most tiles are settled by their farthest depth alone.
+            if (m_tileMaxDepths[tileY * m_tileColumnCount + tileX] < depth)
+            {
+                continue;
+            }
+
+            const int x0 = max(firstX, tileX * static_cast<int>(TileSize));
+            const int x1 = min(endX, (tileX + 1) * static_cast<int>(TileSize));
+            const int y0 = max(firstY, tileY * static_cast<int>(TileSize));
+            const int y1 = min(endY, (tileY + 1) * static_cast<int>(TileSize));
+            for (int y = y0; y < y1; y++)
+            {
+                const float* pRow = &m_depths[y * m_width];
+                for (int x = x0; x < x1; x++)
+                {
+                    if (pRow[x] >= depth)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
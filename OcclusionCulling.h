@@ -0,0 +1,65 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+using namespace DirectX;
+
+// A low-resolution depth buffer the CPU rasterizes occluders into, for testing object
+// bounds before their draws are recorded. Smaller depths are nearer, as in D3D; the
+// buffer clears to 1. Each occluder is written at a single depth, which has to be the
+// farthest it reaches, and only to the pixels it covers completely, so the buffer never
+// claims more occlusion than there is.
+//
+// The buffer is split into rows of TileSize x TileSize tiles, each keeping the
+// farthest depth it holds. Every call takes a range of tile rows, so threads can each
+// clear, rasterize and update their own band with no synchronization; queries read
+// every band, so they have to wait until all of them are done.
+class OcclusionBuffer
+{
+public:
+    static const UINT TileSize = 8;
+
+    OcclusionBuffer();
+
+    // Rounded up to whole tiles.
+    void Create(UINT width, UINT height);
+
+    UINT GetWidth() const { return m_width; }
+    UINT GetHeight() const { return m_height; }
+    UINT GetTileRowCount() const { return m_tileRowCount; }
+
+    // The tile rows thread threadIndex of threadCount owns.
+    void GetBand(UINT threadIndex, UINT threadCount, UINT* pFirstTileRow, UINT* pEndTileRow) const;
+
+    void Clear(UINT firstTileRow, UINT endTileRow);
+
+    // Vertices in clip space: x and y in [-1, 1], y up. Writes the pixels the triangle
+    // covers completely, not those whose centres it covers.
+    void RasterizeTriangle(const XMFLOAT2& v0, const XMFLOAT2& v1, const XMFLOAT2& v2, float depth, UINT firstTileRow, UINT endTileRow);
+
+    // The sample's quad, corners at (+-halfSize, +-halfSize), placed by world. Rasterized
+    // whole, so that the pixels along its diagonal count as covered.
+    void RasterizeQuad(FXMMATRIX world, float halfSize, float depth, UINT firstTileRow, UINT endTileRow);
+
+    // Recomputes the tiles' farthest depths after rasterizing.
+    void UpdateTiles(UINT firstTileRow, UINT endTileRow);
+
+    // False when every pixel of the clip space rectangle holds something nearer than
+    // depth, or the rectangle is off screen.
+    bool IsRectVisible(const XMFLOAT2& minCorner, const XMFLOAT2& maxCorner, float depth) const;
+
+    const float* GetDepths() const { return m_depths.data(); }
+
+private:
+    static const UINT MaxPolygonVertexCount = 4;
+
+    // The vertices of a convex polygon in clip space, in either winding order.
+    void RasterizeConvexPolygon(const XMFLOAT2* pVertices, UINT vertexCount, float depth, UINT firstTileRow, UINT endTileRow);
+
+    UINT m_width;
+    UINT m_height;
+    UINT m_tileColumnCount;
+    UINT m_tileRowCount;
+    std::vector<float> m_depths;
+    std::vector<float> m_tileMaxDepths;
+};
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "OverdrawEstimator.h"
+#include <algorithm>
+
+OverdrawEstimator::OverdrawEstimator() :
+    m_width(0),
+    m_height(0)
+{
+}
+
+void OverdrawEstimator::Create(UINT width, UINT height)
+{
+    m_width = width;
+    m_height = height;
+    m_depths.assign(width * height, 1.0f);
+    m_counts.assign(width * height, 0);
+}
+
+// Calls pixelFunction(pixelIndex) for every pixel whose centre is inside the quad.
+template <class PixelFunction>
+void OverdrawEstimator::RasterizeQuad(const XMFLOAT4& position, float sine, float cosine, float halfSize, PixelFunction pixelFunction)
+{
+    // Corners counterclockwise in clip space, so clockwise once y points down: inside
+    // is to the right of every edge.
+    const float localCorners[4][2] = { { -halfSize, -halfSize }, { halfSize, -halfSize }, { halfSize, halfSize }, { -halfSize, halfSize } };
+    XMFLOAT2 corners[4];
+    for (UINT i = 0; i < 4; i++)
+    {
+        const float x = localCorners[i][0] * cosine - localCorners[i][1] * sine + position.x;
+        const float y = localCorners[i][0] * sine + localCorners[i][1] * cosine + position.y;
+        corners[i] = XMFLOAT2((x + 1.0f) * 0.5f * m_width, (1.0f - y) * 0.5f * m_height);
+    }
+
+    float minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y;
+    for (UINT i = 1; i < 4; i++)
+    {
+        minX = min(minX, corners[i].x);
+        maxX = max(maxX, corners[i].x);
+        minY = min(minY, corners[i].y);
+        maxY = max(maxY, corners[i].y);
+    }
+    const int firstX = max(0, static_cast<int>(floorf(minX)));
+    const int endX = min(static_cast<int>(m_width), static_cast<int>(ceilf(maxX)));
+    const int firstY = max(0, static_cast<int>(floorf(minY)));
+    const int endY = min(static_cast<int>(m_height), static_cast<int>(ceilf(maxY)));
+
+    for (int y = firstY; y < endY; y++)
+    {
+        const float centerY = y + 0.5f;
+        for (int x = firstX; x < endX; x++)
+        {
+            const float centerX = x + 0.5f;
+            bool inside = true;
+            for (UINT i = 0; i < 4 && inside; i++)
+            {
+                const XMFLOAT2& a = corners[i];
+                const XMFLOAT2& b = corners[(i + 1) % 4];
+                inside = (b.x - a.x) * (centerY - a.y) - (b.y - a.y) * (centerX - a.x) <= 0.0f;
+            }
+            if (inside)
+            {
+                pixelFunction(y * m_width + x);
+            }
+        }
+    }
+}
+
+OverdrawStatistics OverdrawEstimator::Estimate(DepthMode mode, const XMFLOAT4* pPositions, const UINT* pDraws, UINT drawCount, UINT opaqueCount, float rotation, float halfSize)
+{
+    std::fill(m_depths.begin(), m_depths.end(), 1.0f);
+    std::fill(m_counts.begin(), m_counts.end(), static_cast<UINT16>(0));
+
+    OverdrawStatistics statistics = {};
+    const float sine = sinf(rotation);
+    const float cosine = cosf(rotation);
+    auto isClipped = [](float depth) { return depth < 0.0f || depth > 1.0f; };
+
+    if (mode == DepthModePrePass)
+    {
+        for (UINT i = 0; i < opaqueCount; i++)
+        {
+            const XMFLOAT4& position = pPositions[pDraws[i]];
+            if (isClipped(position.z))
+            {
+                continue;
+            }
+            RasterizeQuad(position, sine, cosine, halfSize, [&](UINT pixel)
+            {
+                statistics.depthOnlyCount++;
+                m_depths[pixel] = min(m_depths[pixel], position.z);
+            });
+        }
+    }
+
+    for (UINT i = 0; i < drawCount; i++)
+    {
+        const XMFLOAT4& position = pPositions[pDraws[i]];
+        if (isClipped(position.z))
+        {
+            continue;
+        }
+        const bool opaque = i < opaqueCount;
+        const float depth = position.z;
+        RasterizeQuad(position, sine, cosine, halfSize, [&](UINT pixel)
+        {
+            statistics.rasterizedCount++;
+            bool shaded = true;
+            if (mode == DepthModeTested)
+            {
+                // LESS and writing for opaque draws; LESS_EQUAL without writing for transparent ones.
+                shaded = opaque ? depth < m_depths[pixel] : depth <= m_depths[pixel];
+                if (shaded && opaque)
+                {
+                    m_depths[pixel] = depth;
+                }
+            }
+            else if (mode == DepthModePrePass)
+            {
+                shaded = opaque ? depth == m_depths[pixel] : depth <= m_depths[pixel];
+            }
+
+            if (shaded && m_counts[pixel] < 0xffff)
+            {
+                m_counts[pixel]++;
+            }
+            statistics.shadedCount += shaded ? 1 : 0;
+        });
+    }
+
+    for (UINT16 count : m_counts)
+    {
+        statistics.coveredPixelCount += (count > 0) ? 1 : 0;
+        statistics.maxOverdraw = max(statistics.maxOverdraw, static_cast<UINT>(count));
+        statistics.histogram[min(static_cast<UINT>(count), OverdrawHistogramSize - 1)]++;
+    }
+    return statistics;
+}
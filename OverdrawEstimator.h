@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "DrawOrder.h"
+#include <vector>
+
+// Pixels by how many fragments were shaded in them, from none; the last bucket also
+// holds every pixel shaded more often.
+static const UINT OverdrawHistogramSize = 8;
+
+struct OverdrawStatistics
+{
+    UINT64 coveredPixelCount;       // Pixels at least one fragment was shaded in.
+    UINT64 rasterizedCount;         // Fragments of the shading draws, before the depth test.
+    UINT64 depthOnlyCount;          // Fragments of the depth pre-pass; tested and written, never shaded.
+    UINT64 shadedCount;             // Pixel shader invocations.
+    UINT maxOverdraw;               // The most fragments shaded in one pixel.
+    UINT64 histogram[OverdrawHistogramSize];
+};
+
+// Shaded fragments per covered pixel; 1 means nothing was shaded twice.
+inline double GetAverageOverdraw(const OverdrawStatistics& statistics)
+{
+    return statistics.coveredPixelCount ? static_cast<double>(statistics.shadedCount) / statistics.coveredPixelCount : 0.0;
+}
+
+// Counts on the CPU how often a frame's draws shade each pixel, with the depth test
+// done before shading as early-Z hardware does. The objects are the sample's flat
+// quads, each at its position's depth, so one depth per draw is exact; draws outside
+// the [0, 1] depth range are clipped away. Runs headlessly, to compare depth modes
+// for the same draws.
+class OverdrawEstimator
+{
+public:
+    OverdrawEstimator();
+
+    void Create(UINT width, UINT height);
+
+    UINT GetWidth() const { return m_width; }
+    UINT GetHeight() const { return m_height; }
+
+    // pDraws in submission order, the first opaqueCount of them opaque, as
+    // SortDrawOrder returns them. Each quad has its corners at (+-halfSize, +-halfSize),
+    // rotated by rotation radians, then moved to its object's position.
+    OverdrawStatistics Estimate(DepthMode mode, const XMFLOAT4* pPositions, const UINT* pDraws, UINT drawCount, UINT opaqueCount, float rotation, float halfSize);
+
+    // Fragments shaded per pixel by the last Estimate, row by row from the top.
+    const std::vector<UINT16>& GetCounts() const { return m_counts; }
+
+private:
+    template <class PixelFunction>
+    void RasterizeQuad(const XMFLOAT4& position, float sine, float cosine, float halfSize, PixelFunction pixelFunction);
+
+    UINT m_width;
+    UINT m_height;
+    std::vector<float> m_depths;
+    std::vector<UINT16> m_counts;
+};
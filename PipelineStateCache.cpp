@@ -0,0 +1,474 @@
+#include "stdafx.h"
+#include "PipelineStateCache.h"
+#include "ShaderCache.h"
+#include <fstream>
+#include <process.h>
+
+namespace
+{
+    template<class T>
+    inline UINT64 HashValue(const T& value, UINT64 hash)
+    {
+        return ShaderCache::HashBytes(&value, sizeof(value), hash);
+    }
+
+    inline UINT64 HashShader(const D3D12_SHADER_BYTECODE& shader, UINT64 hash)
+    {
+        hash = HashValue(shader.BytecodeLength, hash);
+        return ShaderCache::HashBytes(shader.pShaderBytecode, shader.BytecodeLength, hash);
+    }
+
+    inline UINT64 HashStencilOp(const D3D12_DEPTH_STENCILOP_DESC& op, UINT64 hash)
+    {
+        hash = HashValue(op.StencilFailOp, hash);
+        hash = HashValue(op.StencilDepthFailOp, hash);
+        hash = HashValue(op.StencilPassOp, hash);
+        return HashValue(op.StencilFunc, hash);
+    }
+}
+
+PipelineStateCache::PipelineStateCache() :
+    m_libraryDirty(false),
+    m_pendingCount(0),
+    m_exiting(false)
+{
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+    Release();
+}
+
+// Fields are hashed one by one so that struct padding never leaks into the key.
+UINT64 PipelineStateCache::HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash)
+{
+    UINT64 hash = HashValue(rootSignatureHash, 14695981039346656037ull);
+
+    const D3D12_SHADER_BYTECODE* shaders[] = { &desc.VS, &desc.PS, &desc.DS, &desc.HS, &desc.GS };
+    for (const D3D12_SHADER_BYTECODE* pShader : shaders)
+    {
+        hash = HashShader(*pShader, hash);
+    }
+
+    hash = HashValue(desc.StreamOutput.NumEntries, hash);
+    for (UINT i = 0; i < desc.StreamOutput.NumEntries; i++)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+        hash = HashValue(entry.Stream, hash);
+        hash = entry.SemanticName ? ShaderCache::HashBytes(entry.SemanticName, strlen(entry.SemanticName) + 1, hash) : hash;
+        hash = HashValue(entry.SemanticIndex, hash);
+        hash = HashValue(entry.StartComponent, hash);
+        hash = HashValue(entry.ComponentCount, hash);
+        hash = HashValue(entry.OutputSlot, hash);
+    }
+    for (UINT i = 0; i < desc.StreamOutput.NumStrides; i++)
+    {
+        hash = HashValue(desc.StreamOutput.pBufferStrides[i], hash);
+    }
+    hash = HashValue(desc.StreamOutput.RasterizedStream, hash);
+
+    const D3D12_BLEND_DESC& blend = desc.BlendState;
+    hash = HashValue(blend.AlphaToCoverageEnable, hash);
+    hash = HashValue(blend.IndependentBlendEnable, hash);
+    for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+    {
+        const D3D12_RENDER_TARGET_BLEND_DESC& target = blend.RenderTarget[i];
+        hash = HashValue(target.BlendEnable, hash);
+        hash = HashValue(target.LogicOpEnable, hash);
+        hash = HashValue(target.SrcBlend, hash);
+        hash = HashValue(target.DestBlend, hash);
+        hash = HashValue(target.BlendOp, hash);
+        hash = HashValue(target.SrcBlendAlpha, hash);
+        hash = HashValue(target.DestBlendAlpha, hash);
+        hash = HashValue(target.BlendOpAlpha, hash);
+        hash = HashValue(target.LogicOp, hash);
+        hash = HashValue(target.RenderTargetWriteMask, hash);
+    }
+    hash = HashValue(desc.SampleMask, hash);
+
+    // D3D12_RASTERIZER_DESC only holds 4-byte fields, so it has no padding.
+    hash = HashValue(desc.RasterizerState, hash);
+
+    const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+    hash = HashValue(depthStencil.DepthEnable, hash);
+    hash = HashValue(depthStencil.DepthWriteMask, hash);
+    hash = HashValue(depthStencil.DepthFunc, hash);
+    hash = HashValue(depthStencil.StencilEnable, hash);
+    hash = HashValue(depthStencil.StencilReadMask, hash);
+    hash = HashValue(depthStencil.StencilWriteMask, hash);
+    hash = HashStencilOp(depthStencil.FrontFace, hash);
+    hash = HashStencilOp(depthStencil.BackFace, hash);
+
+    hash = HashValue(desc.InputLayout.NumElements, hash);
+    for (UINT i = 0; i < desc.InputLayout.NumElements; i++)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+        hash = ShaderCache::HashBytes(element.SemanticName, strlen(element.SemanticName) + 1, hash);
+        hash = HashValue(element.SemanticIndex, hash);
+        hash = HashValue(element.Format, hash);
+        hash = HashValue(element.InputSlot, hash);
+        hash = HashValue(element.AlignedByteOffset, hash);
+        hash = HashValue(element.InputSlotClass, hash);
+        hash = HashValue(element.InstanceDataStepRate, hash);
+    }
+
+    hash = HashValue(desc.IBStripCutValue, hash);
+    hash = HashValue(desc.PrimitiveTopologyType, hash);
+    hash = HashValue(desc.NumRenderTargets, hash);
+    for (UINT i = 0; i < desc.NumRenderTargets; i++)
+    {
+        hash = HashValue(desc.RTVFormats[i], hash);
+    }
+    hash = HashValue(desc.DSVFormat, hash);
+    hash = HashValue(desc.SampleDesc.Count, hash);
+    hash = HashValue(desc.SampleDesc.Quality, hash);
+    hash = HashValue(desc.NodeMask, hash);
+    hash = HashValue(desc.Flags, hash);
+    return hash;
+}
+
+void PipelineStateCache::Create(ID3D12Device* pDevice, const std::wstring& libraryFilename, UINT workerCount, const CreateFunction& create)
+{
+    Release();
+
+    struct threadwrapper
+    {
+        static unsigned int WINAPI thunk(LPVOID lpParameter)
+        {
+            reinterpret_cast<PipelineStateCache*>(lpParameter)->WorkerThread();
+            return 0;
+        }
+    };
+
+    m_device = pDevice;
+    m_create = create;
+    if (!m_create)
+    {
+        m_create = [pDevice](const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, ComPtr<ID3D12PipelineState>& pipelineState)
+        {
+            return pDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+        };
+    }
+    m_libraryFilename = libraryFilename;
+    m_exiting = false;
+    if (m_device)
+    {
+        LoadPipelineLibrary();
+    }
+
+    for (UINT i = 0; i < workerCount; i++)
+    {
+        HANDLE threadHandle = reinterpret_cast<HANDLE>(_beginthreadex(
+            nullptr,
+            0,
+            threadwrapper::thunk,
+            reinterpret_cast<LPVOID>(this),
+            0,
+            nullptr));
+        assert(threadHandle != NULL);
+        m_workerHandles.push_back(threadHandle);
+    }
+}
+
+void PipelineStateCache::Release()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exiting = true;
+    }
+    m_workAvailable.notify_all();
+
+    // Workers drain the queue before they exit.
+    if (!m_workerHandles.empty())
+    {
+        WaitForMultipleObjects(static_cast<DWORD>(m_workerHandles.size()), m_workerHandles.data(), TRUE, INFINITE);
+        for (HANDLE threadHandle : m_workerHandles)
+        {
+            CloseHandle(threadHandle);
+        }
+        m_workerHandles.clear();
+    }
+
+    if (m_device)
+    {
+        SavePipelineLibrary();
+    }
+
+    m_pipelineStates.clear();
+    m_rootSignatures.clear();
+    m_queue.clear();
+    m_pendingCount = 0;
+    m_library.Reset();
+    m_libraryBlob.clear();
+    m_device.Reset();
+    m_create = nullptr;
+}
+
+void PipelineStateCache::RegisterRootSignature(ID3D12RootSignature* pRootSignature, const void* pSerializedBlob, SIZE_T size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RegisteredRootSignature& registered = m_rootSignatures[pRootSignature];
+    registered.rootSignature = pRootSignature;
+    registered.hash = ShaderCache::HashBytes(pSerializedBlob, size);
+}
+
+UINT64 PipelineStateCache::GetKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool persistent;
+    return GetKey(desc, &persistent);
+}
+
+UINT64 PipelineStateCache::GetKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, bool* pPersistent)
+{
+    // Called with m_mutex held.
+    if (desc.pRootSignature == nullptr)
+    {
+        *pPersistent = true;
+        return HashDesc(desc, 0);
+    }
+
+    auto it = m_rootSignatures.find(desc.pRootSignature);
+    if (it == m_rootSignatures.end())
+    {
+        // The address changes from run to run, so the key is only good for this session.
+        *pPersistent = false;
+        return HashDesc(desc, reinterpret_cast<UINT64>(desc.pRootSignature));
+    }
+    *pPersistent = true;
+    return HashDesc(desc, it->second.hash);
+}
+
+std::shared_ptr<PipelineStateCache::PipelineStateRequest> PipelineStateCache::AddRequest(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, bool* pAdded)
+{
+    // Called with m_mutex held.
+    bool persistent;
+    const UINT64 key = GetKey(desc, &persistent);
+    auto it = m_pipelineStates.find(key);
+    if (it != m_pipelineStates.end())
+    {
+        *pAdded = false;
+        return it->second;
+    }
+
+    std::shared_ptr<PipelineStateRequest> request = std::make_shared<PipelineStateRequest>();
+    request->key = key;
+    request->desc = desc;
+    request->rootSignature = desc.pRootSignature;
+    request->persistent = persistent;
+    request->ready = false;
+
+    // Deep copy the shader bytecode and input layout the desc points to.
+    D3D12_SHADER_BYTECODE* shaders[] = { &request->desc.VS, &request->desc.PS, &request->desc.DS, &request->desc.HS, &request->desc.GS };
+    for (UINT i = 0; i < _countof(shaders); i++)
+    {
+        const UINT8* pBytecode = reinterpret_cast<const UINT8*>(shaders[i]->pShaderBytecode);
+        request->shaders[i].assign(pBytecode, pBytecode + shaders[i]->BytecodeLength);
+        shaders[i]->pShaderBytecode = request->shaders[i].empty() ? nullptr : request->shaders[i].data();
+    }
+
+    request->inputElements.assign(desc.InputLayout.pInputElementDescs, desc.InputLayout.pInputElementDescs + desc.InputLayout.NumElements);
+    request->semanticNames.reserve(request->inputElements.size());
+    for (D3D12_INPUT_ELEMENT_DESC& element : request->inputElements)
+    {
+        request->semanticNames.push_back(element.SemanticName);
+        element.SemanticName = request->semanticNames.back().c_str();
+    }
+    request->desc.InputLayout.pInputElementDescs = request->inputElements.empty() ? nullptr : request->inputElements.data();
+
+    // Stream output is not used by this sample and is not copied.
+    assert(desc.StreamOutput.NumEntries == 0);
+    request->desc.CachedPSO = {};
+
+    m_pipelineStates[key] = request;
+    m_pendingCount++;
+    *pAdded = true;
+    return request;
+}
+
+void PipelineStateCache::CreatePipelineState(PipelineStateRequest& request)
+{
+    WCHAR name[32];
+    swprintf_s(name, L"PSO_%016llx", request.key);
+
+    ID3D12PipelineLibrary* pLibrary = request.persistent ? m_library.Get() : nullptr;
+    ComPtr<ID3D12PipelineState> pipelineState;
+    if (!pLibrary || FAILED(pLibrary->LoadGraphicsPipeline(name, &request.desc, IID_PPV_ARGS(&pipelineState))))
+    {
+        ThrowIfFailed(m_create(request.desc, pipelineState));
+        if (pLibrary && SUCCEEDED(pLibrary->StorePipeline(name, pipelineState.Get())))
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_libraryDirty = true;
+        }
+    }
+    CompleteRequest(request, pipelineState.Get());
+}
+
+void PipelineStateCache::CompleteRequest(PipelineStateRequest& request, ID3D12PipelineState* pPipelineState)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        request.pipelineState = pPipelineState;
+        request.ready = true;
+        m_pendingCount--;
+    }
+    m_workCompleted.notify_all();
+}
+
+UINT64 PipelineStateCache::RequestPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    bool added;
+    std::shared_ptr<PipelineStateRequest> request;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        request = AddRequest(desc, &added);
+        if (added)
+        {
+            m_queue.push_back(request);
+        }
+    }
+    if (added)
+    {
+        m_workAvailable.notify_one();
+    }
+    return request->key;
+}
+
+ID3D12PipelineState* PipelineStateCache::GetPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    bool added;
+    std::shared_ptr<PipelineStateRequest> request;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        request = AddRequest(desc, &added);
+    }
+
+    if (added)
+    {
+        // Nobody else knows about it yet, so create it here rather than wait on a worker.
+        try
+        {
+            CreatePipelineState(*request);
+        }
+        catch (HrException&)
+        {
+            // Threads that found the request meanwhile are waiting for it to be ready.
+            CompleteRequest(*request, nullptr);
+            throw;
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_workCompleted.wait(lock, [&request] { return request->ready; });
+    }
+    return request->pipelineState.Get();
+}
+
+ID3D12PipelineState* PipelineStateCache::FindPipelineState(UINT64 key, ID3D12PipelineState* pFallback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pipelineStates.find(key);
+    if (it == m_pipelineStates.end() || !it->second->ready || !it->second->pipelineState)
+    {
+        return pFallback;
+    }
+    return it->second->pipelineState.Get();
+}
+
+bool PipelineStateCache::IsPipelineStateReady(UINT64 key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pipelineStates.find(key);
+    return it != m_pipelineStates.end() && it->second->ready;
+}
+
+void PipelineStateCache::EvictPipelineState(UINT64 key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pipelineStates.find(key);
+    if (it != m_pipelineStates.end() && it->second->ready)
+    {
+        m_pipelineStates.erase(it);
+    }
+}
+
+UINT PipelineStateCache::GetPendingCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pendingCount;
+}
+
+void PipelineStateCache::WorkerThread()
+{
+    for (;;)
+    {
+        std::shared_ptr<PipelineStateRequest> request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this] { return m_exiting || !m_queue.empty(); });
+            if (m_queue.empty())
+            {
+                return;
+            }
+            request = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        try
+        {
+            CreatePipelineState(*request);
+        }
+        catch (HrException&)
+        {
+            // Leave the PSO empty; FindPipelineState keeps returning the fallback.
+            CompleteRequest(*request, nullptr);
+        }
+    }
+}
+
+void PipelineStateCache::LoadPipelineLibrary()
+{
+    ComPtr<ID3D12Device1> device1;
+    if (FAILED(m_device.As(&device1)))
+    {
+        // Pipeline libraries need ID3D12Device1; PSOs are still cached for this session.
+        return;
+    }
+
+    std::ifstream file(m_libraryFilename, std::ios::binary | std::ios::ate);
+    if (file)
+    {
+        m_libraryBlob.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(m_libraryBlob.data()), m_libraryBlob.size());
+    }
+
+    // A blob from another driver or adapter is rejected; start over with an empty library.
+    if (m_libraryBlob.empty() || FAILED(device1->CreatePipelineLibrary(m_libraryBlob.data(), m_libraryBlob.size(), IID_PPV_ARGS(&m_library))))
+    {
+        m_libraryBlob.clear();
+        if (FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&m_library))))
+        {
+            m_library.Reset();
+        }
+    }
+    m_libraryDirty = false;
+}
+
+void PipelineStateCache::SavePipelineLibrary()
+{
+    if (!m_library || !m_libraryDirty)
+    {
+        return;
+    }
+
+    std::vector<UINT8> serialized(m_library->GetSerializedSize());
+    if (SUCCEEDED(m_library->Serialize(serialized.data(), serialized.size())))
+    {
+        std::ofstream file(m_libraryFilename, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(serialized.data()), serialized.size());
+    }
+    m_libraryDirty = false;
+}
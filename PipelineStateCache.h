@@ -0,0 +1,109 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Creates graphics pipeline states on worker threads, deduplicated by a hash of the
+// full D3D12_GRAPHICS_PIPELINE_STATE_DESC, and persists them in an
+// ID3D12PipelineLibrary so that later runs load instead of compile.
+class PipelineStateCache
+{
+public:
+    // Injected so the cache can run against a stub in the headless tests. The default
+    // calls ID3D12Device::CreateGraphicsPipelineState.
+    typedef std::function<HRESULT(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, ComPtr<ID3D12PipelineState>& pipelineState)> CreateFunction;
+
+    PipelineStateCache();
+    ~PipelineStateCache();
+
+    // Without a device there is no pipeline library, and create must be given.
+    void Create(ID3D12Device* pDevice, const std::wstring& libraryFilename, UINT workerCount = 2, const CreateFunction& create = CreateFunction());
+
+    // Waits for pending compiles and writes the pipeline library back to disk.
+    void Release();
+
+    // Identifies the root signature by a hash of the blob it was created from, so that
+    // keys, and the names in the pipeline library, are the same from run to run. PSOs
+    // with a root signature that wasn't registered are keyed by its address and are
+    // never stored in the library. Cleared by Release.
+    void RegisterRootSignature(ID3D12RootSignature* pRootSignature, const void* pSerializedBlob, SIZE_T size);
+
+    // Hashes every field of the desc, including shader bytecode and input layout
+    // contents, with rootSignatureHash standing in for the root signature.
+    static UINT64 HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash);
+
+    // The key RequestPipelineState returns for the desc.
+    UINT64 GetKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+    // Queues the PSO for creation on a worker thread unless it already exists or is
+    // pending. Returns the key to pass to FindPipelineState.
+    UINT64 RequestPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+    // Returns the PSO, creating it on the calling thread or waiting for a worker if needed.
+    // Throws HrException if creating it here fails; the request is still completed, so
+    // that anyone waiting on it gets nullptr instead of blocking.
+    ID3D12PipelineState* GetPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+    // Never blocks: returns pFallback while the PSO is still being created.
+    ID3D12PipelineState* FindPipelineState(UINT64 key, ID3D12PipelineState* pFallback);
+
+    // True once creation has finished, successfully or not.
+    bool IsPipelineStateReady(UINT64 key);
+
+    // Drops the cache's reference. The caller must keep the PSO alive while the GPU uses it.
+    void EvictPipelineState(UINT64 key);
+
+    UINT GetPendingCount();
+
+private:
+    // Owns copies of everything the desc points to, so that it can outlive the caller's stack.
+    struct PipelineStateRequest
+    {
+        UINT64 key;
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+        ComPtr<ID3D12RootSignature> rootSignature;
+        std::vector<UINT8> shaders[5];
+        std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements;
+        std::vector<std::string> semanticNames;
+        ComPtr<ID3D12PipelineState> pipelineState;
+        bool persistent;                            // Its key is stable, so it may go in the library.
+        bool ready;
+    };
+
+    struct RegisteredRootSignature
+    {
+        ComPtr<ID3D12RootSignature> rootSignature;  // Keeps the address from being reused.
+        UINT64 hash;
+    };
+
+    UINT64 GetKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, bool* pPersistent);
+    std::shared_ptr<PipelineStateRequest> AddRequest(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, bool* pAdded);
+    void CreatePipelineState(PipelineStateRequest& request);
+    void CompleteRequest(PipelineStateRequest& request, ID3D12PipelineState* pPipelineState);
+    void WorkerThread();
+    void LoadPipelineLibrary();
+    void SavePipelineLibrary();
+
+    ComPtr<ID3D12Device> m_device;
+    CreateFunction m_create;
+    ComPtr<ID3D12PipelineLibrary> m_library;
+    std::vector<UINT8> m_libraryBlob;               // Must outlive m_library.
+    std::wstring m_libraryFilename;
+    bool m_libraryDirty;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workCompleted;
+    std::unordered_map<UINT64, std::shared_ptr<PipelineStateRequest>> m_pipelineStates;
+    std::unordered_map<ID3D12RootSignature*, RegisteredRootSignature> m_rootSignatures;
+    std::deque<std::shared_ptr<PipelineStateRequest>> m_queue;
+    std::vector<HANDLE> m_workerHandles;
+    UINT m_pendingCount;
+    bool m_exiting;
+};
@@ -0,0 +1,47 @@
+// Runs PortableTests.cpp's checks without the bench target, on any platform; see
+// PortableTests.h for the build line. Exits with 0 when every check passed and 2
+// otherwise, as the bench target does.
+//
+//   PortableTests [-buddy [-rounds <n>]]
+//
+// -buddy runs BuddyBenchmark instead and prints its JSON, exiting with 2 if the
+// allocator's blocks overlapped or didn't add up.
+
+#include "PortableTests.h"
+#include "BuddyBenchmark.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char* argv[])
+{
+    bool runBuddyBenchmark = false;
+    unsigned roundCount = 2000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-buddy") == 0)
+        {
+            runBuddyBenchmark = true;
+        }
+        else if (strcmp(argv[i], "-rounds") == 0 && i + 1 < argc)
+        {
+            roundCount = static_cast<unsigned>(atoi(argv[++i]) > 1 ? atoi(argv[i]) : 1);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-buddy [-rounds <n>]]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (runBuddyBenchmark)
+    {
+        const BuddyBenchmarkResult result = RunBuddyBenchmark(roundCount);
+        printf("%s", WriteBuddyBenchmarkJson(result).c_str());
+        return result.consistent ? 0 : 2;
+    }
+
+    std::vector<HeadlessTest> tests;
+    GetPortableTests(&tests);
+    return RunHeadlessTests(tests) == 0 ? 0 : 2;
+}
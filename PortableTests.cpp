@@ -0,0 +1,605 @@
+#include "PortableTests.h"
+#include "BuddyAllocator.h"
+#include "RingAllocator.h"
+#include "ShaderCacheFormat.h"
+#include "ShaderReloadTracker.h"
+#include <algorithm>
+#include <map>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    bool Fail(std::string* pError, const std::string& what)
+    {
+        *pError = what;
+        return false;
+    }
+
+    bool TestRingAllocatorAllocate(std::string* pError)
+    {
+        RingAllocator ring(1024);
+        if (ring.Allocate(100, 1) != 0)
+        {
+            return Fail(pError, "The first allocation isn't at 0");
+        }
+        if (ring.Allocate(10, 256) != 256)
+        {
+            return Fail(pError, "An allocation after 100 bytes, aligned to 256, isn't at 256");
+        }
+        // The padding counts as used until the frame retires.
+        if (ring.GetUsedSize() != 266)
+        {
+            return Fail(pError, "Alignment padding isn't counted as used");
+        }
+        if (ring.Allocate(0, 1) != RingAllocator::InvalidOffset || ring.Allocate(1025, 1) != RingAllocator::InvalidOffset)
+        {
+            return Fail(pError, "An empty or oversized allocation succeeded");
+        }
+        if (ring.Allocate(758, 1) != 266 || ring.Allocate(1, 1) != RingAllocator::InvalidOffset)
+        {
+            return Fail(pError, "The ring didn't fill exactly to its capacity");
+        }
+        return true;
+    }
+
+    bool TestRingAllocatorWraparound(std::string* pError)
+    {
+        RingAllocator ring(1024);
+        ring.Allocate(600, 1);
+        ring.FinishFrame(1);
+        ring.Allocate(300, 1);
+        ring.FinishFrame(2);
+        ring.Retire(1);
+        if (ring.GetUsedSize() != 300)
+        {
+            return Fail(pError, "Retiring the first frame didn't free its 600 bytes");
+        }
+
+        // 124 bytes are left at the end; 200 don't fit there, so they go to 0 and the
+        // skipped end is charged to the frame.
+        if (ring.Allocate(200, 1) != 0 || ring.GetUsedSize() != 624)
+        {
+            return Fail(pError, "An allocation that doesn't fit at the end didn't wrap to 0");
+        }
+        // Between the wrapped allocation and the oldest live one.
+        if (ring.Allocate(400, 1) != 200 || ring.Allocate(1, 1) != RingAllocator::InvalidOffset)
+        {
+            return Fail(pError, "The space before the oldest live allocation wasn't used exactly");
+        }
+        ring.FinishFrame(3);
+
+        ring.Retire(3);
+        if (ring.GetUsedSize() != 0 || ring.GetPendingFrameCount() != 0)
+        {
+            return Fail(pError, "Retiring every frame left space in use");
+        }
+        // Empty again, so one contiguous range from 0.
+        if (ring.Allocate(1024, 1) != 0)
+        {
+            return Fail(pError, "An empty ring didn't restart at 0");
+        }
+        return true;
+    }
+
+    bool TestRingAllocatorRetire(std::string* pError)
+    {
+        RingAllocator ring(4096);
+        // A frame without allocations has nothing to wait for.
+        ring.FinishFrame(1);
+        if (ring.GetPendingFrameCount() != 0)
+        {
+            return Fail(pError, "An empty frame was queued");
+        }
+        for (uint64_t fence = 2; fence <= 5; fence++)
+        {
+            ring.Allocate(512, 256);
+            ring.FinishFrame(fence);
+        }
+        ring.Retire(1);
+        if (ring.GetPendingFrameCount() != 4 || ring.GetUsedSize() != 2048)
+        {
+            return Fail(pError, "Retiring a fence older than every frame freed space");
+        }
+        ring.Retire(3);
+        if (ring.GetPendingFrameCount() != 2 || ring.GetUsedSize() != 1024)
+        {
+            return Fail(pError, "Retiring fence 3 didn't free exactly frames 2 and 3");
+        }
+        // Allocations not yet finished survive any fence.
+        ring.Allocate(512, 256);
+        ring.Retire(100);
+        if (ring.GetPendingFrameCount() != 0 || ring.GetUsedSize() != 512)
+        {
+            return Fail(pError, "Retiring freed the frame still being recorded");
+        }
+        return true;
+    }
+
+    // Random sizes, alignments and GPU latencies against a list of the live ranges:
+    // nothing handed out may overlap anything still in flight.
+    bool TestRingAllocatorStress(std::string* pError)
+    {
+        struct Range
+        {
+            uint64_t offset;
+            uint64_t size;
+            uint64_t fenceValue;
+        };
+
+        const uint64_t Capacity = 64 * 1024;
+        RingAllocator ring(Capacity);
+        std::vector<Range> live;
+        std::mt19937 random(7);
+        uint64_t completedFence = 0;
+        for (uint64_t fence = 1; fence <= 2000; fence++)
+        {
+            const unsigned allocationCount = random() % 16;
+            for (unsigned i = 0; i < allocationCount; i++)
+            {
+                const uint64_t size = 1 + random() % 4096;
+                const uint64_t alignment = 1ull << (random() % 9);
+                const uint64_t offset = ring.Allocate(size, alignment);
+                if (offset == RingAllocator::InvalidOffset)
+                {
+                    continue;
+                }
+                if (offset % alignment != 0 || offset + size > Capacity)
+                {
+                    return Fail(pError, "An allocation is misaligned or past the end");
+                }
+                for (const Range& range : live)
+                {
+                    if (offset < range.offset + range.size && range.offset < offset + size)
+                    {
+                        return Fail(pError, "An allocation overlaps one still in flight");
+                    }
+                }
+                const Range range = { offset, size, fence };
+                live.push_back(range);
+            }
+            ring.FinishFrame(fence);
+
+            // The GPU finishes anywhere from none to all of the outstanding frames.
+            completedFence += random() % (fence - completedFence + 1);
+            ring.Retire(completedFence);
+            std::vector<Range> stillLive;
+            for (const Range& range : live)
+            {
+                if (range.fenceValue > completedFence)
+                {
+                    stillLive.push_back(range);
+                }
+            }
+            live.swap(stillLive);
+
+            uint64_t liveSize = 0;
+            for (const Range& range : live)
+            {
+                liveSize += range.size;
+            }
+            if (ring.GetUsedSize() < liveSize || ring.GetUsedSize() > Capacity)
+            {
+                return Fail(pError, "The used size doesn't cover the live allocations");
+            }
+        }
+        return true;
+    }
+
+    bool TestBuddyAllocatorSplitAndMerge(std::string* pError)
+    {
+        BuddyAllocator buddy(1024, 64);
+        const uint64_t a = buddy.Allocate(64, 1);
+        const uint64_t b = buddy.Allocate(64, 1);
+        const uint64_t c = buddy.Allocate(128, 1);
+        if (a != 0 || b != 64 || c != 128)
+        {
+            return Fail(pError, "Splitting didn't hand out the lowest free buddies");
+        }
+        if (buddy.GetUsedSize() != 256 || buddy.GetLargestFreeBlock() != 512)
+        {
+            return Fail(pError, "The split left the wrong free blocks");
+        }
+        buddy.Free(b);
+        buddy.Free(a);
+        buddy.Free(c);
+        if (buddy.GetUsedSize() != 0 || buddy.GetLargestFreeBlock() != 1024 || buddy.GetFragmentation() != 0.0f)
+        {
+            return Fail(pError, "Freeing everything didn't merge back into one block");
+        }
+        return true;
+    }
+
+    bool TestBuddyAllocatorSizes(std::string* pError)
+    {
+        BuddyAllocator buddy(1024, 64);
+        // Rounded up to a power of two and to the minimum block; aligned to the block size.
+        const uint64_t small = buddy.Allocate(1, 1);
+        const uint64_t aligned = buddy.Allocate(64, 256);
+        const uint64_t odd = buddy.Allocate(300, 1);
+        if (buddy.GetAllocationSize(small) != 64 || aligned % 256 != 0 || buddy.GetAllocationSize(aligned) != 256 ||
+            odd % 512 != 0 || buddy.GetAllocationSize(odd) != 512)
+        {
+            return Fail(pError, "A request wasn't rounded up to an aligned power of two");
+        }
+        if (buddy.Allocate(0, 1) != BuddyAllocator::InvalidOffset || buddy.Allocate(2048, 1) != BuddyAllocator::InvalidOffset ||
+            buddy.Allocate(256, 1) != BuddyAllocator::InvalidOffset)
+        {
+            return Fail(pError, "An empty, oversized or unplaceable request succeeded");
+        }
+        return true;
+    }
+
+    bool TestBuddyAllocatorFragmentation(std::string* pError)
+    {
+        BuddyAllocator buddy(1024, 64);
+        std::vector<uint64_t> offsets;
+        for (int i = 0; i < 16; i++)
+        {
+            offsets.push_back(buddy.Allocate(64, 1));
+        }
+        if (buddy.Allocate(64, 1) != BuddyAllocator::InvalidOffset || buddy.GetFragmentation() != 0.0f)
+        {
+            return Fail(pError, "A full allocator took another block or reported fragmentation");
+        }
+        // Every other block: 512 bytes free, none of it in a piece over 64.
+        for (size_t i = 0; i < offsets.size(); i += 2)
+        {
+            buddy.Free(offsets[i]);
+        }
+        if (buddy.GetLargestFreeBlock() != 64 || buddy.GetFragmentation() != 0.875f || buddy.Allocate(128, 1) != BuddyAllocator::InvalidOffset)
+        {
+            return Fail(pError, "Alternate frees didn't leave 512 bytes in 64-byte pieces");
+        }
+        return true;
+    }
+
+    bool TestBuddyAllocatorStress(std::string* pError)
+    {
+        const uint64_t Size = 1 << 20;
+        BuddyAllocator buddy(Size, 256);
+        std::vector<uint64_t> live;
+        std::mt19937 random(27);
+        for (int step = 0; step < 20000; step++)
+        {
+            if (!live.empty() && random() % 2 == 0)
+            {
+                const size_t index = random() % live.size();
+                buddy.Free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+            else
+            {
+                const uint64_t alignment = 1ull << (random() % 12);
+                const uint64_t offset = buddy.Allocate(1 + random() % 8192, alignment);
+                if (offset != BuddyAllocator::InvalidOffset)
+                {
+                    if (offset % alignment != 0)
+                    {
+                        return Fail(pError, "An allocation is misaligned");
+                    }
+                    live.push_back(offset);
+                }
+            }
+
+            if (step % 100 == 0)
+            {
+                std::vector<uint64_t> sorted = live;
+                std::sort(sorted.begin(), sorted.end());
+                uint64_t usedSize = 0;
+                uint64_t end = 0;
+                for (uint64_t offset : sorted)
+                {
+                    if (offset < end)
+                    {
+                        return Fail(pError, "Two live blocks overlap");
+                    }
+                    end = offset + buddy.GetAllocationSize(offset);
+                    usedSize += buddy.GetAllocationSize(offset);
+                }
+                if (end > Size || usedSize != buddy.GetUsedSize() || buddy.GetAllocationCount() != live.size())
+                {
+                    return Fail(pError, "The live blocks don't add up to the used size");
+                }
+            }
+        }
+        for (uint64_t offset : live)
+        {
+            buddy.Free(offset);
+        }
+        if (buddy.GetLargestFreeBlock() != Size)
+        {
+            return Fail(pError, "Freeing everything didn't merge back into one block");
+        }
+        return true;
+    }
+
+    // D3D_SHADER_MACRO's members, for ComputeShaderCacheKey.
+    struct TestShaderMacro
+    {
+        const char* Name;
+        const char* Definition;
+    };
+
+    bool TestShaderCacheKey(std::string* pError)
+    {
+        // FNV-1a's published vectors.
+        if (HashShaderCacheBytes("", 0) != 0xcbf29ce484222325ull || HashShaderCacheBytes("a", 1) != 0xaf63dc4c8601ec8cull)
+        {
+            return Fail(pError, "HashShaderCacheBytes isn't 64-bit FNV-1a");
+        }
+
+        const TestShaderMacro defines[] = { { "A", "1" }, { nullptr, nullptr } };
+        const TestShaderMacro otherDefines[] = { { "A", "2" }, { nullptr, nullptr } };
+        const TestShaderMacro joined[] = { { "AB", "" }, { nullptr, nullptr } };
+        const TestShaderMacro split[] = { { "A", "B" }, { nullptr, nullptr } };
+        const TestShaderMacro* const pNoDefines = nullptr;
+        const uint64_t key = ComputeShaderCacheKey(1, defines, "VSMain", "vs_5_0", 0);
+        if (key != ComputeShaderCacheKey(1, defines, "VSMain", "vs_5_0", 0))
+        {
+            return Fail(pError, "The same shader got two keys");
+        }
+        const uint64_t others[] =
+        {
+            ComputeShaderCacheKey(2, defines, "VSMain", "vs_5_0", 0),
+            ComputeShaderCacheKey(1, otherDefines, "VSMain", "vs_5_0", 0),
+            ComputeShaderCacheKey(1, pNoDefines, "VSMain", "vs_5_0", 0),
+            ComputeShaderCacheKey(1, defines, "PSMain", "vs_5_0", 0),
+            ComputeShaderCacheKey(1, defines, "VSMain", "vs_5_1", 0),
+            ComputeShaderCacheKey(1, defines, "VSMain", "vs_5_0", 1),
+        };
+        for (uint64_t other : others)
+        {
+            if (other == key)
+            {
+                return Fail(pError, "Changing the source, a define, the entry point, the target or the flags kept the key");
+            }
+        }
+        if (ComputeShaderCacheKey(1, joined, "VSMain", "vs_5_0", 0) == ComputeShaderCacheKey(1, split, "VSMain", "vs_5_0", 0))
+        {
+            return Fail(pError, "A define's name ran into its definition");
+        }
+        return true;
+    }
+
+    bool TestShaderSourceHasher(std::string* pError)
+    {
+        std::map<std::wstring, std::string> files;
+        files[L"assets/shaders.hlsl"] = "#include \"InstanceData.hlsli\"\nfloat4 VSMain() : SV_POSITION { return 0; }\n";
+        files[L"assets/InstanceData.hlsli"] = "#include \"shaders.hlsl\"\nstruct InstanceData { float4 row0; };\n";
+        files[L"assets/Missing.hlsl"] = "#include \"Nowhere.hlsli\"\n";
+        auto readFile = [&files](const std::wstring& filename, std::string* pText)
+        {
+            const auto file = files.find(filename);
+            if (file == files.end())
+            {
+                return false;
+            }
+            *pText = file->second;
+            return true;
+        };
+
+        // The include cycle has to end, and a file that isn't there hashes as 0.
+        ShaderSourceHasher hasher(readFile);
+        const uint64_t hash = hasher.HashFile(L"assets/shaders.hlsl");
+        if (hash == 0 || hasher.HashFile(L"assets/Nowhere.hlsl") != 0 || hasher.HashFile(L"assets/Missing.hlsl") == 0)
+        {
+            return Fail(pError, "A source, or one with a missing include, hashed as missing");
+        }
+
+        // Hashes are kept until Clear, then an edited include changes the includer's.
+        files[L"assets/InstanceData.hlsli"] += "// edited\n";
+        if (hasher.HashFile(L"assets/shaders.hlsl") != hash)
+        {
+            return Fail(pError, "A source was read again before Clear");
+        }
+        hasher.Clear();
+        if (hasher.HashFile(L"assets/shaders.hlsl") == hash)
+        {
+            return Fail(pError, "Editing an included file kept the includer's hash");
+        }
+        return true;
+    }
+
+    bool TestShaderCacheFile(std::string* pError)
+    {
+        const std::string vertexShader = "vertex shader bytecode";
+        const std::string pixelShader = "pixel";
+        std::map<uint64_t, ShaderCacheBlob> shaders;
+        shaders[7] = { vertexShader.data(), vertexShader.size() };
+        shaders[3] = { pixelShader.data(), pixelShader.size() };
+
+        ShaderCacheIndex empty;
+        std::vector<uint8_t> file;
+        WriteShaderCacheFile(empty, shaders, &file);
+
+        ShaderCacheIndex index;
+        ShaderCacheBlob blob = {};
+        if (!index.Open(file.data(), file.size()) || index.GetEntryCount() != 2 || index.GetEntry(0).key != 3)
+        {
+            return Fail(pError, "A written file didn't open with its entries sorted");
+        }
+        if (!index.Find(7, &blob) || std::string(static_cast<const char*>(blob.pData), blob.size) != vertexShader ||
+            !index.Find(3, &blob) || std::string(static_cast<const char*>(blob.pData), blob.size) != pixelShader || index.Find(5, &blob))
+        {
+            return Fail(pError, "A lookup in the written file found the wrong bytecode");
+        }
+
+        // Broken files read as empty.
+        std::vector<uint8_t> broken = file;
+        broken[0] ^= 1;
+        ShaderCacheIndex brokenIndex;
+        if (brokenIndex.Open(broken.data(), broken.size()) || brokenIndex.GetEntryCount() != 0)
+        {
+            return Fail(pError, "A file with the wrong magic opened");
+        }
+        if (brokenIndex.Open(file.data(), file.size() - 1) || brokenIndex.Open(file.data(), sizeof(ShaderCacheHeader) - 1))
+        {
+            return Fail(pError, "A truncated file opened");
+        }
+        broken = file;
+        reinterpret_cast<ShaderCacheEntry*>(broken.data() + sizeof(ShaderCacheHeader))[1].key = 1;
+        if (brokenIndex.Open(broken.data(), broken.size()))
+        {
+            return Fail(pError, "A file with its keys out of order opened");
+        }
+        return true;
+    }
+
+    // Shaders used in a session go in with everything the file already had, replacing
+    // nothing but their own keys.
+    bool TestShaderCacheMerge(std::string* pError)
+    {
+        const std::string precompiled[] = { "debug vertex shader", "debug pixel shader", "old compute shader" };
+        std::map<uint64_t, ShaderCacheBlob> shaders;
+        for (uint64_t key = 0; key < 3; key++)
+        {
+            shaders[10 + key] = { precompiled[key].data(), precompiled[key].size() };
+        }
+        std::vector<uint8_t> file;
+        WriteShaderCacheFile(ShaderCacheIndex(), shaders, &file);
+        ShaderCacheIndex existing;
+        existing.Open(file.data(), file.size());
+
+        const std::string compiled = "new compute shader";
+        std::map<uint64_t, ShaderCacheBlob> used;
+        ShaderCacheBlob blob = {};
+        existing.Find(10, &blob);
+        used[10] = blob;
+        used[12] = { compiled.data(), compiled.size() };
+        used[20] = { compiled.data(), compiled.size() };
+        std::vector<uint8_t> merged;
+        WriteShaderCacheFile(existing, used, &merged);
+
+        ShaderCacheIndex index;
+        if (!index.Open(merged.data(), merged.size()) || index.GetEntryCount() != 4)
+        {
+            return Fail(pError, "Merging dropped or duplicated entries");
+        }
+        const uint64_t keys[] = { 10, 11, 12, 20 };
+        const std::string expected[] = { precompiled[0], precompiled[1], compiled, compiled };
+        for (int i = 0; i < 4; i++)
+        {
+            if (!index.Find(keys[i], &blob) || std::string(static_cast<const char*>(blob.pData), blob.size) != expected[i])
+            {
+                return Fail(pError, "A merged entry has the wrong bytecode");
+            }
+        }
+        return true;
+    }
+
+    bool TestShaderReloadTracker(std::string* pError)
+    {
+        // The sample's layout: two sources, both including InstanceData.hlsli, with three
+        // and two entry points.
+        std::map<std::wstring, std::string> files;
+        files[L"assets/shaders.hlsl"] = "#include \"InstanceData.hlsli\"\nfloat4 VSMain() : SV_POSITION { return 0; }\n";
+        files[L"assets/ObjectTransforms.hlsl"] = "#include \"InstanceData.hlsli\"\n[numthreads(64, 1, 1)] void CSMain() {}\n";
+        files[L"assets/InstanceData.hlsli"] = "struct InstanceData { float4 row0; };\n";
+        ShaderReloadTracker tracker([&files](const std::wstring& filename, std::string* pText)
+        {
+            const auto file = files.find(filename);
+            if (file == files.end())
+            {
+                return false;
+            }
+            *pText = file->second;
+            return true;
+        });
+        tracker.Start({ L"assets/shaders.hlsl", L"assets/shaders.hlsl", L"assets/ObjectTransforms.hlsl", L"assets/shaders.hlsl", L"assets/ObjectTransforms.hlsl" });
+
+        // The stub compiler fails a shader whose source or include contains "error".
+        std::vector<size_t> compiled;
+        auto compile = [&files, &compiled](size_t shader)
+        {
+            compiled.push_back(shader);
+            const wchar_t* filename = (shader == 2 || shader == 4) ? L"assets/ObjectTransforms.hlsl" : L"assets/shaders.hlsl";
+            return (files[filename] + files[L"assets/InstanceData.hlsli"]).find("error") == std::string::npos;
+        };
+        std::vector<bool> changed;
+
+        if (!tracker.Recompile(compile, &changed) || !compiled.empty() || std::count(changed.begin(), changed.end(), true) != 0)
+        {
+            return Fail(pError, "Nothing changed, but something was compiled");
+        }
+
+        files[L"assets/shaders.hlsl"] += "// edited\n";
+        if (!tracker.Recompile(compile, &changed) || compiled != std::vector<size_t>({ 0, 1, 3 }) ||
+            changed != std::vector<bool>({ true, true, false, true, false }))
+        {
+            return Fail(pError, "Editing shaders.hlsl didn't recompile exactly its three shaders");
+        }
+
+        // An include recompiles everything that pulls it in; saving it unchanged, nothing.
+        compiled.clear();
+        files[L"assets/InstanceData.hlsli"] += "struct Extra { float4 value; };\n";
+        if (!tracker.Recompile(compile, &changed) || compiled.size() != 5 || std::count(changed.begin(), changed.end(), true) != 5)
+        {
+            return Fail(pError, "Editing the include didn't recompile every shader");
+        }
+        compiled.clear();
+        if (!tracker.Recompile(compile, &changed) || !compiled.empty())
+        {
+            return Fail(pError, "Saving without changes recompiled something");
+        }
+
+        // A failed compile publishes nothing. Fixing shaders.hlsl then still recompiles
+        // ObjectTransforms.hlsl's shaders for the include edited alongside it.
+        files[L"assets/InstanceData.hlsli"] += "struct More { float4 value; };\n";
+        files[L"assets/shaders.hlsl"] += "error\n";
+        if (tracker.Recompile(compile, &changed) || std::count(changed.begin(), changed.end(), true) != 0)
+        {
+            return Fail(pError, "A failed compile was published");
+        }
+        std::string& source = files[L"assets/shaders.hlsl"];
+        source.replace(source.find("error"), 5, "// fixed");
+        compiled.clear();
+        if (!tracker.Recompile(compile, &changed) || compiled.size() != 5 || std::count(changed.begin(), changed.end(), true) != 5)
+        {
+            return Fail(pError, "After a failed compile, fixing it didn't recompile every affected shader");
+        }
+        return true;
+    }
+}
+
+void GetPortableTests(std::vector<HeadlessTest>* pTests)
+{
+    const HeadlessTest tests[] =
+    {
+        { "RingAllocator.Allocate", TestRingAllocatorAllocate },
+        { "RingAllocator.Wraparound", TestRingAllocatorWraparound },
+        { "RingAllocator.Retire", TestRingAllocatorRetire },
+        { "RingAllocator.Stress", TestRingAllocatorStress },
+        { "BuddyAllocator.SplitAndMerge", TestBuddyAllocatorSplitAndMerge },
+        { "BuddyAllocator.Sizes", TestBuddyAllocatorSizes },
+        { "BuddyAllocator.Fragmentation", TestBuddyAllocatorFragmentation },
+        { "BuddyAllocator.Stress", TestBuddyAllocatorStress },
+        { "ShaderCache.Key", TestShaderCacheKey },
+        { "ShaderCache.SourceHasher", TestShaderSourceHasher },
+        { "ShaderCache.File", TestShaderCacheFile },
+        { "ShaderCache.Merge", TestShaderCacheMerge },
+        { "ShaderReloadTracker.Recompile", TestShaderReloadTracker },
+    };
+    pTests->insert(pTests->end(), tests, tests + sizeof(tests) / sizeof(tests[0]));
+}
+
+unsigned RunHeadlessTests(const std::vector<HeadlessTest>& tests)
+{
+    unsigned failedCount = 0;
+    for (const HeadlessTest& test : tests)
+    {
+        std::string error;
+        if (test.run(&error))
+        {
+            printf("PASS %s\n", test.name);
+        }
+        else
+        {
+            printf("FAIL %s: %s\n", test.name, error.c_str());
+            failedCount++;
+        }
+    }
+    printf("%u of %u checks passed\n", static_cast<unsigned>(tests.size()) - failedCount, static_cast<unsigned>(tests.size()));
+    return failedCount;
+}
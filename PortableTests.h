@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Checks of the modules that build without Windows: the allocators' bookkeeping, the
+// shader cache's keys and file format, and whatever else keeps to standard headers. The bench target's -tests mode runs them
+// with the checks that need the Windows headers; on other platforms
+// PortableTestMain.cpp runs them on their own:
+//
+//   g++ -std=c++17 -O2 -o PortableTests PortableTestMain.cpp PortableTests.cpp BuddyBenchmark.cpp BuddyAllocator.cpp RingAllocator.cpp ShaderCacheFormat.cpp ShaderReloadTracker.cpp
+//
+// A check returns false and describes the first thing that went wrong in error.
+struct HeadlessTest
+{
+    const char* name;
+    bool (*run)(std::string* pError);
+};
+
+void GetPortableTests(std::vector<HeadlessTest>* pTests);
+
+// Runs every check, printing a line for each, and returns how many failed.
+unsigned RunHeadlessTests(const std::vector<HeadlessTest>& tests);
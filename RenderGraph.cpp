@@ -0,0 +1,712 @@
+#include "stdafx.h"
+#include "RenderGraph.h"
+#include "GpuTimer.h"
+#include <algorithm>
+
+namespace
+{
+    const D3D12_RESOURCE_STATES WriteStates =
+        D3D12_RESOURCE_STATE_RENDER_TARGET |
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS |
+        D3D12_RESOURCE_STATE_DEPTH_WRITE |
+        D3D12_RESOURCE_STATE_STREAM_OUT |
+        D3D12_RESOURCE_STATE_COPY_DEST |
+        D3D12_RESOURCE_STATE_RESOLVE_DEST;
+
+    UINT64 AlignUp(UINT64 value, UINT64 alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+RenderGraph::RenderGraph() :
+    m_pGpuTimer(nullptr),
+    m_lastLivePass(InvalidIndex),
+    m_compiled(false),
+    m_heaps{},
+    m_statistics{}
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    Release();
+}
+
+void RenderGraph::Create(ID3D12Device* pDevice)
+{
+    m_device = pDevice;
+}
+
+void RenderGraph::Release()
+{
+    Reset();
+    m_physicalResources.clear();
+    for (int i = 0; i < HeapPoolCount; i++)
+    {
+        m_heaps[i] = {};
+    }
+    m_device.Reset();
+}
+
+void RenderGraph::Reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_finalBarriers.clear();
+    m_lastLivePass = InvalidIndex;
+    m_compiled = false;
+    m_statistics = {};
+}
+
+RenderGraphResource RenderGraph::ImportResource(const char* name, ID3D12Resource* pResource, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState)
+{
+    ResourceNode node = {};
+    node.name = name;
+    node.imported = true;
+    node.pImported = pResource;
+    node.initialState = initialState;
+    node.finalState = finalState;
+    node.physical = InvalidIndex;
+    m_resources.push_back(node);
+    return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::CreateTransientResource(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue)
+{
+    return CreateTransientResource(name, desc, pClearValue, m_device->GetResourceAllocationInfo(0, 1, &desc));
+}
+
+RenderGraphResource RenderGraph::CreateTransientResource(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue, const D3D12_RESOURCE_ALLOCATION_INFO& allocationInfo)
+{
+    ResourceNode node = {};
+    node.name = name;
+    node.imported = false;
+    node.desc = desc;
+    node.hasClearValue = (pClearValue != nullptr);
+    if (pClearValue != nullptr)
+    {
+        node.clearValue = *pClearValue;
+    }
+    node.allocationInfo = allocationInfo;
+    node.pool = SelectPool(desc);
+    node.physical = InvalidIndex;
+    m_resources.push_back(node);
+    return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+UINT RenderGraph::AddPass(const char* name, ID3D12GraphicsCommandList* pCommandList, const ExecuteFunction& execute)
+{
+    PassNode pass = {};
+    pass.name = name;
+    pass.pCommandList = pCommandList;
+    pass.execute = execute;
+    m_passes.push_back(pass);
+    return static_cast<UINT>(m_passes.size() - 1);
+}
+
+void RenderGraph::ReadResource(UINT pass, RenderGraphResource resource, D3D12_RESOURCE_STATES state)
+{
+    assert(IsReadState(state));
+    AddAccess(pass, resource, state, false);
+}
+
+void RenderGraph::WriteResource(UINT pass, RenderGraphResource resource, D3D12_RESOURCE_STATES state)
+{
+    AddAccess(pass, resource, state, true);
+}
+
+void RenderGraph::SetSideEffect(UINT pass)
+{
+    m_passes[pass].sideEffect = true;
+}
+
+// A pass touches a resource in exactly one state; repeated reads merge into one access.
+void RenderGraph::AddAccess(UINT pass, RenderGraphResource resource, D3D12_RESOURCE_STATES state, bool write)
+{
+    for (ResourceAccess& access : m_passes[pass].accesses)
+    {
+        if (access.resource == resource)
+        {
+            assert(!write && !access.write);
+            access.state |= state;
+            return;
+        }
+    }
+
+    ResourceAccess access = { resource, state, write };
+    m_passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::Compile()
+{
+    CullPasses();
+    ComputeLifetimes();
+    PlaceTransients();
+    BuildBarriers();
+    m_compiled = true;
+}
+
+// Reference counting from the outputs: imported resources are always consumed, and a pass
+// survives while any resource it writes is still read by a live pass.
+void RenderGraph::CullPasses()
+{
+    for (ResourceNode& resource : m_resources)
+    {
+        resource.writers.clear();
+        resource.readCount = resource.imported ? 1 : 0;
+    }
+    for (UINT i = 0; i < m_passes.size(); i++)
+    {
+        PassNode& pass = m_passes[i];
+        pass.refCount = 0;
+        pass.culled = false;
+        for (const ResourceAccess& access : pass.accesses)
+        {
+            if (access.write)
+            {
+                m_resources[access.resource].writers.push_back(i);
+                pass.refCount++;
+            }
+            else
+            {
+                m_resources[access.resource].readCount++;
+            }
+        }
+    }
+
+    std::vector<RenderGraphResource> unreferenced;
+    auto cullPass = [&](PassNode& pass)
+    {
+        pass.culled = true;
+        for (const ResourceAccess& access : pass.accesses)
+        {
+            if (!access.write && --m_resources[access.resource].readCount == 0)
+            {
+                unreferenced.push_back(access.resource);
+            }
+        }
+    };
+
+    for (PassNode& pass : m_passes)
+    {
+        if (pass.refCount == 0 && !pass.sideEffect)
+        {
+            cullPass(pass);
+        }
+    }
+    for (UINT i = 0; i < m_resources.size(); i++)
+    {
+        if (m_resources[i].readCount == 0)
+        {
+            unreferenced.push_back(i);
+        }
+    }
+
+    while (!unreferenced.empty())
+    {
+        const RenderGraphResource resource = unreferenced.back();
+        unreferenced.pop_back();
+        for (UINT writer : m_resources[resource].writers)
+        {
+            PassNode& pass = m_passes[writer];
+            if (!pass.culled && --pass.refCount == 0 && !pass.sideEffect)
+            {
+                cullPass(pass);
+            }
+        }
+    }
+
+    m_statistics.passCount = static_cast<UINT>(m_passes.size());
+    m_statistics.culledPassCount = 0;
+    m_lastLivePass = InvalidIndex;
+    for (UINT i = 0; i < m_passes.size(); i++)
+    {
+        if (m_passes[i].culled)
+        {
+            m_statistics.culledPassCount++;
+        }
+        else
+        {
+            m_lastLivePass = i;
+        }
+    }
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+    for (ResourceNode& resource : m_resources)
+    {
+        resource.firstPass = InvalidIndex;
+        resource.lastPass = InvalidIndex;
+    }
+    for (UINT i = 0; i < m_passes.size(); i++)
+    {
+        if (m_passes[i].culled)
+        {
+            continue;
+        }
+        for (const ResourceAccess& access : m_passes[i].accesses)
+        {
+            ResourceNode& resource = m_resources[access.resource];
+            if (resource.firstPass == InvalidIndex)
+            {
+                resource.firstPass = i;
+            }
+            resource.lastPass = i;
+        }
+    }
+}
+
+// Greedy interval packing per heap pool: largest first, each at the lowest offset that
+// does not overlap a resource whose lifetime intersects its own.
+void RenderGraph::PlaceTransients()
+{
+    m_statistics.transientResourceCount = 0;
+    m_statistics.transientHeapSize = 0;
+    m_statistics.transientUnaliasedSize = 0;
+
+    for (UINT poolIndex = 0; poolIndex < HeapPoolCount; poolIndex++)
+    {
+        std::vector<RenderGraphResource> transients;
+        for (UINT i = 0; i < m_resources.size(); i++)
+        {
+            const ResourceNode& resource = m_resources[i];
+            if (!resource.imported && resource.firstPass != InvalidIndex && resource.pool == poolIndex)
+            {
+                transients.push_back(i);
+            }
+        }
+        std::stable_sort(transients.begin(), transients.end(), [this](RenderGraphResource a, RenderGraphResource b)
+        {
+            return m_resources[a].allocationInfo.SizeInBytes > m_resources[b].allocationInfo.SizeInBytes;
+        });
+
+        TransientHeap& heap = m_heaps[poolIndex];
+        heap.requiredSize = 0;
+        heap.alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+        std::vector<RenderGraphResource> placed;
+        std::vector<RenderGraphResource> conflicts;
+        for (RenderGraphResource index : transients)
+        {
+            ResourceNode& resource = m_resources[index];
+            const UINT64 size = resource.allocationInfo.SizeInBytes;
+            const UINT64 alignment = max(resource.allocationInfo.Alignment, static_cast<UINT64>(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+
+            conflicts.clear();
+            for (RenderGraphResource other : placed)
+            {
+                const ResourceNode& otherResource = m_resources[other];
+                if (otherResource.firstPass <= resource.lastPass && resource.firstPass <= otherResource.lastPass)
+                {
+                    conflicts.push_back(other);
+                }
+            }
+            std::sort(conflicts.begin(), conflicts.end(), [this](RenderGraphResource a, RenderGraphResource b)
+            {
+                return m_resources[a].heapOffset < m_resources[b].heapOffset;
+            });
+
+            UINT64 offset = 0;
+            for (RenderGraphResource other : conflicts)
+            {
+                const ResourceNode& otherResource = m_resources[other];
+                if (offset + size <= otherResource.heapOffset)
+                {
+                    break;
+                }
+                offset = max(offset, AlignUp(otherResource.heapOffset + otherResource.allocationInfo.SizeInBytes, alignment));
+            }
+
+            resource.heapOffset = offset;
+            resource.aliased = false;
+            placed.push_back(index);
+
+            heap.requiredSize = max(heap.requiredSize, offset + size);
+            heap.alignment = max(heap.alignment, alignment);
+            m_statistics.transientUnaliasedSize += AlignUp(size, alignment);
+            m_statistics.transientResourceCount++;
+        }
+
+        // Anything sharing memory with another transient needs an aliasing barrier and
+        // must be initialized on first use.
+        for (size_t i = 0; i < placed.size(); i++)
+        {
+            for (size_t j = i + 1; j < placed.size(); j++)
+            {
+                ResourceNode& a = m_resources[placed[i]];
+                ResourceNode& b = m_resources[placed[j]];
+                if (a.heapOffset < b.heapOffset + b.allocationInfo.SizeInBytes && b.heapOffset < a.heapOffset + a.allocationInfo.SizeInBytes)
+                {
+                    a.aliased = true;
+                    b.aliased = true;
+                }
+            }
+        }
+
+        m_statistics.transientHeapSize += heap.requiredSize;
+    }
+}
+
+UINT RenderGraph::NextLivePass(UINT pass) const
+{
+    for (UINT i = pass + 1; i < m_passes.size(); i++)
+    {
+        if (!m_passes[i].culled)
+        {
+            return i;
+        }
+    }
+    return InvalidIndex;
+}
+
+// Walks the live passes in order, tracking each resource's state. Consecutive reads are
+// merged into one combined read state, and a transition is split when at least one
+// unrelated pass on the same command list runs between the two uses.
+void RenderGraph::BuildBarriers()
+{
+    std::vector<D3D12_RESOURCE_STATES> currentStates(m_resources.size());
+    std::vector<UINT> lastAccessPasses(m_resources.size(), static_cast<UINT>(InvalidIndex));
+    std::vector<bool> lastAccessWrites(m_resources.size(), false);
+    for (UINT i = 0; i < m_resources.size(); i++)
+    {
+        currentStates[i] = m_resources[i].initialState;
+    }
+
+    m_statistics.barrierCount = 0;
+    m_statistics.barrierBatchCount = 0;
+    m_statistics.splitBarrierCount = 0;
+    m_statistics.aliasingBarrierCount = 0;
+    m_finalBarriers.clear();
+
+    for (PassNode& pass : m_passes)
+    {
+        pass.barriers.clear();
+        pass.discards.clear();
+    }
+
+    for (UINT passIndex = 0; passIndex < m_passes.size(); passIndex++)
+    {
+        PassNode& pass = m_passes[passIndex];
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        for (const ResourceAccess& access : pass.accesses)
+        {
+            const RenderGraphResource index = access.resource;
+            ResourceNode& resource = m_resources[index];
+
+            D3D12_RESOURCE_STATES targetState = access.state;
+            if (!access.write && targetState != D3D12_RESOURCE_STATE_COMMON)
+            {
+                // Transition once into every state the following readers need.
+                for (UINT next = NextLivePass(passIndex); next != InvalidIndex; next = NextLivePass(next))
+                {
+                    const ResourceAccess* pNextAccess = nullptr;
+                    for (const ResourceAccess& nextAccess : m_passes[next].accesses)
+                    {
+                        if (nextAccess.resource == index)
+                        {
+                            pNextAccess = &nextAccess;
+                        }
+                    }
+                    if (pNextAccess == nullptr)
+                    {
+                        continue;
+                    }
+                    if (pNextAccess->write || pNextAccess->state == D3D12_RESOURCE_STATE_COMMON)
+                    {
+                        break;
+                    }
+                    targetState |= pNextAccess->state;
+                }
+            }
+
+            Barrier barrier = {};
+            barrier.resource = index;
+
+            if (!resource.imported && lastAccessPasses[index] == InvalidIndex)
+            {
+                // First use this frame of a transient: its state comes from the last frame
+                // that used the same placed resource.
+                resource.firstState = targetState;
+                if (resource.aliased)
+                {
+                    barrier.type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+                    pass.barriers.push_back(barrier);
+                    m_statistics.aliasingBarrierCount++;
+                }
+                barrier.type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                barrier.after = targetState;
+                barrier.fromPhysicalState = true;
+                pass.barriers.push_back(barrier);
+
+                // Transient contents never carry over, and placed render targets must be
+                // initialized before use; a discard is the cheapest way to do both.
+                const D3D12_RESOURCE_FLAGS initFlags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+                const D3D12_RESOURCE_STATES initStates = D3D12_RESOURCE_STATE_RENDER_TARGET | D3D12_RESOURCE_STATE_DEPTH_WRITE | D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+                if (resource.desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER && (resource.desc.Flags & initFlags) && (targetState & initStates))
+                {
+                    pass.discards.push_back(index);
+                }
+            }
+            else
+            {
+                const D3D12_RESOURCE_STATES currentState = currentStates[index];
+                const bool covered = IsReadState(currentState) && !access.write &&
+                    (targetState == currentState || (targetState != D3D12_RESOURCE_STATE_COMMON && (currentState & targetState) == targetState));
+
+                if (covered)
+                {
+                    targetState = currentState;
+                }
+                else if (currentState == targetState)
+                {
+                    // Back-to-back UAV work still has to be ordered.
+                    if (targetState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS && (access.write || lastAccessWrites[index]))
+                    {
+                        barrier.type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                        pass.barriers.push_back(barrier);
+                    }
+                }
+                else
+                {
+                    barrier.type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                    barrier.before = currentState;
+                    barrier.after = targetState;
+
+                    const UINT lastAccess = lastAccessPasses[index];
+                    const UINT beginPass = (lastAccess == InvalidIndex) ? InvalidIndex : NextLivePass(lastAccess);
+                    if (beginPass != InvalidIndex && beginPass < passIndex && m_passes[beginPass].pCommandList == pass.pCommandList)
+                    {
+                        barrier.flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+                        m_passes[beginPass].barriers.push_back(barrier);
+                        barrier.flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+                        m_statistics.splitBarrierCount++;
+                    }
+                    pass.barriers.push_back(barrier);
+                }
+            }
+
+            currentStates[index] = targetState;
+            lastAccessPasses[index] = passIndex;
+            lastAccessWrites[index] = access.write;
+        }
+    }
+
+    for (UINT i = 0; i < m_resources.size(); i++)
+    {
+        ResourceNode& resource = m_resources[i];
+        resource.endState = currentStates[i];
+        if (resource.imported && lastAccessPasses[i] != InvalidIndex && currentStates[i] != resource.finalState)
+        {
+            Barrier barrier = {};
+            barrier.type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barrier.resource = i;
+            barrier.before = currentStates[i];
+            barrier.after = resource.finalState;
+            m_finalBarriers.push_back(barrier);
+            resource.endState = resource.finalState;
+        }
+    }
+
+    for (const PassNode& pass : m_passes)
+    {
+        m_statistics.barrierCount += static_cast<UINT>(pass.barriers.size());
+        m_statistics.barrierBatchCount += pass.barriers.empty() ? 0 : 1;
+    }
+    m_statistics.barrierCount += static_cast<UINT>(m_finalBarriers.size());
+    m_statistics.barrierBatchCount += m_finalBarriers.empty() ? 0 : 1;
+}
+
+// Reuses last frame's placed resources where the layout did not change. The owner only
+// executes a graph again once the GPU has finished its previous execution, so anything
+// that is no longer needed can be dropped immediately.
+void RenderGraph::CreateTransients()
+{
+    const D3D12_HEAP_FLAGS heapFlags[HeapPoolCount] =
+    {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+    };
+
+    for (UINT poolIndex = 0; poolIndex < HeapPoolCount; poolIndex++)
+    {
+        TransientHeap& heap = m_heaps[poolIndex];
+        if (heap.requiredSize == 0 || (heap.heap != nullptr && heap.size >= heap.requiredSize))
+        {
+            continue;
+        }
+
+        // Growing invalidates every resource placed in the old heap.
+        m_physicalResources.erase(std::remove_if(m_physicalResources.begin(), m_physicalResources.end(), [poolIndex](const PhysicalResource& physical)
+        {
+            return physical.pool == poolIndex;
+        }), m_physicalResources.end());
+
+        CD3DX12_HEAP_DESC heapDesc(AlignUp(heap.requiredSize, heap.alignment), D3D12_HEAP_TYPE_DEFAULT, heap.alignment, heapFlags[poolIndex]);
+        heap.heap.Reset();
+        ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap.heap)));
+        heap.size = heapDesc.SizeInBytes;
+    }
+
+    for (PhysicalResource& physical : m_physicalResources)
+    {
+        physical.used = false;
+    }
+
+    std::vector<PhysicalResource> physicalResources;
+    for (ResourceNode& resource : m_resources)
+    {
+        resource.physical = InvalidIndex;
+        if (resource.imported || resource.firstPass == InvalidIndex)
+        {
+            continue;
+        }
+
+        PhysicalResource* pMatch = nullptr;
+        for (PhysicalResource& physical : m_physicalResources)
+        {
+            if (!physical.used && physical.pool == resource.pool && physical.heapOffset == resource.heapOffset &&
+                memcmp(&physical.desc, &resource.desc, sizeof(resource.desc)) == 0)
+            {
+                pMatch = &physical;
+                break;
+            }
+        }
+
+        if (pMatch != nullptr)
+        {
+            pMatch->used = true;
+            physicalResources.push_back(*pMatch);
+        }
+        else
+        {
+            PhysicalResource physical = {};
+            physical.pool = resource.pool;
+            physical.heapOffset = resource.heapOffset;
+            physical.desc = resource.desc;
+            physical.state = resource.firstState;
+            ThrowIfFailed(m_device->CreatePlacedResource(
+                m_heaps[resource.pool].heap.Get(),
+                resource.heapOffset,
+                &resource.desc,
+                physical.state,
+                resource.hasClearValue ? &resource.clearValue : nullptr,
+                IID_PPV_ARGS(&physical.resource)));
+            physicalResources.push_back(physical);
+        }
+        resource.physical = static_cast<UINT>(physicalResources.size() - 1);
+    }
+    m_physicalResources.swap(physicalResources);
+}
+
+void RenderGraph::Execute()
+{
+    assert(m_compiled && m_device != nullptr);
+    CreateTransients();
+
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    auto flushBarriers = [&](const std::vector<Barrier>& source, ID3D12GraphicsCommandList* pCommandList)
+    {
+        barriers.clear();
+        for (const Barrier& barrier : source)
+        {
+            ID3D12Resource* pResource = GetResource(barrier.resource);
+            switch (barrier.type)
+            {
+            case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+            {
+                const D3D12_RESOURCE_STATES before = barrier.fromPhysicalState ? m_physicalResources[m_resources[barrier.resource].physical].state : barrier.before;
+                if (before != barrier.after)
+                {
+                    barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(pResource, before, barrier.after, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, barrier.flags));
+                }
+                break;
+            }
+            case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, pResource));
+                break;
+            case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(pResource));
+                break;
+            }
+        }
+        if (!barriers.empty())
+        {
+            pCommandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+        }
+    };
+
+    for (PassNode& pass : m_passes)
+    {
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        PIXBeginEvent(pass.pCommandList, 0, pass.name.c_str());
+        const UINT zone = m_pGpuTimer ? m_pGpuTimer->BeginZone(pass.pCommandList, pass.name.c_str()) : TimestampQueryRing::InvalidZone;
+        flushBarriers(pass.barriers, pass.pCommandList);
+        for (RenderGraphResource resource : pass.discards)
+        {
+            pass.pCommandList->DiscardResource(GetResource(resource), nullptr);
+        }
+        if (pass.execute)
+        {
+            pass.execute(pass.pCommandList);
+        }
+        if (m_pGpuTimer)
+        {
+            m_pGpuTimer->EndZone(pass.pCommandList, zone);
+        }
+        PIXEndEvent(pass.pCommandList);
+    }
+
+    if (m_lastLivePass != InvalidIndex)
+    {
+        flushBarriers(m_finalBarriers, m_passes[m_lastLivePass].pCommandList);
+    }
+
+    for (const ResourceNode& resource : m_resources)
+    {
+        if (resource.physical != InvalidIndex)
+        {
+            m_physicalResources[resource.physical].state = resource.endState;
+        }
+    }
+}
+
+ID3D12Resource* RenderGraph::GetResource(RenderGraphResource resource) const
+{
+    const ResourceNode& node = m_resources[resource];
+    if (node.imported)
+    {
+        return node.pImported;
+    }
+    return (node.physical == InvalidIndex) ? nullptr : m_physicalResources[node.physical].resource.Get();
+}
+
+bool RenderGraph::IsReadState(D3D12_RESOURCE_STATES state)
+{
+    return (state & WriteStates) == 0;
+}
+
+HeapPool RenderGraph::SelectPool(const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return HeapPoolBuffer;
+    }
+    if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+    {
+        return HeapPoolRenderTarget;
+    }
+    return HeapPoolTexture;
+}
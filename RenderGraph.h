@@ -0,0 +1,185 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include "HeapAllocator.h"
+#include <functional>
+#include <vector>
+
+class GpuTimer;
+
+typedef UINT RenderGraphResource;
+
+// Frame graph: passes declare the resources they read and write, and Compile works out
+// the rest. Passes whose results are never consumed are culled, state transitions are
+// merged into one ResourceBarrier batch per pass (split into BEGIN/END halves when
+// there is room), and transient resources with disjoint lifetimes share heap memory.
+//
+// Compile only touches CPU data, so a graph built without a device can be compiled
+// and inspected headlessly; Execute then records the barriers and pass bodies.
+class RenderGraph
+{
+public:
+    static const UINT InvalidIndex = ~0u;
+
+    // Pass bodies. Passes whose commands are recorded elsewhere (e.g. by worker threads)
+    // leave this empty and only contribute their barriers.
+    typedef std::function<void(ID3D12GraphicsCommandList* pCommandList)> ExecuteFunction;
+
+    struct Statistics
+    {
+        UINT passCount;
+        UINT culledPassCount;
+        UINT barrierCount;
+        UINT barrierBatchCount;
+        UINT splitBarrierCount;
+        UINT aliasingBarrierCount;
+        UINT transientResourceCount;
+        UINT64 transientHeapSize;       // Sum over heap pools, after aliasing.
+        UINT64 transientUnaliasedSize;  // What the transients would take without aliasing.
+    };
+
+    // A barrier whose resource is only known once the transients are placed.
+    struct Barrier
+    {
+        D3D12_RESOURCE_BARRIER_TYPE type;
+        RenderGraphResource resource;
+        D3D12_RESOURCE_STATES before;
+        D3D12_RESOURCE_STATES after;
+        D3D12_RESOURCE_BARRIER_FLAGS flags;
+        bool fromPhysicalState;         // before is whatever the transient was left in last frame.
+    };
+
+    RenderGraph();
+    ~RenderGraph();
+
+    // Without a device the graph can still be built and compiled, but not executed.
+    void Create(ID3D12Device* pDevice);
+    void Release();
+
+    // Clears passes and resources; transient memory is kept for the next frame.
+    void Reset();
+
+    // The caller keeps pResource alive until the graph has executed.
+    RenderGraphResource ImportResource(const char* name, ID3D12Resource* pResource, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState);
+    RenderGraphResource CreateTransientResource(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue);
+    RenderGraphResource CreateTransientResource(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue, const D3D12_RESOURCE_ALLOCATION_INFO& allocationInfo);
+
+    // Passes execute in the order they are added. Barriers for a pass are recorded on its
+    // command list, right before its body.
+    UINT AddPass(const char* name, ID3D12GraphicsCommandList* pCommandList, const ExecuteFunction& execute = nullptr);
+    void ReadResource(UINT pass, RenderGraphResource resource, D3D12_RESOURCE_STATES state);
+    void WriteResource(UINT pass, RenderGraphResource resource, D3D12_RESOURCE_STATES state);
+
+    // Keeps a pass alive even though nothing in the graph reads what it writes.
+    void SetSideEffect(UINT pass);
+
+    void Compile();
+
+    // Creates the transient resources and records every live pass.
+    void Execute();
+
+    // Execute times every live pass, under its name, when a timer is set.
+    void SetGpuTimer(GpuTimer* pTimer) { m_pGpuTimer = pTimer; }
+
+    // Valid after Execute, for the pass bodies.
+    ID3D12Resource* GetResource(RenderGraphResource resource) const;
+
+    bool IsPassCulled(UINT pass) const { return m_passes[pass].culled; }
+    UINT64 GetTransientOffset(RenderGraphResource resource) const { return m_resources[resource].heapOffset; }
+    const Statistics& GetStatistics() const { return m_statistics; }
+
+    // The batch Execute records before the pass body, and the one after the last pass.
+    const std::vector<Barrier>& GetPassBarriers(UINT pass) const { return m_passes[pass].barriers; }
+    const std::vector<Barrier>& GetFinalBarriers() const { return m_finalBarriers; }
+
+private:
+    struct ResourceNode
+    {
+        std::string name;
+        bool imported;
+        ID3D12Resource* pImported;
+        D3D12_RESOURCE_STATES initialState;
+        D3D12_RESOURCE_STATES finalState;
+
+        D3D12_RESOURCE_DESC desc;
+        bool hasClearValue;
+        D3D12_CLEAR_VALUE clearValue;
+        D3D12_RESOURCE_ALLOCATION_INFO allocationInfo;
+        HeapPool pool;
+
+        // Compiled.
+        std::vector<UINT> writers;
+        UINT readCount;
+        UINT firstPass;
+        UINT lastPass;
+        UINT64 heapOffset;
+        bool aliased;
+        D3D12_RESOURCE_STATES firstState;
+        D3D12_RESOURCE_STATES endState;
+        UINT physical;
+    };
+
+    struct ResourceAccess
+    {
+        RenderGraphResource resource;
+        D3D12_RESOURCE_STATES state;
+        bool write;
+    };
+
+    struct PassNode
+    {
+        std::string name;
+        ID3D12GraphicsCommandList* pCommandList;
+        ExecuteFunction execute;
+        std::vector<ResourceAccess> accesses;
+        bool sideEffect;
+
+        // Compiled.
+        UINT refCount;
+        bool culled;
+        std::vector<Barrier> barriers;
+        std::vector<RenderGraphResource> discards;
+    };
+
+    // Placed transient kept across frames, so steady-state frames create nothing.
+    struct PhysicalResource
+    {
+        ComPtr<ID3D12Resource> resource;
+        HeapPool pool;
+        UINT64 heapOffset;
+        D3D12_RESOURCE_DESC desc;
+        D3D12_RESOURCE_STATES state;
+        bool used;
+    };
+
+    struct TransientHeap
+    {
+        ComPtr<ID3D12Heap> heap;
+        UINT64 size;
+        UINT64 requiredSize;
+        UINT64 alignment;
+    };
+
+    void AddAccess(UINT pass, RenderGraphResource resource, D3D12_RESOURCE_STATES state, bool write);
+    void CullPasses();
+    void ComputeLifetimes();
+    void PlaceTransients();
+    void BuildBarriers();
+    UINT NextLivePass(UINT pass) const;
+    void CreateTransients();
+
+    static bool IsReadState(D3D12_RESOURCE_STATES state);
+    static HeapPool SelectPool(const D3D12_RESOURCE_DESC& desc);
+
+    ComPtr<ID3D12Device> m_device;
+    GpuTimer* m_pGpuTimer;
+    std::vector<ResourceNode> m_resources;
+    std::vector<PassNode> m_passes;
+    std::vector<Barrier> m_finalBarriers;       // Recorded after the last live pass.
+    UINT m_lastLivePass;
+    bool m_compiled;
+
+    std::vector<PhysicalResource> m_physicalResources;
+    TransientHeap m_heaps[HeapPoolCount];
+    Statistics m_statistics;
+};
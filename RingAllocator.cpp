@@ -0,0 +1,117 @@
+#include "RingAllocator.h"
+#include <cassert>
+
+namespace
+{
+    inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + (alignment - 1)) & ~(alignment - 1);
+    }
+}
+
+RingAllocator::RingAllocator() :
+    m_capacity(0),
+    m_head(0),
+    m_tail(0),
+    m_usedSize(0),
+    m_currentFrameSize(0)
+{
+}
+
+RingAllocator::RingAllocator(uint64_t capacity) :
+    RingAllocator()
+{
+    Reset(capacity);
+}
+
+void RingAllocator::Reset(uint64_t capacity)
+{
+    m_pendingFrames.clear();
+    m_capacity = capacity;
+    m_head = 0;
+    m_tail = 0;
+    m_usedSize = 0;
+    m_currentFrameSize = 0;
+}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    if (size == 0 || size > m_capacity || m_usedSize == m_capacity)
+    {
+        return InvalidOffset;
+    }
+
+    // Nothing is in flight, so restart at the beginning to get one contiguous free range.
+    if (m_usedSize == 0)
+    {
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    const uint64_t alignedTail = AlignUp(m_tail, alignment);
+    uint64_t offset = InvalidOffset;
+    uint64_t consumed = 0;
+
+    if (m_tail >= m_head)
+    {
+        // Free space is [tail, capacity) followed by [0, head).
+        if (alignedTail + size <= m_capacity)
+        {
+            offset = alignedTail;
+            consumed = (alignedTail - m_tail) + size;
+        }
+        else if (size <= m_head)
+        {
+            // Skip the end of the buffer and wrap around to offset 0.
+            offset = 0;
+            consumed = (m_capacity - m_tail) + size;
+        }
+    }
+    else if (alignedTail + size <= m_head)
+    {
+        // Free space is the single range [tail, head).
+        offset = alignedTail;
+        consumed = (alignedTail - m_tail) + size;
+    }
+
+    if (offset == InvalidOffset)
+    {
+        return InvalidOffset;
+    }
+
+    m_tail = offset + size;
+    if (m_tail == m_capacity)
+    {
+        m_tail = 0;
+    }
+    m_usedSize += consumed;
+    m_currentFrameSize += consumed;
+    return offset;
+}
+
+void RingAllocator::FinishFrame(uint64_t fenceValue)
+{
+    if (m_currentFrameSize == 0)
+    {
+        return;
+    }
+
+    PendingFrame frame = {};
+    frame.fenceValue = fenceValue;
+    frame.size = m_currentFrameSize;
+    m_pendingFrames.push_back(frame);
+    m_currentFrameSize = 0;
+}
+
+void RingAllocator::Retire(uint64_t completedFenceValue)
+{
+    while (!m_pendingFrames.empty() && m_pendingFrames.front().fenceValue <= completedFenceValue)
+    {
+        const PendingFrame& frame = m_pendingFrames.front();
+        m_head = (m_head + frame.size) % m_capacity;
+        m_usedSize -= frame.size;
+        m_pendingFrames.pop_front();
+    }
+}
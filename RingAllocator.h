@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Offset bookkeeping for a fixed-size ring. Allocations are handed out in order
+// and grouped into frames; a frame's space is given back once the fence value it
+// was tagged with in FinishFrame has been reached by the GPU.
+//
+// Only standard headers, so that PortableTests.cpp can check it without Windows.
+class RingAllocator
+{
+public:
+    static const uint64_t InvalidOffset = ~0ull;
+
+    RingAllocator();
+    explicit RingAllocator(uint64_t capacity);
+
+    void Reset(uint64_t capacity);
+
+    // Returns InvalidOffset when the request does not fit in the free space.
+    uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+    // Tags everything allocated since the previous call with fenceValue.
+    void FinishFrame(uint64_t fenceValue);
+
+    // Reclaims the space of every frame whose fence value has completed.
+    void Retire(uint64_t completedFenceValue);
+
+    uint64_t GetCapacity() const { return m_capacity; }
+    uint64_t GetUsedSize() const { return m_usedSize; }
+    size_t GetPendingFrameCount() const { return m_pendingFrames.size(); }
+
+private:
+    struct PendingFrame
+    {
+        uint64_t fenceValue;
+        uint64_t size;      // Includes the padding lost to alignment and wraparound.
+    };
+
+    std::deque<PendingFrame> m_pendingFrames;
+    uint64_t m_capacity;
+    uint64_t m_head;        // Start of the oldest live allocation.
+    uint64_t m_tail;        // Where the next allocation starts searching.
+    uint64_t m_usedSize;
+    uint64_t m_currentFrameSize;
+};
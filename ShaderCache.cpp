@@ -0,0 +1,166 @@
+#include "stdafx.h"
+#include "ShaderCache.h"
+#include <fstream>
+#include <sstream>
+
+ShaderCache::ShaderCache() :
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr),
+    m_pView(nullptr),
+    m_sourceHasher(ReadSourceFile),
+    m_hitCount(0),
+    m_missCount(0)
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+    Close();
+}
+
+bool ShaderCache::ReadSourceFile(const std::wstring& filename, std::string* pText)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    *pText = stream.str();
+    return true;
+}
+
+void ShaderCache::Open(const std::wstring& cacheFilename)
+{
+    Close();
+    m_filename = cacheFilename;
+
+    m_file = CreateFile2(cacheFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        // No cache yet; everything will be compiled and written on Close.
+        return;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(m_file, &fileSize);
+    if (fileSize.QuadPart >= sizeof(ShaderCacheHeader))
+    {
+        m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping != nullptr)
+        {
+            m_pView = reinterpret_cast<const UINT8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+
+    if (m_pView != nullptr)
+    {
+        m_index.Open(m_pView, static_cast<UINT64>(fileSize.QuadPart));
+    }
+}
+
+void ShaderCache::Close()
+{
+    if (m_filename.empty())
+    {
+        return;
+    }
+
+    // Hits are in the file already, and so are the entries nobody asked for this time,
+    // such as another configuration's; only new bytecode makes a write worthwhile.
+    if (m_missCount > 0)
+    {
+        Write();
+    }
+    Unmap();
+
+    m_usedShaders.clear();
+    m_compiledShaders.clear();
+    m_sourceHasher.Clear();
+    m_filename.clear();
+    m_hitCount = 0;
+    m_missCount = 0;
+}
+
+void ShaderCache::Unmap()
+{
+    if (m_pView != nullptr)
+    {
+        UnmapViewOfFile(m_pView);
+        m_pView = nullptr;
+    }
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_index.Clear();
+}
+
+D3D12_SHADER_BYTECODE ShaderCache::GetShader(const std::wstring& filename, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target, UINT compileFlags)
+{
+    const UINT64 key = ComputeKey(m_sourceHasher.HashFile(filename), pDefines, entryPoint, target, compileFlags);
+
+    ShaderCacheBlob blob = {};
+    auto used = m_usedShaders.find(key);
+    if (used != m_usedShaders.end())
+    {
+        m_hitCount++;
+        blob = used->second;
+    }
+    else if (m_index.Find(key, &blob))
+    {
+        m_hitCount++;
+        m_usedShaders[key] = blob;
+    }
+    else
+    {
+        m_missCount++;
+
+        ComPtr<ID3DBlob> shader;
+        ComPtr<ID3DBlob> errors;
+        const HRESULT hr = D3DCompileFromFile(filename.c_str(), pDefines, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint, target, compileFlags, 0, &shader, &errors);
+        if (errors != nullptr)
+        {
+            OutputDebugStringA(reinterpret_cast<const char*>(errors->GetBufferPointer()));
+        }
+        ThrowIfFailed(hr);
+
+        blob.pData = shader->GetBufferPointer();
+        blob.size = shader->GetBufferSize();
+        m_compiledShaders.push_back(shader);
+        m_usedShaders[key] = blob;
+    }
+
+    D3D12_SHADER_BYTECODE bytecode = {};
+    bytecode.pShaderBytecode = blob.pData;
+    bytecode.BytecodeLength = blob.size;
+    return bytecode;
+}
+
+void ShaderCache::Write()
+{
+    // Build the new file in memory first: the blobs may still point into the current mapping.
+    std::vector<uint8_t> contents;
+    WriteShaderCacheFile(m_index, m_usedShaders, &contents);
+
+    // The mapping has to go before the file can be replaced.
+    Unmap();
+
+    const std::wstring temporaryFilename = m_filename + L".tmp";
+    {
+        std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+        if (!file)
+        {
+            return;
+        }
+    }
+    MoveFileEx(temporaryFilename.c_str(), m_filename.c_str(), MOVEFILE_REPLACE_EXISTING);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include "ShaderCacheFormat.h"
+#include <map>
+#include <vector>
+
+// Content-addressed store of compiled shader bytecode. A shader is keyed on the hash
+// of its source (including #include'd files), defines, entry point, target and
+// compile flags, so an edited shader simply misses and gets recompiled.
+//
+// The cache file is memory-mapped; hits return pointers straight into the mapping.
+// ShaderCacheFormat.h has the layout, and everything else that doesn't need Windows.
+class ShaderCache
+{
+public:
+    ShaderCache();
+    ~ShaderCache();
+
+    // Maps the cache file if it exists and is valid; otherwise starts empty.
+    void Open(const std::wstring& cacheFilename);
+
+    // If anything was compiled, writes it out with every entry already in the file,
+    // then unmaps.
+    void Close();
+
+    // The returned bytecode stays valid until Close.
+    D3D12_SHADER_BYTECODE GetShader(const std::wstring& filename, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target, UINT compileFlags);
+
+    UINT GetHitCount() const { return m_hitCount; }
+    UINT GetMissCount() const { return m_missCount; }
+
+    // A ShaderSourceHasher::ReadFunction over the file system.
+    static bool ReadSourceFile(const std::wstring& filename, std::string* pText);
+
+    static UINT64 HashBytes(const void* pData, size_t size, UINT64 hash = 14695981039346656037ull) { return HashShaderCacheBytes(pData, size, hash); }
+    static UINT64 ComputeKey(UINT64 sourceHash, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target, UINT compileFlags)
+    {
+        return ComputeShaderCacheKey(sourceHash, pDefines, entryPoint, target, compileFlags);
+    }
+
+private:
+    void Unmap();
+    void Write();
+
+    std::wstring m_filename;
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const UINT8* m_pView;
+    ShaderCacheIndex m_index;
+
+    ShaderSourceHasher m_sourceHasher;
+    std::map<UINT64, ShaderCacheBlob> m_usedShaders;
+    std::vector<ComPtr<ID3DBlob>> m_compiledShaders;
+    UINT m_hitCount;
+    UINT m_missCount;
+};
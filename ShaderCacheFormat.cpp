@@ -0,0 +1,186 @@
+#include "ShaderCacheFormat.h"
+#include <sstream>
+
+uint64_t HashShaderCacheBytes(const void* pData, size_t size, uint64_t hash)
+{
+    const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= pBytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ShaderSourceHasher::ShaderSourceHasher(const ReadFunction& readFile) :
+    m_readFile(readFile)
+{
+}
+
+uint64_t ShaderSourceHasher::HashFile(const std::wstring& filename)
+{
+    auto it = m_hashes.find(filename);
+    if (it != m_hashes.end())
+    {
+        return it->second;
+    }
+
+    std::string source;
+    if (!m_readFile(filename, &source))
+    {
+        return 0;
+    }
+
+    // Guard against include cycles while recursing.
+    m_hashes[filename] = 0;
+    uint64_t hash = HashShaderCacheBytes(source.data(), source.size());
+
+    const std::wstring directory = filename.substr(0, filename.find_last_of(L"\\/") + 1);
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        const size_t directive = line.find("#include");
+        const size_t open = directive == std::string::npos ? std::string::npos : line.find('"', directive);
+        const size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        if (close == std::string::npos)
+        {
+            continue;
+        }
+        const std::string includeName = line.substr(open + 1, close - open - 1);
+        const uint64_t includeHash = HashFile(directory + std::wstring(includeName.begin(), includeName.end()));
+        hash = HashShaderCacheBytes(&includeHash, sizeof(includeHash), hash);
+    }
+
+    m_hashes[filename] = hash;
+    return hash;
+}
+
+ShaderCacheIndex::ShaderCacheIndex() :
+    m_pFile(nullptr),
+    m_pEntries(nullptr),
+    m_entryCount(0)
+{
+}
+
+bool ShaderCacheIndex::Open(const void* pFile, uint64_t fileSize)
+{
+    Clear();
+    if (pFile == nullptr || fileSize < sizeof(ShaderCacheHeader))
+    {
+        return false;
+    }
+
+    const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pFile);
+    const ShaderCacheHeader* pHeader = reinterpret_cast<const ShaderCacheHeader*>(pBytes);
+    const uint64_t indexEnd = sizeof(ShaderCacheHeader) + static_cast<uint64_t>(pHeader->entryCount) * sizeof(ShaderCacheEntry);
+    if (pHeader->magic != ShaderCacheFileMagic || pHeader->version != ShaderCacheFileVersion || indexEnd > fileSize)
+    {
+        return false;
+    }
+
+    // Drop the whole index if any blob points past the end of the file, or the keys are
+    // out of order and the search would miss.
+    const ShaderCacheEntry* pEntries = reinterpret_cast<const ShaderCacheEntry*>(pBytes + sizeof(ShaderCacheHeader));
+    for (uint32_t i = 0; i < pHeader->entryCount; i++)
+    {
+        const ShaderCacheEntry& entry = pEntries[i];
+        if (entry.offset > fileSize || entry.size > fileSize - entry.offset || (i > 0 && entry.key <= pEntries[i - 1].key))
+        {
+            return false;
+        }
+    }
+
+    m_pFile = pBytes;
+    m_pEntries = pEntries;
+    m_entryCount = pHeader->entryCount;
+    return true;
+}
+
+void ShaderCacheIndex::Clear()
+{
+    m_pFile = nullptr;
+    m_pEntries = nullptr;
+    m_entryCount = 0;
+}
+
+bool ShaderCacheIndex::Find(uint64_t key, ShaderCacheBlob* pBlob) const
+{
+    uint32_t first = 0;
+    uint32_t last = m_entryCount;
+    while (first < last)
+    {
+        const uint32_t middle = first + (last - first) / 2;
+        if (m_pEntries[middle].key < key)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+    if (first == m_entryCount || m_pEntries[first].key != key)
+    {
+        return false;
+    }
+    *pBlob = GetBlob(m_pEntries[first]);
+    return true;
+}
+
+ShaderCacheBlob ShaderCacheIndex::GetBlob(const ShaderCacheEntry& entry) const
+{
+    ShaderCacheBlob blob = {};
+    blob.pData = m_pFile + entry.offset;
+    blob.size = static_cast<size_t>(entry.size);
+    return blob;
+}
+
+void WriteShaderCacheFile(const ShaderCacheIndex& existing, const std::map<uint64_t, ShaderCacheBlob>& shaders, std::vector<uint8_t>* pContents)
+{
+    // Sorted by key, as the index has to be.
+    std::map<uint64_t, ShaderCacheBlob> merged;
+    for (uint32_t i = 0; i < existing.GetEntryCount(); i++)
+    {
+        const ShaderCacheEntry& entry = existing.GetEntry(i);
+        merged[entry.key] = existing.GetBlob(entry);
+    }
+    for (const auto& shader : shaders)
+    {
+        merged[shader.first] = shader.second;
+    }
+
+    ShaderCacheHeader header = {};
+    header.magic = ShaderCacheFileMagic;
+    header.version = ShaderCacheFileVersion;
+    header.entryCount = static_cast<uint32_t>(merged.size());
+
+    std::vector<ShaderCacheEntry> entries;
+    entries.reserve(merged.size());
+    uint64_t offset = sizeof(ShaderCacheHeader) + merged.size() * sizeof(ShaderCacheEntry);
+    for (const auto& shader : merged)
+    {
+        ShaderCacheEntry entry = {};
+        entry.key = shader.first;
+        entry.offset = offset;
+        entry.size = shader.second.size;
+        entries.push_back(entry);
+        offset += entry.size;
+    }
+
+    pContents->assign(static_cast<size_t>(offset), 0);
+    memcpy(pContents->data(), &header, sizeof(header));
+    if (!entries.empty())
+    {
+        memcpy(pContents->data() + sizeof(header), entries.data(), entries.size() * sizeof(ShaderCacheEntry));
+    }
+    size_t index = 0;
+    for (const auto& shader : merged)
+    {
+        if (shader.second.size > 0)
+        {
+            memcpy(pContents->data() + entries[index].offset, shader.second.pData, shader.second.size);
+        }
+        index++;
+    }
+}
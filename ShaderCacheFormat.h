@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The platform-independent half of ShaderCache: the key hashing, the index of a cache
+// file in memory and writing a new one. Only standard headers, so that PortableTests.cpp
+// can check them anywhere; ShaderCache adds the file mapping and the compiler.
+//
+// Layout: ShaderCacheHeader, entryCount ShaderCacheEntry records sorted by key, then
+// the bytecode blobs.
+const uint32_t ShaderCacheFileMagic = 0x43444853;      // 'SHDC'
+const uint32_t ShaderCacheFileVersion = 1;
+
+struct ShaderCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct ShaderCacheEntry
+{
+    uint64_t key;
+    uint64_t offset;        // From the start of the file.
+    uint64_t size;
+};
+
+// Bytecode somewhere in memory: in the mapped file or in a compiler's blob.
+struct ShaderCacheBlob
+{
+    const void* pData;
+    size_t size;
+};
+
+// 64-bit FNV-1a.
+uint64_t HashShaderCacheBytes(const void* pData, size_t size, uint64_t hash = 14695981039346656037ull);
+
+// Strings are hashed with their terminators so that adjacent fields cannot run
+// together. ShaderMacro is D3D_SHADER_MACRO or anything else with Name and
+// Definition, the list ended by a null Name.
+template <typename ShaderMacro>
+uint64_t ComputeShaderCacheKey(uint64_t sourceHash, const ShaderMacro* pDefines, const char* entryPoint, const char* target, uint32_t compileFlags)
+{
+    uint64_t key = HashShaderCacheBytes(&sourceHash, sizeof(sourceHash));
+    for (const ShaderMacro* pDefine = pDefines; pDefine != nullptr && pDefine->Name != nullptr; pDefine++)
+    {
+        key = HashShaderCacheBytes(pDefine->Name, strlen(pDefine->Name) + 1, key);
+        const char* definition = pDefine->Definition != nullptr ? pDefine->Definition : "";
+        key = HashShaderCacheBytes(definition, strlen(definition) + 1, key);
+    }
+    key = HashShaderCacheBytes(entryPoint, strlen(entryPoint) + 1, key);
+    key = HashShaderCacheBytes(target, strlen(target) + 1, key);
+    key = HashShaderCacheBytes(&compileFlags, sizeof(compileFlags), key);
+    return key;
+}
+
+// Hashes a shader source and, recursively, every file it pulls in with #include "...",
+// relative to the including file. Each file is read once through readFile, which
+// returns false for a file that doesn't exist; missing files are left for the compiler
+// to report and hash as 0.
+class ShaderSourceHasher
+{
+public:
+    typedef std::function<bool(const std::wstring& filename, std::string* pText)> ReadFunction;
+
+    explicit ShaderSourceHasher(const ReadFunction& readFile);
+
+    uint64_t HashFile(const std::wstring& filename);
+
+    // Forgets every hash, for sources that may have changed.
+    void Clear() { m_hashes.clear(); }
+
+private:
+    ReadFunction m_readFile;
+    std::unordered_map<std::wstring, uint64_t> m_hashes;
+};
+
+// The entries of a cache file already in memory. Open checks the header and that every
+// blob is inside the file; a file that fails either is treated as empty.
+class ShaderCacheIndex
+{
+public:
+    ShaderCacheIndex();
+
+    // Returns false, leaving the index empty, if the file isn't a valid cache.
+    bool Open(const void* pFile, uint64_t fileSize);
+    void Clear();
+
+    // Binary search of the sorted entries; false on a miss.
+    bool Find(uint64_t key, ShaderCacheBlob* pBlob) const;
+
+    uint32_t GetEntryCount() const { return m_entryCount; }
+    const ShaderCacheEntry& GetEntry(uint32_t index) const { return m_pEntries[index]; }
+    ShaderCacheBlob GetBlob(const ShaderCacheEntry& entry) const;
+
+private:
+    const uint8_t* m_pFile;
+    const ShaderCacheEntry* m_pEntries;
+    uint32_t m_entryCount;
+};
+
+// Lays out a cache file holding every entry of existing and every shader in shaders,
+// which win where both have a key, so that entries nobody asked for this time are
+// kept. The blobs are copied, so they may point into the file being replaced.
+void WriteShaderCacheFile(const ShaderCacheIndex& existing, const std::map<uint64_t, ShaderCacheBlob>& shaders, std::vector<uint8_t>* pContents);
@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "ShaderHotReload.h"
+#include "ShaderCache.h"
+#include <process.h>
+
+ShaderHotReload::ShaderHotReload() :
+    m_tracker(ShaderCache::ReadSourceFile),
+    m_hasRecompiledShaders(false),
+    m_exitEvent(nullptr),
+    m_threadHandle(nullptr)
+{
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+    Stop();
+}
+
+ShaderHotReload::CompileFunction ShaderHotReload::DefaultCompileFunction(UINT compileFlags)
+{
+    return [compileFlags](const std::wstring& filename, const char* entryPoint, const char* target, ComPtr<ID3DBlob>& bytecode)
+    {
+        ComPtr<ID3DBlob> errors;
+        const HRESULT hr = D3DCompileFromFile(filename.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint, target, compileFlags, 0, &bytecode, &errors);
+        if (errors != nullptr)
+        {
+            OutputDebugStringA(reinterpret_cast<const char*>(errors->GetBufferPointer()));
+        }
+        return hr;
+    };
+}
+
+void ShaderHotReload::Start(const std::wstring& directory, const std::vector<ShaderSource>& shaders, const CompileFunction& compile)
+{
+    Stop();
+
+    struct threadwrapper
+    {
+        static unsigned int WINAPI thunk(LPVOID lpParameter)
+        {
+            reinterpret_cast<ShaderHotReload*>(lpParameter)->WatcherThread();
+            return 0;
+        }
+    };
+
+    m_directory = directory;
+    m_shaders = shaders;
+    m_compile = compile;
+    m_hasRecompiledShaders = false;
+
+    // Keep our own copy of the bytecode; the caller's pointers may not outlive this call.
+    m_currentShaders.resize(m_shaders.size());
+    m_changedShaders.assign(m_shaders.size(), false);
+    std::vector<std::wstring> filenames(m_shaders.size());
+    for (size_t i = 0; i < m_shaders.size(); i++)
+    {
+        const D3D12_SHADER_BYTECODE& bytecode = m_shaders[i].initialBytecode;
+        ThrowIfFailed(D3DCreateBlob(bytecode.BytecodeLength, &m_currentShaders[i]));
+        memcpy(m_currentShaders[i]->GetBufferPointer(), bytecode.pShaderBytecode, bytecode.BytecodeLength);
+        m_shaders[i].initialBytecode = {};
+        filenames[i] = m_shaders[i].filename;
+    }
+    m_tracker.Start(filenames);
+
+    m_exitEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (m_exitEvent == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    m_threadHandle = reinterpret_cast<HANDLE>(_beginthreadex(
+        nullptr,
+        0,
+        threadwrapper::thunk,
+        reinterpret_cast<LPVOID>(this),
+        0,
+        nullptr));
+    assert(m_threadHandle != NULL);
+}
+
+void ShaderHotReload::Stop()
+{
+    if (m_threadHandle != nullptr)
+    {
+        SetEvent(m_exitEvent);
+        WaitForSingleObject(m_threadHandle, INFINITE);
+        CloseHandle(m_threadHandle);
+        m_threadHandle = nullptr;
+    }
+    if (m_exitEvent != nullptr)
+    {
+        CloseHandle(m_exitEvent);
+        m_exitEvent = nullptr;
+    }
+
+    // Stop is only called once the GPU is idle.
+    m_retiredObjects.clear();
+    m_currentShaders.clear();
+    m_changedShaders.clear();
+    m_shaders.clear();
+}
+
+bool ShaderHotReload::TakeRecompiledShaders(std::vector<ComPtr<ID3DBlob>>& shaders, std::vector<bool>& changed)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_hasRecompiledShaders)
+    {
+        return false;
+    }
+    shaders = m_currentShaders;
+    changed = m_changedShaders;
+    m_changedShaders.assign(m_shaders.size(), false);
+    m_hasRecompiledShaders = false;
+    return true;
+}
+
+void ShaderHotReload::RetireObject(ID3D12Object* pObject, UINT64 fenceValue)
+{
+    if (pObject == nullptr)
+    {
+        return;
+    }
+
+    RetiredObject retired;
+    retired.object = pObject;
+    retired.fenceValue = fenceValue;
+    m_retiredObjects.push_back(retired);
+}
+
+void ShaderHotReload::ReleaseRetiredObjects(UINT64 completedFenceValue)
+{
+    while (!m_retiredObjects.empty() && m_retiredObjects.front().fenceValue <= completedFenceValue)
+    {
+        m_retiredObjects.pop_front();
+    }
+}
+
+void ShaderHotReload::WatcherThread()
+{
+    HANDLE changeHandle = FindFirstChangeNotification(m_directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (changeHandle == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    HANDLE waitHandles[] = { m_exitEvent, changeHandle };
+    while (WaitForMultipleObjects(_countof(waitHandles), waitHandles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+    {
+        // Editors often write a file in several steps; let them finish before compiling.
+        if (WaitForSingleObject(m_exitEvent, 100) == WAIT_OBJECT_0)
+        {
+            break;
+        }
+        RecompileChangedFiles();
+        FindNextChangeNotification(changeHandle);
+    }
+
+    FindCloseChangeNotification(changeHandle);
+}
+
+void ShaderHotReload::RecompileChangedFiles()
+{
+    std::vector<ComPtr<ID3DBlob>> recompiled(m_shaders.size());
+    std::vector<bool> changed;
+    const bool compiled = m_tracker.Recompile([this, &recompiled](size_t shader)
+    {
+        return SUCCEEDED(m_compile(m_shaders[shader].filename, m_shaders[shader].entryPoint.c_str(), m_shaders[shader].target.c_str(), recompiled[shader]));
+    }, &changed);
+    if (!compiled)
+    {
+        // Publish nothing until every changed shader compiles; the next save retries.
+        OutputDebugStringA("Shader hot reload: compile failed, keeping the current shaders.\n");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_shaders.size(); i++)
+    {
+        if (changed[i])
+        {
+            m_currentShaders[i] = recompiled[i];
+            m_changedShaders[i] = true;
+            m_hasRecompiledShaders = true;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include "ShaderReloadTracker.h"
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Watches shader sources and recompiles them on a background thread when they, or a
+// file they include, change; ShaderReloadTracker decides which. The render thread picks
+// up complete, successfully compiled sets at a frame boundary with TakeRecompiledShaders,
+// and hands replaced GPU objects to RetireObject so they are released only after the
+// frames that used them have retired.
+class ShaderHotReload
+{
+public:
+    // Injected so the watcher can run against a stub compiler.
+    typedef std::function<HRESULT(const std::wstring& filename, const char* entryPoint, const char* target, ComPtr<ID3DBlob>& bytecode)> CompileFunction;
+
+    struct ShaderSource
+    {
+        std::wstring filename;
+        std::string entryPoint;
+        std::string target;
+        D3D12_SHADER_BYTECODE initialBytecode;
+    };
+
+    ShaderHotReload();
+    ~ShaderHotReload();
+
+    static CompileFunction DefaultCompileFunction(UINT compileFlags);
+
+    void Start(const std::wstring& directory, const std::vector<ShaderSource>& shaders, const CompileFunction& compile);
+    void Stop();
+
+    // Returns the current bytecode of every shader, in Start order, if anything was
+    // recompiled since the previous call, and flags the shaders that were in changed.
+    bool TakeRecompiledShaders(std::vector<ComPtr<ID3DBlob>>& shaders, std::vector<bool>& changed);
+
+    void RetireObject(ID3D12Object* pObject, UINT64 fenceValue);
+    void ReleaseRetiredObjects(UINT64 completedFenceValue);
+
+private:
+    struct RetiredObject
+    {
+        ComPtr<ID3D12Object> object;
+        UINT64 fenceValue;
+    };
+
+    void WatcherThread();
+    void RecompileChangedFiles();
+
+    std::vector<ShaderSource> m_shaders;
+    ShaderReloadTracker m_tracker;              // Only used by the watcher thread.
+    CompileFunction m_compile;
+    std::wstring m_directory;
+
+    std::mutex m_mutex;
+    std::vector<ComPtr<ID3DBlob>> m_currentShaders;
+    std::vector<bool> m_changedShaders;         // Since the last TakeRecompiledShaders.
+    bool m_hasRecompiledShaders;
+
+    std::deque<RetiredObject> m_retiredObjects;
+
+    HANDLE m_exitEvent;
+    HANDLE m_threadHandle;
+};
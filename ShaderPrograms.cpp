@@ -0,0 +1,23 @@
+#include "stdafx.h"
+#include "ShaderPrograms.h"
+
+// Sized by its initialisers, so that a missing entry fails to match the declaration.
+const ShaderProgram ShaderPrograms[] =
+{
+    { L"shaders.hlsl", "VSMain", "vs_5_0" },    // ShaderProgramSceneVS
+    { L"shaders.hlsl", "PSMain", "ps_5_0" },    // ShaderProgramScenePS
+    { L"ObjectTransforms.hlsl", "CSMain", "cs_5_0" },   // ShaderProgramObjectTransformsCS
+    { L"shaders.hlsl", "VSMainIndirect", "vs_5_0" },    // ShaderProgramSceneIndirectVS
+    { L"ObjectTransforms.hlsl", "CullAndCompactCS", "cs_5_0" },     // ShaderProgramCullAndCompactCS
+    { L"shaders.hlsl", "VSMainRootCbv", "vs_5_0" },     // ShaderProgramSceneRootCbvVS
+};
+
+UINT GetShaderCompileFlags()
+{
+#if defined(_DEBUG)
+    // Enable better shader debugging with the graphics debugging tools.
+    return D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "stdafx.h"
+
+// Indices into ShaderPrograms.
+enum ShaderProgramId
+{
+    ShaderProgramSceneVS = 0,
+    ShaderProgramScenePS,
+    ShaderProgramObjectTransformsCS,
+    ShaderProgramSceneIndirectVS,
+    ShaderProgramCullAndCompactCS,
+    ShaderProgramSceneRootCbvVS,
+    ShaderProgramCount
+};
+
+struct ShaderProgram
+{
+    LPCWSTR filename;           // In the assets directory.
+    const char* entryPoint;
+    const char* target;
+};
+
+// Every shader the sample loads. -precompileshaders fills the cache from this list, and
+// the bench target's -shaders mode times loading it with and without the cache.
+extern const ShaderProgram ShaderPrograms[ShaderProgramCount];
+
+UINT GetShaderCompileFlags();
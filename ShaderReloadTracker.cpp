@@ -0,0 +1,48 @@
+#include "ShaderReloadTracker.h"
+
+ShaderReloadTracker::ShaderReloadTracker(const ShaderSourceHasher::ReadFunction& readFile) :
+    m_hasher(readFile)
+{
+}
+
+void ShaderReloadTracker::Start(const std::vector<std::wstring>& filenames)
+{
+    m_filenames = filenames;
+    m_hashes.resize(m_filenames.size());
+    m_hasher.Clear();
+    for (size_t i = 0; i < m_filenames.size(); i++)
+    {
+        m_hashes[i] = m_hasher.HashFile(m_filenames[i]);
+    }
+}
+
+bool ShaderReloadTracker::Recompile(const CompileFunction& compile, std::vector<bool>* pChanged)
+{
+    pChanged->assign(m_filenames.size(), false);
+
+    // Every file is read again; an include may have changed under any of them.
+    m_hasher.Clear();
+    std::vector<uint64_t> hashes(m_filenames.size());
+    for (size_t i = 0; i < m_filenames.size(); i++)
+    {
+        hashes[i] = m_hasher.HashFile(m_filenames[i]);
+    }
+
+    std::vector<bool> changed(m_filenames.size(), false);
+    for (size_t i = 0; i < m_filenames.size(); i++)
+    {
+        if (hashes[i] == m_hashes[i])
+        {
+            continue;
+        }
+        if (!compile(i))
+        {
+            return false;
+        }
+        changed[i] = true;
+    }
+
+    m_hashes = hashes;
+    *pChanged = changed;
+    return true;
+}
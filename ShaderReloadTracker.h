@@ -0,0 +1,33 @@
+#pragma once
+#include "ShaderCacheFormat.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Decides what shader hot reload recompiles. Each shader's source is hashed with every
+// file it #includes, so that saving InstanceData.hlsli recompiles every shader that pulls
+// it in, and saving a file without changing it recompiles nothing. Only standard headers,
+// so that PortableTests.cpp can run it against a stub compiler; ShaderHotReload adds the
+// directory watcher and D3DCompile.
+class ShaderReloadTracker
+{
+public:
+    // Compiles the shader at that index and keeps the result; false if it doesn't compile.
+    typedef std::function<bool(size_t shader)> CompileFunction;
+
+    explicit ShaderReloadTracker(const ShaderSourceHasher::ReadFunction& readFile);
+
+    // One source file per shader; shaders may share one. Their current contents count as
+    // compiled.
+    void Start(const std::vector<std::wstring>& filenames);
+
+    // Compiles every shader whose source or includes changed since it last compiled, and
+    // flags them in changed. If any fails, nothing is flagged and the old hashes are
+    // kept, so that the next call retries the whole set, and false is returned.
+    bool Recompile(const CompileFunction& compile, std::vector<bool>* pChanged);
+
+private:
+    ShaderSourceHasher m_hasher;
+    std::vector<std::wstring> m_filenames;
+    std::vector<uint64_t> m_hashes;
+};
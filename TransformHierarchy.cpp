@@ -0,0 +1,266 @@
+#include "stdafx.h"
+#include "TransformHierarchy.h"
+#include <algorithm>
+
+TransformHierarchy::TransformHierarchy() :
+    m_levelStarts(1, 0),
+    m_updateIndex(0)
+{
+}
+
+void TransformHierarchy::Build(const UINT* pParents, UINT nodeCount)
+{
+    // Each node's children, in build order, as ranges of one array.
+    std::vector<UINT> childStarts(nodeCount + 1, 0);
+    for (UINT i = 0; i < nodeCount; i++)
+    {
+        if (pParents[i] != NoParent)
+        {
+            childStarts[pParents[i] + 1]++;
+        }
+    }
+    for (UINT i = 0; i < nodeCount; i++)
+    {
+        childStarts[i + 1] += childStarts[i];
+    }
+    std::vector<UINT> children(childStarts[nodeCount]);
+    std::vector<UINT> childCursors(childStarts.begin(), childStarts.end() - 1);
+    for (UINT i = 0; i < nodeCount; i++)
+    {
+        if (pParents[i] != NoParent)
+        {
+            children[childCursors[pParents[i]]++] = i;
+        }
+    }
+
+    // Breadth first from the roots: each level is the previous one's children, in order.
+    std::vector<UINT> order;
+    order.reserve(nodeCount);
+    for (UINT i = 0; i < nodeCount; i++)
+    {
+        if (pParents[i] == NoParent)
+        {
+            order.push_back(i);
+        }
+    }
+    m_levelStarts.assign(1, 0);
+    UINT levelStart = 0;
+    while (levelStart < order.size())
+    {
+        const UINT levelEnd = static_cast<UINT>(order.size());
+        m_levelStarts.push_back(levelEnd);
+        for (UINT i = levelStart; i < levelEnd; i++)
+        {
+            order.insert(order.end(), children.begin() + childStarts[order[i]], children.begin() + childStarts[order[i] + 1]);
+        }
+        levelStart = levelEnd;
+    }
+    // Nodes on a cycle are never reached from a root.
+    assert(order.size() == nodeCount);
+
+    m_nodeOfBuildIndex.resize(nodeCount);
+    for (UINT node = 0; node < nodeCount; node++)
+    {
+        m_nodeOfBuildIndex[order[node]] = node;
+    }
+    m_parents.resize(nodeCount);
+    for (UINT node = 0; node < nodeCount; node++)
+    {
+        const UINT parent = pParents[order[node]];
+        m_parents[node] = (parent == NoParent) ? NoParent : m_nodeOfBuildIndex[parent];
+    }
+
+    m_levelBatchStarts.assign(1, 0);
+    m_nodeSlots.resize(nodeCount);
+    for (UINT level = 0; level < GetLevelCount(); level++)
+    {
+        const UINT batchStart = m_levelBatchStarts[level];
+        for (UINT node = m_levelStarts[level]; node < m_levelStarts[level + 1]; node++)
+        {
+            m_nodeSlots[node] = batchStart * BatchSize + node - m_levelStarts[level];
+        }
+        const UINT levelSize = m_levelStarts[level + 1] - m_levelStarts[level];
+        m_levelBatchStarts.push_back(batchStart + (levelSize + BatchSize - 1) / BatchSize);
+    }
+
+    // _11, _22 and _33 are elements 0, 4 and 8.
+    TransformBatch identity;
+    for (UINT element = 0; element < 12; element++)
+    {
+        const float value = (element % 4 == 0) ? 1.0f : 0.0f;
+        identity.elements[element] = XMFLOAT4A(value, value, value, value);
+    }
+    m_localTransforms.assign(m_levelBatchStarts.back(), identity);
+    m_worldTransforms.assign(m_levelBatchStarts.back(), identity);
+
+    m_updateIndex = 0;
+    m_nodeDirtyUpdates.assign(nodeCount, 1);
+    m_nodeChangedUpdates.assign(nodeCount, 0);
+    m_levelDirtyUpdates.assign(GetLevelCount(), 1);
+    m_levelChangedUpdates.assign(GetLevelCount(), 0);
+}
+
+void TransformHierarchy::SetLocalTransform(UINT node, FXMMATRIX local)
+{
+    const UINT slot = m_nodeSlots[node];
+    StoreBatchTransform(&m_localTransforms[slot / BatchSize], slot % BatchSize, local);
+    m_nodeDirtyUpdates[node] = m_updateIndex + 1;
+    const UINT level = static_cast<UINT>(std::upper_bound(m_levelStarts.begin(), m_levelStarts.end(), node) - m_levelStarts.begin()) - 1;
+    m_levelDirtyUpdates[level] = m_updateIndex + 1;
+}
+
+XMMATRIX TransformHierarchy::GetWorldTransform(UINT node) const
+{
+    const UINT slot = m_nodeSlots[node];
+    return LoadBatchTransform(m_worldTransforms[slot / BatchSize], slot % BatchSize);
+}
+
+void TransformHierarchy::StoreBatchTransform(TransformBatch* pBatch, UINT lane, FXMMATRIX transform)
+{
+    XMFLOAT4X3 elements;
+    XMStoreFloat4x3(&elements, transform);
+    for (UINT element = 0; element < 12; element++)
+    {
+        (&pBatch->elements[element].x)[lane] = (&elements._11)[element];
+    }
+}
+
+XMMATRIX TransformHierarchy::LoadBatchTransform(const TransformBatch& batch, UINT lane)
+{
+    XMFLOAT4X3 elements;
+    for (UINT element = 0; element < 12; element++)
+    {
+        (&elements._11)[element] = (&batch.elements[element].x)[lane];
+    }
+    return XMLoadFloat4x3(&elements);
+}
+
+UINT TransformHierarchy::UpdateWorldTransforms(UINT threadIndex, UINT threadCount, LPSYNCHRONIZATION_BARRIER pLevelBarrier)
+{
+    assert(threadCount == 1 || pLevelBarrier != nullptr);
+
+    const UINT update = m_updateIndex + 1;
+    UINT updatedCount = 0;
+    for (UINT level = 0; level < GetLevelCount(); level++)
+    {
+        // Every thread reads the same flags, so all of them skip the same levels.
+        const bool parentsChanged = level > 0 && m_levelChangedUpdates[level - 1] == static_cast<LONG>(update);
+        if (parentsChanged || m_levelDirtyUpdates[level] == update)
+        {
+            // Whole batches to each thread, so that no two threads write one.
+            const UINT levelStart = m_levelStarts[level];
+            const UINT levelEnd = m_levelStarts[level + 1];
+            const UINT batchStart = m_levelBatchStarts[level];
+            const UINT batchCount = m_levelBatchStarts[level + 1] - batchStart;
+            const UINT firstBatch = batchStart + threadIndex * batchCount / threadCount;
+            const UINT endBatch = batchStart + (threadIndex + 1) * batchCount / threadCount;
+            UINT changedCount = 0;
+            for (UINT batch = firstBatch; batch < endBatch; batch++)
+            {
+                const UINT firstNode = levelStart + (batch - batchStart) * BatchSize;
+                const UINT laneCount = min(BatchSize, levelEnd - firstNode);
+                XMVECTORU32 changedLanes = {};
+                bool batchChanged = false;
+                bool sharedParent = true;
+                for (UINT lane = 0; lane < laneCount; lane++)
+                {
+                    const UINT node = firstNode + lane;
+                    const UINT parent = m_parents[node];
+                    const bool parentChanged = parent != NoParent && m_nodeChangedUpdates[parent] == update;
+                    if (parentChanged || m_nodeDirtyUpdates[node] == update)
+                    {
+                        changedLanes.u[lane] = 0xFFFFFFFF;
+                        batchChanged = true;
+                        m_nodeChangedUpdates[node] = update;
+                        changedCount++;
+                    }
+                    sharedParent = sharedParent && parent == m_parents[firstNode];
+                }
+                if (!batchChanged)
+                {
+                    continue;
+                }
+
+                // The parents' world transforms, element by element across the lanes:
+                // siblings usually share one, which is then simply replicated. Lanes
+                // past the level's end take the first lane's and are thrown away.
+                const TransformBatch& local = m_localTransforms[batch];
+                TransformBatch& world = m_worldTransforms[batch];
+                XMVECTOR parentElements[12];
+                if (level > 0)
+                {
+                    if (sharedParent)
+                    {
+                        const UINT slot = m_nodeSlots[m_parents[firstNode]];
+                        const TransformBatch& parentBatch = m_worldTransforms[slot / BatchSize];
+                        for (UINT element = 0; element < 12; element++)
+                        {
+                            parentElements[element] = XMVectorReplicate((&parentBatch.elements[element].x)[slot % BatchSize]);
+                        }
+                    }
+                    else
+                    {
+                        TransformBatch gathered;
+                        for (UINT lane = 0; lane < BatchSize; lane++)
+                        {
+                            const UINT slot = m_nodeSlots[m_parents[firstNode + (lane < laneCount ? lane : 0)]];
+                            const TransformBatch& parentBatch = m_worldTransforms[slot / BatchSize];
+                            for (UINT element = 0; element < 12; element++)
+                            {
+                                (&gathered.elements[element].x)[lane] = (&parentBatch.elements[element].x)[slot % BatchSize];
+                            }
+                        }
+                        for (UINT element = 0; element < 12; element++)
+                        {
+                            parentElements[element] = XMLoadFloat4A(&gathered.elements[element]);
+                        }
+                    }
+                }
+
+                for (UINT row = 0; row < 4; row++)
+                {
+                    const XMVECTOR local0 = XMLoadFloat4A(&local.elements[3 * row]);
+                    const XMVECTOR local1 = XMLoadFloat4A(&local.elements[3 * row + 1]);
+                    const XMVECTOR local2 = XMLoadFloat4A(&local.elements[3 * row + 2]);
+                    for (UINT column = 0; column < 3; column++)
+                    {
+                        XMVECTOR result = XMLoadFloat4A(&local.elements[3 * row + column]);
+                        if (level > 0)
+                        {
+                            // local * parent, summed in XMMatrixMultiply's order so that the
+                            // results match it exactly. The local matrix's fourth column is
+                            // (0, 0, 0, 1).
+                            const XMVECTOR x = XMVectorMultiplyAdd(local2, parentElements[6 + column], XMVectorMultiply(local0, parentElements[column]));
+                            XMVECTOR y = XMVectorMultiply(local1, parentElements[3 + column]);
+                            if (row == 3)
+                            {
+                                y = XMVectorAdd(y, parentElements[9 + column]);
+                            }
+                            result = XMVectorAdd(x, y);
+                        }
+                        const XMVECTOR previous = XMLoadFloat4A(&world.elements[3 * row + column]);
+                        XMStoreFloat4A(&world.elements[3 * row + column], XMVectorSelect(previous, result, changedLanes));
+                    }
+                }
+            }
+            if (changedCount > 0)
+            {
+                InterlockedExchange(&m_levelChangedUpdates[level], static_cast<LONG>(update));
+            }
+            updatedCount += changedCount;
+        }
+
+        // The next level reads this one's world transforms. After the last level, the
+        // barrier keeps thread 0 from moving m_updateIndex on while others still read it.
+        if (threadCount > 1)
+        {
+            EnterSynchronizationBarrier(pLevelBarrier, 0);
+        }
+    }
+
+    if (threadIndex == 0)
+    {
+        m_updateIndex = update;
+    }
+    return updatedCount;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+using namespace DirectX;
+
+// Parented transforms, stored breadth first with parent indices rather than as a tree
+// of nodes: every level is one contiguous range, and each parent's children are
+// contiguous and in their parents' order. A level's update then streams through its
+// own nodes and through its parents' world transforms in order. Nodes of one level
+// don't depend on each other, so threads split each level and meet at a barrier
+// before the next one.
+//
+// The transforms are kept as structure of arrays in batches of BatchSize nodes, each of
+// the twelve elements of a 4x3 matrix one vector across the batch, so that a batch's
+// world transforms take one set of vector multiplies instead of one matrix multiply per
+// node. Every level starts a new batch, so that a level's threads never write the
+// batches the previous level's world transforms are read from.
+//
+// Only dirty subtrees are recomputed: a node whose local transform was set, and
+// everything below it. Levels with nothing dirty are skipped without looking at
+// their nodes.
+class TransformHierarchy
+{
+public:
+    static const UINT NoParent = ~0u;
+    static const UINT BatchSize = 4;
+
+    TransformHierarchy();
+
+    // pParents[i] is node i's parent, or NoParent for a root; there must be no cycles.
+    // The nodes start with identity local transforms, all dirty.
+    void Build(const UINT* pParents, UINT nodeCount);
+
+    UINT GetNodeCount() const { return static_cast<UINT>(m_parents.size()); }
+    UINT GetLevelCount() const { return static_cast<UINT>(m_levelStarts.size() - 1); }
+
+    // Build's index of a node to the breadth-first one every other call takes.
+    UINT GetNode(UINT buildIndex) const { return m_nodeOfBuildIndex[buildIndex]; }
+    UINT GetParent(UINT node) const { return m_parents[node]; }
+
+    // Relative to the parent. Not thread safe, and not during an update.
+    void SetLocalTransform(UINT node, FXMMATRIX local);
+    XMMATRIX GetWorldTransform(UINT node) const;
+
+    // Thread threadIndex's share of bringing every world transform up to date. Each of
+    // threadCount threads calls it, with a barrier for threadCount threads; one thread
+    // may pass nullptr. Returns how many nodes this thread recomputed.
+    UINT UpdateWorldTransforms(UINT threadIndex, UINT threadCount, LPSYNCHRONIZATION_BARRIER pLevelBarrier);
+
+private:
+    // Element e of the nodes' 4x3 matrices, in XMFLOAT4X3's order, is elements[e].
+    struct TransformBatch
+    {
+        XMFLOAT4A elements[12];
+    };
+
+    static void StoreBatchTransform(TransformBatch* pBatch, UINT lane, FXMMATRIX transform);
+    static XMMATRIX LoadBatchTransform(const TransformBatch& batch, UINT lane);
+
+    std::vector<TransformBatch> m_localTransforms;
+    std::vector<TransformBatch> m_worldTransforms;
+    std::vector<UINT> m_parents;
+    std::vector<UINT> m_levelStarts;        // GetLevelCount() + 1 entries; level i is [m_levelStarts[i], m_levelStarts[i + 1]).
+    std::vector<UINT> m_levelBatchStarts;   // Likewise, in batches.
+    std::vector<UINT> m_nodeSlots;          // Batch times BatchSize plus lane.
+    std::vector<UINT> m_nodeOfBuildIndex;
+
+    // Update numbers, so that nothing needs clearing between updates: a node or level
+    // is dirty when its entry is the next update's number, and changed when it is the
+    // current update's.
+    std::vector<UINT> m_nodeDirtyUpdates;
+    std::vector<UINT> m_nodeChangedUpdates;
+    std::vector<UINT> m_levelDirtyUpdates;
+    std::vector<LONG> m_levelChangedUpdates;    // Written by every thread that changed a node of the level.
+    UINT m_updateIndex;                         // Of the last update.
+};
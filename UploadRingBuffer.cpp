@@ -0,0 +1,82 @@
+#include "stdafx.h"
+#include "UploadRingBuffer.h"
+
+UploadRingBuffer::UploadRingBuffer() :
+    m_pHeapAllocator(nullptr),
+    m_bufferAllocation(),
+    m_pCpuBase(nullptr),
+    m_gpuBase(0)
+{
+}
+
+UploadRingBuffer::~UploadRingBuffer()
+{
+    Release();
+}
+
+void UploadRingBuffer::Create(HeapSuballocator* pHeapAllocator, UINT64 size)
+{
+    Release();
+
+    m_pHeapAllocator = pHeapAllocator;
+    m_bufferAllocation = m_pHeapAllocator->CreatePlacedResource(
+        D3D12_HEAP_TYPE_UPLOAD,
+        &CD3DX12_RESOURCE_DESC::Buffer(size),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_buffer));
+    NAME_D3D12_OBJECT(m_buffer);
+
+    // Keep the buffer mapped for its whole lifetime.
+    CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
+    ThrowIfFailed(m_buffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pCpuBase)));
+    m_gpuBase = m_buffer->GetGPUVirtualAddress();
+
+    m_allocator.Reset(size);
+}
+
+void UploadRingBuffer::Release()
+{
+    if (m_buffer)
+    {
+        m_buffer->Unmap(0, nullptr);
+        m_buffer.Reset();
+        m_pHeapAllocator->Free(m_bufferAllocation);
+    }
+    m_pCpuBase = nullptr;
+    m_gpuBase = 0;
+    m_allocator.Reset(0);
+}
+
+UploadAllocation UploadRingBuffer::Allocate(UINT64 size, UINT64 alignment)
+{
+    const UINT64 offset = m_allocator.Allocate(size, alignment);
+    if (offset == RingAllocator::InvalidOffset)
+    {
+        throw HrException(E_OUTOFMEMORY);
+    }
+
+    UploadAllocation allocation = {};
+    allocation.pResource = m_buffer.Get();
+    allocation.offset = offset;
+    allocation.pCpuAddress = m_pCpuBase + offset;
+    allocation.gpuAddress = m_gpuBase + offset;
+    return allocation;
+}
+
+void UploadRingBuffer::CopyBuffer(ID3D12GraphicsCommandList* pCommandList, ID3D12Resource* pDestination, UINT64 destinationOffset, const void* pData, UINT64 size)
+{
+    UploadAllocation allocation = Allocate(size, 4);
+    memcpy(allocation.pCpuAddress, pData, static_cast<size_t>(size));
+    pCommandList->CopyBufferRegion(pDestination, destinationOffset, allocation.pResource, allocation.offset, size);
+}
+
+void UploadRingBuffer::CopyTexture(ID3D12GraphicsCommandList* pCommandList, ID3D12Resource* pDestination, UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* pSrcData)
+{
+    const UINT64 uploadSize = GetRequiredIntermediateSize(pDestination, firstSubresource, numSubresources);
+    UploadAllocation allocation = Allocate(uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    if (UpdateSubresources(pCommandList, pDestination, allocation.pResource, allocation.offset, firstSubresource, numSubresources, pSrcData) == 0)
+    {
+        ThrowIfFailed(E_FAIL);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include "HeapAllocator.h"
+#include "RingAllocator.h"
+
+struct UploadAllocation
+{
+    ID3D12Resource* pResource;
+    UINT64 offset;
+    UINT8* pCpuAddress;
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+};
+
+// A single persistently mapped UPLOAD heap buffer that stages every CPU -> GPU
+// copy. Memory is recycled with RingAllocator, so callers must call FinishFrame
+// after submitting the copies and Retire with the last completed fence value.
+class UploadRingBuffer
+{
+public:
+    UploadRingBuffer();
+    ~UploadRingBuffer();
+
+    void Create(HeapSuballocator* pHeapAllocator, UINT64 size);
+    void Release();
+
+    // Throws HrException(E_OUTOFMEMORY) when the ring is full.
+    UploadAllocation Allocate(UINT64 size, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+    // Stages pData and records a copy into pDestination, which must be in the COPY_DEST state.
+    void CopyBuffer(ID3D12GraphicsCommandList* pCommandList, ID3D12Resource* pDestination, UINT64 destinationOffset, const void* pData, UINT64 size);
+    void CopyTexture(ID3D12GraphicsCommandList* pCommandList, ID3D12Resource* pDestination, UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* pSrcData);
+
+    void FinishFrame(UINT64 fenceValue) { m_allocator.FinishFrame(fenceValue); }
+    void Retire(UINT64 completedFenceValue) { m_allocator.Retire(completedFenceValue); }
+
+    ID3D12Resource* GetResource() const { return m_buffer.Get(); }
+
+private:
+    HeapSuballocator* m_pHeapAllocator;
+    ComPtr<ID3D12Resource> m_buffer;
+    HeapAllocation m_bufferAllocation;
+    UINT8* m_pCpuBase;
+    D3D12_GPU_VIRTUAL_ADDRESS m_gpuBase;
+    RingAllocator m_allocator;
+};
@@ -0,0 +1,235 @@
+#include "stdafx.h"
+#include "VertexQuantization.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    const float UnormMax = 65535.0f;
+    const float SnormMax = 32767.0f;
+
+    UINT16 QuantizeUnorm(float value, float minimum, float inverseExtent)
+    {
+        return static_cast<UINT16>(min(max((value - minimum) * inverseExtent, 0.0f), 1.0f) * UnormMax + 0.5f);
+    }
+
+    // As the input assembler converts them.
+    float DecodeUnorm(UINT16 value)
+    {
+        return value / UnormMax;
+    }
+
+    float DecodeSnorm(INT16 value)
+    {
+        return max(value / SnormMax, -1.0f);
+    }
+
+    float SignNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    struct VertexBounds
+    {
+        XMFLOAT3 positionMin;
+        XMFLOAT3 positionMax;
+        XMFLOAT2 uvMin;
+        XMFLOAT2 uvMax;
+    };
+}
+
+void ComputeVertexNormals(Mesh* pMesh)
+{
+    const Mesh& mesh = *pMesh;
+    const UINT vertexCount = static_cast<UINT>(mesh.vertices.size());
+
+    // Vertices sorted by position, so that each run shares one sum, kept by the run's first.
+    std::vector<UINT> order(vertexCount);
+    for (UINT i = 0; i < vertexCount; i++)
+    {
+        order[i] = i;
+    }
+    auto positionLess = [&mesh](UINT a, UINT b)
+    {
+        const XMFLOAT3& p = mesh.vertices[a].position;
+        const XMFLOAT3& q = mesh.vertices[b].position;
+        return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z != q.z ? p.z < q.z : a < b;
+    };
+    std::sort(order.begin(), order.end(), positionLess);
+    std::vector<UINT> shared(vertexCount);
+    for (UINT i = 0; i < vertexCount; i++)
+    {
+        const bool samePosition = i > 0 && memcmp(&mesh.vertices[order[i]].position, &mesh.vertices[order[i - 1]].position, sizeof(XMFLOAT3)) == 0;
+        shared[order[i]] = samePosition ? shared[order[i - 1]] : order[i];
+    }
+
+    // The cross product's length is twice the triangle's area, which weights it.
+    std::vector<XMFLOAT3> sums(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+    const size_t firstIndex = mesh.lods.empty() ? 0 : mesh.lods[0].firstIndex;
+    const size_t endIndex = mesh.lods.empty() ? mesh.indices.size() / 3 * 3 : firstIndex + mesh.lods[0].indexCount;
+    for (size_t i = firstIndex; i < endIndex; i += 3)
+    {
+        const XMVECTOR a = XMLoadFloat3(&mesh.vertices[mesh.indices[i]].position);
+        const XMVECTOR b = XMLoadFloat3(&mesh.vertices[mesh.indices[i + 1]].position);
+        const XMVECTOR c = XMLoadFloat3(&mesh.vertices[mesh.indices[i + 2]].position);
+        const XMVECTOR normal = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            XMFLOAT3& sum = sums[shared[mesh.indices[i + corner]]];
+            XMStoreFloat3(&sum, XMVectorAdd(XMLoadFloat3(&sum), normal));
+        }
+    }
+
+    // Vertices no triangle reaches face the viewer.
+    for (UINT i = 0; i < vertexCount; i++)
+    {
+        const XMVECTOR sum = XMLoadFloat3(&sums[shared[i]]);
+        const bool hasArea = XMVectorGetX(XMVector3Length(sum)) > 0.0f;
+        XMStoreFloat3(&pMesh->vertices[i].normal, hasArea ? XMVector3Normalize(sum) : XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f));
+    }
+}
+
+void EncodeOctahedralNormal(FXMVECTOR normal, INT16 encoded[2])
+{
+    XMFLOAT3 n;
+    XMStoreFloat3(&n, normal);
+    const float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float x = length > 0.0f ? n.x / length : 0.0f;
+    float y = length > 0.0f ? n.y / length : 0.0f;
+    if (n.z < 0.0f)
+    {
+        const float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+        y = (1.0f - fabsf(x)) * SignNotZero(y);
+        x = foldedX;
+    }
+    encoded[0] = static_cast<INT16>(floorf(min(max(x, -1.0f), 1.0f) * SnormMax + 0.5f));
+    encoded[1] = static_cast<INT16>(floorf(min(max(y, -1.0f), 1.0f) * SnormMax + 0.5f));
+}
+
+XMVECTOR DecodeOctahedralNormal(const INT16 encoded[2])
+{
+    float x = DecodeSnorm(encoded[0]);
+    float y = DecodeSnorm(encoded[1]);
+    const float z = 1.0f - fabsf(x) - fabsf(y);
+    const float fold = max(-z, 0.0f);
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+    return XMVector3Normalize(XMVectorSet(x, y, z, 0.0f));
+}
+
+void QuantizeMesh(const Mesh& mesh, UINT threadCount, QuantizedMesh* pResult)
+{
+    const UINT vertexCount = static_cast<UINT>(mesh.vertices.size());
+    threadCount = max(min(threadCount, vertexCount / 4096), 1u);
+    auto getFirst = [vertexCount, threadCount](UINT thread)
+    {
+        return static_cast<UINT>(static_cast<UINT64>(vertexCount) * thread / threadCount);
+    };
+
+    std::vector<VertexBounds> threadBounds(threadCount);
+    RunInParallel(threadCount, [&](UINT thread)
+    {
+        VertexBounds bounds = { XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX), XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX), XMFLOAT2(FLT_MAX, FLT_MAX), XMFLOAT2(-FLT_MAX, -FLT_MAX) };
+        XMVECTOR positionMin = XMLoadFloat3(&bounds.positionMin);
+        XMVECTOR positionMax = XMLoadFloat3(&bounds.positionMax);
+        XMVECTOR uvMin = XMLoadFloat2(&bounds.uvMin);
+        XMVECTOR uvMax = XMLoadFloat2(&bounds.uvMax);
+        for (UINT i = getFirst(thread); i < getFirst(thread + 1); i++)
+        {
+            positionMin = XMVectorMin(positionMin, XMLoadFloat3(&mesh.vertices[i].position));
+            positionMax = XMVectorMax(positionMax, XMLoadFloat3(&mesh.vertices[i].position));
+            uvMin = XMVectorMin(uvMin, XMLoadFloat2(&mesh.vertices[i].uv));
+            uvMax = XMVectorMax(uvMax, XMLoadFloat2(&mesh.vertices[i].uv));
+        }
+        XMStoreFloat3(&bounds.positionMin, positionMin);
+        XMStoreFloat3(&bounds.positionMax, positionMax);
+        XMStoreFloat2(&bounds.uvMin, uvMin);
+        XMStoreFloat2(&bounds.uvMax, uvMax);
+        threadBounds[thread] = bounds;
+    });
+    XMVECTOR positionMin = XMLoadFloat3(&threadBounds[0].positionMin);
+    XMVECTOR positionMax = XMLoadFloat3(&threadBounds[0].positionMax);
+    XMVECTOR uvMin = XMLoadFloat2(&threadBounds[0].uvMin);
+    XMVECTOR uvMax = XMLoadFloat2(&threadBounds[0].uvMax);
+    for (UINT thread = 1; thread < threadCount; thread++)
+    {
+        positionMin = XMVectorMin(positionMin, XMLoadFloat3(&threadBounds[thread].positionMin));
+        positionMax = XMVectorMax(positionMax, XMLoadFloat3(&threadBounds[thread].positionMax));
+        uvMin = XMVectorMin(uvMin, XMLoadFloat2(&threadBounds[thread].uvMin));
+        uvMax = XMVectorMax(uvMax, XMLoadFloat2(&threadBounds[thread].uvMax));
+    }
+    if (vertexCount == 0)
+    {
+        positionMin = positionMax = uvMin = uvMax = XMVectorZero();
+    }
+
+    // A flat axis, such as the quad's z, has no extent: every vertex decodes to its offset.
+    XMFLOAT3 positionOffset, positionExtent;
+    XMFLOAT2 uvOffset, uvExtent;
+    XMStoreFloat3(&positionOffset, positionMin);
+    XMStoreFloat3(&positionExtent, XMVectorSubtract(positionMax, positionMin));
+    XMStoreFloat2(&uvOffset, uvMin);
+    XMStoreFloat2(&uvExtent, XMVectorSubtract(uvMax, uvMin));
+    const float positionInverse[3] =
+    {
+        positionExtent.x > 0.0f ? 1.0f / positionExtent.x : 0.0f,
+        positionExtent.y > 0.0f ? 1.0f / positionExtent.y : 0.0f,
+        positionExtent.z > 0.0f ? 1.0f / positionExtent.z : 0.0f,
+    };
+    const float uvInverse[2] =
+    {
+        uvExtent.x > 0.0f ? 1.0f / uvExtent.x : 0.0f,
+        uvExtent.y > 0.0f ? 1.0f / uvExtent.y : 0.0f,
+    };
+    VertexDequantization& dequantization = pResult->dequantization;
+    dequantization.positionScale = XMFLOAT4(positionExtent.x, positionExtent.y, positionExtent.z, 0.0f);
+    dequantization.positionOffset = XMFLOAT4(positionOffset.x, positionOffset.y, positionOffset.z, 1.0f);
+    dequantization.uvScaleOffset = XMFLOAT4(uvExtent.x, uvExtent.y, uvOffset.x, uvOffset.y);
+
+    pResult->vertices.resize(vertexCount);
+    std::vector<QuantizationError> threadErrors(threadCount);
+    RunInParallel(threadCount, [&](UINT thread)
+    {
+        QuantizationError error = {};
+        float largestAngle = 0.0f;
+        for (UINT i = getFirst(thread); i < getFirst(thread + 1); i++)
+        {
+            const MeshVertex& vertex = mesh.vertices[i];
+            QuantizedVertex& quantized = pResult->vertices[i];
+            quantized.position[0] = QuantizeUnorm(vertex.position.x, positionOffset.x, positionInverse[0]);
+            quantized.position[1] = QuantizeUnorm(vertex.position.y, positionOffset.y, positionInverse[1]);
+            quantized.position[2] = QuantizeUnorm(vertex.position.z, positionOffset.z, positionInverse[2]);
+            quantized.position[3] = 0;
+            quantized.uv[0] = QuantizeUnorm(vertex.uv.x, uvOffset.x, uvInverse[0]);
+            quantized.uv[1] = QuantizeUnorm(vertex.uv.y, uvOffset.y, uvInverse[1]);
+            const XMVECTOR normal = XMLoadFloat3(&vertex.normal);
+            EncodeOctahedralNormal(normal, quantized.normal);
+
+            const XMVECTOR position = XMVectorSet(
+                DecodeUnorm(quantized.position[0]) * positionExtent.x + positionOffset.x,
+                DecodeUnorm(quantized.position[1]) * positionExtent.y + positionOffset.y,
+                DecodeUnorm(quantized.position[2]) * positionExtent.z + positionOffset.z, 0.0f);
+            const float u = DecodeUnorm(quantized.uv[0]) * uvExtent.x + uvOffset.x;
+            const float v = DecodeUnorm(quantized.uv[1]) * uvExtent.y + uvOffset.y;
+            error.position = max(error.position, XMVectorGetX(XMVector3Length(XMVectorSubtract(position, XMLoadFloat3(&vertex.position)))));
+            error.uv = max(error.uv, max(fabsf(u - vertex.uv.x), fabsf(v - vertex.uv.y)));
+            // From the sine as well as the cosine: a float cosine can't resolve small angles.
+            const XMVECTOR decodedNormal = DecodeOctahedralNormal(quantized.normal);
+            const float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(decodedNormal, normal)));
+            largestAngle = max(largestAngle, atan2f(sine, XMVectorGetX(XMVector3Dot(decodedNormal, normal))));
+        }
+        error.normalDegrees = XMConvertToDegrees(largestAngle);
+        threadErrors[thread] = error;
+    });
+
+    const float radius = 0.5f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&positionExtent)));
+    QuantizationError& error = pResult->error;
+    error = {};
+    for (const QuantizationError& threadError : threadErrors)
+    {
+        error.position = max(error.position, threadError.position);
+        error.uv = max(error.uv, threadError.uv);
+        error.normalDegrees = max(error.normalDegrees, threadError.normalDegrees);
+    }
+    error.position = radius > 0.0f ? error.position / radius : 0.0f;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "stdafx.h"
+#include "MeshImport.h"
+
+// Packs MeshVertex into the 16-byte vertex the sample draws: positions and texture
+// coordinates as 16-bit UNORM within the mesh's bounds, and a normal as two 16-bit SNORM
+// octahedral coordinates. The vertex shader undoes it with the root constants below;
+// SceneInputElementDescs in D3D12HelloTriangle.cpp describes the layout.
+
+struct QuantizedVertex
+{
+    UINT16 position[4];     // x, y, z; w is unused.
+    INT16 normal[2];
+    UINT16 uv[2];
+};
+
+// The VertexDequantization constants in shaders.hlsl: decoded = encoded * scale + offset,
+// with position w's scale 0 and offset 1, so that positions come out as points.
+struct VertexDequantization
+{
+    XMFLOAT4 positionScale;
+    XMFLOAT4 positionOffset;
+    XMFLOAT4 uvScaleOffset;         // Scale in xy, offset in zw.
+};
+
+// The largest change decoding made to any vertex.
+struct QuantizationError
+{
+    float position;                 // Relative to the mesh's radius, half its bounds' diagonal.
+    float uv;
+    float normalDegrees;
+};
+
+struct QuantizedMesh
+{
+    std::vector<QuantizedVertex> vertices;
+    VertexDequantization dequantization;
+    QuantizationError error;
+};
+
+// For meshes whose file had no normals, or not for every vertex: rebuilds every
+// vertex's normal from LOD 0's triangles, as the area-weighted sum of the faces around
+// every vertex at its position, so that texture seams don't show up as creases.
+void ComputeVertexNormals(Mesh* pMesh);
+
+// Octahedral encoding: the unit sphere folded onto the [-1, 1] square, the lower
+// hemisphere over its corners. Decoding matches shaders.hlsl's.
+void EncodeOctahedralNormal(FXMVECTOR normal, INT16 encoded[2]);
+XMVECTOR DecodeOctahedralNormal(const INT16 encoded[2]);
+
+// Quantises every vertex, threadCount threads taking a share each, and decodes them
+// again as the vertex shader will to measure the error. The result doesn't depend on
+// how many threads there are.
+void QuantizeMesh(const Mesh& mesh, UINT threadCount, QuantizedMesh* pResult);
@@ -0,0 +1,218 @@
+#include "stdafx.h"
+#include "VisibilityCache.h"
+#include <algorithm>
+
+VisibilityCache::VisibilityCache() :
+    m_view(GetClipSpaceView()),
+    m_cullRadius(0.0f),
+    m_viewTravel(0.0f),
+    m_cellSize(1.0f),
+    m_gridOrigin(0.0f, 0.0f),
+    m_columnCount(0),
+    m_rowCount(0),
+    m_updateIndex(0),
+    m_retestedCount(0),
+    m_boundedMoveCount(0)
+{
+}
+
+void VisibilityCache::Reset(const XMFLOAT4* pPositions, UINT objectCount, float cullRadius, const VisibilityView& view, float cellSize)
+{
+    m_view = view;
+    m_cullRadius = cullRadius;
+    m_viewTravel = 0.0f;
+    m_cellSize = cellSize;
+    m_updateIndex = 0;
+    m_movedObjects.clear();
+    m_visibleObjects.clear();
+
+    // The grid covers the objects and the view; moving objects that leave it are kept
+    // in the border cells.
+    float minX = view.centerX - view.halfWidth, maxX = view.centerX + view.halfWidth;
+    float minY = view.centerY - view.halfHeight, maxY = view.centerY + view.halfHeight;
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        minX = min(minX, pPositions[i].x);
+        maxX = max(maxX, pPositions[i].x);
+        minY = min(minY, pPositions[i].y);
+        maxY = max(maxY, pPositions[i].y);
+    }
+    m_gridOrigin = XMFLOAT2(minX, minY);
+    m_columnCount = static_cast<UINT>((maxX - minX) / cellSize) + 1;
+    m_rowCount = static_cast<UINT>((maxY - minY) / cellSize) + 1;
+    m_cells.assign(m_columnCount * m_rowCount, std::vector<UINT>());
+
+    m_objects.resize(objectCount);
+    for (UINT i = 0; i < objectCount; i++)
+    {
+        CachedObject& object = m_objects[i];
+        object.position = XMFLOAT2(pPositions[i].x, pPositions[i].y);
+        object.cell = GetCell(object.position);
+        object.cellSlot = static_cast<UINT>(m_cells[object.cell].size());
+        m_cells[object.cell].push_back(i);
+        object.visible = false;
+        object.moved = false;
+        Test(i);
+    }
+    m_retestedCount = objectCount;
+    m_boundedMoveCount = 0;
+}
+
+void VisibilityCache::MoveObject(UINT objectIndex, const XMFLOAT4& position)
+{
+    CachedObject& object = m_objects[objectIndex];
+    object.position = XMFLOAT2(position.x, position.y);
+
+    // Swap it out of its old cell.
+    const UINT cell = GetCell(object.position);
+    if (cell != object.cell)
+    {
+        std::vector<UINT>& oldCell = m_cells[object.cell];
+        const UINT last = oldCell.back();
+        oldCell[object.cellSlot] = last;
+        m_objects[last].cellSlot = object.cellSlot;
+        oldCell.pop_back();
+
+        object.cell = cell;
+        object.cellSlot = static_cast<UINT>(m_cells[cell].size());
+        m_cells[cell].push_back(objectIndex);
+    }
+
+    if (!object.moved)
+    {
+        object.moved = true;
+        m_movedObjects.push_back(objectIndex);
+    }
+}
+
+void VisibilityCache::Update(const VisibilityView& view)
+{
+    m_updateIndex++;
+    m_retestedCount = 0;
+    m_boundedMoveCount = 0;
+
+    // No edge moves farther than the centre's and the extent's largest changes together.
+    const float viewMove = max(fabsf(view.centerX - m_view.centerX), fabsf(view.centerY - m_view.centerY)) +
+        max(fabsf(view.halfWidth - m_view.halfWidth), fabsf(view.halfHeight - m_view.halfHeight));
+    if (viewMove > 0.0f)
+    {
+        const VisibilityView previousView = m_view;
+        m_view = view;
+        m_viewTravel += viewMove;
+        RetestSweptCells(previousView, view);
+    }
+
+    for (UINT objectIndex : m_movedObjects)
+    {
+        CachedObject& object = m_objects[objectIndex];
+        object.moved = false;
+        if (object.testedUpdate == m_updateIndex)
+        {
+            continue;
+        }
+
+        const float distance = max(fabsf(object.position.x - object.testedPosition.x), fabsf(object.position.y - object.testedPosition.y));
+        if (distance + (m_viewTravel - object.testedViewTravel) <= object.slack)
+        {
+            m_boundedMoveCount++;
+            continue;
+        }
+        Test(objectIndex);
+    }
+    m_movedObjects.clear();
+}
+
+// Settles the object against m_view, and how far it is from the result changing: for
+// a visible object, the least room left on either axis; for a hidden one, the most it
+// is outside by.
+void VisibilityCache::Test(UINT objectIndex)
+{
+    CachedObject& object = m_objects[objectIndex];
+    const float roomX = m_view.halfWidth - (fabsf(object.position.x - m_view.centerX) - m_cullRadius);
+    const float roomY = m_view.halfHeight - (fabsf(object.position.y - m_view.centerY) - m_cullRadius);
+    const bool visible = roomX >= 0.0f && roomY >= 0.0f;
+
+    object.testedPosition = object.position;
+    object.slack = visible ? min(roomX, roomY) : max(-roomX, -roomY);
+    object.testedViewTravel = m_viewTravel;
+    object.testedUpdate = m_updateIndex;
+    m_retestedCount++;
+
+    if (visible == object.visible)
+    {
+        return;
+    }
+    object.visible = visible;
+    if (visible)
+    {
+        object.visibleSlot = static_cast<UINT>(m_visibleObjects.size());
+        m_visibleObjects.push_back(objectIndex);
+    }
+    else
+    {
+        const UINT last = m_visibleObjects.back();
+        m_visibleObjects[object.visibleSlot] = last;
+        m_objects[last].visibleSlot = object.visibleSlot;
+        m_visibleObjects.pop_back();
+    }
+}
+
+UINT VisibilityCache::GetCell(const XMFLOAT2& position) const
+{
+    UINT firstColumn, firstRow, lastColumn, lastRow;
+    GetCellRange(position.x, position.y, position.x, position.y, &firstColumn, &firstRow, &lastColumn, &lastRow);
+    return firstRow * m_columnCount + firstColumn;
+}
+
+// The cells a rectangle overlaps, clamped to the grid.
+void VisibilityCache::GetCellRange(float minX, float minY, float maxX, float maxY, UINT* pFirstColumn, UINT* pFirstRow, UINT* pLastColumn, UINT* pLastRow) const
+{
+    auto toCell = [this](float value, float origin, UINT count)
+    {
+        const float cell = floorf((value - origin) / m_cellSize);
+        return static_cast<UINT>(min(max(cell, 0.0f), static_cast<float>(count - 1)));
+    };
+    *pFirstColumn = toCell(minX, m_gridOrigin.x, m_columnCount);
+    *pLastColumn = toCell(maxX, m_gridOrigin.x, m_columnCount);
+    *pFirstRow = toCell(minY, m_gridOrigin.y, m_rowCount);
+    *pLastRow = toCell(maxY, m_gridOrigin.y, m_rowCount);
+}
+
+// An object's result changes with the view only if its position is in one of the two
+// views grown by the cull radius and not the other. Re-tests the objects of every cell
+// that overlaps either grown view and is not wholly inside both; border cells also
+// hold everything beyond the grid, so they are never skipped.
+void VisibilityCache::RetestSweptCells(const VisibilityView& previousView, const VisibilityView& view)
+{
+    const float previousHalfWidth = previousView.halfWidth + m_cullRadius, previousHalfHeight = previousView.halfHeight + m_cullRadius;
+    const float halfWidth = view.halfWidth + m_cullRadius, halfHeight = view.halfHeight + m_cullRadius;
+    const float unionMinX = min(previousView.centerX - previousHalfWidth, view.centerX - halfWidth);
+    const float unionMaxX = max(previousView.centerX + previousHalfWidth, view.centerX + halfWidth);
+    const float unionMinY = min(previousView.centerY - previousHalfHeight, view.centerY - halfHeight);
+    const float unionMaxY = max(previousView.centerY + previousHalfHeight, view.centerY + halfHeight);
+    const float bothMinX = max(previousView.centerX - previousHalfWidth, view.centerX - halfWidth);
+    const float bothMaxX = min(previousView.centerX + previousHalfWidth, view.centerX + halfWidth);
+    const float bothMinY = max(previousView.centerY - previousHalfHeight, view.centerY - halfHeight);
+    const float bothMaxY = min(previousView.centerY + previousHalfHeight, view.centerY + halfHeight);
+
+    UINT firstColumn, firstRow, lastColumn, lastRow;
+    GetCellRange(unionMinX, unionMinY, unionMaxX, unionMaxY, &firstColumn, &firstRow, &lastColumn, &lastRow);
+    for (UINT row = firstRow; row <= lastRow; row++)
+    {
+        for (UINT column = firstColumn; column <= lastColumn; column++)
+        {
+            const float cellMinX = m_gridOrigin.x + column * m_cellSize;
+            const float cellMinY = m_gridOrigin.y + row * m_cellSize;
+            const bool border = column == 0 || row == 0 || column == m_columnCount - 1 || row == m_rowCount - 1;
+            const bool inBoth = cellMinX >= bothMinX && cellMinX + m_cellSize <= bothMaxX && cellMinY >= bothMinY && cellMinY + m_cellSize <= bothMaxY;
+            if (inBoth && !border)
+            {
+                continue;
+            }
+            for (UINT objectIndex : m_cells[row * m_columnCount + column])
+            {
+                Test(objectIndex);
+            }
+        }
+    }
+}
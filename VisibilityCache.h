@@ -0,0 +1,99 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+using namespace DirectX;
+
+// The part of the world in view, as a rectangle in x and y. The sample draws in clip
+// space, so its view is the unit square around the origin.
+struct VisibilityView
+{
+    float centerX;
+    float centerY;
+    float halfWidth;
+    float halfHeight;
+};
+
+inline VisibilityView GetClipSpaceView()
+{
+    const VisibilityView view = { 0.0f, 0.0f, 1.0f, 1.0f };
+    return view;
+}
+
+// IsObjectVisible for any view: the object's bounding square, cullRadius from its
+// position, overlaps the view.
+inline bool IsObjectInView(const XMFLOAT4& position, float cullRadius, const VisibilityView& view)
+{
+    return fabsf(position.x - view.centerX) - cullRadius <= view.halfWidth && fabsf(position.y - view.centerY) - cullRadius <= view.halfHeight;
+}
+
+// Per-object visibility carried over from frame to frame, so that culling costs what
+// changed rather than what exists. An object is re-tested when:
+//   - it moved farther than its motion bound, the distance it could go without its
+//     result changing, less how far the view's edges have moved since its test;
+//   - or it sits in a grid cell the view's edges swept over since the last Update.
+// Everything else keeps its last result. Results are exact, not approximate: the
+// bounds are conservative, so a skipped test would have given the same answer.
+class VisibilityCache
+{
+public:
+    VisibilityCache();
+
+    // Tests every object against view and bins them into square cells of cellSize,
+    // over the objects' current extent; objects outside it go to the border cells.
+    void Reset(const XMFLOAT4* pPositions, UINT objectCount, float cullRadius, const VisibilityView& view, float cellSize);
+
+    // The object is now at position. Its result is settled at the next Update.
+    void MoveObject(UINT objectIndex, const XMFLOAT4& position);
+
+    // Brings every result up to date for view. Not thread safe; the results may be
+    // read from any thread between Updates.
+    void Update(const VisibilityView& view);
+
+    bool IsVisible(UINT objectIndex) const { return m_objects[objectIndex].visible; }
+
+    // Not in any particular order.
+    const std::vector<UINT>& GetVisibleObjects() const { return m_visibleObjects; }
+
+    UINT GetObjectCount() const { return static_cast<UINT>(m_objects.size()); }
+
+    // By the last Update: objects tested again, and moved objects their motion bound
+    // kept from being tested.
+    UINT GetRetestedCount() const { return m_retestedCount; }
+    UINT GetBoundedMoveCount() const { return m_boundedMoveCount; }
+
+private:
+    struct CachedObject
+    {
+        XMFLOAT2 position;
+        XMFLOAT2 testedPosition;
+        float slack;                // How far, in x or y, the object or the view's edges can move before the result may change.
+        float testedViewTravel;     // m_viewTravel when it was tested.
+        UINT cell;
+        UINT cellSlot;              // Its place in m_cells[cell].
+        UINT visibleSlot;           // Its place in m_visibleObjects, when visible.
+        UINT testedUpdate;          // The m_updateIndex it was last tested in.
+        bool visible;
+        bool moved;
+    };
+
+    void Test(UINT objectIndex);
+    UINT GetCell(const XMFLOAT2& position) const;
+    void GetCellRange(float minX, float minY, float maxX, float maxY, UINT* pFirstColumn, UINT* pFirstRow, UINT* pLastColumn, UINT* pLastRow) const;
+    void RetestSweptCells(const VisibilityView& previousView, const VisibilityView& view);
+
+    std::vector<CachedObject> m_objects;
+    std::vector<std::vector<UINT>> m_cells;
+    std::vector<UINT> m_visibleObjects;
+    std::vector<UINT> m_movedObjects;
+    VisibilityView m_view;
+    float m_cullRadius;
+    float m_viewTravel;             // Sum of how far the view's edges moved at each Update.
+    float m_cellSize;
+    XMFLOAT2 m_gridOrigin;
+    UINT m_columnCount;
+    UINT m_rowCount;
+    UINT m_updateIndex;
+    UINT m_retestedCount;
+    UINT m_boundedMoveCount;
+};
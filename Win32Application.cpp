@@ -22,6 +22,12 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
     pSample->ParseCommandLineArgs(argv, argc);
     LocalFree(argv);
 
+    if (pSample->GetPrecompileShaders())
+    {
+        pSample->OnPrecompileShaders();
+        return 0;
+    }
+
     // Initialize the window class.
     WNDCLASSEX windowClass = { 0 };
     windowClass.cbSize = sizeof(WNDCLASSEX);
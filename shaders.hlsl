@@ -9,6 +9,8 @@
 //
 //*********************************************************
 
+#include "InstanceData.hlsli"
+
 float4x4 CreateTranslationMatrix(float3 translation)
 {
     return float4x4(
@@ -27,21 +29,83 @@ struct PSInput
 {
     float4 position : SV_POSITION;
     float2 uv : TEXCOORD;
+    float3 normal : NORMAL;
+};
+
+// Root constant and GPU-driven paths: the object index is a root constant, set per
+// draw or by the ExecuteIndirect command, and indexes the frame's packed instances.
+cbuffer DrawConstants : register(b1)
+{
+    uint objectIndex;
+};
+
+StructuredBuffer<PackedInstanceData> g_instances : register(t1);
+
+// Root CBV path: the same per-object constants, bound by GPU virtual address instead of
+// through a descriptor. A separate space keeps it from overlapping the table's b0.
+cbuffer ObjectConstants : register(b0, space1)
+{
+    matrix objectModel[4];
+};
+
+// Undoes the mesh's vertex quantisation (see VertexQuantization.h): the input assembler
+// turns the 16-bit UNORM positions and texture coordinates into [0, 1], and these
+// stretch them back over the mesh's bounds. Set once per command list.
+cbuffer VertexDequantization : register(b2)
+{
+    float4 positionScale;   // w 0 and offset w 1: positions come out as points.
+    float4 positionOffset;
+    float4 uvScaleOffset;   // Scale in xy, offset in zw.
 };
 
 Texture2D g_texture : register(t0);
 SamplerState g_sampler : register(s0);
 
-PSInput VSMain(float4 position : POSITION, float4 uv : TEXCOORD, uint instanceID : SV_InstanceID)
+// The octahedral encoding's inverse: the square's corners fold back over the lower
+// hemisphere.
+float3 DecodeOctahedralNormal(float2 encoded)
+{
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    const float fold = saturate(-normal.z);
+    normal.xy += (normal.xy >= 0.0f) ? -fold : fold;
+    return normalize(normal);
+}
+
+PSInput DecodeVertex(float4 position, float2 normal, float2 uv)
 {
     PSInput result;
+    result.position = position * positionScale + positionOffset;
+    result.uv = uv * uvScaleOffset.xy + uvScaleOffset.zw;
+    result.normal = DecodeOctahedralNormal(normal);
+    return result;
+}
+
+PSInput VSMain(float4 position : POSITION, float2 normal : NORMAL, float2 uv : TEXCOORD, uint instanceID : SV_InstanceID)
+{
+    PSInput result = DecodeVertex(position, normal, uv);
     //result.position = position;
-    result.position = mul(position, model[instanceID]);
-    result.uv = uv;
+    result.position = mul(result.position, model[instanceID]);
+    return result;
+}
+
+PSInput VSMainRootCbv(float4 position : POSITION, float2 normal : NORMAL, float2 uv : TEXCOORD, uint instanceID : SV_InstanceID)
+{
+    PSInput result = DecodeVertex(position, normal, uv);
+    result.position = mul(result.position, objectModel[instanceID]);
+    return result;
+}
+
+PSInput VSMainIndirect(float4 position : POSITION, float2 normal : NORMAL, float2 uv : TEXCOORD)
+{
+    PSInput result = DecodeVertex(position, normal, uv);
+    result.position = TransformPosition(DecodeInstanceData(g_instances[objectIndex]), result.position.xyz);
     return result;
 }
 
+// A light at the viewer. The objects only spin about z, which leaves the normal's z as
+// it is in object space, so the quad, facing -z, stays fully lit.
 float4 PSMain(PSInput input) : SV_TARGET
 {
-    return g_texture.Sample(g_sampler, input.uv);
+    const float lighting = 0.25f + 0.75f * saturate(-normalize(input.normal).z);
+    return g_texture.Sample(g_sampler, input.uv) * float4(lighting.xxx, 1.0f);
 }
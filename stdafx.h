@@ -39,4 +39,7 @@ static const UINT NumContexts = 3;
 static const int CommandListCount = 2;
 static const int CommandListPre = 0;
 static const int CommandListPost = 1;
-static const int ConstBufferNum = 100;
\ No newline at end of file
+static const int ConstBufferNum = 100;
+
+// Size of the persistent staging ring that feeds every upload to DEFAULT heap resources.
+static const UINT64 UploadRingBufferSize = 32 * 1024 * 1024;
\ No newline at end of file